@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include "binary_freq_collection.hpp"
+#include "bit_vector.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "index_types.hpp"
+#include "pisa_config.hpp"
+#include "util/prefix_sum.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+
+namespace {
+
+struct posting_list {
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> freqs;
+};
+
+/// Posting lists over documents `[0, num_docs)`, on which every benchmark is run.
+struct distribution {
+    std::string name;
+    uint64_t num_docs = 0;
+    std::vector<posting_list> lists;
+};
+
+/// Generates `list_count` lists of `list_size` postings, whose document gaps are drawn
+/// from a geometric distribution of mean `1 / near_density`, or of mean `1 / far_density`
+/// with probability `far_probability`, so that postings come in clusters when the latter
+/// is positive. Frequencies are geometric, as they are in text collections.
+auto synthetic_distribution(
+    std::string name,
+    std::size_t list_count,
+    std::size_t list_size,
+    double near_density,
+    double far_density = 1.0,
+    double far_probability = 0.0) -> distribution
+{
+    std::mt19937_64 rng(1729);
+    std::geometric_distribution<uint32_t> near_gap(near_density);
+    std::geometric_distribution<uint32_t> far_gap(far_density);
+    std::bernoulli_distribution far(far_probability);
+    std::geometric_distribution<uint32_t> freq(0.5);
+
+    distribution dist{std::move(name), 0, {}};
+    for (std::size_t list = 0; list < list_count; ++list) {
+        posting_list plist;
+        uint64_t doc = near_gap(rng);
+        for (std::size_t posting = 0; posting < list_size; ++posting) {
+            plist.docs.push_back(doc);
+            plist.freqs.push_back(1 + freq(rng));
+            doc += 1 + (far(rng) ? far_gap(rng) : near_gap(rng));
+        }
+        dist.num_docs = std::max(dist.num_docs, uint64_t(plist.docs.back()) + 1);
+        dist.lists.push_back(std::move(plist));
+    }
+    return dist;
+}
+
+/// Reads at most `max_lists` lists with at least `min_length` postings from a collection.
+auto collection_distribution(
+    std::string const& basename, std::size_t min_length, std::size_t max_lists) -> distribution
+{
+    binary_freq_collection collection(basename.c_str());
+    distribution dist{"real", collection.num_docs(), {}};
+    for (auto const& seq: collection) {
+        if (seq.docs.size() < min_length) {
+            continue;
+        }
+        dist.lists.push_back(posting_list{
+            std::vector<uint32_t>(seq.docs.begin(), seq.docs.end()),
+            std::vector<uint32_t>(seq.freqs.begin(), seq.freqs.end())});
+        if (dist.lists.size() == max_lists) {
+            break;
+        }
+    }
+    return dist;
+}
+
+/// The blocks encoded by a block codec, as written by `block_posting_list`: document gaps
+/// minus one, with their sum, or frequencies minus one, whose sum is not given.
+struct codec_input {
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> block_sizes;
+    std::vector<uint32_t> block_sums;
+};
+
+auto make_codec_input(distribution const& dist, std::size_t block_size, bool docs) -> codec_input
+{
+    codec_input input;
+    for (auto const& plist: dist.lists) {
+        uint32_t last_doc(-1);
+        for (std::size_t begin = 0; begin < plist.docs.size(); begin += block_size) {
+            auto end = std::min(begin + block_size, plist.docs.size());
+            uint64_t sum = 0;
+            for (auto posting = begin; posting < end; ++posting) {
+                uint32_t value =
+                    docs ? plist.docs[posting] - last_doc - 1 : plist.freqs[posting] - 1;
+                last_doc = plist.docs[posting];
+                input.values.push_back(value);
+                sum += value;
+            }
+            input.block_sizes.push_back(end - begin);
+            input.block_sums.push_back(docs ? uint32_t(sum) : uint32_t(-1));
+        }
+    }
+    return input;
+}
+
+template <typename BlockCodec>
+void encode_blocks(codec_input const& input, std::vector<uint8_t>& out)
+{
+    auto const* values = input.values.data();
+    for (std::size_t block = 0; block < input.block_sizes.size(); ++block) {
+        BlockCodec::encode(values, input.block_sums[block], input.block_sizes[block], out);
+        values += input.block_sizes[block];
+    }
+}
+
+template <typename BlockCodec>
+void register_codec(std::string const& codec, distribution const& dist)
+{
+    for (bool docs: {true, false}) {
+        auto input = std::make_shared<codec_input>(
+            make_codec_input(dist, BlockCodec::block_size, docs));
+        auto suffix = fmt::format("{}/{}/{}", codec, dist.name, docs ? "docs" : "freqs");
+
+        benchmark::RegisterBenchmark(
+            ("encode/" + suffix).c_str(), [input](benchmark::State& state) {
+                std::vector<uint8_t> out;
+                for (auto _: state) {
+                    out.clear();
+                    encode_blocks<BlockCodec>(*input, out);
+                    benchmark::DoNotOptimize(out.data());
+                }
+                state.SetItemsProcessed(state.iterations() * input->values.size());
+                state.counters["bits_per_int"] = 8.0 * out.size() / input->values.size();
+            });
+
+        benchmark::RegisterBenchmark(
+            ("decode/" + suffix).c_str(), [input](benchmark::State& state) {
+                std::vector<uint8_t> encoded;
+                encode_blocks<BlockCodec>(*input, encoded);
+                // Some decoders read a few bytes past the end of the last block.
+                encoded.resize(encoded.size() + 64);
+                std::vector<uint32_t> buf(decode_buffer_size<BlockCodec>);
+                for (auto _: state) {
+                    uint8_t const* in = encoded.data();
+                    for (std::size_t block = 0; block < input->block_sizes.size(); ++block) {
+                        in = BlockCodec::decode(
+                            in, buf.data(), input->block_sums[block], input->block_sizes[block]);
+                        benchmark::DoNotOptimize(buf.data());
+                    }
+                }
+                state.SetItemsProcessed(state.iterations() * input->values.size());
+            });
+
+        if (not docs) {
+            continue;
+        }
+        // Docids as the enumerators reconstruct them, from gaps or directly by the codec.
+        benchmark::RegisterBenchmark(
+            ("docids/" + suffix).c_str(), [input](benchmark::State& state) {
+                std::vector<uint8_t> encoded;
+                encode_blocks<BlockCodec>(*input, encoded);
+                encoded.resize(encoded.size() + 64);
+                std::vector<uint32_t> buf(decode_buffer_size<BlockCodec>);
+                for (auto _: state) {
+                    uint8_t const* in = encoded.data();
+                    uint32_t base = 0;
+                    for (std::size_t block = 0; block < input->block_sizes.size(); ++block) {
+                        auto size = input->block_sizes[block];
+                        if constexpr (has_docid_decode<BlockCodec>::value) {
+                            in = BlockCodec::decode_docids(in, buf.data(), base, size);
+                        } else {
+                            in = BlockCodec::decode(in, buf.data(), input->block_sums[block], size);
+                            buf[0] += base;
+                            gaps_to_docids(buf.data(), size);
+                        }
+                        benchmark::DoNotOptimize(buf.data());
+                        base += input->block_sums[block] + size;
+                    }
+                }
+                state.SetItemsProcessed(state.iterations() * input->values.size());
+            });
+    }
+}
+
+void register_codecs(distribution const& dist)
+{
+    register_codec<optpfor_block>("optpfor", dist);
+    register_codec<varint_G8IU_block>("varint_G8IU", dist);
+    register_codec<streamvbyte_block>("streamvbyte", dist);
+    register_codec<streamvbyte_delta_block>("streamvbyte_delta", dist);
+    register_codec<maskedvbyte_block>("maskedvbyte", dist);
+    register_codec<interpolative_block>("interpolative", dist);
+    register_codec<qmx_block>("qmx", dist);
+    register_codec<varintgb_block>("varintgb", dist);
+    register_codec<simple8b_block>("simple8b", dist);
+    register_codec<simple16_block>("simple16", dist);
+    register_codec<simdbp_block>("simdbp", dist);
+    register_codec<avx512bp_block>("avx512bp", dist);
+    register_codec<basic_interpolative_block<64>>("interpolative_64", dist);
+    register_codec<basic_interpolative_block<256>>("interpolative_256", dist);
+    register_codec<basic_varintgb_block<64>>("varintgb_64", dist);
+    register_codec<basic_varintgb_block<256>>("varintgb_256", dist);
+    register_codec<basic_simdbp_block<256>>("simdbp_256", dist);
+    register_codec<dense_block<simdbp_block>>("dense_simdbp", dist);
+    register_codec<dense_block<varintgb_block>>("dense_varintgb", dist);
+}
+
+/// Registers `next_geq` on an index of type `IndexType` built from `dist`, every `skip`
+/// postings for each skip distance, as in `index_perftest`. The index is built the first
+/// time one of these benchmarks is run.
+template <typename IndexType>
+void register_next_geq(std::string const& type, distribution const& dist)
+{
+    if constexpr (std::is_same_v<IndexType, block_mixed_index>) {
+        // Mixed block indexes can only be created by transforming another block index.
+        return;
+    }
+    auto index = std::make_shared<std::unique_ptr<IndexType>>();
+    auto build = [index, &dist] {
+        if (*index == nullptr) {
+            global_parameters params;
+            typename IndexType::builder builder(dist.num_docs, params);
+            for (auto const& plist: dist.lists) {
+                uint64_t occurrences =
+                    std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+                builder.add_posting_list(
+                    plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), occurrences);
+            }
+            auto built = std::make_unique<IndexType>();
+            builder.build(*built);
+            *index = std::move(built);
+        }
+    };
+
+    auto* bench = benchmark::RegisterBenchmark(
+        fmt::format("next_geq/{}/{}", type, dist.name).c_str(),
+        [index, build, &dist](benchmark::State& state) {
+            build();
+            uint64_t skip = state.range(0);
+            std::vector<std::vector<uint32_t>> targets;
+            std::size_t calls = 0;
+            for (auto const& plist: dist.lists) {
+                auto& list_targets = targets.emplace_back();
+                for (std::size_t posting = 0; posting < plist.docs.size(); posting += skip) {
+                    list_targets.push_back(plist.docs[posting]);
+                }
+                calls += list_targets.size();
+            }
+            for (auto _: state) {
+                for (std::size_t list = 0; list < targets.size(); ++list) {
+                    auto reader = (**index)[list];
+                    for (auto target: targets[list]) {
+                        reader.next_geq(target);
+                        benchmark::DoNotOptimize(reader.docid());
+                    }
+                }
+            }
+            state.SetItemsProcessed(state.iterations() * calls);
+        });
+    bench->RangeMultiplier(16)->Range(1, 4096);
+}
+
+/// Registers `move` on random positions, that is select, of `compact_elias_fano` sequences
+/// of the documents of `dist`.
+void register_elias_fano_select(distribution const& dist)
+{
+    benchmark::RegisterBenchmark(
+        fmt::format("select/compact_elias_fano/{}", dist.name).c_str(),
+        [&dist](benchmark::State& state) {
+            global_parameters params;
+            bit_vector_builder bvb;
+            std::vector<uint64_t> offsets;
+            for (auto const& plist: dist.lists) {
+                offsets.push_back(bvb.size());
+                compact_elias_fano::write(
+                    bvb, plist.docs.begin(), dist.num_docs, plist.docs.size(), params);
+            }
+            bit_vector bv(&bvb);
+
+            std::mt19937_64 rng(1729);
+            std::vector<std::vector<uint64_t>> positions;
+            std::size_t calls = 0;
+            for (auto const& plist: dist.lists) {
+                std::uniform_int_distribution<uint64_t> position(0, plist.docs.size() - 1);
+                auto& list_positions = positions.emplace_back(4096);
+                std::generate(list_positions.begin(), list_positions.end(), [&] {
+                    return position(rng);
+                });
+                calls += list_positions.size();
+            }
+            for (auto _: state) {
+                for (std::size_t list = 0; list < dist.lists.size(); ++list) {
+                    compact_elias_fano::enumerator enumerator(
+                        bv, offsets[list], dist.num_docs, dist.lists[list].docs.size(), params);
+                    for (auto position: positions[list]) {
+                        benchmark::DoNotOptimize(enumerator.move(position));
+                    }
+                }
+            }
+            state.SetItemsProcessed(state.iterations() * calls);
+        });
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    std::string collection = PISA_SOURCE_DIR "/test/test_data/test_collection";
+    for (int arg = 1; arg < argc; ++arg) {
+        std::string flag = argv[arg];
+        if (flag.rfind("--collection=", 0) == 0) {
+            collection = flag.substr(flag.find('=') + 1);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--collection=<basename>] [benchmark options]" << std::endl;
+            return 1;
+        }
+    }
+
+    // The distributions must outlive the benchmarks, which refer to them.
+    std::vector<distribution> distributions;
+    distributions.push_back(synthetic_distribution("dense", 16, 1 << 16, 1.0 / 4));
+    distributions.push_back(synthetic_distribution("sparse", 16, 1 << 16, 1.0 / 1024));
+    distributions.push_back(
+        synthetic_distribution("clustered", 16, 1 << 16, 1.0 / 2, 1.0 / 1000, 0.1));
+    distributions.push_back(collection_distribution(collection, 4096, 100));
+
+    for (auto const& dist: distributions) {
+        register_codecs(dist);
+#define LOOP_BODY(R, DATA, T) \
+    register_next_geq<BOOST_PP_CAT(T, _index)>(BOOST_PP_STRINGIZE(T), dist);
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+        register_elias_fano_select(dist);
+    }
+    benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""Reproducible query latency benchmarks, comparable across commits.
+
+`run` builds the indexes and WAND data of the datasets of a configuration file, unless they
+already exist, runs its query set with every algorithm through `queries`, and writes the
+latencies, along with the commit, the host, and the configuration, to a JSON file. `compare`
+reports the latencies of two such files side by side, and fails if any regressed.
+"""
+
+import argparse
+import datetime
+import json
+import logging
+import os
+import platform
+import statistics
+import subprocess
+import sys
+
+SCHEMA_VERSION = 1
+SCRIPTDIR = os.path.abspath(os.path.dirname(__file__) + '/..')
+METRICS = ['avg', 'q50', 'q90', 'q95', 'q99', 'qps']
+
+_log = logging.getLogger('harness')
+
+
+def git(*args):
+    try:
+        return subprocess.check_output(
+            ['git', '-C', SCRIPTDIR] + list(args), stderr=subprocess.DEVNULL, text=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def host_info():
+    cpu = platform.processor()
+    try:
+        with open('/proc/cpuinfo') as fin:
+            for line in fin:
+                if line.startswith('model name'):
+                    cpu = line.split(':', 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    governor = None
+    try:
+        with open('/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor') as fin:
+            governor = fin.read().strip()
+    except OSError:
+        pass
+    return {
+        'hostname': platform.node(),
+        'system': platform.system(),
+        'kernel': platform.release(),
+        'cpu': cpu,
+        'cpu_count': os.cpu_count(),
+        'governor': governor,
+    }
+
+
+def drop_caches():
+    """Writes out dirty pages and drops the page cache, which requires root."""
+    subprocess.check_call(['sync'])
+    try:
+        with open('/proc/sys/vm/drop_caches', 'w') as fout:
+            fout.write('3\n')
+    except OSError as error:
+        sys.exit('Unable to drop caches ({}); run as root or without --drop-caches'.format(error))
+
+
+def run(command, pin, env=None):
+    if pin:
+        command = ['taskset', '-c', pin] + command
+    _log.info('%s', ' '.join(command))
+    return subprocess.run(
+        command, check=True, stdout=subprocess.PIPE, text=True, env=env).stdout
+
+
+def build(args, dataset):
+    """Builds the WAND data and the index of each encoding of `dataset` that do not exist."""
+    wand = dataset['wand']
+    outputs = {'wand': os.path.join(args.work_dir, '{}.wand'.format(dataset['name']))}
+    if args.rebuild or not os.path.exists(outputs['wand']):
+        command = [os.path.join(args.bin_dir, 'create_wand_data'),
+                   '-c', dataset['collection'], '-o', outputs['wand'],
+                   '-s', dataset['scorer'], '-b', str(wand.get('block_size', 64))]
+        if wand.get('compress', False):
+            command.append('--compress')
+        run(command, None)
+    for encoding in dataset['encodings']:
+        outputs[encoding] = os.path.join(
+            args.work_dir, '{}.{}'.format(dataset['name'], encoding))
+        if args.rebuild or not os.path.exists(outputs[encoding]):
+            run([os.path.join(args.bin_dir, 'create_freq_index'),
+                 '-e', encoding, '-c', dataset['collection'], '-o', outputs[encoding]], None)
+    return outputs
+
+
+def measure(args, dataset, files, encoding, algorithm):
+    """Returns the median of each metric over the repetitions of a `queries` run."""
+    command = [os.path.join(args.bin_dir, 'queries'),
+               '-e', encoding, '-i', files[encoding], '-w', files['wand'],
+               '-s', dataset['scorer'], '-a', algorithm, '-q', dataset['queries'],
+               '-k', str(dataset.get('k', 10))]
+    if dataset.get('threads', 1) > 1:
+        command += ['--threads', str(dataset['threads'])]
+    samples = []
+    for _ in range(args.repetitions):
+        if args.drop_caches:
+            drop_caches()
+        for line in run(command, args.cores).splitlines():
+            if line.startswith('{'):
+                stats = json.loads(line)
+                if stats.get('query') == algorithm:
+                    samples.append(stats)
+    if not samples:
+        sys.exit('No results for {} with {}'.format(algorithm, encoding))
+    result = {'dataset': dataset['name'], 'encoding': encoding, 'algorithm': algorithm,
+              'repetitions': len(samples)}
+    for metric in METRICS:
+        result[metric] = statistics.median(sample[metric] for sample in samples)
+    return result
+
+
+def run_command(args):
+    with open(args.config) as fin:
+        config = json.load(fin)
+    os.makedirs(args.work_dir, exist_ok=True)
+    results = []
+    for dataset in config['datasets']:
+        files = build(args, dataset)
+        for encoding in dataset['encodings']:
+            for algorithm in dataset['algorithms']:
+                results.append(measure(args, dataset, files, encoding, algorithm))
+    status = git('status', '--porcelain', '--untracked-files=no')
+    report = {
+        'schema': SCHEMA_VERSION,
+        'commit': git('rev-parse', 'HEAD'),
+        'dirty': bool(status) if status is not None else None,
+        'date': datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        'host': host_info(),
+        'protocol': {'cores': args.cores, 'drop_caches': args.drop_caches,
+                     'repetitions': args.repetitions},
+        'config': config,
+        'results': results,
+    }
+    with open(args.output, 'w') as fout:
+        json.dump(report, fout, indent=2)
+    _log.info('Wrote %d results to %s', len(results), args.output)
+
+
+def compare_command(args):
+    with open(args.baseline) as fin:
+        baseline = json.load(fin)
+    with open(args.current) as fin:
+        current = json.load(fin)
+    for report in (baseline, current):
+        if report.get('schema') != SCHEMA_VERSION:
+            sys.exit('Unsupported schema {}'.format(report.get('schema')))
+    if baseline['host'].get('cpu') != current['host'].get('cpu'):
+        _log.warning('Results come from different CPUs')
+
+    def key(result):
+        return (result['dataset'], result['encoding'], result['algorithm'])
+
+    reference = {key(result): result for result in baseline['results']}
+    regressions = 0
+    print('{:<16} {:<20} {:<24} {:>12} {:>12} {:>8}'.format(
+        'dataset', 'encoding', 'algorithm', 'baseline', 'current', 'change'))
+    for result in current['results']:
+        before = reference.get(key(result))
+        if before is None or not before[args.metric]:
+            continue
+        change = 100.0 * (result[args.metric] - before[args.metric]) / before[args.metric]
+        # Throughput regresses when it drops, latencies when they grow.
+        regressed = -change > args.threshold if args.metric == 'qps' else change > args.threshold
+        regressions += regressed
+        print('{:<16} {:<20} {:<24} {:>12.1f} {:>12.1f} {:>+7.1f}%{}'.format(
+            *key(result), before[args.metric], result[args.metric], change,
+            ' REGRESSION' if regressed else ''))
+    if regressions:
+        sys.exit('{} regressions of {} above {}%'.format(regressions, args.metric, args.threshold))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    run_parser = subparsers.add_parser('run', help='Build indexes and measure query latencies')
+    run_parser.add_argument('config', help='JSON file of datasets, see harness.example.json')
+    run_parser.add_argument('-o', '--output', required=True, help='JSON file of results')
+    run_parser.add_argument('--bin-dir', default=os.path.join(SCRIPTDIR, 'build', 'bin'),
+                            help='Directory of the PISA binaries')
+    run_parser.add_argument('--work-dir', default='benchmark-data',
+                            help='Directory of the indexes and WAND data, reused across runs')
+    run_parser.add_argument('--rebuild', action='store_true',
+                            help='Rebuild indexes and WAND data even if they exist')
+    run_parser.add_argument('--cores', help='Cores to pin queries to, as taskset -c takes them')
+    run_parser.add_argument('--drop-caches', action='store_true',
+                            help='Drop the page cache before each run (requires root)')
+    run_parser.add_argument('--repetitions', type=int, default=3,
+                            help='Runs of each algorithm, whose median is reported')
+    run_parser.set_defaults(func=run_command)
+
+    compare_parser = subparsers.add_parser('compare', help='Compare two result files')
+    compare_parser.add_argument('baseline')
+    compare_parser.add_argument('current')
+    compare_parser.add_argument('--metric', default='q50', choices=METRICS)
+    compare_parser.add_argument('--threshold', type=float, default=5.0,
+                                help='Change in percent beyond which a result regressed')
+    compare_parser.set_defaults(func=compare_command)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s:%(levelname)s: %(message)s')
+    main()
@@ -28,6 +28,15 @@ int main()
         }
 
         double time = (get_time_usecs() - tick) / runs * 1000;
-        spdlog::info("u = {}; time = {}", u, time);
+
+        // the first values only, as decoded by `next_geq` skipping into a block
+        tick = get_time_usecs();
+        for (size_t run = 0; run < runs; ++run) {
+            interpolative_block::decode_prefix(
+                encoded.data(), values.data(), sum_of_values, values.size(), 16);
+            do_not_optimize_away(values[0]);
+        }
+        double prefix_time = (get_time_usecs() - tick) / runs * 1000;
+        spdlog::info("u = {}; time = {}; prefix time = {}", u, time, prefix_time);
     }
 }
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+
+#include "binary_freq_collection.hpp"
+#include "document_lexicon.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "query/queries.hpp"
+#include "query/term_processor.hpp"
+#include "scorer/scorer.hpp"
+#include "topk_queue.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using list_type = binary_freq_collection::sequence;
+
+/// The `next_geq` targets of the lists of a query: for each term, the documents of the other
+/// terms, in order, as block-max algorithms move the upper bounds of a list to the pivots
+/// found in the others.
+struct next_geq_trace {
+    std::vector<std::pair<std::uint32_t, std::vector<std::uint32_t>>> moves;
+    std::size_t calls = 0;
+};
+
+[[nodiscard]] auto distinct_terms(Query const& query, std::size_t term_count)
+    -> std::vector<std::uint32_t>
+{
+    std::vector<std::uint32_t> terms;
+    for (auto term: query.terms) {
+        if (term < term_count) {
+            terms.push_back(term);
+        }
+    }
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    return terms;
+}
+
+[[nodiscard]] auto trace_next_geq(
+    std::vector<list_type> const& lists, std::vector<Query> const& queries, std::size_t max_calls)
+    -> next_geq_trace
+{
+    next_geq_trace trace;
+    for (auto const& query: queries) {
+        auto terms = distinct_terms(query, lists.size());
+        for (auto term: terms) {
+            std::vector<std::uint32_t> targets;
+            for (auto other: terms) {
+                if (other != term || terms.size() == 1) {
+                    auto const& docs = lists[other].docs;
+                    targets.insert(targets.end(), docs.begin(), docs.end());
+                }
+            }
+            std::sort(targets.begin(), targets.end());
+            targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+            if (targets.size() > max_calls) {
+                // An even sample keeps the targets spread over the whole list.
+                auto step = (targets.size() + max_calls - 1) / max_calls;
+                std::vector<std::uint32_t> sample;
+                for (std::size_t pos = 0; pos < targets.size(); pos += step) {
+                    sample.push_back(targets[pos]);
+                }
+                targets = std::move(sample);
+            }
+            trace.calls += targets.size();
+            trace.moves.emplace_back(term, std::move(targets));
+        }
+    }
+    return trace;
+}
+
+template <typename WandType>
+void wand_perftest(
+    std::string const& wand_filename, next_geq_trace const& trace, std::string const& type)
+{
+    spdlog::info("Loading WAND data from {}", wand_filename);
+    WandType wdata;
+    mio::mmap_source source(wand_filename.c_str());
+    mapper::map(wdata, source, mapper::map_flags::warmup);
+
+    auto tick = get_time_usecs();
+    for (auto const& [term, targets]: trace.moves) {
+        auto wand = wdata.getenum(term);
+        for (auto target: targets) {
+            wand.next_geq(target);
+            do_not_optimize_away(wand.score());
+        }
+    }
+    double elapsed = get_time_usecs() - tick;
+    auto ns = elapsed / trace.calls * 1000;
+    spdlog::info(
+        "Performed {} next_geq()+score() on {} lists: {:.1f} ns per call",
+        trace.calls,
+        trace.moves.size(),
+        ns);
+    spdlog::info("{}\tnext_geq\t{:.1f}", type, ns);
+}
+
+void lexicon_perftest(std::string const& lexicon_filename, std::vector<Query> const& queries)
+{
+    Document_Lexicon lexicon(lexicon_filename);
+    std::vector<std::uint64_t> ids;
+    for (auto const& query: queries) {
+        for (auto term: query.terms) {
+            if (term < lexicon.size()) {
+                ids.push_back(term);
+            }
+        }
+    }
+    if (ids.empty()) {
+        spdlog::warn("No query term is in the lexicon");
+        return;
+    }
+    std::string buffer;
+    auto tick = get_time_usecs();
+    for (auto id: ids) {
+        do_not_optimize_away(lexicon.lookup(id, buffer).size());
+    }
+    double elapsed = get_time_usecs() - tick;
+    auto ns = elapsed / ids.size() * 1000;
+    auto type = lexicon.is_front_coded() ? "front_coded_vector" : "payload_vector";
+    spdlog::info("Looked up {} terms of the queries: {:.1f} ns per lookup", ids.size(), ns);
+    spdlog::info("{}\tlookup\t{:.1f}", type, ns);
+}
+
+void term_processor_perftest(
+    std::string const& terms_filename,
+    std::optional<std::string> const& stemmer,
+    std::string const& text_queries_filename)
+{
+    std::vector<std::string> lines;
+    std::ifstream is(text_queries_filename);
+    io::for_each_line(is, [&](std::string const& line) { lines.push_back(line); });
+    TermProcessor term_processor(terms_filename, std::nullopt, stemmer);
+    // The first pass fills the cache of resolved tokens, which the second one hits, as
+    // repeated terms of a query log do.
+    for (auto pass: {"cold", "warm"}) {
+        std::size_t terms = 0;
+        auto tick = get_time_usecs();
+        for (auto const& line: lines) {
+            auto query = parse_query_terms(line, term_processor);
+            terms += query.terms.size();
+            do_not_optimize_away(query.terms.data());
+        }
+        double elapsed = get_time_usecs() - tick;
+        auto ns = elapsed / std::max<std::size_t>(terms, 1) * 1000;
+        spdlog::info(
+            "Resolved {} terms of {} queries ({} cache): {:.1f} ns per term",
+            terms,
+            lines.size(),
+            pass,
+            ns);
+        spdlog::info("term_processor_{}\tresolve\t{:.1f}", pass, ns);
+    }
+}
+
+template <typename WandType>
+void topk_perftest(
+    std::string const& wand_filename,
+    std::string const& scorer_name,
+    std::vector<list_type> const& lists,
+    std::vector<Query> const& queries,
+    std::size_t k)
+{
+    WandType wdata;
+    mio::mmap_source source(wand_filename.c_str());
+    mapper::map(wdata, source);
+    auto scorer = scorer::from_name(scorer_name, wdata);
+
+    // The scores of the documents of each query, in document order, as a disjunctive
+    // traversal inserts them.
+    std::vector<std::vector<std::pair<float, std::uint32_t>>> streams;
+    std::size_t inserts = 0;
+    for (auto const& query: queries) {
+        std::vector<std::pair<std::uint32_t, float>> postings;
+        for (auto term: distinct_terms(query, lists.size())) {
+            auto term_scorer = scorer->term_scorer(term);
+            auto freq = lists[term].freqs.begin();
+            for (auto doc: lists[term].docs) {
+                postings.emplace_back(doc, term_scorer(doc, *freq++));
+            }
+        }
+        std::sort(postings.begin(), postings.end());
+        auto& stream = streams.emplace_back();
+        for (auto pos = postings.begin(); pos != postings.end();) {
+            auto doc = pos->first;
+            float score = 0;
+            for (; pos != postings.end() && pos->first == doc; ++pos) {
+                score += pos->second;
+            }
+            stream.emplace_back(score, doc);
+        }
+        inserts += stream.size();
+    }
+    if (inserts == 0) {
+        spdlog::warn("No postings to insert");
+        return;
+    }
+
+    topk_queue topk(k);
+    std::size_t entered = 0;
+    auto tick = get_time_usecs();
+    for (auto const& stream: streams) {
+        topk.clear();
+        for (auto [score, doc]: stream) {
+            entered += static_cast<std::size_t>(topk.insert(score, doc));
+        }
+        topk.finalize();
+        do_not_optimize_away(topk.topk().size());
+    }
+    double elapsed = get_time_usecs() - tick;
+    auto ns = elapsed / inserts * 1000;
+    spdlog::info(
+        "Inserted {} scores of {} queries with k = {}, {:.2f}% entering: {:.1f} ns per insert",
+        inserts,
+        streams.size(),
+        k,
+        100.0 * entered / inserts,
+        ns);
+    spdlog::info("topk_queue\tinsert\t{}\t{:.1f}", k, ns);
+}
+
+int main(int argc, char const** argv)
+{
+    std::optional<std::string> collection_basename;
+    std::optional<std::string> wand_filename;
+    std::optional<std::string> queries_filename;
+    std::optional<std::string> lexicon_filename;
+    std::optional<std::string> text_queries_filename;
+    std::optional<std::string> stemmer;
+    std::string scorer_name = "bm25";
+    bool compressed_wand = false;
+    std::size_t k = 10;
+    std::size_t max_calls = 20000;
+
+    CLI::App app{
+        "Benchmarks the structures queries use besides posting lists, replaying the accesses "
+        "of a query log: WAND data, lexicons, term resolution, and top-k queues."};
+    auto* collection_option =
+        app.add_option("-c,--collection", collection_basename, "Collection basename");
+    auto* wand_option = app.add_option("-w,--wand", wand_filename, "WAND data filename");
+    app.add_flag("--compressed-wand", compressed_wand, "Compressed WAND data file");
+    app.add_option("-q,--queries", queries_filename, "Queries of term IDs")->required();
+    app.add_option("-s,--scorer", scorer_name, "Scorer of the top-k scores", true);
+    app.add_option("-k", k, "Size of the top-k queue", true);
+    app.add_option(
+        "--max-calls", max_calls, "Maximum next_geq calls on the WAND data of a term", true);
+    app.add_option("--lexicon", lexicon_filename, "Lexicon to look query term IDs up in");
+    auto* text_option = app.add_option(
+        "--text-queries",
+        text_queries_filename,
+        "Queries of terms, resolved with the lexicon given by --lexicon");
+    app.add_option("--stemmer", stemmer, "Stemmer of the terms of --text-queries")
+        ->needs(text_option);
+    wand_option->needs(collection_option);
+    CLI11_PARSE(app, argc, argv);
+    if (text_queries_filename && not lexicon_filename) {
+        spdlog::error("--text-queries requires --lexicon");
+        return 1;
+    }
+
+    std::vector<Query> queries;
+    std::ifstream qfile(*queries_filename);
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    spdlog::info("Replaying {} queries", queries.size());
+
+    if (wand_filename) {
+        binary_freq_collection collection(collection_basename->c_str());
+        std::vector<list_type> lists(collection.begin(), collection.end());
+        auto trace = trace_next_geq(lists, queries, max_calls);
+        if (compressed_wand) {
+            using wand_type = wand_data<wand_data_compressed<>>;
+            wand_perftest<wand_type>(*wand_filename, trace, "wand_data_compressed");
+            topk_perftest<wand_type>(*wand_filename, scorer_name, lists, queries, k);
+        } else {
+            using wand_type = wand_data<wand_data_raw>;
+            wand_perftest<wand_type>(*wand_filename, trace, "wand_data_raw");
+            topk_perftest<wand_type>(*wand_filename, scorer_name, lists, queries, k);
+        }
+    }
+    if (lexicon_filename) {
+        lexicon_perftest(*lexicon_filename, queries);
+    }
+    if (text_queries_filename) {
+        term_processor_perftest(*lexicon_filename, stemmer, *text_queries_filename);
+    }
+    return 0;
+}
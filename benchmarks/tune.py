@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Searches index and algorithm parameters for the best trade-offs of space and latency.
+
+`tune.py` samples the collection of a configuration file, builds a small index of the sample for
+every combination of the build parameters of its space, and runs the query log with every
+algorithm through `queries`, as `harness.py run` does. It writes the size and latencies of every
+combination, along with the commit and the host, to a JSON file, and reports the Pareto frontier
+of index size versus median and 99th percentile latency: the combinations that no other one
+beats on all three.
+"""
+
+import argparse
+import bisect
+import datetime
+import itertools
+import json
+import logging
+import os
+import subprocess
+import sys
+
+import harness
+
+SCHEMA_VERSION = 1
+OBJECTIVES = ['space', 'q50', 'q99']
+EF_ENCODINGS = {'ef', 'single', 'pefuniform', 'pefopt', 'pefopt_skip'}
+
+# The encodings each build parameter applies to, or None for all of them, so that other
+# encodings are built once rather than once per value.
+BUILD_PARAMETERS = {
+    'wand_block_size': None,
+    'quantization_bits': None,
+    'ef_log_sampling0': EF_ENCODINGS,
+    'ef_log_sampling1': EF_ENCODINGS,
+    'log_partition_size': {'pefuniform'},
+    'partition_eps1': {'pefopt', 'pefopt_skip'},
+    'partition_eps2': {'pefopt', 'pefopt_skip'},
+}
+
+_log = logging.getLogger('tune')
+
+
+def builds(space):
+    """Yields the build parameters of every index of `space`."""
+    for encoding in space['encoding']:
+        names = [name for name, encodings in BUILD_PARAMETERS.items()
+                 if name in space and (encodings is None or encoding in encodings)]
+        for values in itertools.product(*(space[name] for name in names)):
+            yield dict(encoding=encoding, **dict(zip(names, values)))
+
+
+def build_name(params):
+    return '.'.join([params['encoding']] + ['{}={}'.format(name, value)
+                                            for name, value in sorted(params.items())
+                                            if name != 'encoding'])
+
+
+def remap_queries(queries, dropped, output):
+    """Writes the queries of term IDs to `output` with the IDs of the sample, which has no list
+    for the `dropped` terms: these are left out, and queries left without terms are dropped."""
+    dropped = sorted(set(dropped))
+    dropped_set = set(dropped)
+    with open(queries) as fin, open(output, 'w') as fout:
+        for line in fin:
+            qid, sep, terms = line.rstrip('\n').rpartition(':')
+            sampled = [str(term - bisect.bisect_left(dropped, term))
+                       for term in map(int, terms.split()) if term not in dropped_set]
+            if sampled:
+                fout.write('{}{}{}\n'.format(qid, sep, ' '.join(sampled)))
+
+
+def sample(args, config):
+    """Samples the collection as given by the `sample` section of the configuration, if any, and
+    returns the basenames of the collection and the query log to tune on."""
+    if 'sample' not in config:
+        return config['collection'], config['queries']
+    basename = os.path.join(args.work_dir, 'sample')
+    queries = basename + '.queries'
+    if args.rebuild or not os.path.exists(queries):
+        options = config['sample']
+        harness.run([os.path.join(args.bin_dir, 'sample_inverted_index'),
+                     '-c', config['collection'], '-o', basename,
+                     '-t', options.get('type', 'random_docids'), '-r', str(options['rate']),
+                     '--seed', str(options.get('seed', 0)),
+                     '--terms-to-drop', basename + '.dropped'], None)
+        with open(basename + '.dropped') as fin:
+            dropped = [int(line) for line in fin if line.strip()]
+        remap_queries(config['queries'], dropped, queries)
+    return basename, queries
+
+
+def build(args, config, collection, params, built):
+    """Builds the index of `params` and its WAND data, unless they exist or are in `built`, and
+    returns the files and the scorer to query them with."""
+    wand = os.path.join(args.work_dir, 'wand.{}'.format(params.get('wand_block_size', 64)))
+    if wand not in built and (args.rebuild or not os.path.exists(wand)):
+        harness.run([os.path.join(args.bin_dir, 'create_wand_data'),
+                     '-c', collection, '-o', wand, '-s', config['scorer'],
+                     '-b', str(params.get('wand_block_size', 64))], None)
+        built.add(wand)
+
+    index = os.path.join(args.work_dir, build_name(params))
+    command = [os.path.join(args.bin_dir, 'create_freq_index'),
+               '-e', params['encoding'], '-c', collection, '-o', index]
+    for name in ['ef_log_sampling0', 'ef_log_sampling1', 'log_partition_size']:
+        if name in params:
+            command += ['--' + name.replace('_', '-'), str(params[name])]
+    env = dict(os.environ)
+    for name in ['partition_eps1', 'partition_eps2']:
+        if name in params:
+            env['PISA_' + name.upper()] = str(params[name])
+    files = {params['encoding']: index, 'wand': wand, 'scorer': config['scorer']}
+    if params.get('quantization_bits') is not None:
+        # The index stores quantized scores, scored with the WAND data it writes along.
+        env['PISA_QUANTIZTION_BITS'] = str(params['quantization_bits'])
+        files.update(wand=index + '.wand', scorer='quantized')
+        command += ['-w', wand, '-s', config['scorer'], '--quantize',
+                    '--quantized-wand', files['wand']]
+    if args.rebuild or not os.path.exists(index):
+        harness.run(command, None, env)
+    files['space'] = os.path.getsize(index) + os.path.getsize(files['wand'])
+    return files
+
+
+def dominates(lhs, rhs):
+    return (all(lhs[o] <= rhs[o] for o in OBJECTIVES)
+            and any(lhs[o] < rhs[o] for o in OBJECTIVES))
+
+
+def pareto_frontier(points):
+    frontier = [point for point in points if not any(dominates(other, point) for other in points)]
+    return sorted(frontier, key=lambda point: [point[o] for o in OBJECTIVES])
+
+
+def tune_command(args):
+    with open(args.config) as fin:
+        config = json.load(fin)
+    os.makedirs(args.work_dir, exist_ok=True)
+    collection, queries = sample(args, config)
+    points = []
+    built = set()
+    for params in builds(config['space']):
+        try:
+            files = build(args, config, collection, params, built)
+        except subprocess.CalledProcessError as error:
+            _log.warning('Skipping %s, which failed to build: %s', build_name(params), error)
+            continue
+        dataset = {'name': build_name(params), 'queries': queries, 'scorer': files['scorer'],
+                   'k': config.get('k', 10), 'threads': config.get('threads', 1)}
+        for algorithm in config['space']['algorithm']:
+            result = harness.measure(args, dataset, files, params['encoding'], algorithm)
+            points.append(dict(params, algorithm=algorithm, space=files['space'],
+                               **{metric: result[metric] for metric in harness.METRICS}))
+    if not points:
+        sys.exit('No configuration could be measured')
+    frontier = pareto_frontier(points)
+    status = harness.git('status', '--porcelain', '--untracked-files=no')
+    report = {
+        'schema': SCHEMA_VERSION,
+        'commit': harness.git('rev-parse', 'HEAD'),
+        'dirty': bool(status) if status is not None else None,
+        'date': datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        'host': harness.host_info(),
+        'protocol': {'cores': args.cores, 'drop_caches': args.drop_caches,
+                     'repetitions': args.repetitions},
+        'config': config,
+        'points': points,
+        'frontier': frontier,
+    }
+    with open(args.output, 'w') as fout:
+        json.dump(report, fout, indent=2)
+    _log.info('Wrote %d points, %d on the frontier, to %s',
+              len(points), len(frontier), args.output)
+
+    print('{:>12} {:>10} {:>10}  {}'.format('space (KiB)', 'q50', 'q99', 'configuration'))
+    for point in frontier:
+        params = {name: value for name, value in point.items()
+                  if name in BUILD_PARAMETERS or name == 'algorithm'}
+        print('{:>12.1f} {:>10.1f} {:>10.1f}  {} {}'.format(
+            point['space'] / 1024, point['q50'], point['q99'], point['encoding'],
+            ' '.join('{}={}'.format(name, value) for name, value in sorted(params.items()))))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('config', help='JSON file of the parameter space, see tune.example.json')
+    parser.add_argument('-o', '--output', required=True, help='JSON file of results')
+    parser.add_argument('--bin-dir', default=os.path.join(harness.SCRIPTDIR, 'build', 'bin'),
+                        help='Directory of the PISA binaries')
+    parser.add_argument('--work-dir', default='tuning-data',
+                        help='Directory of the sample and its indexes, reused across runs')
+    parser.add_argument('--rebuild', action='store_true',
+                        help='Rebuild the sample and indexes even if they exist')
+    parser.add_argument('--cores', help='Cores to pin queries to, as taskset -c takes them')
+    parser.add_argument('--drop-caches', action='store_true',
+                        help='Drop the page cache before each run (requires root)')
+    parser.add_argument('--repetitions', type=int, default=3,
+                        help='Runs of each algorithm, whose median is reported')
+    args = parser.parse_args()
+    tune_command(args)
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s:%(levelname)s: %(message)s')
+    main()
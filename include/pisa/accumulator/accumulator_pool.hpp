@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace pisa {
+
+/// A thread-safe pool of accumulators for `size` documents, shared by queries running in
+/// parallel, so that there are only as many accumulators as queries running at once, each
+/// allocated once and reused afterwards.
+///
+/// An accumulator goes back to the pool as is, when the handle returned by `acquire` is
+/// destroyed, and queries clear it with `init()` as usual: accumulators that clear lazily, such
+/// as `Lazy_Accumulator`, keep their counters across queries, so that reusing one costs no pass
+/// over its memory.
+template <typename Accumulator>
+class Accumulator_Pool {
+    struct Releaser {
+        Accumulator_Pool* pool;
+        void operator()(Accumulator* accumulator) const { pool->release(accumulator); }
+    };
+
+  public:
+    using handle_type = std::unique_ptr<Accumulator, Releaser>;
+
+    explicit Accumulator_Pool(std::size_t size) : m_size(size) {}
+    Accumulator_Pool(Accumulator_Pool const&) = delete;
+    Accumulator_Pool(Accumulator_Pool&&) = delete;
+    Accumulator_Pool& operator=(Accumulator_Pool const&) = delete;
+    Accumulator_Pool& operator=(Accumulator_Pool&&) = delete;
+    ~Accumulator_Pool() = default;
+
+    /// Returns an accumulator that no other query holds, allocating one if all are taken. It
+    /// must be released, by destroying the handle, before the pool is destroyed.
+    [[nodiscard]] auto acquire() -> handle_type
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (not m_free.empty()) {
+                auto accumulator = std::move(m_free.back());
+                m_free.pop_back();
+                return handle_type(accumulator.release(), Releaser{this});
+            }
+            m_allocated += 1;
+        }
+        return handle_type(new Accumulator(m_size), Releaser{this});
+    }
+
+    /// Returns the number of accumulators allocated so far.
+    [[nodiscard]] auto allocated() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_allocated;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+
+  private:
+    void release(Accumulator* accumulator)
+    {
+        std::unique_ptr<Accumulator> owned(accumulator);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(std::move(owned));
+    }
+
+    std::size_t m_size;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Accumulator>> m_free;
+    std::size_t m_allocated = 0;
+};
+
+}  // namespace pisa
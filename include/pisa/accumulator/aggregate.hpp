@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace pisa::accumulator {
+
+/// Returns a bit mask of the `N` scores starting at `scores` that are positive and at least
+/// `threshold`, the i-th bit standing for the i-th score. Scores that are not positive would be
+/// dropped when the top-k queue is finalized, so they are never worth inserting.
+template <std::size_t N>
+[[nodiscard]] inline auto threshold_mask(float const* scores, float threshold) noexcept -> uint64_t
+{
+    static_assert(N <= 64, "one bit per score must fit in the mask");
+    uint64_t mask = 0;
+    std::size_t pos = 0;
+#if defined(__SSE2__)
+    auto const thresholds = _mm_set1_ps(threshold);
+    auto const zeros = _mm_setzero_ps();
+    for (; pos < N / 4 * 4; pos += 4) {
+        auto block = _mm_loadu_ps(scores + pos);
+        auto passing =
+            _mm_and_ps(_mm_cmpge_ps(block, thresholds), _mm_cmpgt_ps(block, zeros));
+        mask |= static_cast<uint64_t>(_mm_movemask_ps(passing)) << pos;
+    }
+#endif
+    for (; pos < N; ++pos) {
+        mask |= static_cast<uint64_t>(scores[pos] > 0 && scores[pos] >= threshold) << pos;
+    }
+    return mask;
+}
+
+/// Inserts into `topk` the score of document `first_docid + i` for every bit `i` set in `mask`.
+template <typename Topk>
+inline void insert_masked(Topk& topk, float const* scores, uint64_t first_docid, uint64_t mask)
+{
+    while (mask != 0) {
+        auto pos = __builtin_ctzll(mask);
+        topk.insert(scores[pos], first_docid + pos);
+        mask &= mask - 1;
+    }
+}
+
+/// Returns a word with the highest bit of every `Bits`-wide field of `word`, among the first
+/// `Fields`, set if and only if the field is equal to `value`. The fields are compared all at
+/// once, without carries between them.
+template <std::size_t Bits, std::size_t Fields, typename Word>
+[[nodiscard]] constexpr auto equal_fields(Word word, Word value) noexcept -> Word
+{
+    constexpr Word field = Bits == sizeof(Word) * 8 ? ~Word(0) : (Word(1) << Bits) - 1;
+    constexpr Word low_field = field >> 1U;
+    Word low = 0;
+    Word used = 0;
+    Word broadcast = 0;
+    for (std::size_t idx = 0; idx < Fields; ++idx) {
+        low |= low_field << (idx * Bits);
+        used |= field << (idx * Bits);
+        broadcast |= (value & field) << (idx * Bits);
+    }
+    Word diff = word ^ broadcast;
+    // The highest bit of a field is set in `nonzero` if any bit of the field is set in `diff`.
+    Word nonzero = ((diff & low) + low) | diff;
+    return ~(nonzero | low) & used;
+}
+
+/// Returns a mask whose i-th bit is the highest bit of the i-th `Bits`-wide field of `word`.
+template <std::size_t Bits, std::size_t Fields, typename Word>
+[[nodiscard]] constexpr auto field_positions(Word word) noexcept -> uint64_t
+{
+    static_assert(Fields <= 64, "one bit per field must fit in the mask");
+    uint64_t positions = 0;
+    for (std::size_t idx = 0; idx < Fields; ++idx) {
+        positions |= static_cast<uint64_t>((word >> (idx * Bits + Bits - 1)) & 1U) << idx;
+    }
+    return positions;
+}
+
+}  // namespace pisa::accumulator
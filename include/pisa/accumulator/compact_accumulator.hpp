@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "accumulator/aggregate.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+namespace accumulator {
+
+    /// A 16-bit accumulator holding a bfloat16: the upper half of a float, rounded to nearest
+    /// even. It keeps the range of a float but only 8 bits of precision, so sums are approximate,
+    /// within a relative error of about 2^-9 per accumulated score.
+    struct bfloat16_cell {
+        [[nodiscard]] static auto decode(uint16_t cell) noexcept -> float
+        {
+            uint32_t bits = static_cast<uint32_t>(cell) << 16U;
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        [[nodiscard]] static auto add(uint16_t cell, float score) noexcept -> uint16_t
+        {
+            float sum = decode(cell) + score;
+            uint32_t bits;
+            std::memcpy(&bits, &sum, sizeof(bits));
+            bits += 0x7FFFU + ((bits >> 16U) & 1U);
+            return static_cast<uint16_t>(bits >> 16U);
+        }
+
+        /// Decodes the 8 cells starting at `cells`, all at once where SSE2 is available.
+        static void decode8(uint16_t const* cells, float* out) noexcept
+        {
+#if defined(__SSE2__)
+            auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(cells));
+            auto zeros = _mm_setzero_si128();
+            _mm_storeu_ps(out, _mm_castsi128_ps(_mm_unpacklo_epi16(zeros, block)));
+            _mm_storeu_ps(out + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zeros, block)));
+#else
+            for (std::size_t pos = 0; pos < 8; ++pos) {
+                out[pos] = decode(cells[pos]);
+            }
+#endif
+        }
+    };
+
+    /// A 16-bit accumulator holding an integer sum, exact for quantized scores as long as a
+    /// document sums to at most 65535, e.g., 257 terms of 8-bit scores; larger sums saturate.
+    struct quantized_cell {
+        [[nodiscard]] static auto decode(uint16_t cell) noexcept -> float
+        {
+            return static_cast<float>(cell);
+        }
+
+        [[nodiscard]] static auto add(uint16_t cell, float score) noexcept -> uint16_t
+        {
+            auto sum = static_cast<uint32_t>(cell) + static_cast<uint32_t>(score);
+            return static_cast<uint16_t>(std::min<uint32_t>(sum, 0xFFFFU));
+        }
+
+        /// Decodes the 8 cells starting at `cells`, all at once where SSE2 is available.
+        static void decode8(uint16_t const* cells, float* out) noexcept
+        {
+#if defined(__SSE2__)
+            auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(cells));
+            auto zeros = _mm_setzero_si128();
+            _mm_storeu_ps(out, _mm_cvtepi32_ps(_mm_unpacklo_epi16(block, zeros)));
+            _mm_storeu_ps(out + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(block, zeros)));
+#else
+            for (std::size_t pos = 0; pos < 8; ++pos) {
+                out[pos] = decode(cells[pos]);
+            }
+#endif
+        }
+    };
+
+}  // namespace accumulator
+
+/// An accumulator like `Simple_Accumulator`, but with 16-bit cells of type `Cell`, which halves
+/// its memory, and thus the memory of each thread running TAAT queries on a large collection,
+/// and doubles the documents that fit in the cache. Cells are widened to floats a chunk at a
+/// time during aggregation, before being compared with the threshold.
+template <typename Cell>
+struct Compact_Accumulator: public std::vector<uint16_t> {
+    Compact_Accumulator(std::ptrdiff_t size) : std::vector<uint16_t>(size) {}
+    void init() { std::fill(begin(), end(), 0); }
+    void accumulate(uint32_t doc, float score)
+    {
+        auto& cell = operator[](doc);
+        cell = Cell::add(cell, score);
+    }
+    /// Inserts the accumulated scores into `topk`, with the documents numbered from `first_docid`,
+    /// comparing them with the threshold in chunks of `aggregate_chunk`.
+    void aggregate(topk_queue& topk, uint64_t first_docid = 0)
+    {
+        constexpr std::size_t aggregate_chunk = 16;
+        float scores[aggregate_chunk];
+        std::size_t pos = 0U;
+        for (; pos + aggregate_chunk <= size(); pos += aggregate_chunk) {
+            for (std::size_t part = 0; part < aggregate_chunk; part += 8) {
+                Cell::decode8(data() + pos + part, scores + part);
+            }
+            auto passing = accumulator::threshold_mask<aggregate_chunk>(scores, topk.threshold());
+            accumulator::insert_masked(topk, scores, first_docid + pos, passing);
+        }
+        for (; pos < size(); ++pos) {
+            auto score = Cell::decode(operator[](pos));
+            if (score > 0 && topk.would_enter(score)) {
+                topk.insert(score, first_docid + pos);
+            }
+        }
+    }
+};
+
+/// Accumulates approximate float scores in half the memory of `Simple_Accumulator`.
+using Bfloat16_Accumulator = Compact_Accumulator<accumulator::bfloat16_cell>;
+
+/// Accumulates exact quantized scores in half the memory of `Simple_Accumulator`.
+using Quantized_Accumulator = Compact_Accumulator<accumulator::quantized_cell>;
+
+}  // namespace pisa
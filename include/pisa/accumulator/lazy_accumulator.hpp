@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <vector>
 
+#include "accumulator/aggregate.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
@@ -70,18 +71,25 @@ struct Lazy_Accumulator {
         m_accumulators[block].accumulators[pos_in_block] += score;
     }
 
-    void aggregate(topk_queue& topk)
+    /// Inserts the accumulated scores into `topk`, with the documents numbered from `first_docid`,
+    /// e.g., when the accumulator covers a window of the collection. All counters of a block are compared with the
+    /// current one at once, so blocks untouched by the query are skipped, and the scores of the
+    /// others are compared with the threshold four at a time.
+    void aggregate(topk_queue& topk, uint64_t first_docid = 0)
     {
-        uint64_t docid = 0u;
+        uint64_t docid = first_docid;
         for (auto const& block: m_accumulators) {
-            int pos = 0;
-            for (auto const& score: block.accumulators) {
-                if (block.counter(pos++) == m_counter && topk.would_enter(score)) {
-                    topk.insert(score, docid);
-                }
-                ++docid;
+            auto current = accumulator::equal_fields<counter_bit_size, counters_in_descriptor>(
+                block.descriptor, static_cast<Descriptor>(m_counter));
+            if (current != 0) {
+                auto passing = accumulator::threshold_mask<counters_in_descriptor>(
+                    block.accumulators.data(), topk.threshold());
+                passing &= accumulator::field_positions<counter_bit_size, counters_in_descriptor>(
+                    current);
+                accumulator::insert_masked(topk, block.accumulators.data(), docid, passing);
             }
-        };
+            docid += counters_in_descriptor;
+        }
         m_counter = (m_counter + 1) % cycle;
     }
 
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <vector>
 
+#include "accumulator/aggregate.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
@@ -11,15 +12,23 @@ struct Simple_Accumulator: public std::vector<float> {
     Simple_Accumulator(std::ptrdiff_t size) : std::vector<float>(size) {}
     void init() { std::fill(begin(), end(), 0.0); }
     void accumulate(uint32_t doc, float score) { operator[](doc) += score; }
-    void aggregate(topk_queue& topk)
+    /// Inserts the accumulated scores into `topk`, with the documents numbered from `first_docid`,
+    /// comparing them with the threshold in chunks of `aggregate_chunk`.
+    void aggregate(topk_queue& topk, uint64_t first_docid = 0)
     {
-        uint64_t docid = 0u;
-        std::for_each(begin(), end(), [&](auto score) {
-            if (topk.would_enter(score)) {
-                topk.insert(score, docid);
+        constexpr std::size_t aggregate_chunk = 16;
+        std::size_t pos = 0u;
+        for (; pos + aggregate_chunk <= size(); pos += aggregate_chunk) {
+            auto passing =
+                accumulator::threshold_mask<aggregate_chunk>(data() + pos, topk.threshold());
+            accumulator::insert_masked(topk, data() + pos, first_docid + pos, passing);
+        }
+        for (; pos < size(); ++pos) {
+            auto score = operator[](pos);
+            if (score > 0 && topk.would_enter(score)) {
+                topk.insert(score, first_docid + pos);
             }
-            docid += 1;
-        });
+        }
     }
 };
 
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <cstdint>
+#include <fstream>
 #include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
 
 #include "fmt/format.h"
@@ -10,6 +13,7 @@
 #include "spdlog/spdlog.h"
 
 #include "util/util.hpp"
+#include "util/window_advisor.hpp"
 
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
     #include <sys/mman.h>
@@ -36,12 +40,58 @@ class base_binary_collection {
         m_data_size = m_file.size() / sizeof(m_data[0]);
 
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
-        // Indicates that the application expects to access this address range in a sequential
-        // manner
-        auto ret = posix_madvise((void*)m_data, m_data_size, POSIX_MADV_SEQUENTIAL);
-        if (ret)
-            spdlog::error("Error calling madvice: {}", errno);
+        // Read-only inputs larger than memory are advised a window at a time, so that reading
+        // them does not evict everything else from memory.
+        if constexpr (std::is_same<Source, mio::mmap_source>::value) {
+            if (Window_Advisor::worth_streaming(m_file.size())) {
+                m_advisor = std::make_unique<Window_Advisor>(
+                    m_file.data(), m_file.size(), m_file.file_handle());
+            }
+        }
+        if (not m_advisor) {
+            // Indicates that the application expects to access this address range in a
+            // sequential manner
+            auto ret = posix_madvise((void*)m_data, m_file.size(), POSIX_MADV_SEQUENTIAL);
+            if (ret)
+                spdlog::error("Error calling madvice: {}", errno);
+        }
 #endif
+        map_offsets(offsets_filename(filename));
+    }
+
+    /// Returns the name of the offsets file of the collection `filename`.
+    [[nodiscard]] static auto offsets_filename(std::string const& filename) -> std::string
+    {
+        return filename + ".offsets";
+    }
+
+    /// Writes the offsets of the collection `filename`, i.e., the position, in words, of every
+    /// sequence, followed by the size of the collection, as 64-bit integers, to the file read
+    /// by the constructor when it exists, so that sequences can be accessed at random.
+    static void write_offsets(char const* filename)
+    {
+        base_binary_collection<mio::mmap_source> coll(filename);
+        std::ofstream os(offsets_filename(filename), std::ios::binary);
+        auto write = [&](uint64_t offset) {
+            os.write(reinterpret_cast<char const*>(&offset), sizeof(offset));
+        };
+        for (auto it = coll.begin(); it != coll.end(); ++it) {
+            write(it.position());
+        }
+        write(coll.end().position());
+    }
+
+    /// Whether the collection has offsets, without which sequences can only be read in order.
+    [[nodiscard]] auto has_offsets() const noexcept -> bool { return m_offsets != nullptr; }
+
+    /// Returns the number of sequences, read from the offsets if there are any, and counted
+    /// by a scan otherwise.
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        if (has_offsets()) {
+            return m_sequences;
+        }
+        return std::distance(begin(), end());
     }
 
     class sequence {
@@ -84,6 +134,22 @@ class base_binary_collection {
     const_iterator cbegin() const { return const_iterator(this, 0); }
     const_iterator cend() const { return const_iterator(this, m_data_size); }
 
+    /// Returns an iterator to sequence `idx`, e.g., the first of a range of sequences read by a
+    /// thread of a parallel scan. Requires offsets.
+    [[nodiscard]] auto iterator_at(std::size_t idx) const -> const_iterator
+    {
+        if (not has_offsets()) {
+            throw std::logic_error("Random access to a binary collection requires offsets");
+        }
+        return const_iterator(this, idx < m_sequences ? m_offsets[idx] : m_data_size);
+    }
+
+    /// Returns sequence `idx`. Requires offsets.
+    [[nodiscard]] auto operator[](std::size_t idx) const -> const_sequence
+    {
+        return *iterator_at(idx);
+    }
+
     template <typename S>
     class base_iterator: public std::iterator<std::forward_iterator_tag, S> {
       public:
@@ -109,11 +175,17 @@ class base_binary_collection {
 
         bool operator!=(base_iterator const& other) const { return !(*this == other); }
 
+        /// Returns the position, in words, of the current sequence in the collection.
+        [[nodiscard]] auto position() const noexcept -> std::size_t { return m_pos; }
+
       private:
         friend class base_binary_collection;
 
         base_iterator(base_binary_collection const* coll, size_t pos)
-            : m_data(coll->m_data), m_data_size(coll->m_data_size), m_pos(pos)
+            : m_data(coll->m_data),
+              m_data_size(coll->m_data_size),
+              m_pos(pos),
+              m_advisor(coll->m_advisor.get())
         {
             read();
         }
@@ -133,17 +205,46 @@ class base_binary_collection {
 
             m_next_pos = pos + n;
             m_cur_seq = S(begin, begin + n);
+            if (m_advisor != nullptr) {
+                m_advisor->advance(m_pos * sizeof(posting_type));
+            }
         }
 
         const pointer m_data;
         size_t m_data_size = 0, m_pos = 0, m_next_pos = 0;
+        Window_Advisor* m_advisor = nullptr;
         S m_cur_seq;
     };
 
   private:
+    /// Maps the offsets in `filename`, if it exists and matches the collection. Stale offsets,
+    /// e.g., of a collection since rewritten, are ignored with a warning.
+    void map_offsets(std::string const& filename)
+    {
+        std::error_code error;
+        m_offsets_file.map(filename, error);
+        if (error) {
+            return;
+        }
+        auto count = m_offsets_file.size() / sizeof(uint64_t);
+        auto offsets = reinterpret_cast<uint64_t const*>(m_offsets_file.data());
+        if (count == 0 || m_offsets_file.size() % sizeof(uint64_t) != 0
+            || offsets[count - 1] != m_data_size) {
+            spdlog::warn("Ignoring offsets {}, which do not match the collection", filename);
+            m_offsets_file.unmap();
+            return;
+        }
+        m_offsets = offsets;
+        m_sequences = count - 1;
+    }
+
     Source m_file;
     pointer m_data;
     size_t m_data_size;
+    std::unique_ptr<Window_Advisor> m_advisor;
+    mio::mmap_source m_offsets_file;
+    uint64_t const* m_offsets = nullptr;
+    std::size_t m_sequences = 0;
 };
 
 using binary_collection = base_binary_collection<>;
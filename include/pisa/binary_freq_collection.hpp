@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <iterator>
 #include <stdexcept>
+#include <string>
 
 #include "binary_collection.hpp"
 
@@ -31,7 +32,35 @@ class binary_freq_collection {
 
     iterator end() const { return iterator(m_docs.end(), m_freqs.end()); }
 
-    size_t size() const { return std::distance(begin(), end()); }
+    /// Returns the number of posting lists, in constant time if the collection has offsets.
+    size_t size() const
+    {
+        if (has_offsets()) {
+            return m_freqs.size();
+        }
+        return std::distance(begin(), end());
+    }
+
+    /// Whether both files have offsets, written by `write_offsets`, so that lists can be
+    /// accessed at random, e.g., to split them among threads.
+    [[nodiscard]] auto has_offsets() const noexcept -> bool
+    {
+        return m_docs.has_offsets() && m_freqs.has_offsets();
+    }
+
+    /// Writes the offsets of the `.docs` and `.freqs` files of the collection `basename`.
+    static void write_offsets(const char* basename)
+    {
+        binary_collection::write_offsets((std::string(basename) + ".docs").c_str());
+        binary_collection::write_offsets((std::string(basename) + ".freqs").c_str());
+    }
+
+    /// Returns an iterator to the list of `term`, from which a thread can read a range of
+    /// lists. Requires offsets.
+    [[nodiscard]] auto iterator_at(std::size_t term) const -> iterator
+    {
+        return iterator(m_docs.iterator_at(term + 1), m_freqs.iterator_at(term));
+    }
 
     uint64_t num_docs() const { return m_num_docs; }
 
@@ -40,6 +69,12 @@ class binary_freq_collection {
         binary_collection::const_sequence freqs;
     };
 
+    /// Returns the list of `term`. Requires offsets.
+    [[nodiscard]] auto operator[](std::size_t term) const -> sequence
+    {
+        return sequence{m_docs[term + 1], m_freqs[term]};
+    }
+
     class iterator: public std::iterator<std::forward_iterator_tag, sequence> {
       public:
         iterator() {}
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
+#include <gsl/span>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 #include "util/broadword.hpp"
+#include "util/compiler_attribute.hpp"
+#include "util/likely.hpp"
 #include "util/util.hpp"
 
 #include "mappable/mappable_vector.hpp"
@@ -115,28 +121,67 @@ class bit_vector_builder {
         }
     }
 
+    /// Sets `len` bits at `pos` known to be zero, e.g., in a region just zero-extended, which
+    /// saves clearing them first as `set_bits` does.
+    inline void or_bits(uint64_t pos, uint64_t bits, size_t len)
+    {
+        assert(pos + len <= size());
+        assert(len == 64 || (bits >> len) == 0);
+        if (!len)
+            return;
+        uint64_t word = pos / 64;
+        uint64_t pos_in_word = pos % 64;
+        m_bits[word] |= bits << pos_in_word;
+        uint64_t stored = 64 - pos_in_word;
+        if (stored < len) {
+            m_bits[word + 1] |= bits >> stored;
+        }
+    }
+
     void append(bit_vector_builder const& rhs)
     {
         if (!rhs.size())
             return;
 
-        uint64_t pos = m_bits.size();
-        uint64_t shift = size() % 64;
+        uint64_t pos = size();
         m_size = size() + rhs.size();
         m_bits.resize(detail::words_for(m_size));
+        m_bits[pos / 64] |= rhs.m_bits.front() << (pos % 64);
+        shift_words(rhs.m_bits.data(), rhs.m_bits.size(), pos, 1, words_spanned(pos, rhs.size()));
+        m_cur_word = &m_bits.back();
+    }
 
-        if (shift == 0) {  // word-aligned, easy case
-            std::copy(rhs.m_bits.begin(), rhs.m_bits.end(), m_bits.begin() + ptrdiff_t(pos));
-        } else {
-            uint64_t* cur_word = &m_bits.front() + pos - 1;
-            for (size_t i = 0; i < rhs.m_bits.size() - 1; ++i) {
-                uint64_t w = rhs.m_bits[i];
-                *cur_word |= w << shift;
-                *++cur_word = w >> (64 - shift);
+    /// Appends all of `parts`, in order. Parts are shifted into place in parallel, each over
+    /// ranges of its words; only the first word of each part, which it may share with the parts
+    /// before it, is merged serially.
+    void append_all(gsl::span<bit_vector_builder const* const> parts)
+    {
+        std::vector<uint64_t> offsets;
+        offsets.reserve(parts.size());
+        uint64_t end = size();
+        for (auto const* part: parts) {
+            offsets.push_back(end);
+            end += part->size();
+        }
+        if (end == size()) {
+            return;
+        }
+        m_bits.resize(detail::words_for(end));
+        m_size = end;
+        // Words after the first one of a part receive bits of that part alone.
+        tbb::parallel_for(std::size_t(0), parts.size(), [&](std::size_t idx) {
+            auto const& words = parts[idx]->m_bits;
+            if (parts[idx]->size() == 0) {
+                return;
             }
-            *cur_word |= rhs.m_bits.back() << shift;
-            if (cur_word < &m_bits.back()) {
-                *++cur_word = rhs.m_bits.back() >> (64 - shift);
+            auto spanned = words_spanned(offsets[idx], parts[idx]->size());
+            tbb::parallel_for(tbb::blocked_range<uint64_t>(1, spanned), [&](auto const& range) {
+                shift_words(words.data(), words.size(), offsets[idx], range.begin(), range.end());
+            });
+        });
+        for (std::size_t idx = 0; idx < parts.size(); ++idx) {
+            if (parts[idx]->size() > 0) {
+                m_bits[offsets[idx] / 64] |= parts[idx]->m_bits.front() << (offsets[idx] % 64);
             }
         }
         m_cur_word = &m_bits.back();
@@ -178,6 +223,33 @@ class bit_vector_builder {
     }
 
   private:
+    /// Returns the number of words that `len` bits starting at bit `pos` overlap.
+    static uint64_t words_spanned(uint64_t pos, uint64_t len)
+    {
+        return (pos + len - 1) / 64 - pos / 64 + 1;
+    }
+
+    /// Writes the words `[begin, end)`, counted from the word containing bit `pos`, of the
+    /// `n` words `src` placed at bit `pos`. Word 0, which may hold earlier bits, is left to the
+    /// caller. The loop is free of branches, so that compilers turn it into vector funnel shifts.
+    void shift_words(uint64_t const* src, uint64_t n, uint64_t pos, uint64_t begin, uint64_t end)
+    {
+        uint64_t* dst = m_bits.data() + pos / 64;
+        uint64_t shift = pos % 64;
+        if (shift == 0) {
+            std::copy(src + begin, src + end, dst + begin);
+            return;
+        }
+        // the last word may only hold the high bits of the last source word
+        uint64_t full_end = std::min(end, n);
+        for (uint64_t i = begin; i < full_end; ++i) {
+            dst[i] = (src[i - 1] >> (64 - shift)) | (src[i] << shift);
+        }
+        if (full_end < end) {
+            dst[n] = src[n - 1] >> (64 - shift);
+        }
+    }
+
     bits_type m_bits;
     uint64_t m_size;
     uint64_t* m_cur_word;
@@ -419,11 +491,12 @@ class bit_vector {
     };
 
     struct unary_enumerator {
-        unary_enumerator() : m_data(0), m_position(0), m_buf(0) {}
+        unary_enumerator() : m_data(0), m_end(0), m_position(0), m_buf(0) {}
 
         unary_enumerator(bit_vector const& bv, uint64_t pos)
         {
             m_data = bv.data().data();
+            m_end = m_data + bv.data().size();
             m_position = pos;
             m_buf = m_data[pos / 64];
             // clear low bits
@@ -449,16 +522,8 @@ class bit_vector {
         // skip to the k-th one after the current position
         void skip(uint64_t k)
         {
-            uint64_t skipped = 0;
-            uint64_t buf = m_buf;
-            uint64_t w = 0;
-            while (skipped + (w = broadword::popcount(buf)) <= k) {
-                skipped += w;
-                m_position += 64;
-                buf = m_data[m_position / 64];
-            }
-            assert(buf);
-            uint64_t pos_in_word = broadword::select_in_word(buf, k - skipped);
+            uint64_t buf = find_word<false>(m_position, m_buf, k);
+            uint64_t pos_in_word = broadword::select_in_word(buf, k);
             m_buf = buf & (uint64_t(-1) << pos_in_word);
             m_position = (m_position & ~uint64_t(63)) + pos_in_word;
         }
@@ -467,40 +532,86 @@ class bit_vector {
         uint64_t skip_no_move(uint64_t k)
         {
             uint64_t position = m_position;
-            uint64_t skipped = 0;
-            uint64_t buf = m_buf;
-            uint64_t w = 0;
-            while (skipped + (w = broadword::popcount(buf)) <= k) {
-                skipped += w;
-                position += 64;
-                buf = m_data[position / 64];
-            }
-            assert(buf);
-            uint64_t pos_in_word = broadword::select_in_word(buf, k - skipped);
-            position = (position & ~uint64_t(63)) + pos_in_word;
-            return position;
+            uint64_t buf = find_word<false>(position, m_buf, k);
+            uint64_t pos_in_word = broadword::select_in_word(buf, k);
+            return (position & ~uint64_t(63)) + pos_in_word;
         }
 
         // skip to the k-th zero after the current position
         void skip0(uint64_t k)
         {
-            uint64_t skipped = 0;
-            uint64_t pos_in_word = m_position % 64;
-            uint64_t buf = ~m_buf & (uint64_t(-1) << pos_in_word);
-            uint64_t w = 0;
-            while (skipped + (w = broadword::popcount(buf)) <= k) {
-                skipped += w;
-                m_position += 64;
-                buf = ~m_data[m_position / 64];
-            }
-            assert(buf);
-            pos_in_word = broadword::select_in_word(buf, k - skipped);
+            uint64_t buf = ~m_buf & (uint64_t(-1) << (m_position % 64));
+            buf = find_word<true>(m_position, buf, k);
+            uint64_t pos_in_word = broadword::select_in_word(buf, k);
             m_buf = ~buf & (uint64_t(-1) << pos_in_word);
             m_position = (m_position & ~uint64_t(63)) + pos_in_word;
         }
 
       private:
+        /// Moves `position` to the word holding the `k`-th one after it, or zero if `Zeros`,
+        /// given the current word `buf` with the bits before `position` cleared (and
+        /// complemented if `Zeros`). Returns that word, complemented if `Zeros`, and leaves
+        /// in `k` the rank of the bit within it.
+        ///
+        /// Long skips go over the words between 4 at a time, adding up their bits at once.
+        template <bool Zeros>
+        PISA_ALWAYSINLINE uint64_t find_word(uint64_t& position, uint64_t buf, uint64_t& k) const
+        {
+            uint64_t w = broadword::popcount(buf);
+            if (PISA_LIKELY(w > k)) {
+                return buf;
+            }
+            k -= w;
+            position += 64;
+            for (uint64_t const* block = m_data + position / 64; block + 4 <= m_end; block += 4) {
+                w = block_popcount(block);
+                if constexpr (Zeros) {
+                    w = 256 - w;
+                }
+                if (w > k) {
+                    break;
+                }
+                k -= w;
+                position += 256;
+            }
+            while (true) {
+                buf = Zeros ? ~m_data[position / 64] : m_data[position / 64];
+                w = broadword::popcount(buf);
+                if (w > k) {
+                    assert(buf);
+                    return buf;
+                }
+                k -= w;
+                position += 64;
+            }
+        }
+
+        /// Returns the number of ones in the 4 words starting at `block`.
+        static PISA_ALWAYSINLINE uint64_t block_popcount(uint64_t const* block)
+        {
+#if defined(__AVX2__)
+            // popcount of every nibble by table lookup, summed up by the byte and then by word
+            __m256i const lookup = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            __m256i const low_nibbles = _mm256_set1_epi8(0x0f);
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(block));
+            __m256i counts = _mm256_add_epi8(
+                _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_nibbles)),
+                _mm256_shuffle_epi8(
+                    lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles)));
+            __m256i sums = _mm256_sad_epu8(counts, _mm256_setzero_si256());
+            __m128i sum = _mm_add_epi64(
+                _mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            return _mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1);
+#else
+            return broadword::popcount(block[0]) + broadword::popcount(block[1])
+                + broadword::popcount(block[2]) + broadword::popcount(block[3]);
+#endif
+        }
+
         uint64_t const* m_data;
+        uint64_t const* m_end;
         uint64_t m_position;
         uint64_t m_buf;
     };
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <array>
+#include <cassert>
+#include <vector>
+
+#include <gsl/span>
+
 #include "bit_vector.hpp"
 
 #include "codec/compact_elias_fano.hpp"
@@ -20,6 +26,36 @@ class bitvector_collection {
             m_endpoints.push_back(m_bitvectors.size());
         }
 
+        /// Appends a batch of bitvectors encoded back to back into `bits`, where `endpoints`
+        /// holds the end of each of them relative to the start of `bits`.
+        void append_batch(bit_vector_builder const& bits, gsl::span<uint64_t const> endpoints)
+        {
+            auto base = m_bitvectors.size();
+            std::array<bit_vector_builder const*, 1> parts{&bits};
+            m_bitvectors.append_all(parts);
+            for (auto endpoint: endpoints) {
+                m_endpoints.push_back(base + endpoint);
+            }
+        }
+
+        /// Appends batches of bitvectors in order, such as batches encoded by different
+        /// threads, with `endpoints[i]` those of `bits[i]` as for `append_batch`. The bits of all
+        /// the batches are concatenated at once, shifted into place in parallel.
+        void append_batches(
+            gsl::span<bit_vector_builder const* const> bits,
+            gsl::span<std::vector<uint64_t> const> endpoints)
+        {
+            assert(bits.size() == endpoints.size());
+            auto base = m_bitvectors.size();
+            m_bitvectors.append_all(bits);
+            for (std::size_t batch = 0; batch < bits.size(); ++batch) {
+                for (auto endpoint: endpoints[batch]) {
+                    m_endpoints.push_back(base + endpoint);
+                }
+                base += bits[batch]->size();
+            }
+        }
+
         void build(bitvector_collection& sq)
         {
             sq.m_size = m_endpoints.size() - 1;
@@ -1,26 +1,43 @@
 #pragma once
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
 #include "bit_vector.hpp"
 #include "mappable/mappable_vector.hpp"
+#include "mappable/warmup.hpp"
 
 #include "block_posting_list.hpp"
 #include "codec/compact_elias_fano.hpp"
+#include "decoded_block_cache.hpp"
+#include "util/semiasync_queue.hpp"
 
 namespace pisa {
 
-template <typename BlockCodec, bool Profile = false>
+template <typename BlockCodec, bool Profile = false, bool BlockMaxFreqs = false>
 class block_freq_index {
+    using posting_list_type = block_posting_list<BlockCodec, Profile, BlockMaxFreqs>;
+
   public:
+    static constexpr uint64_t block_size = BlockCodec::block_size;
+
     block_freq_index() : m_size(0) {}
 
     class builder {
       public:
-        builder(uint64_t num_docs, global_parameters const& params) : m_params(params)
+        builder(uint64_t num_docs, global_parameters const& params)
+            : m_queue(1 << 22), m_params(params)
         {
             m_num_docs = num_docs;
             m_endpoints.push_back(0);
         }
 
+        /// Encodes the posting list in a background thread. Lists are encoded concurrently
+        /// but appended in the order they are added. The postings are copied, so the
+        /// iterators need not outlive the call.
         template <typename DocsIterator, typename FreqsIterator>
         void add_posting_list(
             uint64_t n,
@@ -30,8 +47,11 @@ class block_freq_index {
         {
             if (!n)
                 throw std::invalid_argument("List must be nonempty");
-            block_posting_list<BlockCodec, Profile>::write(m_lists, n, docs_begin, freqs_begin);
-            m_endpoints.push_back(m_lists.size());
+            std::shared_ptr<list_adder> ptr(new list_adder(
+                *this,
+                std::vector<uint32_t>(docs_begin, std::next(docs_begin, n)),
+                std::vector<uint32_t>(freqs_begin, std::next(freqs_begin, n))));
+            m_queue.add_job(ptr, n);
         }
 
         template <typename BlockDataRange>
@@ -39,19 +59,22 @@ class block_freq_index {
         {
             if (!n)
                 throw std::invalid_argument("List must be nonempty");
-            block_posting_list<BlockCodec>::write_blocks(m_lists, n, blocks);
+            m_queue.complete();
+            posting_list_type::write_blocks(m_lists, n, blocks);
             m_endpoints.push_back(m_lists.size());
         }
 
         template <typename BytesRange>
         void add_posting_list(BytesRange const& data)
         {
+            m_queue.complete();
             m_lists.insert(m_lists.end(), std::begin(data), std::end(data));
             m_endpoints.push_back(m_lists.size());
         }
 
         void build(block_freq_index& sq)
         {
+            m_queue.complete();
             sq.m_params = m_params;
             sq.m_size = m_endpoints.size() - 1;
             sq.m_num_docs = m_num_docs;
@@ -67,7 +90,53 @@ class block_freq_index {
             bit_vector(&bvb).swap(sq.m_endpoints);
         }
 
+        /// Builds the index with the list added `s`-th being the list of term `slot_terms[s]`,
+        /// so that lists are stored in the order they were added rather than in term order.
+        void build(block_freq_index& sq, std::vector<uint32_t> const& slot_terms)
+        {
+            build(sq);
+            if (slot_terms.size() != sq.m_size) {
+                throw std::invalid_argument("Every list must be assigned a term");
+            }
+            std::vector<uint32_t> term_slots(sq.m_size, sq.m_size);
+            for (uint32_t slot = 0; slot < slot_terms.size(); ++slot) {
+                auto term = slot_terms[slot];
+                if (term >= sq.m_size || term_slots[term] != sq.m_size) {
+                    throw std::invalid_argument("Lists must be assigned distinct terms");
+                }
+                term_slots[term] = slot;
+            }
+            sq.m_term_slots.steal(term_slots);
+        }
+
       private:
+        struct list_adder: semiasync_queue::job {
+            list_adder(builder& b, std::vector<uint32_t> docs, std::vector<uint32_t> freqs)
+                : b(b), docs(std::move(docs)), freqs(std::move(freqs))
+            {}
+
+            void prepare() override
+            {
+                posting_list_type::write(data, docs.size(), docs.begin(), freqs.begin());
+                docs.clear();
+                docs.shrink_to_fit();
+                freqs.clear();
+                freqs.shrink_to_fit();
+            }
+
+            void commit() override
+            {
+                b.m_lists.insert(b.m_lists.end(), data.begin(), data.end());
+                b.m_endpoints.push_back(b.m_lists.size());
+            }
+
+            builder& b;
+            std::vector<uint32_t> docs;
+            std::vector<uint32_t> freqs;
+            std::vector<uint8_t> data;
+        };
+
+        semiasync_queue m_queue;
         global_parameters m_params;
         size_t m_num_docs;
         std::vector<uint64_t> m_endpoints;
@@ -78,55 +147,234 @@ class block_freq_index {
 
     uint64_t num_docs() const { return m_num_docs; }
 
-    typedef typename block_posting_list<BlockCodec, Profile>::document_enumerator document_enumerator;
+    typedef typename posting_list_type::document_enumerator document_enumerator;
+    using wand_data_enumerator = typename posting_list_type::block_max_enumerator;
 
     document_enumerator operator[](size_t i) const
     {
-        assert(i < size());
-        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        return document_enumerator(list_data(i), num_docs(), i, cached_blocks(i));
+    }
+
+    /// Returns the block maximum frequencies of the i-th posting list, which are its block-max
+    /// scores if the index stores quantized scores.
+    [[nodiscard]] auto getenum(size_t i) const -> wand_data_enumerator
+    {
+        return wand_data_enumerator(list_data(i));
+    }
 
-        auto endpoint = endpoints.move(i).second;
-        return document_enumerator(m_lists.data() + endpoint, num_docs(), i);
+    /// Returns the maximum frequency of the i-th posting list.
+    [[nodiscard]] auto max_term_weight(size_t i) const -> float
+    {
+        return wand_data_enumerator(list_data(i)).max_freq();
     }
 
     void warmup(size_t i) const
     {
-        assert(i < size());
+        auto [begin, end] = list_range(i);
+        mapper::warmup_memory(m_lists.data() + begin, end - begin);
+    }
+
+    /// Returns the byte range `[begin, end)` of the i-th posting list in `lists_data()`.
+    [[nodiscard]] auto list_range(size_t i) const -> std::pair<size_t, size_t>
+    {
+        auto slot = list_slot(i);
+        if (not m_decoded_endpoints.empty()) {
+            return {m_decoded_endpoints[slot], m_decoded_endpoints[slot + 1]};
+        }
         compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
 
-        auto begin = endpoints.move(i).second;
+        auto begin = endpoints.move(slot).second;
         auto end = m_lists.size();
-        if (i + 1 != size()) {
-            end = endpoints.move(i + 1).second;
+        if (slot + 1 != size()) {
+            end = endpoints.move(slot + 1).second;
+        }
+        return {begin, end};
+    }
+
+    /// Returns the byte ranges of the posting lists of `terms`, in the same order, as
+    /// `list_range` would, but reading the endpoints in a single forward pass, in the order of
+    /// the lists, with one enumerator rather than one per list.
+    [[nodiscard]] auto list_ranges(gsl::span<uint32_t const> terms) const
+        -> std::vector<std::pair<size_t, size_t>>
+    {
+        std::vector<std::pair<size_t, size_t>> ranges(terms.size());
+        if (not m_decoded_endpoints.empty()) {
+            std::transform(terms.begin(), terms.end(), ranges.begin(), [&](auto term) {
+                auto slot = list_slot(term);
+                return std::make_pair(m_decoded_endpoints[slot], m_decoded_endpoints[slot + 1]);
+            });
+            return ranges;
+        }
+        std::vector<std::pair<size_t, size_t>> slots(terms.size());
+        for (size_t idx = 0; idx < terms.size(); ++idx) {
+            slots[idx] = {list_slot(terms[idx]), idx};
+        }
+        std::sort(slots.begin(), slots.end());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        std::pair<size_t, size_t> range;
+        size_t resolved = size();
+        for (auto [slot, idx]: slots) {
+            if (slot != resolved) {
+                range.first = endpoints.move(slot).second;
+                range.second =
+                    slot + 1 == size() ? m_lists.size() : endpoints.move(slot + 1).second;
+                resolved = slot;
+            }
+            ranges[idx] = range;
+        }
+        return ranges;
+    }
+
+    /// Returns enumerators over the posting lists of `terms`, in the same order, resolving
+    /// their positions with `list_ranges`, e.g., to open all lists of a query or a batch.
+    [[nodiscard]] auto lists(gsl::span<uint32_t const> terms) const
+        -> std::vector<document_enumerator>
+    {
+        auto ranges = list_ranges(terms);
+        std::vector<document_enumerator> enumerators;
+        enumerators.reserve(terms.size());
+        for (size_t idx = 0; idx < terms.size(); ++idx) {
+            enumerators.emplace_back(
+                m_lists.data() + ranges[idx].first,
+                num_docs(),
+                terms[idx],
+                cached_blocks(terms[idx]));
         }
+        return enumerators;
+    }
 
-        volatile uint32_t tmp;
-        for (size_t i = begin; i != end; ++i) {
-            tmp = m_lists[i];
+    /// Decodes the endpoints of all posting lists into an array of 8 bytes per list, kept in
+    /// memory alongside the mapped index, so that opening a list reads one array entry rather
+    /// than moving an Elias-Fano enumerator. This saves time when opening lists dominates,
+    /// e.g., for short queries over short lists, at the cost of the memory of the array.
+    void decode_endpoints()
+    {
+        std::vector<uint64_t> decoded(m_size + 1);
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        for (size_t slot = 0; slot < m_size; ++slot) {
+            decoded[slot] = endpoints.move(slot).second;
         }
-        (void)tmp;
+        decoded[m_size] = m_lists.size();
+        m_decoded_endpoints = std::move(decoded);
     }
 
+    /// Copies the index into `out` with the lists of `hot_terms` stored first, in that order,
+    /// and the other lists after them, in term order. Terms out of range and repeated terms
+    /// are skipped. With the terms of a query log, most frequent first, the lists its queries
+    /// read are contiguous, and stay resident together under memory pressure.
+    void lay_out(std::vector<uint32_t> const& hot_terms, block_freq_index& out) const
+    {
+        std::vector<uint32_t> slot_terms;
+        slot_terms.reserve(size());
+        std::vector<bool> placed(size(), false);
+        for (auto term: hot_terms) {
+            if (term < size() && not placed[term]) {
+                slot_terms.push_back(term);
+                placed[term] = true;
+            }
+        }
+        for (uint32_t term = 0; term < size(); ++term) {
+            if (not placed[term]) {
+                slot_terms.push_back(term);
+            }
+        }
+
+        builder b(m_num_docs, m_params);
+        for (auto term: slot_terms) {
+            auto [begin, end] = list_range(term);
+            b.add_posting_list(gsl::make_span(m_lists.data() + begin, end - begin));
+        }
+        b.build(out, slot_terms);
+    }
+
+    /// Returns the bytes of all posting lists.
+    [[nodiscard]] auto lists_data() const -> uint8_t const* { return m_lists.data(); }
+
+    /// Returns an enumerator over the i-th posting list, read from `data`, a copy of its bytes
+    /// that must outlive the enumerator.
+    [[nodiscard]] auto enumerator(size_t i, uint8_t const* data) const -> document_enumerator
+    {
+        return document_enumerator(data, num_docs(), i, cached_blocks(i));
+    }
+
+    /// Makes the lists opened from now on read the blocks admitted to `cache` from it, or no
+    /// longer use a cache if `nullptr`. The cache must outlive the enumerators of the lists.
+    void set_decoded_block_cache(decoded_block_cache* cache) { m_block_cache = cache; }
+
     void swap(block_freq_index& other)
     {
         std::swap(m_params, other.m_params);
         std::swap(m_size, other.m_size);
         m_endpoints.swap(other.m_endpoints);
         m_lists.swap(other.m_lists);
+        m_term_slots.swap(other.m_term_slots);
+        m_decoded_endpoints.swap(other.m_decoded_endpoints);
+        std::swap(m_block_cache, other.m_block_cache);
     }
 
     template <typename Visitor>
     void map(Visitor& visit)
     {
         visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
-            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+            m_endpoints, "m_endpoints")(m_lists, "m_lists")(m_term_slots, "m_term_slots");
     }
 
   private:
+    /// Returns the position of the i-th posting list in `m_lists`.
+    [[nodiscard]] auto list_slot(size_t i) const -> size_t
+    {
+        assert(i < size());
+        return m_term_slots.empty() ? i : m_term_slots[i];
+    }
+
+    [[nodiscard]] auto cached_blocks(size_t i) const -> decoded_block_cache::term_slots
+    {
+        return m_block_cache != nullptr ? m_block_cache->slots(static_cast<uint32_t>(i))
+                                        : decoded_block_cache::term_slots{};
+    }
+
+    [[nodiscard]] auto list_data(size_t i) const -> uint8_t const*
+    {
+        if (not m_decoded_endpoints.empty()) {
+            return m_lists.data() + m_decoded_endpoints[list_slot(i)];
+        }
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        return m_lists.data() + endpoints.move(list_slot(i)).second;
+    }
+
     global_parameters m_params;
     size_t m_size;
     size_t m_num_docs;
     bit_vector m_endpoints;
     mapper::mappable_vector<uint8_t> m_lists;
+    /// Position of the list of every term in `m_lists`, empty if lists are in term order.
+    mapper::mappable_vector<uint32_t> m_term_slots;
+    /// The endpoints of the lists in `m_lists`, followed by its size, if decoded by
+    /// `decode_endpoints`; not part of the mapped index.
+    std::vector<uint64_t> m_decoded_endpoints;
+    /// Cache of decoded blocks shared with other indexes and threads, if set.
+    decoded_block_cache* m_block_cache = nullptr;
+};
+
+/// An index of quantized scores storing the block-max scores in the posting list headers.
+template <typename BlockCodec, bool Profile, typename WandType>
+[[nodiscard]] auto
+block_max_data(block_freq_index<BlockCodec, Profile, true> const& index, WandType const&)
+    -> block_freq_index<BlockCodec, Profile, true> const&
+{
+    return index;
+}
+
+/// The type of an index whose lists count the blocks they decode with `block_profiler`, and
+/// report them to `query_tracer`; other indexes are left as they are.
+template <typename IndexType>
+struct add_profiling {
+    using type = IndexType;
+};
+
+template <typename BlockCodec, bool BlockMaxFreqs>
+struct add_profiling<block_freq_index<BlockCodec, false, BlockMaxFreqs>> {
+    using type = block_freq_index<BlockCodec, true, BlockMaxFreqs>;
 };
+
 }  // namespace pisa
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "block_freq_index.hpp"
+
+namespace pisa {
+
+namespace detail {
+
+    /// A block of a merged posting list, either copied from an input list or re-encoded.
+    template <typename BlockData>
+    struct merged_block {
+        uint32_t index;
+        uint32_t max;
+        BlockData const* source;
+        std::vector<uint8_t> docs;
+        std::vector<uint8_t> freqs;
+
+        void append_docs_block(std::vector<uint8_t>& out) const
+        {
+            if (source != nullptr) {
+                source->append_docs_block(out);
+            } else {
+                out.insert(out.end(), docs.begin(), docs.end());
+            }
+        }
+
+        void append_freqs_block(std::vector<uint8_t>& out) const
+        {
+            if (source != nullptr) {
+                source->append_freqs_block(out);
+            } else {
+                out.insert(out.end(), freqs.begin(), freqs.end());
+            }
+        }
+    };
+
+    /// Merges one posting list of two block indexes, shifting the documents of `second` by
+    /// `docid_offset`.
+    template <typename BlockCodec, typename Enumerator>
+    class block_list_merger {
+      public:
+        using block_data = typename Enumerator::block_data;
+        using block_type = merged_block<block_data>;
+        static constexpr uint64_t block_size = BlockCodec::block_size;
+
+        /// Appends the blocks of a list of the first index. Full blocks are copied as they are,
+        /// and a trailing partial block is decoded so that it can be filled with postings of
+        /// the second list.
+        void add_first(Enumerator list)
+        {
+            m_first_blocks = list.get_blocks();
+            for (auto const& block: m_first_blocks) {
+                if (block.size == block_size) {
+                    copy(block, 0);
+                } else {
+                    decode(block, 0);
+                }
+            }
+        }
+
+        /// Appends the blocks of a list of the second index. When the merged list ends on a
+        /// block boundary, only the first block is re-encoded, since its first gap is relative
+        /// to the last document of the first list; the others are copied with shifted maxima.
+        /// Otherwise, all blocks are realigned and re-encoded.
+        void add_second(Enumerator list, uint32_t docid_offset)
+        {
+            m_second_blocks = list.get_blocks();
+            bool aligned = m_docs.empty();
+            for (auto const& block: m_second_blocks) {
+                if (aligned and block.index > 0) {
+                    copy(block, docid_offset);
+                } else {
+                    decode(block, docid_offset);
+                    if (aligned) {
+                        flush();
+                    }
+                }
+            }
+        }
+
+        /// Returns the merged blocks, which refer to the input lists.
+        [[nodiscard]] auto finish() -> std::vector<block_type> const&
+        {
+            flush();
+            return m_blocks;
+        }
+
+        [[nodiscard]] auto size() const -> uint64_t { return m_size + m_docs.size(); }
+
+        [[nodiscard]] auto copied_blocks() const -> uint64_t { return m_copied_blocks; }
+
+      private:
+        void copy(block_data const& block, uint32_t docid_offset)
+        {
+            m_blocks.push_back(block_type{
+                static_cast<uint32_t>(m_blocks.size()), block.max + docid_offset, &block, {}, {}});
+            m_last_doc = block.max + docid_offset;
+            m_previous_max = block.max;
+            m_size += block.size;
+            m_copied_blocks += 1;
+        }
+
+        void decode(block_data const& block, uint32_t docid_offset)
+        {
+            block.decode_doc_gaps(m_buffer);
+            auto doc = block.index > 0 ? int64_t(m_previous_max) : int64_t(-1);
+            for (auto gap: m_buffer) {
+                doc += gap + 1;
+                m_docs.push_back(static_cast<uint32_t>(doc + docid_offset));
+            }
+            block.decode_freqs(m_buffer);
+            for (auto freq: m_buffer) {
+                m_freqs.push_back(freq + 1);
+            }
+            m_previous_max = block.max;
+            while (m_docs.size() >= block_size) {
+                encode(block_size);
+            }
+        }
+
+        void flush()
+        {
+            if (not m_docs.empty()) {
+                encode(m_docs.size());
+            }
+        }
+
+        /// Encodes the first `n` pending postings into a new block.
+        void encode(uint64_t n)
+        {
+            std::vector<uint32_t> gaps(n);
+            std::vector<uint32_t> freqs(n);
+            uint32_t block_base = m_last_doc + 1;
+            for (uint64_t i = 0; i < n; ++i) {
+                gaps[i] = m_docs[i] - m_last_doc - 1;
+                m_last_doc = m_docs[i];
+                freqs[i] = m_freqs[i] - 1;
+            }
+            block_type block{static_cast<uint32_t>(m_blocks.size()), m_last_doc, nullptr, {}, {}};
+            auto gaps_universe = static_cast<uint32_t>(m_last_doc - block_base - (n - 1));
+            BlockCodec::encode(gaps.data(), gaps_universe, n, block.docs);
+            BlockCodec::encode(freqs.data(), uint32_t(-1), n, block.freqs);
+            m_blocks.push_back(std::move(block));
+            m_docs.erase(m_docs.begin(), m_docs.begin() + n);
+            m_freqs.erase(m_freqs.begin(), m_freqs.begin() + n);
+            m_size += n;
+        }
+
+        std::vector<block_data> m_first_blocks;
+        std::vector<block_data> m_second_blocks;
+        std::vector<block_type> m_blocks;
+        std::vector<uint32_t> m_docs;
+        std::vector<uint32_t> m_freqs;
+        std::vector<uint32_t> m_buffer;
+        uint32_t m_last_doc = uint32_t(-1);
+        uint32_t m_previous_max = 0;
+        uint64_t m_size = 0;
+        uint64_t m_copied_blocks = 0;
+    };
+
+}  // namespace detail
+
+struct block_index_merge_stats {
+    uint64_t copied_blocks = 0;
+    uint64_t encoded_blocks = 0;
+};
+
+/// Merges two block indexes over consecutive document ranges into `builder`, which must have
+/// been created for `first.num_docs() + second.num_docs()` documents. Documents of `second`
+/// are shifted by `first.num_docs()`, and both indexes must share the same term IDs; a term
+/// past the size of one of them is taken to have no postings in it.
+///
+/// Encoded blocks are copied wherever the block layout allows, which is every full block of
+/// the first index, and every block but the first of the second index when the list of the
+/// first index ends on a block boundary. The other blocks are decoded and encoded again.
+template <typename BlockCodec, bool Profile>
+auto merge_block_indexes(
+    block_freq_index<BlockCodec, Profile> const& first,
+    block_freq_index<BlockCodec, Profile> const& second,
+    typename block_freq_index<BlockCodec, Profile>::builder& builder) -> block_index_merge_stats
+{
+    using enumerator = typename block_freq_index<BlockCodec, Profile>::document_enumerator;
+    if (first.num_docs() + second.num_docs() > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument(fmt::format(
+            "Cannot merge indexes of {} and {} documents", first.num_docs(), second.num_docs()));
+    }
+    block_index_merge_stats stats;
+    auto size = std::max(first.size(), second.size());
+    for (uint64_t term_id = 0; term_id < size; ++term_id) {
+        detail::block_list_merger<BlockCodec, enumerator> merger;
+        if (term_id < first.size()) {
+            merger.add_first(first[term_id]);
+        }
+        if (term_id < second.size()) {
+            merger.add_second(second[term_id], static_cast<uint32_t>(first.num_docs()));
+        }
+        auto const& blocks = merger.finish();
+        builder.add_posting_list(merger.size(), blocks);
+        stats.copied_blocks += merger.copied_blocks();
+        stats.encoded_blocks += blocks.size() - merger.copied_blocks();
+    }
+    return stats;
+}
+
+}  // namespace pisa
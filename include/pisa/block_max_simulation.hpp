@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// The blocks a set of queries could not skip, as estimated by `Block_Max_Simulation`.
+struct block_max_estimate {
+    std::size_t queries = 0;
+    /// Blocks and postings of the lists of all queries.
+    std::size_t blocks = 0;
+    std::size_t postings = 0;
+    /// Blocks whose upper bound reaches the top-k threshold, and their postings.
+    std::size_t scored_blocks = 0;
+    std::size_t scored_postings = 0;
+
+    block_max_estimate& operator+=(block_max_estimate const& other)
+    {
+        queries += other.queries;
+        blocks += other.blocks;
+        postings += other.postings;
+        scored_blocks += other.scored_blocks;
+        scored_postings += other.scored_postings;
+        return *this;
+    }
+};
+
+/// Estimates how many blocks `block_max_wand_query` scores for queries over a document ordering
+/// of a collection, without building an index or WAND data: the BM25 block maxima of the lists
+/// of each query are computed on the fly from the collection, in fixed blocks.
+///
+/// Each query is first scored exhaustively for its final top-k threshold, which does not depend
+/// on the ordering. The documents of its lists are then split into the intervals between the
+/// last documents of their blocks, and a block is counted as scored if the sum of the maxima of
+/// the blocks covering one of its intervals reaches the threshold. This is what block-max WAND
+/// would score if it knew the threshold from the start, so it is a lower bound of the actual
+/// count, but one that depends on the ordering the same way: orderings that gather the
+/// high-scoring documents of lists into few blocks leave more blocks below the threshold.
+class Block_Max_Simulation {
+  public:
+    static constexpr std::size_t default_block_size = 64;
+
+    /// Simulates queries over `lists`, the posting lists of a collection of documents of
+    /// `document_sizes`, retrieving `k` documents, with blocks of `block_size` postings. The
+    /// lists must outlive the simulation.
+    Block_Max_Simulation(
+        std::vector<binary_freq_collection::sequence> const& lists,
+        std::vector<std::uint32_t> const& document_sizes,
+        std::size_t k = 10,
+        std::size_t block_size = default_block_size);
+
+    /// Estimates the blocks scored for `query`. Terms out of the collection are ignored.
+    [[nodiscard]] auto estimate(Query const& query) const -> block_max_estimate;
+
+    /// Estimates the blocks scored for all `queries`, in parallel.
+    [[nodiscard]] auto estimate(std::vector<Query> const& queries) const -> block_max_estimate;
+
+  private:
+    std::vector<binary_freq_collection::sequence> const& m_lists;
+    std::vector<float> m_norm_lens;
+    std::size_t m_k;
+    std::size_t m_block_size;
+};
+
+}  // namespace pisa
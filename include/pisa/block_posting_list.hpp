@@ -1,13 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+
+#include <gsl/span>
+
 #include "codec/block_codecs.hpp"
+#include "decoded_block_cache.hpp"
+#include "query/query_trace.hpp"
 #include "util/block_profiler.hpp"
+#include "util/prefix_sum.hpp"
 #include "util/util.hpp"
 
 namespace pisa {
 
-template <typename BlockCodec, bool Profile = false>
+/// A posting list split into blocks of `BlockCodec::block_size` postings, preceded by the
+/// maximum docid and the offset of every block.
+///
+/// With `BlockMaxFreqs`, the list also stores its maximum frequency and, next to the maximum
+/// docids, that of every block. In an index of quantized scores these are the upper bounds of
+/// the list and of its blocks, which block-max algorithms can then read from the list header
+/// instead of a separate `wand_data` file.
+template <typename BlockCodec, bool Profile = false, bool BlockMaxFreqs = false>
 struct block_posting_list {
+    static constexpr size_t max_freq_size = BlockMaxFreqs ? 4 : 0;
+
     template <typename DocsIterator, typename FreqsIterator>
     static void
     write(std::vector<uint8_t>& out, uint32_t n, DocsIterator docs_begin, FreqsIterator freqs_begin)
@@ -16,8 +33,10 @@ struct block_posting_list {
 
         uint64_t block_size = BlockCodec::block_size;
         uint64_t blocks = ceil_div(n, block_size);
-        size_t begin_block_maxs = out.size();
-        size_t begin_block_endpoints = begin_block_maxs + 4 * blocks;
+        size_t begin_max_freq = out.size();
+        size_t begin_block_maxs = begin_max_freq + max_freq_size;
+        size_t begin_block_max_freqs = begin_block_maxs + 4 * blocks;
+        size_t begin_block_endpoints = begin_block_max_freqs + max_freq_size * blocks;
         size_t begin_blocks = begin_block_endpoints + 4 * (blocks - 1);
         out.resize(begin_blocks);
 
@@ -27,17 +46,25 @@ struct block_posting_list {
         std::vector<uint32_t> freqs_buf(block_size);
         int32_t last_doc(-1);
         uint32_t block_base = 0;
+        uint32_t max_freq = 0;
         for (size_t b = 0; b < blocks; ++b) {
             uint32_t cur_block_size = ((b + 1) * block_size <= n) ? block_size : (n % block_size);
 
+            uint32_t block_max_freq = 0;
             for (size_t i = 0; i < cur_block_size; ++i) {
                 uint32_t doc(*docs_it++);
                 docs_buf[i] = doc - last_doc - 1;
                 last_doc = doc;
 
-                freqs_buf[i] = *freqs_it++ - 1;
+                uint32_t freq(*freqs_it++);
+                freqs_buf[i] = freq - 1;
+                block_max_freq = std::max(block_max_freq, freq);
             }
             *((uint32_t*)&out[begin_block_maxs + 4 * b]) = last_doc;
+            if constexpr (BlockMaxFreqs) {
+                *((uint32_t*)&out[begin_block_max_freqs + 4 * b]) = block_max_freq;
+                max_freq = std::max(max_freq, block_max_freq);
+            }
 
             BlockCodec::encode(
                 docs_buf.data(), last_doc - block_base - (cur_block_size - 1), cur_block_size, out);
@@ -47,11 +74,15 @@ struct block_posting_list {
             }
             block_base = last_doc + 1;
         }
+        if constexpr (BlockMaxFreqs) {
+            *((uint32_t*)&out[begin_max_freq]) = max_freq;
+        }
     }
 
     template <typename BlockDataRange>
     static void write_blocks(std::vector<uint8_t>& out, uint32_t n, BlockDataRange const& input_blocks)
     {
+        static_assert(!BlockMaxFreqs, "blocks are copied without their maximum frequencies");
         TightVariableByte::encode_single(n, out);
         assert(input_blocks.front().index == 0);  // first block must remain first
 
@@ -78,26 +109,37 @@ struct block_posting_list {
     }
 
     class document_enumerator {
+        /// Full blocks of codecs supporting it are decoded this many docids at a time, as far
+        /// as the enumerator moves, until the frequencies or the whole block are needed.
+        static constexpr uint32_t partial_decode_chunk = 16;
+        static constexpr bool partial_decode = has_partial_decode<BlockCodec>::value;
+        static_assert(!partial_decode || BlockCodec::block_size % partial_decode_chunk == 0);
+        /// Full blocks of codecs that can only decode a prefix are decoded up to the guessed
+        /// position of the docid skipped to, and then as a whole when more is needed.
+        static constexpr bool prefix_decode =
+            !partial_decode && has_prefix_decode<BlockCodec>::value;
+        static constexpr bool lazy_decode = partial_decode || prefix_decode;
+
       public:
         document_enumerator(
             uint8_t const* data,
             uint64_t universe,
-            size_t term_id = 0)
+            size_t term_id = 0,
+            decoded_block_cache::term_slots cached_blocks = {})
             : m_n(0)  // just to silence warnings
               ,
               m_base(TightVariableByte::decode(data, &m_n, 1)),
               m_blocks(ceil_div(m_n, BlockCodec::block_size)),
-              m_block_maxs(m_base),
-              m_block_endpoints(m_block_maxs + 4 * m_blocks),
+              m_block_maxs(m_base + max_freq_size),
+              m_block_endpoints(m_block_maxs + (4 + max_freq_size) * m_blocks),
               m_blocks_data(m_block_endpoints + 4 * (m_blocks - 1)),
-              m_universe(universe)
+              m_universe(universe),
+              m_term_id(term_id),
+              m_cached_blocks(cached_blocks)
         {
             if (Profile) {
-                // std::cout << "OPEN\t" << m_term_id << "\t" << m_blocks << "\n";
                 m_block_profile = block_profiler::open_list(term_id, m_blocks);
             }
-            m_docs_buf.resize(BlockCodec::block_size);
-            m_freqs_buf.resize(BlockCodec::block_size);
             reset();
         }
 
@@ -106,14 +148,19 @@ struct block_posting_list {
         void PISA_ALWAYSINLINE next()
         {
             ++m_pos_in_block;
-            if (PISA_UNLIKELY(m_pos_in_block == m_cur_block_size)) {
+            if (PISA_UNLIKELY(m_pos_in_block == m_docs_decoded)) {
+                if (lazy_decode && m_docs_decoded < m_cur_block_size) {
+                    decode_docs_until(m_cur_block_size);
+                    m_cur_docid = m_docs_buf[m_pos_in_block];
+                    return;
+                }
                 if (m_cur_block + 1 == m_blocks) {
                     m_cur_docid = m_universe;
                     return;
                 }
                 decode_docs_block(m_cur_block + 1);
             } else {
-                m_cur_docid += m_docs_buf[m_pos_in_block] + 1;
+                m_cur_docid = m_docs_buf[m_pos_in_block];
             }
         }
 
@@ -132,15 +179,59 @@ struct block_posting_list {
                     ++block;
                 }
 
-                decode_docs_block(block);
+                // lists that skip whole blocks often read only a few postings of the next one
+                decode_docs_block(block, block > m_cur_block + 1 ? lower_bound : 0);
             }
 
+            if constexpr (lazy_decode) {
+                if (m_docs_buf[m_docs_decoded - 1] < lower_bound) {
+                    decode_docs_until(m_cur_block_size);
+                }
+            }
             while (docid() < lower_bound) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                m_cur_docid = m_docs_buf[++m_pos_in_block];
                 assert(m_pos_in_block < m_cur_block_size);
             }
         }
 
+        /// Moves to each of the nondecreasing docids `targets` in turn, as `next_geq`, and calls
+        /// `fn(i, freq)` for every `targets[i]` in the list. The targets that fall in a block
+        /// are probed together: the block is decoded whole, once, and searched from the
+        /// previous target, and the blocks with no target are skipped without being decoded.
+        template <typename Fn>
+        void next_geq_many(gsl::span<uint64_t const> targets, Fn&& fn)
+        {
+            std::size_t i = 0;
+            while (i < targets.size()) {
+                next_geq(targets[i]);
+                if (m_cur_docid == m_universe) {
+                    return;
+                }
+                std::size_t end = i + 1;
+                while (end < targets.size() && targets[end] <= m_cur_block_max) {
+                    ++end;
+                }
+                if (lazy_decode && end > i + 1 && m_docs_decoded < m_cur_block_size) {
+                    decode_docs_until(m_cur_block_size);
+                }
+                while (true) {
+                    if (m_cur_docid == targets[i]) {
+                        fn(i, freq());
+                    }
+                    if (++i == end) {
+                        break;
+                    }
+                    // the block maximum is not below the target, so it is found in the block
+                    auto const* pos = std::lower_bound(
+                        m_docs_buf.data() + m_pos_in_block,
+                        m_docs_buf.data() + m_cur_block_size,
+                        targets[i]);
+                    m_pos_in_block = pos - m_docs_buf.data();
+                    m_cur_docid = *pos;
+                }
+            }
+        }
+
         void PISA_ALWAYSINLINE move(uint64_t pos)
         {
             assert(pos >= position());
@@ -148,9 +239,65 @@ struct block_posting_list {
             if (PISA_UNLIKELY(block != m_cur_block)) {
                 decode_docs_block(block);
             }
-            while (position() < pos) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+            m_pos_in_block = pos % BlockCodec::block_size;
+            if (lazy_decode && m_pos_in_block >= m_docs_decoded) {
+                decode_docs_until(m_pos_in_block + 1);
+            }
+            m_cur_docid = m_docs_buf[m_pos_in_block];
+        }
+
+        /// Moves to the first posting of the next block, or past the end of the list
+        /// if the current block is the last one.
+        void next_block()
+        {
+            if (m_cur_block + 1 == m_blocks) {
+                m_pos_in_block = m_cur_block_size;
+                m_cur_docid = m_universe;
+                return;
+            }
+            decode_docs_block(m_cur_block + 1);
+        }
+
+        /// Prefetches the first `lines` cache lines of the block that contains `lower_bound`, if
+        /// it is not the current one, ahead of a `next_geq(lower_bound)`. The block is found
+        /// from the block maxima alone, and nothing is decoded. Returns whether a block was
+        /// prefetched, i.e., whether the move is expected to miss the cache.
+        bool prefetch(uint64_t lower_bound, uint32_t lines) const
+        {
+            if (lower_bound <= m_cur_block_max || lower_bound > block_max(m_blocks - 1)) {
+                return false;
+            }
+            uint64_t block = m_cur_block + 1;
+            while (block_max(block) < lower_bound) {
+                ++block;
+            }
+            uint8_t const* block_data =
+                m_blocks_data + ((uint32_t const*)m_block_endpoints)[block - 1];
+            for (uint32_t line = 0; line < lines; ++line) {
+                intrinsics::prefetch(block_data + 64 * line);
+            }
+            return true;
+        }
+
+        /// Returns the docids of the current block, from the current position up
+        /// to the end of the block.
+        [[nodiscard]] auto block_docids() -> gsl::span<uint32_t const>
+        {
+            if (lazy_decode && m_docs_decoded < m_cur_block_size) {
+                decode_docs_until(m_cur_block_size);
+            }
+            return gsl::span<uint32_t const>(
+                m_docs_buf.data() + m_pos_in_block, m_cur_block_size - m_pos_in_block);
+        }
+
+        /// Returns the frequencies aligned with `block_docids()`, decoding them if needed.
+        [[nodiscard]] auto block_freqs() -> gsl::span<uint32_t const>
+        {
+            if (!m_freqs_decoded) {
+                decode_freqs_block();
             }
+            return gsl::span<uint32_t const>(
+                m_freqs_buf.data() + m_pos_in_block, m_cur_block_size - m_pos_in_block);
         }
 
         uint64_t docid() const { return m_cur_docid; }
@@ -160,7 +307,7 @@ struct block_posting_list {
             if (!m_freqs_decoded) {
                 decode_freqs_block();
             }
-            return m_freqs_buf[m_pos_in_block] + 1;
+            return m_freqs_buf[m_pos_in_block];
         }
 
         uint64_t position() const { return m_cur_block * BlockCodec::block_size + m_pos_in_block; }
@@ -169,13 +316,20 @@ struct block_posting_list {
 
         uint64_t num_blocks() const { return m_blocks; }
 
+        /// Returns the maximum frequency of the postings of the current block.
+        [[nodiscard]] auto block_max_freq() const -> uint32_t
+        {
+            static_assert(BlockMaxFreqs, "the list does not store block maximum frequencies");
+            return ((uint32_t const*)(m_block_maxs + 4 * m_blocks))[m_cur_block];
+        }
+
         uint64_t stats_freqs_size() const
         {
             // XXX rewrite in terms of get_blocks()
             uint64_t bytes = 0;
             uint8_t const* ptr = m_blocks_data;
             static const uint64_t block_size = BlockCodec::block_size;
-            std::vector<uint32_t> buf(block_size);
+            std::vector<uint32_t> buf(decode_buffer_size<BlockCodec>);
             for (size_t b = 0; b < m_blocks; ++b) {
                 uint32_t cur_block_size =
                     ((b + 1) * block_size <= size()) ? block_size : (size() % block_size);
@@ -208,14 +362,16 @@ struct block_posting_list {
 
             void decode_doc_gaps(std::vector<uint32_t>& out) const
             {
-                out.resize(size);
+                out.resize(size + decode_overflow<BlockCodec>::value);
                 BlockCodec::decode(docs_begin, out.data(), doc_gaps_universe, size);
+                out.resize(size);
             }
 
             void decode_freqs(std::vector<uint32_t>& out) const
             {
-                out.resize(size);
+                out.resize(size + decode_overflow<BlockCodec>::value);
                 BlockCodec::decode(freqs_begin, out.data(), uint32_t(-1), size);
+                out.resize(size);
             }
 
           private:
@@ -232,7 +388,7 @@ struct block_posting_list {
 
             uint8_t const* ptr = m_blocks_data;
             static const uint64_t block_size = BlockCodec::block_size;
-            std::vector<uint32_t> buf(block_size);
+            std::vector<uint32_t> buf(decode_buffer_size<BlockCodec>);
             for (size_t b = 0; b < m_blocks; ++b) {
                 blocks.emplace_back();
                 uint32_t cur_block_size =
@@ -261,7 +417,10 @@ struct block_posting_list {
       private:
         uint32_t block_max(uint32_t block) const { return ((uint32_t const*)m_block_maxs)[block]; }
 
-        void PISA_NOINLINE decode_docs_block(uint64_t block)
+        /// Decodes the docids of `block`. Given a nonzero `lower_bound`, a full block of a
+        /// partially or prefix decodable codec is only decoded up to a guess of the position of
+        /// `lower_bound`, interpolated from the docid range of the block.
+        void PISA_NOINLINE decode_docs_block(uint64_t block, uint64_t lower_bound = 0)
         {
             static const uint64_t block_size = BlockCodec::block_size;
             uint32_t endpoint = block ? ((uint32_t const*)m_block_endpoints)[block - 1] : 0;
@@ -270,33 +429,157 @@ struct block_posting_list {
                 ((block + 1) * block_size <= size()) ? block_size : (size() % block_size);
             uint32_t cur_base = (block ? block_max(block - 1) : uint32_t(-1)) + 1;
             m_cur_block_max = block_max(block);
-            m_freqs_block_data = BlockCodec::decode(
-                block_data,
-                m_docs_buf.data(),
-                m_cur_block_max - cur_base - (m_cur_block_size - 1),
-                m_cur_block_size);
-            intrinsics::prefetch(m_freqs_block_data);
-
-            m_docs_buf[0] += cur_base;
+            bool freqs_decoded = false;
+            if (PISA_UNLIKELY(block < m_cached_blocks.blocks)) {
+                read_cached_block(block, block_data, cur_base);
+                freqs_decoded = true;
+            } else if (lazy_decode && lower_bound > 0 && m_cur_block_size == block_size) {
+                uint64_t end = partial_decode_chunk;
+                if (lower_bound > cur_base) {
+                    end += block_size * (lower_bound - cur_base) / (m_cur_block_max - cur_base + 1);
+                }
+                m_docs_block_data = block_data;
+                m_docs_decoded = 0;
+                if constexpr (prefix_decode) {
+                    decode_docs_prefix(cur_base, round_to_chunk(end));
+                } else {
+                    decode_docs_chunk(cur_base, round_to_chunk(end));
+                }
+            } else {
+                decode_whole_docs_block(block_data, cur_base);
+            }
 
             m_cur_block = block;
             m_pos_in_block = 0;
             m_cur_docid = m_docs_buf[0];
-            m_freqs_decoded = false;
+            m_freqs_decoded = freqs_decoded;
             if (Profile) {
                 ++m_block_profile[2 * m_cur_block];
+                query_tracer::decoded_block(m_term_id, m_cur_block, false);
+            }
+        }
+
+        /// Copies the docids and frequencies of `block` from the decoded block cache, decoding
+        /// and caching them first if no list has yet.
+        void read_cached_block(uint64_t block, uint8_t const* block_data, uint32_t cur_base)
+        {
+            auto const* cached = decoded_block_cache::find(m_cached_blocks, block);
+            if (cached == nullptr) {
+                decode_whole_docs_block(block_data, cur_base);
+                decode_freqs();
+                decoded_block_cache::insert(
+                    m_cached_blocks,
+                    block,
+                    gsl::make_span(m_docs_buf.data(), m_cur_block_size),
+                    gsl::make_span(m_freqs_buf.data(), m_cur_block_size));
+                return;
+            }
+            assert(cached[0] == m_cur_block_size);
+            std::copy(cached + 1, cached + 1 + m_cur_block_size, m_docs_buf.data());
+            std::copy(
+                cached + 1 + m_cur_block_size,
+                cached + 1 + 2 * m_cur_block_size,
+                m_freqs_buf.data());
+            m_docs_decoded = m_cur_block_size;
+        }
+
+        [[nodiscard]] auto round_to_chunk(uint64_t end) const -> uint32_t
+        {
+            return std::min<uint64_t>(
+                ceil_div(end, partial_decode_chunk) * partial_decode_chunk, m_cur_block_size);
+        }
+
+        void decode_whole_docs_block(uint8_t const* block_data, uint32_t cur_base)
+        {
+            if constexpr (has_docid_decode<BlockCodec>::value) {
+                m_freqs_block_data = BlockCodec::decode_docids(
+                    block_data, m_docs_buf.data(), cur_base, m_cur_block_size);
+                intrinsics::prefetch(m_freqs_block_data);
+            } else {
+                m_freqs_block_data = BlockCodec::decode(
+                    block_data,
+                    m_docs_buf.data(),
+                    m_cur_block_max - cur_base - (m_cur_block_size - 1),
+                    m_cur_block_size);
+                intrinsics::prefetch(m_freqs_block_data);
+
+                m_docs_buf[0] += cur_base;
+                gaps_to_docids(m_docs_buf.data(), m_cur_block_size);
+            }
+            m_docs_decoded = m_cur_block_size;
+        }
+
+        /// Decodes the docids of the current block up to position `end`, rounded up to a chunk.
+        void PISA_NOINLINE decode_docs_until(uint32_t end)
+        {
+            if constexpr (prefix_decode) {
+                // a prefix cannot be resumed, and the frequencies follow the end of the block
+                decode_whole_docs_block(
+                    m_docs_block_data,
+                    (m_cur_block ? block_max(m_cur_block - 1) : uint32_t(-1)) + 1);
+            } else {
+                decode_docs_chunk(
+                    m_docs_buf[m_docs_decoded - 1] + 1, round_to_chunk(end) - m_docs_decoded);
+            }
+        }
+
+        void decode_docs_prefix(uint32_t base, uint32_t n)
+        {
+            if constexpr (prefix_decode) {
+                if (n == m_cur_block_size) {
+                    decode_whole_docs_block(m_docs_block_data, base);
+                    return;
+                }
+                BlockCodec::decode_prefix(
+                    m_docs_block_data,
+                    m_docs_buf.data(),
+                    m_cur_block_max - base - (m_cur_block_size - 1),
+                    m_cur_block_size,
+                    n);
+                m_docs_buf[0] += base;
+                gaps_to_docids(m_docs_buf.data(), n);
+                m_docs_decoded = n;
+            }
+        }
+
+        void decode_docs_chunk(uint32_t base, uint32_t n)
+        {
+            if constexpr (partial_decode) {
+                uint32_t* out = m_docs_buf.data() + m_docs_decoded;
+                m_docs_block_data = BlockCodec::decode_partial(m_docs_block_data, out, n);
+                out[0] += base;
+                gaps_to_docids(out, n);
+                m_docs_decoded += n;
+                if (m_docs_decoded == m_cur_block_size) {
+                    m_freqs_block_data = m_docs_block_data;
+                    intrinsics::prefetch(m_freqs_block_data);
+                }
             }
         }
 
         void PISA_NOINLINE decode_freqs_block()
         {
-            uint8_t const* next_block = BlockCodec::decode(
-                m_freqs_block_data, m_freqs_buf.data(), uint32_t(-1), m_cur_block_size);
-            intrinsics::prefetch(next_block);
+            // the frequencies follow the docids, which must have been decoded to find them
+            if (lazy_decode && m_docs_decoded < m_cur_block_size) {
+                decode_docs_until(m_cur_block_size);
+            }
+            decode_freqs();
             m_freqs_decoded = true;
 
             if (Profile) {
                 ++m_block_profile[2 * m_cur_block + 1];
+                query_tracer::decoded_block(m_term_id, m_cur_block, true);
+            }
+        }
+
+        void decode_freqs()
+        {
+            uint8_t const* next_block = BlockCodec::decode(
+                m_freqs_block_data, m_freqs_buf.data(), uint32_t(-1), m_cur_block_size);
+            intrinsics::prefetch(next_block);
+            // frequencies are stored decremented by one
+            for (uint32_t i = 0; i < m_cur_block_size; ++i) {
+                m_freqs_buf[i] += 1;
             }
         }
 
@@ -307,6 +590,9 @@ struct block_posting_list {
         uint8_t const* m_block_endpoints;
         uint8_t const* m_blocks_data;
         uint64_t m_universe;
+        uint32_t m_term_id;
+        /// The slots of the blocks of the list in the decoded block cache, if any.
+        decoded_block_cache::term_slots m_cached_blocks;
 
         uint32_t m_cur_block;
         uint32_t m_pos_in_block;
@@ -314,13 +600,62 @@ struct block_posting_list {
         uint32_t m_cur_block_size;
         uint32_t m_cur_docid;
 
+        uint32_t m_docs_decoded;
+        uint8_t const* m_docs_block_data;
         uint8_t const* m_freqs_block_data;
         bool m_freqs_decoded;
 
-        std::vector<uint32_t> m_docs_buf;
-        std::vector<uint32_t> m_freqs_buf;
+        // inline, so that opening a list allocates nothing
+        std::array<uint32_t, decode_buffer_size<BlockCodec>> m_docs_buf;
+        std::array<uint32_t, decode_buffer_size<BlockCodec>> m_freqs_buf;
 
         block_profiler::counter_type* m_block_profile;
     };
+
+    /// Enumerates the block maximum frequencies of a list, as the block-max scores of an index
+    /// of quantized scores, with the interface of `wand_data::wand_data_enumerator`.
+    class block_max_enumerator {
+      public:
+        explicit block_max_enumerator(uint8_t const* data) : m_blocks(0)
+        {
+            static_assert(BlockMaxFreqs, "the list does not store block maximum frequencies");
+            uint32_t n = 0;
+            uint8_t const* base = TightVariableByte::decode(data, &n, 1);
+            m_blocks = ceil_div(n, BlockCodec::block_size);
+            m_max_freq = *(uint32_t const*)base;
+            m_block_maxs = (uint32_t const*)(base + max_freq_size);
+            m_block_max_freqs = m_block_maxs + m_blocks;
+        }
+
+        /// Moves to the first block whose maximum docid is not less than `lower_bound`, or to
+        /// the last block, searching the block maxima if it is more than a few blocks ahead.
+        void PISA_ALWAYSINLINE next_geq(uint64_t lower_bound)
+        {
+            uint32_t last = m_blocks - 1;
+            for (int step = 0; step < 4; ++step) {
+                if (m_cur_block == last || m_block_maxs[m_cur_block] >= lower_bound) {
+                    return;
+                }
+                ++m_cur_block;
+            }
+            m_cur_block =
+                std::lower_bound(m_block_maxs + m_cur_block, m_block_maxs + last, lower_bound)
+                - m_block_maxs;
+        }
+
+        [[nodiscard]] auto score() const -> float { return m_block_max_freqs[m_cur_block]; }
+
+        [[nodiscard]] auto docid() const -> uint64_t { return m_block_maxs[m_cur_block]; }
+
+        /// Returns the maximum frequency of the whole list.
+        [[nodiscard]] auto max_freq() const -> uint32_t { return m_max_freq; }
+
+      private:
+        uint32_t m_blocks;
+        uint32_t m_max_freq;
+        uint32_t const* m_block_maxs;
+        uint32_t const* m_block_max_freqs;
+        uint32_t m_cur_block = 0;
+    };
 };
 }  // namespace pisa
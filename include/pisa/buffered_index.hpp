@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "posting_buffer_pool.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// An index whose posting lists are read through a `posting_buffer_pool` instead of its mapping.
+///
+/// Only the endpoints and the parameters of `Index` are read from its mapping; `fetch` reads the
+/// lists of the terms of a query concurrently into frames of the pool, and the returned
+/// `buffered_lists` enumerate them from there. `Index` must provide `list_range`, `lists_data`,
+/// and `enumerator`, as `block_freq_index` does.
+template <typename Index>
+class buffered_index {
+  public:
+    using document_enumerator = typename Index::document_enumerator;
+
+    /// The lists of the terms of a query, read by `fetch`, which can be passed to the cursor
+    /// factories in place of the index.
+    class buffered_lists {
+      public:
+        using document_enumerator = typename Index::document_enumerator;
+
+        [[nodiscard]] auto size() const -> std::size_t { return m_index->size(); }
+        [[nodiscard]] auto num_docs() const -> std::uint64_t { return m_index->num_docs(); }
+
+        /// Returns an enumerator over the list of `term`, which must have been fetched;
+        /// throws `std::out_of_range` otherwise.
+        [[nodiscard]] auto operator[](std::size_t term) const -> document_enumerator
+        {
+            return m_index->enumerator(term, m_frames.at(term)->data());
+        }
+
+      private:
+        friend class buffered_index;
+
+        explicit buffered_lists(Index const& index) : m_index(&index) {}
+
+        Index const* m_index;
+        std::unordered_map<std::size_t, posting_buffer_pool::frame> m_frames;
+    };
+
+    /// Creates a buffered index over `index`, mapped from a file whose contents start at
+    /// `mapped_data`, with its lists read from the same file by `pool`.
+    buffered_index(Index const& index, char const* mapped_data, posting_buffer_pool& pool)
+        : m_index(index),
+          m_lists_offset(reinterpret_cast<char const*>(index.lists_data()) - mapped_data),
+          m_pool(pool)
+    {}
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_index.size(); }
+    [[nodiscard]] auto num_docs() const -> std::uint64_t { return m_index.num_docs(); }
+
+    /// Reads the lists of `terms` that are not in the pool, concurrently, and returns all of them.
+    [[nodiscard]] auto fetch(std::vector<term_id_type> terms) const -> buffered_lists
+    {
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+        std::vector<posting_buffer_pool::byte_range> ranges;
+        ranges.reserve(terms.size());
+        for (auto term: terms) {
+            auto [begin, end] = m_index.list_range(term);
+            ranges.push_back({m_lists_offset + begin, end - begin});
+        }
+        auto frames = m_pool.fetch(ranges);
+
+        buffered_lists lists(m_index);
+        for (std::size_t idx = 0; idx < terms.size(); ++idx) {
+            lists.m_frames.emplace(terms[idx], std::move(frames[idx]));
+        }
+        return lists;
+    }
+
+    /// Reads the lists of the terms of `query`; see `fetch(terms)`.
+    [[nodiscard]] auto fetch(Query const& query) const -> buffered_lists
+    {
+        return fetch(query.terms);
+    }
+
+  private:
+    Index const& m_index;
+    std::uint64_t m_lists_offset;
+    posting_buffer_pool& m_pool;
+};
+
+}  // namespace pisa
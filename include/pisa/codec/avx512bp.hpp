@@ -0,0 +1,249 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "codec/block_codecs.hpp"
+#include "util/compiler_attribute.hpp"
+#include "util/likely.hpp"
+
+namespace pisa {
+
+/// Vertical bit packing of 256 integers into 16 lanes of 32 bits.
+///
+/// The i-th integer goes to lane `i % 16`, and the integers of every lane are packed one after
+/// the other into `b / 2` consecutive 512-bit words, each holding a 32-bit word of every lane.
+/// When `b` is odd, the last 16 bits of every lane are stored as a 256-bit word of 16-bit
+/// integers, so that a block always takes exactly `32 * b` bytes. The layout does not depend
+/// on the instruction set, and is packed and unpacked with AVX-512 when it is available.
+namespace avx512bp {
+
+    constexpr std::size_t block_size = 256;
+    constexpr std::size_t lanes = 16;
+    constexpr std::size_t per_lane = block_size / lanes;
+
+    [[nodiscard]] inline auto packed_bytes(uint32_t bits) -> std::size_t { return 32 * bits; }
+
+    [[nodiscard]] inline auto maxbits(uint32_t const* in) -> uint32_t
+    {
+        uint32_t accumulated = 0;
+        for (std::size_t i = 0; i < block_size; ++i) {
+            accumulated |= in[i];
+        }
+        return accumulated == 0 ? 0 : 32 - __builtin_clz(accumulated);
+    }
+
+#if defined(__AVX512F__)
+
+    template <uint32_t Bits, std::size_t K>
+    PISA_ALWAYSINLINE void pack_value(uint32_t const* in, __m512i* words)
+    {
+        constexpr uint32_t start = K * Bits;
+        constexpr uint32_t word = start / 32;
+        constexpr uint32_t shift = start % 32;
+        __m512i value = _mm512_loadu_si512(in + lanes * K);
+        words[word] = _mm512_or_si512(words[word], _mm512_slli_epi32(value, shift));
+        if constexpr (shift + Bits > 32) {
+            words[word + 1] =
+                _mm512_or_si512(words[word + 1], _mm512_srli_epi32(value, 32 - shift));
+        }
+    }
+
+    template <uint32_t Bits, std::size_t... K>
+    PISA_ALWAYSINLINE void
+    pack_values(uint32_t const* in, __m512i* words, std::index_sequence<K...>)
+    {
+        (pack_value<Bits, K>(in, words), ...);
+    }
+
+    template <uint32_t Bits, std::size_t K>
+    PISA_ALWAYSINLINE void unpack_value(__m512i const* words, __m512i mask, uint32_t* out)
+    {
+        constexpr uint32_t start = K * Bits;
+        constexpr uint32_t word = start / 32;
+        constexpr uint32_t shift = start % 32;
+        __m512i value = _mm512_srli_epi32(words[word], shift);
+        if constexpr (shift + Bits > 32) {
+            value = _mm512_or_si512(value, _mm512_slli_epi32(words[word + 1], 32 - shift));
+        }
+        if constexpr (Bits < 32) {
+            value = _mm512_and_si512(value, mask);
+        }
+        _mm512_storeu_si512(out + lanes * K, value);
+    }
+
+    template <uint32_t Bits, std::size_t... K>
+    PISA_ALWAYSINLINE void
+    unpack_values(__m512i const* words, __m512i mask, uint32_t* out, std::index_sequence<K...>)
+    {
+        (unpack_value<Bits, K>(words, mask, out), ...);
+    }
+
+    template <uint32_t Bits>
+    void pack(uint32_t const* in, uint8_t* out)
+    {
+        constexpr uint32_t full_words = Bits / 2;
+        __m512i words[full_words + 1];
+        for (auto& word: words) {
+            word = _mm512_setzero_si512();
+        }
+        pack_values<Bits>(in, words, std::make_index_sequence<per_lane>{});
+        for (uint32_t word = 0; word < full_words; ++word) {
+            _mm512_storeu_si512(out + 64 * word, words[word]);
+        }
+        if constexpr (Bits % 2 == 1) {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(out + 64 * full_words),
+                _mm512_cvtepi32_epi16(words[full_words]));
+        }
+    }
+
+    template <uint32_t Bits>
+    void unpack(uint8_t const* in, uint32_t* out)
+    {
+        constexpr uint32_t full_words = Bits / 2;
+        __m512i words[full_words + 1];
+        for (uint32_t word = 0; word < full_words; ++word) {
+            words[word] = _mm512_loadu_si512(in + 64 * word);
+        }
+        if constexpr (Bits % 2 == 1) {
+            words[full_words] = _mm512_cvtepu16_epi32(
+                _mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + 64 * full_words)));
+        }
+        __m512i const mask = _mm512_set1_epi32(Bits == 32 ? ~0U : (1U << Bits) - 1);
+        unpack_values<Bits>(words, mask, out, std::make_index_sequence<per_lane>{});
+    }
+
+    using pack_function = void (*)(uint32_t const*, uint8_t*);
+    using unpack_function = void (*)(uint8_t const*, uint32_t*);
+
+    template <std::size_t... Bits>
+    constexpr auto make_pack_table(std::index_sequence<Bits...>)
+    {
+        return std::array<pack_function, sizeof...(Bits)>{&pack<Bits + 1>...};
+    }
+
+    template <std::size_t... Bits>
+    constexpr auto make_unpack_table(std::index_sequence<Bits...>)
+    {
+        return std::array<unpack_function, sizeof...(Bits)>{&unpack<Bits + 1>...};
+    }
+
+    inline void pack(uint32_t const* in, uint8_t* out, uint32_t bits)
+    {
+        static constexpr auto table = make_pack_table(std::make_index_sequence<32>{});
+        if (bits > 0) {
+            table[bits - 1](in, out);
+        }
+    }
+
+    inline void unpack(uint8_t const* in, uint32_t* out, uint32_t bits)
+    {
+        static constexpr auto table = make_unpack_table(std::make_index_sequence<32>{});
+        if (bits == 0) {
+            std::fill(out, out + block_size, 0);
+            return;
+        }
+        table[bits - 1](in, out);
+    }
+
+#else
+
+    inline void pack(uint32_t const* in, uint8_t* out, uint32_t bits)
+    {
+        uint32_t full_words = bits / 2;
+        std::memset(out, 0, packed_bytes(bits));
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            uint64_t buffer = 0;
+            uint32_t buffered_bits = 0;
+            uint32_t word = 0;
+            for (std::size_t k = 0; k < per_lane; ++k) {
+                buffer |= static_cast<uint64_t>(in[lanes * k + lane]) << buffered_bits;
+                buffered_bits += bits;
+                if (buffered_bits >= 32) {
+                    auto value = static_cast<uint32_t>(buffer);
+                    std::memcpy(out + 64 * word + 4 * lane, &value, 4);
+                    buffer >>= 32;
+                    buffered_bits -= 32;
+                    word += 1;
+                }
+            }
+            if (buffered_bits > 0) {
+                auto value = static_cast<uint16_t>(buffer);
+                std::memcpy(out + 64 * full_words + 2 * lane, &value, 2);
+            }
+        }
+    }
+
+    inline void unpack(uint8_t const* in, uint32_t* out, uint32_t bits)
+    {
+        uint32_t full_words = bits / 2;
+        uint64_t mask = (uint64_t(1) << bits) - 1;
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            uint64_t buffer = 0;
+            uint32_t buffered_bits = 0;
+            uint32_t word = 0;
+            for (std::size_t k = 0; k < per_lane; ++k) {
+                if (buffered_bits < bits) {
+                    uint64_t next = 0;
+                    if (word < full_words) {
+                        uint32_t value;
+                        std::memcpy(&value, in + 64 * word + 4 * lane, 4);
+                        next = value;
+                    } else {
+                        uint16_t value;
+                        std::memcpy(&value, in + 64 * full_words + 2 * lane, 2);
+                        next = value;
+                    }
+                    buffer |= next << buffered_bits;
+                    buffered_bits += 32;
+                    word += 1;
+                }
+                out[lanes * k + lane] = static_cast<uint32_t>(buffer & mask);
+                buffer >>= bits;
+                buffered_bits -= bits;
+            }
+        }
+    }
+
+#endif
+
+}  // namespace avx512bp
+
+/// Bit packing of blocks of 256 integers, vectorized with AVX-512 when available.
+/// Blocks that are not full are encoded with binary interpolative coding.
+struct avx512bp_block {
+    static constexpr uint64_t block_size = avx512bp::block_size;
+    static void
+    encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
+    {
+        assert(n <= block_size);
+        if (n < block_size) {
+            basic_interpolative_block<block_size>::encode(in, sum_of_values, n, out);
+            return;
+        }
+        uint32_t b = avx512bp::maxbits(in);
+        auto begin = out.size();
+        out.resize(begin + 1 + avx512bp::packed_bytes(b));
+        out[begin] = b;
+        avx512bp::pack(in, out.data() + begin + 1, b);
+    }
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
+    {
+        assert(n <= block_size);
+        if (PISA_UNLIKELY(n < block_size)) {
+            return basic_interpolative_block<block_size>::decode(in, out, sum_of_values, n);
+        }
+        uint32_t b = *in++;
+        avx512bp::unpack(in, out, b);
+        return in + avx512bp::packed_bytes(b);
+    }
+};
+
+}  // namespace pisa
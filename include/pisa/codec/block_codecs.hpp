@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <type_traits>
+
 #include "FastPFor/headers/optpfor.h"
 #include "FastPFor/headers/variablebyte.h"
 
@@ -120,8 +123,93 @@ class TightVariableByte {
     }
 };
 
-struct interpolative_block {
-    static const uint64_t block_size = 128;
+/// Detects block codecs that can decode the first values of a full block, and resume from
+/// where they stopped, with `decode_partial(in, out, n)`. It decodes `n` values starting at
+/// `in`, which is a multiple of 16, and returns the position of the next ones.
+template <typename BlockCodec, typename = void>
+struct has_partial_decode: std::false_type {
+};
+
+template <typename BlockCodec>
+struct has_partial_decode<
+    BlockCodec,
+    std::void_t<decltype(BlockCodec::decode_partial(
+        std::declval<uint8_t const*>(), std::declval<uint32_t*>(), std::size_t()))>>
+    : std::true_type {
+};
+
+/// Detects block codecs that can decode the first values of a full block without the rest
+/// with `decode_prefix(in, out, sum_of_values, n, k)`, which decodes at least `k` of the `n`
+/// values at `in`. Unlike `decode_partial`, the decoding cannot be resumed, nor does it find
+/// the end of the block.
+template <typename BlockCodec, typename = void>
+struct has_prefix_decode: std::false_type {
+};
+
+template <typename BlockCodec>
+struct has_prefix_decode<
+    BlockCodec,
+    std::void_t<decltype(BlockCodec::decode_prefix(
+        std::declval<uint8_t const*>(),
+        std::declval<uint32_t*>(),
+        uint32_t(),
+        std::size_t(),
+        std::size_t()))>>: std::true_type {
+};
+
+/// Detects block codecs that decode the docids of a block directly, rather than their gaps,
+/// with `decode_docids(in, out, base, n)`, given the lowest docid the block may start with.
+/// It returns the position of the frequencies.
+template <typename BlockCodec, typename = void>
+struct has_docid_decode: std::false_type {
+};
+
+template <typename BlockCodec>
+struct has_docid_decode<
+    BlockCodec,
+    std::void_t<decltype(BlockCodec::decode_docids(
+        std::declval<uint8_t const*>(), std::declval<uint32_t*>(), uint32_t(), std::size_t()))>>
+    : std::true_type {
+};
+
+/// Number of values past the `n` requested that `BlockCodec::decode` may write. Codecs whose
+/// decoders unpack whole words declare it as `decode_overflow`; it is zero for the others.
+template <typename BlockCodec, typename = void>
+struct decode_overflow: std::integral_constant<std::size_t, 0> {
+};
+
+template <typename BlockCodec>
+struct decode_overflow<BlockCodec, std::void_t<decltype(BlockCodec::decode_overflow)>>
+    : std::integral_constant<std::size_t, BlockCodec::decode_overflow> {
+};
+
+/// Size of the buffers blocks of `BlockCodec` are decoded into, which leave room for the
+/// values its decoder writes past the end of a block.
+template <typename BlockCodec>
+constexpr std::size_t decode_buffer_size =
+    BlockCodec::block_size + decode_overflow<BlockCodec>::value;
+
+/// Appends to `out` the bytes that `encode(dst)` writes at `dst`, at most `max_bytes`, given
+/// the number of bytes it returns. Codecs encode in place this way, with a bound on the size
+/// of their output, rather than into a scratch buffer then copied into `out`.
+template <typename Encode>
+void encode_in_place(std::vector<uint8_t>& out, std::size_t max_bytes, Encode&& encode)
+{
+    auto begin = out.size();
+    out.resize(begin + max_bytes);
+    std::size_t len = encode(out.data() + begin);
+    assert(len <= max_bytes);
+    out.resize(begin + len);
+}
+
+/// Binary interpolative coding of blocks of up to `BlockSize` integers.
+///
+/// Full blocks are decoded along a precomputed `interpolative_schedule`, without recursion, and
+/// their first values can be decoded alone: a value is written after all the values that
+/// precede it and their bounds, so reading stops as soon as they are known.
+template <uint64_t BlockSize>
+struct basic_interpolative_block {
+    static constexpr uint64_t block_size = BlockSize;
 
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
     {
@@ -152,6 +240,11 @@ struct interpolative_block {
         if (sum_of_values == uint32_t(-1)) {
             inbuf = TightVariableByte::decode(inbuf, &sum_of_values, 1);
         }
+        if (n == block_size) {
+            bit_reader br((uint32_t const*)inbuf);
+            decode_full_prefix(br, out, sum_of_values, n);
+            return inbuf + ceil_div(br.position(), 8);
+        }
 
         out[n - 1] = sum_of_values;
         size_t read_interpolative = 0;
@@ -166,8 +259,42 @@ struct interpolative_block {
 
         return inbuf + read_interpolative;
     }
+
+    /// Decodes at least the first `k` values of a block of `n`, reading only their bits and
+    /// those of their bounds if the block is full.
+    static void PISA_NOINLINE
+    decode_prefix(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, size_t k)
+    {
+        if (n != block_size || k >= n) {
+            decode(in, out, sum_of_values, n);
+            return;
+        }
+        if (sum_of_values == uint32_t(-1)) {
+            in = TightVariableByte::decode(in, &sum_of_values, 1);
+        }
+        bit_reader br((uint32_t const*)in);
+        decode_full_prefix(br, out, sum_of_values, k);
+    }
+
+  private:
+    /// Decodes the first `k` values of a full block, whose `block_size - 1` prefix sums
+    /// are encoded, the last one being `sum_of_values`.
+    static void decode_full_prefix(bit_reader& br, uint32_t* out, uint32_t sum_of_values, size_t k)
+    {
+        static const interpolative_schedule schedule(block_size - 1);
+        std::array<uint32_t, block_size + 1> sums;
+        sums[0] = 0;
+        sums[block_size] = sum_of_values;
+        br.read_interpolative(
+            sums.data(), schedule, schedule.prefix_steps(std::min<size_t>(k, block_size - 1)));
+        for (size_t i = 0; i < k; ++i) {
+            out[i] = sums[i + 1] - sums[i];
+        }
+    }
 };
 
+using interpolative_block = basic_interpolative_block<128>;
+
 struct optpfor_block {
     struct codec_type: FastPForLib::OPTPFor<4, FastPForLib::Simple16<false>> {
         uint8_t const* force_b;
@@ -212,7 +339,6 @@ struct optpfor_block {
         uint8_t const* b = nullptr)  // if non-null forces b
     {
         thread_local codec_type optpfor_codec;
-        thread_local std::vector<uint8_t> buf(2 * 4 * block_size);
         assert(n <= block_size);
 
         if (n < block_size) {
@@ -220,12 +346,13 @@ struct optpfor_block {
             return;
         }
 
-        size_t out_len = buf.size();
-
         optpfor_codec.force_b = b;
-        optpfor_codec.encodeBlock(in, reinterpret_cast<uint32_t*>(buf.data()), out_len);
-        out_len *= 4;
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        // A forced b can make exceptions take more space than the values.
+        encode_in_place(out, 2 * 4 * block_size, [&](uint8_t* dst) {
+            size_t out_len = 2 * block_size;
+            optpfor_codec.encodeBlock(in, reinterpret_cast<uint32_t*>(dst), out_len);
+            return out_len * 4;
+        });
     }
 
     static uint8_t const* PISA_NOINLINE
@@ -282,7 +409,6 @@ struct varint_G8IU_block {
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
     {
         thread_local codec_type varint_codec;
-        thread_local std::vector<uint8_t> buf(2 * 4 * block_size);
         assert(n <= block_size);
 
         if (n < block_size) {
@@ -290,18 +416,19 @@ struct varint_G8IU_block {
             return;
         }
 
-        size_t out_len = buf.size();
-
-        const uint32_t* src = in;
-        unsigned char* dst = buf.data();
-        size_t srclen = n * 4;
-        size_t dstlen = out_len;
-        out_len = 0;
-        while (srclen > 0 && dstlen >= 9) {
-            out_len += varint_codec.encodeBlock(src, srclen, dst, dstlen);
-        }
-        assert(srclen == 0);
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        // Every group of 9 bytes holds at least two values.
+        size_t max_bytes = 9 * ceil_div(n, 2);
+        encode_in_place(out, max_bytes, [&](uint8_t* dst) {
+            const uint32_t* src = in;
+            size_t srclen = n * 4;
+            size_t dstlen = max_bytes;
+            size_t out_len = 0;
+            while (srclen > 0 && dstlen >= 9) {
+                out_len += varint_codec.encodeBlock(src, srclen, dst, dstlen);
+            }
+            assert(srclen == 0);
+            return out_len;
+        });
     }
 
     // we only allow varint to be inlined (others have PISA_NOILINE)
@@ -77,7 +77,7 @@ struct compact_elias_fano {
     {
         uint64_t base_offset = bvb.size();
         offsets of(base_offset, universe, n, params);
-        // initialize all the bits to 0
+        // initialize all the bits to 0, so that fields need not be cleared before being set
         bvb.zero_extend(of.end - base_offset);
 
         uint64_t sample1_mask = (uint64_t(1) << of.log_sampling1) - 1;
@@ -95,7 +95,7 @@ struct compact_elias_fano {
                     continue;
                 offset = of.pointers0_offset + (ptr0 - 1) * of.pointer_size;
                 assert(offset + of.pointer_size <= of.pointers1_offset);
-                bvb.set_bits(offset, (ptr0 << of.log_sampling0) + rank_end, of.pointer_size);
+                bvb.or_bits(offset, (ptr0 << of.log_sampling0) + rank_end, of.pointer_size);
             }
         };
 
@@ -118,14 +118,14 @@ struct compact_elias_fano {
 
             offset = of.lower_bits_offset + i * of.lower_bits;
             assert(offset + of.lower_bits <= of.end);
-            bvb.set_bits(offset, low, of.lower_bits);
+            bvb.or_bits(offset, low, of.lower_bits);
 
             if (i && (i & sample1_mask) == 0) {
                 uint64_t ptr1 = i >> of.log_sampling1;
                 assert(ptr1 > 0);
                 offset = of.pointers1_offset + (ptr1 - 1) * of.pointer_size;
                 assert(offset + of.pointer_size <= of.higher_bits_offset);
-                bvb.set_bits(offset, high, of.pointer_size);
+                bvb.or_bits(offset, high, of.pointer_size);
             }
 
             // write pointers for the run of zeros in [last_high, high)
@@ -217,6 +217,73 @@ struct compact_elias_fano {
 
         uint64_t size() const { return m_of.n; }
 
+        /// Calls `fn(i, position)` for every `values[i]` found in the sequence, at `position`,
+        /// where `values` are increasing and none is below the current value.
+        ///
+        /// Rather than a `next_geq` per value, the high bits are walked once for all values,
+        /// e.g., the docids of a shorter list intersected with this one: the zeros up to the
+        /// bucket of a value are skipped a word at a time, and only the elements from its
+        /// bucket on are decoded. The enumerator is left at the first element of at least the
+        /// last value, as after `next_geq`.
+        template <typename Fn>
+        void intersect(uint32_t const* values, size_t count, Fn fn)
+        {
+            uint64_t const lower_bits = m_of.lower_bits;
+            uint64_t const high_offset = m_of.higher_bits_offset;
+            bit_vector::unary_enumerator high_enumerator = m_high_enumerator;
+            uint64_t position = m_position;
+            uint64_t value = m_value;
+            uint64_t high = value >> lower_bits;
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t target = values[i];
+                if (target <= value) {
+                    if (target == value) {
+                        fn(i, position);
+                    }
+                    continue;
+                }
+                if (PISA_UNLIKELY(target >= m_of.universe)) {
+                    move(size());
+                    return;
+                }
+                uint64_t target_high = target >> lower_bits;
+                if (target_high > high) {
+                    // as in `slow_next_geq`, the 1 of the current element is already consumed
+                    uint64_t high_diff = target_high - high;
+                    if ((high_diff >> m_of.log_sampling0) == 0) {
+                        high_enumerator.skip0(high_diff);
+                    } else {
+                        uint64_t ptr = target_high >> m_of.log_sampling0;
+                        high_enumerator =
+                            bit_vector::unary_enumerator(*m_bv, high_offset + pointer0(ptr));
+                        high_enumerator.skip0(target_high - (ptr << m_of.log_sampling0));
+                    }
+                    position = high_enumerator.position() - high_offset - target_high;
+                } else {
+                    position += 1;
+                }
+                while (true) {
+                    if (PISA_UNLIKELY(position == size())) {
+                        m_position = size();
+                        m_value = m_of.universe;
+                        return;
+                    }
+                    high = high_enumerator.next() - high_offset - position - 1;
+                    value = (high << lower_bits) | read_low(position);
+                    if (value >= target) {
+                        break;
+                    }
+                    position += 1;
+                }
+                if (value == target) {
+                    fn(i, position);
+                }
+            }
+            m_high_enumerator = high_enumerator;
+            m_position = position;
+            m_value = value;
+        }
+
         value_type next()
         {
             m_position += 1;
@@ -329,9 +396,11 @@ struct compact_elias_fano {
 
         static const uint64_t linear_scan_threshold = 8;
 
-        inline uint64_t read_low()
+        inline uint64_t read_low() { return read_low(m_position); }
+
+        inline uint64_t read_low(uint64_t position) const
         {
-            return m_bv->get_word56(m_of.lower_bits_offset + m_position * m_of.lower_bits)
+            return m_bv->get_word56(m_of.lower_bits_offset + position * m_of.lower_bits)
                 & m_of.mask;
         }
 
@@ -247,8 +247,6 @@ struct compact_ranked_bitvector {
 
         value_type PISA_NOINLINE slow_next_geq(uint64_t lower_bound)
         {
-            using broadword::popcount;
-
             if (PISA_UNLIKELY(lower_bound >= m_of.universe)) {
                 return move(size());
             }
@@ -256,42 +254,59 @@ struct compact_ranked_bitvector {
             uint64_t skip = lower_bound - m_value;
             m_enumerator = bit_vector::unary_enumerator(*m_bv, m_of.bits_offset + lower_bound);
 
-            uint64_t begin;
+            uint64_t end = m_of.bits_offset + lower_bound;
             if (lower_bound > m_value && (skip >> m_of.log_rank1_sampling) == 0) {
-                begin = m_of.bits_offset + m_value;
+                m_position += count_ones(m_of.bits_offset + m_value, end);
             } else {
+                // Count from the nearer of the samples around the lower bound, so that at most
+                // half a sampling block is read past the bits the enumerator needs anyway.
                 uint64_t block = lower_bound >> m_of.log_rank1_sampling;
-                m_position = rank1_sample(block);
+                uint64_t next_block = block + 1;
+                uint64_t half = uint64_t(1) << (m_of.log_rank1_sampling - 1);
+                if ((lower_bound & (2 * half - 1)) >= half
+                    && (next_block << m_of.log_rank1_sampling) < m_of.universe) {
+                    uint64_t next_begin = m_of.bits_offset + (next_block << m_of.log_rank1_sampling);
+                    m_position = rank1_sample(next_block) - count_ones(end, next_begin);
+                } else {
+                    m_position = rank1_sample(block);
+                    m_position +=
+                        count_ones(m_of.bits_offset + (block << m_of.log_rank1_sampling), end);
+                }
+            }
 
-                begin = m_of.bits_offset + (block << m_of.log_rank1_sampling);
+            if (m_position < size()) {
+                m_value = read_next();
+            } else {
+                m_value = m_of.universe;
             }
 
-            uint64_t end = m_of.bits_offset + lower_bound;
+            return value();
+        }
+
+        static const uint64_t linear_scan_threshold = 8;
+
+        /// Returns the number of ones in the bits `[begin, end)`.
+        inline uint64_t count_ones(uint64_t begin, uint64_t end) const
+        {
+            using broadword::popcount;
+
             uint64_t begin_word = begin / 64;
             uint64_t begin_shift = begin % 64;
             uint64_t end_word = end / 64;
             uint64_t end_shift = end % 64;
             uint64_t word = (m_bv->data()[begin_word] >> begin_shift) << begin_shift;
 
+            uint64_t count = 0;
             while (begin_word < end_word) {
-                m_position += popcount(word);
+                count += popcount(word);
                 word = m_bv->data()[++begin_word];
             }
             if (end_shift) {
-                m_position += popcount(word << (64 - end_shift));
-            }
-
-            if (m_position < size()) {
-                m_value = read_next();
-            } else {
-                m_value = m_of.universe;
+                count += popcount(word << (64 - end_shift));
             }
-
-            return value();
+            return count;
         }
 
-        static const uint64_t linear_scan_threshold = 8;
-
         inline value_type value() const { return value_type(m_position, m_value); }
 
         inline uint64_t read_next() { return m_enumerator.next() - m_of.bits_offset; }
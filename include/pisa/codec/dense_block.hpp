@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "codec/block_codecs.hpp"
+#include "util/likely.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Stores blocks of docid gaps as bitmaps when that takes less space than `BlockCodec`.
+///
+/// Blocks of stopword-like terms are dense: they span not many more docids than they contain.
+/// The bitmap of a block has a bit for every docid between the first docid of the block and the
+/// block maximum, and is stored in 64-bit words prefixed by a flag byte. Frequency blocks, whose
+/// sum of values is unknown, are always encoded with `BlockCodec`.
+template <typename BlockCodec>
+struct dense_block {
+    static constexpr std::uint64_t block_size = BlockCodec::block_size;
+    static constexpr std::uint64_t decode_overflow = decode_buffer_size<BlockCodec> - block_size;
+
+    enum : uint8_t { codec_block = 0, bitmap_block = 1 };
+
+    [[nodiscard]] static auto bitmap_words(uint32_t sum_of_values, size_t n) -> size_t
+    {
+        return ceil_div(uint64_t(sum_of_values) + n, 64);
+    }
+
+    static void
+    encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
+    {
+        if (sum_of_values == uint32_t(-1)) {
+            BlockCodec::encode(in, sum_of_values, n, out);
+            return;
+        }
+        out.push_back(codec_block);
+        size_t begin = out.size();
+        BlockCodec::encode(in, sum_of_values, n, out);
+        size_t words = bitmap_words(sum_of_values, n);
+        if (8 * words >= out.size() - begin) {
+            return;
+        }
+        out.resize(begin - 1);
+        out.push_back(bitmap_block);
+        thread_local std::vector<uint64_t> bitmap;
+        bitmap.assign(words, 0);
+        uint64_t pos = 0;
+        for (size_t i = 0; i < n; ++i) {
+            pos += in[i];
+            bitmap[pos / 64] |= uint64_t(1) << (pos % 64);
+            pos += 1;
+        }
+        auto const* bytes = reinterpret_cast<uint8_t const*>(bitmap.data());
+        out.insert(out.end(), bytes, bytes + 8 * words);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
+    {
+        if (sum_of_values == uint32_t(-1)) {
+            return BlockCodec::decode(in, out, sum_of_values, n);
+        }
+        if (PISA_LIKELY(*in++ == codec_block)) {
+            return BlockCodec::decode(in, out, sum_of_values, n);
+        }
+        size_t words = bitmap_words(sum_of_values, n);
+        int64_t last = -1;
+        for (size_t w = 0; w < words; ++w) {
+            uint64_t word;
+            std::memcpy(&word, in + 8 * w, 8);
+            while (word != 0) {
+                int64_t pos = 64 * w + __builtin_ctzll(word);
+                *out++ = pos - last - 1;
+                last = pos;
+                word &= word - 1;
+            }
+        }
+        return in + 8 * words;
+    }
+};
+
+}  // namespace pisa
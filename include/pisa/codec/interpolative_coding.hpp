@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 
@@ -69,6 +70,58 @@ class bit_writer {
     uint32_t* m_cur_word;
 };
 
+/// The order in which `bit_writer::write_interpolative` writes a sequence of `n` values, so
+/// that they can be read back with a single loop instead of a recursion.
+///
+/// Values are numbered from 1 to `n`, and 0 and `n + 1` stand for the lower and upper bounds of
+/// the sequence. Every step reads the value at `pos`, bounded by the values at `low` and `high`,
+/// which are read before it.
+class interpolative_schedule {
+  public:
+    struct step {
+        uint16_t pos;
+        uint16_t low;
+        uint16_t high;
+    };
+
+    explicit interpolative_schedule(uint32_t n) : m_prefix_steps(n + 1, 0)
+    {
+        assert(n < (1U << 16) - 1);
+        m_steps.reserve(n);
+        add_steps(1, n, 0, n + 1);
+
+        // A value written after another one is never needed to read it, so the values
+        // `[1, k]` and their bounds are always read by a prefix of the steps.
+        std::vector<uint32_t> step_of(n + 1, 0);
+        for (uint32_t idx = 0; idx < n; ++idx) {
+            step_of[m_steps[idx].pos] = idx;
+        }
+        for (uint32_t k = 1; k <= n; ++k) {
+            m_prefix_steps[k] = std::max(m_prefix_steps[k - 1], step_of[k] + 1);
+        }
+    }
+
+    [[nodiscard]] auto steps() const -> std::vector<step> const& { return m_steps; }
+
+    /// Returns the number of steps reading the values `[1, k]`.
+    [[nodiscard]] auto prefix_steps(uint32_t k) const -> uint32_t { return m_prefix_steps[k]; }
+
+  private:
+    void add_steps(uint32_t begin, uint32_t n, uint32_t low, uint32_t high)
+    {
+        if (!n) {
+            return;
+        }
+        uint32_t pos = begin + n / 2;
+        m_steps.push_back(step{uint16_t(pos), uint16_t(low), uint16_t(high)});
+        add_steps(begin, n / 2, low, pos);
+        add_steps(pos + 1, n - n / 2 - 1, pos, high);
+    }
+
+    std::vector<step> m_steps;
+    std::vector<uint32_t> m_prefix_steps;
+};
+
 class bit_reader {
   public:
     bit_reader(uint32_t const* in) : m_in(in), m_avail(0), m_buf(0), m_pos(0) {}
@@ -98,15 +151,42 @@ class bit_reader {
         auto b = broadword::msb(u);
         uint64_t m = (uint64_t(1) << (b + 1)) - u;
 
-        uint32_t val = read(b);
+        // words are only loaded when their bits are needed, not to read past the encoding
+        if (m_avail < b) {
+            m_buf |= uint64_t(*m_in++) << m_avail;
+            m_avail += 32;
+        }
+        uint32_t val = m_buf & ((uint64_t(1) << b) - 1);
+        m_buf >>= b;
+        m_avail -= b;
+        m_pos += b;
         if (val >= m) {
-            val = (val << 1) + read(1) - m;
+            if (m_avail == 0) {
+                m_buf = *m_in++;
+                m_avail = 32;
+            }
+            val = (val << 1) + (m_buf & 1) - m;
+            m_buf >>= 1;
+            m_avail -= 1;
+            m_pos += 1;
         }
 
         assert(val < u);
         return val;
     }
 
+    /// Reads the values written by `bit_writer::write_interpolative` in the first `steps` steps
+    /// of `schedule`, into the positions of `vals` the steps number, whose bounds at 0 and
+    /// `n + 1` must be set.
+    void read_interpolative(uint32_t* vals, interpolative_schedule const& schedule, size_t steps)
+    {
+        auto const* step = schedule.steps().data();
+        for (auto const* end = step + steps; step != end; ++step) {
+            uint32_t low = vals[step->low];
+            vals[step->pos] = low + read_int(vals[step->high] - low + 1);
+        }
+    }
+
     void read_interpolative(uint32_t* out, size_t n, uint32_t low, uint32_t high)
     {
         assert(low <= high);
@@ -18,9 +18,7 @@ struct maskedvbyte_block {
             interpolative_block::encode(src, sum_of_values, n, out);
             return;
         }
-        thread_local std::vector<uint8_t> buf(2 * block_size * sizeof(uint32_t));
-        size_t out_len = vbyte_encode(src, n, buf.data());
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        encode_in_place(out, 5 * n, [&](uint8_t* dst) { return vbyte_encode(src, n, dst); });
     }
     static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
     {
@@ -31,5 +29,9 @@ struct maskedvbyte_block {
         auto read = masked_vbyte_decode(in, out, n);
         return in + read;
     }
+    static uint8_t const* decode_partial(uint8_t const* in, uint32_t* out, size_t n)
+    {
+        return in + masked_vbyte_decode(in, out, n);
+    }
 };
 }  // namespace pisa
\ No newline at end of file
@@ -7,6 +7,8 @@ namespace pisa {
 struct qmx_block {
     static const uint64_t block_size = 128;
     static const uint64_t overflow = 512;
+    /// The decoder unpacks whole 128-bit words, past the end of the block.
+    static const uint64_t decode_overflow = block_size + overflow;
 
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
     {
@@ -32,12 +34,7 @@ struct qmx_block {
         }
         uint32_t enc_len = 0;
         in = TightVariableByte::decode(in, &enc_len, 1);
-        std::vector<uint32_t> buf(2 * n + overflow);
-        qmx_codec.decode(buf.data(), n, in, enc_len);
-        for (size_t i = 0; i < n; ++i) {
-            *out = buf[i];
-            ++out;
-        }
+        qmx_codec.decode(out, n, in, enc_len);
         return in + enc_len;
     }
 };
@@ -9,32 +9,47 @@ extern "C" {
 }
 
 namespace pisa {
-struct simdbp_block {
-    static const uint64_t block_size = 128;
+
+/// SIMD-BP128 bit packing of blocks of `BlockSize` integers, which must be a multiple of 128.
+/// Every 128 integers of a full block are packed with their own bit width.
+template <uint64_t BlockSize>
+struct basic_simdbp_block {
+    static_assert(BlockSize % 128 == 0, "SIMD-BP128 packs integers 128 at a time");
+    static constexpr uint64_t block_size = BlockSize;
+
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
     {
         assert(n <= block_size);
         uint32_t* src = const_cast<uint32_t*>(in);
         if (n < block_size) {
-            interpolative_block::encode(src, sum_of_values, n, out);
+            basic_interpolative_block<block_size>::encode(src, sum_of_values, n, out);
             return;
         }
-        uint32_t b = maxbits(in);
-        thread_local std::vector<uint8_t> buf(8 * n);
-        uint8_t* buf_ptr = buf.data();
-        *buf_ptr++ = b;
-        simdpackwithoutmask(src, (__m128i*)buf_ptr, b);
-        out.insert(out.end(), buf.data(), buf.data() + b * sizeof(__m128i) + 1);
+        for (size_t chunk = 0; chunk < n; chunk += 128) {
+            uint32_t b = maxbits(in + chunk);
+            size_t chunk_bytes = b * sizeof(__m128i) + 1;
+            encode_in_place(out, chunk_bytes, [&](uint8_t* dst) {
+                *dst++ = b;
+                simdpackwithoutmask(src + chunk, (__m128i*)dst, b);
+                return chunk_bytes;
+            });
+        }
     }
     static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
     {
         assert(n <= block_size);
         if (PISA_UNLIKELY(n < block_size)) {
-            return interpolative_block::decode(in, out, sum_of_values, n);
+            return basic_interpolative_block<block_size>::decode(in, out, sum_of_values, n);
         }
-        uint32_t b = *in++;
-        simdunpack((const __m128i*)in, out, b);
-        return in + b * sizeof(__m128i);
+        for (size_t chunk = 0; chunk < n; chunk += 128) {
+            uint32_t b = *in++;
+            simdunpack((const __m128i*)in, out + chunk, b);
+            in += b * sizeof(__m128i);
+        }
+        return in;
     }
 };
-}  // namespace pisa
\ No newline at end of file
+
+using simdbp_block = basic_simdbp_block<128>;
+
+}  // namespace pisa
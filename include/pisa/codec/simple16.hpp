@@ -1,36 +1,35 @@
 #pragma once
 #include "FastPFor/headers/simple16.h"
 
+#include "codec/block_codecs.hpp"
+
 namespace pisa {
 
 struct simple16_block {
     static const uint64_t block_size = 128;
+    /// The last word decoded can hold up to 28 values past the end of the block.
+    static const uint64_t decode_overflow = 28;
 
     static void
     encode(uint32_t const* in, uint32_t /* sum_of_values */, size_t n, std::vector<uint8_t>& out)
     {
         assert(n <= block_size);
         thread_local FastPForLib::Simple16<false> codec;
-        thread_local std::vector<uint8_t> buf(2 * 8 * block_size);
-        size_t out_len = buf.size();
-        codec.encodeArray(in, n, reinterpret_cast<uint32_t*>(buf.data()), out_len);
-        out_len *= 4;
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        // Every word holds at least one value.
+        encode_in_place(out, 4 * n, [&](uint8_t* dst) {
+            size_t out_len = n;
+            codec.encodeArray(in, n, reinterpret_cast<uint32_t*>(dst), out_len);
+            return out_len * 4;
+        });
     }
 
     static uint8_t const*
     decode(uint8_t const* in, uint32_t* out, uint32_t /* sum_of_values */, size_t n)
     {
         assert(n <= block_size);
-        FastPForLib::Simple16<false> codec;
-        std::vector<uint32_t> buf(2 * block_size);
-
-        uint8_t const* ret = reinterpret_cast<uint8_t const*>(
-            codec.decodeArray(reinterpret_cast<uint32_t const*>(in), 8 * n, buf.data(), n));
-        for (size_t i = 0; i < n; ++i) {
-            *out++ = buf[i];
-        }
-        return ret;
+        thread_local FastPForLib::Simple16<false> codec;
+        return reinterpret_cast<uint8_t const*>(
+            codec.decodeArray(reinterpret_cast<uint32_t const*>(in), 8 * n, out, n));
     }
 };
 }  // namespace pisa
@@ -1,6 +1,8 @@
 #pragma once
 #include "FastPFor/headers/simple8b.h"
 
+#include "codec/block_codecs.hpp"
+
 namespace pisa {
 
 struct simple8b_block {
@@ -11,11 +13,12 @@ struct simple8b_block {
     {
         assert(n <= block_size);
         thread_local FastPForLib::Simple8b<false> codec;
-        thread_local std::vector<uint8_t> buf(2 * 8 * block_size);
-        size_t out_len = buf.size();
-        codec.encodeArray(in, n, reinterpret_cast<uint32_t*>(buf.data()), out_len);
-        out_len *= 4;
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        // Every 64-bit word holds at least one value.
+        encode_in_place(out, 8 * n, [&](uint8_t* dst) {
+            size_t out_len = 2 * n;
+            codec.encodeArray(in, n, reinterpret_cast<uint32_t*>(dst), out_len);
+            return out_len * 4;
+        });
     }
 
     static uint8_t const*
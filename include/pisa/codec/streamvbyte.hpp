@@ -4,6 +4,9 @@
 #include <vector>
 
 #include "streamvbyte/include/streamvbyte.h"
+#include "streamvbyte/include/streamvbytedelta.h"
+
+#include "codec/block_codecs.hpp"
 
 namespace pisa {
 
@@ -14,9 +17,9 @@ struct streamvbyte_block {
     {
         assert(n <= block_size);
         uint32_t* src = const_cast<uint32_t*>(in);
-        thread_local std::vector<uint8_t> buf(streamvbyte_max_compressedbytes(block_size));
-        size_t out_len = streamvbyte_encode(src, n, buf.data());
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        encode_in_place(out, streamvbyte_max_compressedbytes(n), [&](uint8_t* dst) {
+            return streamvbyte_encode(src, n, dst);
+        });
     }
     static uint8_t const*
     decode(uint8_t const* in, uint32_t* out, uint32_t /* sum_of_values */, size_t n)
@@ -26,4 +29,48 @@ struct streamvbyte_block {
         return in + read;
     }
 };
+
+/// Stream VByte storing the docid gaps of a block incremented by one, i.e., the differences
+/// between consecutive docids, so that `decode_docids` recovers the docids with the
+/// library's delta decoding, in a single pass into the enumerator buffer. Frequency blocks,
+/// without a sum of values, are stored as with `streamvbyte_block`.
+struct streamvbyte_delta_block {
+    static const uint64_t block_size = 128;
+    static void
+    encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
+    {
+        assert(n <= block_size);
+        if (sum_of_values == uint32_t(-1)) {
+            streamvbyte_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+        thread_local std::vector<uint32_t> deltas(block_size);
+        for (size_t i = 0; i < n; ++i) {
+            deltas[i] = in[i] + 1;
+        }
+        streamvbyte_block::encode(deltas.data(), sum_of_values, n, out);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
+    {
+        assert(n <= block_size);
+        auto read = streamvbyte_decode(in, out, n);
+        if (sum_of_values != uint32_t(-1)) {
+            for (size_t i = 0; i < n; ++i) {
+                out[i] -= 1;
+            }
+        }
+        return in + read;
+    }
+
+    /// Decodes the docids of a block whose first docid is at least `base`.
+    static uint8_t const* decode_docids(uint8_t const* in, uint32_t* out, uint32_t base, size_t n)
+    {
+        assert(n <= block_size);
+        // the differences are taken from the docid before the block, wrapping around for 0
+        auto read = streamvbyte_delta_decode(in, out, n, base - 1);
+        return in + read;
+    }
+};
+
 }  // namespace pisa
\ No newline at end of file
@@ -236,20 +236,22 @@ class VarIntGB {
 template <bool delta>
 uint32_t VarIntGB<delta>::mask[4] = {0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF};
 
-struct varintgb_block {
-    static const uint64_t block_size = 128;
+template <uint64_t BlockSize>
+struct basic_varintgb_block {
+    static constexpr uint64_t block_size = BlockSize;
 
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
     {
         thread_local VarIntGB<false> varintgb_codec;
         assert(n <= block_size);
         if (n < block_size) {
-            interpolative_block::encode(in, sum_of_values, n, out);
+            basic_interpolative_block<block_size>::encode(in, sum_of_values, n, out);
             return;
         }
-        thread_local std::vector<uint8_t> buf(2 * block_size * sizeof(uint32_t));
-        size_t out_len = varintgb_codec.encodeArray(in, n, buf.data());
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        // Four bytes per value and a selector byte per group of four.
+        encode_in_place(out, 4 * n + ceil_div(n, 4), [&](uint8_t* dst) {
+            return varintgb_codec.encodeArray(in, n, dst);
+        });
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
@@ -257,10 +259,20 @@ struct varintgb_block {
         thread_local VarIntGB<false> varintgb_codec;
         assert(n <= block_size);
         if (PISA_UNLIKELY(n < block_size)) {
-            return interpolative_block::decode(in, out, sum_of_values, n);
+            return basic_interpolative_block<block_size>::decode(in, out, sum_of_values, n);
         }
         auto read = varintgb_codec.decodeArray(in, n, out);
         return read + in;
     }
+
+    /// Decodes the next `n` values of a full block; groups of four values are self-contained.
+    static uint8_t const* decode_partial(uint8_t const* in, uint32_t* out, size_t n)
+    {
+        thread_local VarIntGB<false> varintgb_codec;
+        assert(n % 4 == 0);
+        return in + varintgb_codec.decodeArray(in, n, out);
+    }
 };
+
+using varintgb_block = basic_varintgb_block<128>;
 }  // namespace pisa
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include "deleted_documents.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Collects the top `k` results of a query processed by several threads at once.
+///
+/// Every thread inserts into its own `local()` queue, without synchronization, and all local
+/// queues share a threshold, raised with a compare-and-swap whenever one of them finds a higher
+/// k-th score. Since `local()` is a `basic_topk_queue`, any query algorithm can process a part
+/// of the query, e.g., a docid range, into it. Once all threads are done, `merge` gathers the
+/// local results.
+template <typename Score>
+class basic_concurrent_topk_queue {
+  public:
+    using queue_type = basic_topk_queue<Score>;
+    using entry_type = typename queue_type::entry_type;
+
+    explicit basic_concurrent_topk_queue(
+        uint64_t k, deleted_documents const* deleted = nullptr, Score threshold = 0)
+        : m_k(k),
+          m_deleted(deleted),
+          m_threshold(threshold),
+          m_local([this] {
+              queue_type topk(m_k, m_deleted);
+              topk.share_threshold(&m_threshold);
+              return topk;
+          })
+    {}
+    basic_concurrent_topk_queue(basic_concurrent_topk_queue const&) = delete;
+    basic_concurrent_topk_queue(basic_concurrent_topk_queue&&) = delete;
+    basic_concurrent_topk_queue& operator=(basic_concurrent_topk_queue const&) = delete;
+    basic_concurrent_topk_queue& operator=(basic_concurrent_topk_queue&&) = delete;
+
+    /// Returns the queue of the calling thread.
+    [[nodiscard]] auto local() -> queue_type& { return m_local.local(); }
+
+    /// Returns the highest threshold reached by any thread, or the initial one.
+    [[nodiscard]] auto threshold() const noexcept -> Score { return m_threshold.load(); }
+
+    [[nodiscard]] auto size() const noexcept -> uint64_t { return m_k; }
+
+    /// Inserts the results of all local queues into `topk`, which keeps the `k` highest once
+    /// finalized. Local queues are finalized in the process, and must not be used afterwards.
+    void merge(queue_type& topk)
+    {
+        for (auto& local: m_local) {
+            local.finalize();
+            for (auto const& [score, docid]: local.topk()) {
+                topk.insert(score, docid);
+            }
+        }
+    }
+
+    /// Returns the merged top `k` results, highest score first.
+    [[nodiscard]] auto topk() -> std::vector<entry_type>
+    {
+        queue_type topk(m_k);
+        merge(topk);
+        topk.finalize();
+        return topk.topk();
+    }
+
+  private:
+    uint64_t m_k;
+    deleted_documents const* m_deleted;
+    basic_shared_threshold<Score> m_threshold;
+    tbb::enumerable_thread_specific<queue_type> m_local;
+};
+
+using concurrent_topk_queue = basic_concurrent_topk_queue<float>;
+
+}  // namespace pisa
@@ -19,12 +19,24 @@ class configuration {
 
     size_t quantization_bits;
     bool heuristic_greedy;
+    /// Approximation parameters of the optimal partitioning of partitioned Elias-Fano lists.
+    /// Larger values build indexes faster, at the cost of a slightly larger index.
+    double partition_eps1;
+    double partition_eps2;
+    double partition_eps3;
+    /// Number of optpfor bit widths, among those with the smallest estimated size, that the
+    /// mixed block encoder evaluates for every block; zero evaluates all of them.
+    size_t mixed_block_pfor_candidates;
 
   private:
     configuration()
     {
         fillvar("PISA_HEURISTIC_GREEDY", heuristic_greedy, false);
         fillvar("PISA_QUANTIZTION_BITS", quantization_bits, 8);
+        fillvar("PISA_PARTITION_EPS1", partition_eps1, 0.03);
+        fillvar("PISA_PARTITION_EPS2", partition_eps2, 0.3);
+        fillvar("PISA_PARTITION_EPS3", partition_eps3, 0.01);
+        fillvar("PISA_MIXED_BLOCK_PFOR_CANDIDATES", mixed_block_pfor_candidates, 2);
     }
 
     template <typename T, typename T2>
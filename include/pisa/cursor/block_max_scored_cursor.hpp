@@ -1,43 +1,120 @@
 #pragma once
 
+#include "cursor/max_scored_cursor.hpp"
 #include "query/queries.hpp"
 #include "scorer/index_scorer.hpp"
+#include "scorer/quantized.hpp"
+#include "topk_queue.hpp"
 #include "wand_data.hpp"
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 namespace pisa {
 
-template <typename Index, typename WandType>
-struct block_max_scored_cursor {
-    using enum_type = typename Index::document_enumerator;
+/// A `max_scored_cursor` with the block-max enumerator of its list.
+///
+/// The factories below give cursors summing integer scores with the quantized scorer the
+/// impacts of their lists as scores, see `make_score_term_scorer`.
+template <
+    typename Index,
+    typename WandType,
+    typename TermScorer = term_scorer_t,
+    typename Score = float>
+struct block_max_scored_cursor: max_scored_cursor<Index, TermScorer, Score> {
     using wdata_enum = typename WandType::wand_data_enumerator;
 
-    enum_type docs_enum;
     wdata_enum w;
-    float q_weight;
-    term_scorer_t scorer;
-    float max_weight;
 };
 
-template <typename Index, typename WandType, typename Scorer>
+template <typename Score = float, typename Index, typename WandType, typename Scorer>
 [[nodiscard]] auto make_block_max_scored_cursors(
     Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto query_term_weights = query_weights(query);
 
-    std::vector<block_max_scored_cursor<Index, WandType>> cursors;
-    cursors.reserve(query_term_freqs.size());
+    using cursor_type =
+        block_max_scored_cursor<Index, WandType, score_term_scorer_type_t<Scorer, Score>, Score>;
+    std::vector<cursor_type> cursors;
+    cursors.reserve(query_term_weights.size());
     std::transform(
-        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
+        query_term_weights.begin(),
+        query_term_weights.end(),
+        std::back_inserter(cursors),
+        [&](auto&& term) {
             auto list = index[term.first];
             auto w_enum = wdata.getenum(term.first);
-            float q_weight = term.second;
-            auto max_weight = q_weight * wdata.max_term_weight(term.first);
-            return block_max_scored_cursor<Index, WandType>{
-                std::move(list), w_enum, q_weight, scorer.term_scorer(term.first), max_weight};
+            auto q_weight = static_cast<Score>(term.second);
+            auto max_weight = q_weight * ceil_score<Score>(wdata.max_term_weight(term.first));
+            return cursor_type{
+                {{std::move(list), q_weight, make_score_term_scorer(scorer, term.first, q_weight)},
+                 max_weight},
+                w_enum};
         });
     return cursors;
 }
 
-}  // namespace pisa
\ No newline at end of file
+/// Same as above, but with term scores memoized in `memo`, which must outlive the cursors.
+template <typename Score = float, typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_block_max_scored_cursors(
+    Index const& index, WandType const& wdata, Scorer const& scorer, Query query, score_memo& memo)
+{
+    auto query_term_weights = query_weights(query);
+
+    using cursor_type = block_max_scored_cursor<
+        Index,
+        WandType,
+        memoized_weighted_term_scorer_type_t<Scorer>,
+        Score>;
+    std::vector<cursor_type> cursors;
+    cursors.reserve(query_term_weights.size());
+    for (auto [term, weight]: query_term_weights) {
+        auto q_weight = static_cast<Score>(weight);
+        auto max_weight = q_weight * ceil_score<Score>(wdata.max_term_weight(term));
+        cursors.push_back(cursor_type{
+            {{index[term],
+              q_weight,
+              make_memoized_weighted_term_scorer(scorer, term, q_weight, memo)},
+             max_weight},
+            wdata.getenum(term)});
+    }
+    return cursors;
+}
+
+/// Same as above, but allocated from `arena`, which must outlive the cursors.
+template <typename Score = float, typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_block_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    query_arena& arena)
+{
+    auto query_term_weights = query_weights(query, arena);
+
+    using cursor_type =
+        block_max_scored_cursor<Index, WandType, score_term_scorer_type_t<Scorer, Score>, Score>;
+    arena_vector<cursor_type> cursors{arena_allocator<cursor_type>(arena)};
+    cursors.reserve(query_term_weights.size());
+    for (auto [term, weight]: query_term_weights) {
+        auto q_weight = static_cast<Score>(weight);
+        auto max_weight = q_weight * ceil_score<Score>(wdata.max_term_weight(term));
+        cursors.push_back(cursor_type{
+            {{index[term], q_weight, make_score_term_scorer(scorer, term, q_weight)}, max_weight},
+            wdata.getenum(term)});
+    }
+    return cursors;
+}
+
+/// Calls `fn` with a value of the type of the scores that block-max algorithms sum with the scorer
+/// `scorer_name`: `uint32_t` for quantized scores, whose sums are exact, and `float` otherwise.
+template <typename Fn>
+decltype(auto) with_block_max_score_type(std::string_view scorer_name, Fn&& fn)
+{
+    if (scorer_name == "quantized") {
+        return fn(uint32_t{});
+    }
+    return fn(float{});
+}
+
+}  // namespace pisa
@@ -1,10 +1,124 @@
 #pragma once
 
 #include "query/queries.hpp"
+#include <cstddef>
+#include <gsl/span>
+#include <type_traits>
 #include <vector>
 
 namespace pisa {
 
+/// Query algorithms traverse posting lists with cursors, which all share one layout:
+///
+///  - `scored_cursor` holds the enumerator of a list, `docs_enum`, the weight of its term in the
+///    query, `q_weight`, and its term scorer, `scorer`;
+///  - `max_scored_cursor` extends it with the upper bound of the scores of the list,
+///    `max_weight`;
+///  - `block_max_scored_cursor` further extends it with the block-max enumerator of the list,
+///    `w`.
+///
+/// Algorithms written for a cursor can thus run on the cursors that extend it. Enumerators
+/// move with `next`, `next_geq`, and, to probe a batch of docids, `next_geq_many`.
+
+/// Detects enumerators that can expose a whole decoded block at once,
+/// such as `block_posting_list::document_enumerator`.
+template <typename Enumerator, typename = void>
+struct has_block_interface: std::false_type {
+};
+
+template <typename Enumerator>
+struct has_block_interface<
+    Enumerator,
+    std::void_t<
+        decltype(std::declval<Enumerator&>().block_docids()),
+        decltype(std::declval<Enumerator&>().block_freqs()),
+        decltype(std::declval<Enumerator&>().next_block())>>: std::true_type {
+};
+
+template <typename Enumerator>
+constexpr bool has_block_interface_v = has_block_interface<Enumerator>::value;
+
+/// Detects enumerators that can prefetch the block of a docid ahead of moving to it.
+template <typename Enumerator, typename = void>
+struct has_prefetch: std::false_type {
+};
+
+template <typename Enumerator>
+struct has_prefetch<
+    Enumerator,
+    std::void_t<decltype(std::declval<Enumerator const&>().prefetch(uint64_t{}, uint32_t{}))>>
+    : std::true_type {
+};
+
+template <typename Enumerator>
+constexpr bool has_prefetch_v = has_prefetch<Enumerator>::value;
+
+/// Detects enumerators that decode the frequencies of a run of postings at once with `freqs`,
+/// such as `freq_index::document_enumerator`.
+template <typename Enumerator, typename = void>
+struct has_bulk_freqs: std::false_type {
+};
+
+template <typename Enumerator>
+struct has_bulk_freqs<
+    Enumerator,
+    std::void_t<decltype(std::declval<Enumerator&>().freqs(std::declval<gsl::span<uint64_t>>()))>>
+    : std::true_type {
+};
+
+template <typename Enumerator>
+constexpr bool has_bulk_freqs_v = has_bulk_freqs<Enumerator>::value;
+
+/// Detects enumerators that probe a batch of docids at once with `next_geq_many`.
+template <typename Enumerator, typename = void>
+struct has_next_geq_many: std::false_type {
+};
+
+template <typename Enumerator>
+struct has_next_geq_many<
+    Enumerator,
+    std::void_t<decltype(std::declval<Enumerator&>().next_geq_many(
+        std::declval<gsl::span<uint64_t const>>(),
+        std::declval<void (*)(std::size_t, uint64_t)>()))>>
+    : std::true_type {
+};
+
+/// Moves `list` to each of the nondecreasing docids `targets` in turn, as `next_geq`, and calls
+/// `fn(i, freq)` for every `targets[i]` in the list, e.g., to verify candidates. Enumerators
+/// that implement `next_geq_many` probe the targets of a block together; others move to one
+/// target at a time.
+template <typename Enumerator, typename Fn>
+void next_geq_many(Enumerator& list, gsl::span<uint64_t const> targets, Fn&& fn)
+{
+    if constexpr (has_next_geq_many<Enumerator>::value) {
+        list.next_geq_many(targets, fn);
+    } else {
+        for (std::size_t i = 0; i < targets.size(); ++i) {
+            list.next_geq(targets[i]);
+            if (list.docid() == targets[i]) {
+                fn(i, list.freq());
+            }
+        }
+    }
+}
+
+/// Restores the order by increasing docid of `cursors`, sorted so before their first `moved`
+/// cursors advanced, e.g., past a scored pivot. Each advanced cursor is inserted into the
+/// sorted rest, which is cheaper than sorting them all again when few lists move at a time.
+template <typename Cursor>
+void reorder_moved_cursors(std::vector<Cursor*>& cursors, std::size_t moved)
+{
+    for (auto idx = moved; idx > 0; --idx) {
+        auto* cursor = cursors[idx - 1];
+        auto docid = cursor->docs_enum.docid();
+        auto pos = idx;
+        for (; pos < cursors.size() && cursors[pos]->docs_enum.docid() < docid; ++pos) {
+            cursors[pos - 1] = cursors[pos];
+        }
+        cursors[pos - 1] = cursor;
+    }
+}
+
 template <typename Index>
 [[nodiscard]] auto make_cursors(Index const& index, Query query)
 {
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "query/queries.hpp"
+
+namespace pisa {
+
+template <typename Index>
+struct impact_cursor {
+    using list_type = typename Index::posting_list;
+    list_type postings;
+    float q_weight;
+};
+
+template <typename Index>
+[[nodiscard]] auto make_impact_cursors(Index const& index, Query query)
+{
+    auto query_term_weights = query_weights(query);
+
+    std::vector<impact_cursor<Index>> cursors;
+    cursors.reserve(query_term_weights.size());
+    std::transform(
+        query_term_weights.begin(),
+        query_term_weights.end(),
+        std::back_inserter(cursors),
+        [&](auto&& term) {
+            return impact_cursor<Index>{index[term.first], term.second};
+        });
+    return cursors;
+}
+
+}  // namespace pisa
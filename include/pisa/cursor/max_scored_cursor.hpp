@@ -1,39 +1,86 @@
 #pragma once
 
+#include "cursor/scored_cursor.hpp"
 #include "query/queries.hpp"
 #include "scorer/index_scorer.hpp"
+#include "scorer/score_memo.hpp"
 #include "wand_data.hpp"
 #include <vector>
 
 namespace pisa {
 
-template <typename Index>
-struct max_scored_cursor {
-    using enum_type = typename Index::document_enumerator;
-    enum_type docs_enum;
-    float q_weight;
-    term_scorer_t scorer;
-    float max_weight;
+/// A `scored_cursor` with the upper bound of the scores of its list.
+template <typename Index, typename TermScorer = term_scorer_t, typename Score = float>
+struct max_scored_cursor: scored_cursor<Index, TermScorer, Score> {
+    Score max_weight;
 };
 
 template <typename Index, typename WandType, typename Scorer>
 [[nodiscard]] auto
 make_max_scored_cursors(Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto query_term_weights = query_weights(query);
 
-    std::vector<max_scored_cursor<Index>> cursors;
-    cursors.reserve(query_term_freqs.size());
+    using cursor_type = max_scored_cursor<Index, weighted_term_scorer_type_t<Scorer>>;
+    std::vector<cursor_type> cursors;
+    cursors.reserve(query_term_weights.size());
     std::transform(
-        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
+        query_term_weights.begin(),
+        query_term_weights.end(),
+        std::back_inserter(cursors),
+        [&](auto&& term) {
             auto list = index[term.first];
             float q_weight = term.second;
             auto max_weight = q_weight * wdata.max_term_weight(term.first);
-            return max_scored_cursor<Index>{
-                std::move(list), q_weight, scorer.term_scorer(term.first), max_weight};
+            return cursor_type{
+                {std::move(list), q_weight, make_weighted_term_scorer(scorer, term.first, q_weight)},
+                max_weight};
         });
     return cursors;
 }
 
+/// Same as above, but with term scores memoized in `memo`, which must outlive the cursors.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_max_scored_cursors(
+    Index const& index, WandType const& wdata, Scorer const& scorer, Query query, score_memo& memo)
+{
+    auto query_term_weights = query_weights(query);
+
+    using cursor_type = max_scored_cursor<Index, memoized_weighted_term_scorer_type_t<Scorer>>;
+    std::vector<cursor_type> cursors;
+    cursors.reserve(query_term_weights.size());
+    for (auto [term, weight]: query_term_weights) {
+        float q_weight = weight;
+        auto max_weight = q_weight * wdata.max_term_weight(term);
+        cursors.push_back(cursor_type{
+            {index[term], q_weight, make_memoized_weighted_term_scorer(scorer, term, q_weight, memo)},
+            max_weight});
+    }
+    return cursors;
+}
+
+/// Same as above, but allocated from `arena`, which must outlive the cursors.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    query_arena& arena)
+{
+    auto query_term_weights = query_weights(query, arena);
+
+    using cursor_type = max_scored_cursor<Index, weighted_term_scorer_type_t<Scorer>>;
+    arena_vector<cursor_type> cursors{arena_allocator<cursor_type>(arena)};
+    cursors.reserve(query_term_weights.size());
+    for (auto [term, weight]: query_term_weights) {
+        float q_weight = weight;
+        auto max_weight = q_weight * wdata.max_term_weight(term);
+        cursors.push_back(cursor_type{
+            {index[term], q_weight, make_weighted_term_scorer(scorer, term, q_weight)},
+            max_weight});
+    }
+    return cursors;
+}
+
 }  // namespace pisa
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cursor/cursor.hpp"
 #include "query/queries.hpp"
 #include "scorer/index_scorer.hpp"
 #include "wand_data.hpp"
@@ -7,27 +8,35 @@
 
 namespace pisa {
 
-template <typename Index>
+/// `Score` is the type of the weights, and of the scores summed by block-max algorithms, which can
+/// be an integer type if all term and block scores are quantized.
+template <typename Index, typename TermScorer = term_scorer_t, typename Score = float>
 struct scored_cursor {
     using enum_type = typename Index::document_enumerator;
+    using score_type = Score;
+
     enum_type docs_enum;
-    float q_weight;
-    term_scorer_t scorer;
+    Score q_weight;
+    TermScorer scorer;
 };
 
 template <typename Index, typename Scorer>
 [[nodiscard]] auto make_scored_cursors(Index const& index, Scorer const& scorer, Query query)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto query_term_weights = query_weights(query);
 
-    std::vector<scored_cursor<Index>> cursors;
-    cursors.reserve(query_term_freqs.size());
+    using cursor_type = scored_cursor<Index, weighted_term_scorer_type_t<Scorer>>;
+    std::vector<cursor_type> cursors;
+    cursors.reserve(query_term_weights.size());
     std::transform(
-        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
+        query_term_weights.begin(),
+        query_term_weights.end(),
+        std::back_inserter(cursors),
+        [&](auto&& term) {
             auto list = index[term.first];
             float q_weight = term.second;
-            return scored_cursor<Index>{std::move(list), q_weight, scorer.term_scorer(term.first)};
+            return cursor_type{
+                std::move(list), q_weight, make_weighted_term_scorer(scorer, term.first, q_weight)};
         });
     return cursors;
 }
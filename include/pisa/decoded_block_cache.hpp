@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gsl/span>
+
+namespace pisa {
+
+/// A process-wide cache of the decoded docids and frequencies of the blocks of frequent lists,
+/// shared by the queries of all threads, so that the blocks of terms found in many queries are
+/// decoded once rather than by every query.
+///
+/// The blocks that may be cached are chosen when the cache is built: all the blocks of the
+/// given terms, most frequent first, as long as the capacity allows, so that memory is bounded
+/// before any block is cached. A block is then cached the first time a list decodes it, and
+/// published with a compare-and-swap, so that reading the cache takes no lock: looking up a
+/// block is an index into the slots of its term and an atomic load. Cached blocks are never
+/// evicted, and are freed with the cache.
+class decoded_block_cache {
+  public:
+    /// The slots of the blocks of one term, empty if the term is not cached.
+    struct term_slots {
+        std::atomic<std::uint32_t const*>* slots = nullptr;
+        std::uint32_t blocks = 0;
+    };
+
+    /// Bytes taken by a cached block of `block_size` postings.
+    [[nodiscard]] static constexpr auto block_bytes(std::size_t block_size) -> std::size_t
+    {
+        return (2 * block_size + 1) * sizeof(std::uint32_t);
+    }
+
+    /// Admits the blocks of `terms`, whose lists have `blocks[i]` blocks of at most
+    /// `block_size` postings, in order, and the first blocks of the term that does not fit
+    /// whole, until they would take more than `capacity` bytes. Terms out of range of the
+    /// index, i.e., with no blocks, and repeated terms are skipped.
+    decoded_block_cache(
+        std::vector<std::uint32_t> const& terms,
+        std::vector<std::uint32_t> const& blocks,
+        std::size_t block_size,
+        std::size_t capacity);
+    decoded_block_cache(decoded_block_cache const&) = delete;
+    decoded_block_cache& operator=(decoded_block_cache const&) = delete;
+    ~decoded_block_cache();
+
+    [[nodiscard]] auto slots(std::uint32_t term) -> term_slots
+    {
+        if (term >= m_first_slot.size() || m_first_slot[term] == no_slot) {
+            return {};
+        }
+        return {&m_slots[m_first_slot[term]], m_term_blocks[term]};
+    }
+
+    /// Returns the decoded block in `slot`: its size `n`, followed by its `n` docids and its
+    /// `n` frequencies, or `nullptr` if it is not cached yet.
+    [[nodiscard]] static auto find(term_slots slots, std::uint32_t block) -> std::uint32_t const*
+    {
+        return slots.slots[block].load(std::memory_order_acquire);
+    }
+
+    /// Caches the decoded `docs` and `freqs` of `block` unless another thread did first, and
+    /// returns the cached block.
+    static auto insert(
+        term_slots slots,
+        std::uint32_t block,
+        gsl::span<std::uint32_t const> docs,
+        gsl::span<std::uint32_t const> freqs) -> std::uint32_t const*;
+
+    /// Returns the number of blocks that may be cached.
+    [[nodiscard]] auto admitted_blocks() const -> std::size_t { return m_slot_count; }
+
+    /// Returns the number of blocks cached so far.
+    [[nodiscard]] auto cached_blocks() const -> std::size_t;
+
+  private:
+    static constexpr std::uint32_t no_slot = 0xFFFFFFFF;
+
+    std::vector<std::uint32_t> m_first_slot;
+    std::vector<std::uint32_t> m_term_blocks;
+    std::size_t m_slot_count = 0;
+    std::unique_ptr<std::atomic<std::uint32_t const*>[]> m_slots;
+};
+
+/// Builds a cache of up to `capacity` bytes of the decoded blocks of the lists of `hot_terms`
+/// of `index`, e.g., the terms of a query log, most frequent first.
+template <typename Index>
+[[nodiscard]] auto make_decoded_block_cache(
+    Index const& index, std::vector<std::uint32_t> const& hot_terms, std::size_t capacity)
+    -> std::unique_ptr<decoded_block_cache>
+{
+    std::vector<std::uint32_t> blocks(hot_terms.size(), 0);
+    for (std::size_t idx = 0; idx < hot_terms.size(); ++idx) {
+        if (hot_terms[idx] < index.size()) {
+            blocks[idx] = index[hot_terms[idx]].num_blocks();
+        }
+    }
+    return std::make_unique<decoded_block_cache>(
+        hot_terms, blocks, Index::block_size, capacity);
+}
+
+}  // namespace pisa
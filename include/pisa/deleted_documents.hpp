@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/format.h>
+#include <gsl/span>
+
+#include "bit_vector.hpp"
+#include "mappable/mappable_vector.hpp"
+
+namespace pisa {
+
+/// A set of documents taken down from an index without rebuilding it.
+///
+/// Deleted documents keep their postings, but `topk_queue` drops them when they would enter
+/// the top-k, so every ranked query algorithm honors the deletions at the cost of at most one
+/// bit probe per candidate that beats the current threshold. MaxScore, Block-Max MaxScore and
+/// Block-Max WAND probe candidates before scoring them instead, and skip their scoring.
+///
+/// A filter, restricting queries to a subset of documents, is the deletion of its complement,
+/// built with `keeping`.
+class deleted_documents {
+  public:
+    deleted_documents() = default;
+
+    template <typename DocumentRange>
+    deleted_documents(uint64_t num_docs, DocumentRange const& deleted)
+    {
+        std::vector<bool> bits(num_docs);
+        for (auto docid: deleted) {
+            if (docid >= num_docs) {
+                throw std::out_of_range(fmt::format(
+                    "Cannot delete document {} of a collection of {} documents", docid, num_docs));
+            }
+            if (not bits[docid]) {
+                bits[docid] = true;
+                m_count += 1;
+            }
+        }
+        bit_vector(bits).swap(m_bits);
+    }
+
+    /// Returns the deletions that filter a collection of `num_docs` documents down to `kept`,
+    /// so that queries are restricted to an arbitrary subset of documents, such as the
+    /// documents of a language or of a user, with the same block summaries as deletions.
+    template <typename DocumentRange>
+    [[nodiscard]] static auto keeping(uint64_t num_docs, DocumentRange const& kept)
+        -> deleted_documents
+    {
+        std::vector<bool> bits(num_docs, true);
+        deleted_documents filter;
+        filter.m_count = num_docs;
+        for (auto docid: kept) {
+            if (docid >= num_docs) {
+                throw std::out_of_range(fmt::format(
+                    "Cannot keep document {} of a collection of {} documents", docid, num_docs));
+            }
+            if (bits[docid]) {
+                bits[docid] = false;
+                filter.m_count -= 1;
+            }
+        }
+        bit_vector(bits).swap(filter.m_bits);
+        return filter;
+    }
+
+    [[nodiscard]] auto is_deleted(uint64_t docid) const -> bool { return m_bits[docid]; }
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_bits.size(); }
+    [[nodiscard]] auto count() const -> uint64_t { return m_count; }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_bits, "m_bits")(m_count, "m_count");
+    }
+
+  private:
+    bit_vector m_bits;
+    uint64_t m_count = 0;
+};
+
+/// The blocks of the block-max data of an index whose documents are all deleted, listed for
+/// each term by the last document ID of the block, as returned by the block-max enumerator.
+class deleted_blocks {
+  public:
+    deleted_blocks() = default;
+
+    template <typename Index, typename BlockMaxData>
+    deleted_blocks(
+        Index const& index, BlockMaxData const& block_max_data, deleted_documents const& deleted)
+    {
+        if (deleted.num_docs() != index.num_docs()) {
+            throw std::invalid_argument(fmt::format(
+                "Deleted documents are given for {} documents, but the index has {}",
+                deleted.num_docs(),
+                index.num_docs()));
+        }
+        std::vector<uint64_t> offsets{0};
+        std::vector<uint32_t> block_ends;
+        for (uint64_t term_id = 0; term_id < index.size(); ++term_id) {
+            auto block_max = block_max_data.getenum(term_id);
+            auto list = index[term_id];
+            while (list.docid() < index.num_docs()) {
+                block_max.next_geq(list.docid());
+                auto block_end = block_max.docid();
+                bool all_deleted = true;
+                do {
+                    all_deleted = all_deleted and deleted.is_deleted(list.docid());
+                    list.next();
+                } while (list.docid() <= block_end and list.docid() < index.num_docs());
+                if (all_deleted) {
+                    block_ends.push_back(block_end);
+                }
+            }
+            offsets.push_back(block_ends.size());
+        }
+        m_offsets.steal(offsets);
+        m_block_ends.steal(block_ends);
+    }
+
+    [[nodiscard]] auto size() const -> uint64_t { return m_offsets.size() - 1; }
+
+    [[nodiscard]] auto block_ends(uint64_t term_id) const -> gsl::span<uint32_t const>
+    {
+        if (term_id >= size()) {
+            return {};
+        }
+        return gsl::make_span(
+            m_block_ends.data() + m_offsets[term_id],
+            m_block_ends.data() + m_offsets[term_id + 1]);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_offsets, "m_offsets")(m_block_ends, "m_block_ends");
+    }
+
+  private:
+    mapper::mappable_vector<uint64_t> m_offsets;
+    mapper::mappable_vector<uint32_t> m_block_ends;
+};
+
+/// Block-max data in which the maxima of the blocks in `deleted_blocks` are zero, so that
+/// block-max algorithms skip them without decoding their postings.
+template <typename BlockMaxData>
+class deleted_block_max_data {
+  public:
+    class enumerator {
+      public:
+        enumerator(
+            typename BlockMaxData::wand_data_enumerator block_max,
+            gsl::span<uint32_t const> deleted)
+            : m_block_max(std::move(block_max)),
+              m_next_deleted(deleted.data()),
+              m_end_deleted(deleted.data() + deleted.size())
+        {}
+
+        void next_geq(uint64_t lower_bound)
+        {
+            m_block_max.next_geq(lower_bound);
+            auto block_end = m_block_max.docid();
+            while (m_next_deleted != m_end_deleted and *m_next_deleted < block_end) {
+                ++m_next_deleted;
+            }
+        }
+
+        [[nodiscard]] auto score() -> float
+        {
+            if (m_next_deleted != m_end_deleted and *m_next_deleted == m_block_max.docid()) {
+                return 0.0F;
+            }
+            return m_block_max.score();
+        }
+
+        [[nodiscard]] auto docid() -> uint64_t { return m_block_max.docid(); }
+
+      private:
+        typename BlockMaxData::wand_data_enumerator m_block_max;
+        uint32_t const* m_next_deleted;
+        uint32_t const* m_end_deleted;
+    };
+
+    using wand_data_enumerator = enumerator;
+
+    deleted_block_max_data(BlockMaxData const& data, deleted_blocks const& blocks)
+        : m_data(data), m_blocks(blocks)
+    {}
+
+    [[nodiscard]] auto getenum(uint64_t term_id) const -> enumerator
+    {
+        return enumerator(m_data.getenum(term_id), m_blocks.block_ends(term_id));
+    }
+
+    [[nodiscard]] auto max_term_weight(uint64_t term_id) const -> float
+    {
+        return m_data.max_term_weight(term_id);
+    }
+
+  private:
+    BlockMaxData const& m_data;
+    deleted_blocks const& m_blocks;
+};
+
+}  // namespace pisa
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace pisa {
+
+/// A mutable, uncompressed segment of documents appended after an immutable index.
+///
+/// Documents get consecutive IDs starting at `first_document`, which is the number of documents
+/// of the index it extends, so that appending keeps every posting list sorted. New terms may be
+/// added past the size of the extended index. The segment must not be modified while it is
+/// being queried.
+class delta_index {
+  public:
+    explicit delta_index(uint64_t first_document = 0) : m_first_document(first_document) {}
+
+    /// Appends a document given as the sequence of its term IDs, and returns its ID.
+    template <typename TermRange>
+    auto add_document(TermRange const& terms) -> uint64_t
+    {
+        uint64_t docid = num_docs();
+        m_terms.assign(std::begin(terms), std::end(terms));
+        std::sort(m_terms.begin(), m_terms.end());
+        for (auto first = m_terms.begin(); first != m_terms.end();) {
+            auto last = std::upper_bound(first, m_terms.end(), *first);
+            if (*first >= m_lists.size()) {
+                m_lists.resize(*first + 1);
+            }
+            auto& list = m_lists[*first];
+            list.docs.push_back(docid);
+            list.freqs.push_back(static_cast<uint32_t>(std::distance(first, last)));
+            list.occurrences += list.freqs.back();
+            first = last;
+        }
+        m_doc_lens.push_back(m_terms.size());
+        m_collection_len += m_terms.size();
+        return docid;
+    }
+
+    [[nodiscard]] auto size() const -> uint64_t { return m_lists.size(); }
+    [[nodiscard]] auto first_document() const -> uint64_t { return m_first_document; }
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_first_document + m_doc_lens.size(); }
+    [[nodiscard]] auto collection_len() const -> uint64_t { return m_collection_len; }
+
+    [[nodiscard]] auto doc_len(uint64_t docid) const -> uint64_t
+    {
+        return m_doc_lens[docid - m_first_document];
+    }
+
+    [[nodiscard]] auto term_posting_count(uint64_t term_id) const -> uint64_t
+    {
+        return term_id < size() ? m_lists[term_id].docs.size() : 0;
+    }
+
+    [[nodiscard]] auto term_occurrence_count(uint64_t term_id) const -> uint64_t
+    {
+        return term_id < size() ? m_lists[term_id].occurrences : 0;
+    }
+
+    class document_enumerator {
+      public:
+        document_enumerator(
+            uint32_t const* docs, uint32_t const* freqs, uint64_t n, uint64_t universe)
+            : m_docs(docs), m_freqs(freqs), m_n(n), m_universe(universe)
+        {
+            reset();
+        }
+
+        void reset() { move(0); }
+        void next() { move(m_position + 1); }
+
+        void next_geq(uint64_t lower_bound)
+        {
+            if (lower_bound > m_cur_docid) {
+                move(std::distance(
+                    m_docs, std::lower_bound(m_docs + m_position, m_docs + m_n, lower_bound)));
+            }
+        }
+
+        void move(uint64_t position)
+        {
+            m_position = position;
+            m_cur_docid = position < m_n ? m_docs[position] : m_universe;
+        }
+
+        [[nodiscard]] auto docid() const -> uint64_t { return m_cur_docid; }
+        [[nodiscard]] auto freq() const -> uint64_t { return m_freqs[m_position]; }
+        [[nodiscard]] auto position() const -> uint64_t { return m_position; }
+        [[nodiscard]] auto size() const -> uint64_t { return m_n; }
+
+      private:
+        uint32_t const* m_docs;
+        uint32_t const* m_freqs;
+        uint64_t m_n;
+        uint64_t m_universe;
+        uint64_t m_position = 0;
+        uint64_t m_cur_docid = 0;
+    };
+
+    /// Returns the postings of `term_id`, which are empty for terms not in the segment.
+    [[nodiscard]] auto operator[](uint64_t term_id) const -> document_enumerator
+    {
+        if (term_id >= size()) {
+            return document_enumerator(nullptr, nullptr, 0, num_docs());
+        }
+        auto const& list = m_lists[term_id];
+        return document_enumerator(
+            list.docs.data(), list.freqs.data(), list.docs.size(), num_docs());
+    }
+
+  private:
+    struct posting_list {
+        std::vector<uint32_t> docs;
+        std::vector<uint32_t> freqs;
+        uint64_t occurrences = 0;
+    };
+
+    uint64_t m_first_document;
+    std::vector<posting_list> m_lists;
+    std::vector<uint64_t> m_doc_lens;
+    uint64_t m_collection_len = 0;
+    std::vector<uint64_t> m_terms;
+};
+
+/// An immutable index extended with a `delta_index`, queried as a single index.
+///
+/// Its cursors yield the postings of the base index followed by those of the delta, whose
+/// document IDs are all greater. A segmented index can itself be the base of another one,
+/// e.g., to keep appending documents to a new delta while an older one is compacted.
+template <typename Index>
+class segmented_index {
+  public:
+    using base_enumerator = typename Index::document_enumerator;
+
+    segmented_index(Index const& base, delta_index const& delta) : m_base(base), m_delta(delta)
+    {
+        if (delta.first_document() != base.num_docs()) {
+            throw std::invalid_argument(fmt::format(
+                "Delta segment starting at document {} cannot extend an index of {} documents",
+                delta.first_document(),
+                base.num_docs()));
+        }
+    }
+
+    [[nodiscard]] auto size() const -> uint64_t
+    {
+        return std::max<uint64_t>(m_base.size(), m_delta.size());
+    }
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_delta.num_docs(); }
+    [[nodiscard]] auto base() const -> Index const& { return m_base; }
+    [[nodiscard]] auto delta() const -> delta_index const& { return m_delta; }
+
+    class document_enumerator {
+      public:
+        document_enumerator(
+            std::optional<base_enumerator> base,
+            delta_index::document_enumerator delta,
+            uint64_t base_num_docs)
+            : m_base(std::move(base)), m_delta(delta), m_base_num_docs(base_num_docs)
+        {
+            m_in_base = m_base.has_value() and m_base->docid() < m_base_num_docs;
+        }
+
+        void reset()
+        {
+            if (m_base) {
+                m_base->reset();
+            }
+            m_delta.reset();
+            m_in_base = m_base.has_value() and m_base->docid() < m_base_num_docs;
+        }
+
+        void next()
+        {
+            if (m_in_base) {
+                m_base->next();
+                m_in_base = m_base->docid() < m_base_num_docs;
+            } else {
+                m_delta.next();
+            }
+        }
+
+        void next_geq(uint64_t lower_bound)
+        {
+            if (m_in_base) {
+                if (lower_bound < m_base_num_docs) {
+                    m_base->next_geq(lower_bound);
+                    if (m_base->docid() < m_base_num_docs) {
+                        return;
+                    }
+                }
+                m_in_base = false;
+            }
+            m_delta.next_geq(lower_bound);
+        }
+
+        [[nodiscard]] auto docid() const -> uint64_t
+        {
+            return m_in_base ? m_base->docid() : m_delta.docid();
+        }
+
+        [[nodiscard]] auto freq() -> uint64_t
+        {
+            return m_in_base ? m_base->freq() : m_delta.freq();
+        }
+
+        [[nodiscard]] auto position() const -> uint64_t
+        {
+            return m_in_base ? m_base->position() : base_size() + m_delta.position();
+        }
+
+        [[nodiscard]] auto size() const -> uint64_t { return base_size() + m_delta.size(); }
+
+      private:
+        [[nodiscard]] auto base_size() const -> uint64_t { return m_base ? m_base->size() : 0; }
+
+        std::optional<base_enumerator> m_base;
+        delta_index::document_enumerator m_delta;
+        uint64_t m_base_num_docs;
+        bool m_in_base = false;
+    };
+
+    [[nodiscard]] auto operator[](uint64_t term_id) const -> document_enumerator
+    {
+        std::optional<base_enumerator> base;
+        if (term_id < m_base.size()) {
+            base.emplace(m_base[term_id]);
+        }
+        return document_enumerator(std::move(base), m_delta[term_id], m_base.num_docs());
+    }
+
+  private:
+    Index const& m_base;
+    delta_index const& m_delta;
+};
+
+/// Collection statistics of a segmented index, for the scorers in `scorer/`.
+///
+/// Document lengths of the base come from its WAND data, and those of the delta from the
+/// segment, and term statistics include the postings of both. Maximum term weights are not
+/// provided, since those of the base are no upper bound for the delta; only query algorithms
+/// that need no score bounds, such as `ranked_or_query`, can score a segmented index.
+template <typename Wand>
+class segmented_wand_data {
+  public:
+    template <typename Index>
+    segmented_wand_data(Wand const& base, segmented_index<Index> const& index)
+        : m_base(base),
+          m_delta(index.delta()),
+          m_base_terms(index.base().size()),
+          m_collection_len(base.collection_len() + index.delta().collection_len()),
+          m_avg_len(static_cast<float>(m_collection_len / static_cast<double>(num_docs())))
+    {}
+
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_delta.num_docs(); }
+    [[nodiscard]] auto collection_len() const -> uint64_t { return m_collection_len; }
+    [[nodiscard]] auto avg_len() const -> float { return m_avg_len; }
+
+    [[nodiscard]] auto doc_len(uint64_t docid) const -> uint64_t
+    {
+        return docid < m_delta.first_document() ? m_base.doc_len(docid) : m_delta.doc_len(docid);
+    }
+
+    [[nodiscard]] auto norm_len(uint64_t docid) const -> float
+    {
+        return doc_len(docid) / m_avg_len;
+    }
+
+    [[nodiscard]] auto term_posting_count(uint64_t term_id) const -> uint64_t
+    {
+        return (term_id < m_base_terms ? m_base.term_posting_count(term_id) : 0)
+            + m_delta.term_posting_count(term_id);
+    }
+
+    [[nodiscard]] auto term_occurrence_count(uint64_t term_id) const -> uint64_t
+    {
+        return (term_id < m_base_terms ? m_base.term_occurrence_count(term_id) : 0)
+            + m_delta.term_occurrence_count(term_id);
+    }
+
+  private:
+    Wand const& m_base;
+    delta_index const& m_delta;
+    uint64_t m_base_terms;
+    uint64_t m_collection_len;
+    float m_avg_len;
+};
+
+/// Folds the delta of `index` into a new immutable index written with `builder`, which must
+/// have been created for `index.num_docs()` documents.
+///
+/// Neither segment is modified, so compaction can run in the background while queries keep
+/// using `index` and new documents go to another delta extending it.
+template <typename Index, typename Builder>
+void compact(segmented_index<Index> const& index, Builder& builder)
+{
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> freqs;
+    for (uint64_t term_id = 0; term_id < index.size(); ++term_id) {
+        docs.clear();
+        freqs.clear();
+        uint64_t occurrences = 0;
+        for (auto list = index[term_id]; list.docid() < index.num_docs(); list.next()) {
+            docs.push_back(list.docid());
+            freqs.push_back(list.freq());
+            occurrences += freqs.back();
+        }
+        if (docs.empty()) {
+            throw std::invalid_argument(fmt::format("Term {} has no postings", term_id));
+        }
+        builder.add_posting_list(docs.size(), docs.begin(), freqs.begin(), occurrences);
+    }
+}
+
+}  // namespace pisa
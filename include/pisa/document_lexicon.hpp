@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include <mio/mmap.hpp>
+
+#include "front_coded_vector.hpp"
+#include "payload_vector.hpp"
+
+namespace pisa {
+
+/// The titles of the documents of a collection, e.g., their URLs, by document ID.
+///
+/// The lexicon is either a `Payload_Vector` or a `Front_Coded_Vector`, as written by `lexicon
+/// build`. Front coding takes a fraction of the size when neighboring documents share prefixes,
+/// as URLs do in a collection ordered by URL. Either is memory-mapped, so only the pages of the
+/// titles looked up are read, and a lookup takes constant time: one offset, plus the decoding of
+/// at most one bucket if front-coded.
+class Document_Lexicon {
+  public:
+    explicit Document_Lexicon(std::string const& filename)
+        : m_source(std::make_shared<mio::mmap_source>(filename.c_str())),
+          m_titles(load(*m_source))
+    {}
+
+    [[nodiscard]] auto size() const -> std::uint64_t
+    {
+        return std::visit(
+            [](auto const& titles) -> std::uint64_t { return titles.size(); }, m_titles);
+    }
+
+    [[nodiscard]] auto is_front_coded() const -> bool
+    {
+        return std::holds_alternative<Front_Coded_Vector>(m_titles);
+    }
+
+    /// Returns the title of `docid`, viewing the mapped file or, if front-coded, decoded into
+    /// `buffer`. The view is valid until `buffer` is reused, so a buffer kept across lookups
+    /// saves copying and allocating titles.
+    [[nodiscard]] auto lookup(std::uint64_t docid, std::string& buffer) const -> std::string_view
+    {
+        if (auto const* titles = std::get_if<Front_Coded_Vector>(&m_titles); titles != nullptr) {
+            return titles->get(docid, buffer);
+        }
+        return std::get<Payload_Vector<>>(m_titles)[docid];
+    }
+
+  private:
+    [[nodiscard]] static auto load(mio::mmap_source const& source)
+        -> std::variant<Payload_Vector<>, Front_Coded_Vector>
+    {
+        if (Front_Coded_Vector::is_front_coded(source)) {
+            return Front_Coded_Vector::from(source);
+        }
+        return Payload_Vector<>::from(source);
+    }
+
+    std::shared_ptr<mio::mmap_source> m_source;
+    std::variant<Payload_Vector<>, Front_Coded_Vector> m_titles;
+};
+
+}  // namespace pisa
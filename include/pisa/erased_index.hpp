@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <mio/mmap.hpp>
+
+#include "mappable/mapped_file.hpp"
+
+namespace pisa {
+
+/// The postings of a list of any index type, decoded a block at a time behind a virtual call.
+class erased_block_source {
+  public:
+    static constexpr std::size_t block_size = 128;
+
+    erased_block_source() = default;
+    erased_block_source(erased_block_source const&) = delete;
+    erased_block_source(erased_block_source&&) = delete;
+    erased_block_source& operator=(erased_block_source const&) = delete;
+    erased_block_source& operator=(erased_block_source&&) = delete;
+    virtual ~erased_block_source() = default;
+
+    /// Moves to the first posting with a docid of at least `lower_bound`, which must be greater
+    /// than the docids decoded so far, and decodes up to `block_size` postings from it into
+    /// `docs` and `freqs`. Returns the number of postings decoded, zero past the end.
+    virtual auto decode_from(uint64_t lower_bound, uint32_t* docs, uint32_t* freqs)
+        -> std::size_t = 0;
+};
+
+/// Decodes the postings of any enumerator with `next`, `next_geq`, `docid`, and `freq`.
+template <typename Enumerator>
+class enumerator_block_source final: public erased_block_source {
+  public:
+    enumerator_block_source(Enumerator list, uint64_t num_docs)
+        : m_list(std::move(list)), m_num_docs(num_docs)
+    {}
+
+    auto decode_from(uint64_t lower_bound, uint32_t* docs, uint32_t* freqs)
+        -> std::size_t override
+    {
+        if (m_list.docid() < lower_bound) {
+            m_list.next_geq(std::min(lower_bound, m_num_docs));
+        }
+        std::size_t count = 0;
+        for (; count < block_size && m_list.docid() < m_num_docs; ++count) {
+            docs[count] = static_cast<uint32_t>(m_list.docid());
+            freqs[count] = static_cast<uint32_t>(m_list.freq());
+            m_list.next();
+        }
+        return count;
+    }
+
+  private:
+    Enumerator m_list;
+    uint64_t m_num_docs;
+};
+
+/// A document enumerator over an `erased_block_source`, whose traversal is the same for all
+/// index types: it moves within the block it holds without virtual calls, and only asks the
+/// source for the next block, once per `erased_block_source::block_size` postings or per skip
+/// past its last docid.
+class erased_enumerator {
+  public:
+    erased_enumerator(
+        std::unique_ptr<erased_block_source> source, uint64_t size, uint64_t num_docs)
+        : m_source(std::move(source)), m_size(size), m_num_docs(num_docs)
+    {
+        refill(0);
+    }
+
+    [[nodiscard]] auto docid() const noexcept -> uint64_t { return m_docs[m_pos]; }
+    [[nodiscard]] auto freq() const noexcept -> uint64_t { return m_freqs[m_pos]; }
+    [[nodiscard]] auto size() const noexcept -> uint64_t { return m_size; }
+
+    void next()
+    {
+        m_pos += 1;
+        if (m_pos == m_count) {
+            refill(m_docs[m_count - 1] + 1);
+        }
+    }
+
+    void next_geq(uint64_t lower_bound)
+    {
+        if (lower_bound > m_docs[m_count - 1]) {
+            refill(lower_bound);
+        }
+        while (m_docs[m_pos] < lower_bound) {
+            m_pos += 1;
+        }
+    }
+
+  private:
+    void refill(uint64_t lower_bound)
+    {
+        m_pos = 0;
+        m_count = m_source->decode_from(lower_bound, m_docs.data(), m_freqs.data());
+        if (m_count == 0) {
+            m_docs[0] = static_cast<uint32_t>(m_num_docs);
+            m_freqs[0] = 0;
+            m_count = 1;
+        }
+    }
+
+    std::unique_ptr<erased_block_source> m_source;
+    uint64_t m_size;
+    uint64_t m_num_docs;
+    std::size_t m_pos = 0;
+    std::size_t m_count = 0;
+    std::array<uint32_t, erased_block_source::block_size> m_docs{};
+    std::array<uint32_t, erased_block_source::block_size> m_freqs{};
+};
+
+/// An index of any of `PISA_INDEX_TYPES`, chosen at run time from the encoding recorded in the
+/// header of its file, so that one process can query indexes, e.g., shards or segments, of
+/// different encodings.
+///
+/// Only the decoding of lists is instantiated for every index type, in one translation unit;
+/// query algorithms are instantiated once, for `erased_enumerator`, whatever the encoding,
+/// which keeps compile times and binaries small, at the cost of a virtual call per block.
+class Erased_Index {
+  public:
+    using document_enumerator = erased_enumerator;
+
+    /// The typed index behind an `Erased_Index`.
+    class Model {
+      public:
+        Model() = default;
+        Model(Model const&) = delete;
+        Model(Model&&) = delete;
+        Model& operator=(Model const&) = delete;
+        Model& operator=(Model&&) = delete;
+        virtual ~Model() = default;
+        [[nodiscard]] virtual auto size() const -> std::size_t = 0;
+        [[nodiscard]] virtual auto num_docs() const -> uint64_t = 0;
+        [[nodiscard]] virtual auto enumerator(std::size_t term) const -> erased_enumerator = 0;
+    };
+
+    Erased_Index() = default;
+
+    /// Maps the index at `[data, data + size)`, of the encoding recorded in its header, which
+    /// must outlive it. Throws `std::invalid_argument` if there is no header, or if its
+    /// encoding is not one of `PISA_INDEX_TYPES`.
+    [[nodiscard]] static auto map(char const* data, std::size_t size, uint64_t flags = 0)
+        -> Erased_Index;
+
+    /// Opens the index file `filename`, as `map` does, and keeps it loaded with `mode`.
+    [[nodiscard]] static auto
+    open(std::string const& filename, mapper::load_mode mode = mapper::load_mode::mmap)
+        -> Erased_Index;
+
+    [[nodiscard]] auto operator[](std::size_t term) const -> erased_enumerator
+    {
+        return m_model->enumerator(term);
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_model->size(); }
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_model->num_docs(); }
+    [[nodiscard]] auto encoding() const noexcept -> std::string const& { return m_encoding; }
+
+  private:
+    Erased_Index(std::shared_ptr<Model const> model, std::string encoding)
+        : m_model(std::move(model)), m_encoding(std::move(encoding))
+    {}
+
+    std::shared_ptr<Model const> m_model;
+    std::string m_encoding;
+};
+
+namespace mapper {
+
+    /// Maps an `Erased_Index`, so that code mapping any index type from a file maps it too.
+    inline auto map(
+        Erased_Index& index,
+        mio::mmap_source const& m,
+        uint64_t flags = 0,
+        [[maybe_unused]] const char* friendly_name = "<TOP>") -> std::size_t
+    {
+        index = Erased_Index::map(m.data(), m.size(), flags);
+        return m.size();
+    }
+
+}  // namespace mapper
+
+}  // namespace pisa
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <gsl/span>
+
+#include "bit_vector.hpp"
+#include "codec/block_codecs.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/warmup.hpp"
+#include "util/intrinsics.hpp"
+#include "util/likely.hpp"
+#include "util/prefix_sum.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// A block-compressed index that stores block-max scores next to the skip data.
+///
+/// Every posting list starts with its maximum score and an array of fixed-size block headers,
+/// each holding the block's maximum docid, the offsets of its docids and frequencies, and the
+/// maximum score of its postings. A block-max skip therefore reads a single 16-byte header,
+/// which also locates the data to decode, instead of looking up the block maxima of a separate
+/// `wand_data` file. The index can be passed in place of the WAND data to
+/// `make_block_max_scored_cursors`; the scores are fixed at build time by the scorer given to
+/// the builder.
+template <typename BlockCodec>
+class fat_block_index {
+  public:
+    struct block_header {
+        uint32_t max_docid;
+        uint32_t docs_offset;
+        uint32_t freqs_offset;
+        float max_score;
+    };
+    static_assert(sizeof(block_header) == 16, "block headers must be packed");
+
+    fat_block_index() : m_size(0), m_num_docs(0) {}
+
+    class builder {
+      public:
+        builder(uint64_t num_docs, global_parameters const& params)
+            : m_params(params), m_num_docs(num_docs)
+        {
+            m_endpoints.push_back(0);
+        }
+
+        /// Adds a posting list, computing the block-max scores with `term_scorer`, which is
+        /// called with a docid and a frequency.
+        template <typename DocsIterator, typename FreqsIterator, typename TermScorer>
+        void add_posting_list(
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            TermScorer&& term_scorer)
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            TightVariableByte::encode_single(n, m_lists);
+
+            uint64_t block_size = BlockCodec::block_size;
+            uint64_t blocks = ceil_div(n, block_size);
+            size_t begin_max_score = m_lists.size();
+            size_t begin_headers = begin_max_score + sizeof(float);
+            size_t begin_blocks = begin_headers + blocks * sizeof(block_header);
+            m_lists.resize(begin_blocks);
+
+            std::vector<uint32_t> docs_buf(block_size);
+            std::vector<uint32_t> freqs_buf(block_size);
+            int64_t last_doc = -1;
+            uint32_t block_base = 0;
+            float max_score = 0;
+            for (size_t b = 0; b < blocks; ++b) {
+                uint32_t cur_block_size =
+                    ((b + 1) * block_size <= n) ? block_size : (n % block_size);
+
+                block_header header{};
+                for (size_t i = 0; i < cur_block_size; ++i) {
+                    uint32_t doc = *docs_begin++;
+                    uint32_t freq = *freqs_begin++;
+                    docs_buf[i] = doc - last_doc - 1;
+                    freqs_buf[i] = freq - 1;
+                    last_doc = doc;
+                    header.max_score = std::max<float>(header.max_score, term_scorer(doc, freq));
+                }
+                header.max_docid = last_doc;
+                header.docs_offset = m_lists.size() - begin_blocks;
+                BlockCodec::encode(
+                    docs_buf.data(),
+                    last_doc - block_base - (cur_block_size - 1),
+                    cur_block_size,
+                    m_lists);
+                header.freqs_offset = m_lists.size() - begin_blocks;
+                BlockCodec::encode(freqs_buf.data(), uint32_t(-1), cur_block_size, m_lists);
+                std::memcpy(
+                    &m_lists[begin_headers + b * sizeof(block_header)], &header, sizeof(header));
+                max_score = std::max(max_score, header.max_score);
+                block_base = last_doc + 1;
+            }
+            std::memcpy(&m_lists[begin_max_score], &max_score, sizeof(max_score));
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void build(fat_block_index& index)
+        {
+            index.m_params = m_params;
+            index.m_size = m_endpoints.size() - 1;
+            index.m_num_docs = m_num_docs;
+            index.m_lists.steal(m_lists);
+
+            bit_vector_builder bvb;
+            compact_elias_fano::write(
+                bvb, m_endpoints.begin(), index.m_lists.size(), index.m_size, m_params);
+            bit_vector(&bvb).swap(index.m_endpoints);
+        }
+
+      private:
+        global_parameters m_params;
+        size_t m_num_docs;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+    };
+
+    /// The header of a posting list: its length, maximum score and block headers.
+    class list_header {
+      public:
+        explicit list_header(uint8_t const* data)
+            : m_n(0), m_max_score_data(TightVariableByte::decode(data, &m_n, 1))
+        {}
+
+        [[nodiscard]] auto size() const -> uint32_t { return m_n; }
+        [[nodiscard]] auto num_blocks() const -> uint32_t
+        {
+            return ceil_div(m_n, BlockCodec::block_size);
+        }
+        [[nodiscard]] auto max_score() const -> float
+        {
+            float score;
+            std::memcpy(&score, m_max_score_data, sizeof(score));
+            return score;
+        }
+        [[nodiscard]] auto headers() const -> block_header const*
+        {
+            return reinterpret_cast<block_header const*>(m_max_score_data + sizeof(float));
+        }
+        [[nodiscard]] auto blocks_data() const -> uint8_t const*
+        {
+            return m_max_score_data + sizeof(float) + num_blocks() * sizeof(block_header);
+        }
+
+      private:
+        uint32_t m_n;
+        uint8_t const* m_max_score_data;
+    };
+
+    class document_enumerator {
+      public:
+        document_enumerator(uint8_t const* data, uint64_t universe, size_t /* term_id */ = 0)
+            : m_header(data),
+              m_n(m_header.size()),
+              m_blocks(m_header.num_blocks()),
+              m_headers(m_header.headers()),
+              m_blocks_data(m_header.blocks_data()),
+              m_universe(universe)
+        {
+            reset();
+        }
+
+        void reset() { decode_docs_block(0); }
+
+        void PISA_ALWAYSINLINE next()
+        {
+            ++m_pos_in_block;
+            if (PISA_UNLIKELY(m_pos_in_block == m_cur_block_size)) {
+                if (m_cur_block + 1 == m_blocks) {
+                    m_cur_docid = m_universe;
+                    return;
+                }
+                decode_docs_block(m_cur_block + 1);
+            } else {
+                m_cur_docid = m_docs_buf[m_pos_in_block];
+            }
+        }
+
+        void PISA_ALWAYSINLINE next_geq(uint64_t lower_bound)
+        {
+            assert(lower_bound >= m_cur_docid || position() == 0);
+            if (PISA_UNLIKELY(lower_bound > m_headers[m_cur_block].max_docid)) {
+                if (lower_bound > m_headers[m_blocks - 1].max_docid) {
+                    m_cur_docid = m_universe;
+                    return;
+                }
+
+                uint64_t block = m_cur_block + 1;
+                while (m_headers[block].max_docid < lower_bound) {
+                    ++block;
+                }
+
+                decode_docs_block(block);
+            }
+
+            while (docid() < lower_bound) {
+                m_cur_docid = m_docs_buf[++m_pos_in_block];
+                assert(m_pos_in_block < m_cur_block_size);
+            }
+        }
+
+        void PISA_ALWAYSINLINE move(uint64_t pos)
+        {
+            assert(pos >= position());
+            uint64_t block = pos / BlockCodec::block_size;
+            if (PISA_UNLIKELY(block != m_cur_block)) {
+                decode_docs_block(block);
+            }
+            m_pos_in_block = pos % BlockCodec::block_size;
+            m_cur_docid = m_docs_buf[m_pos_in_block];
+        }
+
+        /// Moves to the first posting of the next block, or past the end of the list
+        /// if the current block is the last one.
+        void next_block()
+        {
+            if (m_cur_block + 1 == m_blocks) {
+                m_pos_in_block = m_cur_block_size;
+                m_cur_docid = m_universe;
+                return;
+            }
+            decode_docs_block(m_cur_block + 1);
+        }
+
+        /// Returns the docids of the current block, from the current position up
+        /// to the end of the block.
+        [[nodiscard]] auto block_docids() const -> gsl::span<uint32_t const>
+        {
+            return gsl::span<uint32_t const>(
+                m_docs_buf.data() + m_pos_in_block, m_cur_block_size - m_pos_in_block);
+        }
+
+        /// Returns the frequencies aligned with `block_docids()`, decoding them if needed.
+        [[nodiscard]] auto block_freqs() -> gsl::span<uint32_t const>
+        {
+            if (!m_freqs_decoded) {
+                decode_freqs_block();
+            }
+            return gsl::span<uint32_t const>(
+                m_freqs_buf.data() + m_pos_in_block, m_cur_block_size - m_pos_in_block);
+        }
+
+        uint64_t docid() const { return m_cur_docid; }
+
+        uint64_t PISA_ALWAYSINLINE freq()
+        {
+            if (!m_freqs_decoded) {
+                decode_freqs_block();
+            }
+            return m_freqs_buf[m_pos_in_block];
+        }
+
+        uint64_t position() const { return m_cur_block * BlockCodec::block_size + m_pos_in_block; }
+
+        uint64_t size() const { return m_n; }
+
+        uint64_t num_blocks() const { return m_blocks; }
+
+        /// Returns the maximum score of the postings of the current block.
+        [[nodiscard]] auto block_max_score() const -> float
+        {
+            return m_headers[m_cur_block].max_score;
+        }
+
+      private:
+        void PISA_NOINLINE decode_docs_block(uint64_t block)
+        {
+            static const uint64_t block_size = BlockCodec::block_size;
+            block_header const& header = m_headers[block];
+            m_cur_block_size =
+                ((block + 1) * block_size <= size()) ? block_size : (size() % block_size);
+            uint32_t cur_base = (block ? m_headers[block - 1].max_docid : uint32_t(-1)) + 1;
+            m_freqs_block_data = m_blocks_data + header.freqs_offset;
+            intrinsics::prefetch(m_freqs_block_data);
+            BlockCodec::decode(
+                m_blocks_data + header.docs_offset,
+                m_docs_buf.data(),
+                header.max_docid - cur_base - (m_cur_block_size - 1),
+                m_cur_block_size);
+
+            m_docs_buf[0] += cur_base;
+            gaps_to_docids(m_docs_buf.data(), m_cur_block_size);
+
+            m_cur_block = block;
+            m_pos_in_block = 0;
+            m_cur_docid = m_docs_buf[0];
+            m_freqs_decoded = false;
+        }
+
+        void PISA_NOINLINE decode_freqs_block()
+        {
+            BlockCodec::decode(
+                m_freqs_block_data, m_freqs_buf.data(), uint32_t(-1), m_cur_block_size);
+            // frequencies are stored decremented by one
+            for (uint32_t i = 0; i < m_cur_block_size; ++i) {
+                m_freqs_buf[i] += 1;
+            }
+            m_freqs_decoded = true;
+        }
+
+        list_header m_header;
+        uint32_t m_n;
+        uint32_t m_blocks;
+        block_header const* m_headers;
+        uint8_t const* m_blocks_data;
+        uint64_t m_universe;
+
+        uint32_t m_cur_block;
+        uint32_t m_pos_in_block;
+        uint32_t m_cur_block_size;
+        uint32_t m_cur_docid;
+
+        uint8_t const* m_freqs_block_data;
+        bool m_freqs_decoded;
+
+        // inline, so that opening a list allocates nothing
+        std::array<uint32_t, decode_buffer_size<BlockCodec>> m_docs_buf;
+        std::array<uint32_t, decode_buffer_size<BlockCodec>> m_freqs_buf;
+    };
+
+    /// Enumerates the block-max scores of a posting list, with the interface of
+    /// `wand_data::wand_data_enumerator`.
+    class block_max_enumerator {
+      public:
+        explicit block_max_enumerator(list_header header)
+            : m_headers(header.headers()), m_blocks(header.num_blocks())
+        {}
+
+        void PISA_ALWAYSINLINE next_geq(uint64_t lower_bound)
+        {
+            while (m_cur_block + 1 < m_blocks && m_headers[m_cur_block].max_docid < lower_bound) {
+                ++m_cur_block;
+            }
+        }
+
+        [[nodiscard]] auto score() const -> float { return m_headers[m_cur_block].max_score; }
+
+        [[nodiscard]] auto docid() const -> uint64_t { return m_headers[m_cur_block].max_docid; }
+
+      private:
+        block_header const* m_headers;
+        uint32_t m_blocks;
+        uint32_t m_cur_block = 0;
+    };
+
+    using wand_data_enumerator = block_max_enumerator;
+
+    size_t size() const { return m_size; }
+
+    uint64_t num_docs() const { return m_num_docs; }
+
+    document_enumerator operator[](size_t i) const
+    {
+        return document_enumerator(list_data(i), num_docs(), i);
+    }
+
+    /// Returns the block-max scores of the i-th posting list.
+    [[nodiscard]] auto getenum(size_t i) const -> block_max_enumerator
+    {
+        return block_max_enumerator(list_header(list_data(i)));
+    }
+
+    /// Returns the maximum score of the i-th posting list.
+    [[nodiscard]] auto max_term_weight(size_t i) const -> float
+    {
+        return list_header(list_data(i)).max_score();
+    }
+
+    void warmup(size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+
+        auto begin = endpoints.move(i).second;
+        auto end = m_lists.size();
+        if (i + 1 != size()) {
+            end = endpoints.move(i + 1).second;
+        }
+
+        mapper::warmup_memory(m_lists.data() + begin, end - begin);
+    }
+
+    void swap(fat_block_index& other)
+    {
+        std::swap(m_params, other.m_params);
+        std::swap(m_size, other.m_size);
+        std::swap(m_num_docs, other.m_num_docs);
+        m_endpoints.swap(other.m_endpoints);
+        m_lists.swap(other.m_lists);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
+            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+    }
+
+  private:
+    [[nodiscard]] auto list_data(size_t i) const -> uint8_t const*
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        return m_lists.data() + endpoints.move(i).second;
+    }
+
+    global_parameters m_params;
+    size_t m_size;
+    size_t m_num_docs;
+    bit_vector m_endpoints;
+    mapper::mappable_vector<uint8_t> m_lists;
+};
+
+/// Returns the source of block-max scores to use with `index`: the WAND data, unless the
+/// index stores its own.
+template <typename Index, typename WandType>
+[[nodiscard]] auto block_max_data(Index const&, WandType const& wdata) -> WandType const&
+{
+    return wdata;
+}
+
+template <typename BlockCodec, typename WandType>
+[[nodiscard]] auto block_max_data(fat_block_index<BlockCodec> const& index, WandType const&)
+    -> fat_block_index<BlockCodec> const&
+{
+    return index;
+}
+
+}  // namespace pisa
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <numeric>
 #include <string>
 #include <vector>
 
 #include "binary_collection.hpp"
+#include "bit_vector.hpp"
 #include "codec/block_codecs.hpp"
+#include "codec/compact_elias_fano.hpp"
 #include "codec/varintgb.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
 #include "util/progress.hpp"
 
 namespace pisa {
@@ -16,61 +22,122 @@ using id_type = std::uint32_t;
 //! This class represents a forward index.
 //!
 //! The documents IDs are assumed to be consecutive numbers [0, N), where N is the collection size.
-//! Each entry contains an encoded list of terms for the given document.
-class forward_index: public std::vector<std::vector<std::uint8_t>> {
+//! The encoded terms of all documents are stored in one contiguous buffer, in document order, and
+//! located by an Elias-Fano sequence of their offsets, so that the index can be frozen and mapped
+//! with `mapper`. Each entry is the number of terms of the document, as a variable byte, followed
+//! by its sorted term IDs, encoded with VarIntGB if the index is compressed, or as variable byte
+//! gaps otherwise.
+class forward_index {
   public:
     using id_type = uint32_t;
-    using entry_type = std::vector<std::uint8_t>;
 
-    //! Initializes a new forward index with empty containers.
-    forward_index(size_t document_count, size_t term_count, bool compressed = true)
-        : std::vector<entry_type>(document_count),
-          m_term_count(term_count),
-          m_term_counts(document_count),
-          m_compressed(compressed)
-    {}
+    //! Builds a forward index by appending the documents in order.
+    class builder {
+      public:
+        builder(size_t term_count, bool compressed = true)
+            : m_term_count(term_count), m_compressed(compressed)
+        {
+            m_endpoints.push_back(0);
+        }
 
-    const std::size_t& term_count() const { return m_term_count; }
-    const std::size_t& term_count(id_type document) const { return m_term_counts[document]; }
+        //! Appends the next document, given the number of its terms and its encoded gaps, as
+        //! written by `TightVariableByte`.
+        void add_encoded_document(size_t term_count, uint8_t const* gaps, size_t length)
+        {
+            TightVariableByte::encode_single(term_count, m_entries);
+            if (m_compressed) {
+                m_terms.resize(term_count);
+                TightVariableByte::decode(gaps, m_terms.data(), term_count);
+                for (size_t i = 1; i < term_count; ++i) {
+                    m_terms[i] += m_terms[i - 1];
+                }
+                append_compressed();
+            } else {
+                m_entries.insert(m_entries.end(), gaps, gaps + length);
+            }
+            m_endpoints.push_back(m_entries.size());
+        }
 
-    //! Compresses each document in `fwd` with a faster codec.
-    static forward_index read(const std::string& input_file)
-    {
-        std::ifstream in(input_file.c_str());
-        bool compressed;
-        size_t term_count, docs_count;
-        in.read(reinterpret_cast<char*>(&compressed), sizeof(compressed));
-        in.read(reinterpret_cast<char*>(&term_count), sizeof(term_count));
-        in.read(reinterpret_cast<char*>(&docs_count), sizeof(docs_count));
-        forward_index fwd(docs_count, term_count, compressed);
-        for (id_type doc = 0; doc < docs_count; ++doc) {
-            size_t block_size;
-            in.read(reinterpret_cast<char*>(&term_count), sizeof(term_count));
-            in.read(reinterpret_cast<char*>(&block_size), sizeof(block_size));
-            fwd.m_term_counts[doc] = term_count;
-            fwd[doc].resize(block_size);
-            in.read(reinterpret_cast<char*>(fwd[doc].data()), block_size);
+        //! Appends the next document, given its sorted term IDs.
+        void add_document(std::vector<id_type> const& terms)
+        {
+            TightVariableByte::encode_single(terms.size(), m_entries);
+            if (m_compressed) {
+                m_terms = terms;
+                append_compressed();
+            } else {
+                id_type prev = 0;
+                for (auto term: terms) {
+                    TightVariableByte::encode_single(term - prev, m_entries);
+                    prev = term;
+                }
+            }
+            m_endpoints.push_back(m_entries.size());
         }
-        return fwd;
+
+        void build(forward_index& fwd)
+        {
+            fwd.m_params = global_parameters();
+            fwd.m_size = m_endpoints.size() - 1;
+            fwd.m_term_count = m_term_count;
+            fwd.m_compressed = m_compressed;
+            // VarIntGB decodes groups with 4-byte loads, which may read past the last entry.
+            m_entries.resize(m_entries.size() + sizeof(uint32_t));
+            fwd.m_entries.steal(m_entries);
+
+            bit_vector_builder bvb;
+            compact_elias_fano::write(
+                bvb, m_endpoints.begin(), fwd.m_entries.size(), fwd.m_size, fwd.m_params);
+            bit_vector(&bvb).swap(fwd.m_endpoints);
+        }
+
+      private:
+        void append_compressed()
+        {
+            auto offset = m_entries.size();
+            m_entries.resize(offset + 5 * m_terms.size() + 1);
+            VarIntGB<true> varintgb_codec;
+            auto length =
+                varintgb_codec.encodeArray(m_terms.data(), m_terms.size(), &m_entries[offset]);
+            m_entries.resize(offset + length);
+        }
+
+        size_t m_term_count;
+        bool m_compressed;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_entries;
+        std::vector<id_type> m_terms;
+    };
+
+    forward_index() = default;
+    forward_index(forward_index const&) = delete;
+    forward_index& operator=(forward_index const&) = delete;
+    forward_index(forward_index&& other) noexcept { swap(other); }
+    forward_index& operator=(forward_index&& other) noexcept
+    {
+        forward_index(std::move(other)).swap(*this);
+        return *this;
     }
 
-    static forward_index& compress(forward_index& fwd)
+    //! Returns the number of documents.
+    size_t size() const { return m_size; }
+    size_t term_count() const { return m_term_count; }
+    size_t term_count(id_type document) const
     {
-        progress p("Compressing forward index", fwd.size());
-        for (id_type doc = 0u; doc < fwd.size(); ++doc) {
-            auto& encoded_terms = fwd[doc];
-            std::vector<id_type> terms(encoded_terms.size() * 5);
-            std::size_t n = 0;
-            TightVariableByte::decode(encoded_terms.data(), terms.data(), encoded_terms.size(), n);
-            fwd.m_term_counts[doc] = n;
-            encoded_terms.clear();
-            encoded_terms.resize(2 * n * sizeof(id_type));
-            VarIntGB<false> varintgb_codec;
-            std::size_t byte_size = varintgb_codec.encodeArray(terms.data(), n, encoded_terms.data());
-            encoded_terms.resize(byte_size);
-            encoded_terms.shrink_to_fit();
-            p.update(1);
-        }
+        uint32_t count;
+        TightVariableByte::decode(entry(document), &count, 1);
+        return count;
+    }
+    bool compressed() const { return m_compressed; }
+
+    //! Maps the forward index frozen into `input_file` by `write`, which stays mapped for the
+    //! lifetime of the returned index.
+    static forward_index
+    read(const std::string& input_file, mapper::load_mode load_mode = mapper::load_mode::mmap)
+    {
+        forward_index fwd;
+        fwd.m_source = mapper::mapped_file(input_file, load_mode);
+        mapper::map(fwd, fwd.m_source);
         return fwd;
     }
 
@@ -86,71 +153,139 @@ class forward_index: public std::vector<std::vector<std::uint8_t>> {
         auto num_docs = *firstseq.begin();
         auto num_terms = std::distance(++coll.begin(), coll.end());
 
-        forward_index fwd(num_docs, num_terms, use_compression);
+        // The postings are read term by term, so the gaps of all documents are first written
+        // in place into one buffer, whose layout is computed by a first pass over the lists.
+        std::vector<uint64_t> offsets(num_docs + 1, 0u);
+        std::vector<id_type> prev(num_docs, 0u);
+        std::vector<uint32_t> term_counts(num_docs, 0u);
         {
-            progress p("Building forward index", num_terms);
+            progress p("Computing forward index layout", num_terms);
             id_type tid = 0;
-            std::vector<id_type> prev(num_docs, 0u);
             for (auto it = ++coll.begin(); it != coll.end(); ++it) {
-                for (const auto& d: *it) {
-                    if (it->size() >= min_len) {
-                        TightVariableByte::encode_single(tid - prev[d], fwd[d]);
+                if (it->size() >= min_len) {
+                    for (const auto& d: *it) {
+                        offsets[d + 1] += vbyte_size(tid - prev[d]);
                         prev[d] = tid;
-                        fwd.m_term_counts[d]++;
+                        term_counts[d]++;
                     }
                 }
                 p.update(1);
                 ++tid;
             }
         }
-        if (use_compression) {
-            compress(fwd);
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<uint8_t> gaps(offsets.back());
+        {
+            progress p("Building forward index", num_terms);
+            std::fill(prev.begin(), prev.end(), 0u);
+            id_type tid = 0;
+            size_t length;
+            for (auto it = ++coll.begin(); it != coll.end(); ++it) {
+                if (it->size() >= min_len) {
+                    for (const auto& d: *it) {
+                        uint32_t gap = tid - prev[d];
+                        TightVariableByte::encode(&gap, 1, &gaps[offsets[d]], length);
+                        offsets[d] += length;
+                        prev[d] = tid;
+                    }
+                }
+                p.update(1);
+                ++tid;
+            }
         }
+        prev.clear();
+        prev.shrink_to_fit();
 
+        forward_index fwd;
+        {
+            progress p("Encoding forward index", num_docs);
+            builder fwd_builder(num_terms, use_compression);
+            uint64_t begin = 0;
+            for (id_type doc = 0; doc < num_docs; ++doc) {
+                // After the second pass, each offset points to the end of its document.
+                fwd_builder.add_encoded_document(
+                    term_counts[doc], &gaps[begin], offsets[doc] - begin);
+                begin = offsets[doc];
+                p.update(1);
+            }
+            gaps.clear();
+            gaps.shrink_to_fit();
+            fwd_builder.build(fwd);
+        }
         return fwd;
     }
 
-    static void write(const forward_index& fwd, const std::string& output_file)
+    //! Freezes the forward index into `output_file`, to be mapped by `read`.
+    static void write(forward_index& fwd, const std::string& output_file)
     {
-        std::ofstream out(output_file.c_str());
-        size_t size = fwd.size();
-        out.write(reinterpret_cast<const char*>(&fwd.m_compressed), sizeof(fwd.m_compressed));
-        out.write(reinterpret_cast<const char*>(&fwd.m_term_count), sizeof(fwd.m_term_count));
-        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
-        for (id_type doc = 0; doc < fwd.size(); ++doc) {
-            size = fwd[doc].size();
-            out.write(
-                reinterpret_cast<const char*>(&fwd.m_term_counts[doc]),
-                sizeof(fwd.m_term_counts[doc]));
-            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
-            out.write(reinterpret_cast<const char*>(fwd[doc].data()), size);
-        }
+        mapper::freeze(
+            fwd, output_file.c_str(), mapper::file_description{"forward_index", fwd.size()});
     }
 
     //! Decodes and returns the list of terms for a given document.
     std::vector<id_type> terms(id_type document) const
     {
-        const entry_type& encoded_terms = (*this)[document];
-        std::vector<uint32_t> terms;
+        uint32_t term_count;
+        auto encoded_terms = TightVariableByte::decode(entry(document), &term_count, 1);
+        std::vector<id_type> terms(term_count);
         if (m_compressed) {
-            std::size_t term_count = m_term_counts[document];
-            terms.resize(term_count);
             VarIntGB<true> varintgb_codec;
-            varintgb_codec.decodeArray(encoded_terms.data(), term_count, terms.data());
+            varintgb_codec.decodeArray(encoded_terms, term_count, terms.data());
         } else {
-            terms.resize(encoded_terms.size() * 5);
-            size_t n = 0;
-            TightVariableByte::decode(encoded_terms.data(), terms.data(), encoded_terms.size(), n);
-            terms.resize(n);
-            terms.shrink_to_fit();
+            TightVariableByte::decode(encoded_terms, terms.data(), term_count);
+            std::partial_sum(terms.begin(), terms.end(), terms.begin());
         }
         return terms;
     }
 
+    //! Releases the memory of the forward index.
+    void clear() { forward_index().swap(*this); }
+
+    void swap(forward_index& other)
+    {
+        std::swap(m_params, other.m_params);
+        std::swap(m_size, other.m_size);
+        std::swap(m_term_count, other.m_term_count);
+        std::swap(m_compressed, other.m_compressed);
+        m_endpoints.swap(other.m_endpoints);
+        m_entries.swap(other.m_entries);
+        std::swap(m_source, other.m_source);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_params, "m_params")(m_size, "m_size")(m_term_count, "m_term_count")(
+            m_compressed, "m_compressed")(m_endpoints, "m_endpoints")(m_entries, "m_entries");
+    }
+
   private:
-    std::size_t m_term_count;
-    std::vector<std::size_t> m_term_counts;
-    bool m_compressed;
+    static size_t vbyte_size(uint32_t value)
+    {
+        size_t size = 1;
+        while (value >= (1U << 7U)) {
+            value >>= 7U;
+            ++size;
+        }
+        return size;
+    }
+
+    uint8_t const* entry(id_type document) const
+    {
+        assert(document < size());
+        compact_elias_fano::enumerator endpoints(
+            m_endpoints, 0, m_entries.size(), m_size, m_params);
+        return m_entries.data() + endpoints.move(document).second;
+    }
+
+    global_parameters m_params;
+    size_t m_size = 0;
+    size_t m_term_count = 0;
+    bool m_compressed = true;
+    bit_vector m_endpoints;
+    mapper::mappable_vector<uint8_t> m_entries;
+    mapper::mapped_file m_source;
 };
 
 }  // namespace pisa
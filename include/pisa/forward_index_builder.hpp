@@ -2,29 +2,35 @@
 
 #include <algorithm>
 #include <cctype>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <map>
+#include <mutex>
 #include <numeric>
 #include <optional>
+#include <queue>
 #include <sstream>
-#include <stack>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <boost/filesystem.hpp>
 #include <gsl/gsl_assert>
-#include <pstl/algorithm>
-#include <pstl/execution>
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/iota.hpp>
 #include <range/v3/view/transform.hpp>
 #include <range/v3/view/zip.hpp>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
+#include <tbb/blocked_range.h>
 #include <tbb/concurrent_queue.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 #include <tbb/task_group.h>
 
 #include "binary_collection.hpp"
+#include "invert.hpp"
 #include "io.hpp"
 #include "parsing/html.hpp"
 #include "payload_vector.hpp"
@@ -76,34 +82,62 @@ void parse_plaintext_content(std::string&& content, std::function<void(std::stri
     return std::string_view(&*start, 4) == "HTTP"sv;
 }
 
-void parse_html_content(std::string&& content, std::function<void(std::string&&)> process)
+/// Returns the body of an HTTP response, or the whole `content` if it is not one.
+[[nodiscard]] auto skip_http_headers(std::string_view content) -> std::string_view
 {
-    content = parsing::html::cleantext([&]() {
-        auto pos = content.begin();
-        if (is_http(content)) {
-            while (pos != content.end()) {
-                pos = std::find(pos, content.end(), '\n');
-                pos = std::find_if(std::next(pos), content.end(), [](unsigned char c) {
-                    return c == '\n' or not std::isspace(c);
-                });
-                if (pos != content.end() and *pos == '\n') {
-                    return std::string_view(&*pos, std::distance(pos, content.end()));
-                }
-            }
-            return ""sv;
+    if (not is_http(content)) {
+        return content;
+    }
+    auto pos = content.begin();
+    while (pos != content.end()) {
+        pos = std::find(pos, content.end(), '\n');
+        pos = std::find_if(std::next(pos), content.end(), [](unsigned char c) {
+            return c == '\n' or not std::isspace(c);
+        });
+        if (pos != content.end() and *pos == '\n') {
+            return std::string_view(&*pos, std::distance(pos, content.end()));
         }
-        return std::string_view(content);
-    }());
+    }
+    return ""sv;
+}
+
+/// Extracts the text of an HTML document, skipping HTTP headers, and splits it into terms with
+/// `Tokenizer`.
+template <typename Tokenizer = TermTokenizer>
+void parse_html_content(std::string&& content, std::function<void(std::string&&)> process)
+{
+    content = parsing::html::cleantext(skip_http_headers(content));
     if (content.empty()) {
         return;
     }
-    TermTokenizer tokenizer(content);
-    std::for_each(tokenizer.begin(), tokenizer.end(), process);
+    Tokenizer tokenizer(content);
+    for (auto&& term: tokenizer) {
+        process(std::string(term));
+    }
+}
+
+/// Same as `parse_html_content`, but extracts the text with the single-pass
+/// `parsing::html::strip_tags` instead of parsing the document tree, into a buffer reused by
+/// each thread.
+template <typename Tokenizer = TermTokenizer>
+void parse_fast_html_content(std::string&& content, std::function<void(std::string&&)> process)
+{
+    thread_local std::string text;
+    text.clear();
+    parsing::html::strip_tags(skip_http_headers(content), text);
+    if (text.empty()) {
+        return;
+    }
+    Tokenizer tokenizer(text);
+    for (auto&& term: tokenizer) {
+        process(std::string(term));
+    }
 }
 
 class Forward_Index_Builder {
   public:
     using read_record_function_type = std::function<std::optional<Document_Record>(std::istream&)>;
+    using next_record_function_type = std::function<std::optional<Document_Record>()>;
 
     template <typename Iterator>
     static std::ostream& write_document(std::ostream& os, Iterator first, Iterator last)
@@ -134,6 +168,39 @@ class Forward_Index_Builder {
         std::string const& output_file;
     };
 
+    /// Parses the records of a batch, writing their titles and URLs to the batch files, and
+    /// passes the batch term IDs of every document to `process_document`.
+    ///
+    /// Returns the mapping from the batch terms to their batch IDs.
+    template <typename ProcessDocument>
+    [[nodiscard]] auto parse_batch(
+        Batch_Process& bp,
+        process_term_function_type const& process_term,
+        process_content_function_type const& process_content,
+        ProcessDocument process_document) const -> std::map<std::string, uint32_t>
+    {
+        auto basename = batch_file(bp.output_file, bp.batch_number);
+        std::ofstream title_os(basename + ".documents");
+        std::ofstream url_os(basename + ".urls");
+
+        std::map<std::string, uint32_t> map;
+        std::vector<uint32_t> term_ids;
+        for (auto&& record: bp.records) {
+            title_os << record.title() << '\n';
+            url_os << record.url() << '\n';
+
+            term_ids.clear();
+            auto process = [&](auto&& term) {
+                term = process_term(std::move(term));
+                auto id = static_cast<uint32_t>(map.size());
+                term_ids.push_back(map.try_emplace(std::move(term), id).first->second);
+            };
+            process_content(std::move(record.content()), process);
+            process_document(term_ids);
+        }
+        return map;
+    }
+
     void
     run(Batch_Process bp,
         process_term_function_type process_term,
@@ -147,34 +214,75 @@ class Forward_Index_Builder {
         auto basename = batch_file(bp.output_file, bp.batch_number);
 
         std::ofstream os(basename);
-        std::ofstream title_os(basename + ".documents");
-        std::ofstream url_os(basename + ".urls");
-        std::ofstream term_os(basename + ".terms");
         write_header(os, bp.records.size());
+        auto map = parse_batch(bp, process_term, process_content, [&](auto const& term_ids) {
+            write_document(os, term_ids.begin(), term_ids.end());
+        });
 
-        std::map<std::string, uint32_t> map;
+        std::vector<std::string const*> terms(map.size());
+        for (auto const& [term, id]: map) {
+            terms[id] = &term;
+        }
+        std::ofstream term_os(basename + ".terms");
+        for (auto const* term: terms) {
+            term_os << *term << '\n';
+        }
+        spdlog::info(
+            "[Batch {}] Processed documents [{}, {})",
+            bp.batch_number,
+            bp.first_document,
+            bp.first_document + bp.records.size());
+    }
 
-        for (auto&& record: bp.records) {
-            title_os << record.title() << '\n';
-            url_os << record.url() << '\n';
+    /// Parses a batch like `run`, but inverts it in memory instead of writing its forward index.
+    ///
+    /// The batch terms are written in lexicographical order, and the posting lists in the same
+    /// order, so that batches can be merged by term without a global mapping.
+    void run_inverted(
+        Batch_Process bp,
+        process_term_function_type process_term,
+        process_content_function_type process_content) const
+    {
+        spdlog::debug(
+            "[Batch {}] Processing documents [{}, {})",
+            bp.batch_number,
+            bp.first_document,
+            bp.first_document + bp.records.size());
+        auto basename = batch_file(bp.output_file, bp.batch_number);
 
-            std::vector<uint32_t> term_ids;
+        std::vector<uint32_t> term_ids;
+        std::vector<std::size_t> document_ends;
+        auto map = parse_batch(bp, process_term, process_content, [&](auto const& document) {
+            term_ids.insert(term_ids.end(), document.begin(), document.end());
+            document_ends.push_back(term_ids.size());
+        });
 
-            auto process = [&](auto&& term) {
-                term = process_term(std::move(term));
-                uint32_t id = 0;
-                if (auto pos = map.find(term); pos != map.end()) {
-                    id = pos->second;
-                } else {
-                    id = map.size();
-                    map[term] = id;
-                    term_os << term << '\n';
-                }
-                term_ids.push_back(id);
-            };
-            process_content(std::move(record.content()), process);
-            write_document(os, term_ids.begin(), term_ids.end());
+        std::vector<Term_Id> ranks(map.size());
+        {
+            std::ofstream term_os(basename + ".terms");
+            Term_Id rank{0};
+            for (auto const& [term, id]: map) {
+                term_os << term << '\n';
+                ranks[id] = rank;
+                ++rank;
+            }
+        }
+        std::vector<Term_Id> documents(term_ids.size());
+        std::transform(term_ids.begin(), term_ids.end(), documents.begin(), [&](auto id) {
+            return ranks[id];
+        });
+        std::vector<gsl::span<Term_Id const>> document_spans;
+        std::size_t document_begin = 0;
+        for (auto document_end: document_ends) {
+            document_spans.emplace_back(
+                documents.data() + document_begin, document_end - document_begin);
+            document_begin = document_end;
         }
+        auto term_count = static_cast<std::uint32_t>(map.size());
+        invert::write(
+            basename,
+            invert::invert_range_flat(document_spans, bp.first_document, term_count, 1),
+            term_count);
         spdlog::info(
             "[Batch {}] Processed documents [{}, {})",
             bp.batch_number,
@@ -194,59 +302,62 @@ class Forward_Index_Builder {
         return mapping;
     }
 
-    [[nodiscard]] static auto collect_terms(std::string const& basename, std::ptrdiff_t batch_count)
+    /// Returns the union of two sorted sequences of distinct terms.
+    [[nodiscard]] static auto
+    merge_terms(std::vector<std::string> lhs, std::vector<std::string> rhs)
+        -> std::vector<std::string>
     {
-        struct Term_Span {
-            size_t first;
-            size_t last;
-            size_t lvl;
-        };
-        std::stack<Term_Span> spans;
+        if (lhs.empty()) {
+            return rhs;
+        }
+        if (rhs.empty()) {
+            return lhs;
+        }
         std::vector<std::string> terms;
-        auto merge_spans = [&](Term_Span lhs, Term_Span rhs) {
-            Expects(lhs.last == rhs.first);
-            auto first = std::next(terms.begin(), lhs.first);
-            auto mid = std::next(terms.begin(), lhs.last);
-            auto last = std::next(terms.begin(), rhs.last);
-            std::inplace_merge(std::execution::par, first, mid, last);
-            terms.erase(std::unique(std::execution::par, first, last), last);
-            return Term_Span{lhs.first, terms.size(), lhs.lvl + 1};
-        };
-        auto push_span = [&](Term_Span s) {
-            while (not spans.empty() and spans.top().lvl == s.lvl) {
-                s = merge_spans(spans.top(), s);
-                spans.pop();
-            }
-            spans.push(s);
-        };
+        terms.reserve(std::max(lhs.size(), rhs.size()));
+        std::set_union(
+            std::make_move_iterator(lhs.begin()),
+            std::make_move_iterator(lhs.end()),
+            std::make_move_iterator(rhs.begin()),
+            std::make_move_iterator(rhs.end()),
+            std::back_inserter(terms));
+        return terms;
+    }
 
+    /// Returns the sorted union of the terms of all batches.
+    ///
+    /// Batches are read and sorted concurrently, and merged pairwise in a parallel reduction, so
+    /// that each thread only holds a logarithmic number of partial vocabularies at a time.
+    [[nodiscard]] static auto collect_terms(std::string const& basename, std::ptrdiff_t batch_count)
+        -> std::vector<std::string>
+    {
         spdlog::info("Collecting terms");
-        for (auto batch: ranges::views::iota(0, batch_count)) {
-            spdlog::debug("[Collecting terms] Batch {}/{}", batch, batch_count);
-            auto mid = terms.size();
-            std::ifstream terms_is(batch_file(basename, batch) + ".terms");
-            std::string term;
-            while (std::getline(terms_is, term)) {
-                terms.push_back(term);
-            }
-            std::sort(std::next(terms.begin(), mid), terms.end());
-            push_span(Term_Span{mid, terms.size(), 0u});
-        }
-        while (spans.size() > 1) {
-            auto rhs = spans.top();
-            spans.pop();
-            auto lhs = spans.top();
-            spans.pop();
-            spans.push(merge_spans(lhs, rhs));
-        }
+        auto terms = tbb::parallel_reduce(
+            tbb::blocked_range<std::ptrdiff_t>(0, batch_count, 1),
+            std::vector<std::string>{},
+            [&](tbb::blocked_range<std::ptrdiff_t> const& batches, std::vector<std::string> terms) {
+                for (auto batch = batches.begin(); batch != batches.end(); ++batch) {
+                    spdlog::debug("[Collecting terms] Batch {}/{}", batch, batch_count);
+                    auto batch_terms =
+                        io::read_string_vector(batch_file(basename, batch) + ".terms");
+                    std::sort(batch_terms.begin(), batch_terms.end());
+                    batch_terms.erase(
+                        std::unique(batch_terms.begin(), batch_terms.end()), batch_terms.end());
+                    terms = merge_terms(std::move(terms), std::move(batch_terms));
+                }
+                return terms;
+            },
+            [](std::vector<std::string> lhs, std::vector<std::string> rhs) {
+                return merge_terms(std::move(lhs), std::move(rhs));
+            },
+            tbb::simple_partitioner());
         terms.shrink_to_fit();
         return terms;
     }
 
-    void merge(std::string const& basename, std::ptrdiff_t document_count, std::ptrdiff_t batch_count) const
+    /// Concatenates the titles and URLs of the batches, and builds the document lexicon.
+    static void merge_documents(std::string const& basename, std::ptrdiff_t batch_count)
     {
-        std::ofstream term_os(basename + ".terms");
-
         {
             spdlog::info("Merging titles");
             std::ofstream title_os(basename + ".documents");
@@ -272,8 +383,16 @@ class Forward_Index_Builder {
                 url_os << url_is.rdbuf();
             }
         }
+    }
 
+    void merge(std::string const& basename, std::ptrdiff_t document_count, std::ptrdiff_t batch_count) const
+    {
+        std::ofstream term_os(basename + ".terms");
+
+        tbb::task_group documents;
+        documents.run([&] { merge_documents(basename, batch_count); });
         auto terms = collect_terms(basename, batch_count);
+        documents.wait();
 
         spdlog::info("Writing terms");
         for (auto const& term: terms) {
@@ -284,45 +403,181 @@ class Forward_Index_Builder {
         spdlog::info("Mapping terms");
         auto term_mapping = reverse_mapping(std::move(terms));
 
-        spdlog::info("Remapping IDs");
-        for (auto batch: ranges::views::iota(0, batch_count)) {
+        // Batches are remapped concurrently. Whichever thread finishes the next batch in order
+        // appends every batch that is ready, while the others keep remapping.
+        spdlog::info("Remapping IDs and concatenating batches");
+        std::ofstream os(basename);
+        write_header(os, document_count);
+        std::mutex mutex;
+        std::vector<bool> remapped(batch_count, false);
+        std::ptrdiff_t next_batch = 0;
+        bool writing = false;
+        auto append_ready_batches = [&](std::ptrdiff_t batch) {
+            std::unique_lock<std::mutex> lock(mutex);
+            remapped[batch] = true;
+            if (writing) {
+                return;
+            }
+            writing = true;
+            while (next_batch < batch_count and remapped[next_batch]) {
+                auto ready = next_batch++;
+                lock.unlock();
+                spdlog::debug("[Concatenating batches] Batch {}/{}", ready, batch_count);
+                std::ifstream is(batch_file(basename, ready));
+                is.ignore(8);
+                os << is.rdbuf();
+                lock.lock();
+            }
+            writing = false;
+        };
+        tbb::parallel_for(std::ptrdiff_t{0}, batch_count, [&](std::ptrdiff_t batch) {
             spdlog::debug("[Remapping IDs] Batch {}/{}", batch, batch_count);
             auto batch_terms = io::read_string_vector(batch_file(basename, batch) + ".terms");
             std::vector<Term_Id> mapping(batch_terms.size());
             std::transform(
                 batch_terms.begin(), batch_terms.end(), mapping.begin(), [&](auto const& bterm) {
-                    return term_mapping[bterm];
+                    return term_mapping.find(bterm)->second;
                 });
-            writable_binary_collection coll(batch_file(basename, batch).c_str());
-            for (auto doc_iter = ++coll.begin(); doc_iter != coll.end(); ++doc_iter) {
-                for (auto& term_id: *doc_iter) {
-                    term_id = mapping[term_id].as_int();
+            {
+                writable_binary_collection coll(batch_file(basename, batch).c_str());
+                for (auto doc_iter = ++coll.begin(); doc_iter != coll.end(); ++doc_iter) {
+                    for (auto& term_id: *doc_iter) {
+                        term_id = mapping[term_id].as_int();
+                    }
                 }
             }
-        }
+            append_ready_batches(batch);
+        });
         term_mapping.clear();
 
-        spdlog::info("Concatenating batches");
-        std::ofstream os(basename);
-        write_header(os, document_count);
+        spdlog::info("Success.");
+    }
+
+    /// Merges batches written by `run_inverted` into an inverted index.
+    ///
+    /// Every batch lists its terms in lexicographical order, which is the order of the global
+    /// term IDs, so the posting lists are produced by a k-way merge of the batches by term,
+    /// reading each batch sequentially.
+    void merge_inverted(
+        std::string const& basename,
+        std::ptrdiff_t document_count,
+        std::ptrdiff_t batch_count) const
+    {
+        merge_documents(basename, batch_count);
+
+        struct Batch_Cursor {
+            std::ifstream terms;
+            std::string term{};
+            bool valid;
+            std::optional<binary_collection> documents;
+            std::optional<binary_collection> frequencies;
+            binary_collection::const_iterator document_list;
+            binary_collection::const_iterator frequency_list;
+
+            explicit Batch_Cursor(std::string const& batch_basename)
+                : terms(batch_basename + ".terms"),
+                  valid(static_cast<bool>(std::getline(terms, term))),
+                  documents(open(valid, batch_basename + ".docs")),
+                  frequencies(open(valid, batch_basename + ".freqs")),
+                  document_list(valid ? ++documents->begin() : binary_collection::const_iterator{}),
+                  frequency_list(valid ? frequencies->begin() : binary_collection::const_iterator{})
+            {}
+
+            void advance() { valid = static_cast<bool>(std::getline(terms, term)); }
+
+            // A batch without terms has an empty frequency file, which cannot be mapped.
+            static auto open(bool nonempty, std::string const& filename)
+                -> std::optional<binary_collection>
+            {
+                if (nonempty) {
+                    return std::make_optional<binary_collection>(filename.c_str());
+                }
+                return std::nullopt;
+            }
+        };
+
+        spdlog::info("Merging posting lists");
+        std::vector<uint32_t> document_sizes;
+        std::deque<Batch_Cursor> batches;
         for (auto batch: ranges::views::iota(0, batch_count)) {
-            spdlog::debug("[Concatenating batches] Batch {}/{}", batch, batch_count);
-            std::ifstream is(batch_file(basename, batch));
-            is.ignore(8);
-            os << is.rdbuf();
+            auto batch_basename = batch_file(basename, batch);
+            std::ifstream sizes_is(batch_basename + ".sizes");
+            read_sequence(sizes_is, document_sizes);
+            batches.emplace_back(batch_basename);
+        }
+        {
+            std::ofstream sos(basename + ".sizes");
+            write_sequence(sos, gsl::span<uint32_t const>(document_sizes));
         }
 
+        auto greater = [&](std::ptrdiff_t lhs, std::ptrdiff_t rhs) {
+            return std::tie(batches[rhs].term, rhs) < std::tie(batches[lhs].term, lhs);
+        };
+        std::priority_queue<std::ptrdiff_t, std::vector<std::ptrdiff_t>, decltype(greater)> heap(
+            greater);
+        for (auto batch: ranges::views::iota(0, batch_count)) {
+            if (batches[batch].valid) {
+                heap.push(batch);
+            }
+        }
+
+        std::ofstream term_os(basename + ".terms");
+        std::ofstream dos(basename + ".docs");
+        std::ofstream fos(basename + ".freqs");
+        auto count = static_cast<uint32_t>(document_count);
+        write_sequence(dos, gsl::make_span<uint32_t const>(&count, 1));
+        std::vector<uint32_t> dlist;
+        std::vector<uint32_t> flist;
+        std::size_t term_count = 0;
+        while (not heap.empty()) {
+            std::string term = batches[heap.top()].term;
+            dlist.clear();
+            flist.clear();
+            while (not heap.empty() and batches[heap.top()].term == term) {
+                auto index = heap.top();
+                auto& batch = batches[index];
+                heap.pop();
+                auto documents = *batch.document_list;
+                auto frequencies = *batch.frequency_list;
+                dlist.insert(dlist.end(), documents.begin(), documents.end());
+                flist.insert(flist.end(), frequencies.begin(), frequencies.end());
+                ++batch.document_list;
+                ++batch.frequency_list;
+                batch.advance();
+                if (batch.valid) {
+                    heap.push(index);
+                }
+            }
+            term_os << term << '\n';
+            write_sequence(dos, gsl::span<uint32_t const>(dlist));
+            write_sequence(fos, gsl::span<uint32_t const>(flist));
+            term_count += 1;
+        }
+        term_os.close();
+
+        spdlog::info("Creating term lexicon");
+        std::ifstream term_is(basename + ".terms");
+        encode_payload_vector(
+            std::istream_iterator<io::Line>(term_is), std::istream_iterator<io::Line>())
+            .to_file(basename + ".termlex");
+
+        spdlog::info("Number of terms: {}", term_count);
+        spdlog::info("Number of documents: {}", document_count);
         spdlog::info("Success.");
     }
 
-    void build(
-        std::istream& is,
+    /// Reads records from `next_record`, until it returns `std::nullopt`, into batches of
+    /// `batch_size` and passes each batch to `run_batch` as a separate task, with at most
+    /// `2 * (threads - 1)` batches in flight.
+    ///
+    /// Returns the number of documents and the number of batches.
+    template <typename RunBatch>
+    [[nodiscard]] auto build_batches(
         std::string const& output_file,
-        read_record_function_type next_record,
-        process_term_function_type process_term,
-        process_content_function_type process_content,
+        next_record_function_type const& next_record,
         std::ptrdiff_t batch_size,
-        std::size_t threads) const
+        std::size_t threads,
+        RunBatch run_batch) const -> std::pair<std::ptrdiff_t, std::ptrdiff_t>
     {
         if (threads < 2) {
             spdlog::error("Building forward index requires at least 2 threads");
@@ -337,12 +592,12 @@ class Forward_Index_Builder {
         queue.set_capacity((threads - 1) * 2);
         while (true) {
             std::optional<Document_Record> record = std::nullopt;
-            if (not(record = next_record(is))) {
+            if (not(record = next_record())) {
                 auto last_batch_size = record_batch.size();
                 Batch_Process bp{batch_number, std::move(record_batch), first_document, output_file};
                 queue.push(0);
-                batch_group.run([bp = std::move(bp), process_term, this, &queue, &process_content]() {
-                    run(std::move(bp), process_term, process_content);
+                batch_group.run([bp = std::move(bp), &run_batch, &queue]() {
+                    run_batch(std::move(bp));
                     int x;
                     queue.try_pop(x);
                 });
@@ -356,8 +611,8 @@ class Forward_Index_Builder {
             if (record_batch.size() == batch_size) {
                 Batch_Process bp{batch_number, std::move(record_batch), first_document, output_file};
                 queue.push(0);
-                batch_group.run([bp = std::move(bp), process_term, this, &queue, &process_content]() {
-                    run(std::move(bp), process_term, process_content);
+                batch_group.run([bp = std::move(bp), &run_batch, &queue]() {
+                    run_batch(std::move(bp));
                     int x;
                     queue.try_pop(x);
                 });
@@ -367,8 +622,84 @@ class Forward_Index_Builder {
             }
         }
         batch_group.wait();
-        merge(output_file, first_document.as_int(), batch_number);
-        remove_batches(output_file, batch_number);
+        return {first_document.as_int(), batch_number};
+    }
+
+    void build(
+        std::istream& is,
+        std::string const& output_file,
+        read_record_function_type next_record,
+        process_term_function_type process_term,
+        process_content_function_type process_content,
+        std::ptrdiff_t batch_size,
+        std::size_t threads) const
+    {
+        build(
+            [&]() { return next_record(is); },
+            output_file,
+            std::move(process_term),
+            std::move(process_content),
+            batch_size,
+            threads);
+    }
+
+    /// Builds the forward index from the records returned by `next_record`, such as those read
+    /// from files by `parsing::warc::Parallel_Reader`, until it returns `std::nullopt`.
+    void build(
+        next_record_function_type const& next_record,
+        std::string const& output_file,
+        process_term_function_type process_term,
+        process_content_function_type process_content,
+        std::ptrdiff_t batch_size,
+        std::size_t threads) const
+    {
+        auto [document_count, batch_count] = build_batches(
+            output_file, next_record, batch_size, threads, [&](Batch_Process bp) {
+                run(std::move(bp), process_term, process_content);
+            });
+        merge(output_file, document_count, batch_count);
+        remove_batches(output_file, batch_count);
+    }
+
+    /// Builds an inverted index straight from the collection, without writing a forward index.
+    ///
+    /// Batches are inverted in memory as soon as they are parsed, and `merge_inverted` merges
+    /// them into `<output_file>.{docs,freqs,sizes}`, along with the same term and document
+    /// files as `build`.
+    void build_inverted(
+        std::istream& is,
+        std::string const& output_file,
+        read_record_function_type next_record,
+        process_term_function_type process_term,
+        process_content_function_type process_content,
+        std::ptrdiff_t batch_size,
+        std::size_t threads) const
+    {
+        build_inverted(
+            [&]() { return next_record(is); },
+            output_file,
+            std::move(process_term),
+            std::move(process_content),
+            batch_size,
+            threads);
+    }
+
+    /// Same as `build_inverted`, with records returned by `next_record` until it returns
+    /// `std::nullopt`.
+    void build_inverted(
+        next_record_function_type const& next_record,
+        std::string const& output_file,
+        process_term_function_type process_term,
+        process_content_function_type process_content,
+        std::ptrdiff_t batch_size,
+        std::size_t threads) const
+    {
+        auto [document_count, batch_count] = build_batches(
+            output_file, next_record, batch_size, threads, [&](Batch_Process bp) {
+                run_inverted(std::move(bp), process_term, process_content);
+            });
+        merge_inverted(output_file, document_count, batch_count);
+        remove_batches(output_file, batch_count);
     }
 
     void remove_batches(std::string const& basename, std::ptrdiff_t batch_count) const
@@ -380,6 +711,9 @@ class Forward_Index_Builder {
             remove(path{batch_basename + ".documents"});
             remove(path{batch_basename + ".terms"});
             remove(path{batch_basename + ".urls"});
+            remove(path{batch_basename + ".docs"});
+            remove(path{batch_basename + ".freqs"});
+            remove(path{batch_basename + ".sizes"});
             remove(path{batch_basename});
         }
     }
@@ -1,14 +1,36 @@
 #pragma once
 
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <gsl/span>
+
 #include "tbb/parallel_invoke.h"
 
 #include "bitvector_collection.hpp"
 #include "codec/compact_elias_fano.hpp"
 #include "codec/integer_codes.hpp"
 #include "global_parameters.hpp"
+#include "util/semiasync_queue.hpp"
 
 namespace pisa {
 
+/// Detects sequence enumerators that find a batch of increasing values at once with
+/// `intersect(values, count, fn)`, such as those of `compact_elias_fano`.
+template <typename Enumerator, typename = void>
+struct has_sequence_intersect: std::false_type {
+};
+
+template <typename Enumerator>
+struct has_sequence_intersect<
+    Enumerator,
+    std::void_t<decltype(std::declval<Enumerator&>().intersect(
+        std::declval<uint32_t const*>(),
+        std::size_t(),
+        std::declval<void (*)(std::size_t, uint64_t)>()))>>: std::true_type {
+};
+
 template <typename DocsSequence, typename FreqsSequence>
 class freq_index {
   public:
@@ -17,12 +39,17 @@ class freq_index {
     class builder {
       public:
         builder(uint64_t num_docs, global_parameters const& params)
-            : m_params(params),
+            : m_queue(1 << 22),
+              m_params(params),
               m_num_docs(num_docs),
               m_docs_sequences(params),
               m_freqs_sequences(params)
         {}
 
+        /// Encodes the posting list in a background thread. Lists are gathered into batches
+        /// of about `batch_postings` postings, each encoded by one thread into bitvectors of its
+        /// own, which are then stitched onto the sequences in the order the lists are added.
+        /// The postings are copied, so the iterators need not outlive the call.
         template <typename DocsIterator, typename FreqsIterator>
         void add_posting_list(
             uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin, uint64_t occurrences)
@@ -30,25 +57,22 @@ class freq_index {
             if (!n)
                 throw std::invalid_argument("List must be nonempty");
 
-            tbb::parallel_invoke(
-                [&] {
-                    bit_vector_builder docs_bits;
-                    write_gamma_nonzero(docs_bits, occurrences);
-                    if (occurrences > 1) {
-                        docs_bits.append_bits(n, ceil_log2(occurrences + 1));
-                    }
-                    DocsSequence::write(docs_bits, docs_begin, m_num_docs, n, m_params);
-                    m_docs_sequences.append(docs_bits);
-                },
-                [&] {
-                    bit_vector_builder freqs_bits;
-                    FreqsSequence::write(freqs_bits, freqs_begin, occurrences + 1, n, m_params);
-                    m_freqs_sequences.append(freqs_bits);
-                });
+            if (!m_batch) {
+                m_batch = std::make_shared<batch_adder>(*this);
+            }
+            m_batch->docs.emplace_back(docs_begin, std::next(docs_begin, n));
+            m_batch->freqs.emplace_back(freqs_begin, std::next(freqs_begin, n));
+            m_batch->occurrences.push_back(occurrences);
+            m_batch->postings += n;
+            if (m_batch->postings >= batch_postings) {
+                submit_batch();
+            }
         }
 
         void build(freq_index& sq)
         {
+            submit_batch();
+            m_queue.complete();
             sq.m_num_docs = m_num_docs;
             sq.m_params = m_params;
 
@@ -57,10 +81,76 @@ class freq_index {
         }
 
       private:
+        static constexpr uint64_t batch_postings = 1 << 22;
+
+        void submit_batch()
+        {
+            if (m_batch) {
+                auto postings = m_batch->postings;
+                m_queue.add_job(std::move(m_batch), postings);
+                m_batch.reset();
+            }
+        }
+
+        struct batch_adder: semiasync_queue::job {
+            explicit batch_adder(builder& b) : b(b) {}
+
+            void prepare() override
+            {
+                tbb::parallel_invoke(
+                    [&] {
+                        for (std::size_t i = 0; i < docs.size(); ++i) {
+                            uint64_t n = docs[i].size();
+                            write_gamma_nonzero(docs_bits, occurrences[i]);
+                            if (occurrences[i] > 1) {
+                                docs_bits.append_bits(n, ceil_log2(occurrences[i] + 1));
+                            }
+                            DocsSequence::write(
+                                docs_bits, docs[i].begin(), b.m_num_docs, n, b.m_params);
+                            docs_endpoints.push_back(docs_bits.size());
+                        }
+                        docs.clear();
+                        docs.shrink_to_fit();
+                    },
+                    [&] {
+                        for (std::size_t i = 0; i < freqs.size(); ++i) {
+                            FreqsSequence::write(
+                                freqs_bits,
+                                freqs[i].begin(),
+                                occurrences[i] + 1,
+                                freqs[i].size(),
+                                b.m_params);
+                            freqs_endpoints.push_back(freqs_bits.size());
+                        }
+                        freqs.clear();
+                        freqs.shrink_to_fit();
+                    });
+            }
+
+            void commit() override
+            {
+                tbb::parallel_invoke(
+                    [&] { b.m_docs_sequences.append_batch(docs_bits, docs_endpoints); },
+                    [&] { b.m_freqs_sequences.append_batch(freqs_bits, freqs_endpoints); });
+            }
+
+            builder& b;
+            std::vector<std::vector<uint64_t>> docs;
+            std::vector<std::vector<uint64_t>> freqs;
+            std::vector<uint64_t> occurrences;
+            uint64_t postings = 0;
+            bit_vector_builder docs_bits;
+            bit_vector_builder freqs_bits;
+            std::vector<uint64_t> docs_endpoints;
+            std::vector<uint64_t> freqs_endpoints;
+        };
+
+        semiasync_queue m_queue;
         global_parameters m_params;
         uint64_t m_num_docs;
         bitvector_collection::builder m_docs_sequences;
         bitvector_collection::builder m_freqs_sequences;
+        std::shared_ptr<batch_adder> m_batch;
     };
 
     uint64_t size() const { return m_docs_sequences.size(); }
@@ -98,8 +188,44 @@ class freq_index {
 
         uint64_t docid() const { return m_cur_docid; }
 
+        /// Calls `fn(i)` for every `docids[i]` in the list, with the enumerator at it, where
+        /// `docids` are increasing and none is below the current docid. The enumerator is then
+        /// left at the first docid of at least the last one, as after `next_geq`.
+        ///
+        /// Docid sequences that support it, such as `compact_elias_fano`, find all docids in one
+        /// pass over their high bits; the others call `next_geq` for each.
+        template <typename Fn>
+        void intersect(uint32_t const* docids, std::size_t count, Fn fn)
+        {
+            if constexpr (has_sequence_intersect<typename DocsSequence::enumerator>::value) {
+                m_docs_enum.intersect(docids, count, [&](std::size_t i, uint64_t position) {
+                    m_cur_pos = position;
+                    m_cur_docid = docids[i];
+                    fn(i);
+                });
+                auto val = m_docs_enum.value();
+                m_cur_pos = val.first;
+                m_cur_docid = val.second;
+            } else {
+                for (std::size_t i = 0; i < count; ++i) {
+                    next_geq(docids[i]);
+                    if (m_cur_docid == docids[i]) {
+                        fn(i);
+                    }
+                }
+            }
+        }
+
         uint64_t PISA_FLATTEN_FUNC freq() { return m_freqs_enum.move(m_cur_pos).second; }
 
+        /// Writes the frequencies of the `out.size()` postings from the current one to `out`,
+        /// without moving the enumerator, so that a run of postings can be scored in one batch.
+        void PISA_FLATTEN_FUNC freqs(gsl::span<uint64_t> out)
+        {
+            assert(m_cur_pos + out.size() <= size());
+            m_freqs_enum.decode(m_cur_pos, out);
+        }
+
         uint64_t position() const { return m_cur_pos; }
 
         uint64_t size() const { return m_docs_enum.size(); }
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+#include <gsl/span>
+
+#include "payload_vector.hpp"
+
+namespace pisa {
+
+namespace detail {
+
+    constexpr std::uint64_t front_coded_vector_magic = 0x3143465f41534950ULL;  // "PISA_FC1"
+
+    template <typename OutputIterator>
+    void write_varint(std::uint64_t value, OutputIterator out)
+    {
+        while (value >= 128U) {
+            *out++ = static_cast<std::byte>((value & 127U) | 128U);
+            value >>= 7U;
+        }
+        *out++ = static_cast<std::byte>(value);
+    }
+
+    [[nodiscard]] inline auto read_varint(std::byte const*& in) -> std::uint64_t
+    {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            auto byte = std::to_integer<std::uint64_t>(*in++);
+            value |= (byte & 127U) << shift;
+            if (byte < 128U) {
+                return value;
+            }
+        }
+    }
+
+}  // namespace detail
+
+/// A front-coded sequence of strings under construction, or read into memory.
+///
+/// Strings are grouped into buckets of `bucket_size`. The first string of each bucket is stored
+/// in full, and every other one as the length of the prefix it shares with its predecessor
+/// followed by the remaining suffix. Lengths are variable-byte encoded, and a single offset
+/// is kept per bucket, so a sorted lexicon takes a fraction of its `Payload_Vector` size.
+struct Front_Coded_Vector_Buffer {
+    static constexpr std::uint64_t default_bucket_size = 16;
+
+    std::uint64_t size;
+    std::uint64_t bucket_size;
+    std::vector<std::uint64_t> bucket_offsets;
+    std::vector<std::byte> payloads;
+
+    template <typename InputIterator>
+    [[nodiscard]] static auto
+    make(InputIterator first, InputIterator last, std::uint64_t bucket_size = default_bucket_size)
+        -> Front_Coded_Vector_Buffer
+    {
+        if (bucket_size == 0) {
+            throw std::invalid_argument("Bucket size must be positive");
+        }
+        Front_Coded_Vector_Buffer buffer{0, bucket_size, {}, {}};
+        auto out = std::back_inserter(buffer.payloads);
+        std::string previous;
+        for (; first != last; ++first) {
+            std::string_view term(*first);
+            auto value = term;
+            if (buffer.size % bucket_size == 0) {
+                buffer.bucket_offsets.push_back(buffer.payloads.size());
+                detail::write_varint(value.size(), out);
+            } else {
+                auto [shared, _] = std::mismatch(
+                    value.begin(), value.end(), previous.begin(), previous.end());
+                auto prefix = static_cast<std::size_t>(std::distance(value.begin(), shared));
+                detail::write_varint(prefix, out);
+                detail::write_varint(value.size() - prefix, out);
+                value.remove_prefix(prefix);
+            }
+            std::transform(value.begin(), value.end(), out, [](auto ch) {
+                return static_cast<std::byte>(ch);
+            });
+            previous.assign(term.begin(), term.end());
+            buffer.size += 1;
+        }
+        buffer.bucket_offsets.push_back(buffer.payloads.size());
+        return buffer;
+    }
+
+    void to_file(std::string const& filename) const
+    {
+        std::ofstream os(filename, std::ios::binary);
+        to_stream(os);
+    }
+
+    void to_stream(std::ostream& os) const
+    {
+        std::uint64_t bucket_count = bucket_offsets.size() - 1U;
+        for (auto value: {detail::front_coded_vector_magic, size, bucket_size, bucket_count}) {
+            os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+        }
+        os.write(
+            reinterpret_cast<char const*>(bucket_offsets.data()),
+            bucket_offsets.size() * sizeof(bucket_offsets[0]));
+        os.write(reinterpret_cast<char const*>(payloads.data()), payloads.size());
+    }
+};
+
+template <typename InputIterator>
+auto encode_front_coded_vector(
+    InputIterator first,
+    InputIterator last,
+    std::uint64_t bucket_size = Front_Coded_Vector_Buffer::default_bucket_size)
+{
+    return Front_Coded_Vector_Buffer::make(first, last, bucket_size);
+}
+
+/// A read-only view of a front-coded sequence of strings, e.g., a memory-mapped lexicon.
+///
+/// Unlike `Payload_Vector`, strings are decoded on access, so they are returned by value.
+/// `find` assumes that the strings are sorted.
+class Front_Coded_Vector {
+  public:
+    using size_type = std::uint64_t;
+
+    Front_Coded_Vector(Front_Coded_Vector_Buffer const& buffer)
+        : Front_Coded_Vector(
+            buffer.size, buffer.bucket_size, buffer.bucket_offsets, buffer.payloads)
+    {}
+
+    Front_Coded_Vector(
+        size_type size,
+        size_type bucket_size,
+        gsl::span<std::uint64_t const> bucket_offsets,
+        gsl::span<std::byte const> payloads)
+        : m_size(size),
+          m_bucket_size(bucket_size),
+          m_bucket_offsets(bucket_offsets),
+          m_payloads(payloads)
+    {}
+
+    /// Checks whether `mem` starts like a serialized front-coded vector.
+    template <typename ContiguousContainer>
+    [[nodiscard]] static auto is_front_coded(ContiguousContainer&& mem) -> bool
+    {
+        std::uint64_t magic = 0;
+        if (mem.size() >= sizeof(magic)) {
+            std::memcpy(&magic, mem.data(), sizeof(magic));
+        }
+        return magic == detail::front_coded_vector_magic;
+    }
+
+    template <typename ContiguousContainer>
+    [[nodiscard]] static auto from(ContiguousContainer&& mem) -> Front_Coded_Vector
+    {
+        return from(gsl::make_span(reinterpret_cast<std::byte const*>(mem.data()), mem.size()));
+    }
+
+    [[nodiscard]] static auto from(gsl::span<std::byte const> mem) -> Front_Coded_Vector
+    {
+        auto [magic, size, bucket_size, bucket_count, tail] =
+            unpack_head<std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t>(mem);
+        if (magic != detail::front_coded_vector_magic) {
+            throw std::runtime_error("Not a front-coded vector");
+        }
+        auto [offsets, payloads] = split(tail, (bucket_count + 1U) * sizeof(std::uint64_t));
+        return Front_Coded_Vector(size, bucket_size, cast_span<std::uint64_t>(offsets), payloads);
+    }
+
+    [[nodiscard]] auto size() const -> size_type { return m_size; }
+
+    [[nodiscard]] auto operator[](size_type idx) const -> std::string
+    {
+        std::string value;
+        get(idx, value);
+        return value;
+    }
+
+    /// Decodes the string at `idx` into `value` and returns a view of it, so that a buffer
+    /// reused across calls saves allocating every string.
+    auto get(size_type idx, std::string& value) const -> std::string_view
+    {
+        if (idx >= m_size) {
+            throw std::out_of_range(
+                fmt::format("Index {} too large for front-coded vector of size {}", idx, m_size));
+        }
+        auto const* in = bucket_begin(idx / m_bucket_size, value);
+        for (auto pos = idx % m_bucket_size; pos > 0; --pos) {
+            in = next(in, value);
+        }
+        return value;
+    }
+
+    /// Returns the position of `value`, found by binary search over bucket heads followed by a
+    /// scan of one bucket.
+    [[nodiscard]] auto find(std::string_view value) const -> std::optional<size_type>
+    {
+        size_type bucket_count = m_bucket_offsets.size() - 1U;
+        size_type first = 0;
+        size_type count = bucket_count;
+        // Finds the first bucket whose head is greater than `value`.
+        while (count > 0) {
+            auto step = count / 2;
+            if (head(first + step) <= value) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        if (first == 0) {
+            return std::nullopt;
+        }
+        auto bucket = first - 1;
+        std::string current;
+        auto const* in = bucket_begin(bucket, current);
+        auto idx = bucket * m_bucket_size;
+        auto last = std::min(idx + m_bucket_size, m_size);
+        while (true) {
+            if (current == value) {
+                return idx;
+            }
+            if (current > value or ++idx == last) {
+                return std::nullopt;
+            }
+            in = next(in, current);
+        }
+    }
+
+    /// Calls `fun` on every string in order, decoding each bucket once.
+    template <typename Fn>
+    void for_each(Fn fun) const
+    {
+        std::string value;
+        for (size_type bucket = 0; bucket + 1U < m_bucket_offsets.size(); ++bucket) {
+            auto const* in = bucket_begin(bucket, value);
+            auto last = std::min((bucket + 1U) * m_bucket_size, m_size);
+            for (auto idx = bucket * m_bucket_size; idx < last; ++idx) {
+                if (idx > bucket * m_bucket_size) {
+                    in = next(in, value);
+                }
+                fun(std::string_view(value));
+            }
+        }
+    }
+
+  private:
+    [[nodiscard]] auto head(size_type bucket) const -> std::string_view
+    {
+        auto const* in = m_payloads.data() + m_bucket_offsets[bucket];
+        auto length = detail::read_varint(in);
+        return std::string_view(reinterpret_cast<char const*>(in), length);
+    }
+
+    auto bucket_begin(size_type bucket, std::string& value) const -> std::byte const*
+    {
+        auto const* in = m_payloads.data() + m_bucket_offsets[bucket];
+        auto length = detail::read_varint(in);
+        value.assign(reinterpret_cast<char const*>(in), length);
+        return in + length;
+    }
+
+    static auto next(std::byte const* in, std::string& value) -> std::byte const*
+    {
+        auto prefix = detail::read_varint(in);
+        auto suffix = detail::read_varint(in);
+        value.resize(prefix);
+        value.append(reinterpret_cast<char const*>(in), suffix);
+        return in + suffix;
+    }
+
+    size_type m_size;
+    size_type m_bucket_size;
+    gsl::span<std::uint64_t const> m_bucket_offsets;
+    gsl::span<std::byte const> m_payloads;
+};
+
+}  // namespace pisa
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+
+namespace pisa {
+
+/// Statistics of a whole collection, for the terms of one of its shards.
+///
+/// Scorers of a shard only see the statistics of its own documents in its WAND data, so that
+/// the same document would get different scores in different shards, and the results of the
+/// shards could not be merged by score. These statistics are those of all shards, indexed by
+/// the term IDs of one shard, so that its scores are the ones of the unsharded collection.
+class global_statistics {
+  public:
+    global_statistics() = default;
+
+    global_statistics(
+        uint64_t num_docs,
+        uint64_t collection_len,
+        std::vector<uint64_t> term_posting_counts,
+        std::vector<uint64_t> term_occurrence_counts)
+        : m_num_docs(num_docs),
+          m_collection_len(collection_len),
+          m_avg_len(num_docs > 0 ? float(collection_len / double(num_docs)) : 0.0F)
+    {
+        m_term_posting_counts.steal(term_posting_counts);
+        m_term_occurrence_counts.steal(term_occurrence_counts);
+    }
+
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_num_docs; }
+    [[nodiscard]] auto collection_len() const -> uint64_t { return m_collection_len; }
+    [[nodiscard]] auto avg_len() const -> float { return m_avg_len; }
+    [[nodiscard]] auto term_count() const -> std::size_t { return m_term_posting_counts.size(); }
+
+    [[nodiscard]] auto term_posting_count(uint64_t term_id) const -> uint64_t
+    {
+        return m_term_posting_counts[term_id];
+    }
+
+    [[nodiscard]] auto term_occurrence_count(uint64_t term_id) const -> uint64_t
+    {
+        return m_term_occurrence_counts[term_id];
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_num_docs, "m_num_docs")(m_collection_len, "m_collection_len")(
+            m_avg_len, "m_avg_len")(m_term_posting_counts, "m_term_posting_counts")(
+            m_term_occurrence_counts, "m_term_occurrence_counts");
+    }
+
+  private:
+    uint64_t m_num_docs = 0;
+    uint64_t m_collection_len = 0;
+    float m_avg_len = 0;
+    mapper::mappable_vector<uint64_t> m_term_posting_counts;
+    mapper::mappable_vector<uint64_t> m_term_occurrence_counts;
+};
+
+/// WAND data of a shard whose collection and term statistics are replaced by global ones.
+///
+/// Scorers instantiated with it score documents as in the whole collection. Everything
+/// else, including document lengths and score upper bounds, comes from the WAND data of
+/// the shard, whose upper bounds must therefore have been computed with the same statistics
+/// (see `create_wand_data --global-stats`).
+template <typename Wand>
+class global_wand_data {
+  public:
+    using wand_data_enumerator = typename Wand::wand_data_enumerator;
+
+    global_wand_data(Wand const& wdata, global_statistics const& stats)
+        : m_wdata(&wdata), m_stats(&stats), m_len_scale(wdata.avg_len() / stats.avg_len())
+    {}
+
+    /// The length of a document divided by the global average length.
+    [[nodiscard]] auto norm_len(uint64_t doc_id) const -> float
+    {
+        return m_wdata->norm_len(doc_id) * m_len_scale;
+    }
+
+    [[nodiscard]] auto doc_len(uint64_t doc_id) const -> size_t
+    {
+        return m_wdata->doc_len(doc_id);
+    }
+
+    [[nodiscard]] auto term_occurrence_count(uint64_t term_id) const -> size_t
+    {
+        return m_stats->term_occurrence_count(term_id);
+    }
+
+    [[nodiscard]] auto term_posting_count(uint64_t term_id) const -> size_t
+    {
+        return m_stats->term_posting_count(term_id);
+    }
+
+    [[nodiscard]] auto num_docs() const -> size_t { return m_stats->num_docs(); }
+    [[nodiscard]] auto avg_len() const -> float { return m_stats->avg_len(); }
+    [[nodiscard]] auto collection_len() const -> uint64_t { return m_stats->collection_len(); }
+
+    [[nodiscard]] auto index_max_term_weight() const -> float
+    {
+        return m_wdata->index_max_term_weight();
+    }
+
+    [[nodiscard]] auto max_term_weight(uint64_t list) const -> float
+    {
+        return m_wdata->max_term_weight(list);
+    }
+
+    [[nodiscard]] auto getenum(size_t i) const -> wand_data_enumerator
+    {
+        return m_wdata->getenum(i);
+    }
+
+    [[nodiscard]] auto get_block_wand() const -> decltype(auto)
+    {
+        return m_wdata->get_block_wand();
+    }
+
+  private:
+    Wand const* m_wdata;
+    global_statistics const* m_stats;
+    float m_len_scale;
+};
+
+/// Computes the global statistics of `shard_count` shards, and writes those of shard `i` to
+/// `{output_basename}.{i:03d}`.
+///
+/// The inverted index of shard `i` is read from `{collection_basename}.{i:03d}`, and its
+/// terms, as written by `partition_fwd_index`, from `{terms_basename}.{i:03d}.terms`.
+void compute_global_statistics(
+    std::string const& collection_basename,
+    std::string const& terms_basename,
+    std::size_t shard_count,
+    std::string const& output_basename);
+
+}  // namespace pisa
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/warmup.hpp"
+
+#include "block_posting_list.hpp"
+#include "codec/block_codecs.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "codec/simdbp.hpp"
+#include "codec/varintgb.hpp"
+#include "util/semiasync_queue.hpp"
+
+namespace pisa {
+
+/// The block codecs a list of a `hybrid_block_index` can be encoded with. The position of a
+/// codec in the tuple is the tag stored in front of the lists it encodes.
+using hybrid_codecs = std::tuple<simdbp_block, varintgb_block, optpfor_block, interpolative_block>;
+
+constexpr std::size_t hybrid_codec_count = std::tuple_size_v<hybrid_codecs>;
+
+constexpr std::array<std::string_view, hybrid_codec_count> hybrid_codec_names{
+    "simdbp", "varintgb", "optpfor", "interpolative"};
+
+/// Returns the tag of the hybrid codec called `name`.
+[[nodiscard]] inline auto parse_hybrid_codec(std::string_view name) -> uint8_t
+{
+    auto pos = std::find(hybrid_codec_names.begin(), hybrid_codec_names.end(), name);
+    if (pos == hybrid_codec_names.end()) {
+        throw std::invalid_argument("Unknown hybrid codec " + std::string(name));
+    }
+    return pos - hybrid_codec_names.begin();
+}
+
+/// Calls `fn` with the `std::integral_constant` of the codec tagged `codec`, so that a single
+/// jump on the tag selects the statically typed code of the codec.
+template <typename Fn>
+decltype(auto) with_hybrid_codec(uint8_t codec, Fn&& fn)
+{
+    static_assert(hybrid_codec_count == 4, "a case is needed for every hybrid codec");
+    switch (codec) {
+    case 0: return fn(std::integral_constant<std::size_t, 0>{});
+    case 1: return fn(std::integral_constant<std::size_t, 1>{});
+    case 2: return fn(std::integral_constant<std::size_t, 2>{});
+    case 3: return fn(std::integral_constant<std::size_t, 3>{});
+    default: throw std::invalid_argument("Invalid hybrid codec tag");
+    }
+}
+
+/// The space and the expected decoding time of a posting list encoded with one of the hybrid
+/// codecs.
+struct hybrid_codec_cost {
+    uint64_t space;
+    double time;
+};
+
+/// Selects a codec for every list, given the costs of each codec on each list, minimizing the
+/// total time under `space_budget` bytes.
+///
+/// The lists start with their smallest codec. Along the lower convex hull of the space-time
+/// points of a list, every step towards a larger and faster codec saves time at a decreasing
+/// rate per byte, so the steps of all lists are taken in decreasing order of that rate, as
+/// long as they fit in the budget. This is the Lagrangian relaxation of the problem: the
+/// result is optimal for the space it takes, which is at most one step of a list away from
+/// the budget. Without a budget, every list gets its fastest codec.
+[[nodiscard]] inline auto select_hybrid_codecs(
+    std::vector<std::array<hybrid_codec_cost, hybrid_codec_count>> const& costs,
+    std::optional<uint64_t> space_budget) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> selection(costs.size());
+    auto by_space = [](auto const& lhs, auto const& rhs) {
+        return std::make_pair(lhs.space, lhs.time) < std::make_pair(rhs.space, rhs.time);
+    };
+    auto by_time = [](auto const& lhs, auto const& rhs) {
+        return std::make_pair(lhs.time, lhs.space) < std::make_pair(rhs.time, rhs.space);
+    };
+
+    uint64_t space = 0;
+    for (std::size_t list = 0; list < costs.size(); ++list) {
+        auto const& list_costs = costs[list];
+        auto choice = space_budget
+            ? std::min_element(list_costs.begin(), list_costs.end(), by_space)
+            : std::min_element(list_costs.begin(), list_costs.end(), by_time);
+        selection[list] = choice - list_costs.begin();
+        space += choice->space;
+    }
+    if (not space_budget || space >= *space_budget) {
+        return selection;
+    }
+
+    struct step {
+        double rate;
+        uint32_t list;
+        uint8_t codec;
+    };
+    std::vector<step> steps;
+    std::array<uint8_t, hybrid_codec_count> order;
+    std::vector<uint8_t> hull;
+    for (std::size_t list = 0; list < costs.size(); ++list) {
+        auto const& list_costs = costs[list];
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+            return by_space(list_costs[lhs], list_costs[rhs]);
+        });
+        auto rate = [&](uint8_t from, uint8_t to) {
+            return (list_costs[from].time - list_costs[to].time)
+                / static_cast<double>(list_costs[to].space - list_costs[from].space);
+        };
+        hull.clear();
+        for (auto codec: order) {
+            auto const& cost = list_costs[codec];
+            if (not hull.empty()
+                && (cost.time >= list_costs[hull.back()].time
+                    || cost.space == list_costs[hull.back()].space)) {
+                continue;
+            }
+            while (hull.size() >= 2
+                   && rate(hull[hull.size() - 2], hull.back()) <= rate(hull.back(), codec)) {
+                hull.pop_back();
+            }
+            hull.push_back(codec);
+        }
+        for (std::size_t idx = 1; idx < hull.size(); ++idx) {
+            steps.push_back(step{rate(hull[idx - 1], hull[idx]), uint32_t(list), hull[idx]});
+        }
+    }
+
+    // The steps of a list have decreasing rates, so a stable sort keeps them in hull order.
+    std::stable_sort(steps.begin(), steps.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.rate > rhs.rate;
+    });
+    std::vector<bool> stuck(costs.size(), false);
+    for (auto const& step: steps) {
+        if (stuck[step.list]) {
+            continue;
+        }
+        auto const& list_costs = costs[step.list];
+        auto added = list_costs[step.codec].space - list_costs[selection[step.list]].space;
+        if (space + added > *space_budget) {
+            stuck[step.list] = true;
+            continue;
+        }
+        space += added;
+        selection[step.list] = step.codec;
+    }
+    return selection;
+}
+
+/// A block index in which every posting list is encoded with its own block codec, out of
+/// `hybrid_codecs`.
+///
+/// A list is a codec tag byte followed by a `block_posting_list` of that codec. Enumerators
+/// dispatch each operation on the tag through a jump table, and then run the code of the
+/// codec's own enumerator. By default, the builder encodes each list with its smallest codec;
+/// `create_hybrid_block_index` rather picks codecs by their predicted decoding time on a query
+/// log, under a space budget.
+class hybrid_block_index {
+    template <std::size_t Codec>
+    using posting_list_type = block_posting_list<std::tuple_element_t<Codec, hybrid_codecs>>;
+
+  public:
+    hybrid_block_index() : m_size(0) {}
+
+    /// Appends the list encoded with the codec tagged `codec` to `out`.
+    template <typename DocsIterator, typename FreqsIterator>
+    static void encode(
+        uint8_t codec,
+        std::vector<uint8_t>& out,
+        uint32_t n,
+        DocsIterator docs_begin,
+        FreqsIterator freqs_begin)
+    {
+        with_hybrid_codec(codec, [&](auto c) {
+            out.push_back(codec);
+            posting_list_type<decltype(c)::value>::write(out, n, docs_begin, freqs_begin);
+        });
+    }
+
+    /// Appends the list encoded with its smallest codec to `out`.
+    template <typename DocsIterator, typename FreqsIterator>
+    static void encode_smallest(
+        std::vector<uint8_t>& out, uint32_t n, DocsIterator docs_begin, FreqsIterator freqs_begin)
+    {
+        thread_local std::vector<uint8_t> buf;
+        thread_local std::vector<uint8_t> smallest;
+        smallest.clear();
+        for (uint8_t codec = 0; codec < hybrid_codec_count; ++codec) {
+            buf.clear();
+            encode(codec, buf, n, docs_begin, freqs_begin);
+            if (smallest.empty() || buf.size() < smallest.size()) {
+                smallest.swap(buf);
+            }
+        }
+        out.insert(out.end(), smallest.begin(), smallest.end());
+    }
+
+    class builder {
+      public:
+        builder(uint64_t num_docs, global_parameters const& params)
+            : m_queue(1 << 22), m_params(params)
+        {
+            m_num_docs = num_docs;
+            m_endpoints.push_back(0);
+        }
+
+        /// Encodes the posting list with its smallest codec in a background thread, as
+        /// `block_freq_index::builder` does.
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_posting_list(
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            uint64_t /* occurrences */)
+        {
+            add_job(std::nullopt, n, docs_begin, freqs_begin);
+        }
+
+        /// Encodes the posting list with the codec tagged `codec` in a background thread.
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_posting_list(
+            uint8_t codec, uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin)
+        {
+            if (codec >= hybrid_codec_count) {
+                throw std::invalid_argument("Invalid hybrid codec tag");
+            }
+            add_job(codec, n, docs_begin, freqs_begin);
+        }
+
+        void build(hybrid_block_index& sq)
+        {
+            m_queue.complete();
+            sq.m_params = m_params;
+            sq.m_size = m_endpoints.size() - 1;
+            sq.m_num_docs = m_num_docs;
+            sq.m_lists.steal(m_lists);
+
+            bit_vector_builder bvb;
+            compact_elias_fano::write(
+                bvb, m_endpoints.begin(), sq.m_lists.size(), sq.m_size, m_params);
+            bit_vector(&bvb).swap(sq.m_endpoints);
+        }
+
+      private:
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_job(
+            std::optional<uint8_t> codec,
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin)
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            std::shared_ptr<list_adder> ptr(new list_adder(
+                *this,
+                codec,
+                std::vector<uint32_t>(docs_begin, std::next(docs_begin, n)),
+                std::vector<uint32_t>(freqs_begin, std::next(freqs_begin, n))));
+            m_queue.add_job(ptr, codec ? n : hybrid_codec_count * n);
+        }
+
+        struct list_adder: semiasync_queue::job {
+            list_adder(
+                builder& b,
+                std::optional<uint8_t> codec,
+                std::vector<uint32_t> docs,
+                std::vector<uint32_t> freqs)
+                : b(b), codec(codec), docs(std::move(docs)), freqs(std::move(freqs))
+            {}
+
+            void prepare() override
+            {
+                if (codec) {
+                    encode(*codec, data, docs.size(), docs.begin(), freqs.begin());
+                } else {
+                    encode_smallest(data, docs.size(), docs.begin(), freqs.begin());
+                }
+                docs.clear();
+                docs.shrink_to_fit();
+                freqs.clear();
+                freqs.shrink_to_fit();
+            }
+
+            void commit() override
+            {
+                b.m_lists.insert(b.m_lists.end(), data.begin(), data.end());
+                b.m_endpoints.push_back(b.m_lists.size());
+            }
+
+            builder& b;
+            std::optional<uint8_t> codec;
+            std::vector<uint32_t> docs;
+            std::vector<uint32_t> freqs;
+            std::vector<uint8_t> data;
+        };
+
+        semiasync_queue m_queue;
+        global_parameters m_params;
+        size_t m_num_docs;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+    };
+
+    class document_enumerator {
+        using enumerator_variant = std::variant<
+            typename posting_list_type<0>::document_enumerator,
+            typename posting_list_type<1>::document_enumerator,
+            typename posting_list_type<2>::document_enumerator,
+            typename posting_list_type<3>::document_enumerator>;
+
+      public:
+        document_enumerator(uint8_t const* data, uint64_t universe, size_t term_id = 0)
+            : m_enum(with_hybrid_codec(*data, [&](auto c) {
+                  return enumerator_variant(
+                      std::in_place_index<decltype(c)::value>, data + 1, universe, term_id);
+              }))
+        {}
+
+        void reset()
+        {
+            std::visit([](auto& e) { e.reset(); }, m_enum);
+        }
+
+        void PISA_ALWAYSINLINE next()
+        {
+            std::visit([](auto& e) { e.next(); }, m_enum);
+        }
+
+        void PISA_ALWAYSINLINE next_geq(uint64_t lower_bound)
+        {
+            std::visit([=](auto& e) { e.next_geq(lower_bound); }, m_enum);
+        }
+
+        void PISA_ALWAYSINLINE move(uint64_t pos)
+        {
+            std::visit([=](auto& e) { e.move(pos); }, m_enum);
+        }
+
+        bool prefetch(uint64_t lower_bound, uint32_t lines) const
+        {
+            return std::visit(
+                [=](auto const& e) { return e.prefetch(lower_bound, lines); }, m_enum);
+        }
+
+        uint64_t docid() const
+        {
+            return std::visit([](auto const& e) { return e.docid(); }, m_enum);
+        }
+
+        uint64_t PISA_ALWAYSINLINE freq()
+        {
+            return std::visit([](auto& e) { return e.freq(); }, m_enum);
+        }
+
+        uint64_t position() const
+        {
+            return std::visit([](auto const& e) { return e.position(); }, m_enum);
+        }
+
+        uint64_t size() const
+        {
+            return std::visit([](auto const& e) { return e.size(); }, m_enum);
+        }
+
+        uint64_t num_blocks() const
+        {
+            return std::visit([](auto const& e) { return e.num_blocks(); }, m_enum);
+        }
+
+        uint64_t stats_freqs_size() const
+        {
+            return std::visit([](auto const& e) { return e.stats_freqs_size(); }, m_enum);
+        }
+
+        /// Returns the tag of the codec of the list.
+        [[nodiscard]] auto codec() const -> uint8_t { return m_enum.index(); }
+
+      private:
+        enumerator_variant m_enum;
+    };
+
+    size_t size() const { return m_size; }
+
+    uint64_t num_docs() const { return m_num_docs; }
+
+    document_enumerator operator[](size_t i) const
+    {
+        return document_enumerator(list_data(i), num_docs(), i);
+    }
+
+    /// Returns the tag of the codec of the i-th posting list.
+    [[nodiscard]] auto codec(size_t i) const -> uint8_t { return *list_data(i); }
+
+    void warmup(size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+
+        auto begin = endpoints.move(i).second;
+        auto end = m_lists.size();
+        if (i + 1 != size()) {
+            end = endpoints.move(i + 1).second;
+        }
+        mapper::warmup_memory(m_lists.data() + begin, end - begin);
+    }
+
+    void swap(hybrid_block_index& other)
+    {
+        std::swap(m_params, other.m_params);
+        std::swap(m_size, other.m_size);
+        std::swap(m_num_docs, other.m_num_docs);
+        m_endpoints.swap(other.m_endpoints);
+        m_lists.swap(other.m_lists);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
+            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+    }
+
+  private:
+    [[nodiscard]] auto list_data(size_t i) const -> uint8_t const*
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        return m_lists.data() + endpoints.move(i).second;
+    }
+
+    global_parameters m_params;
+    size_t m_size;
+    size_t m_num_docs = 0;
+    bit_vector m_endpoints;
+    mapper::mappable_vector<uint8_t> m_lists;
+};
+
+}  // namespace pisa
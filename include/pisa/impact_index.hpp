@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "codec/block_codecs.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/warmup.hpp"
+#include "util/prefix_sum.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// An impact-ordered inverted index.
+///
+/// The postings of every term are grouped into segments sharing the same impact, stored in
+/// decreasing impact order. Within a segment, docids are increasing and compressed with
+/// `BlockCodec`, one block of `BlockCodec::block_size` postings at a time. Impacts are
+/// expected to be quantized scores, such as the frequencies of an index built with
+/// `create_freq_index --quantize`.
+///
+/// The index may store the lists of some terms only, e.g., the longest ones, alongside a
+/// docid-ordered index of all terms with the same docids and impacts, so that a query can be
+/// processed score-at-a-time or document-at-a-time depending on its terms. The other terms
+/// have empty lists, see `stores`.
+template <typename BlockCodec>
+class impact_index {
+  public:
+    impact_index() : m_size(0), m_num_docs(0) {}
+
+    class builder {
+      public:
+        builder(uint64_t num_docs, global_parameters const& params)
+            : m_params(params), m_num_docs(num_docs)
+        {
+            m_endpoints.push_back(0);
+        }
+
+        /// Adds a docid-ordered posting list, whose frequencies are the impacts.
+        template <typename DocsIterator, typename ImpactsIterator>
+        void add_posting_list(uint64_t n, DocsIterator docs_begin, ImpactsIterator impacts_begin)
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            std::vector<std::pair<uint32_t, uint32_t>> postings;
+            postings.reserve(n);
+            for (uint64_t pos = 0; pos < n; ++pos) {
+                postings.emplace_back(*impacts_begin++, *docs_begin++);
+            }
+            std::stable_sort(
+                postings.begin(), postings.end(), [](auto const& lhs, auto const& rhs) {
+                    return lhs.first > rhs.first;
+                });
+
+            std::vector<uint32_t> impacts;
+            std::vector<uint32_t> sizes;
+            std::vector<uint8_t> segments;
+            std::vector<size_t> segment_endpoints;
+            std::vector<uint32_t> docs;
+            for (auto segment_begin = postings.begin(); segment_begin != postings.end();) {
+                auto impact = segment_begin->first;
+                auto segment_end = std::find_if(segment_begin, postings.end(), [&](auto const& p) {
+                    return p.first != impact;
+                });
+                docs.clear();
+                std::transform(
+                    segment_begin, segment_end, std::back_inserter(docs), [](auto const& p) {
+                        return p.second;
+                    });
+                write_segment(segments, docs);
+                impacts.push_back(impact);
+                sizes.push_back(docs.size());
+                segment_endpoints.push_back(segments.size());
+                segment_begin = segment_end;
+            }
+
+            TightVariableByte::encode_single(impacts.size(), m_lists);
+            size_t segment_begin = 0;
+            for (size_t segment = 0; segment < impacts.size(); ++segment) {
+                TightVariableByte::encode_single(impacts[segment], m_lists);
+                TightVariableByte::encode_single(sizes[segment], m_lists);
+                TightVariableByte::encode_single(
+                    segment_endpoints[segment] - segment_begin, m_lists);
+                segment_begin = segment_endpoints[segment];
+            }
+            m_lists.insert(m_lists.end(), segments.begin(), segments.end());
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        /// Adds an empty list, for a term stored in another index only.
+        void add_empty_list()
+        {
+            TightVariableByte::encode_single(0, m_lists);
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void build(impact_index& index)
+        {
+            index.m_params = m_params;
+            index.m_size = m_endpoints.size() - 1;
+            index.m_num_docs = m_num_docs;
+            index.m_lists.steal(m_lists);
+
+            bit_vector_builder bvb;
+            compact_elias_fano::write(
+                bvb, m_endpoints.begin(), index.m_lists.size(), index.m_size, m_params);
+            bit_vector(&bvb).swap(index.m_endpoints);
+        }
+
+      private:
+        static void write_segment(std::vector<uint8_t>& out, std::vector<uint32_t> const& docs)
+        {
+            uint64_t block_size = BlockCodec::block_size;
+            std::vector<uint32_t> buf(block_size);
+            int64_t last_doc = -1;
+            uint32_t block_base = 0;
+            for (size_t begin = 0; begin < docs.size(); begin += block_size) {
+                size_t cur_block_size = std::min<size_t>(block_size, docs.size() - begin);
+                for (size_t i = 0; i < cur_block_size; ++i) {
+                    uint32_t doc = docs[begin + i];
+                    buf[i] = doc - last_doc - 1;
+                    last_doc = doc;
+                }
+                uint32_t sum_of_values = last_doc - block_base - (cur_block_size - 1);
+                TightVariableByte::encode_single(sum_of_values, out);
+                BlockCodec::encode(buf.data(), sum_of_values, cur_block_size, out);
+                block_base = last_doc + 1;
+            }
+        }
+
+        global_parameters m_params;
+        size_t m_num_docs;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+    };
+
+    /// A run of postings of one term sharing the same impact.
+    class segment {
+      public:
+        segment(uint32_t impact, uint32_t size, uint8_t const* data)
+            : m_impact(impact), m_size(size), m_data(data)
+        {}
+
+        [[nodiscard]] auto impact() const noexcept -> uint32_t { return m_impact; }
+        [[nodiscard]] auto size() const noexcept -> uint32_t { return m_size; }
+
+        /// Decodes the first `limit` docids of the segment, in increasing order, and calls
+        /// `fn` with each of them.
+        template <typename Fn>
+        void for_each(Fn&& fn, uint64_t limit = std::numeric_limits<uint64_t>::max()) const
+        {
+            uint64_t block_size = BlockCodec::block_size;
+            thread_local std::vector<uint32_t> buf(decode_buffer_size<BlockCodec>);
+            uint64_t n = std::min<uint64_t>(limit, m_size);
+            uint8_t const* ptr = m_data;
+            uint32_t block_base = 0;
+            for (uint64_t begin = 0; begin < n; begin += block_size) {
+                size_t cur_block_size = std::min<uint64_t>(block_size, m_size - begin);
+                uint32_t sum_of_values;
+                ptr = TightVariableByte::decode(ptr, &sum_of_values, 1);
+                ptr = BlockCodec::decode(ptr, buf.data(), sum_of_values, cur_block_size);
+                buf[0] += block_base;
+                gaps_to_docids(buf.data(), cur_block_size);
+                block_base = buf[cur_block_size - 1] + 1;
+
+                size_t end = std::min<uint64_t>(cur_block_size, n - begin);
+                for (size_t i = 0; i < end; ++i) {
+                    fn(buf[i]);
+                }
+            }
+        }
+
+      private:
+        uint32_t m_impact;
+        uint32_t m_size;
+        uint8_t const* m_data;
+    };
+
+    /// The segments of a term, in decreasing impact order.
+    class posting_list {
+      public:
+        explicit posting_list(uint8_t const* data)
+        {
+            uint32_t num_segments;
+            data = TightVariableByte::decode(data, &num_segments, 1);
+            std::vector<uint32_t> header(3 * num_segments);
+            data = TightVariableByte::decode(data, header.data(), header.size());
+            m_segments.reserve(num_segments);
+            for (size_t segment = 0; segment < num_segments; ++segment) {
+                m_segments.emplace_back(header[3 * segment], header[3 * segment + 1], data);
+                m_size += header[3 * segment + 1];
+                data += header[3 * segment + 2];
+            }
+        }
+
+        [[nodiscard]] auto size() const noexcept -> uint64_t { return m_size; }
+        [[nodiscard]] auto num_segments() const noexcept -> size_t { return m_segments.size(); }
+        [[nodiscard]] auto segments() const noexcept -> std::vector<segment> const&
+        {
+            return m_segments;
+        }
+
+      private:
+        std::vector<segment> m_segments;
+        uint64_t m_size = 0;
+    };
+
+    size_t size() const { return m_size; }
+
+    uint64_t num_docs() const { return m_num_docs; }
+
+    posting_list operator[](size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        auto endpoint = endpoints.move(i).second;
+        return posting_list(m_lists.data() + endpoint);
+    }
+
+    /// Returns whether the list of term `i` is stored, i.e., not added empty.
+    [[nodiscard]] auto stores(size_t i) const -> bool
+    {
+        return i < size() && (*this)[i].num_segments() > 0;
+    }
+
+    void warmup(size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+
+        auto begin = endpoints.move(i).second;
+        auto end = m_lists.size();
+        if (i + 1 != size()) {
+            end = endpoints.move(i + 1).second;
+        }
+
+        mapper::warmup_memory(m_lists.data() + begin, end - begin);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
+            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+    }
+
+  private:
+    global_parameters m_params;
+    size_t m_size;
+    size_t m_num_docs;
+    bit_vector m_endpoints;
+    mapper::mappable_vector<uint8_t> m_lists;
+};
+
+}  // namespace pisa
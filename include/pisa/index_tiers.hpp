@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// The postings of a list split into two tiers: the highest-scoring ones, and all the others.
+struct posting_tiers {
+    std::vector<uint32_t> first_docs;
+    std::vector<uint32_t> first_freqs;
+    std::vector<uint32_t> second_docs;
+    std::vector<uint32_t> second_freqs;
+    float first_max_score = 0;
+    float second_max_score = 0;
+
+    /// Puts the `max(min_postings, ratio * size)` postings with the highest `scores` into the
+    /// first tier, and the others into the second, both in docid order.
+    template <typename DocIterator, typename FreqIterator>
+    [[nodiscard]] static auto split(
+        DocIterator docs,
+        FreqIterator freqs,
+        std::vector<float> const& scores,
+        double ratio,
+        std::size_t min_postings) -> posting_tiers
+    {
+        std::size_t size = scores.size();
+        auto first_size = std::min<std::size_t>(
+            size, std::max<std::size_t>(min_postings, std::ceil(ratio * size)));
+        first_size = std::max<std::size_t>(first_size, 1);
+        std::vector<std::size_t> order(size);
+        std::iota(order.begin(), order.end(), 0);
+        std::nth_element(
+            order.begin(), order.begin() + (first_size - 1), order.end(), [&](auto lhs, auto rhs) {
+                return scores[lhs] > scores[rhs];
+            });
+        std::sort(order.begin(), order.begin() + first_size);
+        std::sort(order.begin() + first_size, order.end());
+
+        posting_tiers tiers;
+        for (std::size_t idx = 0; idx < size; ++idx) {
+            auto pos = order[idx];
+            if (idx < first_size) {
+                tiers.first_docs.push_back(docs[pos]);
+                tiers.first_freqs.push_back(freqs[pos]);
+                tiers.first_max_score = std::max(tiers.first_max_score, scores[pos]);
+            } else {
+                tiers.second_docs.push_back(docs[pos]);
+                tiers.second_freqs.push_back(freqs[pos]);
+                tiers.second_max_score = std::max(tiers.second_max_score, scores[pos]);
+            }
+        }
+        return tiers;
+    }
+};
+
+/// Describes a two-tier index, made of a first tier with the highest-scoring postings of every
+/// term, and a second tier with the rest.
+///
+/// Every term has a list in the first tier, under its own ID, but only terms with more postings
+/// than fit the first tier have a list in the second, whose ID is given by `second_term`. The
+/// maximum scores of both tiers bound how much the second one can change the results of a query
+/// processed on the first. As with `pair_bounds`, they must only be used with the scorer they
+/// were computed with.
+class index_tiers {
+  public:
+    static constexpr uint32_t no_term = std::numeric_limits<uint32_t>::max();
+
+    class builder {
+      public:
+        void add_term(posting_tiers const& tiers)
+        {
+            m_first_max_scores.push_back(tiers.first_max_score);
+            m_second_max_scores.push_back(tiers.second_max_score);
+            if (tiers.second_docs.empty()) {
+                m_second_terms.push_back(no_term);
+            } else {
+                m_second_terms.push_back(m_second_size++);
+            }
+        }
+
+        void build(index_tiers& tiers)
+        {
+            tiers.m_first_max_scores.steal(m_first_max_scores);
+            tiers.m_second_max_scores.steal(m_second_max_scores);
+            tiers.m_second_terms.steal(m_second_terms);
+        }
+
+      private:
+        std::vector<float> m_first_max_scores;
+        std::vector<float> m_second_max_scores;
+        std::vector<uint32_t> m_second_terms;
+        uint32_t m_second_size = 0;
+    };
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_second_terms.size(); }
+
+    [[nodiscard]] auto first_max_score(term_id_type term) const -> float
+    {
+        return m_first_max_scores[term];
+    }
+
+    /// Returns the maximum score of the second-tier postings of `term`, or zero if it has none.
+    [[nodiscard]] auto second_max_score(term_id_type term) const -> float
+    {
+        return m_second_max_scores[term];
+    }
+
+    /// Returns the ID of the list of `term` in the second tier, or `no_term` if it has none.
+    [[nodiscard]] auto second_term(term_id_type term) const -> uint32_t
+    {
+        return m_second_terms[term];
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_first_max_scores, "m_first_max_scores")(
+            m_second_max_scores, "m_second_max_scores")(m_second_terms, "m_second_terms");
+    }
+
+  private:
+    mapper::mappable_vector<float> m_first_max_scores;
+    mapper::mappable_vector<float> m_second_max_scores;
+    mapper::mappable_vector<uint32_t> m_second_terms;
+};
+
+}  // namespace pisa
@@ -4,7 +4,9 @@
 #include "boost/preprocessor/seq/for_each.hpp"
 #include "boost/preprocessor/stringize.hpp"
 
+#include "codec/avx512bp.hpp"
 #include "codec/block_codecs.hpp"
+#include "codec/dense_block.hpp"
 #include "codec/maskedvbyte.hpp"
 #include "codec/qmx.hpp"
 #include "codec/simdbp.hpp"
@@ -16,7 +18,10 @@
 #include "binary_freq_collection.hpp"
 #include "block_freq_index.hpp"
 
+#include "fat_block_index.hpp"
 #include "freq_index.hpp"
+#include "hybrid_block_index.hpp"
+#include "impact_index.hpp"
 #include "mixed_block.hpp"
 #include "sequence/partitioned_sequence.hpp"
 #include "sequence/positive_sequence.hpp"
@@ -33,9 +38,14 @@ using pefuniform_index =
 using pefopt_index =
     freq_index<partitioned_sequence<>, positive_sequence<partitioned_sequence<strict_sequence>>>;
 
+using pefopt_skip_index = freq_index<
+    partitioned_sequence<indexed_sequence, true>,
+    positive_sequence<partitioned_sequence<strict_sequence>>>;
+
 using block_optpfor_index = block_freq_index<pisa::optpfor_block>;
 using block_varintg8iu_index = block_freq_index<pisa::varint_G8IU_block>;
 using block_streamvbyte_index = block_freq_index<pisa::streamvbyte_block>;
+using block_streamvbyte_delta_index = block_freq_index<pisa::streamvbyte_delta_block>;
 using block_maskedvbyte_index = block_freq_index<pisa::maskedvbyte_block>;
 using block_varintgb_index = block_freq_index<pisa::varintgb_block>;
 using block_interpolative_index = block_freq_index<pisa::interpolative_block>;
@@ -43,14 +53,38 @@ using block_qmx_index = block_freq_index<pisa::qmx_block>;
 using block_simple8b_index = block_freq_index<pisa::simple8b_block>;
 using block_simple16_index = block_freq_index<pisa::simple16_block>;
 using block_simdbp_index = block_freq_index<pisa::simdbp_block>;
+using block_avx512bp_index = block_freq_index<pisa::avx512bp_block>;
 using block_mixed_index = block_freq_index<pisa::mixed_block>;
+using block_dense_simdbp_index = block_freq_index<pisa::dense_block<pisa::simdbp_block>>;
+
+// Alternative block sizes, trading skipping granularity for decoding efficiency.
+using block_interpolative_64_index = block_freq_index<pisa::basic_interpolative_block<64>>;
+using block_interpolative_256_index = block_freq_index<pisa::basic_interpolative_block<256>>;
+using block_varintgb_64_index = block_freq_index<pisa::basic_varintgb_block<64>>;
+using block_varintgb_256_index = block_freq_index<pisa::basic_varintgb_block<256>>;
+using block_simdbp_256_index = block_freq_index<pisa::basic_simdbp_block<256>>;
+
+// Every list encoded with its own codec out of `hybrid_codecs`.
+using block_hybrid_index = hybrid_block_index;
+
+// Quantized indexes storing the block-max scores in the list headers.
+using block_quantized_simdbp_index = block_freq_index<pisa::simdbp_block, false, true>;
+
+using impact_simdbp_index = impact_index<pisa::simdbp_block>;
+using fat_block_simdbp_index = fat_block_index<pisa::simdbp_block>;
 
 }  // namespace pisa
 
-#define PISA_INDEX_TYPES                                                                    \
-    (ef)(single)(pefuniform)(pefopt)(block_optpfor)(block_varintg8iu)(block_streamvbyte)(   \
-        block_maskedvbyte)(block_interpolative)(block_qmx)(block_varintgb)(block_simple8b)( \
-        block_simple16)(block_simdbp)(block_mixed)
+#define PISA_INDEX_TYPES                                                                      \
+    (ef)(single)(pefuniform)(pefopt)(pefopt_skip)(block_optpfor)(block_varintg8iu)(           \
+        block_streamvbyte)(block_streamvbyte_delta)(block_maskedvbyte)(block_interpolative)(  \
+        block_qmx)(block_varintgb)(block_simple8b)(block_simple16)(block_simdbp)(              \
+        block_avx512bp)(block_mixed)(block_interpolative_64)(block_interpolative_256)(         \
+        block_varintgb_64)(block_varintgb_256)(block_simdbp_256)(block_dense_simdbp)(          \
+        block_quantized_simdbp)(block_hybrid)
 #define PISA_BLOCK_INDEX_TYPES                                                                    \
-    (block_optpfor)(block_varintg8iu)(block_streamvbyte)(block_maskedvbyte)(block_interpolative)( \
-        block_qmx)(block_varintgb)(block_simple8b)(block_simple16)(block_simdbp)(block_mixed)
+    (block_optpfor)(block_varintg8iu)(block_streamvbyte)(block_streamvbyte_delta)(                \
+        block_maskedvbyte)(block_interpolative)(block_qmx)(block_varintgb)(block_simple8b)(       \
+        block_simple16)(block_simdbp)(block_avx512bp)(block_mixed)(block_interpolative_64)(       \
+        block_interpolative_256)(block_varintgb_64)(block_varintgb_256)(block_simdbp_256)(        \
+        block_dense_simdbp)
@@ -1,12 +1,16 @@
+#include <algorithm>
 #include <bitset>
 #include <cstddef>
 #include <optional>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "query/algorithm/and_query.hpp"
 #include "query/queries.hpp"
 #include "scorer/scorer.hpp"
+#include "util/broadword.hpp"
 
 namespace pisa {
 
@@ -78,6 +82,69 @@ inline auto Intersection::compute(
     return Intersection{results.size(), max_score};
 }
 
+/// Calls `func(query, mask, intersection)` for all intersections in a query that have a given
+/// maximum number of terms, in the same order as `for_all_subsets`.
+///
+/// Unlike calling `Intersection::compute` for each mask, intersections of three or more terms are
+/// not recomputed from the posting lists: the postings of a subset are obtained by looking up the
+/// postings of the same subset without its last term in the list of that term. The postings of a
+/// subset are kept until the last subset extending it has been computed.
+template <typename Index, typename Wand, typename Fn>
+void for_all_subset_intersections(
+    Index const& index,
+    Wand const& wand,
+    Query const& query,
+    std::optional<std::uint8_t> max_term_count,
+    Fn func)
+{
+    using Posting = std::pair<std::uint32_t, float>;
+    auto term_count = query.terms.size();
+    std::size_t max_count = max_term_count ? *max_term_count : term_count;
+    auto scorer = scorer::from_name("bm25", wand);
+    auto summarize = [](std::vector<Posting> const& postings) {
+        float max_score = 0.0;
+        for (auto const& posting: postings) {
+            max_score = std::max(max_score, posting.second);
+        }
+        return Intersection{postings.size(), max_score};
+    };
+
+    std::unordered_map<std::uint32_t, std::vector<Posting>> cache;
+    auto subset_count = 1u << term_count;
+    for (auto subset = 1u; subset < subset_count; ++subset) {
+        auto mask = intersection::Mask(subset);
+        auto count = mask.count();
+        if (count > max_count) {
+            continue;
+        }
+        auto last_term = broadword::msb(subset);
+        auto prefix = subset ^ (1u << last_term);
+        std::vector<Posting> postings;
+        if (count <= 2) {
+            postings = scored_and_query{}(
+                make_scored_cursors(index, *scorer, intersection::filter(query, mask)),
+                index.num_docs());
+        } else {
+            auto term_query = intersection::filter(query, intersection::Mask(1u << last_term));
+            auto cursor = std::move(make_scored_cursors(index, *scorer, term_query)[0]);
+            for (auto [docid, score]: cache.at(prefix)) {
+                cursor.docs_enum.next_geq(docid);
+                if (cursor.docs_enum.docid() == docid) {
+                    postings.emplace_back(
+                        docid, score + cursor.scorer(docid, cursor.docs_enum.freq()));
+                }
+            }
+        }
+        func(query, mask, summarize(postings));
+        if (count >= 2 && count < max_count && last_term + 1 < term_count) {
+            cache.emplace(subset, std::move(postings));
+        }
+        if (last_term + 1 == term_count) {
+            cache.erase(prefix);
+        }
+    }
+}
+
 /// Do `func` for all intersections in a query that have a given maximum number of terms.
 /// `Fn` takes `Query` and `Mask`.
 template <typename Fn>
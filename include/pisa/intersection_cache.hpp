@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+
+namespace pisa {
+
+/// Iterates over a precomputed intersection of two posting lists, in which every document
+/// carries the sum of the scores of both terms.
+class intersection_cursor {
+  public:
+    intersection_cursor(
+        uint32_t const* docs,
+        float const* scores,
+        std::size_t size,
+        float max_score,
+        uint64_t num_docs)
+        : m_docs(docs),
+          m_scores(scores),
+          m_size(size),
+          m_max_score(max_score),
+          m_num_docs(num_docs)
+    {}
+
+    [[nodiscard]] auto docid() const -> uint64_t
+    {
+        return m_position < m_size ? m_docs[m_position] : m_num_docs;
+    }
+    [[nodiscard]] auto score() const -> float { return m_scores[m_position]; }
+    [[nodiscard]] auto max_score() const -> float { return m_max_score; }
+    [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+
+    void next() { m_position += 1; }
+
+    void next_geq(uint64_t docid)
+    {
+        m_position = std::lower_bound(m_docs + m_position, m_docs + m_size, docid) - m_docs;
+    }
+
+  private:
+    uint32_t const* m_docs;
+    float const* m_scores;
+    std::size_t m_size;
+    std::size_t m_position = 0;
+    float m_max_score;
+    uint64_t m_num_docs;
+};
+
+/// An auxiliary index of materialized intersections of frequently co-occurring term pairs.
+///
+/// Scores are precomputed with a given scorer, so the cache must only be used with queries
+/// processed with that same scorer.
+class intersection_cache {
+  public:
+    using term_pair = std::pair<term_id_type, term_id_type>;
+
+    class builder {
+      public:
+        explicit builder(uint64_t num_docs) : m_num_docs(num_docs) { m_endpoints.push_back(0); }
+
+        /// Adds the intersection of `pair`, whose terms must be different. Pairs can be added
+        /// in any order.
+        void add_pair(term_pair pair, std::vector<uint32_t> docs, std::vector<float> scores)
+        {
+            if (pair.first > pair.second) {
+                std::swap(pair.first, pair.second);
+            }
+            m_pairs.emplace(pair, std::make_pair(std::move(docs), std::move(scores)));
+        }
+
+        void build(intersection_cache& cache)
+        {
+            std::vector<uint64_t> keys;
+            std::vector<uint32_t> docs;
+            std::vector<float> scores;
+            std::vector<float> max_scores;
+            for (auto&& [pair, postings]: m_pairs) {
+                keys.push_back(key(pair.first, pair.second));
+                docs.insert(docs.end(), postings.first.begin(), postings.first.end());
+                scores.insert(scores.end(), postings.second.begin(), postings.second.end());
+                max_scores.push_back(
+                    postings.second.empty()
+                        ? 0.0F
+                        : *std::max_element(postings.second.begin(), postings.second.end()));
+                m_endpoints.push_back(docs.size());
+            }
+            cache.m_num_docs = m_num_docs;
+            cache.m_keys.steal(keys);
+            cache.m_endpoints.steal(m_endpoints);
+            cache.m_docs.steal(docs);
+            cache.m_scores.steal(scores);
+            cache.m_max_scores.steal(max_scores);
+        }
+
+      private:
+        uint64_t m_num_docs;
+        std::map<term_pair, std::pair<std::vector<uint32_t>, std::vector<float>>> m_pairs;
+        std::vector<uint64_t> m_endpoints;
+    };
+
+    /// Returns the `count` term pairs co-occurring in the largest number of queries.
+    [[nodiscard]] static auto select_pairs(std::vector<Query> const& queries, std::size_t count)
+        -> std::vector<term_pair>
+    {
+        std::map<term_pair, std::size_t> occurrences;
+        for (auto const& query: queries) {
+            auto terms = query.terms;
+            remove_duplicate_terms(terms);
+            for (std::size_t left = 0; left < terms.size(); ++left) {
+                for (std::size_t right = left + 1; right < terms.size(); ++right) {
+                    occurrences[{terms[left], terms[right]}] += 1;
+                }
+            }
+        }
+        std::vector<std::pair<term_pair, std::size_t>> ranked(
+            occurrences.begin(), occurrences.end());
+        std::stable_sort(ranked.begin(), ranked.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.second > rhs.second;
+        });
+        ranked.resize(std::min(ranked.size(), count));
+        std::vector<term_pair> pairs;
+        for (auto const& [pair, _]: ranked) {
+            pairs.push_back(pair);
+        }
+        return pairs;
+    }
+
+    /// Intersects the posting lists of `pair` and sums the scores of both terms.
+    template <typename Index, typename Scorer>
+    [[nodiscard]] static auto intersect(Index const& index, Scorer const& scorer, term_pair pair)
+        -> std::pair<std::vector<uint32_t>, std::vector<float>>
+    {
+        auto left = index[pair.first];
+        auto right = index[pair.second];
+        auto left_scorer = make_term_scorer(scorer, pair.first);
+        auto right_scorer = make_term_scorer(scorer, pair.second);
+        std::vector<uint32_t> docs;
+        std::vector<float> scores;
+        while (left.docid() < index.num_docs() && right.docid() < index.num_docs()) {
+            if (left.docid() < right.docid()) {
+                left.next_geq(right.docid());
+            } else if (right.docid() < left.docid()) {
+                right.next_geq(left.docid());
+            } else {
+                docs.push_back(left.docid());
+                scores.push_back(
+                    left_scorer(left.docid(), left.freq())
+                    + right_scorer(right.docid(), right.freq()));
+                left.next();
+                right.next();
+            }
+        }
+        return {std::move(docs), std::move(scores)};
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_keys.size(); }
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_num_docs; }
+
+    /// Returns the position of the cached intersection of `left` and `right`, if any.
+    [[nodiscard]] auto find(term_id_type left, term_id_type right) const
+        -> std::optional<std::size_t>
+    {
+        if (left > right) {
+            std::swap(left, right);
+        }
+        auto k = key(left, right);
+        auto pos = std::lower_bound(m_keys.begin(), m_keys.end(), k);
+        if (pos == m_keys.end() || *pos != k) {
+            return std::nullopt;
+        }
+        return std::distance(m_keys.begin(), pos);
+    }
+
+    /// Returns the shortest cached intersection of two distinct terms of `query`, along with
+    /// the terms of `query` that it does not cover. The cached scores are unweighted, so only
+    /// terms of weight 1 are paired.
+    [[nodiscard]] auto best_pair(Query const& query) const
+        -> std::optional<std::pair<std::size_t, Query>>
+    {
+        auto terms = query_weights(query);
+        std::optional<std::size_t> best;
+        term_pair best_terms;
+        for (std::size_t left = 0; left < terms.size(); ++left) {
+            if (terms[left].second != 1.0F) {
+                continue;
+            }
+            for (std::size_t right = left + 1; right < terms.size(); ++right) {
+                if (terms[right].second != 1.0F) {
+                    continue;
+                }
+                auto pos = find(terms[left].first, terms[right].first);
+                if (pos && (not best || length(*pos) < length(*best))) {
+                    best = pos;
+                    best_terms = {terms[left].first, terms[right].first};
+                }
+            }
+        }
+        if (not best) {
+            return std::nullopt;
+        }
+        Query remaining{query.id, {}, {}};
+        for (auto [term, weight]: terms) {
+            if (term != best_terms.first && term != best_terms.second) {
+                remaining.terms.push_back(term);
+                remaining.term_weights.push_back(weight);
+            }
+        }
+        return std::make_pair(*best, std::move(remaining));
+    }
+
+    [[nodiscard]] auto length(std::size_t pos) const -> std::size_t
+    {
+        return m_endpoints[pos + 1] - m_endpoints[pos];
+    }
+
+    [[nodiscard]] auto cursor(std::size_t pos) const -> intersection_cursor
+    {
+        return intersection_cursor(
+            m_docs.data() + m_endpoints[pos],
+            m_scores.data() + m_endpoints[pos],
+            length(pos),
+            m_max_scores[pos],
+            m_num_docs);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_num_docs, "m_num_docs")(m_keys, "m_keys")(m_endpoints, "m_endpoints")(
+            m_docs, "m_docs")(m_scores, "m_scores")(m_max_scores, "m_max_scores");
+    }
+
+  private:
+    [[nodiscard]] static auto key(term_id_type left, term_id_type right) -> uint64_t
+    {
+        return (static_cast<uint64_t>(left) << 32U) | right;
+    }
+
+    uint64_t m_num_docs = 0;
+    mapper::mappable_vector<uint64_t> m_keys;
+    mapper::mappable_vector<uint64_t> m_endpoints;
+    mapper::mappable_vector<uint32_t> m_docs;
+    mapper::mappable_vector<float> m_scores;
+    mapper::mappable_vector<float> m_max_scores;
+};
+
+}  // namespace pisa
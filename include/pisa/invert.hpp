@@ -9,7 +9,9 @@
 #include <optional>
 #include <sstream>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 
 #include "boost/filesystem.hpp"
 #include "gsl/span"
@@ -18,10 +20,14 @@
 #include "range/v3/view/iota.hpp"
 #include "spdlog/spdlog.h"
 #include "tbb/concurrent_queue.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
 #include "tbb/task_group.h"
 #include "type_safe.hpp"
 
 #include "binary_collection.hpp"
+#include "util/collection_writer.hpp"
+#include "util/external_sort.hpp"
 #include "util/util.hpp"
 
 namespace pisa {
@@ -166,28 +172,37 @@ namespace invert {
         }
     };
 
+    /// Returns the underlying values of a range of type-safe integers, as written to a
+    /// collection.
+    template <typename Range>
+    [[nodiscard]] auto raw_values(Range const& values) -> std::vector<std::uint32_t>
+    {
+        std::vector<std::uint32_t> raw(std::size(values));
+        std::transform(std::begin(values), std::end(values), raw.begin(), [](auto value) {
+            return static_cast<std::uint32_t>(static_cast<std::int32_t>(value));
+        });
+        return raw;
+    }
+
     template <typename Iterator>
     void write(
         std::string const& basename,
         invert::Inverted_Index<Iterator> const& index,
         std::uint32_t term_count)
     {
-        std::ofstream dstream(basename + ".docs");
-        std::ofstream fstream(basename + ".freqs");
         std::ofstream sstream(basename + ".sizes");
-        std::uint32_t count = index.document_sizes.size();
-        write_sequence(dstream, gsl::make_span<uint32_t const>(&count, 1));
+        Freq_Collection_Writer writer(basename, index.document_sizes.size());
         for (auto term: ranges::views::iota(Term_Id(0), Term_Id(term_count))) {
+            std::vector<std::uint32_t> documents;
+            std::vector<std::uint32_t> frequencies;
             if (auto pos = index.documents.find(term); pos != index.documents.end()) {
-                auto const& documents = pos->second;
-                auto const& frequencies = index.frequencies.at(term);
-                write_sequence(dstream, gsl::span<Document_Id const>(documents));
-                write_sequence(fstream, gsl::span<Frequency const>(frequencies));
-            } else {
-                write_sequence(dstream, gsl::span<Document_Id const>());
-                write_sequence(fstream, gsl::span<Frequency const>());
+                documents = raw_values(pos->second);
+                frequencies = raw_values(index.frequencies.at(term));
             }
+            writer.push(
+                static_cast<std::size_t>(term), std::move(documents), std::move(frequencies));
         }
+        writer.close();
         write_sequence(sstream, gsl::span<uint32_t const>(index.document_sizes));
     }
 
@@ -233,6 +248,109 @@ namespace invert {
         return index;
     }
 
+    /// Postings of a range of documents, stored term after term in flat buffers.
+    struct Flat_Inverted_Index {
+        /// The posting list of term `t` starts at `offsets[t]` and has `lengths[t]` postings.
+        std::vector<std::size_t> offsets{};
+        std::vector<std::uint32_t> lengths{};
+        std::vector<Document_Id> documents{};
+        std::vector<Frequency> frequencies{};
+        std::vector<std::uint32_t> document_sizes{};
+
+        [[nodiscard]] auto term_documents(std::uint32_t term) const -> gsl::span<Document_Id const>
+        {
+            return gsl::span<Document_Id const>(&documents[offsets[term]], lengths[term]);
+        }
+
+        [[nodiscard]] auto term_frequencies(std::uint32_t term) const -> gsl::span<Frequency const>
+        {
+            return gsl::span<Frequency const>(&frequencies[offsets[term]], lengths[term]);
+        }
+    };
+
+    /// Inverts a range of documents with a counting sort of their terms.
+    ///
+    /// A first pass counts the occurrences of every term, whose prefix sums give the start of
+    /// each posting list in one flat buffer, and a second pass scatters the document IDs there.
+    /// Documents are scattered in order, so repeated documents are adjacent and are folded into
+    /// frequencies with a scan of each list, in parallel over terms.
+    [[nodiscard]] auto invert_range_flat(
+        gsl::span<gsl::span<Term_Id const>> documents,
+        Document_Id first_document_id,
+        std::uint32_t term_count,
+        size_t threads) -> Flat_Inverted_Index
+    {
+        Flat_Inverted_Index index;
+        index.lengths.assign(term_count, 0);
+        index.document_sizes.reserve(documents.size());
+        for (auto const& terms: documents) {
+            index.document_sizes.push_back(terms.size());
+            for (auto term: terms) {
+                auto term_idx = static_cast<std::size_t>(term);
+                if (term_idx >= term_count) {
+                    throw std::out_of_range(fmt::format(
+                        "Term {} out of range [0, {})", static_cast<std::int32_t>(term), term_count));
+                }
+                index.lengths[term_idx] += 1;
+            }
+        }
+        index.offsets.assign(term_count + 1, 0);
+        for (std::uint32_t term = 0; term < term_count; ++term) {
+            index.offsets[term + 1] = index.offsets[term] + index.lengths[term];
+        }
+
+        index.documents.resize(index.offsets.back());
+        index.frequencies.resize(index.offsets.back());
+        std::fill(index.lengths.begin(), index.lengths.end(), 0);
+        auto document_id = first_document_id;
+        for (auto const& terms: documents) {
+            for (auto term: terms) {
+                auto term_idx = static_cast<std::size_t>(term);
+                index.documents[index.offsets[term_idx] + index.lengths[term_idx]++] = document_id;
+            }
+            ++document_id;
+        }
+
+        auto fold_frequencies = [&](tbb::blocked_range<std::uint32_t> const& term_range) {
+            for (auto term = term_range.begin(); term != term_range.end(); ++term) {
+                auto first = std::next(index.documents.begin(), index.offsets[term]);
+                auto last = std::next(first, index.lengths[term]);
+                auto document_out = first;
+                auto frequency_out = std::next(index.frequencies.begin(), index.offsets[term]);
+                while (first != last) {
+                    auto document = *first;
+                    auto next = std::find_if(
+                        first, last, [&](auto const& other) { return other != document; });
+                    *document_out++ = document;
+                    *frequency_out++ = Frequency(static_cast<std::int32_t>(next - first));
+                    first = next;
+                }
+                index.lengths[term] = std::distance(
+                    std::next(index.documents.begin(), index.offsets[term]), document_out);
+            }
+        };
+        tbb::task_arena arena(static_cast<int>(threads));
+        arena.execute([&] {
+            tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, term_count), fold_frequencies);
+        });
+        return index;
+    }
+
+    void write(
+        std::string const& basename, Flat_Inverted_Index const& index, std::uint32_t term_count)
+    {
+        std::ofstream sstream(basename + ".sizes");
+        Freq_Collection_Writer writer(basename, index.document_sizes.size());
+        tbb::parallel_for(std::uint32_t(0), term_count, [&](std::uint32_t term) {
+            writer.push(
+                term,
+                raw_values(index.term_documents(term)),
+                raw_values(index.term_frequencies(term)));
+        });
+        writer.close();
+        write_sequence(sstream, gsl::span<uint32_t const>(index.document_sizes));
+    }
+
     [[nodiscard]] auto build_batches(
         std::string const& input_basename,
         std::string const& output_basename,
@@ -254,7 +372,8 @@ namespace invert {
             }
             spdlog::info(
                 "Inverting [{}, {})", documents_processed, documents_processed + documents.size());
-            auto index = invert_range(documents, Document_Id(documents_processed), threads);
+            auto index =
+                invert_range_flat(documents, Document_Id(documents_processed), term_count, threads);
             write(fmt::format("{}.batch.{}", output_basename, batch), index, term_count);
             documents_processed += documents.size();
             batch += 1;
@@ -292,11 +411,8 @@ namespace invert {
             std::back_inserter(freq_iterators),
             [](auto const& coll) { return coll.begin(); });
 
-        std::ofstream dos(output_basename + ".docs");
-        std::ofstream fos(output_basename + ".freqs");
         auto document_count = static_cast<uint32_t>(document_sizes.size());
-        write_sequence(dos, gsl::make_span<uint32_t const>(&document_count, 1));
-        size_t postings_count = 0;
+        Freq_Collection_Writer writer(output_basename, document_count);
         for (auto term_id: ranges::views::iota(uint32_t(0), term_count)) {
             std::vector<uint32_t> dlist;
             for (auto& iter: doc_iterators) {
@@ -325,14 +441,96 @@ namespace invert {
                 spdlog::error(msg);
                 throw std::runtime_error(msg);
             }
-            postings_count += dlist.size();
-            write_sequence(dos, gsl::span<uint32_t const>(dlist));
-            write_sequence(fos, gsl::span<uint32_t const>(flist));
+            writer.push(term_id, std::move(dlist), std::move(flist));
+        }
+        writer.close();
+
+        spdlog::info("Number of terms: {}", term_count);
+        spdlog::info("Number of documents: {}", document_count);
+        spdlog::info("Number of postings: {}", writer.postings());
+    }
+
+    /// A posting of the external inversion, along with the frequency of its term.
+    struct Posting_Record {
+        std::uint32_t term;
+        std::uint32_t document;
+        std::uint32_t frequency;
+
+        [[nodiscard]] friend auto operator<(Posting_Record const& lhs, Posting_Record const& rhs)
+            -> bool
+        {
+            return std::tie(lhs.term, lhs.document) < std::tie(rhs.term, rhs.document);
+        }
+    };
+
+    /// Inverts a forward index keeping at most `memory_budget` bytes of postings in memory.
+    ///
+    /// The postings of every document are counted and fed to an `external_sorter`, which spills
+    /// sorted runs next to the output. The k-way merge of the runs is written directly as a
+    /// `binary_freq_collection`, one posting list at a time.
+    void invert_forward_index_external(
+        std::string const& input_basename,
+        std::string const& output_basename,
+        uint32_t term_count,
+        std::size_t memory_budget)
+    {
+        external_sorter<Posting_Record> sorter(output_basename + ".postings", memory_budget);
+        std::vector<uint32_t> document_sizes;
+        {
+            binary_collection coll(input_basename.c_str());
+            std::vector<uint32_t> terms;
+            for (auto doc_iter = ++coll.begin(); doc_iter != coll.end(); ++doc_iter) {
+                auto document = *doc_iter;
+                auto document_id = static_cast<uint32_t>(document_sizes.size());
+                document_sizes.push_back(document.size());
+                terms.assign(document.begin(), document.end());
+                std::sort(terms.begin(), terms.end());
+                for (auto first = terms.begin(); first != terms.end();) {
+                    auto last = std::upper_bound(first, terms.end(), *first);
+                    sorter.push({*first, document_id, static_cast<uint32_t>(last - first)});
+                    first = last;
+                }
+            }
+        }
+        spdlog::info("Merging {} postings from {} runs", sorter.size(), sorter.runs());
+
+        std::ofstream sos(output_basename + ".sizes");
+        write_sequence(sos, gsl::span<uint32_t const>(document_sizes));
+
+        auto document_count = static_cast<uint32_t>(document_sizes.size());
+        Freq_Collection_Writer writer(output_basename, document_count);
+        uint32_t term_id = 0;
+        std::vector<uint32_t> dlist;
+        std::vector<uint32_t> flist;
+        auto write_list = [&] {
+            if (dlist.empty()) {
+                auto msg = fmt::format("Posting list must be non-empty (term {})", term_id);
+                spdlog::error(msg);
+                throw std::runtime_error(msg);
+            }
+            writer.push(term_id, std::exchange(dlist, {}), std::exchange(flist, {}));
+            term_id += 1;
+        };
+        sorter.merge([&](Posting_Record const& posting) {
+            if (posting.term >= term_count) {
+                auto msg = fmt::format("Term {} out of range [0, {})", posting.term, term_count);
+                spdlog::error(msg);
+                throw std::runtime_error(msg);
+            }
+            while (term_id < posting.term) {
+                write_list();
+            }
+            dlist.push_back(posting.document);
+            flist.push_back(posting.frequency);
+        });
+        while (term_id < term_count) {
+            write_list();
         }
+        writer.close();
 
         spdlog::info("Number of terms: {}", term_count);
         spdlog::info("Number of documents: {}", document_count);
-        spdlog::info("Number of postings: {}", postings_count);
+        spdlog::info("Number of postings: {}", writer.postings());
     }
 
     void invert_forward_index(
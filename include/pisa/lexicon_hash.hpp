@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <fmt/format.h>
+#include <gsl/span>
+
+#include "payload_vector.hpp"
+
+namespace pisa {
+
+namespace detail {
+
+    /// Finalizer of SplitMix64, a bijective 64-bit mixing function.
+    [[nodiscard]] constexpr auto mix64(std::uint64_t value) -> std::uint64_t
+    {
+        value = (value ^ (value >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27U)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31U);
+    }
+
+    [[nodiscard]] inline auto hash_term(std::string_view term, std::uint64_t seed)
+        -> std::uint64_t
+    {
+        auto hash = mix64(seed ^ term.size());
+        std::size_t pos = 0;
+        for (; pos + sizeof(std::uint64_t) <= term.size(); pos += sizeof(std::uint64_t)) {
+            std::uint64_t word;
+            std::memcpy(&word, term.data() + pos, sizeof(word));
+            hash = mix64(hash ^ word);
+        }
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, term.data() + pos, term.size() - pos);
+        return mix64(hash ^ tail);
+    }
+
+    /// Maps a uniformly distributed 64-bit value to `[0, range)` without a division.
+    [[nodiscard]] inline auto reduce(std::uint64_t value, std::uint64_t range) -> std::uint64_t
+    {
+        return static_cast<std::uint64_t>((static_cast<__uint128_t>(value) * range) >> 64U);
+    }
+
+    /// Returns the table slot of a term hash displaced by the pilot of its bucket.
+    [[nodiscard]] inline auto
+    displace(std::uint64_t hash, std::uint64_t pilot, std::uint64_t table_size) -> std::uint64_t
+    {
+        return reduce(mix64(hash ^ mix64(pilot)), table_size);
+    }
+
+    struct Lexicon_Hash_Header {
+        std::uint64_t magic;
+        std::uint64_t key_count;
+        std::uint64_t bucket_count;
+        std::uint64_t table_size;
+        std::uint64_t seed;
+    };
+
+    constexpr std::uint64_t lexicon_hash_magic = 0x3148504d41534950ULL;  // "PISAMPH1"
+
+}  // namespace detail
+
+/// A minimal perfect hash function over the terms of a lexicon, mapping every term to its
+/// position in the lexicon, built in the style of PTHash.
+///
+/// Terms are hashed into buckets, and each bucket gets a pilot value that displaces its terms
+/// into free slots of a table slightly larger than the lexicon. Slots past the lexicon size are
+/// remapped to free ones, so a lookup takes one hash, one pilot, possibly one remapping, and one
+/// term ID. Since the function maps any string to some term, `Lexicon_Hash::find` verifies the
+/// candidate against the lexicon.
+struct Lexicon_Hash_Buffer {
+    detail::Lexicon_Hash_Header header;
+    std::vector<std::uint32_t> pilots;
+    std::vector<std::uint32_t> free_slots;
+    std::vector<std::uint32_t> term_ids;
+
+    static constexpr std::size_t keys_per_bucket = 4;
+    static constexpr double load_factor = 0.98;
+
+    template <typename Payload_View>
+    [[nodiscard]] static auto build(Payload_Vector<Payload_View> const& lexicon)
+        -> Lexicon_Hash_Buffer
+    {
+        std::uint64_t key_count = lexicon.size();
+        if (key_count > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::invalid_argument(
+                fmt::format("Cannot hash a lexicon of {} terms", key_count));
+        }
+        std::uint64_t bucket_count = key_count / keys_per_bucket + 1;
+        auto table_size = std::max(
+            key_count, static_cast<std::uint64_t>(static_cast<double>(key_count) / load_factor));
+
+        // All terms must have distinct hashes; a collision means either duplicate terms or an
+        // unlucky seed.
+        constexpr std::uint64_t max_seeds = 16;
+        for (std::uint64_t seed = 0; seed < max_seeds; ++seed) {
+            std::vector<std::tuple<std::uint64_t, std::uint64_t, std::uint32_t>> keys;
+            keys.reserve(key_count);
+            std::uint32_t term_id = 0;
+            for (auto term: lexicon) {
+                auto hash = detail::hash_term(std::string_view(term), seed);
+                keys.emplace_back(detail::reduce(hash, bucket_count), hash, term_id++);
+            }
+            std::sort(keys.begin(), keys.end());
+            auto collision = std::adjacent_find(keys.begin(), keys.end(), [](auto lhs, auto rhs) {
+                return std::get<1>(lhs) == std::get<1>(rhs);
+            });
+            if (collision == keys.end()) {
+                return build(keys, {detail::lexicon_hash_magic,
+                                    key_count,
+                                    bucket_count,
+                                    table_size,
+                                    seed});
+            }
+        }
+        throw std::invalid_argument("Cannot hash a lexicon with duplicate terms");
+    }
+
+    void to_file(std::string const& filename) const
+    {
+        std::ofstream os(filename, std::ios::binary);
+        to_stream(os);
+    }
+
+    void to_stream(std::ostream& os) const
+    {
+        os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        for (auto const* values: {&pilots, &free_slots, &term_ids}) {
+            os.write(
+                reinterpret_cast<char const*>(values->data()),
+                values->size() * sizeof(std::uint32_t));
+        }
+    }
+
+  private:
+    /// Builds the function from `(bucket, hash, term ID)` triples sorted by bucket.
+    [[nodiscard]] static auto build(
+        std::vector<std::tuple<std::uint64_t, std::uint64_t, std::uint32_t>> const& keys,
+        detail::Lexicon_Hash_Header header) -> Lexicon_Hash_Buffer
+    {
+        Lexicon_Hash_Buffer buffer{header, std::vector<std::uint32_t>(header.bucket_count), {}, {}};
+
+        std::vector<std::pair<std::size_t, std::size_t>> buckets;
+        for (std::size_t first = 0; first < keys.size();) {
+            auto last = first;
+            while (last < keys.size() and std::get<0>(keys[last]) == std::get<0>(keys[first])) {
+                ++last;
+            }
+            buckets.emplace_back(first, last);
+            first = last;
+        }
+        // Larger buckets are harder to place, so they go first, while the table is emptiest.
+        std::stable_sort(buckets.begin(), buckets.end(), [](auto lhs, auto rhs) {
+            return lhs.second - lhs.first > rhs.second - rhs.first;
+        });
+
+        std::vector<bool> taken(header.table_size);
+        std::vector<std::uint32_t> slots(header.table_size);
+        std::vector<std::uint64_t> positions;
+        for (auto [first, last]: buckets) {
+            std::uint64_t pilot = 0;
+            for (;; ++pilot) {
+                if (pilot > std::numeric_limits<std::uint32_t>::max()) {
+                    throw std::runtime_error("Failed to find a pilot for a lexicon hash bucket");
+                }
+                positions.clear();
+                for (auto key = first; key < last; ++key) {
+                    positions.push_back(buffer.position(std::get<1>(keys[key]), pilot));
+                }
+                auto available = std::none_of(
+                    positions.begin(), positions.end(), [&](auto pos) { return taken[pos]; });
+                std::sort(positions.begin(), positions.end());
+                if (available
+                    and std::adjacent_find(positions.begin(), positions.end())
+                        == positions.end()) {
+                    break;
+                }
+            }
+            buffer.pilots[std::get<0>(keys[first])] = static_cast<std::uint32_t>(pilot);
+            for (auto key = first; key < last; ++key) {
+                auto pos = buffer.position(std::get<1>(keys[key]), pilot);
+                taken[pos] = true;
+                slots[pos] = std::get<2>(keys[key]);
+            }
+        }
+
+        buffer.free_slots.resize(header.table_size - header.key_count);
+        buffer.term_ids.resize(header.key_count);
+        std::uint64_t free_slot = 0;
+        for (std::uint64_t pos = 0; pos < header.table_size; ++pos) {
+            if (not taken[pos]) {
+                continue;
+            }
+            if (pos < header.key_count) {
+                buffer.term_ids[pos] = slots[pos];
+                continue;
+            }
+            while (taken[free_slot]) {
+                ++free_slot;
+            }
+            buffer.free_slots[pos - header.key_count] = static_cast<std::uint32_t>(free_slot);
+            buffer.term_ids[free_slot++] = slots[pos];
+        }
+        return buffer;
+    }
+
+    [[nodiscard]] auto position(std::uint64_t hash, std::uint64_t pilot) const -> std::uint64_t
+    {
+        return detail::displace(hash, pilot, header.table_size);
+    }
+};
+
+/// A memory-mapped view of a `Lexicon_Hash_Buffer`.
+class Lexicon_Hash {
+  public:
+    Lexicon_Hash(
+        detail::Lexicon_Hash_Header header,
+        gsl::span<std::uint32_t const> pilots,
+        gsl::span<std::uint32_t const> free_slots,
+        gsl::span<std::uint32_t const> term_ids)
+        : m_header(header), m_pilots(pilots), m_free_slots(free_slots), m_term_ids(term_ids)
+    {}
+
+    template <typename ContiguousContainer>
+    [[nodiscard]] static auto from(ContiguousContainer&& mem) -> Lexicon_Hash
+    {
+        return from(gsl::make_span(reinterpret_cast<std::byte const*>(mem.data()), mem.size()));
+    }
+
+    [[nodiscard]] static auto from(gsl::span<std::byte const> mem) -> Lexicon_Hash
+    {
+        auto [magic, key_count, bucket_count, table_size, seed, tail] =
+            unpack_head<std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t>(
+                mem);
+        if (magic != detail::lexicon_hash_magic) {
+            throw std::runtime_error("Not a lexicon hash file");
+        }
+        auto [pilots, free_slots_and_ids] =
+            split(tail, bucket_count * sizeof(std::uint32_t));
+        auto [free_slots, term_ids] =
+            split(free_slots_and_ids, (table_size - key_count) * sizeof(std::uint32_t));
+        return Lexicon_Hash({magic, key_count, bucket_count, table_size, seed},
+                            cast_span<std::uint32_t>(pilots),
+                            cast_span<std::uint32_t>(free_slots),
+                            cast_span<std::uint32_t>(term_ids));
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_header.key_count; }
+
+    /// Returns the position of `term` if it is a term of `lexicon`, the lexicon this function
+    /// was built from.
+    template <typename Payload_View>
+    [[nodiscard]] auto find(Payload_Vector<Payload_View> const& lexicon, std::string_view term)
+        const -> std::optional<std::size_t>
+    {
+        if (m_header.key_count == 0) {
+            return std::nullopt;
+        }
+        auto hash = detail::hash_term(term, m_header.seed);
+        auto pilot = m_pilots[detail::reduce(hash, m_header.bucket_count)];
+        auto pos = detail::displace(hash, pilot, m_header.table_size);
+        if (pos >= m_header.key_count) {
+            pos = m_free_slots[pos - m_header.key_count];
+        }
+        std::size_t term_id = m_term_ids[pos];
+        if (std::string_view(*(lexicon.begin() + term_id)) == term) {
+            return term_id;
+        }
+        return std::nullopt;
+    }
+
+  private:
+    detail::Lexicon_Hash_Header m_header;
+    gsl::span<std::uint32_t const> m_pilots;
+    gsl::span<std::uint32_t const> m_free_slots;
+    gsl::span<std::uint32_t const> m_term_ids;
+};
+
+/// Returns the name of the lexicon hash file stored next to `lexicon_filename`.
+[[nodiscard]] inline auto lexicon_hash_filename(std::string const& lexicon_filename)
+    -> std::string
+{
+    return lexicon_filename + ".mphf";
+}
+
+}  // namespace pisa
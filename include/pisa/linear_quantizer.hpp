@@ -1,7 +1,10 @@
 #pragma once
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <cmath>
 #include <gsl/gsl_assert>
+#include <gsl/span>
+#include <vector>
 
 namespace pisa {
 
@@ -20,9 +23,158 @@ struct LinearQuantizer {
         return std::ceil(value * m_scale);
     }
 
+    /// Quantizes `values` into `out`, which must be as long, as the call operator does but
+    /// without its check, in a loop that compilers can vectorize.
+    void quantize(gsl::span<float const> values, gsl::span<std::uint32_t> out) const
+    {
+        Expects(out.size() == values.size());
+        float const* in = values.data();
+        std::uint32_t* quants = out.data();
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            quants[i] = std::ceil(in[i] * m_scale);
+        }
+    }
+
   private:
     float m_max;
     float m_scale;
 };
 
-}  // namespace pisa
\ No newline at end of file
+/// Maps scores in [0, max] to `2^bits` buckets of different widths, to spend the codes where
+/// scores are dense rather than evenly over the range, as `LinearQuantizer` does.
+///
+/// As with `LinearQuantizer`, zero is mapped to 0 and other scores to codes from 1 to `2^bits`,
+/// in the same order as the scores. The codes are not proportional to the scores, however, so
+/// scores are recovered from them with the table of `weights`.
+class bucket_quantizer {
+  public:
+    /// The most bits a code can take.
+    static constexpr std::uint8_t max_bits = 16;
+
+    /// Creates a quantizer with the buckets ending at `bounds`, which must be `2^k` sorted
+    /// values, the last of them the maximum score.
+    explicit bucket_quantizer(std::vector<float> bounds) : m_bounds(std::move(bounds))
+    {
+        auto size = m_bounds.size();
+        if (size < 2 || size > (std::size_t(1) << max_bits) || (size & (size - 1)) != 0) {
+            throw std::invalid_argument(fmt::format(
+                "Bucket quantizer must take between 2 and {} buckets, a power of 2, but {} passed",
+                std::size_t(1) << max_bits,
+                size));
+        }
+        if (not std::is_sorted(m_bounds.begin(), m_bounds.end()) || m_bounds.front() < 0) {
+            throw std::invalid_argument("Bucket bounds must be sorted and non-negative");
+        }
+    }
+
+    /// Returns a quantizer whose buckets widen geometrically from 0 to `max`, so that every
+    /// bucket has about the same width relative to the scores in it.
+    [[nodiscard]] static auto logarithmic(float max, std::uint8_t bits) -> bucket_quantizer
+    {
+        auto buckets = bucket_count(bits);
+        double growth = std::log1p(static_cast<double>(buckets));
+        std::vector<float> bounds(buckets);
+        for (std::size_t bucket = 0; bucket < buckets; ++bucket) {
+            double fraction = static_cast<double>(bucket + 1) / buckets;
+            bounds[bucket] = max * std::expm1(growth * fraction) / buckets;
+        }
+        bounds.back() = max;
+        return bucket_quantizer(std::move(bounds));
+    }
+
+    /// Returns a quantizer whose buckets each hold about as many of the scores of `sample` as
+    /// each other, up to `max`, so that frequent scores are told apart the most finely.
+    [[nodiscard]] static auto quantiles(std::vector<float> sample, float max, std::uint8_t bits)
+        -> bucket_quantizer
+    {
+        auto buckets = bucket_count(bits);
+        std::sort(sample.begin(), sample.end());
+        std::vector<float> bounds(buckets, max);
+        for (std::size_t bucket = 0; bucket + 1 < buckets && not sample.empty(); ++bucket) {
+            auto rank = (bucket + 1) * sample.size() / buckets;
+            bounds[bucket] = std::min(sample[std::max<std::size_t>(rank, 1) - 1], max);
+        }
+        return bucket_quantizer(std::move(bounds));
+    }
+
+    /// Returns the code of `value`, found by a binary search of the bucket bounds with a fixed
+    /// number of steps and no branches.
+    [[nodiscard]] auto operator()(float value) const -> std::uint32_t
+    {
+        float const* bounds = m_bounds.data();
+        std::uint32_t position = 0;
+        for (auto step = static_cast<std::uint32_t>(m_bounds.size() / 2); step > 0; step /= 2) {
+            position += bounds[position + step - 1] < value ? step : 0;
+        }
+        return static_cast<std::uint32_t>(value > 0) * (position + 1);
+    }
+
+    /// Quantizes `values` into `out`, which must be as long.
+    ///
+    /// The searches of a batch of values advance together, one step at a time, so that their
+    /// loads do not wait for each other and the steps can be vectorized with gathers.
+    void quantize(gsl::span<float const> values, gsl::span<std::uint32_t> out) const
+    {
+        Expects(out.size() == values.size());
+        constexpr std::size_t batch = 16;
+        float const* bounds = m_bounds.data();
+        float const* in = values.data();
+        std::uint32_t* codes = out.data();
+        std::size_t size = values.size();
+        auto first_step = static_cast<std::uint32_t>(m_bounds.size() / 2);
+        std::size_t begin = 0;
+        for (; begin + batch <= size; begin += batch) {
+            std::uint32_t positions[batch] = {};
+            for (auto step = first_step; step > 0; step /= 2) {
+                for (std::size_t i = 0; i < batch; ++i) {
+                    positions[i] += bounds[positions[i] + step - 1] < in[begin + i] ? step : 0;
+                }
+            }
+            for (std::size_t i = 0; i < batch; ++i) {
+                auto positive = static_cast<std::uint32_t>(in[begin + i] > 0);
+                codes[begin + i] = positive * (positions[i] + 1);
+            }
+        }
+        for (; begin < size; ++begin) {
+            codes[begin] = (*this)(in[begin]);
+        }
+    }
+
+    /// Returns the integer score of every code: 0 for code 0, and for the other codes the
+    /// middle of their bucket on a linear scale of `2^weight_bits` steps up to the maximum.
+    ///
+    /// The weights are in the order of the codes, and at least 1 for positive codes, so sums
+    /// of them rank documents as the sums of the scores they stand for, up to the buckets.
+    [[nodiscard]] auto weights(std::uint8_t weight_bits = max_bits) const
+        -> std::vector<std::uint32_t>
+    {
+        double scale = static_cast<double>(std::uint64_t(1) << weight_bits) / m_bounds.back();
+        std::vector<std::uint32_t> weights(m_bounds.size() + 1, 0);
+        float low = 0;
+        for (std::size_t bucket = 0; bucket < m_bounds.size(); ++bucket) {
+            double middle = (static_cast<double>(low) + m_bounds[bucket]) / 2;
+            weights[bucket + 1] =
+                std::max(weights[bucket], std::max<std::uint32_t>(std::ceil(middle * scale), 1));
+            low = m_bounds[bucket];
+        }
+        return weights;
+    }
+
+    [[nodiscard]] auto bounds() const noexcept -> std::vector<float> const& { return m_bounds; }
+
+  private:
+    [[nodiscard]] static auto bucket_count(std::uint8_t bits) -> std::size_t
+    {
+        if (bits == 0 || bits > max_bits) {
+            throw std::invalid_argument(fmt::format(
+                "Bucket quantizer must take a number of bits between 1 and {} but {} passed",
+                max_bits,
+                bits));
+        }
+        return std::size_t(1) << bits;
+    }
+
+    std::vector<float> m_bounds;
+};
+
+}  // namespace pisa
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pisa { namespace mapper {
+
+    /// A range of a frozen structure, i.e., the data of one of its `mappable_vector`s, with the
+    /// xxHash of its bytes. The offset is relative to the structure, right after the header.
+    struct section {
+        std::uint64_t offset = 0;
+        std::uint64_t length = 0;
+        std::uint64_t checksum = 0;
+    };
+
+    /// What a file is, recorded in its header by `freeze`.
+    struct file_description {
+        /// Name of the type of the frozen structure, e.g., the encoding of an index.
+        std::string type;
+        std::uint64_t num_docs = 0;
+    };
+
+    /// Header that `freeze` may write before a structure, so that a file can be validated at
+    /// `map` time in time proportional to its number of sections, without reading them.
+    ///
+    /// Files written without a header are still mapped as before, and are not validated.
+    struct file_header {
+        static constexpr std::uint32_t current_version = 1;
+
+        std::uint32_t version = current_version;
+        file_description description;
+        std::vector<section> sections;
+        /// Bytes of the structure following the header.
+        std::uint64_t data_size = 0;
+
+        /// Returns the number of bytes of the serialized header, a multiple of 64 so that the
+        /// structure keeps the alignment of the file.
+        [[nodiscard]] auto size() const -> std::size_t;
+
+        void write(std::ostream& os) const;
+
+        /// Returns the header at the start of `[data, data + size)`, or `std::nullopt` if the
+        /// file was frozen without one. Throws `std::runtime_error` if the header is truncated or
+        /// of an unsupported version.
+        [[nodiscard]] static auto read(char const* data, std::size_t size)
+            -> std::optional<file_header>;
+
+        /// Returns the header of the file `filename`, reading only the header.
+        [[nodiscard]] static auto read(std::string const& filename) -> std::optional<file_header>;
+    };
+
+    /// Throws `std::invalid_argument` if `filename` has a header recording a type other than
+    /// `type`. Files without a header are accepted.
+    void check_file_type(std::string const& filename, std::string_view type);
+
+    /// Returns whether the checksums of all sections of the file at `[data, data + size)` match
+    /// its header. Files without a header are accepted. This reads the whole file.
+    [[nodiscard]] auto verify_checksums(char const* data, std::size_t size) -> bool;
+
+}}  // namespace pisa::mapper
@@ -17,6 +17,7 @@ namespace pisa { namespace mapper {
         class freeze_visitor;
         class map_visitor;
         class sizeof_visitor;
+        class section_visitor;
     }  // namespace detail
 
     typedef boost::function<void()> deleter_t;
@@ -99,6 +100,7 @@ namespace pisa { namespace mapper {
         friend class detail::freeze_visitor;
         friend class detail::map_visitor;
         friend class detail::sizeof_visitor;
+        friend class detail::section_visitor;
 
       protected:
         const T* m_data;
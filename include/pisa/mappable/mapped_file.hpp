@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace pisa { namespace mapper {
+
+    /// How the bytes of a file are brought into memory by `mapped_file`.
+    enum class load_mode {
+        /// Maps the file, whose pages are read on first access.
+        mmap,
+        /// Maps the file and reads all of its pages ahead, with `MAP_POPULATE`.
+        populate,
+        /// Maps the file and asks for it to be backed by transparent huge pages, with
+        /// `madvise(MADV_HUGEPAGE)`, which needs a kernel that supports them for the page cache.
+        hugepage,
+        /// Copies the file into an anonymous buffer of 2MB huge pages from the hugetlbfs pool.
+        hugetlb_2mb,
+        /// Copies the file into an anonymous buffer of 1GB huge pages from the hugetlbfs pool.
+        hugetlb_1gb,
+    };
+
+    /// Returns the load mode called `name`, which is that of its enumerator with dashes, e.g.,
+    /// `hugetlb-2mb`. Throws `std::invalid_argument` for unknown names.
+    [[nodiscard]] auto parse_load_mode(std::string_view name) -> load_mode;
+
+    /// The read-only contents of a file, loaded according to a `load_mode`.
+    ///
+    /// A hugetlbfs buffer is only available if enough huge pages are reserved, e.g., in
+    /// `/proc/sys/vm/nr_hugepages`; otherwise, the file is copied into an anonymous buffer
+    /// advised to use transparent huge pages, with a warning.
+    class mapped_file {
+      public:
+        mapped_file() = default;
+        explicit mapped_file(std::string const& filename, load_mode mode = load_mode::mmap);
+        mapped_file(mapped_file const&) = delete;
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file const&) = delete;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+        ~mapped_file();
+
+        [[nodiscard]] auto data() const noexcept -> char const* { return m_data; }
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+
+      private:
+        void release() noexcept;
+
+        char* m_data = nullptr;
+        std::size_t m_size = 0;
+        /// Length of the mapping, rounded up to its page size.
+        std::size_t m_length = 0;
+    };
+
+}}  // namespace pisa::mapper
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 #include "mio/mmap.hpp"
 
+#include "mappable/file_header.hpp"
 #include "mappable/mappable_vector.hpp"
+#include "mappable/mapped_file.hpp"
+#include "mappable/residency.hpp"
+#include "mappable/warmup.hpp"
+#include "util/xxhash.hpp"
 
 namespace pisa { namespace mapper {
 
@@ -21,6 +29,8 @@ namespace pisa { namespace mapper {
 
         std::string name;
         size_t size;
+        /// Bytes of the node resident in memory, only set by `residency_tree_of`.
+        size_t resident = 0;
         std::vector<size_node_ptr> children;
 
         void dump(std::ostream& os = std::cerr, size_t depth = 0)
@@ -85,9 +95,12 @@ namespace pisa { namespace mapper {
 
         class map_visitor {
           public:
-            map_visitor(const char* base_address, uint64_t flags)
-                : m_base(base_address), m_cur(m_base), m_flags(flags)
+            /// Maps from `base_address`; if `end` is given, throws `std::runtime_error` rather than
+            /// reading past it.
+            map_visitor(const char* base_address, uint64_t flags, const char* end = nullptr)
+                : m_base(base_address), m_cur(m_base), m_end(end), m_flags(flags)
             {
+                require(sizeof(m_freeze_flags), 1);
                 m_freeze_flags = *reinterpret_cast<const uint64_t*>(m_cur);
                 m_cur += sizeof(m_freeze_flags);
             }
@@ -107,6 +120,7 @@ namespace pisa { namespace mapper {
             typename std::enable_if<std::is_pod<T>::value, map_visitor&>::type
             operator()(T& val, const char* /* friendly_name */)
             {
+                require(sizeof(T), 1);
                 val = *reinterpret_cast<const T*>(m_cur);
                 m_cur += sizeof(T);
                 return *this;
@@ -118,15 +132,12 @@ namespace pisa { namespace mapper {
                 vec.clear();
                 (*this)(vec.m_size, "size");
 
+                require(sizeof(T), vec.m_size);
                 vec.m_data = reinterpret_cast<const T*>(m_cur);
                 size_t bytes = vec.m_size * sizeof(T);
 
                 if (m_flags & map_flags::warmup) {
-                    T foo;
-                    volatile T* bar = &foo;
-                    for (size_t i = 0; i < vec.m_size; ++i) {
-                        *bar = vec.m_data[i];
-                    }
+                    warmup_memory(vec.m_data, bytes);
                 }
 
                 m_cur += bytes;
@@ -136,15 +147,24 @@ namespace pisa { namespace mapper {
             size_t bytes_read() const { return size_t(m_cur - m_base); }
 
           protected:
+            void require(size_t size, uint64_t count) const
+            {
+                if (m_end != nullptr && count > size_t(m_end - m_cur) / size) {
+                    throw std::runtime_error("Mapped structure exceeds the file");
+                }
+            }
+
             const char* m_base;
             const char* m_cur;
+            const char* m_end;
             const uint64_t m_flags;
             uint64_t m_freeze_flags;
         };
 
         class sizeof_visitor {
           public:
-            sizeof_visitor(bool with_tree = false) : m_size(0)
+            sizeof_visitor(bool with_tree = false, bool with_residency = false)
+                : m_size(0), m_with_residency(with_residency)
             {
                 if (with_tree) {
                     m_cur_size_node = std::make_shared<size_node>();
@@ -159,6 +179,7 @@ namespace pisa { namespace mapper {
             operator()(T& val, const char* friendly_name)
             {
                 size_t checkpoint = m_size;
+                size_t resident_checkpoint = m_resident;
                 size_node_ptr parent_node;
                 if (m_cur_size_node) {
                     parent_node = m_cur_size_node;
@@ -169,6 +190,7 @@ namespace pisa { namespace mapper {
 
                 if (m_cur_size_node) {
                     m_cur_size_node->size = m_size - checkpoint;
+                    m_cur_size_node->resident = m_resident - resident_checkpoint;
                     m_cur_size_node = parent_node;
                 }
                 return *this;
@@ -188,10 +210,15 @@ namespace pisa { namespace mapper {
             {
                 size_t checkpoint = m_size;
                 (*this)(vec.m_size, "size");
-                m_size += static_cast<size_t>(vec.m_size * sizeof(T));
+                auto bytes = static_cast<size_t>(vec.m_size * sizeof(T));
+                m_size += bytes;
+                size_t resident = m_with_residency ? resident_bytes(vec.m_data, bytes) : 0;
+                m_resident += resident;
 
                 if (m_cur_size_node) {
-                    make_node(friendly_name)->size = m_size - checkpoint;
+                    auto node = make_node(friendly_name);
+                    node->size = m_size - checkpoint;
+                    node->resident = resident;
                 }
 
                 return *this;
@@ -215,9 +242,89 @@ namespace pisa { namespace mapper {
             }
 
             size_t m_size;
+            bool m_with_residency;
+            size_t m_resident = 0;
             size_node_ptr m_cur_size_node;
         };
 
+        /// Collects the sections of a structure, as laid out by `freeze_visitor`.
+        class section_visitor {
+          public:
+            explicit section_visitor(bool with_checksums) : m_with_checksums(with_checksums)
+            {
+                m_size += sizeof(uint64_t);  // freezing flags
+            }
+
+            section_visitor(const section_visitor&) = delete;
+            section_visitor& operator=(const section_visitor&) = delete;
+
+            template <typename T>
+            typename std::enable_if<!std::is_pod<T>::value, section_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */)
+            {
+                val.map(*this);
+                return *this;
+            }
+
+            template <typename T>
+            typename std::enable_if<std::is_pod<T>::value, section_visitor&>::type
+            operator()(T& /* val */, const char* /* friendly_name */)
+            {
+                m_size += sizeof(T);
+                return *this;
+            }
+
+            template <typename T>
+            section_visitor& operator()(mappable_vector<T>& vec, const char* /* friendly_name */)
+            {
+                (*this)(vec.m_size, "size");
+                section s;
+                s.offset = m_size;
+                s.length = static_cast<uint64_t>(vec.m_size * sizeof(T));
+                if (m_with_checksums) {
+                    s.checksum = xxhash64(vec.m_data, s.length);
+                }
+                m_sections.push_back(s);
+                m_size += s.length;
+                return *this;
+            }
+
+            [[nodiscard]] auto sections() const -> std::vector<section> const&
+            {
+                return m_sections;
+            }
+            [[nodiscard]] auto size() const -> uint64_t { return m_size; }
+
+          private:
+            bool m_with_checksums;
+            uint64_t m_size = 0;
+            std::vector<section> m_sections;
+        };
+
+        /// Throws `std::runtime_error` unless `val`, mapped from the data following `header`,
+        /// has the sections recorded in it.
+        template <typename T>
+        void check_sections(T& val, file_header const& header)
+        {
+            section_visitor sections(false);
+            sections(val, "<TOP>");
+            auto same_range = [](section const& lhs, section const& rhs) {
+                return lhs.offset == rhs.offset && lhs.length == rhs.length;
+            };
+            bool same_layout = sections.size() == header.data_size
+                && std::equal(
+                    sections.sections().begin(),
+                    sections.sections().end(),
+                    header.sections.begin(),
+                    header.sections.end(),
+                    same_range);
+            if (not same_layout) {
+                throw std::runtime_error(
+                    "Mapped structure does not match the " + header.description.type
+                    + " file it is read from");
+            }
+        }
+
     }  // namespace detail
 
     template <typename T>
@@ -237,20 +344,75 @@ namespace pisa { namespace mapper {
         return freeze(val, fout, flags, friendly_name);
     }
 
+    /// Freezes `val` into `filename` after a header with `description` and the checksums of
+    /// its sections, which `map` validates the file with.
+    template <typename T>
+    size_t freeze(T& val, const char* filename, file_description description, uint64_t flags = 0)
+    {
+        detail::section_visitor sections(true);
+        sections(val, "<TOP>");
+        file_header header;
+        header.description = std::move(description);
+        header.sections = sections.sections();
+        header.data_size = sections.size();
+
+        std::ofstream fout(filename, std::ios::binary);
+        header.write(fout);
+        return header.size() + freeze(val, fout, flags);
+    }
+
+    /// Maps `val` from `base_address`, skipping the file header if there is one, without
+    /// validating it.
     template <typename T>
     size_t
     map(T& val, const char* base_address, uint64_t flags = 0, const char* friendly_name = "<TOP>")
     {
-        detail::map_visitor mapper(base_address, flags);
+        std::size_t header_size = 0;
+        if (auto header = file_header::read(base_address, std::numeric_limits<std::size_t>::max());
+            header) {
+            header_size = header->size();
+        }
+        detail::map_visitor mapper(base_address + header_size, flags);
         mapper(val, friendly_name);
-        return mapper.bytes_read();
+        return header_size + mapper.bytes_read();
     }
 
+    namespace detail {
+        /// Maps `val` from the `size` bytes at `data`, throwing `std::runtime_error` if it does not
+        /// fit. If the file has a header, the layout of `val` is checked against its sections.
+        template <typename T>
+        size_t map_file(
+            T& val, const char* data, std::size_t size, uint64_t flags, const char* friendly_name)
+        {
+            auto header = file_header::read(data, size);
+            if (not header) {
+                map_visitor mapper(data, flags, data + size);
+                mapper(val, friendly_name);
+                return mapper.bytes_read();
+            }
+            if (header->size() + header->data_size != size) {
+                throw std::runtime_error(
+                    "File size does not match its " + header->description.type + " header");
+            }
+            map_visitor mapper(data + header->size(), flags, data + size);
+            mapper(val, friendly_name);
+            check_sections(val, *header);
+            return header->size() + mapper.bytes_read();
+        }
+    }  // namespace detail
+
     template <typename T>
     size_t
     map(T& val, const mio::mmap_source& m, uint64_t flags = 0, const char* friendly_name = "<TOP>")
     {
-        return map(val, m.data(), flags, friendly_name);
+        return detail::map_file(val, m.data(), m.size(), flags, friendly_name);
+    }
+
+    template <typename T>
+    size_t
+    map(T& val, mapped_file const& file, uint64_t flags = 0, const char* friendly_name = "<TOP>")
+    {
+        return detail::map_file(val, file.data(), file.size(), flags, friendly_name);
     }
 
     template <typename T>
@@ -270,4 +432,17 @@ namespace pisa { namespace mapper {
         return sizer.size_tree()->children[0];
     }
 
+    /// Returns the size tree of the mapped `val`, with the bytes of each node resident in
+    /// memory, so that the memory taken by each of its sections can be told from the bytes
+    /// merely mapped. Residency is read with `mincore`, so it reflects the page cache for
+    /// file mappings, shared by all processes mapping the file.
+    template <typename T>
+    size_node_ptr residency_tree_of(T& val, const char* friendly_name = "<TOP>")
+    {
+        detail::sizeof_visitor sizer(true, true);
+        sizer(val, friendly_name);
+        assert(sizer.size_tree()->children.size());
+        return sizer.size_tree()->children[0];
+    }
+
 }}  // namespace pisa::mapper
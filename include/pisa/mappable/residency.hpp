@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pisa { namespace mapper {
+
+    /// Byte ranges `[begin, end)` within a mapped range, as offsets from its start.
+    using byte_ranges = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    /// Returns how many bytes of `[data, data + size)` are resident in memory, as reported by
+    /// `mincore` for the pages overlapping the range, each counted for its part in the range.
+    /// Memory that `mincore` rejects, e.g., not mapped by this process, counts as not resident.
+    [[nodiscard]] auto resident_bytes(void const* data, std::size_t size) -> std::size_t;
+
+    /// Returns the resident parts of `[data, data + size)`, as reported by `mincore`, each run
+    /// of consecutive resident pages as a single range, clipped to the range, in order.
+    [[nodiscard]] auto resident_ranges(void const* data, std::size_t size) -> byte_ranges;
+
+    /// Writes `ranges`, e.g., the resident parts of a mapped file of `size` bytes, to
+    /// `filename`, replacing it at once so that a reader never sees a partial snapshot.
+    void write_residency_snapshot(
+        std::string const& filename, std::size_t size, byte_ranges const& ranges);
+
+    /// Reads the ranges written by `write_residency_snapshot`, or returns `std::nullopt` if
+    /// `filename` cannot be read, or if it was written for a file of a size other than `size`,
+    /// and thus probably for another file.
+    [[nodiscard]] auto read_residency_snapshot(std::string const& filename, std::size_t size)
+        -> std::optional<byte_ranges>;
+
+}}  // namespace pisa::mapper
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "mappable/residency.hpp"
+
+namespace pisa { namespace mapper {
+
+    /// Brings the pages of `[data, data + size)` into memory.
+    ///
+    /// The range is first advised with `MADV_WILLNEED`, so that the kernel reads it ahead, and
+    /// one byte of every page is then read to fault it in; large ranges are split into chunks
+    /// read by several threads.
+    void warmup_memory(void const* data, std::size_t size);
+
+    /// Brings the parts `ranges` of `[data, data + size)` into memory, several ranges at once,
+    /// e.g., the ranges of a residency snapshot, to restore the pages a process had in memory
+    /// before a restart. Ranges past `size` are ignored.
+    void warmup_ranges(void const* data, std::size_t size, byte_ranges const& ranges);
+
+    /// Drops `[data, data + size)`, a read-only mapping of the file `filename`, from memory:
+    /// the pages are unmapped with `MADV_DONTNEED`, then dropped from the page cache with
+    /// `POSIX_FADV_DONTNEED`, so that the next accesses read them from disk, as after a
+    /// restart with a cold cache. Pages mapped by other processes stay in the page cache.
+    void evict_memory(void const* data, std::size_t size, std::string const& filename);
+
+}}  // namespace pisa::mapper
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <numeric>
 #include <string>
 
 #include "codec/block_codecs.hpp"
+#include "configuration.hpp"
 #include "dec_time_prediction.hpp"
 
 namespace pisa {
@@ -102,6 +107,59 @@ struct mixed_block {
         return true;
     }
 
+    /// Returns the `count` optpfor parameters with the smallest estimated size on a full block,
+    /// or all of them if `count` is zero. The estimate counts the packed bits, plus the high
+    /// bits and a byte of position for every exception, and only needs a histogram of the bit
+    /// widths of the values.
+    static std::vector<compr_param_type>
+    pfor_candidates(uint32_t const* in, size_t n, size_t count)
+    {
+        auto const& possLogs = optpfor_block::codec_type::possLogs;
+        std::vector<compr_param_type> params(possLogs.size());
+        std::iota(params.begin(), params.end(), 0);
+        if (count == 0 || count >= params.size()) {
+            return params;
+        }
+
+        std::array<uint32_t, 33> widths{};
+        for (size_t i = 0; i < n; ++i) {
+            widths[in[i] ? broadword::msb(in[i]) + 1 : 0] += 1;
+        }
+        uint32_t max_b = 32;
+        while (max_b > 0 && widths[max_b] == 0) {
+            --max_b;
+        }
+        std::array<uint64_t, 34> exception_bits{};  // high bits of values wider than b
+        std::array<uint32_t, 34> exceptions{};
+        for (uint32_t b = 32; b-- > 0;) {
+            exceptions[b] = exceptions[b + 1] + widths[b + 1];
+            exception_bits[b] = exception_bits[b + 1] + exceptions[b];
+        }
+        auto estimate = [&](compr_param_type param) {
+            uint32_t b = std::min<uint32_t>(possLogs[param], 32);
+            return n * b + exception_bits[b] + 8 * exceptions[b];
+        };
+
+        // Skip the widths rejected by compression_stats, so that they do not take the place
+        // of a candidate.
+        params.erase(
+            std::remove_if(
+                params.begin(),
+                params.end(),
+                [&](auto param) {
+                    return (param > 0 && possLogs[param - 1] >= max_b)
+                        || max_b > possLogs[param] + 28;
+                }),
+            params.end());
+        count = std::min(count, params.size());
+        std::partial_sort(
+            params.begin(), params.begin() + count, params.end(), [&](auto lhs, auto rhs) {
+                return estimate(lhs) < estimate(rhs);
+            });
+        params.resize(count);
+        return params;
+    }
+
     struct space_time_point {
         float time;
         uint16_t space;
@@ -126,9 +184,19 @@ struct mixed_block {
         feature_vector fv;
         values_statistics(values, fv);
 
+        std::vector<compr_param_type> pfor_params;
+        if (values.size() == block_size) {
+            pfor_params = pfor_candidates(
+                values.data(), values.size(), configuration::get().mixed_block_pfor_candidates);
+        }
+
         for (uint8_t t = 0; t < block_types; ++t) {
             block_type type = (block_type)t;
-            for (compr_param_type param = 0; param < compr_params(type); ++param) {
+            std::vector<compr_param_type> params{0};
+            if (type == block_type::pfor) {
+                params = pfor_params;
+            }
+            for (compr_param_type param: params) {
                 buf.clear();
                 if (!compression_stats(
                         type, param, values.data(), sum_of_values, values.size(), buf, fv)) {
@@ -214,9 +282,12 @@ struct mixed_block {
 
 using predictors_vec_type = std::vector<pisa::time_prediction::predictor>;
 
-inline predictors_vec_type load_predictors(const char* predictors_filename)
+/// Loads the predictors of `types` block types, `mixed_block` ones by default, from lines of
+/// `type <type> bias <value> <feature> <value>...`.
+inline predictors_vec_type
+load_predictors(const char* predictors_filename, size_t types = mixed_block::block_types)
 {
-    std::vector<time_prediction::predictor> predictors(mixed_block::block_types);
+    std::vector<time_prediction::predictor> predictors(types);
 
     std::ifstream fin(predictors_filename);
 
@@ -237,7 +308,7 @@ inline predictors_vec_type load_predictors(const char* predictors_filename)
             values.emplace_back(field, value);
         }
 
-        if (type >= mixed_block::block_types) {
+        if (type >= types) {
             throw std::invalid_argument("Invalid type while loading predictors");
         }
         predictors[type] = time_prediction::predictor(values);
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Partitions a list of scores into blocks that minimize the total error of their upper bounds,
+/// i.e., the sum over every posting of the block maximum minus the posting score, using at most
+/// `max_blocks` blocks of at most `max_block_size` postings.
+///
+/// Unlike `score_opt_partition`, whose windows only approximate the cost of a block, the cost of
+/// every block up to `max_block_size` postings is exact. The budget is met through a Lagrangian
+/// relaxation: each block is charged a fixed cost, and the cost is searched by bisection for the
+/// smallest one whose optimal partition fits in the budget. The result is then optimal among all
+/// partitions with the same number of blocks. Each step of the search takes
+/// `O(scores.size() * max_block_size)` time.
+class optimal_score_partition {
+  public:
+    optimal_score_partition(
+        std::vector<float> const& scores, uint64_t max_blocks, uint64_t max_block_size)
+        : m_scores(scores), m_max_block_size(std::max<uint64_t>(max_block_size, 1))
+    {
+        auto size = m_scores.size();
+        m_prefix_sums.resize(size + 1, 0.0);
+        for (size_t pos = 0; pos < size; ++pos) {
+            m_prefix_sums[pos + 1] = m_prefix_sums[pos] + m_scores[pos];
+        }
+        max_blocks = std::max<uint64_t>(max_blocks, ceil_div(size, m_max_block_size));
+        if (size == 0) {
+            return;
+        }
+
+        // No block is worth more than the error of a single block spanning the whole list.
+        double max_score = *std::max_element(m_scores.begin(), m_scores.end());
+        double low = 0.0;
+        double high = max_score * size + 1.0;
+        if (solve(low); m_block_ends.size() <= max_blocks) {
+            return;
+        }
+        solve(high);
+        std::vector<uint32_t> best = m_block_ends;
+        for (int step = 0; step < bisection_steps and best.size() < max_blocks; ++step) {
+            double fixed_cost = (low + high) / 2;
+            solve(fixed_cost);
+            if (m_block_ends.size() <= max_blocks) {
+                high = fixed_cost;
+                best = m_block_ends;
+            } else {
+                low = fixed_cost;
+            }
+        }
+        m_block_ends = std::move(best);
+    }
+
+    /// Returns the positions one past the end of each block.
+    [[nodiscard]] auto block_ends() const -> std::vector<uint32_t> const& { return m_block_ends; }
+
+    /// Returns the sum of the errors of the upper bounds of all postings.
+    [[nodiscard]] auto error() const -> double
+    {
+        double error = 0.0;
+        uint32_t begin = 0;
+        for (auto end: m_block_ends) {
+            error += block_error(begin, end, block_max(begin, end));
+            begin = end;
+        }
+        return error;
+    }
+
+    /// Returns the maximum score of each block.
+    [[nodiscard]] auto block_max_scores() const -> std::vector<float>
+    {
+        std::vector<float> max_scores;
+        uint32_t begin = 0;
+        for (auto end: m_block_ends) {
+            max_scores.push_back(block_max(begin, end));
+            begin = end;
+        }
+        return max_scores;
+    }
+
+  private:
+    static constexpr int bisection_steps = 40;
+
+    [[nodiscard]] auto block_max(uint32_t begin, uint32_t end) const -> float
+    {
+        return *std::max_element(
+            std::next(m_scores.begin(), begin), std::next(m_scores.begin(), end));
+    }
+
+    [[nodiscard]] auto block_error(uint32_t begin, uint32_t end, double max) const -> double
+    {
+        return max * (end - begin) - (m_prefix_sums[end] - m_prefix_sums[begin]);
+    }
+
+    /// Finds the partition minimizing the error plus `fixed_cost` for each block, preferring
+    /// fewer blocks among equal costs.
+    void solve(double fixed_cost)
+    {
+        auto size = m_scores.size();
+        std::vector<double> min_cost(size + 1, std::numeric_limits<double>::infinity());
+        std::vector<uint32_t> block_count(size + 1, 0);
+        std::vector<uint32_t> path(size + 1, 0);
+        min_cost[0] = 0.0;
+        for (uint32_t end = 1; end <= size; ++end) {
+            double max = 0.0;
+            uint32_t first = end > m_max_block_size ? end - m_max_block_size : 0;
+            for (uint32_t begin = end; begin > first; --begin) {
+                max = std::max<double>(max, m_scores[begin - 1]);
+                auto start = begin - 1;
+                double cost = min_cost[start] + block_error(start, end, max) + fixed_cost;
+                uint32_t count = block_count[start] + 1;
+                if (cost < min_cost[end] or (cost == min_cost[end] and count < block_count[end])) {
+                    min_cost[end] = cost;
+                    block_count[end] = count;
+                    path[end] = start;
+                }
+            }
+        }
+        m_block_ends.clear();
+        for (auto end = static_cast<uint32_t>(size); end > 0; end = path[end]) {
+            m_block_ends.push_back(end);
+        }
+        std::reverse(m_block_ends.begin(), m_block_ends.end());
+    }
+
+    std::vector<float> const& m_scores;
+    uint64_t m_max_block_size;
+    std::vector<double> m_prefix_sums;
+    std::vector<uint32_t> m_block_ends;
+};
+
+}  // namespace pisa
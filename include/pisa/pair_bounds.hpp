@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+#include "query/queries.hpp"
+#include "util/broadword.hpp"
+
+namespace pisa {
+
+/// Maximum scores of the intersections of frequently co-occurring term pairs.
+///
+/// When two terms co-occur rarely, the maximum score of a document containing both is much lower
+/// than the sum of their maximum scores, which lets MaxScore and WAND bound a set of terms more
+/// tightly. As with `intersection_cache`, the bounds must only be used with the scorer they
+/// were computed with.
+class pair_bounds {
+  public:
+    using term_pair = std::pair<term_id_type, term_id_type>;
+
+    class builder {
+      public:
+        /// Adds the maximum score of the intersection of `pair`, whose terms must be different.
+        /// Pairs can be added in any order.
+        void add_pair(term_pair pair, float max_score)
+        {
+            if (pair.first > pair.second) {
+                std::swap(pair.first, pair.second);
+            }
+            m_max_scores[pair] = max_score;
+        }
+
+        void build(pair_bounds& bounds)
+        {
+            std::vector<uint64_t> keys;
+            std::vector<float> max_scores;
+            for (auto&& [pair, max_score]: m_max_scores) {
+                keys.push_back(key(pair.first, pair.second));
+                max_scores.push_back(max_score);
+            }
+            bounds.m_keys.steal(keys);
+            bounds.m_max_scores.steal(max_scores);
+        }
+
+      private:
+        std::map<term_pair, float> m_max_scores;
+    };
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_keys.size(); }
+
+    /// Returns the maximum score of a document containing both `left` and `right`, if known.
+    [[nodiscard]] auto find(term_id_type left, term_id_type right) const -> std::optional<float>
+    {
+        if (left > right) {
+            std::swap(left, right);
+        }
+        auto k = key(left, right);
+        auto pos = std::lower_bound(m_keys.begin(), m_keys.end(), k);
+        if (pos == m_keys.end() || *pos != k) {
+            return std::nullopt;
+        }
+        return m_max_scores[std::distance(m_keys.begin(), pos)];
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_keys, "m_keys")(m_max_scores, "m_max_scores");
+    }
+
+  private:
+    [[nodiscard]] static auto key(term_id_type left, term_id_type right) -> uint64_t
+    {
+        return (static_cast<uint64_t>(left) << 32U) | right;
+    }
+
+    mapper::mappable_vector<uint64_t> m_keys;
+    mapper::mappable_vector<float> m_max_scores;
+};
+
+/// The bounds of the pairs of cursors of a query.
+///
+/// The sum of the scores of two cursors is bounded by the larger of their maximum scores for the
+/// documents that only one of them contains, and by the pair bound for the others. The bound of
+/// a set of cursors is the smallest sum of the bounds of a partition into pairs and single
+/// cursors.
+class query_pair_bounds {
+  public:
+    /// Queries with more distinct terms have their prefixes bounded by plain sums.
+    static constexpr std::size_t max_paired_terms = 12;
+
+    /// Takes `cursors` in the order given by `make_max_scored_cursors` for `query`.
+    template <typename CursorRange>
+    query_pair_bounds(pair_bounds const& bounds, Query const& query, CursorRange const& cursors)
+    {
+        auto terms = query_weights(query);
+        if (terms.size() != cursors.size()) {
+            throw std::invalid_argument("Cursors do not match the terms of the query");
+        }
+        m_size = cursors.size();
+        m_pair_bounds.resize(m_size * m_size);
+        for (std::size_t left = 0; left < m_size; ++left) {
+            m_max_scores.push_back(cursors[left].max_weight);
+        }
+        for (std::size_t left = 0; left < m_size; ++left) {
+            for (std::size_t right = 0; right < m_size; ++right) {
+                float bound = m_max_scores[left] + m_max_scores[right];
+                if (auto pair_max = bounds.find(terms[left].first, terms[right].first);
+                    pair_max && left != right) {
+                    float weight = std::max(terms[left].second, terms[right].second);
+                    float single_max = std::max(m_max_scores[left], m_max_scores[right]);
+                    bound = std::min(bound, std::max(single_max, weight * *pair_max));
+                }
+                m_pair_bounds[left * m_size + right] = bound;
+            }
+        }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+
+    /// Returns the bound of the sum of the scores of cursors `left` and `right`.
+    [[nodiscard]] auto pair(std::size_t left, std::size_t right) const -> float
+    {
+        return m_pair_bounds[left * m_size + right];
+    }
+
+    /// Returns, for each prefix of `order`, a permutation of the cursors, the bound of the sum of
+    /// the scores of its cursors.
+    [[nodiscard]] auto prefix_upper_bounds(std::vector<std::size_t> const& order) const
+        -> std::vector<float>
+    {
+        std::vector<float> upper_bounds(order.size());
+        if (order.empty()) {
+            return upper_bounds;
+        }
+        if (order.size() > max_paired_terms) {
+            upper_bounds[0] = m_max_scores[order[0]];
+            for (std::size_t i = 1; i < order.size(); ++i) {
+                upper_bounds[i] = upper_bounds[i - 1] + m_max_scores[order[i]];
+            }
+            return upper_bounds;
+        }
+        // Best partition of every subset of positions in `order`, removing the lowest position
+        // either alone or paired with another one.
+        std::vector<float> subset_bounds(std::size_t(1) << order.size(), 0.0F);
+        for (std::size_t subset = 1; subset < subset_bounds.size(); ++subset) {
+            std::size_t low = broadword::lsb(subset);
+            std::size_t rest = subset & (subset - 1);
+            float bound = subset_bounds[rest] + m_max_scores[order[low]];
+            for (std::size_t other = rest; other != 0; other &= other - 1) {
+                std::size_t high = broadword::lsb(other);
+                bound = std::min(
+                    bound,
+                    subset_bounds[rest & ~(std::size_t(1) << high)]
+                        + pair(order[low], order[high]));
+            }
+            subset_bounds[subset] = bound;
+        }
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            upper_bounds[i] = subset_bounds[(std::size_t(2) << i) - 1];
+        }
+        return upper_bounds;
+    }
+
+  private:
+    std::size_t m_size = 0;
+    std::vector<float> m_max_scores;
+    std::vector<float> m_pair_bounds;
+};
+
+}  // namespace pisa
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "gumbo.h"
 
@@ -42,4 +47,193 @@ namespace pisa::parsing::html {
     return content;
 }
 
+namespace detail {
+
+    [[nodiscard]] inline auto is_name_char(char c) -> bool
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0;
+    }
+
+    /// Checks if `text` starts with `prefix`, ignoring the case of `text`; `prefix` must be
+    /// lowercase.
+    [[nodiscard]] inline auto starts_with_lower(std::string_view text, std::string_view prefix)
+        -> bool
+    {
+        if (text.size() < prefix.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < prefix.size(); ++i) {
+            if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Returns the position past the `>` closing the tag whose attributes start at `pos`,
+    /// skipping quoted attribute values.
+    [[nodiscard]] inline auto tag_end(std::string_view html, std::size_t pos) -> std::size_t
+    {
+        while (pos < html.size()) {
+            char c = html[pos];
+            if (c == '>') {
+                return pos + 1;
+            }
+            if (c == '"' || c == '\'') {
+                pos = html.find(c, pos + 1);
+                if (pos == std::string_view::npos) {
+                    return html.size();
+                }
+            }
+            ++pos;
+        }
+        return html.size();
+    }
+
+    /// Returns the position past the tag closing the raw text element `name` (`script` or
+    /// `style`), whose content starts at `pos`.
+    [[nodiscard]] inline auto
+    raw_text_end(std::string_view html, std::size_t pos, std::string_view name) -> std::size_t
+    {
+        for (pos = html.find("</", pos); pos != std::string_view::npos;
+             pos = html.find("</", pos + 2)) {
+            auto rest = html.substr(pos + 2);
+            if (starts_with_lower(rest, name)
+                && (rest.size() == name.size() || not is_name_char(rest[name.size()]))) {
+                return tag_end(html, pos + 2 + name.size());
+            }
+        }
+        return html.size();
+    }
+
+    inline void append_utf8(std::string& out, std::uint32_t code_point)
+    {
+        if (code_point == 0 || code_point > 0x10FFFF
+            || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+            code_point = 0xFFFD;
+        }
+        if (code_point < 0x80) {
+            out.push_back(static_cast<char>(code_point));
+        } else if (code_point < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else if (code_point < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+    /// Decodes the character reference at the beginning of `text`, which starts with `&`, and
+    /// appends it to `out`. Returns the length of the reference, or 0 if it is not one.
+    [[nodiscard]] inline auto decode_entity(std::string_view text, std::string& out)
+        -> std::size_t
+    {
+        constexpr std::size_t max_length = 10;
+        if (text.size() > 2 && text[1] == '#') {
+            bool hex = text[2] == 'x' || text[2] == 'X';
+            std::size_t pos = hex ? 3 : 2;
+            std::uint32_t code_point = 0;
+            std::size_t digits_start = pos;
+            for (; pos < text.size() && pos < max_length; ++pos) {
+                auto c = static_cast<unsigned char>(text[pos]);
+                if (std::isdigit(c) != 0) {
+                    code_point = code_point * (hex ? 16 : 10) + (c - '0');
+                } else if (hex && std::isxdigit(c) != 0) {
+                    code_point = code_point * 16 + (std::tolower(c) - 'a' + 10);
+                } else {
+                    break;
+                }
+            }
+            if (pos == digits_start) {
+                return 0;
+            }
+            append_utf8(out, code_point);
+            return pos < text.size() && text[pos] == ';' ? pos + 1 : pos;
+        }
+        static constexpr std::array<std::pair<std::string_view, char>, 6> entities{
+            {{"amp;", '&'}, {"lt;", '<'}, {"gt;", '>'}, {"quot;", '"'}, {"apos;", '\''},
+             {"nbsp;", ' '}}};
+        for (auto [name, c]: entities) {
+            if (text.substr(1, name.size()) == name) {
+                out.push_back(c);
+                return name.size() + 1;
+            }
+        }
+        return 0;
+    }
+
+}  // namespace detail
+
+/// Appends the text of `html` to `out` in a single pass over the input, without building a
+/// document tree: tags and comments are replaced by a space, the contents of `script` and
+/// `style` elements are dropped, and character references are decoded. Unlike `cleantext`, it
+/// does not allocate beyond growing `out`, so reusing `out` across documents makes it
+/// allocation-free, and it never gives up on malformed documents.
+inline void strip_tags(std::string_view html, std::string& out)
+{
+    auto const start = out.size();
+    auto separate = [&]() {
+        if (out.size() > start && out.back() != ' ') {
+            out.push_back(' ');
+        }
+    };
+    std::size_t pos = 0;
+    while (pos < html.size()) {
+        auto next = std::min(html.find_first_of("<&", pos), html.size());
+        out.append(html.substr(pos, next - pos));
+        pos = next;
+        if (pos == html.size()) {
+            break;
+        }
+        auto rest = html.substr(pos);
+        if (rest[0] == '&') {
+            auto length = detail::decode_entity(rest, out);
+            if (length == 0) {
+                out.push_back('&');
+                length = 1;
+            }
+            pos += length;
+        } else if (rest.substr(0, 4) == "<!--") {
+            auto end = html.find("-->", pos + 4);
+            pos = end == std::string_view::npos ? html.size() : end + 3;
+            separate();
+        } else if (rest.size() > 1 && (rest[1] == '!' || rest[1] == '?')) {
+            pos = detail::tag_end(html, pos + 2);
+            separate();
+        } else {
+            bool closing = rest.size() > 1 && rest[1] == '/';
+            auto name_start = pos + (closing ? 2 : 1);
+            if (name_start >= html.size()
+                || std::isalpha(static_cast<unsigned char>(html[name_start])) == 0) {
+                out.push_back('<');
+                ++pos;
+                continue;
+            }
+            auto name_end = name_start;
+            while (name_end < html.size() && detail::is_name_char(html[name_end])) {
+                ++name_end;
+            }
+            auto name = html.substr(name_start, name_end - name_start);
+            pos = detail::tag_end(html, name_end);
+            separate();
+            if (not closing) {
+                for (std::string_view raw: {"script", "style"}) {
+                    if (name.size() == raw.size() && detail::starts_with_lower(name, raw)) {
+                        pos = detail::raw_text_end(html, pos, raw);
+                    }
+                }
+            }
+        }
+    }
+    while (out.size() > start && out.back() == ' ') {
+        out.pop_back();
+    }
+}
+
 }  // namespace pisa::parsing::html
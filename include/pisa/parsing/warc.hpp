@@ -0,0 +1,403 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <tbb/concurrent_queue.h>
+#include <zlib.h>
+
+#include "forward_index_builder.hpp"
+#include "pisa_config.hpp"
+
+#ifdef PISA_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace pisa::parsing::warc {
+
+/// Reads the decompressed bytes of a file in chunks, with the compression detected from its
+/// magic bytes: gzip, including the concatenated members of ClueWeb-style `.warc.gz` files, zstd
+/// if built with `PISA_ENABLE_ZSTD`, and no compression otherwise.
+class Decompressed_File {
+  public:
+    explicit Decompressed_File(std::string const& path, std::size_t chunk_size = 1U << 20U)
+        : m_file(std::fopen(path.c_str(), "rb"), &std::fclose), m_path(path), m_input(chunk_size)
+    {
+        if (not m_file) {
+            throw std::runtime_error(fmt::format("Failed to open {}", path));
+        }
+        refill();
+        auto magic = [&](std::string_view bytes) {
+            return m_input_size >= bytes.size()
+                && std::string_view(m_input.data(), bytes.size()) == bytes;
+        };
+        if (magic("\x1f\x8b")) {
+            m_format = Format::Gzip;
+            m_zlib = std::make_unique<z_stream>();
+            if (inflateInit2(m_zlib.get(), 16 + MAX_WBITS) != Z_OK) {
+                throw std::runtime_error("Failed to initialize zlib");
+            }
+        } else if (magic("\x28\xb5\x2f\xfd")) {
+#ifdef PISA_ENABLE_ZSTD
+            m_format = Format::Zstd;
+            m_zstd = ZSTD_createDStream();
+            ZSTD_initDStream(m_zstd);
+#else
+            throw std::runtime_error(
+                fmt::format("Reading zstd file {} requires PISA_ENABLE_ZSTD", path));
+#endif
+        }
+    }
+    Decompressed_File(Decompressed_File const&) = delete;
+    Decompressed_File(Decompressed_File&&) = delete;
+    Decompressed_File& operator=(Decompressed_File const&) = delete;
+    Decompressed_File& operator=(Decompressed_File&&) = delete;
+    ~Decompressed_File()
+    {
+        if (m_zlib) {
+            inflateEnd(m_zlib.get());
+        }
+#ifdef PISA_ENABLE_ZSTD
+        if (m_zstd != nullptr) {
+            ZSTD_freeDStream(m_zstd);
+        }
+#endif
+    }
+
+    /// Appends the next decompressed bytes to `out`. Returns `false` at the end of the file.
+    auto read(std::string& out) -> bool
+    {
+        switch (m_format) {
+        case Format::Gzip: return inflate(out);
+#ifdef PISA_ENABLE_ZSTD
+        case Format::Zstd: return decompress_zstd(out);
+#endif
+        default: break;
+        }
+        if (m_input_pos == m_input_size && not refill()) {
+            return false;
+        }
+        out.append(m_input.data() + m_input_pos, m_input_size - m_input_pos);
+        m_input_pos = m_input_size;
+        return true;
+    }
+
+  private:
+    enum class Format { Plain, Gzip, Zstd };
+
+    auto refill() -> bool
+    {
+        m_input_size = std::fread(m_input.data(), 1, m_input.size(), m_file.get());
+        m_input_pos = 0;
+        if (m_input_size == 0 && std::ferror(m_file.get()) != 0) {
+            throw std::runtime_error(fmt::format("Failed to read {}", m_path));
+        }
+        return m_input_size > 0;
+    }
+
+    auto inflate(std::string& out) -> bool
+    {
+        auto offset = out.size();
+        out.resize(offset + m_input.size());
+        auto& zs = *m_zlib;
+        zs.next_out = reinterpret_cast<Bytef*>(&out[offset]);
+        zs.avail_out = m_input.size();
+        while (zs.avail_out > 0) {
+            if (m_input_pos == m_input_size) {
+                if (not refill()) {
+                    if (m_member_started) {
+                        throw std::runtime_error(fmt::format("Truncated gzip file {}", m_path));
+                    }
+                    break;
+                }
+            }
+            zs.next_in = reinterpret_cast<Bytef*>(m_input.data() + m_input_pos);
+            zs.avail_in = m_input_size - m_input_pos;
+            m_member_started = true;
+            int status = ::inflate(&zs, Z_NO_FLUSH);
+            m_input_pos = m_input_size - zs.avail_in;
+            if (status == Z_STREAM_END) {
+                // Each record of a ClueWeb file is a separate gzip member.
+                inflateReset(&zs);
+                m_member_started = false;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                throw std::runtime_error(fmt::format("Invalid gzip data in {}", m_path));
+            }
+        }
+        out.resize(out.size() - zs.avail_out);
+        return out.size() > offset;
+    }
+
+#ifdef PISA_ENABLE_ZSTD
+    auto decompress_zstd(std::string& out) -> bool
+    {
+        auto offset = out.size();
+        out.resize(offset + m_input.size());
+        ZSTD_outBuffer output{&out[offset], m_input.size(), 0};
+        while (output.pos < output.size) {
+            if (m_input_pos == m_input_size && not refill()) {
+                break;
+            }
+            ZSTD_inBuffer input{m_input.data(), m_input_size, m_input_pos};
+            auto status = ZSTD_decompressStream(m_zstd, &output, &input);
+            if (ZSTD_isError(status) != 0U) {
+                throw std::runtime_error(fmt::format(
+                    "Invalid zstd data in {}: {}", m_path, ZSTD_getErrorName(status)));
+            }
+            m_input_pos = input.pos;
+        }
+        out.resize(offset + output.pos);
+        return output.pos > 0;
+    }
+
+    ZSTD_DStream* m_zstd = nullptr;
+#endif
+
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> m_file;
+    std::string m_path;
+    std::vector<char> m_input;
+    std::size_t m_input_size = 0;
+    std::size_t m_input_pos = 0;
+    Format m_format = Format::Plain;
+    std::unique_ptr<z_stream> m_zlib;
+    bool m_member_started = false;
+};
+
+/// Reads the response records of a (possibly compressed) WARC file directly from its
+/// decompressed bytes. A document is titled with its `WARC-TREC-ID`, and its content is the
+/// HTTP body; records of other types or without a TREC ID are skipped.
+class Record_Reader {
+  public:
+    explicit Record_Reader(std::string const& path) : m_file(path), m_path(path) {}
+
+    /// Returns the next document, or `std::nullopt` at the end of the file.
+    /// Throws `std::runtime_error` if the file is malformed or truncated.
+    auto next() -> std::optional<Document_Record>
+    {
+        while (true) {
+            auto header_end = find_header_end();
+            if (not header_end) {
+                return std::nullopt;
+            }
+            auto header = std::string_view(m_buffer).substr(m_pos, *header_end - m_pos);
+            // Copied, since reading the block may reallocate the buffer.
+            std::string type;
+            std::string trecid;
+            std::string url;
+            std::optional<std::size_t> content_length;
+            for (auto line: lines(header)) {
+                auto colon = line.find(':');
+                if (colon == std::string_view::npos) {
+                    continue;
+                }
+                auto name = line.substr(0, colon);
+                auto value = trim(line.substr(colon + 1));
+                if (boost::iequals(name, "WARC-Type")) {
+                    type = value;
+                } else if (boost::iequals(name, "WARC-TREC-ID")) {
+                    trecid = value;
+                } else if (boost::iequals(name, "WARC-Target-URI")) {
+                    url = value;
+                } else if (boost::iequals(name, "Content-Length")) {
+                    content_length = std::stoull(std::string(value));
+                }
+            }
+            if (not content_length) {
+                throw std::runtime_error(
+                    fmt::format("WARC record without Content-Length in {}", m_path));
+            }
+            auto block_start = *header_end;
+            while (m_buffer.size() - block_start < *content_length) {
+                if (not m_file.read(m_buffer)) {
+                    throw std::runtime_error(fmt::format("Truncated WARC record in {}", m_path));
+                }
+            }
+            std::optional<Document_Record> record;
+            if (type == "response" && not trecid.empty()) {
+                auto block = std::string_view(m_buffer).substr(block_start, *content_length);
+                record.emplace(std::move(trecid), std::string(http_body(block)), std::move(url));
+            }
+            m_pos = block_start + *content_length;
+            if (record) {
+                return record;
+            }
+        }
+    }
+
+  private:
+    /// Skips the blank lines separating records and makes sure that the header of the next
+    /// record is in the buffer. Returns the position just past the blank line ending the
+    /// header, or `std::nullopt` if there are no more records.
+    auto find_header_end() -> std::optional<std::size_t>
+    {
+        if (m_pos > m_buffer.size() / 2) {
+            m_buffer.erase(0, m_pos);
+            m_pos = 0;
+        }
+        std::size_t scanned = m_pos;
+        while (true) {
+            m_pos = std::min(m_buffer.find_first_not_of("\r\n", m_pos), m_buffer.size());
+            scanned = std::max(scanned, m_pos);
+            for (auto eol = m_buffer.find('\n', scanned); eol != std::string::npos;
+                 eol = m_buffer.find('\n', scanned)) {
+                scanned = eol + 1;
+                auto next = scanned;
+                if (next < m_buffer.size() && m_buffer[next] == '\r') {
+                    ++next;
+                }
+                if (next >= m_buffer.size()) {
+                    // The blank line may continue in the next chunk.
+                    scanned = eol;
+                    break;
+                }
+                if (m_buffer[next] == '\n') {
+                    return next + 1;
+                }
+            }
+            if (not m_file.read(m_buffer)) {
+                if (m_pos < m_buffer.size()) {
+                    throw std::runtime_error(fmt::format("Truncated WARC header in {}", m_path));
+                }
+                return std::nullopt;
+            }
+        }
+    }
+
+    [[nodiscard]] static auto trim(std::string_view value) -> std::string_view
+    {
+        auto first = value.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos) {
+            return {};
+        }
+        auto last = value.find_last_not_of(" \t\r");
+        return value.substr(first, last - first + 1);
+    }
+
+    [[nodiscard]] static auto lines(std::string_view text) -> std::vector<std::string_view>
+    {
+        std::vector<std::string_view> result;
+        while (not text.empty()) {
+            auto eol = text.find('\n');
+            result.push_back(text.substr(0, eol));
+            text = eol == std::string_view::npos ? std::string_view{} : text.substr(eol + 1);
+        }
+        return result;
+    }
+
+    /// Strips the HTTP status line and headers of a response block, if it has any.
+    [[nodiscard]] static auto http_body(std::string_view block) -> std::string_view
+    {
+        if (not boost::starts_with(block, "HTTP/")) {
+            return block;
+        }
+        for (auto eol = block.find('\n'); eol != std::string_view::npos;
+             eol = block.find('\n', eol + 1)) {
+            auto next = eol + 1;
+            if (next < block.size() && block[next] == '\r') {
+                ++next;
+            }
+            if (next < block.size() && block[next] == '\n') {
+                return block.substr(next + 1);
+            }
+        }
+        return {};
+    }
+
+    Decompressed_File m_file;
+    std::string m_path;
+    std::string m_buffer;
+    std::size_t m_pos = 0;
+};
+
+/// Reads the documents of several WARC files concurrently, each file decompressed and parsed
+/// by one of `threads` reader threads, and hands them out through a bounded queue of
+/// `capacity` records. The documents of each file keep their order, but files are interleaved.
+/// A file that fails to read is logged and the rest of it skipped.
+class Parallel_Reader {
+  public:
+    Parallel_Reader(
+        std::vector<std::string> files, std::size_t threads, std::size_t capacity = 1024)
+        : m_files(std::move(files))
+    {
+        m_queue.set_capacity(capacity);
+        threads = std::max<std::size_t>(1, std::min(threads, m_files.size()));
+        m_active = threads;
+        for (std::size_t thread = 0; thread < threads; ++thread) {
+            m_threads.emplace_back([this] { read_files(); });
+        }
+    }
+    Parallel_Reader(Parallel_Reader const&) = delete;
+    Parallel_Reader(Parallel_Reader&&) = delete;
+    Parallel_Reader& operator=(Parallel_Reader const&) = delete;
+    Parallel_Reader& operator=(Parallel_Reader&&) = delete;
+    ~Parallel_Reader()
+    {
+        m_stopped = true;
+        // Readers blocked on a full queue are released by draining it.
+        std::optional<Document_Record> record;
+        while (m_exited < m_threads.size()) {
+            m_queue.try_pop(record);
+            std::this_thread::yield();
+        }
+        for (auto& thread: m_threads) {
+            thread.join();
+        }
+    }
+
+    /// Returns the next document of any file, or `std::nullopt` once all files are read.
+    auto next() -> std::optional<Document_Record>
+    {
+        if (m_done) {
+            return std::nullopt;
+        }
+        std::optional<Document_Record> record;
+        m_queue.pop(record);
+        m_done = not record.has_value();
+        return record;
+    }
+
+  private:
+    void read_files()
+    {
+        for (auto idx = m_next_file++; idx < m_files.size() && not m_stopped; idx = m_next_file++) {
+            try {
+                Record_Reader reader(m_files[idx]);
+                while (not m_stopped) {
+                    auto record = reader.next();
+                    if (not record) {
+                        break;
+                    }
+                    m_queue.push(std::move(record));
+                }
+            } catch (std::exception const& error) {
+                spdlog::error("Skipped the rest of {}: {}", m_files[idx], error.what());
+            }
+        }
+        if (--m_active == 0) {
+            m_queue.push(std::nullopt);
+        }
+        ++m_exited;
+    }
+
+    std::vector<std::string> m_files;
+    tbb::concurrent_bounded_queue<std::optional<Document_Record>> m_queue;
+    std::vector<std::thread> m_threads;
+    std::atomic_size_t m_next_file = 0;
+    std::atomic_size_t m_active = 0;
+    std::atomic_size_t m_exited = 0;
+    std::atomic_bool m_stopped = false;
+    bool m_done = false;
+};
+
+}  // namespace pisa::parsing::warc
@@ -0,0 +1,6 @@
+#pragma once
+
+#define PISA_SOURCE_DIR "/root/repo"
+
+/* #undef PISA_ENABLE_QUERY_STATS */
+/* #undef PISA_ENABLE_ZSTD */
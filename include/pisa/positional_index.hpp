@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <gsl/span>
+
+#include "codec/block_codecs.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// The positions of the postings of an inverted index, for phrase queries.
+///
+/// The positions of a list are stored in blocks aligned to the blocks of `BlockCodec::block_size`
+/// postings of a block index, each encoded with `BlockCodec`: first the frequencies of the
+/// postings of the block, then the gaps between the positions in each document, the first one
+/// being absolute. Postings are addressed by their position in their list, as given by
+/// `position()` of a document enumerator, so that a query decodes only the blocks of the
+/// candidates it verifies.
+template <typename BlockCodec>
+class positional_index {
+  public:
+    static constexpr uint64_t block_size = BlockCodec::block_size;
+
+    class builder {
+      public:
+        builder() { m_endpoints.push_back(0); }
+
+        /// Adds the positions of a list of `n` postings, given by their frequencies, and the
+        /// positions of all postings one after another, each in increasing order.
+        template <typename FreqsIterator, typename PositionsIterator>
+        void add_list(uint64_t n, FreqsIterator freqs, PositionsIterator positions)
+        {
+            if (n == 0) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            write(m_lists, n, freqs, positions);
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void build(positional_index& index)
+        {
+            index.m_endpoints.steal(m_endpoints);
+            index.m_lists.steal(m_lists);
+        }
+
+      private:
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+    };
+
+    /// Decodes the positions of a list a block at a time.
+    class enumerator {
+      public:
+        explicit enumerator(uint8_t const* data)
+        {
+            uint32_t n = 0;
+            m_block_endpoints = TightVariableByte::decode(data, &n, 1);
+            m_size = n;
+            m_blocks_data = m_block_endpoints + 4 * (ceil_div(m_size, block_size) - 1);
+        }
+
+        [[nodiscard]] auto size() const noexcept -> uint64_t { return m_size; }
+
+        /// Returns the positions of the posting at `posting` in its list, in increasing order.
+        /// The span is valid until positions of another block are requested.
+        [[nodiscard]] auto positions(uint64_t posting) -> gsl::span<uint32_t const>
+        {
+            uint64_t block = posting / block_size;
+            if (block != m_cur_block) {
+                decode_block(block);
+            }
+            uint64_t idx = posting % block_size;
+            return gsl::span<uint32_t const>(m_positions).subspan(
+                m_offsets[idx], m_offsets[idx + 1] - m_offsets[idx]);
+        }
+
+      private:
+        void decode_block(uint64_t block)
+        {
+            uint32_t endpoint = block ? ((uint32_t const*)m_block_endpoints)[block - 1] : 0;
+            uint8_t const* data = m_blocks_data + endpoint;
+            auto postings = std::min(block_size, m_size - block * block_size);
+            uint32_t count = 0;
+            data = TightVariableByte::decode(data, &count, 1);
+            std::array<uint32_t, decode_buffer_size<BlockCodec>> freqs{};
+            data = BlockCodec::decode(data, freqs.data(), uint32_t(-1), postings);
+            m_offsets.resize(postings + 1);
+            m_offsets[0] = 0;
+            for (uint64_t idx = 0; idx < postings; ++idx) {
+                m_offsets[idx + 1] = m_offsets[idx] + freqs[idx] + 1;
+            }
+            m_positions.resize(count + decode_overflow<BlockCodec>::value);
+            for (uint64_t begin = 0; begin < count; begin += block_size) {
+                data = BlockCodec::decode(
+                    data,
+                    m_positions.data() + begin,
+                    uint32_t(-1),
+                    std::min<uint64_t>(block_size, count - begin));
+            }
+            for (uint64_t idx = 0; idx < postings; ++idx) {
+                for (auto pos = m_offsets[idx] + 1; pos < m_offsets[idx + 1]; ++pos) {
+                    m_positions[pos] += m_positions[pos - 1] + 1;
+                }
+            }
+            m_cur_block = block;
+        }
+
+        uint64_t m_size = 0;
+        uint8_t const* m_block_endpoints = nullptr;
+        uint8_t const* m_blocks_data = nullptr;
+        uint64_t m_cur_block = std::numeric_limits<uint64_t>::max();
+        std::vector<uint32_t> m_offsets;
+        std::vector<uint32_t> m_positions;
+    };
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_endpoints.size() - 1; }
+
+    [[nodiscard]] auto operator[](std::size_t term) const -> enumerator
+    {
+        assert(term < size());
+        return enumerator(m_lists.data() + m_endpoints[term]);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_endpoints, "m_endpoints")(m_lists, "m_lists");
+    }
+
+  private:
+    template <typename FreqsIterator, typename PositionsIterator>
+    static void
+    write(std::vector<uint8_t>& out, uint64_t n, FreqsIterator freqs, PositionsIterator positions)
+    {
+        TightVariableByte::encode_single(n, out);
+        uint64_t blocks = ceil_div(n, block_size);
+        size_t begin_block_endpoints = out.size();
+        size_t begin_blocks = begin_block_endpoints + 4 * (blocks - 1);
+        out.resize(begin_blocks);
+
+        std::vector<uint32_t> freqs_buf(block_size);
+        std::vector<uint32_t> gaps;
+        for (uint64_t block = 0; block < blocks; ++block) {
+            auto postings = std::min(block_size, n - block * block_size);
+            gaps.clear();
+            for (uint64_t idx = 0; idx < postings; ++idx, ++freqs) {
+                uint32_t freq = *freqs;
+                // frequencies are stored decremented by one
+                freqs_buf[idx] = freq - 1;
+                uint32_t previous = 0;
+                for (uint32_t occurrence = 0; occurrence < freq; ++occurrence, ++positions) {
+                    uint32_t position = *positions;
+                    gaps.push_back(occurrence == 0 ? position : position - previous - 1);
+                    previous = position;
+                }
+            }
+            TightVariableByte::encode_single(gaps.size(), out);
+            BlockCodec::encode(freqs_buf.data(), uint32_t(-1), postings, out);
+            for (uint64_t begin = 0; begin < gaps.size(); begin += block_size) {
+                BlockCodec::encode(
+                    gaps.data() + begin,
+                    uint32_t(-1),
+                    std::min<uint64_t>(block_size, gaps.size() - begin),
+                    out);
+            }
+            if (block != blocks - 1) {
+                *((uint32_t*)&out[begin_block_endpoints + 4 * block]) = out.size() - begin_blocks;
+            }
+        }
+    }
+
+    mapper::mappable_vector<uint64_t> m_endpoints;
+    mapper::mappable_vector<uint8_t> m_lists;
+};
+
+}  // namespace pisa
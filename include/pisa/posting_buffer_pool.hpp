@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pisa {
+
+/// A cache of byte ranges of a file, read with `pread` instead of being paged in through a
+/// memory mapping.
+///
+/// Indexes larger than memory fault their lists in one page at a time when they are mapped, which
+/// serializes I/O within a query. A pool instead reads all the ranges a query needs concurrently,
+/// before it is processed, into buffers ("frames"). Frames are reference counted, so that a frame
+/// in use by a query stays valid even once it is evicted.
+///
+/// The pool is split into shards by offset, each with its own lock and an equal share of the
+/// capacity. A shard evicts with a generalized CLOCK: every hit increases the usage count of a
+/// frame, up to `max_usage`, and the clock hand decreases it until it finds a frame of count zero.
+/// Frequently used lists thus outlive lists that were read once, and ranges larger than a shard
+/// are read for the query but never cached, so that a single long list cannot flush the pool.
+class posting_buffer_pool {
+  public:
+    using frame = std::shared_ptr<std::vector<std::uint8_t> const>;
+
+    /// A range of `length` bytes at `offset` in the file.
+    struct byte_range {
+        std::uint64_t offset;
+        std::uint64_t length;
+    };
+
+    /// Counters of the requests to the pool, to size its capacity.
+    struct statistics {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t bytes_read = 0;
+        std::uint64_t evictions = 0;
+
+        /// Returns the fraction of requested ranges that were cached.
+        [[nodiscard]] auto hit_rate() const -> double
+        {
+            return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses);
+        }
+    };
+
+    /// Zero bytes appended to each frame, so that block decoders may read past the end of a
+    /// list as they do within a mapped index.
+    static constexpr std::size_t frame_padding = 64;
+    static constexpr std::uint8_t max_usage = 3;
+
+    posting_buffer_pool(std::string const& filename, std::size_t capacity, std::size_t shards = 16);
+    posting_buffer_pool(posting_buffer_pool const&) = delete;
+    posting_buffer_pool& operator=(posting_buffer_pool const&) = delete;
+    ~posting_buffer_pool();
+
+    /// Returns the frames of `ranges`, in the same order. The ranges that are not cached are read
+    /// concurrently. A range is cached by its offset only, so ranges at the same offset must have
+    /// the same length.
+    [[nodiscard]] auto fetch(std::vector<byte_range> const& ranges) -> std::vector<frame>;
+
+    /// Returns the number of bytes held by cached frames.
+    [[nodiscard]] auto cached_bytes() const -> std::size_t;
+
+    /// Returns the counters of all shards.
+    [[nodiscard]] auto stats() const -> statistics;
+
+  private:
+    struct slot {
+        std::uint64_t offset = 0;
+        frame data;
+        std::uint8_t usage = 0;
+    };
+
+    struct shard {
+        mutable std::mutex mutex;
+        std::size_t capacity = 0;
+        std::size_t bytes = 0;
+        std::vector<slot> clock;
+        std::vector<std::size_t> free_slots;
+        std::size_t hand = 0;
+        std::unordered_map<std::uint64_t, std::size_t> slots;
+        statistics stats;
+
+        /// Returns the cached frame at `offset`, if any, counting a hit or a miss.
+        auto find(std::uint64_t offset) -> frame;
+        /// Caches `data` at `offset`, unless it is already cached or larger than the shard, and
+        /// evicts frames until the shard fits its capacity. Returns the cached frame.
+        auto insert(std::uint64_t offset, frame data) -> frame;
+    };
+
+    [[nodiscard]] auto shard_of(std::uint64_t offset) -> shard&;
+
+    int m_fd = -1;
+    std::vector<std::unique_ptr<shard>> m_shards;
+};
+
+}  // namespace pisa
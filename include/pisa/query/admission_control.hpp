@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace pisa {
+
+/// Bytes a cursor is estimated to take while a query runs: its decoded block, and the block
+/// of its block-max scores.
+constexpr std::size_t query_cursor_bytes = std::size_t(1) << 12U;
+
+/// Estimates the memory a query of `terms` terms takes while it runs: its cursors, a top-k
+/// queue of `k` results and the copy of its results, and `accumulator_bytes` of accumulator,
+/// e.g., 4 bytes per document for a term-at-a-time query with a `Simple_Accumulator`.
+[[nodiscard]] constexpr auto
+estimate_query_memory(std::size_t terms, std::size_t k, std::size_t accumulator_bytes = 0)
+    -> std::size_t
+{
+    return terms * query_cursor_bytes + 3 * (k + 1) * sizeof(std::pair<float, std::uint64_t>)
+        + accumulator_bytes;
+}
+
+/// Admits queries to run as long as their estimated memory fits, together with that of the
+/// queries already running, in a budget, so that a burst of queries with large accumulators or
+/// top-k queues does not push a server into swap.
+///
+/// A query that fits is admitted right away, unless others are already waiting, which go
+/// first. Otherwise, a query that can be downgraded, e.g., from a term-at-a-time algorithm to
+/// MaxScore, is admitted with its fallback if that fits. Otherwise, it waits, in the order of
+/// arrival, until enough memory is released, for up to `max_wait`, and is rejected if it times
+/// out or if `max_waiting` queries are already waiting. A query that exceeds the whole budget
+/// by itself is admitted once no other query runs.
+class admission_controller {
+  public:
+    enum class decision { admitted, downgraded, rejected };
+
+    /// The memory reserved for a running query, released when the ticket is destroyed.
+    class ticket {
+      public:
+        ticket(ticket const&) = delete;
+        ticket& operator=(ticket const&) = delete;
+        ticket(ticket&& other) noexcept
+            : m_controller(std::exchange(other.m_controller, nullptr)),
+              m_bytes(other.m_bytes),
+              m_decision(other.m_decision)
+        {}
+        ticket& operator=(ticket&&) = delete;
+        ~ticket()
+        {
+            if (m_controller != nullptr) {
+                m_controller->release(m_bytes);
+            }
+        }
+
+        [[nodiscard]] auto decision() const noexcept -> admission_controller::decision
+        {
+            return m_decision;
+        }
+        [[nodiscard]] auto bytes() const noexcept -> std::size_t { return m_bytes; }
+
+      private:
+        friend class admission_controller;
+        ticket(
+            admission_controller* controller,
+            std::size_t bytes,
+            admission_controller::decision decision)
+            : m_controller(controller), m_bytes(bytes), m_decision(decision)
+        {}
+
+        admission_controller* m_controller;
+        std::size_t m_bytes;
+        admission_controller::decision m_decision;
+    };
+
+    /// Counts the decisions taken so far.
+    struct counters {
+        std::size_t admitted = 0;
+        std::size_t downgraded = 0;
+        std::size_t rejected = 0;
+        /// Queries that had to wait, whether they were admitted in the end or not.
+        std::size_t waited = 0;
+    };
+
+    admission_controller(
+        std::size_t budget, std::size_t max_waiting, std::chrono::milliseconds max_wait)
+        : m_budget(budget), m_max_waiting(max_waiting), m_max_wait(max_wait)
+    {}
+    admission_controller(admission_controller const&) = delete;
+    admission_controller(admission_controller&&) = delete;
+    admission_controller& operator=(admission_controller const&) = delete;
+    admission_controller& operator=(admission_controller&&) = delete;
+    ~admission_controller() = default;
+
+    /// Decides whether a query estimated to take `bytes` runs, or runs its fallback of
+    /// `fallback_bytes` if it has one, reserving their memory until the ticket is destroyed.
+    /// Rejected queries hold no memory.
+    [[nodiscard]] auto admit(std::size_t bytes, std::optional<std::size_t> fallback_bytes = {})
+        -> ticket;
+
+    [[nodiscard]] auto budget() const noexcept -> std::size_t { return m_budget; }
+    [[nodiscard]] auto used() const -> std::size_t;
+    [[nodiscard]] auto waiting() const -> std::size_t;
+    [[nodiscard]] auto stats() const -> counters;
+
+  private:
+    void release(std::size_t bytes);
+    [[nodiscard]] auto fits(std::size_t bytes) const -> bool
+    {
+        return m_used == 0 || m_used + bytes <= m_budget;
+    }
+
+    std::size_t m_budget;
+    std::size_t m_max_waiting;
+    std::chrono::milliseconds m_max_wait;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::size_t m_used = 0;
+    std::deque<std::uint64_t> m_waiters;
+    std::uint64_t m_next_waiter = 0;
+    counters m_counters;
+};
+
+}  // namespace pisa
@@ -1,14 +1,25 @@
 #pragma once
 
 #include "query/algorithm/and_query.hpp"
+#include "query/algorithm/and_simd_query.hpp"
+#include "query/algorithm/anytime_saat_query.hpp"
+#include "query/algorithm/batch_ranked_or_taat_query.hpp"
 #include "query/algorithm/block_max_maxscore_query.hpp"
 #include "query/algorithm/block_max_ranked_and_query.hpp"
 #include "query/algorithm/block_max_wand_query.hpp"
+#include "query/algorithm/dynamic_block_max_maxscore_query.hpp"
+#include "query/algorithm/interleaved_ranked_and_query.hpp"
+#include "query/algorithm/long_maxscore_query.hpp"
 #include "query/algorithm/maxscore_query.hpp"
 #include "query/algorithm/or_query.hpp"
+#include "query/algorithm/parallel_range_query.hpp"
+#include "query/algorithm/phrase_query.hpp"
+#include "query/algorithm/pipelined_taat_query.hpp"
 #include "query/algorithm/range_query.hpp"
 #include "query/algorithm/range_taat_query.hpp"
 #include "query/algorithm/ranked_and_query.hpp"
 #include "query/algorithm/ranked_or_query.hpp"
 #include "query/algorithm/ranked_or_taat_query.hpp"
+#include "query/algorithm/tiered_query.hpp"
 #include "query/algorithm/wand_query.hpp"
+#include "query/algorithm/windowed_taat_query.hpp"
@@ -12,6 +12,14 @@ namespace pisa {
 struct and_query {
     template <typename CursorRange>
     auto operator()(CursorRange&& cursors, uint32_t max_docid) const
+    {
+        return (*this)(cursors, max_docid, [](uint32_t) { return true; });
+    }
+
+    /// Returns the documents of the intersection for which `verify(docid)` holds. It is called
+    /// with all cursors at `docid`, e.g., to check the positions of their postings.
+    template <typename CursorRange, typename Verify>
+    auto operator()(CursorRange&& cursors, uint32_t max_docid, Verify&& verify) const
     {
         using Cursor = typename std::decay_t<CursorRange>::value_type;
 
@@ -47,7 +55,9 @@ struct and_query {
             }
 
             if (i == ordered_cursors.size()) {
-                results.push_back(candidate);
+                if (verify(candidate)) {
+                    results.push_back(candidate);
+                }
 
                 ordered_cursors[0]->next();
                 candidate = ordered_cursors[0]->docid();
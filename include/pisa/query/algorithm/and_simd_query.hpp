@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Detects document enumerators that find a batch of increasing docids at once with
+/// `intersect(docids, count, fn)`, such as those of `freq_index`.
+template <typename Enum, typename = void>
+struct has_batched_intersect: std::false_type {
+};
+
+template <typename Enum>
+struct has_batched_intersect<
+    Enum,
+    std::void_t<decltype(std::declval<Enum&>().intersect(
+        std::declval<std::uint32_t const*>(),
+        std::size_t(),
+        std::declval<void (*)(std::size_t)>()))>>: std::true_type {
+};
+
+/// Scoring policy of `svs_intersection` that scores nothing, and never reads frequencies.
+struct svs_unscored {};
+
+/// Set-vs-set (SvS) conjunctive engine.
+///
+/// Instead of leapfrogging `next_geq` across all cursors, the shortest list is decoded in windows
+/// of `window_size` docids, and each window is filtered against the other lists, one list at a
+/// time in increasing size order. A list at most `dense_ratio` times longer than the shortest one
+/// is decoded over the span of the remaining candidates and intersected with them in decoded
+/// buffers, four docids per comparison (the V1 algorithm of Lemire et al.); a longer list is
+/// probed with a galloping `next_geq` per candidate, since decoding it would mostly read postings
+/// that cannot match, or with one batched `intersect` for enumerators that support it, such as
+/// Elias-Fano lists walking their high bits once for all candidates.
+///
+/// Since lists are consumed one at a time, a candidate's score is accumulated as each list
+/// confirms it, while its frequency is at hand.
+class svs_intersection {
+  public:
+    static constexpr std::size_t window_size = 128;
+    static constexpr std::uint64_t dense_ratio = 32;
+
+    /// Calls `fn(docid, score)` with every docid below `max_docid` that is in all of `cursors`,
+    /// in increasing order. `docs` maps a cursor to its document enumerator, and `score(cursor,
+    /// docid, freq)` returns the score of a posting, unless it is `svs_unscored`.
+    template <typename CursorRange, typename Docs, typename Score, typename Fn>
+    void operator()(CursorRange&& cursors, std::uint32_t max_docid, Docs docs, Score score, Fn fn)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        constexpr bool scored = not std::is_same_v<Score, svs_unscored>;
+        if (cursors.empty()) {
+            return;
+        }
+
+        std::vector<Cursor*> ordered_cursors;
+        ordered_cursors.reserve(cursors.size());
+        for (auto& en: cursors) {
+            ordered_cursors.push_back(&en);
+        }
+        // sort by increasing frequency
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [&](Cursor* lhs, Cursor* rhs) {
+            return docs(*lhs).size() < docs(*rhs).size();
+        });
+
+        auto& shortest = docs(*ordered_cursors[0]);
+        auto dense_size = shortest.size() * dense_ratio;
+        m_candidates.reserve(window_size);
+        while (shortest.docid() < max_docid) {
+            m_candidates.clear();
+            m_scores.clear();
+            while (m_candidates.size() < window_size && shortest.docid() < max_docid) {
+                m_candidates.push_back(shortest.docid());
+                if constexpr (scored) {
+                    m_scores.push_back(
+                        score(*ordered_cursors[0], shortest.docid(), shortest.freq()));
+                }
+                shortest.next();
+            }
+            for (std::size_t i = 1; i < ordered_cursors.size() && not m_candidates.empty(); ++i) {
+                auto& cursor = *ordered_cursors[i];
+                auto& list = docs(cursor);
+                auto add_score = [&](std::size_t candidate, auto freq) {
+                    if constexpr (scored) {
+                        m_scores[candidate] += score(cursor, m_candidates[candidate], freq);
+                    }
+                };
+                if (list.size() <= dense_size) {
+                    intersect_decoded<scored>(list, add_score);
+                } else {
+                    intersect_galloping<scored>(list, add_score);
+                }
+            }
+            for (std::size_t i = 0; i < m_candidates.size(); ++i) {
+                fn(m_candidates[i], scored ? m_scores[i] : 0.0F);
+            }
+        }
+    }
+
+  private:
+    /// Keeps the candidates found when probing `list` with `next_geq`.
+    template <bool Scored, typename Enum, typename AddScore>
+    void intersect_galloping(Enum& list, AddScore add_score)
+    {
+        std::size_t out = 0;
+        if constexpr (has_batched_intersect<Enum>::value) {
+            list.intersect(m_candidates.data(), m_candidates.size(), [&](std::size_t i) {
+                if constexpr (Scored) {
+                    add_score(i, list.freq());
+                }
+                keep(i, out++);
+            });
+            shrink(out);
+            return;
+        }
+        for (std::size_t i = 0; i < m_candidates.size(); ++i) {
+            list.next_geq(m_candidates[i]);
+            if (list.docid() == m_candidates[i]) {
+                if constexpr (Scored) {
+                    add_score(i, list.freq());
+                }
+                keep(i, out++);
+            }
+        }
+        shrink(out);
+    }
+
+    /// Decodes `list` from the first to the last candidate and keeps the candidates in it.
+    template <bool Scored, typename Enum, typename AddScore>
+    void intersect_decoded(Enum& list, AddScore add_score)
+    {
+        m_buffer.clear();
+        m_freqs.clear();
+        list.next_geq(m_candidates.front());
+        while (list.docid() <= m_candidates.back()) {
+            m_buffer.push_back(list.docid());
+            if constexpr (Scored) {
+                m_freqs.push_back(list.freq());
+            }
+            list.next();
+        }
+
+        std::size_t out = 0;
+        std::size_t j = 0;
+        auto const* large = m_buffer.data();
+        auto large_size = m_buffer.size();
+        for (std::size_t i = 0; i < m_candidates.size(); ++i) {
+            auto docid = m_candidates[i];
+            auto match = [&](std::size_t pos) {
+                if constexpr (Scored) {
+                    add_score(i, m_freqs[pos]);
+                }
+                keep(i, out++);
+            };
+#if defined(__SSE2__)
+            // Docids are below 2^31, so signed comparisons of 32-bit lanes are exact.
+            while (j + 4 <= large_size && large[j + 3] < docid) {
+                j += 4;
+            }
+            if (j + 4 <= large_size) {
+                auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(large + j));
+                auto mask = _mm_movemask_epi8(
+                    _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(docid))));
+                if (mask != 0) {
+                    match(j + __builtin_ctz(mask) / 4);
+                }
+                continue;
+            }
+#endif
+            while (j < large_size && large[j] < docid) {
+                ++j;
+            }
+            if (j == large_size) {
+                break;
+            }
+            if (large[j] == docid) {
+                match(j);
+            }
+        }
+        shrink(out);
+    }
+
+    /// Moves the candidate at `from` to `to`, with its score.
+    void keep(std::size_t from, std::size_t to)
+    {
+        m_candidates[to] = m_candidates[from];
+        if (not m_scores.empty()) {
+            m_scores[to] = m_scores[from];
+        }
+    }
+
+    void shrink(std::size_t size)
+    {
+        m_candidates.resize(size);
+        if (not m_scores.empty()) {
+            m_scores.resize(size);
+        }
+    }
+
+    std::vector<std::uint32_t> m_candidates;
+    std::vector<float> m_scores;
+    std::vector<std::uint32_t> m_buffer;
+    std::vector<std::uint32_t> m_freqs;
+};
+
+/// Conjunctive query over document cursors, using `svs_intersection`.
+struct and_simd_query {
+    template <typename CursorRange>
+    auto operator()(CursorRange&& cursors, std::uint32_t max_docid) const
+    {
+        std::vector<std::uint32_t> results;
+        svs_intersection intersection;
+        intersection(
+            cursors,
+            max_docid,
+            [](auto& cursor) -> auto& { return cursor; },
+            svs_unscored{},
+            [&](std::uint32_t docid, float) { results.push_back(docid); });
+        return results;
+    }
+};
+
+/// Ranked conjunctive query over scored cursors, using `svs_intersection`.
+struct ranked_and_simd_query {
+    ranked_and_simd_query(topk_queue& topk) : m_topk(topk) {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, std::uint32_t max_docid)
+    {
+        svs_intersection intersection;
+        intersection(
+            cursors,
+            max_docid,
+            [](auto& cursor) -> auto& { return cursor.docs_enum; },
+            [](auto& cursor, std::uint32_t docid, std::uint32_t freq) -> float {
+                return cursor.scorer(docid, freq);
+            },
+            [&](std::uint32_t docid, float score) { m_topk.insert(score, docid); });
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    topk_queue& m_topk;
+};
+
+}  // namespace pisa
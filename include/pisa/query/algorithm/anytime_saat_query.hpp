@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Score-at-a-time processing of an impact-ordered index.
+///
+/// The segments of all query terms are processed in decreasing order of their weighted
+/// impact, until either all of them are done or `postings_budget` postings have been
+/// accumulated. Bounding the budget bounds the query latency, at the cost of a possibly
+/// approximate top-k.
+class anytime_saat_query {
+  public:
+    explicit anytime_saat_query(
+        topk_queue& topk, uint64_t postings_budget = std::numeric_limits<uint64_t>::max())
+        : m_topk(topk), m_postings_budget(postings_budget)
+    {}
+
+    template <typename CursorRange, typename Acc>
+    void operator()(CursorRange&& cursors, Acc&& accumulator)
+    {
+        m_postings_processed = 0;
+        if (cursors.empty()) {
+            return;
+        }
+        accumulator.init();
+
+        struct segment_ref {
+            float score;
+            size_t cursor;
+            size_t segment;
+        };
+        std::vector<segment_ref> order;
+        for (size_t cursor = 0; cursor < cursors.size(); ++cursor) {
+            auto const& segments = cursors[cursor].postings.segments();
+            for (size_t segment = 0; segment < segments.size(); ++segment) {
+                float score = cursors[cursor].q_weight * segments[segment].impact();
+                order.push_back({score, cursor, segment});
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.score > rhs.score;
+        });
+
+        for (auto const& ref: order) {
+            if (m_postings_processed >= m_postings_budget) {
+                break;
+            }
+            auto const& segment = cursors[ref.cursor].postings.segments()[ref.segment];
+            uint64_t limit =
+                std::min<uint64_t>(segment.size(), m_postings_budget - m_postings_processed);
+            segment.for_each(
+                [&](uint32_t docid) { accumulator.accumulate(docid, ref.score); }, limit);
+            m_postings_processed += limit;
+        }
+        accumulator.aggregate(m_topk);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+    /// Returns the number of postings accumulated by the last query.
+    [[nodiscard]] auto postings_processed() const noexcept -> uint64_t
+    {
+        return m_postings_processed;
+    }
+
+  private:
+    topk_queue& m_topk;
+    uint64_t m_postings_budget;
+    uint64_t m_postings_processed = 0;
+};
+
+}  // namespace pisa
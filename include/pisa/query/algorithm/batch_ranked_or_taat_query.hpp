@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/span>
+
+#include "cursor/cursor.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Ranked disjunctive TAAT over a batch of queries at once.
+///
+/// Each distinct term of the batch is opened and decoded once, however many queries contain it,
+/// and each posting is scored once and added to the accumulators of all these queries. To keep
+/// the accumulators of the whole batch small, documents are processed in windows of
+/// `window_size` docids: every list is decoded up to the end of the window, after which the
+/// accumulators of each query are aggregated into its top-k queue and cleared.
+///
+/// Within a window, each list is decoded in runs of postings, which are scored together with
+/// `score_postings` and then added to the accumulators of one query after the other.
+///
+/// The results of each query are those of `ranked_or_query`, restricted to positive scores.
+class batch_ranked_or_taat_query {
+  public:
+    using result_type = std::vector<std::pair<float, uint64_t>>;
+    static constexpr std::uint32_t default_window_size = 1U << 16U;
+
+    explicit batch_ranked_or_taat_query(
+        uint64_t k,
+        std::uint32_t window_size = default_window_size,
+        deleted_documents const* deleted = nullptr)
+        : m_k(k), m_window_size(window_size), m_deleted(deleted)
+    {}
+
+    /// Returns the finalized top-k results of each of `queries`, in order.
+    template <typename Index, typename Scorer>
+    [[nodiscard]] auto
+    operator()(Index const& index, Scorer const& scorer, gsl::span<Query const> queries)
+        -> std::vector<result_type>
+    {
+        using term_scorer_type = term_scorer_type_t<Scorer>;
+        struct shared_term {
+            typename Index::document_enumerator docs_enum;
+            term_scorer_type scorer;
+            /// The queries containing the term, with its weight in each of them.
+            std::vector<std::pair<std::uint32_t, float>> queries;
+        };
+
+        std::vector<shared_term> terms;
+        std::unordered_map<term_id_type, std::size_t> term_positions;
+        for (std::size_t query_idx = 0; query_idx < queries.size(); ++query_idx) {
+            for (auto [term, weight]: query_weights(queries[query_idx])) {
+                auto [pos, inserted] = term_positions.emplace(term, terms.size());
+                if (inserted) {
+                    terms.push_back(shared_term{index[term], make_term_scorer(scorer, term), {}});
+                }
+                terms[pos->second].queries.emplace_back(query_idx, weight);
+            }
+        }
+
+        std::vector<topk_queue> topks(queries.size(), topk_queue(m_k, m_deleted));
+        m_accumulators.assign(queries.size() * std::size_t(m_window_size), 0.0F);
+        for (std::uint64_t begin = 0; begin < index.num_docs(); begin += m_window_size) {
+            auto end = std::min<std::uint64_t>(begin + m_window_size, index.num_docs());
+            for (auto& term: terms) {
+                while (term.docs_enum.docid() < end) {
+                    auto size = decode_run(term.docs_enum, end);
+                    score_postings(
+                        term.scorer,
+                        gsl::make_span(m_docids.data(), size),
+                        gsl::make_span(m_freqs.data(), size),
+                        gsl::make_span(m_scores.data(), size));
+                    for (auto [query_idx, weight]: term.queries) {
+                        auto* scores = &m_accumulators[query_idx * std::size_t(m_window_size)];
+                        for (std::size_t idx = 0; idx < size; ++idx) {
+                            scores[m_docids[idx] - begin] += weight * m_scores[idx];
+                        }
+                    }
+                }
+            }
+            for (std::size_t query_idx = 0; query_idx < queries.size(); ++query_idx) {
+                aggregate(query_idx, begin, end, topks[query_idx]);
+            }
+        }
+
+        std::vector<result_type> results;
+        results.reserve(queries.size());
+        for (auto& topk: topks) {
+            topk.finalize();
+            results.push_back(topk.topk());
+        }
+        return results;
+    }
+
+  private:
+    static constexpr std::size_t run_size = 128;
+
+    /// Decodes the postings of `docs` up to `run_size` of them or to the first docid not less
+    /// than `end`, whichever comes first, and returns their number.
+    template <typename Enumerator>
+    auto decode_run(Enumerator& docs, std::uint64_t end) -> std::size_t
+    {
+        std::size_t size = 0;
+        if constexpr (has_bulk_freqs_v<Enumerator>) {
+            auto count = std::min<std::size_t>(run_size, docs.size() - docs.position());
+            docs.freqs(gsl::make_span(m_bulk_freqs.data(), count));
+            for (; size < count && docs.docid() < end; ++size, docs.next()) {
+                m_docids[size] = docs.docid();
+                m_freqs[size] = m_bulk_freqs[size];
+            }
+        } else {
+            for (; size < run_size && docs.docid() < end; ++size, docs.next()) {
+                m_docids[size] = docs.docid();
+                m_freqs[size] = docs.freq();
+            }
+        }
+        return size;
+    }
+
+    /// Inserts the scores of documents in `[begin, end)` accumulated for `query_idx` into `topk`,
+    /// and clears them for the next window.
+    void aggregate(std::size_t query_idx, std::uint64_t begin, std::uint64_t end, topk_queue& topk)
+    {
+        auto* scores = &m_accumulators[query_idx * std::size_t(m_window_size)];
+        for (std::uint64_t docid = begin; docid < end; ++docid) {
+            auto& score = scores[docid - begin];
+            if (score > 0 && topk.would_enter(score)) {
+                topk.insert(score, docid);
+            }
+            score = 0;
+        }
+    }
+
+    uint64_t m_k;
+    std::uint32_t m_window_size;
+    deleted_documents const* m_deleted;
+    std::vector<float> m_accumulators;
+    std::array<std::uint32_t, run_size> m_docids{};
+    std::array<std::uint32_t, run_size> m_freqs{};
+    std::array<std::uint64_t, run_size> m_bulk_freqs{};
+    std::array<float, run_size> m_scores{};
+};
+
+}  // namespace pisa
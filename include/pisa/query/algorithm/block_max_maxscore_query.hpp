@@ -1,13 +1,24 @@
 #pragma once
 
 #include "query/queries.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
+#include <type_traits>
 #include <vector>
 
 namespace pisa {
 
-struct block_max_maxscore_query {
-    block_max_maxscore_query(topk_queue& topk) : m_topk(topk) {}
+/// Block-Max MaxScore, summing scores of type `Score`, which can be an integer type when the
+/// index, the block-max scores, and the cursor weights are all quantized. Its work is counted
+/// with the stats policy `Stats`.
+///
+/// Candidates that the deletions or the filter of the top-k queue exclude are skipped unscored,
+/// and blocks whose documents are all excluded are skipped by `deleted_block_max_data`.
+template <typename Score = float, typename Stats = default_query_stats>
+struct basic_block_max_maxscore_query {
+    using bound_type = std::conditional_t<std::is_floating_point_v<Score>, double, Score>;
+
+    basic_block_max_maxscore_query(basic_topk_queue<Score>& topk) : m_topk(topk) {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -27,7 +38,7 @@ struct block_max_maxscore_query {
             return lhs->max_weight < rhs->max_weight;
         });
 
-        std::vector<float> upper_bounds(ordered_cursors.size());
+        std::vector<Score> upper_bounds(ordered_cursors.size());
         upper_bounds[0] = ordered_cursors[0]->max_weight;
         for (size_t i = 1; i < ordered_cursors.size(); ++i) {
             upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
@@ -40,27 +51,38 @@ struct block_max_maxscore_query {
             })->docs_enum.docid();
 
         while (non_essential_lists < ordered_cursors.size() && cur_doc < max_docid) {
-            float score = 0;
+            Score score = 0;
             uint64_t next_doc = max_docid;
+            bool excluded = m_topk.excludes(cur_doc);
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
                 if (ordered_cursors[i]->docs_enum.docid() == cur_doc) {
-                    score += ordered_cursors[i]->scorer(
-                        ordered_cursors[i]->docs_enum.docid(), ordered_cursors[i]->docs_enum.freq());
+                    if (not excluded) {
+                        score += static_cast<Score>(ordered_cursors[i]->scorer(
+                            ordered_cursors[i]->docs_enum.docid(),
+                            ordered_cursors[i]->docs_enum.freq()));
+                        m_scored_postings += 1;
+                        Stats::scored();
+                    }
                     ordered_cursors[i]->docs_enum.next();
+                    Stats::decoded();
                 }
                 if (ordered_cursors[i]->docs_enum.docid() < next_doc) {
                     next_doc = ordered_cursors[i]->docs_enum.docid();
                 }
             }
+            if (excluded) {
+                cur_doc = next_doc;
+                continue;
+            }
 
-            double block_upper_bound =
+            bound_type block_upper_bound =
                 non_essential_lists > 0 ? upper_bounds[non_essential_lists - 1] : 0;
             for (int i = non_essential_lists - 1; i + 1 > 0; --i) {
                 if (ordered_cursors[i]->w.docid() < cur_doc) {
                     ordered_cursors[i]->w.next_geq(cur_doc);
                 }
-                block_upper_bound -= ordered_cursors[i]->max_weight
-                    - ordered_cursors[i]->w.score() * ordered_cursors[i]->q_weight;
+                block_upper_bound -=
+                    ordered_cursors[i]->max_weight - block_score(*ordered_cursors[i]);
                 if (!m_topk.would_enter(score + block_upper_bound)) {
                     break;
                 }
@@ -69,35 +91,58 @@ struct block_max_maxscore_query {
                 // try to complete evaluation with non-essential lists
                 for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
                     ordered_cursors[i]->docs_enum.next_geq(cur_doc);
+                    Stats::decoded();
                     if (ordered_cursors[i]->docs_enum.docid() == cur_doc) {
-                        auto s = ordered_cursors[i]->scorer(
+                        auto s = static_cast<Score>(ordered_cursors[i]->scorer(
                             ordered_cursors[i]->docs_enum.docid(),
-                            ordered_cursors[i]->docs_enum.freq());
+                            ordered_cursors[i]->docs_enum.freq()));
+                        m_scored_postings += 1;
+                        Stats::scored();
                         // score += s;
                         block_upper_bound += s;
                     }
-                    block_upper_bound -= ordered_cursors[i]->w.score() * ordered_cursors[i]->q_weight;
+                    block_upper_bound -= block_score(*ordered_cursors[i]);
 
                     if (!m_topk.would_enter(score + block_upper_bound)) {
                         break;
                     }
                 }
                 score += block_upper_bound;
+            } else if (non_essential_lists > 0) {
+                Stats::skipped_blocks();
             }
-            if (m_topk.insert(score, cur_doc)) {
+            if (Stats::insert(m_topk, score, cur_doc)) {
                 // update non-essential lists
                 while (non_essential_lists < ordered_cursors.size()
                        && !m_topk.would_enter(upper_bounds[non_essential_lists])) {
                     non_essential_lists += 1;
+                    Stats::moved_pivot();
                 }
             }
             cur_doc = next_doc;
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    auto topk() const -> std::vector<typename basic_topk_queue<Score>::entry_type> const&
+    {
+        return m_topk.topk();
+    }
+
+    /// Returns the number of postings scored so far.
+    [[nodiscard]] auto scored_postings() const noexcept -> uint64_t { return m_scored_postings; }
 
   private:
-    topk_queue& m_topk;
+    /// Returns the weighted block-max score of `cursor` at its current block, rounded up to
+    /// `Score`.
+    template <typename Cursor>
+    static auto block_score(Cursor& cursor) -> Score
+    {
+        return ceil_score<Score>(cursor.w.score()) * static_cast<Score>(cursor.q_weight);
+    }
+
+    basic_topk_queue<Score>& m_topk;
+    uint64_t m_scored_postings = 0;
 };
+
+using block_max_maxscore_query = basic_block_max_maxscore_query<>;
 }  // namespace pisa
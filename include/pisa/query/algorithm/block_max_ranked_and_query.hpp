@@ -1,13 +1,24 @@
 #pragma once
 
+#include "intersection_cache.hpp"
 #include "query/queries.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 
 namespace pisa {
 
-struct block_max_ranked_and_query {
-    block_max_ranked_and_query(topk_queue& topk) : m_topk(topk) {}
+/// Ranked conjunction that skips with block-max data before touching the posting lists.
+///
+/// The block-max data of all lists are intersected first: the blocks that contain the current
+/// candidate make an interval of docids, up to the first block end, whose summed block maxima
+/// bound every document in it. Intervals that cannot enter the top-k are skipped as a whole, and
+/// the lists are only intersected, with `next_geq`, within the others.
+///
+/// Its work is counted with the stats policy `Stats`; skipped intervals count as skipped blocks.
+template <typename Stats = default_query_stats>
+struct basic_block_max_ranked_and_query {
+    basic_block_max_ranked_and_query(topk_queue& topk) : m_topk(topk) {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -28,53 +39,91 @@ struct block_max_ranked_and_query {
             return lhs->docs_enum.size() < rhs->docs_enum.size();
         });
 
-        uint64_t candidate = ordered_cursors[0]->docs_enum.docid();
-        size_t candidate_list = 1;
+        uint64_t candidate = 0;
+        for (auto* cursor: ordered_cursors) {
+            candidate = std::max<uint64_t>(candidate, cursor->docs_enum.docid());
+        }
         while (candidate < max_docid) {
-            // Get current block UB
+            // The blocks of all lists that contain `candidate` span together an interval of
+            // docids, found with the block-max data alone, in which their upper bound holds.
             double block_upper_bound = 0;
-            for (size_t block = 0; block < ordered_cursors.size(); ++block) {
-                ordered_cursors[block]->w.next_geq(candidate);
-                block_upper_bound +=
-                    ordered_cursors[block]->w.score() * ordered_cursors[block]->q_weight;
+            uint64_t interval_end = max_docid;
+            for (auto* cursor: ordered_cursors) {
+                cursor->w.next_geq(candidate);
+                // We have exhausted a list, so we are done
+                if (cursor->w.docid() < candidate) {
+                    return;
+                }
+                block_upper_bound += cursor->w.score() * cursor->q_weight;
+                interval_end = std::min<uint64_t>(interval_end, cursor->w.docid());
             }
             if (m_topk.would_enter(block_upper_bound)) {
-                for (; candidate_list < ordered_cursors.size(); ++candidate_list) {
-                    ordered_cursors[candidate_list]->docs_enum.next_geq(candidate);
-
-                    if (ordered_cursors[candidate_list]->docs_enum.docid() != candidate) {
-                        candidate = ordered_cursors[candidate_list]->docs_enum.docid();
-                        candidate_list = 0;
-                        break;
-                    }
-                }
-                if (candidate_list == ordered_cursors.size()) {
-                    float score = 0;
-                    for (candidate_list = 0; candidate_list < ordered_cursors.size();
-                         ++candidate_list) {
-                        score += ordered_cursors[candidate_list]->scorer(
-                            ordered_cursors[candidate_list]->docs_enum.docid(),
-                            ordered_cursors[candidate_list]->docs_enum.freq());
-                    }
-
-                    m_topk.insert(score, ordered_cursors[0]->docs_enum.docid());
-                    ordered_cursors[0]->docs_enum.next();
-                    candidate = ordered_cursors[0]->docs_enum.docid();
-                    candidate_list = 1;
-                }
+                candidate =
+                    intersect_interval(ordered_cursors, candidate, interval_end, block_upper_bound);
             } else {
-                candidate_list = 0;
-                uint64_t next_jump = max_docid;
-                for (size_t block = 0; block < ordered_cursors.size(); ++block) {
-                    next_jump = std::min(next_jump, ordered_cursors[block]->w.docid());
-                }
+                Stats::skipped_blocks();
+                candidate = interval_end + 1;
+            }
+        }
+    }
+
+    /// Processes a query whose two terms are replaced by the precomputed intersection `pair`,
+    /// which drives the traversal of the cursors of the remaining terms. The maximum score of
+    /// the intersection stands in for its block upper bounds.
+    template <typename CursorRange>
+    void operator()(intersection_cursor pair, CursorRange&& cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+
+        std::vector<Cursor*> ordered_cursors;
+        ordered_cursors.reserve(cursors.size());
+        for (auto& en: cursors) {
+            ordered_cursors.push_back(&en);
+        }
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->docs_enum.size() < rhs->docs_enum.size();
+        });
+
+        uint64_t candidate = pair.docid();
+        while (candidate < max_docid) {
+            double block_upper_bound = pair.max_score();
+            uint64_t next_jump = max_docid;
+            for (auto* cursor: ordered_cursors) {
+                cursor->w.next_geq(candidate);
+                block_upper_bound += cursor->w.score() * cursor->q_weight;
+                next_jump = std::min<uint64_t>(next_jump, cursor->w.docid());
+            }
+            if (not m_topk.would_enter(block_upper_bound)) {
                 // We have exhausted a list, so we are done
-                if (candidate == next_jump + 1)
-                    candidate = max_docid;
+                if (next_jump < candidate) {
+                    break;
+                }
                 // Otherwise, exit the current block configuration
-                else
-                    candidate = next_jump + 1;
+                Stats::skipped_blocks();
+                pair.next_geq(next_jump + 1);
+                candidate = pair.docid();
+                continue;
+            }
+            size_t i = 0;
+            for (; i < ordered_cursors.size(); ++i) {
+                ordered_cursors[i]->docs_enum.next_geq(candidate);
+                Stats::decoded();
+                if (ordered_cursors[i]->docs_enum.docid() != candidate) {
+                    break;
+                }
+            }
+            if (i == ordered_cursors.size()) {
+                float score = pair.score();
+                for (auto* cursor: ordered_cursors) {
+                    score += cursor->scorer(cursor->docs_enum.docid(), cursor->docs_enum.freq());
+                }
+                Stats::scored(ordered_cursors.size());
+                Stats::insert(m_topk, score, candidate);
+                pair.next();
+            } else {
+                pair.next_geq(ordered_cursors[i]->docs_enum.docid());
             }
+            candidate = pair.docid();
         }
     }
 
@@ -83,7 +132,46 @@ struct block_max_ranked_and_query {
     topk_queue& get_topk() { return m_topk; }
 
   private:
+    /// Intersects the lists from `candidate` up to `interval_end`, inclusive, and returns the
+    /// docid to continue from. The interval is left as soon as its upper bound can no longer
+    /// enter the top-k.
+    template <typename Cursor>
+    uint64_t intersect_interval(
+        std::vector<Cursor*> const& ordered_cursors,
+        uint64_t candidate,
+        uint64_t interval_end,
+        double block_upper_bound)
+    {
+        while (candidate <= interval_end) {
+            size_t candidate_list = 0;
+            for (; candidate_list < ordered_cursors.size(); ++candidate_list) {
+                auto& docs_enum = ordered_cursors[candidate_list]->docs_enum;
+                docs_enum.next_geq(candidate);
+                Stats::decoded();
+                if (docs_enum.docid() != candidate) {
+                    candidate = docs_enum.docid();
+                    break;
+                }
+            }
+            if (candidate_list == ordered_cursors.size()) {
+                float score = 0;
+                for (auto* cursor: ordered_cursors) {
+                    score += cursor->scorer(cursor->docs_enum.docid(), cursor->docs_enum.freq());
+                }
+                Stats::scored(ordered_cursors.size());
+                Stats::insert(m_topk, score, candidate);
+                if (not m_topk.would_enter(block_upper_bound)) {
+                    return interval_end + 1;
+                }
+                candidate += 1;
+            }
+        }
+        return candidate;
+    }
+
     topk_queue& m_topk;
 };
 
+using block_max_ranked_and_query = basic_block_max_ranked_and_query<>;
+
 }  // namespace pisa
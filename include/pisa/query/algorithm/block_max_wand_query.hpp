@@ -1,17 +1,41 @@
 #pragma once
 
+#include "cursor/cursor.hpp"
 #include "query/queries.hpp"
+#include "query/query_budget.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
+#include <type_traits>
 #include <vector>
 namespace pisa {
 
-struct block_max_wand_query {
-    block_max_wand_query(topk_queue& topk) : m_topk(topk) {}
+/// Block-Max WAND, summing scores of type `Score`, which can be an integer type when the index,
+/// the block-max scores, and the cursor weights are all quantized.
+///
+/// Given a `budget`, a query stops once it is exhausted, and its results are approximate.
+///
+/// Given `prefetch_lines`, once a pivot passes the block-max check, the first cache lines of the
+/// blocks that the lists before it move to are prefetched all at once, before the lists are
+/// moved, one after another, so that their cache misses overlap.
+///
+/// Pivots that the deletions or the filter of the top-k queue exclude are skipped unscored,
+/// and blocks whose documents are all excluded are skipped by `deleted_block_max_data`.
+///
+/// Its work is counted with the stats policy `Stats`.
+template <typename Score = float, typename Stats = default_query_stats>
+struct basic_block_max_wand_query {
+    using bound_type = std::conditional_t<std::is_floating_point_v<Score>, double, Score>;
+
+    basic_block_max_wand_query(
+        basic_topk_queue<Score>& topk, query_budget budget = {}, uint32_t prefetch_lines = 0)
+        : m_topk(topk), m_budget(budget), m_prefetch_lines(prefetch_lines)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
     {
         using Cursor = typename std::decay_t<CursorRange>::value_type;
+        m_budget.start();
         if (cursors.empty())
             return;
 
@@ -21,18 +45,15 @@ struct block_max_wand_query {
             ordered_cursors.push_back(&en);
         }
 
-        auto sort_cursors = [&]() {
-            // sort enumerators by increasing docid
-            std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
-                return lhs->docs_enum.docid() < rhs->docs_enum.docid();
-            });
-        };
-
-        sort_cursors();
+        // sort enumerators by increasing docid
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->docs_enum.docid() < rhs->docs_enum.docid();
+        });
+        [[maybe_unused]] uint64_t prefetched_pivot = max_docid;
 
         while (true) {
             // find pivot
-            float upper_bound = 0.f;
+            Score upper_bound = 0;
             size_t pivot;
             bool found_pivot = false;
             uint64_t pivot_id = max_docid;
@@ -59,47 +80,70 @@ struct block_max_wand_query {
                 break;
             }
 
-            double block_upper_bound = 0;
+            bound_type block_upper_bound = 0;
 
             for (size_t i = 0; i < pivot + 1; ++i) {
                 if (ordered_cursors[i]->w.docid() < pivot_id) {
                     ordered_cursors[i]->w.next_geq(pivot_id);
                 }
 
-                block_upper_bound += ordered_cursors[i]->w.score() * ordered_cursors[i]->q_weight;
+                block_upper_bound += block_score(*ordered_cursors[i]);
             }
 
             if (m_topk.would_enter(block_upper_bound)) {
                 // check if pivot is a possible match
                 if (pivot_id == ordered_cursors[0]->docs_enum.docid()) {
-                    float score = 0;
+                    Score score = 0;
+                    uint64_t scored_postings = 0;
+                    // a filtered out pivot is only skipped past
+                    bool excluded = m_topk.excludes(pivot_id);
                     for (Cursor* en: ordered_cursors) {
-                        if (en->docs_enum.docid() != pivot_id) {
+                        if (excluded or en->docs_enum.docid() != pivot_id) {
                             break;
                         }
-                        float part_score = en->scorer(en->docs_enum.docid(), en->docs_enum.freq());
+                        auto part_score = static_cast<Score>(
+                            en->scorer(en->docs_enum.docid(), en->docs_enum.freq()));
                         score += part_score;
-                        block_upper_bound -= en->w.score() * en->q_weight - part_score;
+                        scored_postings += 1;
+                        Stats::scored();
+                        block_upper_bound -= block_score(*en) - part_score;
                         if (!m_topk.would_enter(block_upper_bound)) {
                             break;
                         }
                     }
+                    size_t moved = 0;
                     for (Cursor* en: ordered_cursors) {
                         if (en->docs_enum.docid() != pivot_id) {
                             break;
                         }
                         en->docs_enum.next();
+                        Stats::decoded();
+                        moved += 1;
                     }
 
-                    m_topk.insert(score, pivot_id);
-                    // resort by docid
-                    sort_cursors();
+                    if (not excluded) {
+                        Stats::insert(m_topk, score, pivot_id);
+                    }
+                    if (not m_budget.consume(scored_postings, m_topk.threshold())) {
+                        return;
+                    }
+                    reorder_moved_cursors(ordered_cursors, moved);
 
                 } else {
+                    if constexpr (has_prefetch_v<typename Cursor::enum_type>) {
+                        if (m_prefetch_lines > 0 && prefetched_pivot != pivot_id) {
+                            for (size_t i = 0; i < pivot; ++i) {
+                                ordered_cursors[i]->docs_enum.prefetch(pivot_id, m_prefetch_lines);
+                            }
+                            prefetched_pivot = pivot_id;
+                        }
+                    }
                     uint64_t next_list = pivot;
                     for (; ordered_cursors[next_list]->docs_enum.docid() == pivot_id; --next_list)
                         ;
                     ordered_cursors[next_list]->docs_enum.next_geq(pivot_id);
+                    Stats::decoded();
+                    Stats::moved_pivot();
 
                     // bubble down the advanced list
                     for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
@@ -116,7 +160,7 @@ struct block_max_wand_query {
                 uint64_t next;
                 uint64_t next_list = pivot;
 
-                float max_weight = ordered_cursors[next_list]->max_weight;
+                Score max_weight = ordered_cursors[next_list]->max_weight;
 
                 for (uint64_t i = 0; i < pivot; i++) {
                     if (ordered_cursors[i]->max_weight > max_weight) {
@@ -143,6 +187,8 @@ struct block_max_wand_query {
                 }
 
                 ordered_cursors[next_list]->docs_enum.next_geq(next);
+                Stats::decoded();
+                Stats::skipped_blocks();
 
                 // bubble down the advanced list
                 for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
@@ -157,14 +203,38 @@ struct block_max_wand_query {
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    auto topk() const -> std::vector<typename basic_topk_queue<Score>::entry_type> const&
+    {
+        return m_topk.topk();
+    }
 
     void clear_topk() { m_topk.clear(); }
 
-    topk_queue const& get_topk() const { return m_topk; }
+    /// Returns whether the last query ran out of budget, so that its results may be approximate.
+    [[nodiscard]] auto is_approximate() const noexcept -> bool { return m_budget.is_exhausted(); }
+
+    /// Returns the number of postings scored by the last query.
+    [[nodiscard]] auto scored_postings() const noexcept -> uint64_t
+    {
+        return m_budget.postings_scored();
+    }
+
+    basic_topk_queue<Score> const& get_topk() const { return m_topk; }
 
   private:
-    topk_queue& m_topk;
+    /// Returns the weighted block-max score of `cursor` at its current block, rounded up to
+    /// `Score`.
+    template <typename Cursor>
+    static auto block_score(Cursor& cursor) -> Score
+    {
+        return ceil_score<Score>(cursor.w.score()) * static_cast<Score>(cursor.q_weight);
+    }
+
+    basic_topk_queue<Score>& m_topk;
+    query_budget m_budget;
+    uint32_t m_prefetch_lines;
 };
 
+using block_max_wand_query = basic_block_max_wand_query<>;
+
 }  // namespace pisa
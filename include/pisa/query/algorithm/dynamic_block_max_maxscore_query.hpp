@@ -0,0 +1,182 @@
+#pragma once
+
+#include "query/queries.hpp"
+#include "query/query_stats.hpp"
+#include "topk_queue.hpp"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace pisa {
+
+/// Block-Max MaxScore that partitions the lists into essential and non-essential ones per window
+/// of docids, using the block-max scores of the window instead of the global maximum scores.
+///
+/// A window spans the docids covered by the current block of every list, so the contribution of
+/// each list within it is bounded by its block-max score, or by zero if it has no posting in the
+/// window. At the start of each window, the lists are sorted by these bounds, and the longest
+/// prefix whose bounds sum to less than the threshold is non-essential; if all lists are, the
+/// whole window is skipped. The partition is updated within the window whenever the threshold
+/// rises.
+///
+/// Its work is counted with the stats policy `Stats`; skipped windows count as skipped blocks.
+template <typename Score = float, typename Stats = default_query_stats>
+struct basic_dynamic_block_max_maxscore_query {
+    using bound_type = std::conditional_t<std::is_floating_point_v<Score>, double, Score>;
+
+    basic_dynamic_block_max_maxscore_query(basic_topk_queue<Score>& topk) : m_topk(topk) {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        if (cursors.empty()) {
+            return;
+        }
+
+        struct list {
+            Cursor* cursor;
+            Score bound;
+        };
+        std::vector<list> lists;
+        lists.reserve(cursors.size());
+        for (auto& en: cursors) {
+            lists.push_back({&en, 0});
+        }
+        std::vector<bound_type> upper_bounds(lists.size());
+
+        uint64_t cur_doc =
+            std::min_element(cursors.begin(), cursors.end(), [](Cursor const& lhs, Cursor const& rhs) {
+                return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+            })->docs_enum.docid();
+
+        while (cur_doc < max_docid) {
+            // the window ends with the first of the current blocks to end
+            uint64_t window_end = max_docid;
+            for (auto& l: lists) {
+                if (l.cursor->w.docid() < cur_doc) {
+                    l.cursor->w.next_geq(cur_doc);
+                }
+                if (l.cursor->w.docid() >= cur_doc) {
+                    window_end = std::min<uint64_t>(window_end, l.cursor->w.docid() + 1);
+                }
+            }
+            for (auto& l: lists) {
+                bool in_window =
+                    l.cursor->docs_enum.docid() < window_end && l.cursor->w.docid() >= cur_doc;
+                l.bound = in_window ? block_score(*l.cursor) : 0;
+            }
+            std::sort(lists.begin(), lists.end(), [](list const& lhs, list const& rhs) {
+                return lhs.bound < rhs.bound;
+            });
+            bound_type sum = 0;
+            for (size_t i = 0; i < lists.size(); ++i) {
+                sum += lists[i].bound;
+                upper_bounds[i] = sum;
+            }
+
+            size_t non_essential_lists = 0;
+            auto update_partition = [&] {
+                while (non_essential_lists < lists.size()
+                       && !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                    non_essential_lists += 1;
+                    Stats::moved_pivot();
+                }
+            };
+            update_partition();
+            if (non_essential_lists == lists.size()) {
+                m_skipped_windows += 1;
+                Stats::skipped_blocks();
+                cur_doc = window_end;
+                continue;
+            }
+            m_windows += 1;
+
+            for (size_t i = non_essential_lists; i < lists.size(); ++i) {
+                lists[i].cursor->docs_enum.next_geq(cur_doc);
+                Stats::decoded();
+            }
+            while (non_essential_lists < lists.size()) {
+                uint64_t candidate = window_end;
+                for (size_t i = non_essential_lists; i < lists.size(); ++i) {
+                    candidate = std::min<uint64_t>(candidate, lists[i].cursor->docs_enum.docid());
+                }
+                if (candidate >= window_end) {
+                    break;
+                }
+
+                bound_type score = 0;
+                for (size_t i = non_essential_lists; i < lists.size(); ++i) {
+                    if (lists[i].cursor->docs_enum.docid() == candidate) {
+                        score += posting_score(*lists[i].cursor);
+                        lists[i].cursor->docs_enum.next();
+                        Stats::decoded();
+                    }
+                }
+
+                // complete the score with non-essential lists, by decreasing bound
+                bound_type upper_bound =
+                    score + (non_essential_lists > 0 ? upper_bounds[non_essential_lists - 1] : 0);
+                for (size_t i = non_essential_lists; i > 0; --i) {
+                    if (!m_topk.would_enter(upper_bound)) {
+                        break;
+                    }
+                    auto& cursor = *lists[i - 1].cursor;
+                    cursor.docs_enum.next_geq(candidate);
+                    Stats::decoded();
+                    if (cursor.docs_enum.docid() == candidate) {
+                        upper_bound += posting_score(cursor);
+                    }
+                    upper_bound -= lists[i - 1].bound;
+                }
+                if (Stats::insert(m_topk, upper_bound, candidate)) {
+                    update_partition();
+                }
+            }
+            cur_doc = window_end;
+        }
+    }
+
+    auto topk() const -> std::vector<typename basic_topk_queue<Score>::entry_type> const&
+    {
+        return m_topk.topk();
+    }
+
+    /// Returns the number of postings scored so far.
+    [[nodiscard]] auto scored_postings() const noexcept -> uint64_t { return m_scored_postings; }
+
+    /// Returns the number of windows traversed so far, and the number of those skipped without
+    /// scoring any posting.
+    [[nodiscard]] auto windows() const noexcept -> uint64_t
+    {
+        return m_windows + m_skipped_windows;
+    }
+    [[nodiscard]] auto skipped_windows() const noexcept -> uint64_t { return m_skipped_windows; }
+
+  private:
+    /// Scores the current posting of `cursor`, counting it.
+    template <typename Cursor>
+    auto posting_score(Cursor& cursor) -> Score
+    {
+        m_scored_postings += 1;
+        Stats::scored();
+        return static_cast<Score>(cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq()));
+    }
+
+    /// Returns the weighted block-max score of `cursor` at its current block, rounded up to
+    /// `Score`.
+    template <typename Cursor>
+    static auto block_score(Cursor& cursor) -> Score
+    {
+        return ceil_score<Score>(cursor.w.score()) * static_cast<Score>(cursor.q_weight);
+    }
+
+    basic_topk_queue<Score>& m_topk;
+    uint64_t m_scored_postings = 0;
+    uint64_t m_windows = 0;
+    uint64_t m_skipped_windows = 0;
+};
+
+using dynamic_block_max_maxscore_query = basic_dynamic_block_max_maxscore_query<>;
+
+}  // namespace pisa
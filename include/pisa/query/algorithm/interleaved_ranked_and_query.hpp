@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gsl/span>
+
+#include "cursor/cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Ranked conjunctions of a group of queries, interleaved on one thread to hide the latency of
+/// loading blocks.
+///
+/// Each query is a resumable traversal, a hand-written stackless coroutine. Whenever a list is
+/// about to move to a block not yet in cache, its traversal prefetches the first
+/// `prefetch_lines` cache lines of the block and yields to the next query, and resumes with the
+/// move once every other query has had its turn, by which time the block has likely arrived.
+/// Enumerators that cannot prefetch are never suspended.
+///
+/// The results of each query are those of `ranked_and_query`.
+class interleaved_ranked_and_query {
+  public:
+    using result_type = std::vector<std::pair<float, uint64_t>>;
+    static constexpr std::uint32_t default_prefetch_lines = 4;
+
+    explicit interleaved_ranked_and_query(
+        uint64_t k,
+        std::uint32_t prefetch_lines = default_prefetch_lines,
+        deleted_documents const* deleted = nullptr)
+        : m_k(k), m_prefetch_lines(prefetch_lines), m_deleted(deleted)
+    {}
+
+    /// Returns the finalized top-k results of each of `queries`, in order.
+    template <typename Index, typename Scorer>
+    [[nodiscard]] auto
+    operator()(Index const& index, Scorer const& scorer, gsl::span<Query const> queries)
+        -> std::vector<result_type>
+    {
+        using cursors_type = decltype(make_scored_cursors(index, scorer, Query{}));
+        std::vector<topk_queue> topks(queries.size(), topk_queue(m_k, m_deleted));
+        std::vector<traversal<cursors_type>> traversals;
+        traversals.reserve(queries.size());
+        for (std::size_t query_idx = 0; query_idx < queries.size(); ++query_idx) {
+            traversals.emplace_back(
+                make_scored_cursors(index, scorer, queries[query_idx]),
+                topks[query_idx],
+                index.num_docs(),
+                m_prefetch_lines);
+        }
+
+        // Round-robin over the traversals still running, dropping each one once done.
+        std::vector<traversal<cursors_type>*> running;
+        for (auto& t: traversals) {
+            running.push_back(&t);
+        }
+        while (not running.empty()) {
+            running.erase(
+                std::remove_if(
+                    running.begin(), running.end(), [](auto* t) { return not t->resume(); }),
+                running.end());
+        }
+
+        std::vector<result_type> results;
+        results.reserve(queries.size());
+        for (auto& topk: topks) {
+            topk.finalize();
+            results.emplace_back(topk.topk().begin(), topk.topk().end());
+        }
+        return results;
+    }
+
+  private:
+    /// The state of the ranked conjunction of one query between two resumptions.
+    template <typename Cursors>
+    class traversal {
+      public:
+        using cursor_type = typename Cursors::value_type;
+
+        traversal(Cursors cursors, topk_queue& topk, uint64_t max_docid, std::uint32_t lines)
+            : m_cursors(std::move(cursors)), m_topk(topk), m_max_docid(max_docid), m_lines(lines)
+        {
+            // sort by increasing frequency
+            std::sort(m_cursors.begin(), m_cursors.end(), [](auto const& lhs, auto const& rhs) {
+                return lhs.docs_enum.size() < rhs.docs_enum.size();
+            });
+            m_candidate = m_cursors.empty() ? max_docid : m_cursors[0].docs_enum.docid();
+        }
+
+        /// Runs the traversal until it must wait for a block, or to its end. Returns whether it
+        /// is suspended rather than done.
+        bool resume()
+        {
+            while (m_candidate < m_max_docid) {
+                for (; m_next < m_cursors.size(); ++m_next) {
+                    auto& docs_enum = m_cursors[m_next].docs_enum;
+                    if constexpr (has_prefetch_v<typename cursor_type::enum_type>) {
+                        if (not m_suspended and docs_enum.prefetch(m_candidate, m_lines)) {
+                            m_suspended = true;
+                            return true;
+                        }
+                        m_suspended = false;
+                    }
+                    docs_enum.next_geq(m_candidate);
+                    if (docs_enum.docid() != m_candidate) {
+                        m_candidate = docs_enum.docid();
+                        m_next = 0;
+                        break;
+                    }
+                }
+                if (m_next == m_cursors.size()) {
+                    float score = 0;
+                    for (auto& cursor: m_cursors) {
+                        score += cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq());
+                    }
+                    m_topk.insert(score, m_candidate);
+                    m_cursors[0].docs_enum.next();
+                    m_candidate = m_cursors[0].docs_enum.docid();
+                    m_next = 1;
+                }
+            }
+            return false;
+        }
+
+      private:
+        Cursors m_cursors;
+        topk_queue& m_topk;
+        uint64_t m_max_docid;
+        std::uint32_t m_lines;
+        uint64_t m_candidate = 0;
+        std::size_t m_next = 1;
+        bool m_suspended = false;
+    };
+
+    uint64_t m_k;
+    std::uint32_t m_prefetch_lines;
+    deleted_documents const* m_deleted;
+};
+
+}  // namespace pisa
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "query/queries.hpp"
+#include "query/query_stats.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// MaxScore for long queries, such as expansion queries with tens to hundreds of terms.
+///
+/// Lists are split as in `maxscore_query` into essential lists, whose documents are all scored,
+/// and non-essential ones, with the lowest maximum scores, which are only probed for these
+/// documents while they can still enter the top-k. `maxscore_query` scans all essential lists for
+/// every document; here they are kept in a binary heap ordered by docid, so that finding the next
+/// document and advancing the lists that contain it is logarithmic in the number of lists. Lists
+/// that become non-essential as the threshold rises are dropped from the heap once they reach
+/// its top.
+///
+/// With a positive `clip_ratio`, for learned sparse queries with many low-weight terms, lists
+/// whose maximum score is below `clip_ratio` times the largest one are never essential: they only
+/// add to the scores of the documents found in the other lists, and are never traversed on their
+/// own. Documents that only contain such terms are missed, so results are approximate, but the
+/// scores of the documents returned are exact.
+///
+/// Its work is counted with the stats policy `Stats`.
+template <typename Stats = default_query_stats>
+struct basic_long_maxscore_query {
+    explicit basic_long_maxscore_query(topk_queue& topk, float clip_ratio = 0.0)
+        : m_topk(topk), m_clip_ratio(clip_ratio)
+    {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        if (cursors.empty()) {
+            return;
+        }
+
+        std::vector<Cursor*> ordered_cursors;
+        ordered_cursors.reserve(cursors.size());
+        for (auto& en: cursors) {
+            ordered_cursors.push_back(&en);
+        }
+        // sort enumerators by increasing maxscore
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->max_weight < rhs->max_weight;
+        });
+
+        std::vector<float> upper_bounds(ordered_cursors.size());
+        upper_bounds[0] = ordered_cursors[0]->max_weight;
+        for (size_t i = 1; i < ordered_cursors.size(); ++i) {
+            upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
+        }
+
+        size_t non_essential_lists = 0;
+        float clipped_weight = m_clip_ratio * ordered_cursors.back()->max_weight;
+        while (non_essential_lists + 1 < ordered_cursors.size()
+               && ordered_cursors[non_essential_lists]->max_weight < clipped_weight) {
+            non_essential_lists += 1;
+        }
+        auto update_non_essential_lists = [&]() {
+            while (non_essential_lists < ordered_cursors.size()
+                   && !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                non_essential_lists += 1;
+                Stats::moved_pivot();
+            }
+        };
+        update_non_essential_lists();
+
+        // min-heap of the positions in `ordered_cursors` of the essential lists, by docid
+        auto docid = [&](size_t list) { return ordered_cursors[list]->docs_enum.docid(); };
+        auto heap_order = [&](size_t lhs, size_t rhs) { return docid(lhs) > docid(rhs); };
+        std::vector<size_t> heap;
+        heap.reserve(ordered_cursors.size());
+        for (size_t list = non_essential_lists; list < ordered_cursors.size(); ++list) {
+            if (docid(list) < max_docid) {
+                heap.push_back(list);
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), heap_order);
+
+        while (!heap.empty() && non_essential_lists < ordered_cursors.size()) {
+            if (heap.front() < non_essential_lists) {
+                std::pop_heap(heap.begin(), heap.end(), heap_order);
+                heap.pop_back();
+                continue;
+            }
+            uint64_t cur_doc = docid(heap.front());
+            float score = 0;
+            while (!heap.empty() && docid(heap.front()) == cur_doc) {
+                std::pop_heap(heap.begin(), heap.end(), heap_order);
+                auto list = heap.back();
+                if (list < non_essential_lists) {
+                    // probed below with the other non-essential lists
+                    heap.pop_back();
+                    continue;
+                }
+                auto* cursor = ordered_cursors[list];
+                score += cursor->scorer(cursor->docs_enum.docid(), cursor->docs_enum.freq());
+                Stats::scored();
+                cursor->docs_enum.next();
+                Stats::decoded();
+                if (cursor->docs_enum.docid() < max_docid) {
+                    std::push_heap(heap.begin(), heap.end(), heap_order);
+                } else {
+                    heap.pop_back();
+                }
+            }
+
+            // try to complete evaluation with non-essential lists
+            for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
+                if (!m_topk.would_enter(score + upper_bounds[i])) {
+                    break;
+                }
+                auto& docs_enum = ordered_cursors[i]->docs_enum;
+                if (docs_enum.docid() < cur_doc) {
+                    docs_enum.next_geq(cur_doc);
+                    Stats::decoded();
+                }
+                if (docs_enum.docid() == cur_doc) {
+                    score += ordered_cursors[i]->scorer(docs_enum.docid(), docs_enum.freq());
+                    Stats::scored();
+                }
+            }
+
+            if (Stats::insert(m_topk, score, cur_doc)) {
+                update_non_essential_lists();
+            }
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    topk_queue& m_topk;
+    float m_clip_ratio;
+};
+
+using long_maxscore_query = basic_long_maxscore_query<>;
+
+}  // namespace pisa
@@ -1,18 +1,55 @@
 #pragma once
 
+#include "pair_bounds.hpp"
 #include "query/queries.hpp"
+#include "query/query_budget.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 
 namespace pisa {
 
-struct maxscore_query {
-    maxscore_query(topk_queue& topk) : m_topk(topk) {}
+/// MaxScore. Given a `budget`, a query stops once it is exhausted, and its results are
+/// approximate. Its work is counted with the stats policy `Stats`.
+///
+/// Candidates that the deletions or the filter of the top-k queue exclude are skipped unscored.
+template <typename Stats = default_query_stats>
+struct basic_maxscore_query {
+    basic_maxscore_query(topk_queue& topk, query_budget budget = {})
+        : m_topk(topk), m_budget(budget)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        process(cursors, max_docid, nullptr);
+    }
+
+    /// Bounds the non-essential lists with the bounds of the term pairs of the query, which can
+    /// make more lists non-essential.
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid, query_pair_bounds const& pairs)
+    {
+        process(cursors, max_docid, &pairs);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+    /// Returns whether the last query ran out of budget, so that its results may be approximate.
+    [[nodiscard]] auto is_approximate() const noexcept -> bool { return m_budget.is_exhausted(); }
+
+    /// Returns the number of postings scored by the last query.
+    [[nodiscard]] auto scored_postings() const noexcept -> uint64_t
+    {
+        return m_budget.postings_scored();
+    }
+
+  private:
+    template <typename CursorRange>
+    void process(CursorRange&& cursors, uint64_t max_docid, query_pair_bounds const* pairs)
     {
         using Cursor = typename std::decay_t<CursorRange>::value_type;
+        m_budget.start();
         if (cursors.empty())
             return;
 
@@ -28,9 +65,17 @@ struct maxscore_query {
         });
 
         std::vector<float> upper_bounds(ordered_cursors.size());
-        upper_bounds[0] = ordered_cursors[0]->max_weight;
-        for (size_t i = 1; i < ordered_cursors.size(); ++i) {
-            upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
+        if (pairs != nullptr) {
+            std::vector<std::size_t> order;
+            for (Cursor* cursor: ordered_cursors) {
+                order.push_back(cursor - &*std::begin(cursors));
+            }
+            upper_bounds = pairs->prefix_upper_bounds(order);
+        } else {
+            upper_bounds[0] = ordered_cursors[0]->max_weight;
+            for (size_t i = 1; i < ordered_cursors.size(); ++i) {
+                upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
+            }
         }
 
         uint64_t non_essential_lists = 0;
@@ -38,6 +83,7 @@ struct maxscore_query {
             while (non_essential_lists < ordered_cursors.size()
                    && !m_topk.would_enter(upper_bounds[non_essential_lists])) {
                 non_essential_lists += 1;
+                Stats::moved_pivot();
             }
         };
         update_non_essential_lists();
@@ -49,17 +95,28 @@ struct maxscore_query {
 
         while (non_essential_lists < ordered_cursors.size() && cur_doc < max_docid) {
             float score = 0;
+            uint64_t scored_postings = 0;
             uint64_t next_doc = max_docid;
+            bool excluded = m_topk.excludes(cur_doc);
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
                 if (ordered_cursors[i]->docs_enum.docid() == cur_doc) {
-                    score += ordered_cursors[i]->scorer(
-                        ordered_cursors[i]->docs_enum.docid(), ordered_cursors[i]->docs_enum.freq());
+                    if (not excluded) {
+                        score += ordered_cursors[i]->scorer(
+                            ordered_cursors[i]->docs_enum.docid(),
+                            ordered_cursors[i]->docs_enum.freq());
+                        scored_postings += 1;
+                    }
                     ordered_cursors[i]->docs_enum.next();
+                    Stats::decoded();
                 }
                 if (ordered_cursors[i]->docs_enum.docid() < next_doc) {
                     next_doc = ordered_cursors[i]->docs_enum.docid();
                 }
             }
+            if (excluded) {
+                cur_doc = next_doc;
+                continue;
+            }
 
             // try to complete evaluation with non-essential lists
             for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
@@ -67,24 +124,30 @@ struct maxscore_query {
                     break;
                 }
                 ordered_cursors[i]->docs_enum.next_geq(cur_doc);
+                Stats::decoded();
                 if (ordered_cursors[i]->docs_enum.docid() == cur_doc) {
                     score += ordered_cursors[i]->scorer(
                         ordered_cursors[i]->docs_enum.docid(), ordered_cursors[i]->docs_enum.freq());
+                    scored_postings += 1;
                 }
             }
 
-            if (m_topk.insert(score, cur_doc)) {
+            Stats::scored(scored_postings);
+            if (Stats::insert(m_topk, score, cur_doc)) {
                 update_non_essential_lists();
             }
+            if (not m_budget.consume(scored_postings, m_topk.threshold())) {
+                break;
+            }
 
             cur_doc = next_doc;
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
-
-  private:
     topk_queue& m_topk;
+    query_budget m_budget;
 };
 
+using maxscore_query = basic_maxscore_query<>;
+
 }  // namespace pisa
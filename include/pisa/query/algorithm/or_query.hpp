@@ -1,12 +1,28 @@
 #pragma once
 
-#include "query/queries.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
+#include "cursor/cursor.hpp"
+#include "query/queries.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/intrinsics.hpp"
+#include "util/util.hpp"
+
 namespace pisa {
 
+/// Counts the documents that contain any of the terms of a query.
+///
+/// Documents are counted a window of `window_size` docids at a time: each list marks its
+/// documents of the window in a bitmap, which is then counted with `popcount`. Finding the
+/// smallest docid of all lists for every document is thus avoided, and lists that expose their
+/// decoded blocks are read directly from them. Windows that no list has a document in are
+/// skipped.
 template <bool with_freqs>
 struct or_query {
+    static constexpr uint64_t window_size = uint64_t(1) << 16U;
+
     template <typename CursorRange>
     uint64_t operator()(CursorRange&& cursors, uint64_t max_docid) const
     {
@@ -14,32 +30,71 @@ struct or_query {
         if (cursors.empty())
             return 0;
 
+        std::vector<uint64_t> bitmap(window_size / 64);
         uint64_t results = 0;
-        uint64_t cur_doc =
+        uint64_t begin =
             std::min_element(cursors.begin(), cursors.end(), [](Cursor const& lhs, Cursor const& rhs) {
                 return lhs.docid() < rhs.docid();
             })->docid();
 
-        while (cur_doc < max_docid) {
-            results += 1;
-            uint64_t next_doc = max_docid;
-            for (size_t i = 0; i < cursors.size(); ++i) {
-                if (cursors[i].docid() == cur_doc) {
-                    if constexpr (with_freqs) {
-                        do_not_optimize_away(cursors[i].freq());
+        while (begin < max_docid) {
+            uint64_t end = std::min(begin + window_size, max_docid);
+            uint64_t next_begin = max_docid;
+            for (auto& cursor: cursors) {
+                mark(cursor, begin, end, bitmap);
+                next_begin = std::min<uint64_t>(next_begin, cursor.docid());
+            }
+            auto words = ceil_div(end - begin, 64);
+            for (size_t word = 0; word < words; ++word) {
+                results += intrinsics::popcount(bitmap[word]);
+                bitmap[word] = 0;
+            }
+            begin = next_begin;
+        }
+
+        return results;
+    }
+
+  private:
+    /// Marks the documents of `cursor` in `[begin, end)`, leaving it at the first posting not
+    /// less than `end`.
+    template <typename Cursor>
+    static void mark(Cursor& cursor, uint64_t begin, uint64_t end, std::vector<uint64_t>& bitmap)
+    {
+        auto set = [&](uint64_t docid) {
+            auto offset = docid - begin;
+            bitmap[offset / 64] |= uint64_t(1) << (offset % 64);
+        };
+        if constexpr (has_block_interface_v<Cursor>) {
+            while (cursor.docid() < end) {
+                auto docids = cursor.block_docids();
+                std::size_t size = docids.size();
+                std::size_t idx = 0;
+                for (; idx < size && docids[idx] < end; ++idx) {
+                    set(docids[idx]);
+                }
+                if constexpr (with_freqs) {
+                    auto freqs = cursor.block_freqs();
+                    for (std::size_t pos = 0; pos < idx; ++pos) {
+                        do_not_optimize_away(freqs[pos]);
                     }
-                    cursors[i].next();
                 }
-                if (cursors[i].docid() < next_doc) {
-                    next_doc = cursors[i].docid();
+                if (idx < size) {
+                    cursor.move(cursor.position() + idx);
+                    return;
                 }
+                cursor.next_block();
+            }
+        } else {
+            while (cursor.docid() < end) {
+                set(cursor.docid());
+                if constexpr (with_freqs) {
+                    do_not_optimize_away(cursor.freq());
+                }
+                cursor.next();
             }
-
-            cur_doc = next_doc;
         }
-
-        return results;
     }
 };
 
-}  // namespace pisa
\ No newline at end of file
+}  // namespace pisa
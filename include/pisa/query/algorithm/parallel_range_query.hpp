@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <tbb/parallel_for.h>
+
+#include "concurrent_topk_queue.hpp"
+#include "query/docid_range.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Processes the docid ranges of a query concurrently.
+///
+/// Every range is evaluated by `QueryAlg` on its own copy of the cursors, forwarded to the
+/// beginning of the range, into the local queue of its thread of a `concurrent_topk_queue`.
+/// All ranges prune with the best threshold found so far by any thread, as soon as it is found.
+template <typename QueryAlg>
+struct parallel_range_query {
+    parallel_range_query(topk_queue& topk) : m_topk(topk) {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid, size_t range_size)
+    {
+        auto initial_threshold = m_topk.threshold();
+        m_topk.clear();
+        if (cursors.empty()) {
+            return;
+        }
+
+        concurrent_topk_queue topk(m_topk.size(), m_topk.deleted(), initial_threshold);
+        size_t num_ranges = ceil_div(max_docid, range_size);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, num_ranges, 1),
+            [&](tbb::blocked_range<size_t> const& ranges) {
+                for (size_t range = ranges.begin(); range != ranges.end(); ++range) {
+                    uint64_t begin = range * range_size;
+                    uint64_t end = std::min(begin + range_size, max_docid);
+                    process_range(std::decay_t<CursorRange>(cursors), begin, end, topk.local());
+                }
+            });
+        topk.merge(m_topk);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+    template <typename CursorRange>
+    void process_range(CursorRange&& cursors, uint64_t begin, uint64_t end, topk_queue& topk)
+    {
+        seek_cursors(cursors, begin);
+        QueryAlg query_alg(topk);
+        query_alg(cursors, end);
+    }
+
+  private:
+    topk_queue& m_topk;
+};
+
+}  // namespace pisa
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gsl/span>
+
+#include "cursor/cursor.hpp"
+#include "query/algorithm/and_query.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// Returns the documents that contain the terms of a query as an exact phrase, in query order.
+///
+/// Candidates are found by intersecting the lists of the distinct terms, as in `and_query`, and
+/// then verified with the positions of their postings in a `positional_index`, which decodes only
+/// the position blocks of the postings that reach verification.
+struct phrase_query {
+    template <typename Index, typename PositionalIndex>
+    auto operator()(Index const& index, PositionalIndex const& positions, Query const& query) const
+    {
+        auto cursors = make_cursors(index, query);
+        auto terms = query.terms;
+        remove_duplicate_terms(terms);
+
+        using positions_enumerator = typename PositionalIndex::enumerator;
+        std::vector<positions_enumerator> term_positions;
+        term_positions.reserve(terms.size());
+        for (auto term: terms) {
+            term_positions.push_back(positions[term]);
+        }
+        // the index of the distinct term, and thus of its cursor, of each term of the phrase
+        std::vector<std::size_t> phrase;
+        phrase.reserve(query.terms.size());
+        for (auto term: query.terms) {
+            phrase.push_back(
+                std::lower_bound(terms.begin(), terms.end(), term) - terms.begin());
+        }
+
+        std::vector<gsl::span<uint32_t const>> spans(terms.size());
+        auto verify = [&](uint32_t) {
+            for (std::size_t idx = 0; idx < cursors.size(); ++idx) {
+                spans[idx] = term_positions[idx].positions(cursors[idx].position());
+            }
+            for (auto start: spans[phrase[0]]) {
+                bool match = true;
+                for (std::size_t offset = 1; match && offset < phrase.size(); ++offset) {
+                    auto const& span = spans[phrase[offset]];
+                    match = std::binary_search(span.begin(), span.end(), start + offset);
+                }
+                if (match) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        return and_query{}(cursors, index.num_docs(), verify);
+    }
+};
+
+}  // namespace pisa
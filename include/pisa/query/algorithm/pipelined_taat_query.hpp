@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <tbb/concurrent_queue.h>
+
+#include "cursor/cursor.hpp"
+#include "query/queries.hpp"
+#include "query/query_stats.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Term-at-a-time ranked disjunction over a term-partitioned index, in which every node holds
+/// the lists of some of the terms.
+///
+/// The nodes form a pipeline: the first one scores its lists over a window of docids into a
+/// window accumulator, which it passes on to the next node, and so on, until the last one
+/// passes it back to the caller, which aggregates it into the top-k. Each node runs in a thread
+/// of its own, so that while a node scores a window, the nodes before it are already scoring
+/// the following ones. As in `windowed_taat_query`, the accumulators are of a single window
+/// each, and they are the only data that flows between nodes, not the lists.
+///
+/// `accumulators`, e.g., `Simple_Accumulator` or `Lazy_Accumulator` of `window_size`, are the
+/// windows in flight: the more of them, the less the nodes wait for each other. The work of all
+/// nodes is counted with the stats policy `Stats` in the calling thread.
+template <typename Stats = default_query_stats>
+class basic_pipelined_taat_query {
+  public:
+    /// 64Ki scores take 256 KiB, which fits in the L2 cache of most CPUs.
+    static constexpr std::size_t default_window_size = std::size_t(1) << 16U;
+
+    explicit basic_pipelined_taat_query(
+        topk_queue& topk, std::size_t window_size = default_window_size)
+        : m_topk(topk), m_window_size(window_size)
+    {}
+
+    /// Processes the query, whose cursors over the lists held by node `n` are in
+    /// `node_cursors[n]`, in the order of the nodes.
+    template <typename CursorRange, typename Acc>
+    void operator()(
+        std::vector<CursorRange>& node_cursors, uint64_t max_docid, std::vector<Acc>& accumulators)
+    {
+        using Cursor = typename CursorRange::value_type;
+        if (accumulators.empty()) {
+            throw std::invalid_argument("At least one accumulator must be in flight");
+        }
+        // windows start from the first posting, which is not 0 in a restricted docid range
+        uint64_t first_docid = max_docid;
+        for (auto&& cursors: node_cursors) {
+            for (auto&& cursor: cursors) {
+                first_docid = std::min<uint64_t>(first_docid, cursor.docs_enum.docid());
+            }
+        }
+        if (first_docid >= max_docid) {
+            return;
+        }
+
+        // Queue `n` holds the windows node `n` is to score next, and the last one those to
+        // aggregate. A window is the position of its accumulator, and `done` ends the query.
+        constexpr std::size_t done = std::numeric_limits<std::size_t>::max();
+        std::vector<tbb::concurrent_bounded_queue<std::size_t>> queues(node_cursors.size() + 1);
+        tbb::concurrent_bounded_queue<std::size_t> free;
+        std::vector<uint64_t> window_begin(accumulators.size());
+        for (std::size_t idx = 0; idx < accumulators.size(); ++idx) {
+            free.push(idx);
+        }
+        std::vector<query_counters> counters(node_cursors.size());
+
+        // The first node takes the accumulators released by the caller for the next windows.
+        auto feed = [&] {
+            for (uint64_t begin = first_docid; begin < max_docid; begin += m_window_size) {
+                std::size_t idx = 0;
+                free.pop(idx);
+                window_begin[idx] = begin;
+                accumulators[idx].init();
+                queues[0].push(idx);
+            }
+            queues[0].push(done);
+        };
+        auto node = [&](std::size_t n) {
+            auto& cursors = node_cursors[n];
+            while (true) {
+                std::size_t idx = 0;
+                queues[n].pop(idx);
+                if (idx != done) {
+                    auto begin = window_begin[idx];
+                    auto end = std::min<uint64_t>(begin + m_window_size, max_docid);
+                    for (auto&& cursor: cursors) {
+                        score_window<Cursor>(cursor, begin, end, accumulators[idx], counters[n]);
+                    }
+                }
+                queues[n + 1].push(idx);
+                if (idx == done) {
+                    return;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.emplace_back(feed);
+        for (std::size_t n = 0; n < node_cursors.size(); ++n) {
+            threads.emplace_back(node, n);
+        }
+        while (true) {
+            std::size_t idx = 0;
+            queues.back().pop(idx);
+            if (idx == done) {
+                break;
+            }
+            accumulators[idx].aggregate(m_topk, window_begin[idx]);
+            free.push(idx);
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        for (auto const& node_counters: counters) {
+            Stats::decoded(node_counters.postings_decoded);
+            Stats::scored(node_counters.postings_scored);
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    /// Scores the postings of `cursor` in `[begin, end)`, leaving it at the first posting not
+    /// less than `end`, and counts them in `counters`.
+    template <typename Cursor, typename Acc>
+    static void score_window(
+        Cursor& cursor, uint64_t begin, uint64_t end, Acc& accumulator, query_counters& counters)
+    {
+        if constexpr (has_block_interface_v<typename Cursor::enum_type>) {
+            while (cursor.docs_enum.docid() < end) {
+                auto docids = cursor.docs_enum.block_docids();
+                auto freqs = cursor.docs_enum.block_freqs();
+                std::size_t size = docids.size();
+                std::size_t idx = 0;
+                for (; idx < size && docids[idx] < end; ++idx) {
+                    accumulator.accumulate(
+                        docids[idx] - begin, cursor.scorer(docids[idx], freqs[idx]));
+                }
+                counters.postings_decoded += idx;
+                counters.postings_scored += idx;
+                if (idx < size) {
+                    cursor.docs_enum.move(cursor.docs_enum.position() + idx);
+                    return;
+                }
+                cursor.docs_enum.next_block();
+            }
+        } else {
+            while (cursor.docs_enum.docid() < end) {
+                auto docid = cursor.docs_enum.docid();
+                accumulator.accumulate(
+                    docid - begin, cursor.scorer(docid, cursor.docs_enum.freq()));
+                cursor.docs_enum.next();
+                counters.postings_decoded += 1;
+                counters.postings_scored += 1;
+            }
+        }
+    }
+
+    topk_queue& m_topk;
+    std::size_t m_window_size;
+};
+
+using pipelined_taat_query = basic_pipelined_taat_query<>;
+
+}  // namespace pisa
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "bit_vector.hpp"
+#include "query/docid_range.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
+#include "util/util.hpp"
 
 namespace pisa {
 
@@ -23,6 +26,27 @@ struct range_query {
         process_range(cursors, max_docid);
     }
 
+    /// Processes only the ranges of `range_size` documents set in `live_ranges`, such as computed
+    /// once per query by `wand_data_range::compute_live_blocks`.
+    template <typename CursorRange>
+    void operator()(
+        CursorRange&& cursors, uint64_t max_docid, size_t range_size, bit_vector const& live_ranges)
+    {
+        m_topk.clear();
+        if (cursors.empty()) {
+            return;
+        }
+
+        size_t num_ranges = std::min<size_t>(ceil_div(max_docid, range_size), live_ranges.size());
+        for (size_t range = 0; range < num_ranges; ++range) {
+            if (not live_ranges[range]) {
+                continue;
+            }
+            seek_cursors(cursors, range * range_size);
+            process_range(cursors, std::min<uint64_t>((range + 1) * range_size, max_docid));
+        }
+    }
+
     std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
 
     template <typename CursorRange>
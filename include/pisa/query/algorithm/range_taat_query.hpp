@@ -1,7 +1,10 @@
 #pragma once
 
+#include "bit_vector.hpp"
+#include "query/docid_range.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
+#include "util/util.hpp"
 
 namespace pisa {
 
@@ -24,6 +27,34 @@ struct range_taat_query {
         process_range(cursors, max_docid, accumulator);
     }
 
+    /// Processes only the ranges of `range_size` documents set in `live_ranges`, such as computed
+    /// once per query by `wand_data_range::compute_live_blocks`.
+    template <typename CursorRange, typename Acc>
+    void operator()(
+        CursorRange&& cursors,
+        uint64_t max_docid,
+        size_t range_size,
+        bit_vector const& live_ranges,
+        Acc&& accumulator)
+    {
+        if (cursors.empty()) {
+            return;
+        }
+
+        accumulator.init();
+
+        size_t num_ranges = std::min<size_t>(ceil_div(max_docid, range_size), live_ranges.size());
+        for (size_t range = 0; range < num_ranges; ++range) {
+            if (not live_ranges[range]) {
+                continue;
+            }
+            uint64_t begin = range * range_size;
+            seek_cursors(cursors, begin);
+            process_range(
+                cursors, std::min<uint64_t>(begin + range_size, max_docid), accumulator);
+        }
+    }
+
     std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
 
     template <typename CursorRange, typename Acc>
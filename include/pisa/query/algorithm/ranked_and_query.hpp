@@ -1,13 +1,17 @@
 #pragma once
 
+#include "intersection_cache.hpp"
 #include "query/queries.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 
 namespace pisa {
 
-struct ranked_and_query {
-    ranked_and_query(topk_queue& topk) : m_topk(topk) {}
+/// Ranked conjunction, counting its work with the stats policy `Stats`.
+template <typename Stats = default_query_stats>
+struct basic_ranked_and_query {
+    basic_ranked_and_query(topk_queue& topk) : m_topk(topk) {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -32,6 +36,7 @@ struct ranked_and_query {
         while (candidate < max_docid) {
             for (; i < ordered_cursors.size(); ++i) {
                 ordered_cursors[i]->docs_enum.next_geq(candidate);
+                Stats::decoded();
                 if (ordered_cursors[i]->docs_enum.docid() != candidate) {
                     candidate = ordered_cursors[i]->docs_enum.docid();
                     i = 0;
@@ -45,15 +50,58 @@ struct ranked_and_query {
                     score += ordered_cursors[i]->scorer(
                         ordered_cursors[i]->docs_enum.docid(), ordered_cursors[i]->docs_enum.freq());
                 }
+                Stats::scored(ordered_cursors.size());
 
-                m_topk.insert(score, ordered_cursors[0]->docs_enum.docid());
+                Stats::insert(m_topk, score, ordered_cursors[0]->docs_enum.docid());
                 ordered_cursors[0]->docs_enum.next();
+                Stats::decoded();
                 candidate = ordered_cursors[0]->docs_enum.docid();
                 i = 1;
             }
         }
     }
 
+    /// Processes a query whose two terms are replaced by the precomputed intersection `pair`,
+    /// which drives the traversal of the cursors of the remaining terms.
+    template <typename CursorRange>
+    void operator()(intersection_cursor pair, CursorRange&& cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+
+        std::vector<Cursor*> ordered_cursors;
+        ordered_cursors.reserve(cursors.size());
+        for (auto& en: cursors) {
+            ordered_cursors.push_back(&en);
+        }
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->docs_enum.size() < rhs->docs_enum.size();
+        });
+
+        uint64_t candidate = pair.docid();
+        while (candidate < max_docid) {
+            size_t i = 0;
+            for (; i < ordered_cursors.size(); ++i) {
+                ordered_cursors[i]->docs_enum.next_geq(candidate);
+                Stats::decoded();
+                if (ordered_cursors[i]->docs_enum.docid() != candidate) {
+                    break;
+                }
+            }
+            if (i == ordered_cursors.size()) {
+                float score = pair.score();
+                for (auto* cursor: ordered_cursors) {
+                    score += cursor->scorer(cursor->docs_enum.docid(), cursor->docs_enum.freq());
+                }
+                Stats::scored(ordered_cursors.size());
+                Stats::insert(m_topk, score, candidate);
+                pair.next();
+            } else {
+                pair.next_geq(ordered_cursors[i]->docs_enum.docid());
+            }
+            candidate = pair.docid();
+        }
+    }
+
     std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
 
     topk_queue& get_topk() { return m_topk; }
@@ -62,4 +110,6 @@ struct ranked_and_query {
     topk_queue& m_topk;
 };
 
+using ranked_and_query = basic_ranked_and_query<>;
+
 }  // namespace pisa
@@ -1,14 +1,17 @@
 #pragma once
 
 #include "query/queries.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
 #include <string>
 #include <vector>
 
 namespace pisa {
 
-struct ranked_or_query {
-    ranked_or_query(topk_queue& topk) : m_topk(topk) {}
+/// Ranked disjunction, counting its work with the stats policy `Stats`.
+template <typename Stats = default_query_stats>
+struct basic_ranked_or_query {
+    basic_ranked_or_query(topk_queue& topk) : m_topk(topk) {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -28,14 +31,16 @@ struct ranked_or_query {
                 if (cursors[i].docs_enum.docid() == cur_doc) {
                     score +=
                         cursors[i].scorer(cursors[i].docs_enum.docid(), cursors[i].docs_enum.freq());
+                    Stats::scored();
                     cursors[i].docs_enum.next();
+                    Stats::decoded();
                 }
                 if (cursors[i].docs_enum.docid() < next_doc) {
                     next_doc = cursors[i].docs_enum.docid();
                 }
             }
 
-            m_topk.insert(score, cur_doc);
+            Stats::insert(m_topk, score, cur_doc);
             cur_doc = next_doc;
         }
     }
@@ -46,4 +51,6 @@ struct ranked_or_query {
     topk_queue& m_topk;
 };
 
+using ranked_or_query = basic_ranked_or_query<>;
+
 }  // namespace pisa
@@ -1,18 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 #include "query/queries.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
 #include "util/intrinsics.hpp"
 
 #include "accumulator/simple_accumulator.hpp"
+#include "cursor/cursor.hpp"
+#include "scorer/index_scorer.hpp"
 
 #include "topk_queue.hpp"
 
 namespace pisa {
 
-class ranked_or_taat_query {
+/// Term-at-a-time ranked disjunction, counting its work with the stats policy `Stats`.
+template <typename Stats = default_query_stats>
+class basic_ranked_or_taat_query {
   public:
-    ranked_or_taat_query(topk_queue& topk) : m_topk(topk) {}
+    basic_ranked_or_taat_query(topk_queue& topk) : m_topk(topk) {}
 
     template <typename CursorRange, typename Acc>
     void operator()(CursorRange&& cursors, uint64_t max_docid, Acc&& accumulator)
@@ -24,11 +33,19 @@ class ranked_or_taat_query {
         accumulator.init();
 
         for (auto&& cursor: cursors) {
-            while (cursor.docs_enum.docid() < max_docid) {
-                accumulator.accumulate(
-                    cursor.docs_enum.docid(),
-                    cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq()));
-                cursor.docs_enum.next();
+            if constexpr (has_block_interface_v<typename Cursor::enum_type>) {
+                process_blocks(cursor, max_docid, accumulator);
+            } else if constexpr (has_bulk_freqs_v<typename Cursor::enum_type>) {
+                process_runs(cursor, max_docid, accumulator);
+            } else {
+                while (cursor.docs_enum.docid() < max_docid) {
+                    accumulator.accumulate(
+                        cursor.docs_enum.docid(),
+                        cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq()));
+                    cursor.docs_enum.next();
+                    Stats::decoded();
+                    Stats::scored();
+                }
             }
         }
         accumulator.aggregate(m_topk);
@@ -37,7 +54,64 @@ class ranked_or_taat_query {
     std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
 
   private:
+    /// Scores whole decoded blocks, leaving the cursor at the first posting not less
+    /// than `max_docid`.
+    template <typename Cursor, typename Acc>
+    void process_blocks(Cursor&& cursor, uint64_t max_docid, Acc&& accumulator)
+    {
+        while (cursor.docs_enum.docid() < max_docid) {
+            auto docids = cursor.docs_enum.block_docids();
+            auto freqs = cursor.docs_enum.block_freqs();
+            std::size_t size = docids.size();
+            std::size_t end = std::lower_bound(docids.begin(), docids.end(), max_docid)
+                - docids.begin();
+            m_scores.resize(std::max(m_scores.size(), end));
+            score_postings(
+                cursor.scorer,
+                docids.first(end),
+                freqs.first(end),
+                gsl::make_span(m_scores.data(), end));
+            std::size_t idx = 0;
+            for (; idx < end; ++idx) {
+                accumulator.accumulate(docids[idx], m_scores[idx]);
+            }
+            Stats::decoded(idx);
+            Stats::scored(idx);
+            if (idx < size) {
+                cursor.docs_enum.move(cursor.docs_enum.position() + idx);
+                return;
+            }
+            cursor.docs_enum.next_block();
+        }
+    }
+
+    /// Scores the postings in runs, decoding the frequencies of each run at once, leaving the
+    /// cursor at the first posting not less than `max_docid`.
+    template <typename Cursor, typename Acc>
+    void process_runs(Cursor&& cursor, uint64_t max_docid, Acc&& accumulator)
+    {
+        std::array<uint64_t, run_size> freqs{};
+        while (cursor.docs_enum.docid() < max_docid) {
+            auto size = std::min<std::size_t>(
+                run_size, cursor.docs_enum.size() - cursor.docs_enum.position());
+            cursor.docs_enum.freqs(gsl::make_span(freqs.data(), size));
+            std::size_t idx = 0;
+            for (; idx < size && cursor.docs_enum.docid() < max_docid; ++idx) {
+                accumulator.accumulate(
+                    cursor.docs_enum.docid(), cursor.scorer(cursor.docs_enum.docid(), freqs[idx]));
+                cursor.docs_enum.next();
+            }
+            Stats::decoded(idx);
+            Stats::scored(idx);
+        }
+    }
+
+    static constexpr std::size_t run_size = 128;
+
     topk_queue& m_topk;
+    std::vector<float> m_scores;
 };
 
+using ranked_or_taat_query = basic_ranked_or_taat_query<>;
+
 };  // namespace pisa
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "index_tiers.hpp"
+#include "query/algorithm/wand_query.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Processes a query on a two-tier index, described by `index_tiers`, with WAND.
+///
+/// The query is first processed on the first tier alone, which yields partial scores. The
+/// results are completed with their second-tier postings, found with `next_geq_many`, and kept if no
+/// other document can outscore them: any other document has a partial score of at most the k-th
+/// partial score, and at most the sum of the second-tier maximum scores of the terms on top of
+/// it. Otherwise, the query is processed again on the lists of both tiers together, starting from
+/// the k-th completed score, so the results are always exact.
+class tiered_query {
+  public:
+    explicit tiered_query(topk_queue& topk) : m_topk(topk) {}
+
+    template <typename Index, typename Scorer>
+    void operator()(
+        Index const& first_tier,
+        Index const& second_tier,
+        index_tiers const& tiers,
+        Scorer const& scorer,
+        Query const& query)
+    {
+        using cursor_type = max_scored_cursor<Index, weighted_term_scorer_type_t<Scorer>>;
+        m_used_second_tier = false;
+        auto initial_threshold = m_topk.threshold();
+        auto term_weights = query_weights(query);
+
+        float second_tier_bound = 0;
+        auto first_cursors = [&]() {
+            std::vector<cursor_type> cursors;
+            for (auto [term, weight]: term_weights) {
+                float q_weight = weight;
+                cursors.push_back(cursor_type{
+                    {first_tier[term], q_weight, make_weighted_term_scorer(scorer, term, q_weight)},
+                    q_weight * tiers.first_max_score(term)});
+            }
+            return cursors;
+        };
+        for (auto [term, weight]: term_weights) {
+            second_tier_bound += weight * tiers.second_max_score(term);
+        }
+
+        wand_query wand_q(m_topk);
+        wand_q(first_cursors(), first_tier.num_docs());
+        m_topk.finalize();
+        if (second_tier_bound == 0) {
+            return;
+        }
+
+        auto results = m_topk.topk();
+        bool full = results.size() == m_topk.size();
+        float partial_kth = full ? results.back().first : 0.0F;
+        std::sort(results.begin(), results.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.second < rhs.second;
+        });
+        std::vector<uint64_t> docids(results.size());
+        std::transform(results.begin(), results.end(), docids.begin(), [](auto const& result) {
+            return result.second;
+        });
+        for (auto [term, weight]: term_weights) {
+            if (tiers.second_term(term) == index_tiers::no_term) {
+                continue;
+            }
+            auto list = second_tier[tiers.second_term(term)];
+            auto term_scorer = make_weighted_term_scorer(scorer, term, weight);
+            next_geq_many(list, gsl::make_span(docids), [&](std::size_t i, uint64_t freq) {
+                results[i].first += term_scorer(docids[i], freq);
+            });
+        }
+        std::sort(results.begin(), results.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.first > rhs.first;
+        });
+
+        m_topk.clear();
+        if (full && results.back().first >= partial_kth + second_tier_bound) {
+            m_topk.set_threshold(initial_threshold);
+            for (auto [score, docid]: results) {
+                m_topk.insert(score, docid);
+            }
+            m_topk.finalize();
+            return;
+        }
+
+        m_used_second_tier = true;
+        m_topk.set_threshold(full ? std::max(initial_threshold, results.back().first)
+                                  : initial_threshold);
+        auto cursors = first_cursors();
+        for (auto [term, weight]: term_weights) {
+            if (tiers.second_term(term) == index_tiers::no_term) {
+                continue;
+            }
+            float q_weight = weight;
+            cursors.push_back(cursor_type{
+                {second_tier[tiers.second_term(term)],
+                 q_weight,
+                 make_weighted_term_scorer(scorer, term, q_weight)},
+                q_weight * tiers.second_max_score(term)});
+        }
+        wand_q(cursors, first_tier.num_docs());
+        m_topk.finalize();
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+    /// Returns whether the last query had to be processed on the second tier.
+    [[nodiscard]] auto used_second_tier() const noexcept -> bool { return m_used_second_tier; }
+
+  private:
+    topk_queue& m_topk;
+    bool m_used_second_tier = false;
+};
+
+}  // namespace pisa
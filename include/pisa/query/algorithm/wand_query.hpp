@@ -1,17 +1,40 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
+#include "cursor/cursor.hpp"
+#include "pair_bounds.hpp"
 #include "query/queries.hpp"
+#include "query/query_stats.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
 
-struct wand_query {
-    wand_query(topk_queue& topk) : m_topk(topk) {}
+/// WAND, counting its work with the stats policy `Stats`.
+template <typename Stats = default_query_stats>
+struct basic_wand_query {
+    basic_wand_query(topk_queue& topk) : m_topk(topk) {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        process(cursors, max_docid, nullptr);
+    }
+
+    /// Bounds the lists before the pivot with the bounds of the term pairs of the query, pairing
+    /// each list with the one before it, which can select an earlier pivot.
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid, query_pair_bounds const& pairs)
+    {
+        process(cursors, max_docid, &pairs);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    template <typename CursorRange>
+    void process(CursorRange&& cursors, uint64_t max_docid, query_pair_bounds const* pairs)
     {
         using Cursor = typename std::decay_t<CursorRange>::value_type;
         if (cursors.empty())
@@ -23,24 +46,35 @@ struct wand_query {
             ordered_cursors.push_back(&en);
         }
 
-        auto sort_enums = [&]() {
-            // sort enumerators by increasing docid
-            std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
-                return lhs->docs_enum.docid() < rhs->docs_enum.docid();
-            });
+        auto cursor_index = [&](Cursor* cursor) -> std::size_t {
+            return cursor - &*std::begin(cursors);
         };
 
-        sort_enums();
+        // sort enumerators by increasing docid
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->docs_enum.docid() < rhs->docs_enum.docid();
+        });
         while (true) {
             // find pivot
             float upper_bound = 0;
+            float previous_upper_bound = 0;
             size_t pivot;
             bool found_pivot = false;
             for (pivot = 0; pivot < ordered_cursors.size(); ++pivot) {
                 if (ordered_cursors[pivot]->docs_enum.docid() >= max_docid) {
                     break;
                 }
-                upper_bound += ordered_cursors[pivot]->max_weight;
+                float bound = upper_bound + ordered_cursors[pivot]->max_weight;
+                if (pairs != nullptr && pivot > 0) {
+                    bound = std::min(
+                        bound,
+                        previous_upper_bound
+                            + pairs->pair(
+                                cursor_index(ordered_cursors[pivot - 1]),
+                                cursor_index(ordered_cursors[pivot])));
+                }
+                previous_upper_bound = upper_bound;
+                upper_bound = bound;
                 if (m_topk.would_enter(upper_bound)) {
                     found_pivot = true;
                     break;
@@ -56,23 +90,28 @@ struct wand_query {
             uint64_t pivot_id = ordered_cursors[pivot]->docs_enum.docid();
             if (pivot_id == ordered_cursors[0]->docs_enum.docid()) {
                 float score = 0;
+                size_t moved = 0;
                 for (Cursor* en: ordered_cursors) {
                     if (en->docs_enum.docid() != pivot_id) {
                         break;
                     }
                     score += en->scorer(en->docs_enum.docid(), en->docs_enum.freq());
+                    Stats::scored();
                     en->docs_enum.next();
+                    Stats::decoded();
+                    moved += 1;
                 }
 
-                m_topk.insert(score, pivot_id);
-                // resort by docid
-                sort_enums();
+                Stats::insert(m_topk, score, pivot_id);
+                reorder_moved_cursors(ordered_cursors, moved);
             } else {
                 // no match, move farthest list up to the pivot
                 uint64_t next_list = pivot;
                 for (; ordered_cursors[next_list]->docs_enum.docid() == pivot_id; --next_list) {
                 }
                 ordered_cursors[next_list]->docs_enum.next_geq(pivot_id);
+                Stats::decoded();
+                Stats::moved_pivot();
                 // bubble down the advanced list
                 for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
                     if (ordered_cursors[i]->docs_enum.docid()
@@ -86,10 +125,9 @@ struct wand_query {
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
-
-  private:
     topk_queue& m_topk;
 };
 
+using wand_query = basic_wand_query<>;
+
 }  // namespace pisa
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "cursor/cursor.hpp"
+#include "query/queries.hpp"
+#include "query/query_stats.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Term-at-a-time ranked disjunction over windows of the collection.
+///
+/// Unlike `ranked_or_taat_query`, which scores every list over the whole collection into an
+/// accumulator as large as the collection, all lists are scored for one window of docids before
+/// moving to the next, into an accumulator of a single window that is aggregated after each one.
+/// With a window that fits in the L2 cache, the accumulator writes no longer miss it.
+///
+/// The cursors must carry their `max_weight`, as made by `make_max_scored_cursors`: windows in
+/// which the maximum scores of the lists with postings in it sum to less than the threshold are
+/// skipped with `next_geq`, without scoring any posting.
+///
+/// The accumulator, e.g., `Simple_Accumulator` or `Lazy_Accumulator`, must be of `window_size`.
+/// Its work is counted with the stats policy `Stats`.
+template <typename Stats = default_query_stats>
+class basic_windowed_taat_query {
+  public:
+    /// 64Ki scores take 256 KiB, which fits in the L2 cache of most CPUs.
+    static constexpr std::size_t default_window_size = std::size_t(1) << 16U;
+
+    explicit basic_windowed_taat_query(
+        topk_queue& topk, std::size_t window_size = default_window_size)
+        : m_topk(topk), m_window_size(window_size)
+    {}
+
+    template <typename CursorRange, typename Acc>
+    void operator()(CursorRange&& cursors, uint64_t max_docid, Acc&& accumulator)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        m_skipped_windows = 0;
+        if (cursors.empty()) {
+            return;
+        }
+        // windows start from the first posting, which is not 0 in a restricted docid range
+        uint64_t first_docid = std::min_element(
+                                   cursors.begin(),
+                                   cursors.end(),
+                                   [](Cursor const& lhs, Cursor const& rhs) {
+                                       return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+                                   })
+                                   ->docs_enum.docid();
+        for (uint64_t begin = first_docid; begin < max_docid; begin += m_window_size) {
+            uint64_t end = std::min<uint64_t>(begin + m_window_size, max_docid);
+            float upper_bound = 0;
+            for (auto&& cursor: cursors) {
+                if (cursor.docs_enum.docid() < end) {
+                    upper_bound += cursor.max_weight;
+                }
+            }
+            if (upper_bound == 0) {
+                continue;
+            }
+            if (not m_topk.would_enter(upper_bound)) {
+                for (auto&& cursor: cursors) {
+                    cursor.docs_enum.next_geq(end);
+                    Stats::decoded();
+                }
+                m_skipped_windows += 1;
+                continue;
+            }
+            accumulator.init();
+            for (auto&& cursor: cursors) {
+                if constexpr (has_block_interface_v<typename Cursor::enum_type>) {
+                    process_blocks(cursor, begin, end, accumulator);
+                } else {
+                    while (cursor.docs_enum.docid() < end) {
+                        auto docid = cursor.docs_enum.docid();
+                        accumulator.accumulate(
+                            docid - begin, cursor.scorer(docid, cursor.docs_enum.freq()));
+                        cursor.docs_enum.next();
+                        Stats::decoded();
+                        Stats::scored();
+                    }
+                }
+            }
+            accumulator.aggregate(m_topk, begin);
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+    /// Returns the number of windows skipped by the last query.
+    [[nodiscard]] auto skipped_windows() const noexcept -> std::size_t
+    {
+        return m_skipped_windows;
+    }
+
+  private:
+    /// Scores the decoded blocks, from the current position, up to `end`, leaving the cursor at
+    /// the first posting not less than `end`.
+    template <typename Cursor, typename Acc>
+    static void process_blocks(Cursor&& cursor, uint64_t begin, uint64_t end, Acc&& accumulator)
+    {
+        while (cursor.docs_enum.docid() < end) {
+            auto docids = cursor.docs_enum.block_docids();
+            auto freqs = cursor.docs_enum.block_freqs();
+            std::size_t size = docids.size();
+            std::size_t idx = 0;
+            for (; idx < size && docids[idx] < end; ++idx) {
+                accumulator.accumulate(
+                    docids[idx] - begin, cursor.scorer(docids[idx], freqs[idx]));
+            }
+            Stats::decoded(idx);
+            Stats::scored(idx);
+            if (idx < size) {
+                cursor.docs_enum.move(cursor.docs_enum.position() + idx);
+                return;
+            }
+            cursor.docs_enum.next_block();
+        }
+    }
+
+    topk_queue& m_topk;
+    std::size_t m_window_size;
+    std::size_t m_skipped_windows = 0;
+};
+
+using windowed_taat_query = basic_windowed_taat_query<>;
+
+}  // namespace pisa
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+#include <mio/mmap.hpp>
+
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// A file of queries already mapped to term IDs, which is memory mapped and read without any
+/// parsing.
+///
+/// The file starts with the 8 bytes `PISAQRY1` and the number of queries `n`, followed by the
+/// `n + 1` offsets of the queries in 32-bit words from the end of the offsets, all 64-bit. Each
+/// query is a sequence of 32-bit words: the length of its ID in bytes (`0xFFFFFFFF` if it has
+/// none), its number of terms, and whether it has term weights, followed by the ID padded with
+/// zeros to a whole word, the term IDs, and the term weights as floats, if any.
+class binary_queries {
+  public:
+    static constexpr std::string_view magic = "PISAQRY1";
+
+    class query_view {
+      public:
+        [[nodiscard]] auto id() const -> std::optional<std::string_view>;
+        [[nodiscard]] auto terms() const -> gsl::span<term_id_type const>;
+        /// Empty if every term has weight 1.
+        [[nodiscard]] auto term_weights() const -> gsl::span<float const>;
+        [[nodiscard]] auto to_query() const -> Query;
+
+      private:
+        friend class binary_queries;
+        explicit query_view(uint32_t const* data) : m_data(data) {}
+        uint32_t const* m_data;
+    };
+
+    /// Throws `std::invalid_argument` if `filename` is not a binary query file.
+    explicit binary_queries(std::string const& filename);
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+    [[nodiscard]] auto operator[](std::size_t query) const -> query_view;
+    [[nodiscard]] auto to_queries() const -> std::vector<Query>;
+
+    /// Checks the magic bytes at the beginning of `filename`.
+    [[nodiscard]] static auto is_binary_query_file(std::string const& filename) -> bool;
+
+    static void write(std::ostream& os, gsl::span<Query const> queries);
+
+  private:
+    mio::mmap_source m_file;
+    std::size_t m_size = 0;
+    uint64_t const* m_offsets = nullptr;
+    uint32_t const* m_queries = nullptr;
+};
+
+}  // namespace pisa
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace pisa {
+
+/// A result of a query in a binary results file, which stores the results of a query set with
+/// no formatting, e.g., to be read by a feature pipeline as an array of records.
+///
+/// The file starts with the 8 bytes `PISARES1`, followed by one record per result, of three
+/// 32-bit words: the position of the query in the query set, the docid, and the score as a
+/// float. The results of a query are in rank order.
+struct binary_result {
+    static constexpr std::string_view magic = "PISARES1";
+
+    std::uint32_t query;
+    std::uint32_t docid;
+    float score;
+
+    [[nodiscard]] friend auto operator==(binary_result const& lhs, binary_result const& rhs)
+        -> bool
+    {
+        return lhs.query == rhs.query && lhs.docid == rhs.docid && lhs.score == rhs.score;
+    }
+};
+static_assert(sizeof(binary_result) == 12, "Binary results must be packed");
+
+/// Returns the records of `results`, pairs of scores and docids, of the query at position
+/// `query`, to be written after the magic bytes of a binary results file.
+template <typename Results>
+[[nodiscard]] auto binary_result_records(std::uint32_t query, Results const& results)
+    -> std::string
+{
+    std::string records(std::size(results) * sizeof(binary_result), '\0');
+    auto* out = records.data();
+    for (auto const& [score, docid]: results) {
+        binary_result record{query, static_cast<std::uint32_t>(docid), static_cast<float>(score)};
+        std::memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+    }
+    return records;
+}
+
+/// Reads all records of the binary results file `filename`. Throws `std::invalid_argument` if
+/// it is not one.
+[[nodiscard]] inline auto read_binary_results(std::string const& filename)
+    -> std::vector<binary_result>
+{
+    std::ifstream is(filename, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    if (bytes.compare(0, binary_result::magic.size(), binary_result::magic) != 0
+        || (bytes.size() - binary_result::magic.size()) % sizeof(binary_result) != 0) {
+        throw std::invalid_argument(fmt::format("{} is not a binary results file", filename));
+    }
+    std::vector<binary_result> results(
+        (bytes.size() - binary_result::magic.size()) / sizeof(binary_result));
+    std::memcpy(
+        results.data(),
+        bytes.data() + binary_result::magic.size(),
+        results.size() * sizeof(binary_result));
+    return results;
+}
+
+}  // namespace pisa
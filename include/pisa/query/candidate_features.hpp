@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "cursor/cursor.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+
+namespace pisa {
+
+/// The features of a candidate document for a reranker, with one entry per distinct query term,
+/// in the order of `query_freqs`, which is zero for terms that do not occur in the document.
+struct candidate_features {
+    uint64_t docid;
+    float score;
+    uint64_t doc_length;
+    std::vector<uint32_t> freqs;
+    std::vector<float> term_scores;
+};
+
+/// Collects the per-term features of the `candidates` of a query, e.g., its top-k results, as
+/// the second phase of a two-phase retrieval.
+///
+/// Candidates are visited in docid order, so that each list is traversed once, forward, with
+/// `next_geq_many`: a block is decoded at most once, and blocks that contain no candidate are
+/// skipped without being decoded. The features are returned in the order of the candidates.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto extract_candidate_features(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    std::vector<std::pair<float, uint64_t>> const& candidates) -> std::vector<candidate_features>
+{
+    auto term_freqs = query_freqs(query.terms);
+    std::vector<candidate_features> features;
+    features.reserve(candidates.size());
+    for (auto [score, docid]: candidates) {
+        features.push_back(candidate_features{
+            docid,
+            score,
+            wdata.doc_len(docid),
+            std::vector<uint32_t>(term_freqs.size(), 0),
+            std::vector<float>(term_freqs.size(), 0.0F)});
+    }
+
+    std::vector<std::size_t> order(candidates.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+        return candidates[lhs].second < candidates[rhs].second;
+    });
+    std::vector<uint64_t> docids(order.size());
+    std::transform(order.begin(), order.end(), docids.begin(), [&](auto idx) {
+        return candidates[idx].second;
+    });
+    for (std::size_t term_idx = 0; term_idx < term_freqs.size(); ++term_idx) {
+        auto term = term_freqs[term_idx].first;
+        auto list = index[term];
+        auto term_scorer = make_term_scorer(scorer, term);
+        next_geq_many(list, gsl::make_span(docids), [&](std::size_t i, uint64_t freq) {
+            auto idx = order[i];
+            features[idx].freqs[term_idx] = freq;
+            features[idx].term_scores[term_idx] = term_scorer(docids[i], freq);
+        });
+    }
+    return features;
+}
+
+}  // namespace pisa
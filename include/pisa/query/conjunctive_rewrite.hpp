@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cursor/block_max_scored_cursor.hpp"
+#include "deleted_documents.hpp"
+#include "query/algorithm/block_max_ranked_and_query.hpp"
+#include "query/docid_range.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Rewrites a disjunctive query into conjunctive subqueries of some of its terms, whose k-th
+/// scores quickly give the disjunctive pass a high initial threshold.
+///
+/// Scores are non-negative, so a document scores at least as much in the query as in any
+/// subquery: the k-th highest score of a subquery never exceeds that of the query, and any of
+/// them is a safe threshold. Subqueries are chosen with a cost model over the list sizes and the
+/// maximum scores of the terms, without touching the lists: among the subsets of the terms
+/// expected to have at least `k` documents in common, assuming terms occur independently, those
+/// with the highest summed maximum scores are chosen, as long as intersecting them costs a small
+/// fraction of the disjunction.
+class conjunctive_rewriter {
+  public:
+    struct parameters {
+        /// Maximum number of subqueries.
+        std::size_t max_subqueries = 2;
+        /// Number of terms, those with the highest maximum scores, whose subsets are considered.
+        std::size_t max_terms = 10;
+        /// Maximum ratio of the cost of a subquery, its number of terms times its shortest list,
+        /// to the number of postings of the query.
+        float max_cost_ratio = 0.2F;
+    };
+
+    conjunctive_rewriter() = default;
+    explicit conjunctive_rewriter(parameters params) : m_params(params) {}
+
+    /// Returns the conjunctive subqueries of `query` to process before its top `k`, best first,
+    /// if any, with the weights of the terms in `query`.
+    template <typename Index, typename Wand>
+    [[nodiscard]] auto
+    rewrite(Index const& index, Wand const& wdata, Query const& query, std::size_t k) const
+        -> std::vector<Query>
+    {
+        struct term_stats {
+            std::uint32_t term;
+            float weight;
+            float max_score;
+            std::uint64_t size;
+        };
+        std::vector<term_stats> terms;
+        std::uint64_t postings = 0;
+        for (auto const& [term, weight]: query_weights(query)) {
+            auto size = index[term].size();
+            terms.push_back({term, weight, weight * wdata.max_term_weight(term), size});
+            postings += size;
+        }
+        if (terms.size() < 3) {
+            // the only subquery would be the conjunction of the whole query, or a single list
+            return {};
+        }
+        std::sort(terms.begin(), terms.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.max_score > rhs.max_score;
+        });
+        terms.resize(std::min(terms.size(), m_params.max_terms));
+
+        struct candidate {
+            std::uint32_t mask;
+            float max_score;
+            double cost;
+        };
+        std::vector<candidate> candidates;
+        auto num_docs = static_cast<double>(index.num_docs());
+        auto max_cost = m_params.max_cost_ratio * static_cast<double>(postings);
+        auto subsets = std::uint32_t(1) << terms.size();
+        for (std::uint32_t mask = 3; mask < subsets; ++mask) {
+            auto count = static_cast<std::size_t>(__builtin_popcount(mask));
+            if (count < 2) {
+                continue;
+            }
+            double expected = num_docs;
+            std::uint64_t shortest = index.num_docs();
+            float max_score = 0;
+            for (std::size_t idx = 0; idx < terms.size(); ++idx) {
+                if ((mask >> idx) & 1U) {
+                    expected *= static_cast<double>(terms[idx].size) / num_docs;
+                    shortest = std::min(shortest, terms[idx].size);
+                    max_score += terms[idx].max_score;
+                }
+            }
+            double cost = static_cast<double>(count) * static_cast<double>(shortest);
+            if (expected >= static_cast<double>(k) && cost <= max_cost) {
+                candidates.push_back({mask, max_score, cost});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.max_score > rhs.max_score
+                || (lhs.max_score == rhs.max_score && lhs.cost < rhs.cost);
+        });
+
+        // A subset of a chosen subquery has more documents, each scoring less, and is skipped.
+        std::vector<std::uint32_t> chosen;
+        for (auto const& c: candidates) {
+            if (chosen.size() == m_params.max_subqueries) {
+                break;
+            }
+            if (std::none_of(chosen.begin(), chosen.end(), [&](auto mask) {
+                    return (c.mask & mask) == c.mask;
+                })) {
+                chosen.push_back(c.mask);
+            }
+        }
+        std::vector<Query> subqueries;
+        for (auto mask: chosen) {
+            Query subquery{query.id, {}, {}};
+            for (std::size_t idx = 0; idx < terms.size(); ++idx) {
+                if ((mask >> idx) & 1U) {
+                    subquery.terms.push_back(terms[idx].term);
+                    subquery.term_weights.push_back(terms[idx].weight);
+                }
+            }
+            subqueries.push_back(std::move(subquery));
+        }
+        return subqueries;
+    }
+
+  private:
+    parameters m_params{};
+};
+
+/// Processes `subqueries` with `block_max_ranked_and_query` within `docids`, each with the
+/// threshold reached by the ones before, and returns the highest k-th score of any of them, or
+/// zero if none has `k` results. Documents in `deleted` are not counted.
+template <typename Index, typename BlockMax, typename Scorer>
+[[nodiscard]] auto conjunctive_threshold(
+    Index const& index,
+    BlockMax const& block_max,
+    Scorer const& scorer,
+    std::vector<Query> const& subqueries,
+    std::size_t k,
+    deleted_documents const* deleted = nullptr,
+    docid_range const& docids = {}) -> float
+{
+    float threshold = 0;
+    for (auto const& subquery: subqueries) {
+        topk_queue topk(k, deleted);
+        topk.set_threshold(threshold);
+        block_max_ranked_and_query block_max_ranked_and_q(topk);
+        auto cursors = make_block_max_scored_cursors(index, block_max, scorer, subquery);
+        seek_cursors(cursors, docids.begin);
+        block_max_ranked_and_q(cursors, docids.end_within(index.num_docs()));
+        topk.finalize();
+        if (topk.topk().size() == k) {
+            threshold = std::max(threshold, topk.topk().back().first);
+        }
+    }
+    return threshold;
+}
+
+}  // namespace pisa
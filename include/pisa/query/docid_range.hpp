@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace pisa {
+
+/// A range `[begin, end)` of docids that queries are restricted to, such as the documents of
+/// the last days in an index ordered by date.
+///
+/// Query algorithms process the documents from the current positions of their cursors up to
+/// their `max_docid`, so restricting a query amounts to moving its cursors to `begin` with
+/// `seek_cursors` and passing `end(num_docs)` as `max_docid`. Blocks of postings before the
+/// range are skipped without being decoded, and so are the block-max data before it, which
+/// enumerators then skip on their first move; a query thus costs in proportion to the postings
+/// in the range rather than in the lists.
+struct docid_range {
+    uint64_t begin = 0;
+    uint64_t end = std::numeric_limits<uint64_t>::max();
+
+    /// Returns the end of the range in a collection of `num_docs` documents.
+    [[nodiscard]] auto end_within(uint64_t num_docs) const noexcept -> uint64_t
+    {
+        return std::min(end, num_docs);
+    }
+
+    /// Returns whether the range is the whole collection.
+    [[nodiscard]] auto is_full() const noexcept -> bool
+    {
+        return begin == 0 && end == std::numeric_limits<uint64_t>::max();
+    }
+};
+
+/// Detects cursors that wrap their enumerator as `docs_enum`, as opposed to bare enumerators.
+template <typename Cursor, typename = void>
+struct has_docs_enum: std::false_type {
+};
+
+template <typename Cursor>
+struct has_docs_enum<Cursor, std::void_t<decltype(std::declval<Cursor&>().docs_enum)>>
+    : std::true_type {
+};
+
+/// Moves every cursor, or bare enumerator, of `cursors` to its first docid not less than `begin`.
+template <typename CursorRange>
+void seek_cursors(CursorRange&& cursors, uint64_t begin)
+{
+    if (begin == 0) {
+        return;
+    }
+    for (auto&& cursor: cursors) {
+        if constexpr (has_docs_enum<std::decay_t<decltype(cursor)>>::value) {
+            cursor.docs_enum.next_geq(begin);
+        } else {
+            cursor.next_geq(begin);
+        }
+    }
+}
+
+}  // namespace pisa
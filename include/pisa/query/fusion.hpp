@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// Ways of fusing the rankings of the variants of a query into one.
+enum class fusion_method {
+    /// Reciprocal rank fusion: a document scores `1 / (rrf_k + rank)` in each ranking, with
+    /// ranks starting at 1.
+    rrf,
+    /// The sum of the scores of a document in each ranking.
+    combsum,
+    /// CombSUM multiplied by the number of rankings containing the document.
+    combmnz,
+};
+
+[[nodiscard]] inline auto fusion_method_from_name(std::string_view name)
+    -> std::optional<fusion_method>
+{
+    if (name == "rrf") {
+        return fusion_method::rrf;
+    }
+    if (name == "combsum") {
+        return fusion_method::combsum;
+    }
+    if (name == "combmnz") {
+        return fusion_method::combmnz;
+    }
+    return std::nullopt;
+}
+
+/// The constant of reciprocal rank fusion commonly used, which damps the weight of top ranks.
+constexpr float default_rrf_k = 60.0F;
+
+/// Returns the top `k` of the fusion of `rankings`, each sorted by decreasing score as returned
+/// by `topk_queue::topk`, sorted by decreasing fused score and then by docid.
+///
+/// The result is exactly that of fusing the given rankings, so fusing the top-k of every
+/// variant, as computed by any safe algorithm, is the same as fusing their exhaustive top-k.
+[[nodiscard]] inline auto fuse_rankings(
+    gsl::span<std::vector<std::pair<float, uint64_t>> const> rankings,
+    fusion_method method,
+    uint64_t k,
+    float rrf_k = default_rrf_k) -> std::vector<std::pair<float, uint64_t>>
+{
+    struct fused {
+        float score = 0;
+        uint32_t count = 0;
+    };
+    std::unordered_map<uint64_t, fused> scores;
+    for (auto const& ranking: rankings) {
+        for (std::size_t rank = 0; rank < ranking.size(); ++rank) {
+            auto& entry = scores[ranking[rank].second];
+            entry.score += method == fusion_method::rrf
+                ? 1.0F / (rrf_k + static_cast<float>(rank + 1))
+                : ranking[rank].first;
+            entry.count += 1;
+        }
+    }
+    std::vector<std::pair<float, uint64_t>> results;
+    results.reserve(scores.size());
+    for (auto const& [docid, entry]: scores) {
+        results.emplace_back(
+            method == fusion_method::combmnz ? entry.score * static_cast<float>(entry.count)
+                                             : entry.score,
+            docid);
+    }
+    auto order = [](auto const& lhs, auto const& rhs) {
+        return lhs.first > rhs.first or (lhs.first == rhs.first and lhs.second < rhs.second);
+    };
+    auto top = std::min<std::size_t>(k, results.size());
+    std::partial_sort(results.begin(), results.begin() + top, results.end(), order);
+    results.resize(top);
+    return results;
+}
+
+/// Groups the positions of `queries` by query ID, in order of first appearance, so that the
+/// variants of a query share its ID. Queries without an ID are groups of their own.
+[[nodiscard]] inline auto group_variants(gsl::span<Query const> queries)
+    -> std::vector<std::vector<std::size_t>>
+{
+    std::vector<std::vector<std::size_t>> groups;
+    std::unordered_map<std::string, std::size_t> group_of;
+    for (std::size_t idx = 0; idx < queries.size(); ++idx) {
+        auto const& id = queries[idx].id;
+        if (not id) {
+            groups.push_back({idx});
+            continue;
+        }
+        auto [pos, inserted] = group_of.emplace(*id, groups.size());
+        if (inserted) {
+            groups.emplace_back();
+        }
+        groups[pos->second].push_back(idx);
+    }
+    return groups;
+}
+
+}  // namespace pisa
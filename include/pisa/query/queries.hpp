@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "query/term_processor.hpp"
+#include "util/query_arena.hpp"
 
 namespace pisa {
 
@@ -15,22 +16,32 @@ using term_id_type = uint32_t;
 using term_id_vec = std::vector<term_id_type>;
 using term_freq_pair = std::pair<uint64_t, uint64_t>;
 using term_freq_vec = std::vector<term_freq_pair>;
+using term_weight_pair = std::pair<uint64_t, float>;
+using term_weight_vec = std::vector<term_weight_pair>;
 
+/// A query. `term_weights` is either empty, in which case every term has weight 1, or holds the
+/// weight of each term of `terms`.
 struct Query {
     std::optional<std::string> id;
     std::vector<term_id_type> terms;
     std::vector<float> term_weights;
 };
 
-[[nodiscard]] auto split_query_at_colon(std::string const& query_string)
+/// Splits a query into its optional ID, before the first colon, and its terms. The returned
+/// terms are a view of `query_string`, which must outlive them.
+[[nodiscard]] auto split_query_at_colon(std::string_view query_string)
     -> std::pair<std::optional<std::string>, std::string_view>;
 
-[[nodiscard]] auto parse_query_terms(std::string const& query_string, TermProcessor term_processor)
-    -> Query;
+/// Parses a query of terms, each of which can be followed by a weight, as in `term^0.5`. The `term_processor` is shared, and only read, so a single instance
+/// serves all queries, from any thread.
+[[nodiscard]] auto
+parse_query_terms(std::string_view query_string, TermProcessor const& term_processor) -> Query;
 
-[[nodiscard]] auto parse_query_ids(std::string const& query_string) -> Query;
+/// Parses a query of term IDs, in place, without splitting it into strings. As with terms, an ID
+/// can be followed by a weight, as in `12^0.5`.
+[[nodiscard]] auto parse_query_ids(std::string_view query_string) -> Query;
 
-[[nodiscard]] std::function<void(const std::string)> resolve_query_parser(
+[[nodiscard]] std::function<void(std::string const&)> resolve_query_parser(
     std::vector<Query>& queries,
     std::optional<std::string> const& terms_file,
     std::optional<std::string> const& stopwords_filename,
@@ -42,4 +53,16 @@ void remove_duplicate_terms(term_id_vec& terms);
 
 term_freq_vec query_freqs(term_id_vec terms);
 
+/// Same as `query_freqs`, but allocated from `arena`, without copying `terms` to the heap.
+[[nodiscard]] auto query_freqs(term_id_vec const& terms, query_arena& arena)
+    -> arena_vector<term_freq_pair>;
+
+/// Returns the distinct terms of `query`, in increasing order, along with their weights: the sum of
+/// the weights of their occurrences, which is their frequency in a query without `term_weights`.
+[[nodiscard]] auto query_weights(Query const& query) -> term_weight_vec;
+
+/// Same as `query_weights`, but allocated from `arena`.
+[[nodiscard]] auto query_weights(Query const& query, query_arena& arena)
+    -> arena_vector<term_weight_pair>;
+
 }  // namespace pisa
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace pisa {
+
+/// Bounds the work of a query, in scored postings, in time, or both.
+///
+/// Algorithms check the budget cooperatively: `start()` at the beginning of a query, then
+/// `consume(postings)` after each document they score, and they stop as soon as it returns
+/// false, with the results found so far. When stopping early, documents in later docid ranges
+/// are never considered, so a docid order that puts the most promising documents first, e.g.,
+/// by static rank, loses the least quality on a given budget. To keep checks cheap, the clock is
+/// read only every `clock_interval` documents.
+///
+/// A query can also stop once its top-k stabilizes, see `stop_when_stable`, which spends no
+/// budget on the long tail of documents that, e.g., on navigational queries over an index
+/// ordered by static rank, seldom enter the top-k.
+class query_budget {
+  public:
+    using clock = std::chrono::steady_clock;
+    static constexpr uint64_t clock_interval = 256;
+
+    /// An unlimited budget, which is never exhausted.
+    query_budget() = default;
+
+    query_budget(std::optional<uint64_t> postings, std::optional<std::chrono::microseconds> time)
+        : m_postings_limit(postings.value_or(std::numeric_limits<uint64_t>::max())), m_time(time)
+    {}
+
+    /// Starts counting the budget of a new query.
+    void start()
+    {
+        m_postings_scored = 0;
+        m_documents_scored = 0;
+        m_exhausted = false;
+        m_checkpoint = 0;
+        if (m_time) {
+            m_deadline = clock::now() + *m_time;
+        }
+    }
+
+    /// Records a document scored from `postings` postings, and returns whether the query can go
+    /// on.
+    bool consume(uint64_t postings)
+    {
+        m_postings_scored += postings;
+        m_documents_scored += 1;
+        if (m_postings_scored >= m_postings_limit) {
+            m_exhausted = true;
+        } else if (m_time && m_documents_scored % clock_interval == 0) {
+            m_exhausted = clock::now() >= m_deadline;
+        }
+        return not m_exhausted;
+    }
+
+    /// Also stops a query, unsafely, once its top-k threshold has grown by a fraction less than
+    /// `growth` over the last `window` documents scored, as checked by `consume` given the
+    /// threshold. The threshold must have risen above zero, i.e., the top-k must be full.
+    void stop_when_stable(uint64_t window, double growth)
+    {
+        m_stable_window = window;
+        m_stable_growth = growth;
+    }
+
+    /// Records a document scored from `postings` postings, after which the threshold of the
+    /// top-k is `threshold`, and returns whether the query can go on.
+    bool consume(uint64_t postings, double threshold)
+    {
+        if (not consume(postings)) {
+            return false;
+        }
+        if (m_stable_window > 0 && m_documents_scored % m_stable_window == 0) {
+            m_exhausted = threshold > 0 && threshold <= m_checkpoint * (1 + m_stable_growth);
+            m_checkpoint = threshold;
+        }
+        return not m_exhausted;
+    }
+
+    /// Returns whether the budget ran out since the last `start()`.
+    [[nodiscard]] auto is_exhausted() const noexcept -> bool { return m_exhausted; }
+
+    [[nodiscard]] auto is_unlimited() const noexcept -> bool
+    {
+        return m_postings_limit == std::numeric_limits<uint64_t>::max() && not m_time
+            && m_stable_window == 0;
+    }
+
+    /// Returns the number of postings scored since the last `start()`.
+    [[nodiscard]] auto postings_scored() const noexcept -> uint64_t { return m_postings_scored; }
+
+  private:
+    uint64_t m_postings_limit = std::numeric_limits<uint64_t>::max();
+    std::optional<std::chrono::microseconds> m_time{};
+    clock::time_point m_deadline{};
+    uint64_t m_postings_scored = 0;
+    uint64_t m_documents_scored = 0;
+    bool m_exhausted = false;
+    uint64_t m_stable_window = 0;
+    double m_stable_growth = 0;
+    double m_checkpoint = 0;
+};
+
+}  // namespace pisa
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Algorithms a `query_planner` can pick for a query.
+enum class planned_algorithm : std::size_t {
+    block_max_ranked_and,
+    block_max_maxscore,
+    block_max_wand,
+    ranked_or_taat,
+    long_maxscore,
+    impact_saat,
+};
+
+constexpr std::size_t planned_algorithm_count = 6;
+
+[[nodiscard]] constexpr auto planned_algorithm_name(planned_algorithm algorithm) noexcept
+    -> std::string_view
+{
+    constexpr std::array<std::string_view, planned_algorithm_count> names{
+        "block_max_ranked_and",
+        "block_max_maxscore",
+        "block_max_wand",
+        "ranked_or_taat",
+        "long_maxscore",
+        "impact_saat"};
+    return names[static_cast<std::size_t>(algorithm)];
+}
+
+/// Cheap statistics of a query, available before any posting is decoded.
+struct query_features {
+    std::size_t terms = 0;
+    std::uint64_t shortest_list = 0;
+    std::uint64_t postings = 0;
+    /// Sum of the weighted maximum scores of all terms.
+    float max_score = 0;
+    /// Smallest weighted maximum score of a term.
+    float min_term_max_score = 0;
+    /// Estimated threshold, e.g., the k-th score from a thresholds file, if known.
+    std::optional<float> threshold{};
+    /// Whether the lists of all terms are also stored in impact order, see `impact_index`.
+    bool impact_ordered = false;
+
+    /// Computes the features of `query` from the list sizes of `index` and the maximum term
+    /// weights of `wdata`.
+    template <typename Index, typename Wand>
+    [[nodiscard]] static auto
+    compute(Index const& index, Wand const& wdata, Query const& query, std::optional<float> threshold)
+        -> query_features
+    {
+        query_features features;
+        features.threshold = threshold;
+        features.shortest_list = std::numeric_limits<std::uint64_t>::max();
+        features.min_term_max_score = std::numeric_limits<float>::max();
+        for (auto const& [term, weight]: query_weights(query)) {
+            auto size = index[term].size();
+            auto term_max_score = weight * wdata.max_term_weight(term);
+            features.terms += 1;
+            features.shortest_list = std::min<std::uint64_t>(features.shortest_list, size);
+            features.postings += size;
+            features.max_score += term_max_score;
+            features.min_term_max_score = std::min(features.min_term_max_score, term_max_score);
+        }
+        if (features.terms == 0) {
+            features.shortest_list = 0;
+            features.min_term_max_score = 0;
+        }
+        return features;
+    }
+
+    /// Returns the highest score of a document missing at least one term.
+    [[nodiscard]] auto partial_max_score() const noexcept -> float
+    {
+        return max_score - min_term_max_score;
+    }
+};
+
+/// Picks an algorithm per query with a hand-tuned cost model over `query_features`.
+///
+/// Queries whose shortest list is much shorter than the others, or whose estimated threshold can
+/// only be reached by documents containing all terms, are processed conjunctive-first: results of
+/// `block_max_ranked_and` are kept if their k-th score is at least the highest score of a document
+/// missing a term, which makes them safe, and the disjunctive algorithm is run otherwise. Among
+/// disjunctive algorithms, queries with few postings are processed exhaustively by
+/// `ranked_or_taat`, long ones by `block_max_maxscore`, and the others by `block_max_wand`.
+/// Queries with many more terms, such as expansion queries, are processed by `long_maxscore`.
+/// Queries with very many postings are processed score-at-a-time by `impact_saat` if all their
+/// lists are also stored in impact order.
+///
+/// The parameters can be calibrated with the latencies and decoded blocks reported by `queries`
+/// and `profile_queries` for each algorithm.
+class query_planner {
+  public:
+    struct parameters {
+        /// Maximum ratio of the shortest list size to the average list size for which the
+        /// intersection is tried first.
+        float conjunctive_selectivity = 0.01F;
+        /// Maximum number of postings for which an exhaustive TAAT is cheaper than pruning.
+        std::uint64_t taat_postings = 4096;
+        /// Minimum number of terms from which MaxScore is preferred over WAND.
+        std::size_t maxscore_terms = 5;
+        /// Minimum number of terms from which the heap-based `long_maxscore` is preferred.
+        std::size_t long_query_terms = 32;
+        /// Minimum number of postings from which an impact-ordered SAAT is preferred, if all
+        /// lists of the query are stored in impact order.
+        std::uint64_t saat_postings = 1U << 20U;
+    };
+
+    query_planner() = default;
+    explicit query_planner(parameters params) : m_params(params) {}
+
+    /// Returns whether the intersection is tried before the disjunctive algorithm.
+    [[nodiscard]] auto conjunctive_first(query_features const& features) const noexcept -> bool
+    {
+        if (features.terms < 2) {
+            return false;
+        }
+        if (features.threshold && *features.threshold > features.partial_max_score()) {
+            return true;
+        }
+        auto average_list = static_cast<float>(features.postings) / features.terms;
+        return features.shortest_list <= m_params.conjunctive_selectivity * average_list;
+    }
+
+    /// Returns the disjunctive algorithm for a query.
+    [[nodiscard]] auto disjunctive(query_features const& features) const noexcept
+        -> planned_algorithm
+    {
+        if (features.postings <= m_params.taat_postings) {
+            return planned_algorithm::ranked_or_taat;
+        }
+        if (features.impact_ordered && features.postings >= m_params.saat_postings) {
+            return planned_algorithm::impact_saat;
+        }
+        if (features.terms >= m_params.long_query_terms) {
+            return planned_algorithm::long_maxscore;
+        }
+        if (features.terms >= m_params.maxscore_terms) {
+            return planned_algorithm::block_max_maxscore;
+        }
+        return planned_algorithm::block_max_wand;
+    }
+
+    /// Processes a query with features `features` into `topk`, where `run(algorithm)` processes
+    /// it with `algorithm` into `topk`. Returns the algorithm whose results are in `topk`, which
+    /// is finalized.
+    template <typename Run>
+    auto execute(query_features const& features, topk_queue& topk, Run&& run) const
+        -> planned_algorithm
+    {
+        if (conjunctive_first(features)) {
+            auto initial_threshold = topk.threshold();
+            run(planned_algorithm::block_max_ranked_and);
+            topk.finalize();
+            if (is_safe_conjunction(features, topk)) {
+                return planned_algorithm::block_max_ranked_and;
+            }
+            topk.clear();
+            topk.set_threshold(initial_threshold);
+        }
+        auto algorithm = disjunctive(features);
+        run(algorithm);
+        topk.finalize();
+        return algorithm;
+    }
+
+  private:
+    /// Returns whether no document missing a term can enter the finalized `topk`.
+    [[nodiscard]] static auto
+    is_safe_conjunction(query_features const& features, topk_queue const& topk) -> bool
+    {
+        return topk.topk().size() == topk.size()
+            && topk.topk().back().first >= features.partial_max_score();
+    }
+
+    parameters m_params{};
+};
+
+}  // namespace pisa
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include "pisa_config.hpp"
+
+namespace pisa {
+
+/// Counts the work done by the query algorithms while processing queries.
+struct query_counters {
+    /// Postings the cursors were moved to, with `next`, `next_geq`, or whole decoded blocks.
+    uint64_t postings_decoded = 0;
+    /// Postings whose scores were computed.
+    uint64_t postings_scored = 0;
+    /// Blocks, or ranges of blocks, whose block-max scores let them be skipped.
+    uint64_t blocks_skipped = 0;
+    /// Lists moved to a WAND pivot, or made non-essential by MaxScore.
+    uint64_t pivot_moves = 0;
+    /// Times a document inserted in the top-k raised its threshold. Term-at-a-time algorithms,
+    /// which fill the top-k from their accumulators, do not count them.
+    uint64_t threshold_updates = 0;
+
+    void reset() { *this = query_counters{}; }
+
+    static void write_tsv_header(std::ostream& os)
+    {
+        os << "postings_decoded\tpostings_scored\tblocks_skipped\tpivot_moves\t"
+              "threshold_updates";
+    }
+
+    void write_tsv(std::ostream& os) const
+    {
+        os << postings_decoded << '\t' << postings_scored << '\t' << blocks_skipped << '\t'
+           << pivot_moves << '\t' << threshold_updates;
+    }
+
+    /// Adds the counters to a `stats_line`, which prints them as JSON.
+    template <typename StatsLine>
+    auto dump(StatsLine& line) const -> StatsLine&
+    {
+        return line("postings_decoded", postings_decoded)("postings_scored", postings_scored)(
+            "blocks_skipped", blocks_skipped)("pivot_moves", pivot_moves)(
+            "threshold_updates", threshold_updates);
+    }
+};
+
+/// Stats policy of the query algorithms that counts their work in `query_counters` of the
+/// calling thread, so that the algorithms that make up one query, e.g., the ranges of
+/// `range_query` or the tiers of `tiered_query`, add up to its counters.
+struct query_stats {
+    static constexpr bool enabled = true;
+
+    [[nodiscard]] static auto local() -> query_counters&
+    {
+        thread_local query_counters counters;
+        return counters;
+    }
+
+    static void decoded(uint64_t postings = 1) { local().postings_decoded += postings; }
+    static void scored(uint64_t postings = 1) { local().postings_scored += postings; }
+    static void skipped_blocks(uint64_t blocks = 1) { local().blocks_skipped += blocks; }
+    static void moved_pivot(uint64_t lists = 1) { local().pivot_moves += lists; }
+
+    /// Inserts a document in `topk`, counting whether it raised the threshold.
+    template <typename TopK, typename Score>
+    static auto insert(TopK& topk, Score score, uint64_t docid) -> bool
+    {
+        auto threshold = topk.threshold();
+        bool inserted = topk.insert(score, docid);
+        if (topk.threshold() != threshold) {
+            local().threshold_updates += 1;
+        }
+        return inserted;
+    }
+};
+
+/// Stats policy that counts nothing, with which the algorithms compile as if they were not
+/// instrumented.
+struct no_query_stats {
+    static constexpr bool enabled = false;
+
+    static void decoded(uint64_t = 1) {}
+    static void scored(uint64_t = 1) {}
+    static void skipped_blocks(uint64_t = 1) {}
+    static void moved_pivot(uint64_t = 1) {}
+
+    template <typename TopK, typename Score>
+    static auto insert(TopK& topk, Score score, uint64_t docid) -> bool
+    {
+        return topk.insert(score, docid);
+    }
+};
+
+/// The stats policy of the algorithms when none is given: `query_stats` when built with
+/// `PISA_ENABLE_QUERY_STATS`, and `no_query_stats` otherwise.
+#ifdef PISA_ENABLE_QUERY_STATS
+using default_query_stats = query_stats;
+#else
+using default_query_stats = no_query_stats;
+#endif
+
+}  // namespace pisa
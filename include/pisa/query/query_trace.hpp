@@ -0,0 +1,165 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "query/query_stats.hpp"
+
+namespace pisa {
+
+/// Something that happened while a traced query ran, stamped with the nanoseconds elapsed since
+/// the query started.
+struct trace_event {
+    enum class kind : std::uint8_t { docs_block = 0, freqs_block = 1, threshold = 2 };
+
+    kind type = kind::docs_block;
+    std::uint64_t nanoseconds = 0;
+    /// Term and block of the list whose block was decoded, for block events.
+    std::uint32_t term = 0;
+    std::uint32_t block = 0;
+    /// The new top-k threshold, for threshold events.
+    float threshold = 0;
+
+    [[nodiscard]] auto operator==(trace_event const& other) const -> bool
+    {
+        return type == other.type && nanoseconds == other.nanoseconds && term == other.term
+            && block == other.block && threshold == other.threshold;
+    }
+};
+
+/// The trace of one query: its terms, latency, and the blocks it decoded and the thresholds it
+/// reached, in order.
+struct query_trace {
+    std::optional<std::string> id;
+    std::vector<std::uint32_t> terms;
+    std::uint64_t nanoseconds = 0;
+    std::vector<trace_event> events;
+
+    [[nodiscard]] auto operator==(query_trace const& other) const -> bool
+    {
+        return id == other.id && terms == other.terms && nanoseconds == other.nanoseconds
+            && events == other.events;
+    }
+};
+
+/// How the traces of a file were recorded, so that they can be replayed the same way.
+struct trace_header {
+    std::string algorithm;
+    std::string encoding;
+    std::uint32_t k = 0;
+};
+
+/// Writes and reads files of query traces.
+///
+/// A file starts with the 8 bytes `PISATRC1`, then the header and the traces, with all integers
+/// as variable bytes (7 bits per byte, least significant first) and strings as their length
+/// followed by their bytes. The header is the algorithm, the encoding, and `k`, followed by the
+/// number of traces. A trace is 1 plus the length of its ID (0 if it has none) and the ID, its
+/// number of terms and the terms, its latency in nanoseconds, and its number of events and the
+/// events. An event is its kind, the nanoseconds since the previous one, and either the term and
+/// block decoded, or the threshold as 4 bytes.
+namespace query_trace_file {
+
+    constexpr std::string_view magic = "PISATRC1";
+
+    void
+    write(std::ostream& os, trace_header const& header, std::vector<query_trace> const& traces);
+
+    /// Throws `std::invalid_argument` if `is` does not hold a whole trace file.
+    [[nodiscard]] auto read(std::istream& is)
+        -> std::pair<trace_header, std::vector<query_trace>>;
+
+}  // namespace query_trace_file
+
+/// Records the trace of the query running on the calling thread, between `start` and `finish`.
+///
+/// Lists of indexes built with profiling report the blocks they decode with `decoded_block`,
+/// and algorithms run with the stats policy `traced_query_stats` report the thresholds their
+/// top-k reaches. Nothing is recorded while no trace is started, so profiled lists only pay for
+/// a check of a thread-local pointer outside of traced queries.
+class query_tracer {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    [[nodiscard]] static auto local() -> query_tracer&
+    {
+        thread_local query_tracer tracer;
+        return tracer;
+    }
+
+    /// Starts recording into `trace`, whose events are cleared.
+    void start(query_trace& trace)
+    {
+        m_trace = &trace;
+        m_trace->events.clear();
+        m_start = clock::now();
+    }
+
+    /// Stops recording, and sets the latency of the trace.
+    void finish()
+    {
+        if (m_trace != nullptr) {
+            m_trace->nanoseconds = elapsed();
+            m_trace = nullptr;
+        }
+    }
+
+    static void decoded_block(std::uint32_t term, std::uint32_t block, bool freqs)
+    {
+        auto& tracer = local();
+        if (tracer.m_trace != nullptr) {
+            trace_event event;
+            event.type = freqs ? trace_event::kind::freqs_block : trace_event::kind::docs_block;
+            event.nanoseconds = tracer.elapsed();
+            event.term = term;
+            event.block = block;
+            tracer.m_trace->events.push_back(event);
+        }
+    }
+
+    static void raised_threshold(float threshold)
+    {
+        auto& tracer = local();
+        if (tracer.m_trace != nullptr) {
+            trace_event event;
+            event.type = trace_event::kind::threshold;
+            event.nanoseconds = tracer.elapsed();
+            event.threshold = threshold;
+            tracer.m_trace->events.push_back(event);
+        }
+    }
+
+  private:
+    [[nodiscard]] auto elapsed() const -> std::uint64_t
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_start)
+            .count();
+    }
+
+    query_trace* m_trace = nullptr;
+    clock::time_point m_start;
+};
+
+/// Stats policy that counts the work of the algorithms like `query_stats`, and also records
+/// the thresholds their top-k reaches in the trace of the calling thread.
+struct traced_query_stats: query_stats {
+    template <typename TopK, typename Score>
+    static auto insert(TopK& topk, Score score, uint64_t docid) -> bool
+    {
+        auto threshold = topk.threshold();
+        bool inserted = query_stats::insert(topk, score, docid);
+        if (topk.threshold() != threshold) {
+            query_tracer::raised_threshold(topk.threshold());
+        }
+        return inserted;
+    }
+};
+
+}  // namespace pisa
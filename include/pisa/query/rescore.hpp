@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "cursor/cursor.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+
+namespace pisa {
+
+/// Returns the top `k` of `candidates`, the results of a cheaper first stage such as a query on
+/// a quantized index, rescored exactly with `scorer` on `index`, sorted by decreasing score and
+/// then by docid. The results are exact as long as the exact top `k` are among the candidates.
+///
+/// As with `extract_candidate_features`, candidates are visited in docid order, so that each
+/// list is traversed once, forward, with `next_geq_many`, and blocks that contain no candidate
+/// are skipped without being decoded.
+template <typename Index, typename Scorer>
+[[nodiscard]] auto rescore_candidates(
+    Index const& index,
+    Scorer const& scorer,
+    Query const& query,
+    std::vector<std::pair<float, uint64_t>> const& candidates,
+    uint64_t k) -> std::vector<std::pair<float, uint64_t>>
+{
+    std::vector<std::pair<float, uint64_t>> results;
+    results.reserve(candidates.size());
+    for (auto const& candidate: candidates) {
+        results.emplace_back(0.0F, candidate.second);
+    }
+    std::sort(results.begin(), results.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.second < rhs.second;
+    });
+    std::vector<uint64_t> docids(results.size());
+    std::transform(results.begin(), results.end(), docids.begin(), [](auto const& result) {
+        return result.second;
+    });
+    for (auto [term, weight]: query_weights(query)) {
+        auto list = index[term];
+        auto term_scorer = make_weighted_term_scorer(scorer, term, weight);
+        next_geq_many(list, gsl::make_span(docids), [&](std::size_t i, uint64_t freq) {
+            results[i].first += term_scorer(docids[i], freq);
+        });
+    }
+    auto order = [](auto const& lhs, auto const& rhs) {
+        return lhs.first > rhs.first or (lhs.first == rhs.first and lhs.second < rhs.second);
+    };
+    auto top = std::min<std::size_t>(k, results.size());
+    std::partial_sort(results.begin(), results.begin() + top, results.end(), order);
+    results.resize(top);
+    return results;
+}
+
+}  // namespace pisa
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// A bounded, thread-safe LRU cache of top-k query results.
+///
+/// Entries are spread over independently locked shards, each evicting its least recently used
+/// entry when full, so that concurrent lookups of different queries rarely contend.
+class result_cache {
+  public:
+    using result_type = std::vector<std::pair<float, uint64_t>>;
+
+    explicit result_cache(std::size_t capacity, std::size_t shard_count = 16)
+        : m_shards(std::max<std::size_t>(1, std::min(shard_count, capacity)))
+    {
+        for (std::size_t shard = 0; shard < m_shards.size(); ++shard) {
+            m_shards[shard].capacity = capacity / m_shards.size()
+                + static_cast<std::size_t>(shard < capacity % m_shards.size());
+        }
+    }
+
+    /// Normalizes a query into a cache key.
+    ///
+    /// Term order is irrelevant, but term multiplicity is kept, since scorers weight every
+    /// term by its query frequency; the key also includes everything else results depend on.
+    [[nodiscard]] static auto key(
+        Query const& query, uint64_t k, std::string_view algorithm, std::string_view scorer)
+        -> std::string
+    {
+        std::string key;
+        key.append(algorithm).push_back('\0');
+        key.append(scorer).push_back('\0');
+        append_bytes(key, k);
+        for (auto [term, weight]: query_weights(query)) {
+            append_bytes(key, term);
+            append_bytes(key, weight);
+        }
+        return key;
+    }
+
+    /// Returns cached results for `key`, marking them as most recently used.
+    [[nodiscard]] auto get(std::string const& key) -> std::optional<result_type>
+    {
+        auto& shard = shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto pos = shard.entries.find(key);
+        if (pos == shard.entries.end()) {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        shard.recency.splice(shard.recency.begin(), shard.recency, pos->second);
+        return pos->second->second;
+    }
+
+    /// Inserts or replaces the results for `key`, evicting the least recently used entry of
+    /// its shard if it is full.
+    void put(std::string const& key, result_type results)
+    {
+        auto& shard = shard_of(key);
+        if (shard.capacity == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (auto pos = shard.entries.find(key); pos != shard.entries.end()) {
+            pos->second->second = std::move(results);
+            shard.recency.splice(shard.recency.begin(), shard.recency, pos->second);
+            return;
+        }
+        if (shard.entries.size() == shard.capacity) {
+            shard.entries.erase(shard.recency.back().first);
+            shard.recency.pop_back();
+            m_evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        shard.recency.emplace_front(key, std::move(results));
+        shard.entries.emplace(key, shard.recency.begin());
+    }
+
+    /// Returns cached results for `key`, or computes them with `fn()` and caches them.
+    ///
+    /// The shard is not locked while computing, so concurrent misses of the same query may
+    /// all compute it.
+    template <typename Fn>
+    [[nodiscard]] auto get_or_compute(std::string const& key, Fn&& fn) -> result_type
+    {
+        if (auto cached = get(key); cached) {
+            return *std::move(cached);
+        }
+        result_type results = fn();
+        put(key, results);
+        return results;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        std::size_t size = 0;
+        for (auto& shard: m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+
+    [[nodiscard]] auto hits() const -> std::size_t { return m_hits.load(); }
+    [[nodiscard]] auto misses() const -> std::size_t { return m_misses.load(); }
+    [[nodiscard]] auto evictions() const -> std::size_t { return m_evictions.load(); }
+
+    [[nodiscard]] auto hit_rate() const -> double
+    {
+        auto lookups = hits() + misses();
+        return lookups > 0 ? static_cast<double>(hits()) / lookups : 0.0;
+    }
+
+  private:
+    using entry_list = std::list<std::pair<std::string, result_type>>;
+
+    struct shard_type {
+        std::size_t capacity = 0;
+        mutable std::mutex mutex;
+        entry_list recency;
+        std::unordered_map<std::string, entry_list::iterator> entries;
+    };
+
+    template <typename T>
+    static void append_bytes(std::string& key, T value)
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        key.append(bytes, sizeof(T));
+    }
+
+    [[nodiscard]] auto shard_of(std::string const& key) -> shard_type&
+    {
+        return m_shards[std::hash<std::string>{}(key) % m_shards.size()];
+    }
+
+    std::vector<shard_type> m_shards;
+    std::atomic_size_t m_hits{0};
+    std::atomic_size_t m_misses{0};
+    std::atomic_size_t m_evictions{0};
+};
+
+}  // namespace pisa
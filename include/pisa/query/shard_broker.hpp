@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+
+#include "erased_index.hpp"
+#include "global_statistics.hpp"
+#include "mappable/mapper.hpp"
+#include "payload_vector.hpp"
+#include "query/queries.hpp"
+#include "query/term_processor.hpp"
+#include "topk_queue.hpp"
+#include "type_safe.hpp"
+
+namespace pisa {
+
+struct shard_result {
+    float score;
+    Shard_Id shard;
+    uint64_t docid;
+};
+
+/// Runs a query on the given shards concurrently and merges their results.
+///
+/// `query_shard(shard, topk)` processes the query on one shard, pushing its results to
+/// `topk`. The queues of all shards share a threshold, raised as soon as any of them finds a
+/// higher k-th score: the global k-th score is never lower than the k-th score within a
+/// single shard, so this does not change the merged top-k.
+template <typename QueryShardFn>
+[[nodiscard]] auto sharded_query(
+    std::vector<Shard_Id> const& shards,
+    uint64_t k,
+    QueryShardFn&& query_shard,
+    Threshold threshold = 0) -> std::vector<shard_result>
+{
+    basic_shared_threshold<float> shared_threshold(threshold);
+    std::mutex merge_mutex;
+    std::vector<shard_result> results;
+    tbb::parallel_for(std::size_t(0), shards.size(), [&](std::size_t idx) {
+        auto shard = shards[idx];
+        topk_queue topk(k);
+        topk.share_threshold(&shared_threshold);
+        query_shard(shard, topk);
+        topk.finalize();
+
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        for (auto const& [score, docid]: topk.topk()) {
+            results.push_back({score, shard, docid});
+        }
+    });
+
+    auto by_score = [](auto const& lhs, auto const& rhs) {
+        if (lhs.score != rhs.score) {
+            return lhs.score > rhs.score;
+        }
+        return std::make_pair(lhs.shard, lhs.docid) < std::make_pair(rhs.shard, rhs.docid);
+    };
+    auto end = results.begin() + std::min<std::size_t>(k, results.size());
+    std::partial_sort(results.begin(), end, results.end(), by_score);
+    results.erase(end, results.end());
+    return results;
+}
+
+/// Runs a query on all of `shard_count` shards concurrently and merges their results.
+template <typename QueryShardFn>
+[[nodiscard]] auto sharded_query(
+    std::size_t shard_count, uint64_t k, QueryShardFn&& query_shard, Threshold threshold = 0)
+    -> std::vector<shard_result>
+{
+    std::vector<Shard_Id> shards;
+    shards.reserve(shard_count);
+    for (std::size_t shard = 0; shard < shard_count; ++shard) {
+        shards.push_back(Shard_Id(shard));
+    }
+    return sharded_query(shards, k, std::forward<QueryShardFn>(query_shard), threshold);
+}
+
+/// Maps the shards produced by `partition_fwd_index`, and runs queries against all of them.
+///
+/// The files of shard `i` are found by appending `.{i:03d}` to each of the basenames: the
+/// inverted index, its WAND data, and the term and document lexicons (as built with
+/// `lexicon build`). Since every shard has its own term IDs, queries are given as text and
+/// parsed separately for each shard. Optionally, the global statistics of each shard, as
+/// written by `compute_global_statistics`, are found the same way.
+template <typename Index, typename Wand>
+class shard_broker {
+  public:
+    struct shard {
+        mio::mmap_source index_source;
+        mio::mmap_source wand_source;
+        Index index;
+        Wand wdata;
+        TermProcessor term_processor;
+        std::shared_ptr<mio::mmap_source> documents_source;
+        Payload_Vector<> documents;
+        mio::mmap_source global_stats_source{};
+        std::optional<global_statistics> global_stats{};
+
+        template <typename QueryFn>
+        void query(Query const& query, topk_queue& topk, QueryFn&& query_fn) const
+        {
+            if (global_stats) {
+                query_fn(index, global_wand_data<Wand>(wdata, *global_stats), query, topk);
+            } else {
+                query_fn(index, wdata, query, topk);
+            }
+        }
+    };
+
+    shard_broker(
+        std::string const& index_basename,
+        std::string const& wand_basename,
+        std::string const& terms_basename,
+        std::string const& documents_basename,
+        std::size_t shard_count,
+        std::optional<std::string> const& stopwords_filename = std::nullopt,
+        std::optional<std::string> const& stemmer = std::nullopt,
+        std::optional<std::string> const& global_stats_basename = std::nullopt)
+    {
+        auto shard_file = [](std::string const& basename, std::size_t shard) {
+            return fmt::format("{}.{:03d}", basename, shard);
+        };
+        for (std::size_t shard_id = 0; shard_id < shard_count; ++shard_id) {
+            spdlog::info("Loading shard {}", shard_id);
+            auto documents_source = std::make_shared<mio::mmap_source>(
+                shard_file(documents_basename, shard_id).c_str());
+            auto documents = Payload_Vector<>::from(*documents_source);
+            auto s = std::unique_ptr<shard>(new shard{
+                mio::mmap_source(shard_file(index_basename, shard_id).c_str()),
+                mio::mmap_source(shard_file(wand_basename, shard_id).c_str()),
+                Index{},
+                Wand{},
+                TermProcessor(shard_file(terms_basename, shard_id), stopwords_filename, stemmer),
+                std::move(documents_source),
+                documents});
+            mapper::map(s->index, s->index_source);
+            mapper::map(s->wdata, s->wand_source, mapper::map_flags::warmup);
+            if (global_stats_basename) {
+                s->global_stats_source =
+                    mio::mmap_source(shard_file(*global_stats_basename, shard_id).c_str());
+                s->global_stats.emplace();
+                mapper::map(*s->global_stats, s->global_stats_source);
+            }
+            m_shards.push_back(std::move(s));
+        }
+    }
+
+    [[nodiscard]] auto shard_count() const noexcept -> std::size_t { return m_shards.size(); }
+
+    [[nodiscard]] auto operator[](Shard_Id shard_id) const -> shard const&
+    {
+        return *m_shards[shard_id.as_int()];
+    }
+
+    /// Runs `query_fn(index, wdata, query, topk)` on each shard, with `query` parsed with the
+    /// shard's own lexicon, and returns the merged top-k.
+    ///
+    /// If global statistics were loaded, `wdata` is the `global_wand_data` of the shard, so
+    /// that all shards score documents alike and their results are merged exactly.
+    template <typename QueryFn>
+    [[nodiscard]] auto
+    operator()(std::string const& query_string, uint64_t k, QueryFn&& query_fn) const
+        -> std::vector<shard_result>
+    {
+        return sharded_query(shard_count(), k, [&](Shard_Id shard_id, topk_queue& topk) {
+            auto const& s = (*this)[shard_id];
+            auto query = parse_query_terms(query_string, s.term_processor);
+            s.query(query, topk, query_fn);
+        });
+    }
+
+    /// Same as above, but only runs the query on `shards`, such as those chosen by a
+    /// `central_sample_index`.
+    template <typename QueryFn>
+    [[nodiscard]] auto operator()(
+        std::string const& query_string,
+        uint64_t k,
+        QueryFn&& query_fn,
+        std::vector<Shard_Id> const& shards) const -> std::vector<shard_result>
+    {
+        return sharded_query(shards, k, [&](Shard_Id shard_id, topk_queue& topk) {
+            auto const& s = (*this)[shard_id];
+            auto query = parse_query_terms(query_string, s.term_processor);
+            s.query(query, topk, query_fn);
+        });
+    }
+
+    /// Returns the title of a document found in one of the shards.
+    [[nodiscard]] auto document(shard_result const& result) const -> std::string_view
+    {
+        return (*this)[result.shard].documents[result.docid];
+    }
+
+  private:
+    std::vector<std::unique_ptr<shard>> m_shards;
+};
+
+}  // namespace pisa
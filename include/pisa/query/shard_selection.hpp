@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+
+#include "erased_index.hpp"
+#include "mappable/mapper.hpp"
+#include "query/queries.hpp"
+#include "query/term_processor.hpp"
+#include "topk_queue.hpp"
+#include "type_safe.hpp"
+
+namespace pisa {
+
+/// How `shard_selector` ranks the shards for a query, from the results of the query on the
+/// central sample index.
+struct shard_selection {
+    enum class method_type { redde, rank_s };
+
+    method_type method = method_type::redde;
+    /// Number of results retrieved from the central sample index.
+    uint64_t depth = 1000;
+    /// Maximum number of selected shards; 0 selects all shards with a positive score.
+    std::size_t max_shards = 0;
+    /// Rank-S: the vote of a result at rank `r`, counted from 1, is `rank_s_base^-r`.
+    float rank_s_base = 5.0;
+    /// Rank-S: shards whose votes do not add up to this threshold are not selected.
+    float rank_s_threshold = 0.0001;
+};
+
+[[nodiscard]] inline auto parse_shard_selection_method(std::string const& name)
+    -> shard_selection::method_type
+{
+    if (name == "redde") {
+        return shard_selection::method_type::redde;
+    }
+    if (name == "rank_s") {
+        return shard_selection::method_type::rank_s;
+    }
+    throw std::invalid_argument(fmt::format("Unknown shard selection method: {}", name));
+}
+
+/// Ranks the shards of a collection for a query, given the results of that query on a central
+/// sample index (CSI): an index of a sample of the documents of all shards, such as one built
+/// with `sample_inverted_index`, in which document `d` belongs to shard `document_shards[d]`.
+///
+/// ReDDE (Si and Callan, 2003) estimates the number of relevant documents of each shard: every
+/// sampled result stands for `shard size / sample size` documents of its shard. Rank-S
+/// (Kulkarni et al., 2012) lets every result vote for its shard with a weight decaying
+/// exponentially with its rank, so that it also decides how many shards to select.
+class shard_selector {
+  public:
+    /// `sampled[d]` tells whether document `d` is part of the sample; all documents count
+    /// towards the sizes of their shards.
+    shard_selector(std::vector<Shard_Id> document_shards, std::vector<bool> const& sampled)
+        : m_document_shards(std::move(document_shards))
+    {
+        if (sampled.size() != m_document_shards.size()) {
+            throw std::invalid_argument(fmt::format(
+                "Sample of {} documents does not match the {} documents of the shards",
+                sampled.size(),
+                m_document_shards.size()));
+        }
+        std::size_t shard_count = 0;
+        for (auto shard: m_document_shards) {
+            shard_count = std::max<std::size_t>(shard_count, shard.as_int() + 1);
+        }
+        std::vector<std::size_t> shard_sizes(shard_count, 0);
+        std::vector<std::size_t> sample_sizes(shard_count, 0);
+        for (std::size_t document = 0; document < m_document_shards.size(); ++document) {
+            auto shard = m_document_shards[document].as_int();
+            shard_sizes[shard] += 1;
+            sample_sizes[shard] += sampled[document] ? 1 : 0;
+        }
+        m_scale.resize(shard_count, 0.0);
+        for (std::size_t shard = 0; shard < shard_count; ++shard) {
+            if (sample_sizes[shard] > 0) {
+                m_scale[shard] = static_cast<float>(shard_sizes[shard]) / sample_sizes[shard];
+            }
+        }
+    }
+
+    [[nodiscard]] auto shard_count() const noexcept -> std::size_t { return m_scale.size(); }
+
+    /// Returns the shards to query, from the best to the worst, given the top results of the
+    /// query on the central sample index, sorted by decreasing score.
+    [[nodiscard]] auto select(
+        std::vector<topk_queue::entry_type> const& csi_results,
+        shard_selection const& selection) const -> std::vector<Shard_Id>
+    {
+        std::vector<float> scores(shard_count(), 0.0);
+        auto depth = std::min<std::size_t>(selection.depth, csi_results.size());
+        for (std::size_t rank = 0; rank < depth; ++rank) {
+            auto shard = m_document_shards.at(csi_results[rank].second).as_int();
+            if (selection.method == shard_selection::method_type::redde) {
+                scores[shard] += m_scale[shard];
+            } else {
+                scores[shard] += std::pow(selection.rank_s_base, -static_cast<float>(rank + 1));
+            }
+        }
+        float threshold = selection.method == shard_selection::method_type::rank_s
+            ? selection.rank_s_threshold
+            : 0.0F;
+
+        std::vector<Shard_Id> shards;
+        for (std::size_t shard = 0; shard < shard_count(); ++shard) {
+            if (scores[shard] > 0.0F && scores[shard] >= threshold) {
+                shards.push_back(Shard_Id(shard));
+            }
+        }
+        std::stable_sort(shards.begin(), shards.end(), [&](auto lhs, auto rhs) {
+            return scores[lhs.as_int()] > scores[rhs.as_int()];
+        });
+        if (selection.max_shards > 0 && shards.size() > selection.max_shards) {
+            shards.resize(selection.max_shards);
+        }
+        return shards;
+    }
+
+  private:
+    std::vector<Shard_Id> m_document_shards;
+    std::vector<float> m_scale;
+};
+
+/// Reads the shard of each document, as written by `partition_fwd_index` to `.shards`.
+[[nodiscard]] inline auto read_document_shards(std::string const& filename)
+    -> std::vector<Shard_Id>
+{
+    mio::mmap_source source(filename.c_str());
+    auto const* shards = reinterpret_cast<std::uint32_t const*>(source.data());
+    std::vector<Shard_Id> document_shards;
+    document_shards.reserve(source.size() / sizeof(std::uint32_t));
+    for (std::size_t document = 0; document < source.size() / sizeof(std::uint32_t); ++document) {
+        document_shards.push_back(Shard_Id(shards[document]));
+    }
+    return document_shards;
+}
+
+/// A central sample index, mapped along with its WAND data and term lexicon, which selects
+/// the shards to which a query is sent.
+///
+/// Its documents must be numbered as in the full collection, as in the indexes built by
+/// `sample_inverted_index`, so that the shard of each document is found in the `.shards`
+/// file written by `partition_fwd_index`. The sample is made of the documents with postings.
+template <typename Index, typename Wand>
+class central_sample_index {
+  public:
+    central_sample_index(
+        std::string const& index_filename,
+        std::string const& wand_filename,
+        std::string const& terms_filename,
+        std::string const& document_shards_filename,
+        std::optional<std::string> const& stopwords_filename = std::nullopt,
+        std::optional<std::string> const& stemmer = std::nullopt)
+        : m_index_source(index_filename.c_str()),
+          m_wand_source(wand_filename.c_str()),
+          m_term_processor(terms_filename, stopwords_filename, stemmer)
+    {
+        spdlog::info("Loading central sample index");
+        mapper::map(m_index, m_index_source);
+        mapper::map(m_wdata, m_wand_source, mapper::map_flags::warmup);
+
+        auto document_shards = read_document_shards(document_shards_filename);
+        if (document_shards.size() != m_index.num_docs()) {
+            throw std::invalid_argument(fmt::format(
+                "Central sample index has {} documents but {} has {}",
+                m_index.num_docs(),
+                document_shards_filename,
+                document_shards.size()));
+        }
+        std::vector<bool> sampled(m_index.num_docs(), false);
+        for (std::size_t term = 0; term < m_index.size(); ++term) {
+            for (auto list = m_index[term]; list.docid() < m_index.num_docs(); list.next()) {
+                sampled[list.docid()] = true;
+            }
+        }
+        m_selector.emplace(std::move(document_shards), sampled);
+    }
+
+    [[nodiscard]] auto selector() const -> shard_selector const& { return *m_selector; }
+
+    /// Runs `query_fn(index, wdata, query, topk)` on the central sample index, with `query`
+    /// parsed with its lexicon, and returns the shards selected from its results.
+    template <typename QueryFn>
+    [[nodiscard]] auto select(
+        std::string const& query_string,
+        shard_selection const& selection,
+        QueryFn&& query_fn) const -> std::vector<Shard_Id>
+    {
+        topk_queue topk(selection.depth);
+        query_fn(m_index, m_wdata, parse_query_terms(query_string, m_term_processor), topk);
+        topk.finalize();
+        return m_selector->select(topk.topk(), selection);
+    }
+
+  private:
+    mio::mmap_source m_index_source;
+    mio::mmap_source m_wand_source;
+    Index m_index;
+    Wand m_wdata;
+    TermProcessor m_term_processor;
+    std::optional<shard_selector> m_selector;
+};
+
+}  // namespace pisa
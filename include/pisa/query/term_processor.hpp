@@ -1,16 +1,23 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <unordered_set>
 
 #include <KrovetzStemmer/KrovetzStemmer.hpp>
 #include <Porter2.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 #include <mio/mmap.hpp>
 
+#include "front_coded_vector.hpp"
 #include "io.hpp"
+#include "lexicon_hash.hpp"
 #include "payload_vector.hpp"
+#include "term_cache.hpp"
 
 namespace pisa {
 
@@ -20,50 +27,102 @@ class TermProcessor {
   private:
     std::unordered_set<term_id_type> stopwords;
 
+    // Memoizes '_to_id' for raw tokens; shared by copies of the processor.
+    std::shared_ptr<term_cache<std::optional<term_id_type>>> memo;
+
     // Method implemented in constructor according to the specified stemmer.
     std::function<std::optional<term_id_type>(std::string)> _to_id;
 
-  public:
-    TermProcessor(
-        std::optional<std::string> const& terms_file,
-        std::optional<std::string> const& stopwords_filename,
-        std::optional<std::string> const& stemmer_type)
+    // Resolves terms of a `Payload_Vector` lexicon, with the perfect hash of the lexicon if it
+    // was built, and by binary search otherwise.
+    static auto
+    payload_vector_lookup(std::shared_ptr<mio::mmap_source> source, std::string const& terms_file)
+        -> std::function<std::optional<term_id_type>(std::string const&)>
     {
-        auto source = std::make_shared<mio::mmap_source>(terms_file->c_str());
         auto terms = Payload_Vector<>::from(*source);
-        auto to_id = [source = std::move(source),
-                      terms = std::move(terms)](auto str) -> std::optional<term_id_type> {
+        std::shared_ptr<mio::mmap_source> hash_source;
+        std::optional<Lexicon_Hash> hash;
+        if (auto hash_file = lexicon_hash_filename(terms_file);
+            boost::filesystem::exists(hash_file)) {
+            hash_source = std::make_shared<mio::mmap_source>(hash_file.c_str());
+            hash = Lexicon_Hash::from(*hash_source);
+            if (hash->size() != terms.size()) {
+                throw std::runtime_error(fmt::format(
+                    "Lexicon hash {} has {} terms but lexicon has {}",
+                    hash_file,
+                    hash->size(),
+                    terms.size()));
+            }
+        }
+        return [source = std::move(source),
+                terms = std::move(terms),
+                hash_source = std::move(hash_source),
+                hash](std::string const& str) -> std::optional<term_id_type> {
+            if (hash) {
+                return hash->find(terms, str);
+            }
             // Note: the lexicographical order of the terms matters.
             auto pos = std::lower_bound(terms.begin(), terms.end(), std::string_view(str));
-            if (*pos == std::string_view(str)) {
+            if (pos != terms.end() and *pos == std::string_view(str)) {
                 return std::distance(terms.begin(), pos);
             }
             return std::nullopt;
         };
+    }
 
-        // Implements '_to_id' method.
+  public:
+    /// Number of tokens whose term IDs are cached by each thread.
+    static constexpr std::size_t default_cache_size = 1U << 16U;
+
+    TermProcessor(
+        std::optional<std::string> const& terms_file,
+        std::optional<std::string> const& stopwords_filename,
+        std::optional<std::string> const& stemmer_type,
+        std::size_t cache_size = default_cache_size)
+        : memo(std::make_shared<term_cache<std::optional<term_id_type>>>(cache_size))
+    {
+        auto source = std::make_shared<mio::mmap_source>(terms_file->c_str());
+        std::function<std::optional<term_id_type>(std::string const&)> to_id;
+        if (Front_Coded_Vector::is_front_coded(*source)) {
+            to_id = [source, terms = Front_Coded_Vector::from(*source)](
+                        std::string const& str) -> std::optional<term_id_type> {
+                if (auto pos = terms.find(str); pos) {
+                    return *pos;
+                }
+                return std::nullopt;
+            };
+        } else {
+            to_id = payload_vector_lookup(source, *terms_file);
+        }
+
+        // Stemmers are stateful and expensive to construct, so each thread reuses its own.
+        std::function<std::optional<term_id_type>(std::string)> process;
         if (not stemmer_type) {
-            _to_id = [=](auto str) {
+            process = [=](auto str) {
                 boost::algorithm::to_lower(str);
                 return to_id(std::move(str));
             };
         } else if (*stemmer_type == "porter2") {
-            _to_id = [=](auto str) {
+            process = [=](auto str) {
                 boost::algorithm::to_lower(str);
-                porter2::Stemmer stemmer{};
-                return to_id(std::move(stemmer.stem(str)));
+                thread_local porter2::Stemmer stemmer{};
+                return to_id(stemmer.stem(str));
             };
         } else if (*stemmer_type == "krovetz") {
-            _to_id = [=](auto str) {
+            process = [=](auto str) {
                 boost::algorithm::to_lower(str);
-                stem::KrovetzStemmer stemmer{};
-                stemmer.kstem_stemmer(str);
+                thread_local stem::KrovetzStemmer stemmer{};
                 return to_id(stemmer.kstem_stemmer(std::move(str)));
             };
         } else {
             throw std::invalid_argument("Unknown stemmer");
         }
 
+        // Implements '_to_id' method.
+        _to_id = [memo = memo, process = std::move(process)](std::string const& str) {
+            return memo->get_or_compute(str, process);
+        };
+
         // Loads stopwords.
         if (stopwords_filename) {
             std::ifstream is(*stopwords_filename);
@@ -75,9 +134,25 @@ class TermProcessor {
         }
     }
 
-    std::optional<term_id_type> operator()(std::string token) { return _to_id(token); }
+    /// Returns the ID of `token`. The token is copied into a buffer kept by each thread, which
+    /// only allocates for tokens longer than any before it.
+    std::optional<term_id_type> operator()(std::string_view token) const
+    {
+        thread_local std::string buffer;
+        buffer.assign(token.data(), token.size());
+        return _to_id(buffer);
+    }
+
+    bool is_stopword(const term_id_type term) const
+    {
+        return stopwords.find(term) != stopwords.end();
+    }
 
-    bool is_stopword(const term_id_type term) { return stopwords.find(term) != stopwords.end(); }
+    /// Returns the cache of term IDs, e.g., to report its hit rate.
+    [[nodiscard]] auto cache() const -> term_cache<std::optional<term_id_type>> const&
+    {
+        return *memo;
+    }
 
     std::vector<term_id_type> get_stopwords()
     {
@@ -2,10 +2,17 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/trim.hpp>
+#include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <tbb/parallel_for.h>
 
 namespace pisa {
 
@@ -119,4 +126,59 @@ class trec_topic_reader {
     std::istream& m_is;
 };
 
+/// Returns the offsets at which `text`, the contents of a topic file, is cut into chunks of at
+/// least `chunk_size` bytes, each but the first starting with a `<top>` tag, followed by the
+/// size of `text`.
+[[nodiscard]] inline auto topic_chunks(std::string_view text, std::size_t chunk_size)
+    -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> offsets{0};
+    auto target = std::max<std::size_t>(chunk_size, 1);
+    while (target < text.size()) {
+        auto top = text.find(TOP, target);
+        if (top == std::string_view::npos) {
+            break;
+        }
+        offsets.push_back(top);
+        target = top + std::max<std::size_t>(chunk_size, 1);
+    }
+    offsets.push_back(text.size());
+    return offsets;
+}
+
+/// Parses the topics of `text`, e.g., a memory-mapped topic file, and returns `fn(topic)` for
+/// each of them, in the order of the text.
+///
+/// The text is cut into chunks of about `chunk_size` bytes at `<top>` tags, and chunks are
+/// parsed, and their topics passed to `fn`, in parallel, so that `fn` can do the heavy part of
+/// preprocessing, e.g., stemming and mapping terms to IDs, and must be safe to call from any
+/// thread. Throws `std::runtime_error` if a topic cannot be parsed.
+template <typename Fn>
+[[nodiscard]] auto
+transform_topics(std::string_view text, Fn fn, std::size_t chunk_size = std::size_t(1) << 20U)
+    -> std::vector<std::invoke_result_t<Fn, trec_topic>>
+{
+    using result_type = std::invoke_result_t<Fn, trec_topic>;
+    auto offsets = topic_chunks(text, chunk_size);
+    std::vector<std::vector<result_type>> chunks(offsets.size() - 1);
+    tbb::parallel_for(std::size_t(0), chunks.size(), [&](std::size_t chunk) {
+        std::istringstream is(
+            std::string(text.substr(offsets[chunk], offsets[chunk + 1] - offsets[chunk])));
+        trec_topic_reader reader(is);
+        while (auto topic = reader.next_topic()) {
+            chunks[chunk].push_back(fn(std::move(*topic)));
+        }
+    });
+    std::size_t size = 0;
+    for (auto const& chunk: chunks) {
+        size += chunk.size();
+    }
+    std::vector<result_type> results;
+    results.reserve(size);
+    for (auto& chunk: chunks) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(results));
+    }
+    return results;
+}
+
 }  // namespace pisa
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include "decoded_block_cache.hpp"
+#include "mappable/warmup.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// Returns the distinct terms of `queries`, the most frequent first, keeping only the first
+/// `count` if given.
+[[nodiscard]] inline auto
+query_log_terms(std::vector<Query> const& queries, std::optional<std::size_t> count = std::nullopt)
+    -> std::vector<term_id_type>
+{
+    std::unordered_map<term_id_type, std::size_t> frequencies;
+    for (auto const& query: queries) {
+        for (auto term: query.terms) {
+            frequencies[term] += 1;
+        }
+    }
+    std::vector<std::pair<term_id_type, std::size_t>> ranked(
+        frequencies.begin(), frequencies.end());
+    std::sort(ranked.begin(), ranked.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+    });
+    if (count && *count < ranked.size()) {
+        ranked.resize(*count);
+    }
+    std::vector<term_id_type> terms(ranked.size());
+    std::transform(ranked.begin(), ranked.end(), terms.begin(), [](auto const& entry) {
+        return entry.first;
+    });
+    return terms;
+}
+
+template <typename Index, typename = void>
+struct has_list_ranges: std::false_type {
+};
+
+template <typename Index>
+struct has_list_ranges<
+    Index,
+    std::void_t<
+        decltype(std::declval<Index const&>().list_ranges(
+            std::declval<gsl::span<std::uint32_t const>>())),
+        decltype(std::declval<Index const&>().lists_data())>>: std::true_type {
+};
+
+/// Brings the posting lists of `terms` of `index` into memory, with `threads` threads, all
+/// available ones by default, regardless of the number of threads the queries are later run
+/// with.
+///
+/// If `index` exposes the byte ranges of its lists, adjacent lists are read as one range, so
+/// that the lists of an index laid out by query log frequency are read sequentially.
+template <typename Index>
+void warmup_lists(
+    Index const& index,
+    std::vector<term_id_type> const& terms,
+    int threads = tbb::task_arena::automatic)
+{
+    tbb::task_arena arena(threads);
+    if constexpr (has_list_ranges<Index>::value) {
+        auto ranges = index.list_ranges(gsl::make_span(terms));
+        std::sort(ranges.begin(), ranges.end());
+        std::vector<std::pair<std::size_t, std::size_t>> merged;
+        for (auto const& range: ranges) {
+            if (not merged.empty() && range.first <= merged.back().second) {
+                merged.back().second = std::max(merged.back().second, range.second);
+            } else {
+                merged.push_back(range);
+            }
+        }
+        arena.execute([&] {
+            tbb::parallel_for(std::size_t(0), merged.size(), [&](std::size_t idx) {
+                auto [begin, end] = merged[idx];
+                mapper::warmup_memory(index.lists_data() + begin, end - begin);
+            });
+        });
+    } else {
+        arena.execute([&] {
+            tbb::parallel_for(std::size_t(0), terms.size(), [&](std::size_t idx) {
+                index.warmup(terms[idx]);
+            });
+        });
+    }
+}
+
+template <typename Index, typename = void>
+struct has_decode_endpoints: std::false_type {
+};
+
+template <typename Index>
+struct has_decode_endpoints<Index, std::void_t<decltype(std::declval<Index&>().decode_endpoints())>>
+    : std::true_type {
+};
+
+/// Decodes the positions of the posting lists of `index` into memory, if it supports it, e.g.,
+/// `block_freq_index::decode_endpoints`, and returns whether it did.
+template <typename Index>
+auto decode_endpoints(Index& index) -> bool
+{
+    if constexpr (has_decode_endpoints<Index>::value) {
+        index.decode_endpoints();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <typename Index, typename = void>
+struct has_decoded_block_cache: std::false_type {
+};
+
+template <typename Index>
+struct has_decoded_block_cache<
+    Index,
+    std::void_t<decltype(std::declval<Index&>().set_decoded_block_cache(nullptr))>>
+    : std::true_type {
+};
+
+/// Makes `index` read the blocks of the lists of `hot_terms`, most frequent first, from a
+/// cache of up to `capacity` bytes of decoded blocks shared by all queries, if it supports it,
+/// and returns the cache, which must outlive the queries, or `nullptr` if it does not.
+template <typename Index>
+auto use_decoded_block_cache(
+    Index& index, std::vector<term_id_type> const& hot_terms, std::size_t capacity)
+    -> std::unique_ptr<decoded_block_cache>
+{
+    if constexpr (has_decoded_block_cache<Index>::value) {
+        auto cache = make_decoded_block_cache(index, hot_terms, capacity);
+        index.set_decoded_block_cache(cache.get());
+        return cache;
+    } else {
+        return nullptr;
+    }
+}
+
+/// Brings all posting lists of `index` into memory.
+template <typename Index>
+void warmup_lists(Index const& index, int threads = tbb::task_arena::automatic)
+{
+    std::vector<term_id_type> terms(index.size());
+    std::iota(terms.begin(), terms.end(), 0);
+    warmup_lists(index, terms, threads);
+}
+
+}  // namespace pisa
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <gsl/span>
+#include <spdlog/spdlog.h>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "io.hpp"
+#include "payload_vector.hpp"
+#include "query/docid_range.hpp"
+#include "util/collection_writer.hpp"
+#include "util/progress.hpp"
+
+namespace pisa {
+
+/// Returns the number of postings of `collection` in each bucket of `bucket_width` consecutive
+/// docids. Lists are counted in parallel if the collection has offsets, and in order otherwise.
+[[nodiscard]] inline auto
+postings_histogram(binary_freq_collection const& collection, std::uint64_t bucket_width)
+    -> std::vector<std::uint64_t>
+{
+    bucket_width = std::max<std::uint64_t>(bucket_width, 1);
+    auto buckets = (collection.num_docs() + bucket_width - 1) / bucket_width;
+    auto count = [&](auto const& docs, std::vector<std::uint64_t>& counts) {
+        for (auto docid: docs) {
+            counts[docid / bucket_width] += 1;
+        }
+    };
+    if (not collection.has_offsets()) {
+        std::vector<std::uint64_t> counts(buckets, 0);
+        for (auto const& list: collection) {
+            count(list.docs, counts);
+        }
+        return counts;
+    }
+    tbb::enumerable_thread_specific<std::vector<std::uint64_t>> local_counts(
+        [&] { return std::vector<std::uint64_t>(buckets, 0); });
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>(0, collection.size(), 1024),
+        [&](auto const& terms) {
+            auto& counts = local_counts.local();
+            auto it = collection.iterator_at(terms.begin());
+            for (auto term = terms.begin(); term != terms.end(); ++term, ++it) {
+                count(it->docs, counts);
+            }
+        });
+    std::vector<std::uint64_t> counts(buckets, 0);
+    for (auto const& local: local_counts) {
+        std::transform(local.begin(), local.end(), counts.begin(), counts.begin(), std::plus<>{});
+    }
+    return counts;
+}
+
+/// Splits the docids `[0, num_docs)` into `parts` consecutive ranges with about as many
+/// postings each, given the postings of every bucket of `bucket_width` docids, see
+/// `postings_histogram`.
+///
+/// Ranges end at bucket boundaries, each as close as possible to its share of the postings, so
+/// that no range has more than a bucket of postings above its share. Every range has at least
+/// one bucket, unless there are fewer buckets than parts, in which case the last ranges are
+/// empty.
+[[nodiscard]] inline auto balanced_docid_ranges(
+    gsl::span<std::uint64_t const> histogram,
+    std::uint64_t bucket_width,
+    std::uint64_t num_docs,
+    std::size_t parts) -> std::vector<docid_range>
+{
+    if (parts == 0) {
+        throw std::invalid_argument("Docids must be split into at least one range");
+    }
+    std::vector<std::uint64_t> prefix(histogram.size() + 1, 0);
+    for (std::size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+        prefix[bucket + 1] = prefix[bucket] + histogram[bucket];
+    }
+    auto total = prefix.back();
+    std::vector<docid_range> ranges;
+    std::size_t begin_bucket = 0;
+    for (std::size_t part = 0; part < parts; ++part) {
+        std::size_t end_bucket = histogram.size();
+        if (part + 1 < parts) {
+            // The end closest to the share of postings of the parts so far, leaving a bucket to
+            // every part after this one.
+            auto target = static_cast<double>(total) * static_cast<double>(part + 1) / parts;
+            auto first = std::min(begin_bucket + 1, histogram.size());
+            auto last = histogram.size() - std::min(histogram.size(), parts - part - 1);
+            last = std::max(last, first);
+            auto pos = std::lower_bound(
+                prefix.begin() + first, prefix.begin() + last, static_cast<std::uint64_t>(target));
+            end_bucket = static_cast<std::size_t>(pos - prefix.begin());
+            if (end_bucket > first
+                && target - static_cast<double>(prefix[end_bucket - 1])
+                    < static_cast<double>(prefix[end_bucket]) - target) {
+                end_bucket -= 1;
+            }
+        }
+        ranges.push_back(docid_range{
+            std::min(begin_bucket * bucket_width, num_docs),
+            std::min(end_bucket * bucket_width, num_docs)});
+        begin_bucket = end_bucket;
+    }
+    return ranges;
+}
+
+/// Writes the part of the collection `input_basename` in each of `ranges`, which must be
+/// consecutive, to `{output_basename}.{r:03d}` for range `r`, with docids counted from the
+/// beginning of the range, so that every range can be compressed, mapped, and served as an
+/// index of its own.
+///
+/// Each part only has the terms with postings in its range, listed in `.terms` and `.termlex`
+/// if `terms_filename` lists the terms of the collection, one per line, and its documents in
+/// `.documents` and `.doclex` if `documents_filename` lists the titles of the documents. Parts
+/// also get their slice of the document sizes. The range of every document is written to
+/// `{output_basename}.shards`, as by `partition_fwd_index`, and the ranges, one per line, to
+/// `{output_basename}.ranges`.
+///
+/// Lists are split in parallel, a batch of terms at a time, and every part is written by a
+/// `Freq_Collection_Writer` of its own.
+inline void partition_docid_ranges(
+    std::string const& input_basename,
+    std::string const& output_basename,
+    std::vector<docid_range> const& ranges,
+    std::optional<std::string> const& terms_filename = std::nullopt,
+    std::optional<std::string> const& documents_filename = std::nullopt)
+{
+    binary_freq_collection input(input_basename.c_str());
+    auto num_docs = input.num_docs();
+    for (std::size_t part = 0; part < ranges.size(); ++part) {
+        auto expected_begin = part == 0 ? 0 : ranges[part - 1].end;
+        if (ranges[part].begin != expected_begin || ranges[part].end < ranges[part].begin) {
+            throw std::invalid_argument("Docid ranges must be consecutive from 0");
+        }
+    }
+    if (ranges.empty() || ranges.back().end != num_docs) {
+        throw std::invalid_argument("Docid ranges must cover all documents");
+    }
+    auto part_name = [&](std::size_t part) {
+        return fmt::format("{}.{:03d}", output_basename, part);
+    };
+
+    std::vector<std::unique_ptr<Freq_Collection_Writer>> writers;
+    for (std::size_t part = 0; part < ranges.size(); ++part) {
+        // Smaller buffers than usual, since there is a writer for every part.
+        writers.push_back(std::make_unique<Freq_Collection_Writer>(
+            part_name(part),
+            static_cast<std::uint32_t>(ranges[part].end - ranges[part].begin),
+            Freq_Collection_Writer::default_buffer_size / 4));
+    }
+    std::vector<std::vector<std::uint32_t>> part_terms(ranges.size());
+
+    pisa::progress progress("Partitioning docid ranges", input.size());
+    constexpr std::size_t batch_size = 1U << 12U;
+    using list_type = std::pair<std::vector<std::uint32_t>, std::vector<std::uint32_t>>;
+    std::vector<binary_freq_collection::sequence> batch;
+    std::vector<std::vector<list_type>> parts(batch_size);
+    std::uint32_t first_term = 0;
+    auto flush = [&] {
+        tbb::parallel_for(std::size_t(0), batch.size(), [&](std::size_t idx) {
+            auto const& list = batch[idx];
+            auto& lists = parts[idx];
+            lists.assign(ranges.size(), {});
+            auto docs = list.docs.begin();
+            for (std::size_t part = 0; part < ranges.size(); ++part) {
+                auto begin = docs;
+                docs = std::lower_bound(docs, list.docs.end(), ranges[part].end);
+                auto& [part_docs, part_freqs] = lists[part];
+                part_docs.reserve(docs - begin);
+                for (auto it = begin; it != docs; ++it) {
+                    part_docs.push_back(static_cast<std::uint32_t>(*it - ranges[part].begin));
+                }
+                auto freqs = list.freqs.begin() + (begin - list.docs.begin());
+                part_freqs.assign(freqs, freqs + (docs - begin));
+            }
+        });
+        for (std::size_t idx = 0; idx < batch.size(); ++idx) {
+            for (std::size_t part = 0; part < ranges.size(); ++part) {
+                auto& [part_docs, part_freqs] = parts[idx][part];
+                if (not part_docs.empty()) {
+                    writers[part]->push(
+                        part_terms[part].size(), std::move(part_docs), std::move(part_freqs));
+                    part_terms[part].push_back(first_term + idx);
+                }
+            }
+        }
+        progress.update(batch.size());
+        first_term += batch.size();
+        batch.clear();
+    };
+    for (auto const& list: input) {
+        batch.push_back(list);
+        if (batch.size() == batch_size) {
+            flush();
+        }
+    }
+    flush();
+    for (auto& writer: writers) {
+        writer->close();
+    }
+
+    binary_collection sizes((input_basename + ".sizes").c_str());
+    auto document_sizes = *sizes.begin();
+    for (std::size_t part = 0; part < ranges.size(); ++part) {
+        std::ofstream os(part_name(part) + ".sizes", std::ios::binary);
+        auto size = static_cast<std::uint32_t>(ranges[part].end - ranges[part].begin);
+        os.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        os.write(
+            reinterpret_cast<char const*>(document_sizes.begin() + ranges[part].begin),
+            size * sizeof(std::uint32_t));
+    }
+
+    if (terms_filename) {
+        std::vector<std::string> terms;
+        std::ifstream is(*terms_filename);
+        io::for_each_line(is, [&](auto const& term) { terms.push_back(term); });
+        for (std::size_t part = 0; part < ranges.size(); ++part) {
+            std::vector<std::string> kept;
+            kept.reserve(part_terms[part].size());
+            for (auto term: part_terms[part]) {
+                if (term >= terms.size()) {
+                    throw std::invalid_argument(fmt::format(
+                        "{} lists {} terms but the collection has more",
+                        *terms_filename,
+                        terms.size()));
+                }
+                kept.push_back(terms[term]);
+            }
+            std::ofstream os(part_name(part) + ".terms");
+            for (auto const& term: kept) {
+                os << term << '\n';
+            }
+            encode_payload_vector(gsl::span<std::string const>(kept))
+                .to_file(part_name(part) + ".termlex");
+        }
+    }
+    if (documents_filename) {
+        std::vector<std::string> titles;
+        std::ifstream is(*documents_filename);
+        io::for_each_line(is, [&](auto const& title) { titles.push_back(title); });
+        if (titles.size() != num_docs) {
+            throw std::invalid_argument(fmt::format(
+                "{} lists {} documents but the collection has {}",
+                *documents_filename,
+                titles.size(),
+                num_docs));
+        }
+        for (std::size_t part = 0; part < ranges.size(); ++part) {
+            gsl::span<std::string const> part_titles(
+                titles.data() + ranges[part].begin,
+                static_cast<std::ptrdiff_t>(ranges[part].end - ranges[part].begin));
+            std::ofstream os(part_name(part) + ".documents");
+            for (auto const& title: part_titles) {
+                os << title << '\n';
+            }
+            encode_payload_vector(part_titles).to_file(part_name(part) + ".doclex");
+        }
+    }
+
+    std::ofstream shards_os(output_basename + ".shards", std::ios::binary);
+    std::ofstream ranges_os(output_basename + ".ranges");
+    for (std::size_t part = 0; part < ranges.size(); ++part) {
+        std::vector<std::uint32_t> document_shards(
+            ranges[part].end - ranges[part].begin, static_cast<std::uint32_t>(part));
+        shards_os.write(
+            reinterpret_cast<char const*>(document_shards.data()),
+            document_shards.size() * sizeof(std::uint32_t));
+        ranges_os << ranges[part].begin << '\t' << ranges[part].end << '\n';
+    }
+}
+
+}  // namespace pisa
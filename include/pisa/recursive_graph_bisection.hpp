@@ -1,16 +1,23 @@
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <fstream>
+#include <functional>
 #include <iterator>
+#include <numeric>
 #include <thread>
 #include <vector>
 
 #include "pstl/algorithm"
 #include "pstl/execution"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
 #include "tbb/task_group.h"
 
+#include "binary_freq_collection.hpp"
 #include "forward_index.hpp"
+#include "mappable/mappable_vector.hpp"
 #include "util/index_build_utils.hpp"
 #include "util/log.hpp"
 #include "util/progress.hpp"
@@ -41,12 +48,20 @@ class document_range {
   public:
     using value_type = typename std::iterator_traits<Iterator>::value_type;
 
+    /// The range of documents `[first, last)` of `fwdidx`, whose gains are stored in `gains`.
+    /// If `term_weights` is given, the cost of each term is scaled by its weight, see
+    /// `bp::query_term_weights`; otherwise all terms weigh the same.
     document_range(
         Iterator first,
         Iterator last,
         std::reference_wrapper<const forward_index> fwdidx,
-        std::reference_wrapper<std::vector<double>> gains)
-        : m_first(first), m_last(last), m_fwdidx(fwdidx), m_gains(gains)
+        std::reference_wrapper<std::vector<double>> gains,
+        std::vector<double> const* term_weights = nullptr)
+        : m_first(first),
+          m_last(last),
+          m_fwdidx(fwdidx),
+          m_gains(gains),
+          m_term_weights(term_weights)
     {}
 
     Iterator begin() { return m_first; }
@@ -56,8 +71,8 @@ class document_range {
     PISA_ALWAYSINLINE document_partition<Iterator> split() const
     {
         Iterator mid = std::next(m_first, size() / 2);
-        return {document_range(m_first, mid, m_fwdidx, m_gains),
-                document_range(mid, m_last, m_fwdidx, m_gains),
+        return {document_range(m_first, mid, m_fwdidx, m_gains, m_term_weights),
+                document_range(mid, m_last, m_fwdidx, m_gains, m_term_weights),
                 term_count()};
     }
 
@@ -65,7 +80,8 @@ class document_range {
     {
         assert(left < right);
         assert(right <= size());
-        return document_range(std::next(m_first, left), std::next(m_first, right), m_fwdidx, m_gains);
+        return document_range(
+            std::next(m_first, left), std::next(m_first, right), m_fwdidx, m_gains, m_term_weights);
     }
 
     std::size_t term_count() const { return m_fwdidx.get().term_count(); }
@@ -73,6 +89,7 @@ class document_range {
     {
         return m_fwdidx.get().terms(document);
     }
+    [[nodiscard]] auto term_weights() const -> std::vector<double> const* { return m_term_weights; }
     double gain(value_type document) const { return m_gains.get()[document]; }
     double& gain(value_type document) { return m_gains.get()[document]; }
 
@@ -88,6 +105,7 @@ class document_range {
     Iterator m_last;
     std::reference_wrapper<const forward_index> m_fwdidx;
     std::reference_wrapper<std::vector<double>> m_gains;
+    std::vector<double> const* m_term_weights;
 };
 
 template <class Iterator>
@@ -132,91 +150,260 @@ auto get_mapping = [](const auto& collection) {
     return mapping;
 };
 
-template <class Iterator>
-void compute_degrees(document_range<Iterator>& range, single_init_vector<size_t>& deg_map)
-{
-    for (const auto& document: range) {
-        auto terms = range.terms(document);
-        auto deg_map_inc = [&](const auto& t) { deg_map.set(t, deg_map[t] + 1); };
-        std::for_each(std::execution::unseq, terms.begin(), terms.end(), deg_map_inc);
+namespace bp {
+
+    /// Table mapping global to local term IDs, of which each thread has one.
+    struct local_term_table {
+        std::vector<uint32_t> ids;
+        /// ID of the partition whose terms the table currently maps, or 0.
+        std::uint64_t owner = 0;
+    };
+
+    /// Returns the table of the calling thread, with at least `term_count` entries.
+    inline local_term_table& thread_term_table(std::size_t term_count)
+    {
+        thread_local local_term_table table;
+        if (table.ids.size() < term_count) {
+            table.ids.resize(term_count);
+        }
+        return table;
     }
-}
 
+    /// The terms of the documents of a partition, numbered from 0 in order of appearance, with
+    /// their degrees in each half of the partition.
+    ///
+    /// The degrees and gains of a partition are thus sized to the terms it contains rather than
+    /// to the vocabulary, which only the table mapping global to local IDs is, once per thread.
+    /// Since other partitions may use the table of a thread in between, local IDs are looked up
+    /// through `local_ids()`, which rewrites the entries of this partition if needed.
+    class partition_terms {
+      public:
+        template <class Iterator>
+        explicit partition_terms(document_partition<Iterator>& partition)
+            : m_id(next_id()), m_term_count(partition.term_count)
+        {
+            auto& table = thread_term_table(m_term_count);
+            count_degrees(partition.left, table.ids, m_left_degrees, m_right_degrees);
+            count_degrees(partition.right, table.ids, m_right_degrees, m_left_degrees);
+            table.owner = m_id;
+            m_gain_cache.resize(m_terms.size());
+            if (auto const* weights = partition.left.term_weights(); weights != nullptr) {
+                m_weights.resize(m_terms.size());
+                for (uint32_t local = 0; local < m_terms.size(); ++local) {
+                    m_weights[local] = (*weights)[m_terms[local]];
+                }
+            }
+        }
+
+        /// Returns the table of the current thread, indexed by global term ID, after making it
+        /// map the terms of this partition. It is valid until the thread runs other partitions,
+        /// e.g., while waiting on a parallel algorithm.
+        [[nodiscard]] auto local_ids() const -> uint32_t const*
+        {
+            auto& table = thread_term_table(m_term_count);
+            if (table.owner != m_id) {
+                for (uint32_t local = 0; local < m_terms.size(); ++local) {
+                    table.ids[m_terms[local]] = local;
+                }
+                table.owner = m_id;
+            }
+            return table.ids.data();
+        }
+
+        [[nodiscard]] auto size() const -> std::size_t { return m_terms.size(); }
+
+        /// Returns the weight of the local term `local`, 1 if terms are not weighted.
+        [[nodiscard]] auto weight(uint32_t local) const -> double
+        {
+            return m_weights.empty() ? 1.0 : m_weights[local];
+        }
+
+        [[nodiscard]] auto left_degrees() -> std::vector<uint32_t>& { return m_left_degrees; }
+        [[nodiscard]] auto right_degrees() -> std::vector<uint32_t>& { return m_right_degrees; }
+
+        /// Returns the cache of term gains, which is cleared by the caller.
+        [[nodiscard]] auto gain_cache() -> single_init_vector<double>& { return m_gain_cache; }
+
+        /// Returns a buffer for the gains of all terms, to be resized by the caller.
+        [[nodiscard]] auto term_gains() -> std::vector<double>& { return m_term_gains; }
+
+      private:
+        static auto next_id() -> std::uint64_t
+        {
+            static std::atomic_uint64_t last_id{0};
+            return ++last_id;
+        }
+
+        template <class Iterator>
+        void count_degrees(
+            document_range<Iterator>& range,
+            std::vector<uint32_t>& local_ids,
+            std::vector<uint32_t>& degrees,
+            std::vector<uint32_t>& other_degrees)
+        {
+            for (const auto& document: range) {
+                for (auto term: range.terms(document)) {
+                    auto local = local_ids[term];
+                    // The table is not cleared between partitions: an ID is only valid if it
+                    // points back to the term.
+                    if (local >= m_terms.size() || m_terms[local] != term) {
+                        local = m_terms.size();
+                        local_ids[term] = local;
+                        m_terms.push_back(term);
+                        degrees.push_back(0);
+                        other_degrees.push_back(0);
+                    }
+                    degrees[local] += 1;
+                }
+            }
+        }
+
+        std::uint64_t m_id;
+        std::size_t m_term_count;
+        std::vector<uint32_t> m_terms;
+        std::vector<uint32_t> m_left_degrees;
+        std::vector<uint32_t> m_right_degrees;
+        std::vector<double> m_weights;
+        single_init_vector<double> m_gain_cache;
+        std::vector<double> m_term_gains;
+    };
+
+    /// Returns the gain of moving a document containing a term of degrees `from_deg` and
+    /// `to_deg` from a half of `log2(n1)` to one of `log2(n2)` documents.
+    PISA_ALWAYSINLINE double move_gain(double logn1, double logn2, size_t from_deg, size_t to_deg)
+    {
+        return expb(logn1, logn2, from_deg, to_deg)
+            - expb(logn1, logn2, from_deg - 1, to_deg + 1);
+    }
+
+}  // namespace bp
+
+/// Computes the gains of moving each document of `range` to the other half, each term
+/// contributing its gain times its weight.
+///
+/// With `isLikelyCached`, used for the large partitions of the first levels, the gains of all
+/// terms are computed first, and then summed for each document, both in parallel. Otherwise,
+/// the gains of terms are computed as they are met, on the current thread.
 template <bool isLikelyCached = true, typename Iter>
 void compute_move_gains_caching(
     document_range<Iter>& range,
     const std::ptrdiff_t from_n,
     const std::ptrdiff_t to_n,
-    const single_init_vector<size_t>& from_lex,
-    const single_init_vector<size_t>& to_lex)
+    const std::vector<uint32_t>& from_lex,
+    const std::vector<uint32_t>& to_lex,
+    bp::partition_terms& terms)
 {
     const auto logn1 = log2(from_n);
     const auto logn2 = log2(to_n);
 
-    thread_local single_init_vector<double> gain_cache(from_lex.size());
-    gain_cache.clear();
-    auto compute_document_gain = [&](auto& d) {
-        double gain = 0.0;
-        auto terms = range.terms(d);
-        for (const auto& t: terms) {
-            if constexpr (isLikelyCached) {
-                if (PISA_UNLIKELY(not gain_cache.has_value(t))) {
-                    const auto& from_deg = from_lex[t];
-                    const auto& to_deg = to_lex[t];
-                    const auto term_gain = bp::expb(logn1, logn2, from_deg, to_deg)
-                        - bp::expb(logn1, logn2, from_deg - 1, to_deg + 1);
-                    gain_cache.set(t, term_gain);
+    if constexpr (isLikelyCached) {
+        auto& term_gains = terms.term_gains();
+        term_gains.resize(from_lex.size());
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, from_lex.size()), [&](auto const& local_terms) {
+                for (auto t = local_terms.begin(); t != local_terms.end(); ++t) {
+                    // Terms that only appear in the other half are not needed, and may have
+                    // a degree of 0.
+                    if (from_lex[t] > 0) {
+                        term_gains[t] = terms.weight(t)
+                            * bp::move_gain(logn1, logn2, from_lex[t], to_lex[t]);
+                    }
                 }
-            } else {
+            });
+        tbb::parallel_for(
+            tbb::blocked_range<Iter>(range.begin(), range.end()), [&](auto const& docs) {
+                auto local_ids = terms.local_ids();
+                for (auto const& d: docs) {
+                    double gain = 0.0;
+                    for (const auto& term: range.terms(d)) {
+                        gain += term_gains[local_ids[term]];
+                    }
+                    range.gain(d) = gain;
+                }
+            });
+    } else {
+        auto& gain_cache = terms.gain_cache();
+        gain_cache.clear();
+        auto local_ids = terms.local_ids();
+        auto compute_document_gain = [&](auto& d) {
+            double gain = 0.0;
+            for (const auto& term: range.terms(d)) {
+                auto t = local_ids[term];
                 if (PISA_LIKELY(not gain_cache.has_value(t))) {
-                    const auto& from_deg = from_lex[t];
-                    const auto& to_deg = to_lex[t];
-                    const auto term_gain = bp::expb(logn1, logn2, from_deg, to_deg)
-                        - bp::expb(logn1, logn2, from_deg - 1, to_deg + 1);
-                    gain_cache.set(t, term_gain);
+                    gain_cache.set(
+                        t, terms.weight(t) * bp::move_gain(logn1, logn2, from_lex[t], to_lex[t]));
                 }
+                gain += gain_cache[t];
             }
-            gain += gain_cache[t];
-        }
-        range.gain(d) = gain;
-    };
-    std::for_each(range.begin(), range.end(), compute_document_gain);
+            range.gain(d) = gain;
+        };
+        std::for_each(range.begin(), range.end(), compute_document_gain);
+    }
 }
 
 template <class Iterator, class GainF>
 void compute_gains(
-    document_partition<Iterator>& partition, const degree_map_pair& degrees, GainF gain_function)
+    document_partition<Iterator>& partition, bp::partition_terms& terms, GainF gain_function)
 {
     auto n1 = partition.left.size();
     auto n2 = partition.right.size();
-    gain_function(partition.left, n1, n2, degrees.left, degrees.right);
-    gain_function(partition.right, n2, n1, degrees.right, degrees.left);
+    gain_function(partition.left, n1, n2, terms.left_degrees(), terms.right_degrees(), terms);
+    gain_function(partition.right, n2, n1, terms.right_degrees(), terms.left_degrees(), terms);
 }
 
+/// Moves the documents that may be swapped, i.e., whose gain exceeds minus the largest gain of
+/// the other half, to the front of each half, and sorts them by decreasing gain. The documents
+/// left behind could only be paired with documents of negative total gain.
 template <class Iterator>
-void swap(document_partition<Iterator>& partition, degree_map_pair& degrees)
+void sort_swap_candidates(document_partition<Iterator>& partition)
+{
+    auto& left = partition.left;
+    auto& right = partition.right;
+    if (left.size() == 0 || right.size() == 0) {
+        return;
+    }
+    auto max_gain = [](auto& range) {
+        return range.gain(*std::max_element(
+            std::execution::par_unseq, range.begin(), range.end(), [&](auto lhs, auto rhs) {
+                return range.gain(lhs) < range.gain(rhs);
+            }));
+    };
+    auto sort_candidates = [](auto& range, double min_gain) {
+        auto last = std::partition(
+            std::execution::par_unseq, range.begin(), range.end(), [&](auto const& d) {
+                return range.gain(d) > min_gain;
+            });
+        std::sort(std::execution::par_unseq, range.begin(), last, range.by_gain());
+    };
+    double left_max = max_gain(left);
+    double right_max = max_gain(right);
+    tbb::parallel_invoke(
+        [&] { sort_candidates(left, -right_max); }, [&] { sort_candidates(right, -left_max); });
+}
+
+template <class Iterator>
+void swap(document_partition<Iterator>& partition, bp::partition_terms& terms)
 {
     auto left = partition.left;
     auto right = partition.right;
+    auto& left_degrees = terms.left_degrees();
+    auto& right_degrees = terms.right_degrees();
+    auto local_ids = terms.local_ids();
     auto lit = left.begin();
     auto rit = right.begin();
     for (; lit != left.end() && rit != right.end(); ++lit, ++rit) {
         if (PISA_UNLIKELY(left.gain(*lit) + right.gain(*rit) <= 0)) {
             break;
         }
-        {
-            auto terms = left.terms(*lit);
-            for (auto& term: terms) {
-                degrees.left.set(term, degrees.left[term] - 1);
-                degrees.right.set(term, degrees.right[term] + 1);
-            }
+        for (auto term: left.terms(*lit)) {
+            auto t = local_ids[term];
+            left_degrees[t] -= 1;
+            right_degrees[t] += 1;
         }
-        {
-            auto terms = right.terms(*rit);
-            for (auto& term: terms) {
-                degrees.left.set(term, degrees.left[term] + 1);
-                degrees.right.set(term, degrees.right[term] - 1);
-            }
+        for (auto term: right.terms(*rit)) {
+            auto t = local_ids[term];
+            left_degrees[t] += 1;
+            right_degrees[t] -= 1;
         }
 
         std::iter_swap(lit, rit);
@@ -226,32 +413,12 @@ void swap(document_partition<Iterator>& partition, degree_map_pair& degrees)
 template <class Iterator, class GainF>
 void process_partition(document_partition<Iterator>& partition, GainF gain_function, int iterations = 20)
 {
-    thread_local single_init_vector<size_t> left_degree(partition.left.term_count());
-    left_degree.clear();
-    thread_local single_init_vector<size_t> right_degree(partition.right.term_count());
-    right_degree.clear();
-    compute_degrees(partition.left, left_degree);
-    compute_degrees(partition.right, right_degree);
-    degree_map_pair degrees{left_degree, right_degree};
+    bp::partition_terms terms(partition);
 
     for (int iteration = 0; iteration < iterations; ++iteration) {
-        compute_gains(partition, degrees, gain_function);
-        tbb::parallel_invoke(
-            [&] {
-                std::sort(
-                    std::execution::par_unseq,
-                    partition.left.begin(),
-                    partition.left.end(),
-                    partition.left.by_gain());
-            },
-            [&] {
-                std::sort(
-                    std::execution::par_unseq,
-                    partition.right.begin(),
-                    partition.right.end(),
-                    partition.right.by_gain());
-            });
-        swap(partition, degrees);
+        compute_gains(partition, terms, gain_function);
+        sort_swap_candidates(partition);
+        swap(partition, terms);
     }
 }
 
@@ -279,6 +446,138 @@ void recursive_graph_bisection(
     }
 }
 
+namespace bp {
+
+    /// Appends to `subtrees` the ranges that `recursive_graph_bisection` recurses into once it
+    /// has processed `documents` to depth `levels`, in order. Running the remaining levels on
+    /// each of them independently, e.g., on other machines, completes the bisection.
+    template <class Iterator>
+    void collect_subtrees(
+        document_range<Iterator> documents,
+        size_t levels,
+        std::vector<document_range<Iterator>>& subtrees)
+    {
+        if (levels == 0 || documents.size() <= 2) {
+            return;
+        }
+        auto partition = documents.split();
+        if (levels == 1) {
+            subtrees.push_back(partition.left);
+            subtrees.push_back(partition.right);
+        } else {
+            collect_subtrees(partition.left, levels - 1, subtrees);
+            collect_subtrees(partition.right, levels - 1, subtrees);
+        }
+    }
+
+    /// A document ordering after the first levels of recursive graph bisection, or the part of
+    /// it finished by one shard, frozen to be resumed or merged on another machine.
+    ///
+    /// The ordering after the first levels has a `shard_count` of 0 and stores all documents.
+    /// Otherwise, subtree `i`, as listed by `collect_subtrees`, belongs to shard
+    /// `i % shard_count`, which only stores the documents of its subtrees, in order.
+    struct partial_ordering {
+        /// Depth of the whole bisection.
+        uint64_t depth = 0;
+        /// Number of levels run on all documents before splitting them into subtrees.
+        uint64_t levels = 0;
+        uint64_t shard = 0;
+        uint64_t shard_count = 0;
+        uint64_t num_docs = 0;
+        mapper::mappable_vector<uint32_t> documents;
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit(depth, "depth")(levels, "levels")(shard, "shard")(shard_count, "shard_count")(
+                num_docs, "num_docs")(documents, "documents");
+        }
+    };
+
+    /// Returns the weights of the `term_count` terms of a collection given the number of
+    /// times each term occurs in a query log, `query_frequencies`, indexed by term ID.
+    ///
+    /// A term weighs `1 + boost * f / max_f`, where `f` is its frequency and `max_f` that of the
+    /// most frequent term, so that the lists queries touch most are the ones ordered best, while
+    /// the other lists keep the weight they have in the unweighted objective.
+    inline auto query_term_weights(
+        std::vector<std::size_t> const& query_frequencies, std::size_t term_count, double boost)
+        -> std::vector<double>
+    {
+        std::vector<double> weights(term_count, 1.0);
+        auto max_frequency = std::accumulate(
+            query_frequencies.begin(),
+            query_frequencies.end(),
+            std::size_t(0),
+            [](auto lhs, auto rhs) { return std::max(lhs, rhs); });
+        if (max_frequency == 0) {
+            return weights;
+        }
+        for (std::size_t term = 0; term < std::min(term_count, query_frequencies.size()); ++term) {
+            weights[term] += boost * static_cast<double>(query_frequencies[term])
+                / static_cast<double>(max_frequency);
+        }
+        return weights;
+    }
+
+    /// Returns `fwd` with an impact term added for each term of `collection` whose weight
+    /// exceeds 1, i.e., that occurs in the query log, to the documents holding the top
+    /// `fraction` of its postings by frequency. The impact terms are numbered from
+    /// `fwd.term_count()`, and their weights, those of their terms, appended to `weights`.
+    ///
+    /// Bisecting the extended index keeps the high-impact documents of each query term close
+    /// together, in few blocks, whose block-max scores are then higher than those of the other
+    /// blocks of the list, which dynamic pruning skips.
+    inline auto add_impact_terms(
+        forward_index const& fwd,
+        binary_freq_collection const& collection,
+        std::vector<double>& weights,
+        double fraction) -> forward_index
+    {
+        std::vector<std::vector<uint32_t>> impact_terms(fwd.size());
+        auto impact_term = static_cast<uint32_t>(fwd.term_count());
+        std::vector<std::pair<uint32_t, uint32_t>> postings;
+        std::size_t term = 0;
+        for (auto const& list: collection) {
+            if (term < fwd.term_count() && weights[term] > 1.0) {
+                auto count = static_cast<std::size_t>(std::ceil(fraction * list.docs.size()));
+                if (count > 0 && count < list.docs.size()) {
+                    postings.clear();
+                    auto freq = list.freqs.begin();
+                    for (auto doc: list.docs) {
+                        postings.emplace_back(*freq++, doc);
+                    }
+                    std::nth_element(
+                        postings.begin(),
+                        std::next(postings.begin(), count - 1),
+                        postings.end(),
+                        std::greater<>());
+                    for (auto pos = postings.begin(); pos != std::next(postings.begin(), count);
+                         ++pos) {
+                        impact_terms[pos->second].push_back(impact_term);
+                    }
+                    weights.push_back(weights[term]);
+                    impact_term += 1;
+                }
+            }
+            term += 1;
+        }
+
+        forward_index::builder builder(impact_term, fwd.compressed());
+        for (uint32_t document = 0; document < fwd.size(); ++document) {
+            // Impact terms follow all terms of the collection, in increasing order.
+            auto terms = fwd.terms(document);
+            terms.insert(terms.end(), impact_terms[document].begin(), impact_terms[document].end());
+            builder.add_document(terms);
+            impact_terms[document] = {};
+        }
+        forward_index extended;
+        builder.build(extended);
+        return extended;
+    }
+
+}  // namespace bp
+
 /// Runs the Network-BP according to the configuration in `nodes`.
 ///
 /// All nodes on the same level of recursion are allowed to be executed in parallel.
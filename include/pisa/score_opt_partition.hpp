@@ -33,24 +33,19 @@ struct score_opt_partition {
         std::deque<float> max_queue;
         float m_fixed_cost;
         float sum;
-        uint64_t end_sequence;
-        uint64_t element_count;
 
         score_window(
             ForwardIterator begin,
             posting_t base,
             wand_cost_t cost_upper_bound,
-            float fixed_cost,
-            size_t size)
+            float fixed_cost)
             : start_it(begin),
               end_it(begin),
               min_p(base),
               max_p(0),
               cost_upper_bound(cost_upper_bound),
               m_fixed_cost(fixed_cost),
-              sum(0),
-              end_sequence(size),
-              element_count(0)
+              sum(0)
         {}
 
         uint64_t universe() const { return max_p - min_p + 1; }
@@ -66,8 +61,6 @@ struct score_opt_partition {
             sum -= v;
             ++start;
             ++start_it;
-            if (std::get<1>(*start_it) != 0)
-                ++element_count;
         }
 
         void advance_end()
@@ -83,8 +76,6 @@ struct score_opt_partition {
             // max_p = *end_it;
             ++end;
             ++end_it;
-            if (std::get<1>(*end_it) != 0)
-                --element_count;
         }
 
         float cost()
@@ -121,7 +112,7 @@ struct score_opt_partition {
         wand_cost_t cost_lb = fixed_cost;
         wand_cost_t cost_bound = cost_lb;
         while (eps1 == 0 || cost_bound < cost_lb / eps1) {
-            windows.emplace_back(begin, base, cost_bound, fixed_cost, size);
+            windows.emplace_back(begin, base, cost_bound, fixed_cost);
             if (cost_bound >= single_block_cost)
                 break;
             cost_bound = cost_bound * (1 + eps2);
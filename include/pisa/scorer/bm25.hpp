@@ -15,6 +15,12 @@ struct bm25: public index_scorer<Wand> {
     using index_scorer<Wand>::index_scorer;
 
     static float doc_term_weight(uint64_t freq, float norm_len)
+    {
+        return doc_term_weight(freq, norm_len, k1, b);
+    }
+
+    /// Same as above, with parameters `k1` and `b` in place of the default ones.
+    static float doc_term_weight(uint64_t freq, float norm_len, float k1, float b)
     {
         float f = (float)freq;
         return f / (f + k1 * (1.0f - b + b * norm_len));
@@ -22,6 +28,12 @@ struct bm25: public index_scorer<Wand> {
 
     // IDF (inverse document frequency)
     static float query_term_weight(uint64_t df, uint64_t num_docs)
+    {
+        return query_term_weight(df, num_docs, k1);
+    }
+
+    /// Same as above, with parameter `k1` in place of the default one.
+    static float query_term_weight(uint64_t df, uint64_t num_docs, float k1)
     {
         float fdf = (float)df;
         float idf = std::log((float(num_docs) - fdf + 0.5f) / (fdf + 0.5f));
@@ -29,14 +41,40 @@ struct bm25: public index_scorer<Wand> {
         return std::max(epsilon_score, idf) * (1.0f + k1);
     }
 
-    term_scorer_t term_scorer(uint64_t term_id) const override
+    struct term_scorer_type {
+        Wand const* wdata;
+        float term_weight;
+
+        float operator()(uint32_t doc, uint32_t freq) const
+        {
+            return term_weight * doc_term_weight(freq, wdata->norm_len(doc));
+        }
+
+        /// Scores a block of postings, gathering the lengths before the arithmetic.
+        void score(
+            gsl::span<uint32_t const> docs,
+            gsl::span<uint32_t const> freqs,
+            gsl::span<float> out) const
+        {
+            for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+                out[i] = wdata->norm_len(docs[i]);
+            }
+            for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+                out[i] = term_weight * doc_term_weight(freqs[i], out[i]);
+            }
+        }
+    };
+
+    [[nodiscard]] auto static_term_scorer(uint64_t term_id) const -> term_scorer_type
     {
         auto term_len = this->m_wdata.term_posting_count(term_id);
         auto term_weight = query_term_weight(term_len, this->m_wdata.num_docs());
-        auto s = [&, term_weight](uint32_t doc, uint32_t freq) {
-            return term_weight * doc_term_weight(freq, this->m_wdata.norm_len(doc));
-        };
-        return s;
+        return {&this->m_wdata, term_weight};
+    }
+
+    term_scorer_t term_scorer(uint64_t term_id) const override
+    {
+        return static_term_scorer(term_id);
     }
 };
 }  // namespace pisa
@@ -18,20 +18,56 @@ struct dph: public index_scorer<Wand> {
 
     static constexpr float c = 1;
 
-    term_scorer_t term_scorer(uint64_t term_id) const override
-    {
-        auto s = [&, term_id](uint32_t doc, uint32_t freq) {
-            float f = (float)freq / this->m_wdata.doc_len(doc);
+    /// The scorer of one term, holding the factors that depend only on the term, so that
+    /// scoring a posting reads nothing but the length of its document.
+    struct term_scorer_type {
+        Wand const* wdata;
+        float avg_len;
+        /// The number of documents over the number of occurrences of the term.
+        float idf;
+
+        float operator()(uint32_t doc, uint32_t freq) const
+        {
+            return score_posting(freq, wdata->doc_len(doc));
+        }
+
+        /// Scores a block of postings, gathering the lengths before the arithmetic.
+        void score(
+            gsl::span<uint32_t const> docs,
+            gsl::span<uint32_t const> freqs,
+            gsl::span<float> out) const
+        {
+            for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+                out[i] = wdata->doc_len(docs[i]);
+            }
+            for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+                out[i] = score_posting(freqs[i], out[i]);
+            }
+        }
+
+      private:
+        float score_posting(uint32_t freq, float doc_len) const
+        {
+            float f = (float)freq / doc_len;
             float norm = (1.f - f) * (1.f - f) / (freq + 1.f);
             return norm
-                * (freq
-                       * std::log2(
-                           (freq * this->m_wdata.avg_len() / this->m_wdata.doc_len(doc))
-                           * ((float)this->m_wdata.num_docs()
-                              / this->m_wdata.term_occurrence_count(term_id)))
+                * (freq * std::log2((freq * avg_len / doc_len) * idf)
                    + .5f * std::log2(2.f * M_PI * freq * (1.f - f)));
-        };
-        return s;
+        }
+    };
+
+    [[nodiscard]] auto static_term_scorer(uint64_t term_id) const -> term_scorer_type
+    {
+        auto const& wdata = this->m_wdata;
+        return {
+            &wdata,
+            wdata.avg_len(),
+            (float)wdata.num_docs() / wdata.term_occurrence_count(term_id)};
+    }
+
+    term_scorer_t term_scorer(uint64_t term_id) const override
+    {
+        return static_term_scorer(term_id);
     }
 };
 
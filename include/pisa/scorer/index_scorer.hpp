@@ -4,6 +4,9 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <type_traits>
+
+#include <gsl/span>
 
 namespace pisa {
 
@@ -21,4 +24,95 @@ struct index_scorer {
     virtual term_scorer_t term_scorer(uint64_t term_id) const = 0;
 };
 
+template <typename Scorer, typename = void>
+struct has_static_term_scorer: std::false_type {
+};
+
+template <typename Scorer>
+struct has_static_term_scorer<Scorer, std::void_t<typename Scorer::term_scorer_type>>: std::true_type {
+};
+
+/// Returns the term scorer of `scorer` for `term_id`.
+///
+/// Concrete scorers produce their own functor type, which can be inlined into the
+/// query processing loops; anything else falls back to the type-erased `term_scorer_t`.
+template <typename Scorer>
+[[nodiscard]] auto make_term_scorer(Scorer const& scorer, uint64_t term_id)
+{
+    if constexpr (has_static_term_scorer<Scorer>::value) {
+        return scorer.static_term_scorer(term_id);
+    } else {
+        return scorer.term_scorer(term_id);
+    }
+}
+
+template <typename Scorer>
+using term_scorer_type_t = decltype(make_term_scorer(std::declval<Scorer const&>(), 0));
+
+/// Detects term scorers that score a block of postings at once with `score`.
+template <typename TermScorer, typename = void>
+struct has_block_score: std::false_type {
+};
+
+template <typename TermScorer>
+struct has_block_score<
+    TermScorer,
+    std::void_t<decltype(std::declval<TermScorer const&>().score(
+        std::declval<gsl::span<uint32_t const>>(),
+        std::declval<gsl::span<uint32_t const>>(),
+        std::declval<gsl::span<float>>()))>>: std::true_type {
+};
+
+/// Writes the scores of the postings `docs`, with frequencies `freqs`, to `out`.
+///
+/// Term scorers that have a block `score` compute each score exactly as their call operator
+/// does, with the factors that depend only on the term computed once, and in loops over the
+/// block that compilers can vectorize; other term scorers are called posting by posting.
+template <typename TermScorer>
+void score_postings(
+    TermScorer const& scorer,
+    gsl::span<uint32_t const> docs,
+    gsl::span<uint32_t const> freqs,
+    gsl::span<float> out)
+{
+    if constexpr (has_block_score<TermScorer>::value) {
+        scorer.score(docs, freqs, out);
+    } else {
+        for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+            out[i] = scorer(docs[i], freqs[i]);
+        }
+    }
+}
+
+/// A term scorer whose scores are multiplied by the weight of the term in the query.
+template <typename TermScorer>
+struct weighted_term_scorer {
+    TermScorer scorer;
+    float weight;
+
+    float operator()(uint32_t doc, uint32_t freq) const { return weight * scorer(doc, freq); }
+
+    void score(
+        gsl::span<uint32_t const> docs,
+        gsl::span<uint32_t const> freqs,
+        gsl::span<float> out) const
+    {
+        score_postings(scorer, docs, freqs, out);
+        for (auto& score: out) {
+            score *= weight;
+        }
+    }
+};
+
+/// Returns the term scorer of `scorer` for `term_id`, weighted by `weight`.
+template <typename Scorer>
+[[nodiscard]] auto make_weighted_term_scorer(Scorer const& scorer, uint64_t term_id, float weight)
+{
+    return weighted_term_scorer<term_scorer_type_t<Scorer>>{
+        make_term_scorer(scorer, term_id), weight};
+}
+
+template <typename Scorer>
+using weighted_term_scorer_type_t = weighted_term_scorer<term_scorer_type_t<Scorer>>;
+
 }  // namespace pisa
@@ -14,18 +14,52 @@ struct qld: public index_scorer<Wand> {
 
     using index_scorer<Wand>::index_scorer;
 
+    /// The scorer of one term, holding the factors that depend only on the term, so that
+    /// scoring a posting reads nothing but the length of its document.
+    struct term_scorer_type {
+        Wand const* wdata;
+        /// `mu` times the probability of the term in the collection.
+        float background;
+
+        float operator()(uint32_t doc, uint32_t freq) const
+        {
+            return score_posting(freq, wdata->doc_len(doc));
+        }
+
+        /// Scores a block of postings, gathering the lengths before the arithmetic.
+        void score(
+            gsl::span<uint32_t const> docs,
+            gsl::span<uint32_t const> freqs,
+            gsl::span<float> out) const
+        {
+            for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+                out[i] = wdata->doc_len(docs[i]);
+            }
+            for (std::ptrdiff_t i = 0; i < docs.size(); ++i) {
+                out[i] = score_posting(freqs[i], out[i]);
+            }
+        }
+
+      private:
+        float score_posting(uint32_t freq, float doc_len) const
+        {
+            float numerator = 1 + freq / background;
+            float denominator = mu / (doc_len + mu);
+            return std::max(0.f, std::log(numerator) + std::log(denominator));
+        }
+    };
+
+    [[nodiscard]] auto static_term_scorer(uint64_t term_id) const -> term_scorer_type
+    {
+        auto const& wdata = this->m_wdata;
+        return {
+            &wdata,
+            mu * ((float)wdata.term_occurrence_count(term_id) / wdata.collection_len())};
+    }
+
     term_scorer_t term_scorer(uint64_t term_id) const override
     {
-        auto s = [&, term_id](uint32_t doc, uint32_t freq) {
-            float numerator = 1
-                + freq
-                    / (this->mu
-                       * ((float)this->m_wdata.term_occurrence_count(term_id)
-                          / this->m_wdata.collection_len()));
-            float denominator = this->mu / (this->m_wdata.doc_len(doc) + this->mu);
-            return std::max(0.f, std::log(numerator) + std::log(denominator));
-        };
-        return s;
+        return static_term_scorer(term_id);
     }
 };
 
@@ -3,19 +3,116 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <type_traits>
 #include <utility>
 
 #include "index_scorer.hpp"
 namespace pisa {
 
+/// Detects WAND data that can hold the weights of the codes of a quantized index.
+template <typename Wand, typename = void>
+struct has_impact_weights: std::false_type {
+};
+
+template <typename Wand>
+struct has_impact_weights<
+    Wand,
+    std::void_t<decltype(std::declval<Wand const&>().impact_weights())>>: std::true_type {
+};
+
+/// Scores a posting by its stored quantized score, its impact, or by the weight of its impact
+/// if the index stores codes of non-uniform buckets, see `bucket_quantizer`.
+struct quantized_term_scorer {
+    uint32_t const* weights = nullptr;
+
+    [[nodiscard]] auto impact(uint32_t freq) const -> uint32_t
+    {
+        return weights == nullptr ? freq : weights[freq];
+    }
+
+    float operator()(uint32_t /* doc */, uint32_t freq) const { return impact(freq); }
+
+    void score(
+        gsl::span<uint32_t const> /* docs */,
+        gsl::span<uint32_t const> freqs,
+        gsl::span<float> out) const
+    {
+        if (weights == nullptr) {
+            std::copy(freqs.begin(), freqs.end(), out.begin());
+        } else {
+            std::transform(freqs.begin(), freqs.end(), out.begin(), [&](uint32_t freq) {
+                return weights[freq];
+            });
+        }
+    }
+};
+
+/// Scores postings by their stored quantized scores.
+///
+/// If the WAND data has a table of impact weights, the index stores codes of non-uniform
+/// buckets, see `bucket_quantizer`, and a posting scores the weight of its code.
 template <typename Wand>
 struct quantized: public index_scorer<Wand> {
     using index_scorer<Wand>::index_scorer;
-    term_scorer_t term_scorer(uint64_t term_id) const
+
+    using term_scorer_type = quantized_term_scorer;
+
+    [[nodiscard]] auto static_term_scorer(uint64_t /* term_id */) const -> term_scorer_type
     {
-        auto s = [](uint32_t doc, uint32_t freq) { return freq; };
-        return s;
+        if constexpr (has_impact_weights<Wand>::value) {
+            auto weights = this->m_wdata.impact_weights();
+            return {weights.empty() ? nullptr : weights.data()};
+        } else {
+            return {};
+        }
     }
+
+    term_scorer_t term_scorer(uint64_t term_id) const override
+    {
+        return static_term_scorer(term_id);
+    }
+};
+
+template <typename Scorer>
+struct is_quantized_scorer: std::false_type {
+};
+
+template <typename Wand>
+struct is_quantized_scorer<quantized<Wand>>: std::true_type {
 };
 
-}  // namespace pisa
\ No newline at end of file
+/// The impacts of a quantized index multiplied by an integer query weight, so that algorithms
+/// summing integer scores add impacts as they are, without converting them to and from floats.
+template <typename Score>
+struct integer_weighted_term_scorer {
+    quantized_term_scorer scorer;
+    Score weight;
+
+    Score operator()(uint32_t /* doc */, uint32_t freq) const
+    {
+        return weight * static_cast<Score>(scorer.impact(freq));
+    }
+};
+
+/// The type of the term scorers of cursors summing scores of type `Score` with `Scorer`: integer
+/// impacts for the quantized scorer with integer scores, and weighted scores otherwise.
+template <typename Scorer, typename Score>
+using score_term_scorer_type_t = std::conditional_t<
+    is_quantized_scorer<Scorer>::value && std::is_integral_v<Score>,
+    integer_weighted_term_scorer<Score>,
+    weighted_term_scorer_type_t<Scorer>>;
+
+/// Returns the term scorer of `scorer` for `term_id`, weighted by `weight`, whose scores are
+/// summed as `Score`, see `score_term_scorer_type_t`.
+template <typename Score, typename Scorer>
+[[nodiscard]] auto make_score_term_scorer(Scorer const& scorer, uint64_t term_id, Score weight)
+    -> score_term_scorer_type_t<Scorer, Score>
+{
+    if constexpr (is_quantized_scorer<Scorer>::value && std::is_integral_v<Score>) {
+        return {scorer.static_term_scorer(term_id), weight};
+    } else {
+        return make_weighted_term_scorer(scorer, term_id, static_cast<float>(weight));
+    }
+}
+
+}  // namespace pisa
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "scorer/index_scorer.hpp"
+
+namespace pisa {
+
+/// A bounded memo of term scores by term and document, shared by the queries of a batch.
+///
+/// Variants of a query, such as its synonym expansions, share most of their terms and score the
+/// same top documents over and over. Term scores depend only on the term and the document, not
+/// on the query, so a memo filled by one variant serves the others. It is direct-mapped: a
+/// colliding entry replaces the previous one, which bounds its memory and keeps lookups to one
+/// probe. It is not thread-safe; each thread uses its own.
+class score_memo {
+  public:
+    /// Holds at least `capacity` entries, rounded up to a power of two.
+    explicit score_memo(std::size_t capacity)
+    {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        m_entries.resize(size);
+        m_mask = size - 1;
+    }
+
+    /// Returns whether the score of `term_id` in `docid` is memoized, setting `score` if so.
+    [[nodiscard]] auto get(uint32_t term_id, uint32_t docid, float& score) -> bool
+    {
+        auto const& entry = m_entries[slot(key(term_id, docid))];
+        if (entry.key == key(term_id, docid)) {
+            score = entry.score;
+            m_hits += 1;
+            return true;
+        }
+        m_misses += 1;
+        return false;
+    }
+
+    void put(uint32_t term_id, uint32_t docid, float score)
+    {
+        auto k = key(term_id, docid);
+        m_entries[slot(k)] = {k, score};
+    }
+
+    /// Forgets every score, e.g., between batches of unrelated queries.
+    void clear()
+    {
+        std::fill(m_entries.begin(), m_entries.end(), entry{});
+        m_hits = 0;
+        m_misses = 0;
+    }
+
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t { return m_entries.size(); }
+    [[nodiscard]] auto hits() const noexcept -> uint64_t { return m_hits; }
+    [[nodiscard]] auto misses() const noexcept -> uint64_t { return m_misses; }
+
+  private:
+    struct entry {
+        uint64_t key = std::numeric_limits<uint64_t>::max();
+        float score = 0;
+    };
+
+    [[nodiscard]] static auto key(uint32_t term_id, uint32_t docid) noexcept -> uint64_t
+    {
+        return (uint64_t(term_id) << 32U) | docid;
+    }
+
+    [[nodiscard]] auto slot(uint64_t key) const noexcept -> std::size_t
+    {
+        // Fibonacci hashing spreads the consecutive docids of a term and the terms of a docid
+        return ((key * 0x9E3779B97F4A7C15ULL) >> 32U) & m_mask;
+    }
+
+    std::vector<entry> m_entries;
+    std::size_t m_mask = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
+
+/// A term scorer that looks its scores up in a `score_memo` before computing them.
+template <typename TermScorer>
+struct memoized_term_scorer {
+    TermScorer scorer;
+    uint32_t term_id;
+    score_memo* memo;
+
+    float operator()(uint32_t doc, uint32_t freq) const
+    {
+        float score;
+        if (memo->get(term_id, doc, score)) {
+            return score;
+        }
+        score = scorer(doc, freq);
+        memo->put(term_id, doc, score);
+        return score;
+    }
+};
+
+/// Returns the term scorer of `scorer` for `term_id`, memoized in `memo` and weighted by
+/// `weight`. Scores are memoized before weighting, so that query variants weighting a term
+/// differently share its scores.
+template <typename Scorer>
+[[nodiscard]] auto make_memoized_weighted_term_scorer(
+    Scorer const& scorer, uint64_t term_id, float weight, score_memo& memo)
+{
+    return weighted_term_scorer<memoized_term_scorer<term_scorer_type_t<Scorer>>>{
+        {make_term_scorer(scorer, term_id), static_cast<uint32_t>(term_id), &memo}, weight};
+}
+
+template <typename Scorer>
+using memoized_weighted_term_scorer_type_t =
+    weighted_term_scorer<memoized_term_scorer<term_scorer_type_t<Scorer>>>;
+
+}  // namespace pisa
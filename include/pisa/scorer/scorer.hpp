@@ -30,4 +30,27 @@ namespace pisa { namespace scorer {
             std::abort();
         }
     };
+
+    /// Calls `fn` with the concrete scorer named `scorer_name`.
+    ///
+    /// Unlike `from_name`, the scorer is passed with its static type, so that cursors built
+    /// from it carry a term scorer that can be inlined into query processing.
+    template <typename Wand, typename Fn>
+    void with_scorer(std::string const& scorer_name, Wand const& wdata, Fn&& fn)
+    {
+        if (scorer_name == "bm25") {
+            fn(bm25<Wand>(wdata));
+        } else if (scorer_name == "qld") {
+            fn(qld<Wand>(wdata));
+        } else if (scorer_name == "pl2") {
+            fn(pl2<Wand>(wdata));
+        } else if (scorer_name == "dph") {
+            fn(dph<Wand>(wdata));
+        } else if (scorer_name == "quantized") {
+            fn(quantized<Wand>(wdata));
+        } else {
+            spdlog::error("Unknown scorer {}", scorer_name);
+            std::abort();
+        }
+    }
 }}  // namespace pisa::scorer
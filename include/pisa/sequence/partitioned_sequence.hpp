@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tbb/task_group.h"
+#include <deque>
 #include <stdexcept>
 
 #include "codec/compact_elias_fano.hpp"
@@ -13,8 +14,15 @@
 
 namespace pisa {
 
-template <typename BaseSequence = indexed_sequence>
+/// With `SkipDirectory`, sequences of more than one partition also store the upper bounds of
+/// their partitions as fixed-width integers, along with the upper bound of every group of
+/// `skip_group_size` partitions, so that `next_geq` finds the partition of a value with a
+/// binary search over the groups and a scan of a single group, rather than with a `next_geq`
+/// on the Elias-Fano sequence of upper bounds.
+template <typename BaseSequence = indexed_sequence, bool SkipDirectory = false>
 struct partitioned_sequence {
+    static constexpr uint64_t skip_group_size = 16;
+
     typedef BaseSequence base_sequence_type;
     typedef typename base_sequence_type::enumerator base_sequence_enumerator;
 
@@ -108,6 +116,17 @@ struct partitioned_sequence {
                 bvb.append_bits(endpoints[p], endpoint_bits);
             }
 
+            if constexpr (SkipDirectory) {
+                uint64_t bound_bits = skip_bound_bits(universe);
+                for (uint64_t p = skip_group_size; p < partitions; p += skip_group_size) {
+                    bvb.append_bits(upper_bounds[p], bound_bits);
+                }
+                bvb.append_bits(upper_bounds[partitions], bound_bits);
+                for (uint64_t p = 1; p <= partitions; ++p) {
+                    bvb.append_bits(upper_bounds[p], bound_bits);
+                }
+            }
+
             bvb.append(bv_sequences);
         }
     }
@@ -160,6 +179,14 @@ struct partitioned_sequence {
                 uint64_t endpoints_size = m_endpoint_bits * (m_partitions - 1);
                 cur_offset += endpoints_size;
 
+                if constexpr (SkipDirectory) {
+                    m_bound_bits = skip_bound_bits(universe);
+                    m_groups_offset = cur_offset;
+                    cur_offset += m_bound_bits * ceil_div(m_partitions, skip_group_size);
+                    m_bounds_offset = cur_offset;
+                    cur_offset += m_bound_bits * m_partitions;
+                }
+
                 m_sequences_offset = cur_offset;
             }
 
@@ -264,6 +291,18 @@ struct partitioned_sequence {
                 }
             }
 
+            if constexpr (SkipDirectory) {
+                uint64_t partition = find_partition(lower_bound);
+                if (partition == m_partitions) {
+                    return move(size());
+                }
+                if (partition == 0 && lower_bound <= m_upper_bounds.move(0).second) {
+                    return move(0);
+                }
+                switch_partition(partition);
+                return next_geq(lower_bound);
+            }
+
             auto ub_it = m_upper_bounds.next_geq(lower_bound);
             if (ub_it.first == 0) {
                 return move(0);
@@ -277,6 +316,53 @@ struct partitioned_sequence {
             return next_geq(lower_bound);
         }
 
+        [[nodiscard]] uint64_t skip_bound(uint64_t offset, uint64_t idx) const
+        {
+            return m_bv->get_word56(offset + idx * m_bound_bits)
+                & ((uint64_t(1) << m_bound_bits) - 1);
+        }
+
+        /// Returns the first partition whose upper bound is at least `lower_bound`, or the
+        /// number of partitions if there is none. Since lists are mostly traversed forward,
+        /// groups following the current partition are searched with an exponential search.
+        [[nodiscard]] uint64_t find_partition(uint64_t lower_bound) const
+        {
+            uint64_t groups = ceil_div(m_partitions, skip_group_size);
+            uint64_t first = 0;
+            uint64_t count = groups;
+            if (lower_bound > m_cur_upper_bound) {
+                first = m_cur_partition / skip_group_size;
+                if (skip_bound(m_groups_offset, first) >= lower_bound) {
+                    return scan_group(m_cur_partition + 1, lower_bound);
+                }
+                uint64_t step = 1;
+                while (first + step < groups
+                       && skip_bound(m_groups_offset, first + step) < lower_bound) {
+                    first += step;
+                    step *= 2;
+                }
+                count = std::min(step + 1, groups - first);
+            }
+            while (count > 0) {
+                uint64_t half = count / 2;
+                bool below = skip_bound(m_groups_offset, first + half) < lower_bound;
+                first = below ? first + half + 1 : first;
+                count = below ? count - half - 1 : half;
+            }
+            if (first == groups) {
+                return m_partitions;
+            }
+            return scan_group(first * skip_group_size, lower_bound);
+        }
+
+        [[nodiscard]] uint64_t scan_group(uint64_t partition, uint64_t lower_bound) const
+        {
+            while (skip_bound(m_bounds_offset, partition) < lower_bound) {
+                ++partition;
+            }
+            return partition;
+        }
+
         void switch_partition(uint64_t partition)
         {
             assert(m_partitions > 1);
@@ -311,6 +397,9 @@ struct partitioned_sequence {
         uint64_t m_endpoints_offset;
         uint64_t m_endpoint_bits;
         uint64_t m_sequences_offset;
+        uint64_t m_bound_bits = 0;
+        uint64_t m_groups_offset = 0;
+        uint64_t m_bounds_offset = 0;
         uint64_t m_size;
         uint64_t m_universe;
 
@@ -328,6 +417,11 @@ struct partitioned_sequence {
     };
 
   private:
+    static uint64_t skip_bound_bits(uint64_t universe)
+    {
+        return std::max<uint64_t>(1, ceil_log2(universe));
+    }
+
     template <typename Iterator>
     static std::vector<uint32_t> compute_partition(
         Iterator begin,
@@ -337,9 +431,9 @@ struct partitioned_sequence {
         // Follwing Giuseppe Ottaviano and Rossano Venturini.
         // 2014. Partitioned Elias-Fano indexes. In Proc. SIGIR
         uint64_t fix_cost = 64,
-        double eps1 = 0.03,
-        double eps2 = 0.3,
-        double eps3 = 0.01)
+        double eps1 = configuration::get().partition_eps1,
+        double eps2 = configuration::get().partition_eps2,
+        double eps3 = configuration::get().partition_eps3)
     {
         std::vector<uint32_t> partition;
 
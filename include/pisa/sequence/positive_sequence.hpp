@@ -1,5 +1,9 @@
 #pragma once
 
+#include <numeric>
+
+#include <gsl/span>
+
 #include "global_parameters.hpp"
 #include "sequence/strict_sequence.hpp"
 #include "util/util.hpp"
@@ -62,6 +66,31 @@ struct positive_sequence {
             return value_type(position, m_cur - prev);
         }
 
+        /// Writes the values at positions `[position, position + out.size())` to `out`. The
+        /// prefix sums are decoded in one sweep of the base sequence and then differenced in a
+        /// loop free of dependencies, rather than with a `move` per value.
+        void decode(uint64_t position, gsl::span<uint64_t> out)
+        {
+            assert(position + out.size() <= m_base_enum.size());
+            if (out.empty()) {
+                return;
+            }
+            uint64_t prev = 0;
+            if (position == 0) {
+                out[0] = m_base_enum.move(0).second;
+            } else {
+                prev = position == m_position + 1 ? m_cur : m_base_enum.move(position - 1).second;
+                out[0] = m_base_enum.next().second;
+            }
+            for (std::size_t i = 1; i < out.size(); ++i) {
+                out[i] = m_base_enum.next().second;
+            }
+            m_position = position + out.size() - 1;
+            m_cur = out[out.size() - 1];
+            std::adjacent_difference(out.begin(), out.end(), out.begin());
+            out[0] -= prev;
+        }
+
         base_sequence_enumerator const& base() const { return m_base_enum; }
 
       private:
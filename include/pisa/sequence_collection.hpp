@@ -1,5 +1,10 @@
 #pragma once
 
+#include <iterator>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+
 #include "bitvector_collection.hpp"
 #include "codec/compact_elias_fano.hpp"
 #include "codec/integer_codes.hpp"
@@ -33,6 +38,51 @@ class sequence_collection {
             m_queue.add_job(ptr, n);
         }
 
+        /// Adds `sequences`, each a nonempty sorted range such as a `std::vector<uint64_t>`, after
+        /// the sequences added before, with the universe of each one past its last element.
+        ///
+        /// Chunks of consecutive sequences of about `chunk_elements` elements are encoded in
+        /// parallel, each into bits of its own, which are then concatenated in order at once.
+        template <typename Sequences>
+        void add_sequences(Sequences const& sequences)
+        {
+            std::vector<std::size_t> chunk_begins{0};
+            std::size_t elements = 0;
+            for (std::size_t idx = 0; idx < sequences.size(); ++idx) {
+                if (std::empty(sequences[idx])) {
+                    throw std::invalid_argument("Sequence must be nonempty");
+                }
+                elements += std::size(sequences[idx]);
+                if (elements >= chunk_elements) {
+                    chunk_begins.push_back(idx + 1);
+                    elements = 0;
+                }
+            }
+            if (chunk_begins.back() != sequences.size()) {
+                chunk_begins.push_back(sequences.size());
+            }
+            auto chunks = chunk_begins.size() - 1;
+            std::vector<bit_vector_builder> bits(chunks);
+            std::vector<std::vector<uint64_t>> endpoints(chunks);
+            tbb::parallel_for(std::size_t(0), chunks, [&](std::size_t chunk) {
+                for (auto idx = chunk_begins[chunk]; idx < chunk_begins[chunk + 1]; ++idx) {
+                    auto const& sequence = sequences[idx];
+                    auto n = std::size(sequence);
+                    auto last = *std::next(std::begin(sequence), n - 1);
+                    write_sequence(bits[chunk], std::begin(sequence), last + 1, n, m_params);
+                    endpoints[chunk].push_back(bits[chunk].size());
+                }
+            });
+
+            // sequences added one by one before must be committed first
+            m_queue.complete();
+            std::vector<bit_vector_builder const*> parts;
+            for (auto const& chunk_bits: bits) {
+                parts.push_back(&chunk_bits);
+            }
+            m_sequences.append_batches(parts, endpoints);
+        }
+
         void build(sequence_collection& sq)
         {
             m_queue.complete();
@@ -41,22 +91,31 @@ class sequence_collection {
         }
 
       private:
+        static constexpr std::size_t chunk_elements = 1 << 20;
+
+        template <typename Iterator>
+        static void write_sequence(
+            bit_vector_builder& bits,
+            Iterator begin,
+            uint64_t last_element,
+            uint64_t n,
+            global_parameters const& params)
+        {
+            // store approximation of the universe as smallest power of two
+            // that can represent last_element
+            uint64_t universe_bits = ceil_log2(last_element);
+            write_gamma(bits, universe_bits);
+            write_gamma_nonzero(bits, n);
+            IndexedSequence::write(bits, begin, (uint64_t(1) << universe_bits) + 1, n, params);
+        }
+
         template <typename Iterator>
         struct sequence_adder: semiasync_queue::job {
             sequence_adder(builder& b, Iterator begin, uint64_t last_element, uint64_t n)
                 : b(b), begin(begin), last_element(last_element), n(n)
             {}
 
-            virtual void prepare()
-            {
-                // store approximation of the universe as smallest power of two
-                // that can represent last_element
-                uint64_t universe_bits = ceil_log2(last_element);
-                write_gamma(bits, universe_bits);
-                write_gamma_nonzero(bits, n);
-                IndexedSequence::write(
-                    bits, begin, (uint64_t(1) << universe_bits) + 1, n, b.m_params);
-            }
+            virtual void prepare() { write_sequence(bits, begin, last_element, n, b.m_params); }
 
             virtual void commit() { b.m_sequences.append(bits); }
 
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
 #include <random>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include <fmt/format.h>
@@ -26,6 +30,7 @@
 #include "binary_collection.hpp"
 #include "invert.hpp"
 #include "io.hpp"
+#include "payload_vector.hpp"
 #include "type_safe.hpp"
 #include "vec_map.hpp"
 
@@ -113,15 +118,28 @@ auto create_random_mapping(
     return create_random_mapping(document_count, shard_count, seed);
 }
 
-void copy_sequence(std::istream& is, std::ostream& os)
-{
-    uint32_t len;
-    is.read(reinterpret_cast<char*>(&len), sizeof(len));
-    os.write(reinterpret_cast<char const*>(&len), sizeof(len));
-    std::vector<char> buf(len * sizeof(uint32_t));
-    is.read(buf.data(), buf.size());
-    os.write(buf.data(), buf.size());
-}
+/// Size of the buffer through which each shard file is written.
+constexpr std::size_t shard_write_buffer_size = 1U << 24U;
+
+/// An output file stream writing through a buffer of `shard_write_buffer_size` bytes.
+class shard_writer {
+  public:
+    explicit shard_writer(std::string const& filename) : m_buffer(shard_write_buffer_size)
+    {
+        // The buffer must be set before the file is opened to be used by the stream.
+        m_stream.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+        m_stream.open(filename, std::ios::binary);
+        if (not m_stream) {
+            throw std::runtime_error(fmt::format("Cannot open {}", filename));
+        }
+    }
+
+    std::ofstream& stream() { return m_stream; }
+
+  private:
+    std::vector<char> m_buffer;
+    std::ofstream m_stream;
+};
 
 auto rearrange_sequences(
     std::string const& input_basename,
@@ -131,39 +149,66 @@ auto rearrange_sequences(
 {
     spdlog::info("Rearranging documents");
     if (not shard_count) {
-        *shard_count = *std::max_element(mapping.begin(), mapping.end()) + 1;
+        shard_count = *std::max_element(mapping.begin(), mapping.end()) + 1;
     }
-    std::ifstream is(input_basename);
-    std::ifstream dis(fmt::format("{}.documents", input_basename));
-    VecMap<Shard_Id, std::ofstream> os;
-    VecMap<Shard_Id, std::ofstream> dos;
-    for (auto shard: ranges::views::iota(0_s, *shard_count)) {
-        spdlog::debug("Initializing file for shard {}", shard.as_int());
-        auto filename = fmt::format("{}.{:03d}", output_basename, shard.as_int());
-        os.emplace_back(filename);
-        constexpr std::array<char, 8> zero{0, 0, 0, 0, 0, 0, 0, 0};
-        os.back().write(zero.data(), zero.size());
-        dos.emplace_back(fmt::format("{}.documents", filename));
+    auto document_count = mapping.size();
+
+    // Sequences and titles are located in the mapped input files, and then copied to the shards
+    // by one task per shard, so that each shard file is written sequentially by a single thread.
+    binary_collection sequences(input_basename.c_str());
+    std::vector<gsl::span<std::uint32_t const>> documents;
+    documents.reserve(document_count);
+    for (auto iter = ++sequences.begin();
+         iter != sequences.end() && documents.size() < document_count;
+         ++iter) {
+        auto seq = *iter;
+        documents.emplace_back(seq.begin() - 1, seq.size() + 1);
     }
-    is.ignore(8);
-    VecMap<Shard_Id, std::uint32_t> shard_sizes(shard_count->as_int(), 0u);
-    spdlog::info("Copying sequences and titles");
-    int idx = 0;
-    for (auto shard: mapping) {
-        spdlog::debug("Copying sequence {} to shard {}", idx++, shard.as_int());
-        copy_sequence(is, os[shard]);
-        std::string title;
-        std::getline(dis, title);
-        dos[shard] << title << '\n';
-        shard_sizes[shard]++;
+    if (documents.size() < document_count) {
+        throw std::invalid_argument(fmt::format(
+            "Mapping has {} documents but forward index only {}",
+            document_count,
+            documents.size()));
     }
-    spdlog::info("Writing sizes");
-    for (auto&& [o, size]: ranges::views::zip(os.as_vector(), shard_sizes.as_vector())) {
-        o.seekp(0);
-        uint32_t one = 1;
-        o.write(reinterpret_cast<char const*>(&one), sizeof(uint32_t));
-        o.write(reinterpret_cast<char const*>(&size), sizeof(uint32_t));
+
+    mio::mmap_source title_file(fmt::format("{}.documents", input_basename));
+    std::vector<std::string_view> titles;
+    titles.reserve(document_count);
+    std::string_view title_data(title_file.data(), title_file.size());
+    while (titles.size() < document_count && not title_data.empty()) {
+        auto end = std::min(title_data.find('\n'), title_data.size());
+        titles.push_back(title_data.substr(0, end));
+        title_data.remove_prefix(std::min(end + 1, title_data.size()));
     }
+    titles.resize(document_count);
+
+    VecMap<Shard_Id, std::vector<std::size_t>> shard_documents(shard_count->as_int());
+    for (std::size_t document = 0; document < document_count; ++document) {
+        shard_documents[mapping[Document_Id(document)]].push_back(document);
+    }
+
+    spdlog::info("Copying sequences and titles");
+    auto shard_ids = ranges::views::iota(0_s, *shard_count) | ranges::to_vector;
+    std::for_each(std::execution::par, shard_ids.begin(), shard_ids.end(), [&](auto shard) {
+        spdlog::debug("Writing shard {}", shard.as_int());
+        auto filename = fmt::format("{}.{:03d}", output_basename, shard.as_int());
+        auto const& shard_docs = shard_documents[shard];
+        {
+            shard_writer writer(filename);
+            std::array<std::uint32_t, 2> header{1, static_cast<std::uint32_t>(shard_docs.size())};
+            writer.stream().write(reinterpret_cast<char const*>(header.data()), sizeof(header));
+            for (auto document: shard_docs) {
+                auto seq = documents[document];
+                writer.stream().write(reinterpret_cast<char const*>(seq.data()), seq.size_bytes());
+            }
+        }
+        {
+            shard_writer writer(fmt::format("{}.documents", filename));
+            for (auto document: shard_docs) {
+                writer.stream() << titles[document] << '\n';
+            }
+        }
+    });
 }
 
 auto process_shard(
@@ -184,12 +229,29 @@ auto process_shard(
     }
 
     spdlog::debug("[Shard {}] Writing terms", shard_id.as_int());
-    std::ofstream tos(fmt::format("{}.terms", basename));
+    std::vector<std::string> shard_terms;
     for (auto&& [term, occurs]: ranges::views::zip(terms.as_vector(), has_term)) {
         if (occurs) {
-            tos << term << '\n';
+            shard_terms.push_back(term);
         }
     }
+    {
+        shard_writer writer(fmt::format("{}.terms", basename));
+        for (auto const& term: shard_terms) {
+            writer.stream() << term << '\n';
+        }
+    }
+    encode_payload_vector(gsl::span<std::string const>(shard_terms))
+        .to_file(fmt::format("{}.termlex", basename));
+    shard_terms = {};
+
+    spdlog::debug("[Shard {}] Writing document lexicon", shard_id.as_int());
+    {
+        std::ifstream title_is(fmt::format("{}.documents", basename));
+        encode_payload_vector(
+            std::istream_iterator<io::Line>(title_is), std::istream_iterator<io::Line>())
+            .to_file(fmt::format("{}.doclex", basename));
+    }
 
     spdlog::debug("[Shard {}] Remapping term IDs", shard_id.as_int());
     if (auto pos = std::find(has_term.begin(), has_term.end(), 1u); pos != has_term.end()) {
@@ -215,6 +277,17 @@ auto partition_fwd_index(
     auto shard_count = *std::max_element(mapping.begin(), mapping.end()) + 1;
     auto shard_ids = ranges::views::iota(0_s, shard_count) | ranges::to_vector;
     rearrange_sequences(input_basename, output_basename, mapping, shard_count);
+    {
+        // The shard of each document, with which a central sample index selects shards.
+        std::ofstream shards_os(fmt::format("{}.shards", output_basename), std::ios::binary);
+        std::vector<std::uint32_t> document_shards(mapping.size());
+        std::transform(mapping.begin(), mapping.end(), document_shards.begin(), [](auto shard) {
+            return static_cast<std::uint32_t>(shard.as_int());
+        });
+        shards_os.write(
+            reinterpret_cast<char const*>(document_shards.data()),
+            document_shards.size() * sizeof(std::uint32_t));
+    }
     spdlog::info("Remapping shards");
     std::for_each(std::execution::par_unseq, shard_ids.begin(), shard_ids.end(), [&](auto&& id) {
         process_shard(input_basename, output_basename, id, terms);
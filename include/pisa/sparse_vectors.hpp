@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+
+#include "io.hpp"
+#include "linear_quantizer.hpp"
+#include "payload_vector.hpp"
+
+namespace pisa::sparse_vectors {
+
+namespace detail {
+
+    /// Reads the JSON values of a single record. Strings are returned as views of the input,
+    /// unless they contain escape sequences, in which case they are decoded into a buffer.
+    class json_reader {
+      public:
+        explicit json_reader(std::string_view text) : m_text(text) {}
+
+        [[nodiscard]] auto peek() -> char
+        {
+            while (m_pos < m_text.size()
+                   && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\r'
+                       || m_text[m_pos] == '\n')) {
+                ++m_pos;
+            }
+            return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+        }
+
+        [[nodiscard]] auto at_end() -> bool
+        {
+            peek();
+            return m_pos == m_text.size();
+        }
+
+        [[nodiscard]] auto consume(char c) -> bool
+        {
+            if (peek() == c) {
+                ++m_pos;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c)
+        {
+            if (not consume(c)) {
+                fail(fmt::format("expected '{}'", c));
+            }
+        }
+
+        [[nodiscard]] auto string(std::string& buffer) -> std::string_view
+        {
+            expect('"');
+            auto begin = m_pos;
+            while (m_pos < m_text.size() && m_text[m_pos] != '"' && m_text[m_pos] != '\\') {
+                ++m_pos;
+            }
+            if (m_pos == m_text.size()) {
+                fail("unterminated string");
+            }
+            if (m_text[m_pos] == '"') {
+                return m_text.substr(begin, m_pos++ - begin);
+            }
+            buffer.assign(m_text.substr(begin, m_pos - begin));
+            while (m_pos < m_text.size()) {
+                char c = m_text[m_pos++];
+                if (c == '"') {
+                    return buffer;
+                }
+                if (c != '\\') {
+                    buffer.push_back(c);
+                    continue;
+                }
+                if (m_pos == m_text.size()) {
+                    break;
+                }
+                switch (char escaped = m_text[m_pos++]; escaped) {
+                case '"':
+                case '\\':
+                case '/': buffer.push_back(escaped); break;
+                case 'b': buffer.push_back('\b'); break;
+                case 'f': buffer.push_back('\f'); break;
+                case 'n': buffer.push_back('\n'); break;
+                case 'r': buffer.push_back('\r'); break;
+                case 't': buffer.push_back('\t'); break;
+                case 'u': append_code_point(buffer); break;
+                default: fail("invalid escape sequence");
+                }
+            }
+            fail("unterminated string");
+        }
+
+        [[nodiscard]] auto number() -> float
+        {
+            peek();
+            auto begin = m_pos;
+            while (m_pos < m_text.size()
+                   && ((m_text[m_pos] >= '0' && m_text[m_pos] <= '9') || m_text[m_pos] == '-'
+                       || m_text[m_pos] == '+' || m_text[m_pos] == '.' || m_text[m_pos] == 'e'
+                       || m_text[m_pos] == 'E')) {
+                ++m_pos;
+            }
+            // the input is not null-terminated, so the digits are copied for `strtof`
+            std::array<char, 64> digits{};
+            auto length = m_pos - begin;
+            if (length == 0 || length >= digits.size()) {
+                fail("invalid number");
+            }
+            std::copy_n(m_text.data() + begin, length, digits.data());
+            char* end = nullptr;
+            float value = std::strtof(digits.data(), &end);
+            if (end != digits.data() + length) {
+                fail("invalid number");
+            }
+            return value;
+        }
+
+        void skip_value()
+        {
+            std::string buffer;
+            switch (peek()) {
+            case '"': (void)string(buffer); break;
+            case '{':
+                ++m_pos;
+                if (not consume('}')) {
+                    do {
+                        (void)string(buffer);
+                        expect(':');
+                        skip_value();
+                    } while (consume(','));
+                    expect('}');
+                }
+                break;
+            case '[':
+                ++m_pos;
+                if (not consume(']')) {
+                    do {
+                        skip_value();
+                    } while (consume(','));
+                    expect(']');
+                }
+                break;
+            case 't': literal("true"); break;
+            case 'f': literal("false"); break;
+            case 'n': literal("null"); break;
+            default: (void)number();
+            }
+        }
+
+        [[noreturn]] void fail(std::string_view what) const
+        {
+            throw std::invalid_argument(
+                fmt::format("Invalid vector record at character {}: {}", m_pos, what));
+        }
+
+      private:
+        void literal(std::string_view word)
+        {
+            if (m_text.substr(m_pos, word.size()) != word) {
+                fail("invalid literal");
+            }
+            m_pos += word.size();
+        }
+
+        [[nodiscard]] auto hex4() -> std::uint32_t
+        {
+            if (m_pos + 4 > m_text.size()) {
+                fail("invalid unicode escape");
+            }
+            std::uint32_t value = 0;
+            for (auto end = m_pos + 4; m_pos < end; ++m_pos) {
+                char c = m_text[m_pos];
+                value <<= 4U;
+                if (c >= '0' && c <= '9') {
+                    value |= c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    value |= c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    value |= c - 'A' + 10;
+                } else {
+                    fail("invalid unicode escape");
+                }
+            }
+            return value;
+        }
+
+        /// Decodes `\uXXXX`, or a surrogate pair of them, into UTF-8.
+        void append_code_point(std::string& buffer)
+        {
+            auto code_point = hex4();
+            if (code_point >= 0xD800 && code_point < 0xDC00) {
+                if (m_text.substr(m_pos, 2) != "\\u") {
+                    fail("unpaired surrogate");
+                }
+                m_pos += 2;
+                auto low = hex4();
+                if (low < 0xDC00 || low >= 0xE000) {
+                    fail("unpaired surrogate");
+                }
+                code_point = 0x10000 + ((code_point - 0xD800) << 10U) + (low - 0xDC00);
+            }
+            if (code_point < 0x80) {
+                buffer.push_back(static_cast<char>(code_point));
+            } else if (code_point < 0x800) {
+                buffer.push_back(static_cast<char>(0xC0 | (code_point >> 6U)));
+                buffer.push_back(static_cast<char>(0x80 | (code_point & 0x3FU)));
+            } else if (code_point < 0x10000) {
+                buffer.push_back(static_cast<char>(0xE0 | (code_point >> 12U)));
+                buffer.push_back(static_cast<char>(0x80 | ((code_point >> 6U) & 0x3FU)));
+                buffer.push_back(static_cast<char>(0x80 | (code_point & 0x3FU)));
+            } else {
+                buffer.push_back(static_cast<char>(0xF0 | (code_point >> 18U)));
+                buffer.push_back(static_cast<char>(0x80 | ((code_point >> 12U) & 0x3FU)));
+                buffer.push_back(static_cast<char>(0x80 | ((code_point >> 6U) & 0x3FU)));
+                buffer.push_back(static_cast<char>(0x80 | (code_point & 0x3FU)));
+            }
+        }
+
+        std::string_view m_text;
+        std::size_t m_pos = 0;
+    };
+
+    /// Calls `fn` with every line of `text` that is not blank.
+    template <typename Fn>
+    void for_each_record(std::string_view text, Fn&& fn)
+    {
+        while (not text.empty()) {
+            auto end = std::min(text.find('\n'), text.size());
+            auto line = text.substr(0, end);
+            if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+                fn(line);
+            }
+            text.remove_prefix(std::min(end + 1, text.size()));
+        }
+    }
+
+    template <typename T>
+    void write_sequence(std::ofstream& os, std::uint32_t length, T const* values)
+    {
+        os.write(reinterpret_cast<char const*>(&length), sizeof(length));
+        os.write(reinterpret_cast<char const*>(values), length * sizeof(T));
+    }
+
+}  // namespace detail
+
+/// Parses a JSON object written on a single line, such as
+/// `{"id": "D1", "contents": "...", "vector": {"term": 1.5, ...}}`, calling `on_id` with the
+/// value of `id`, and `on_weight` with every term of `vector` and its weight. Other fields are
+/// skipped. Throws `std::invalid_argument` if the line is not such an object.
+template <typename IdFn, typename WeightFn>
+void parse_record(std::string_view line, IdFn&& on_id, WeightFn&& on_weight)
+{
+    detail::json_reader reader(line);
+    std::string key_buffer;
+    std::string value_buffer;
+    bool has_id = false;
+    bool has_vector = false;
+    reader.expect('{');
+    if (not reader.consume('}')) {
+        do {
+            auto key = reader.string(key_buffer);
+            reader.expect(':');
+            if (key == "id") {
+                on_id(reader.string(value_buffer));
+                has_id = true;
+            } else if (key == "vector") {
+                reader.expect('{');
+                if (not reader.consume('}')) {
+                    do {
+                        auto term = reader.string(value_buffer);
+                        reader.expect(':');
+                        on_weight(term, reader.number());
+                    } while (reader.consume(','));
+                    reader.expect('}');
+                }
+                has_vector = true;
+            } else {
+                reader.skip_value();
+            }
+        } while (reader.consume(','));
+        reader.expect('}');
+    }
+    if (not reader.at_end()) {
+        reader.fail("trailing characters");
+    }
+    if (not has_id || not has_vector) {
+        reader.fail("record must have an \"id\" and a \"vector\"");
+    }
+}
+
+struct import_stats {
+    std::uint64_t documents = 0;
+    std::uint64_t terms = 0;
+    std::uint64_t postings = 0;
+    float max_weight = 0.0;
+};
+
+/// Builds a binary frequency collection from a JSONL file of learned sparse vectors, with the
+/// weights quantized to `bits` bits in place of frequencies, so that an index built from it
+/// with the `quantized` scorer returns the stored impacts.
+///
+/// Writes `<output>.docs`, `<output>.freqs` and `<output>.sizes`, where the size of a
+/// document is its number of terms, as well as the term and document lexicons written by
+/// `parse_collection`. Terms are numbered in lexicographic order, documents in input order,
+/// and terms with non-positive weights are dropped. The input is read twice, in batches of
+/// about `batch_bytes` bytes parsed concurrently: first to collect the vocabulary and the
+/// largest weight, then to quantize and invert the postings.
+inline auto import_jsonl(
+    std::string const& input_filename,
+    std::string const& output_basename,
+    std::size_t bits,
+    std::size_t batch_bytes = std::size_t(1) << 24U) -> import_stats
+{
+    mio::mmap_source input(input_filename);
+    std::string_view text(input.data(), input.size());
+    std::vector<std::string_view> batches;
+    while (not text.empty()) {
+        auto end = std::min(text.find('\n', std::min(batch_bytes, text.size())), text.size());
+        batches.push_back(text.substr(0, std::min(end + 1, text.size())));
+        text.remove_prefix(batches.back().size());
+    }
+
+    // Terms without escape sequences are views of the mapped input; the others are owned by
+    // the batch that first reads them.
+    struct batch_vocabulary {
+        std::uint64_t documents = 0;
+        float max_weight = 0.0;
+        std::unordered_map<std::string_view, std::uint64_t> document_frequencies;
+        std::deque<std::string> decoded_terms;
+    };
+    spdlog::info("Collecting terms from {} batches", batches.size());
+    std::vector<batch_vocabulary> vocabularies(batches.size());
+    tbb::parallel_for(std::size_t(0), batches.size(), [&](std::size_t batch) {
+        auto& vocabulary = vocabularies[batch];
+        detail::for_each_record(batches[batch], [&](std::string_view line) {
+            auto on_weight = [&](std::string_view term, float weight) {
+                if (weight <= 0.0) {
+                    return;
+                }
+                vocabulary.max_weight = std::max(vocabulary.max_weight, weight);
+                if (auto pos = vocabulary.document_frequencies.find(term);
+                    pos != vocabulary.document_frequencies.end()) {
+                    pos->second += 1;
+                } else {
+                    if (term.data() < input.data() || term.data() >= input.data() + input.size()) {
+                        term = vocabulary.decoded_terms.emplace_back(term);
+                    }
+                    vocabulary.document_frequencies.emplace(term, 1);
+                }
+            };
+            parse_record(line, [](std::string_view) {}, on_weight);
+            vocabulary.documents += 1;
+        });
+    });
+
+    import_stats stats;
+    std::vector<std::uint64_t> first_document(batches.size() + 1, 0);
+    std::unordered_map<std::string_view, std::uint64_t> document_frequencies;
+    for (std::size_t batch = 0; batch < batches.size(); ++batch) {
+        first_document[batch + 1] = first_document[batch] + vocabularies[batch].documents;
+        stats.max_weight = std::max(stats.max_weight, vocabularies[batch].max_weight);
+        for (auto [term, frequency]: vocabularies[batch].document_frequencies) {
+            document_frequencies[term] += frequency;
+        }
+    }
+    stats.documents = first_document.back();
+    if (document_frequencies.empty()) {
+        throw std::invalid_argument("Collection does not contain any positive weight");
+    }
+
+    std::vector<std::string_view> terms;
+    terms.reserve(document_frequencies.size());
+    for (auto const& entry: document_frequencies) {
+        terms.push_back(entry.first);
+    }
+    std::sort(terms.begin(), terms.end());
+    stats.terms = terms.size();
+    std::unordered_map<std::string_view, std::uint32_t> term_ids;
+    std::vector<std::uint64_t> next_posting(terms.size() + 1, 0);
+    for (std::uint32_t term_id = 0; term_id < terms.size(); ++term_id) {
+        term_ids.emplace(terms[term_id], term_id);
+        next_posting[term_id + 1] = next_posting[term_id] + document_frequencies[terms[term_id]];
+    }
+    std::vector<std::uint64_t> list_begins(next_posting.begin(), next_posting.end() - 1);
+    document_frequencies.clear();
+
+    spdlog::info("Quantizing postings of {} terms to {} bits", stats.terms, bits);
+    LinearQuantizer quantizer(stats.max_weight, bits);
+    std::vector<std::uint32_t> documents(next_posting.back());
+    std::vector<std::uint32_t> impacts(next_posting.back());
+    std::vector<std::uint32_t> sizes(stats.documents);
+    std::ofstream title_os(output_basename + ".documents");
+
+    // Batches are parsed concurrently, but postings must be appended to their lists in
+    // document order. Whichever thread finishes the next batch in order appends every batch
+    // that is ready, while the others keep parsing.
+    struct batch_postings {
+        std::string titles;
+        std::vector<std::uint32_t> sizes;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> postings;
+    };
+    std::vector<batch_postings> parsed(batches.size());
+    std::mutex mutex;
+    std::vector<bool> ready(batches.size(), false);
+    std::size_t next_batch = 0;
+    bool appending = false;
+    auto append = [&](std::size_t batch) {
+        auto const& result = parsed[batch];
+        auto document = first_document[batch];
+        auto posting = result.postings.begin();
+        for (auto size: result.sizes) {
+            sizes[document] = size;
+            for (auto end = posting + size; posting != end; ++posting) {
+                auto pos = next_posting[posting->first]++;
+                documents[pos] = document;
+                impacts[pos] = posting->second;
+            }
+            document += 1;
+        }
+        title_os << result.titles;
+        parsed[batch] = {};
+    };
+    auto append_ready_batches = [&](std::size_t batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready[batch] = true;
+        if (appending) {
+            return;
+        }
+        appending = true;
+        while (next_batch < batches.size() and ready[next_batch]) {
+            auto batch = next_batch++;
+            lock.unlock();
+            append(batch);
+            lock.lock();
+        }
+        appending = false;
+    };
+    tbb::parallel_for(std::size_t(0), batches.size(), [&](std::size_t batch) {
+        auto& result = parsed[batch];
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> document_postings;
+        detail::for_each_record(batches[batch], [&](std::string_view line) {
+            document_postings.clear();
+            auto on_id = [&](std::string_view id) {
+                result.titles.append(id);
+                result.titles.push_back('\n');
+            };
+            auto on_weight = [&](std::string_view term, float weight) {
+                if (weight > 0.0) {
+                    document_postings.emplace_back(term_ids.at(term), quantizer(weight));
+                }
+            };
+            parse_record(line, on_id, on_weight);
+            // repeated terms of a document add up to a single posting
+            std::sort(document_postings.begin(), document_postings.end());
+            auto out = document_postings.begin();
+            for (auto in = document_postings.begin(); in != document_postings.end(); ++in) {
+                if (out != document_postings.begin() && std::prev(out)->first == in->first) {
+                    std::prev(out)->second += in->second;
+                } else {
+                    *out++ = *in;
+                }
+            }
+            document_postings.erase(out, document_postings.end());
+            result.sizes.push_back(document_postings.size());
+            result.postings.insert(
+                result.postings.end(), document_postings.begin(), document_postings.end());
+        });
+        append_ready_batches(batch);
+    });
+    title_os.close();
+
+    spdlog::info("Writing the collection to {}", output_basename);
+    {
+        std::ofstream docs_os(output_basename + ".docs");
+        std::ofstream freqs_os(output_basename + ".freqs");
+        auto num_docs = static_cast<std::uint32_t>(stats.documents);
+        detail::write_sequence(docs_os, 1, &num_docs);
+        for (std::size_t term_id = 0; term_id < terms.size(); ++term_id) {
+            // terms repeated in a document leave unused slots at the end of their lists
+            auto begin = list_begins[term_id];
+            auto length = static_cast<std::uint32_t>(next_posting[term_id] - begin);
+            detail::write_sequence(docs_os, length, documents.data() + begin);
+            detail::write_sequence(freqs_os, length, impacts.data() + begin);
+            stats.postings += length;
+        }
+    }
+    {
+        std::ofstream sizes_os(output_basename + ".sizes");
+        detail::write_sequence(sizes_os, sizes.size(), sizes.data());
+    }
+    {
+        std::ofstream term_os(output_basename + ".terms");
+        for (auto term: terms) {
+            term_os << term << '\n';
+        }
+    }
+    encode_payload_vector(terms.begin(), terms.end()).to_file(output_basename + ".termlex");
+    {
+        std::ifstream title_is(output_basename + ".documents");
+        encode_payload_vector(
+            std::istream_iterator<io::Line>(title_is), std::istream_iterator<io::Line>())
+            .to_file(output_basename + ".doclex");
+    }
+    return stats;
+}
+
+}  // namespace pisa::sparse_vectors
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <fmt/format.h>
+#include <tbb/parallel_for.h>
+
+#include "binary_freq_collection.hpp"
+#include "global_statistics.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+#include "topk_queue.hpp"
+#include "util/collection_writer.hpp"
+#include "util/progress.hpp"
+
+namespace pisa {
+
+/// How `prune_inverted_index` chooses the postings to drop.
+///
+/// Term-centric pruning (Carmel et al., 2001) drops the postings of every term scoring less
+/// than a fraction `epsilon` of the k-th highest score of its list, so that the top `k` of a
+/// single-term query is unchanged. Document-centric pruning (Büttcher and Clarke, 2006) keeps
+/// the postings of the highest-scoring fraction of the terms of every document.
+enum class pruning_policy { term_centric, document_centric };
+
+/// Postings of a collection before and after pruning.
+struct pruning_stats {
+    std::size_t postings = 0;
+    std::size_t kept_postings = 0;
+};
+
+/// Returns the lists of `coll`, to read them at random whether or not it has offsets.
+[[nodiscard]] inline auto collection_lists(binary_freq_collection const& coll)
+    -> std::vector<binary_freq_collection::sequence>
+{
+    std::vector<binary_freq_collection::sequence> lists;
+    for (auto const& seq: coll) {
+        lists.push_back(seq);
+    }
+    return lists;
+}
+
+/// Returns the statistics of the collection `wdata` was built from, which has `terms` terms,
+/// so that WAND data of a pruned copy of the collection can score as the original one.
+template <typename Wand>
+[[nodiscard]] auto collection_statistics(Wand const& wdata, std::size_t terms) -> global_statistics
+{
+    std::vector<uint64_t> posting_counts(terms);
+    std::vector<uint64_t> occurrence_counts(terms);
+    for (std::size_t term = 0; term < terms; ++term) {
+        posting_counts[term] = wdata.term_posting_count(term);
+        occurrence_counts[term] = wdata.term_occurrence_count(term);
+    }
+    return global_statistics(
+        wdata.num_docs(),
+        wdata.collection_len(),
+        std::move(posting_counts),
+        std::move(occurrence_counts));
+}
+
+/// Returns the score of every term below which its postings are pruned by term-centric
+/// pruning: `epsilon` times the `k`-th highest score of its list, or zero for lists of at most
+/// `k` postings, which are kept whole.
+template <typename Scorer>
+[[nodiscard]] auto term_centric_thresholds(
+    std::vector<binary_freq_collection::sequence> const& lists,
+    Scorer const& scorer,
+    std::size_t k,
+    float epsilon) -> std::vector<float>
+{
+    std::vector<float> thresholds(lists.size(), 0.0F);
+    tbb::parallel_for(std::size_t(0), lists.size(), [&](std::size_t term) {
+        auto const& seq = lists[term];
+        if (k == 0 || seq.docs.size() <= k) {
+            return;
+        }
+        auto term_scorer = make_term_scorer(scorer, term);
+        std::vector<float> scores;
+        scores.reserve(seq.docs.size());
+        auto freq = seq.freqs.begin();
+        for (auto docid: seq.docs) {
+            scores.push_back(term_scorer(docid, *freq++));
+        }
+        std::nth_element(scores.begin(), scores.begin() + (k - 1), scores.end(), std::greater<>());
+        thresholds[term] = epsilon * scores[k - 1];
+    });
+    return thresholds;
+}
+
+/// Returns the score of every document below which its postings are pruned by
+/// document-centric pruning: the score of its `ceil(ratio * n)`-th highest-scoring term, where
+/// `n` is its number of distinct terms, or zero for documents without terms.
+///
+/// The scores of all postings are held in memory, grouped by document, 4 bytes per posting.
+template <typename Scorer>
+[[nodiscard]] auto document_centric_thresholds(
+    std::vector<binary_freq_collection::sequence> const& lists,
+    std::size_t num_docs,
+    Scorer const& scorer,
+    double ratio) -> std::vector<float>
+{
+    std::vector<std::size_t> offsets(num_docs + 1, 0);
+    for (auto const& seq: lists) {
+        for (auto docid: seq.docs) {
+            offsets[docid + 1] += 1;
+        }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<float> scores(offsets.back());
+    std::vector<std::atomic<std::size_t>> ends(num_docs);
+    for (std::size_t docid = 0; docid < num_docs; ++docid) {
+        ends[docid].store(offsets[docid], std::memory_order_relaxed);
+    }
+    tbb::parallel_for(std::size_t(0), lists.size(), [&](std::size_t term) {
+        auto const& seq = lists[term];
+        auto term_scorer = make_term_scorer(scorer, term);
+        auto freq = seq.freqs.begin();
+        for (auto docid: seq.docs) {
+            scores[ends[docid].fetch_add(1, std::memory_order_relaxed)] =
+                term_scorer(docid, *freq++);
+        }
+    });
+
+    std::vector<float> thresholds(num_docs, 0.0F);
+    tbb::parallel_for(std::size_t(0), num_docs, [&](std::size_t docid) {
+        auto begin = scores.begin() + offsets[docid];
+        auto end = scores.begin() + offsets[docid + 1];
+        auto terms = static_cast<std::size_t>(end - begin);
+        if (terms == 0) {
+            return;
+        }
+        auto kept = std::clamp<std::size_t>(std::ceil(ratio * terms), 1, terms);
+        std::nth_element(begin, begin + (kept - 1), end, std::greater<>());
+        thresholds[docid] = *(begin + (kept - 1));
+    });
+    return thresholds;
+}
+
+/// Writes to `output_basename` the collection `input_basename` without its postings scoring
+/// less than their threshold: `thresholds[term]` with term-centric pruning, and
+/// `thresholds[docid]` with document-centric pruning, see `term_centric_thresholds` and
+/// `document_centric_thresholds`. Document sizes are copied as they are.
+///
+/// Every list keeps at least its highest-scoring posting, so that the pruned collection has
+/// the same terms, with the same IDs, as the original one, and works with the same lexicon
+/// and queries. Lists are pruned in parallel, a batch of terms at a time, and written in term
+/// order.
+template <typename Scorer>
+auto prune_inverted_index(
+    std::string const& input_basename,
+    std::string const& output_basename,
+    Scorer const& scorer,
+    pruning_policy policy,
+    std::vector<float> const& thresholds) -> pruning_stats
+{
+    binary_freq_collection input(input_basename.c_str());
+    boost::filesystem::copy_file(
+        fmt::format("{}.sizes", input_basename),
+        fmt::format("{}.sizes", output_basename),
+        boost::filesystem::copy_option::overwrite_if_exists);
+
+    Freq_Collection_Writer writer(output_basename, static_cast<uint32_t>(input.num_docs()));
+    pisa::progress progress("Pruning inverted index", input.size());
+
+    constexpr std::size_t batch_size = 1U << 12U;
+    std::vector<binary_freq_collection::sequence> batch;
+    std::vector<std::pair<std::vector<std::uint32_t>, std::vector<std::uint32_t>>> pruned;
+    pruning_stats stats;
+    std::size_t first_term = 0;
+    auto flush = [&] {
+        pruned.resize(batch.size());
+        tbb::parallel_for(std::size_t(0), batch.size(), [&](std::size_t idx) {
+            auto term = first_term + idx;
+            auto const& seq = batch[idx];
+            auto term_scorer = make_term_scorer(scorer, term);
+            auto& [docs, freqs] = pruned[idx];
+            docs.clear();
+            freqs.clear();
+            std::pair<float, std::size_t> best{-1.0F, 0};
+            auto freq = seq.freqs.begin();
+            for (auto docid: seq.docs) {
+                auto score = term_scorer(docid, *freq);
+                auto threshold =
+                    policy == pruning_policy::term_centric ? thresholds[term] : thresholds[docid];
+                if (score >= threshold) {
+                    docs.push_back(docid);
+                    freqs.push_back(*freq);
+                }
+                if (docs.empty() && score > best.first) {
+                    best = {score, static_cast<std::size_t>(freq - seq.freqs.begin())};
+                }
+                ++freq;
+            }
+            if (docs.empty() && seq.docs.size() > 0) {
+                docs.push_back(*(seq.docs.begin() + best.second));
+                freqs.push_back(*(seq.freqs.begin() + best.second));
+            }
+        });
+        for (std::size_t idx = 0; idx < batch.size(); ++idx) {
+            stats.postings += batch[idx].docs.size();
+            stats.kept_postings += pruned[idx].first.size();
+            writer.push(
+                first_term + idx, std::move(pruned[idx].first), std::move(pruned[idx].second));
+        }
+        progress.update(batch.size());
+        first_term += batch.size();
+        batch.clear();
+    };
+    for (auto const& seq: input) {
+        batch.push_back(seq);
+        if (batch.size() == batch_size) {
+            flush();
+        }
+    }
+    flush();
+    writer.close();
+    return stats;
+}
+
+/// Returns the IDs of the top `k` documents of `query` over `lists`, highest score first,
+/// scoring every posting of its terms, e.g., to compare the results of a pruned collection
+/// with those of the original one. `accumulator` holds a score per document, and is left
+/// zeroed for the next query.
+template <typename Scorer>
+[[nodiscard]] auto exhaustive_topk(
+    std::vector<binary_freq_collection::sequence> const& lists,
+    Scorer const& scorer,
+    Query const& query,
+    std::size_t k,
+    std::vector<float>& accumulator) -> std::vector<uint64_t>
+{
+    std::vector<uint32_t> touched;
+    for (std::size_t idx = 0; idx < query.terms.size(); ++idx) {
+        auto term = query.terms[idx];
+        if (term >= lists.size()) {
+            continue;
+        }
+        float weight = query.term_weights.empty() ? 1.0F : query.term_weights[idx];
+        auto term_scorer = make_term_scorer(scorer, term);
+        auto freq = lists[term].freqs.begin();
+        for (auto docid: lists[term].docs) {
+            if (accumulator[docid] == 0.0F) {
+                touched.push_back(docid);
+            }
+            accumulator[docid] += weight * term_scorer(docid, *freq++);
+        }
+    }
+    // documents whose scores add up to zero so far are touched again
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    topk_queue topk(k);
+    for (auto docid: touched) {
+        topk.insert(accumulator[docid], docid);
+        accumulator[docid] = 0.0F;
+    }
+    topk.finalize();
+    std::vector<uint64_t> docids;
+    for (auto const& [score, docid]: topk.topk()) {
+        docids.push_back(docid);
+    }
+    return docids;
+}
+
+/// Returns the fraction of the documents of `expected` found in `actual`, or 1 if `expected`
+/// is empty.
+[[nodiscard]] inline auto
+topk_overlap(std::vector<uint64_t> expected, std::vector<uint64_t> actual) -> double
+{
+    if (expected.empty()) {
+        return 1.0;
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    std::vector<uint64_t> common;
+    std::set_intersection(
+        expected.begin(), expected.end(), actual.begin(), actual.end(), std::back_inserter(common));
+    return static_cast<double>(common.size()) / expected.size();
+}
+
+}  // namespace pisa
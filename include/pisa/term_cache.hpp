@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <tbb/enumerable_thread_specific.h>
+
+namespace pisa {
+
+/// A bounded, per-thread memo from raw tokens to their processed form, such as stemmed terms or
+/// term IDs.
+///
+/// Token frequencies are heavily skewed, so a small set of tokens accounts for most lookups.
+/// Each thread keeps two generations of at most `capacity` entries: misses are inserted into the
+/// current one, which replaces the previous one when full, and hits in the previous generation
+/// are promoted, so that frequent tokens survive rotations.
+template <typename Value>
+class term_cache {
+  public:
+    explicit term_cache(std::size_t capacity) : m_capacity(capacity) {}
+
+    /// Returns the cached value of `token`, or computes it with `fn(token)` and caches it.
+    template <typename Fn>
+    [[nodiscard]] auto get_or_compute(std::string const& token, Fn&& fn) -> Value
+    {
+        if (m_capacity == 0) {
+            return fn(token);
+        }
+        auto& local = m_local.local();
+        if (auto pos = local.current.find(token); pos != local.current.end()) {
+            local.hits += 1;
+            return pos->second;
+        }
+        if (auto pos = local.previous.find(token); pos != local.previous.end()) {
+            local.hits += 1;
+            auto entry = local.previous.extract(pos);
+            rotate_if_full(local);
+            return local.current.insert(std::move(entry)).position->second;
+        }
+        local.misses += 1;
+        Value value = fn(token);
+        rotate_if_full(local);
+        local.current.emplace(token, value);
+        return value;
+    }
+
+    [[nodiscard]] auto hits() const -> std::size_t
+    {
+        std::size_t hits = 0;
+        for (auto const& local: m_local) {
+            hits += local.hits;
+        }
+        return hits;
+    }
+
+    [[nodiscard]] auto misses() const -> std::size_t
+    {
+        std::size_t misses = 0;
+        for (auto const& local: m_local) {
+            misses += local.misses;
+        }
+        return misses;
+    }
+
+    [[nodiscard]] auto hit_rate() const -> double
+    {
+        auto lookups = hits() + misses();
+        return lookups > 0 ? static_cast<double>(hits()) / lookups : 0.0;
+    }
+
+  private:
+    using map_type = std::unordered_map<std::string, Value>;
+
+    struct local_cache {
+        map_type current;
+        map_type previous;
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+    };
+
+    void rotate_if_full(local_cache& local) const
+    {
+        if (local.current.size() >= m_capacity) {
+            local.previous = std::move(local.current);
+            local.current = map_type{};
+        }
+    }
+
+    std::size_t m_capacity;
+    tbb::enumerable_thread_specific<local_cache> m_local;
+};
+
+}  // namespace pisa
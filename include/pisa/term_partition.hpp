@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <gsl/span>
+
+#include "binary_freq_collection.hpp"
+#include "query/queries.hpp"
+#include "util/collection_writer.hpp"
+#include "util/progress.hpp"
+
+namespace pisa {
+
+/// Assigns each of the lists of `list_sizes` postings to one of the nodes of `capacities`,
+/// e.g., their memory, so that every node holds about as many postings relative to its
+/// capacity. Returns the node of every list.
+///
+/// The longest lists are assigned first, each to the node that would then be the least loaded
+/// relative to its capacity, so the hottest lists go to the nodes with the largest capacity.
+[[nodiscard]] inline auto
+assign_terms_to_nodes(gsl::span<std::uint64_t const> list_sizes, gsl::span<double const> capacities)
+    -> std::vector<std::uint32_t>
+{
+    if (capacities.empty()) {
+        throw std::invalid_argument("Terms must be assigned to at least one node");
+    }
+    if (std::any_of(capacities.begin(), capacities.end(), [](auto c) { return not(c > 0); })) {
+        throw std::invalid_argument("Node capacities must be positive");
+    }
+    std::vector<std::uint32_t> terms(list_sizes.size());
+    std::iota(terms.begin(), terms.end(), 0);
+    std::stable_sort(terms.begin(), terms.end(), [&](auto lhs, auto rhs) {
+        return list_sizes[lhs] > list_sizes[rhs];
+    });
+    std::vector<std::uint64_t> loads(capacities.size(), 0);
+    std::vector<std::uint32_t> nodes(list_sizes.size(), 0);
+    for (auto term: terms) {
+        std::size_t best = 0;
+        double best_load = 0;
+        for (std::size_t node = 0; node < capacities.size(); ++node) {
+            auto load = static_cast<double>(loads[node] + list_sizes[term]) / capacities[node];
+            if (node == 0 || load < best_load) {
+                best = node;
+                best_load = load;
+            }
+        }
+        loads[best] += list_sizes[term];
+        nodes[term] = static_cast<std::uint32_t>(best);
+    }
+    return nodes;
+}
+
+/// The node of every term of a term-partitioned index, as written by `partition_terms`, and
+/// the ID of the term among the lists held by its node.
+class term_partition {
+  public:
+    /// Takes the node of every term, of at least `node_count` nodes, some of which may hold no
+    /// lists.
+    explicit term_partition(std::vector<std::uint32_t> nodes, std::size_t node_count = 0)
+        : m_nodes(std::move(nodes)), m_node_count(node_count)
+    {
+        for (auto node: m_nodes) {
+            m_node_count = std::max<std::size_t>(m_node_count, node + 1);
+        }
+        std::vector<std::uint32_t> counts(m_node_count, 0);
+        m_local_terms.reserve(m_nodes.size());
+        for (auto node: m_nodes) {
+            m_local_terms.push_back(counts[node]++);
+        }
+    }
+
+    /// Reads the node of every term, written as 32-bit integers, of at least `node_count` nodes.
+    [[nodiscard]] static auto from_file(std::string const& filename, std::size_t node_count = 0)
+        -> term_partition
+    {
+        std::ifstream is(filename, std::ios::binary);
+        if (not is) {
+            throw std::runtime_error(fmt::format("Cannot read {}", filename));
+        }
+        std::vector<std::uint32_t> nodes;
+        std::uint32_t node = 0;
+        while (is.read(reinterpret_cast<char*>(&node), sizeof(node))) {
+            nodes.push_back(node);
+        }
+        return term_partition(std::move(nodes), node_count);
+    }
+
+    void to_file(std::string const& filename) const
+    {
+        std::ofstream os(filename, std::ios::binary);
+        os.write(
+            reinterpret_cast<char const*>(m_nodes.data()), m_nodes.size() * sizeof(std::uint32_t));
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_nodes.size(); }
+    [[nodiscard]] auto node_count() const noexcept -> std::size_t { return m_node_count; }
+    [[nodiscard]] auto node(std::uint32_t term) const -> std::uint32_t { return m_nodes[term]; }
+
+    /// Returns the ID of `term` in the index of its node.
+    [[nodiscard]] auto local_term(std::uint32_t term) const -> std::uint32_t
+    {
+        return m_local_terms[term];
+    }
+
+    /// Splits `query` into the queries of the terms held by each node, with their local IDs.
+    [[nodiscard]] auto split(Query const& query) const -> std::vector<Query>
+    {
+        std::vector<Query> queries(m_node_count);
+        for (std::size_t idx = 0; idx < query.terms.size(); ++idx) {
+            auto term = query.terms[idx];
+            auto& node_query = queries[node(term)];
+            node_query.terms.push_back(local_term(term));
+            if (not query.term_weights.empty()) {
+                node_query.term_weights.push_back(query.term_weights[idx]);
+            }
+        }
+        return queries;
+    }
+
+  private:
+    std::vector<std::uint32_t> m_nodes;
+    std::vector<std::uint32_t> m_local_terms;
+    std::size_t m_node_count = 0;
+};
+
+/// Writes the lists of the collection `input_basename` held by each node of `partition` to
+/// `{output_basename}.{n:03d}` for node `n`, in the order of their terms, so that each node
+/// can be compressed and given WAND data as an index of its own. Every node gets all document
+/// sizes, with which its lists are scored as in the whole collection. The node of every term
+/// is written to `{output_basename}.nodes`.
+inline void partition_terms(
+    std::string const& input_basename,
+    std::string const& output_basename,
+    term_partition const& partition)
+{
+    binary_freq_collection input(input_basename.c_str());
+    if (partition.size() != input.size()) {
+        throw std::invalid_argument(fmt::format(
+            "{} terms are assigned to nodes but the collection has {}",
+            partition.size(),
+            input.size()));
+    }
+    auto node_name = [&](std::size_t node) {
+        return fmt::format("{}.{:03d}", output_basename, node);
+    };
+    std::vector<std::unique_ptr<Freq_Collection_Writer>> writers;
+    for (std::size_t node = 0; node < partition.node_count(); ++node) {
+        writers.push_back(std::make_unique<Freq_Collection_Writer>(
+            node_name(node),
+            static_cast<std::uint32_t>(input.num_docs()),
+            Freq_Collection_Writer::default_buffer_size / partition.node_count()));
+    }
+    pisa::progress progress("Partitioning terms", input.size());
+    std::uint32_t term = 0;
+    for (auto const& list: input) {
+        writers[partition.node(term)]->push(
+            partition.local_term(term),
+            std::vector<std::uint32_t>(list.docs.begin(), list.docs.end()),
+            std::vector<std::uint32_t>(list.freqs.begin(), list.freqs.end()));
+        progress.update(1);
+        ++term;
+    }
+    for (auto& writer: writers) {
+        writer->close();
+    }
+
+    std::ifstream sizes(input_basename + ".sizes", std::ios::binary);
+    std::vector<char> document_sizes(
+        (std::istreambuf_iterator<char>(sizes)), std::istreambuf_iterator<char>());
+    for (std::size_t node = 0; node < partition.node_count(); ++node) {
+        std::ofstream os(node_name(node) + ".sizes", std::ios::binary);
+        os.write(document_sizes.data(), document_sizes.size());
+    }
+    partition.to_file(output_basename + ".nodes");
+}
+
+}  // namespace pisa
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
+#include "binary_freq_collection.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// The k-th highest score of each term, for a few values of k, used to estimate query thresholds
+/// before processing.
+///
+/// Since scores are non-negative, the k-th score of a query is at least the k-th score of any of
+/// its terms alone, so the largest of them is a safe initial threshold for any `k` not greater
+/// than one the table was built with. As with `pair_bounds`, the table must only be used with
+/// the scorer it was computed with, and is not safe if documents are deleted afterwards.
+class term_thresholds {
+  public:
+    /// The values of k stored by `create_wand_data`.
+    static inline std::vector<uint64_t> const default_ks{10, 100, 1000};
+
+    /// Computes the k-th highest score of each term of `index` scored by `scorer`, for each k in
+    /// `ks`, or zero for terms with fewer than k postings.
+    template <typename Index, typename Scorer>
+    static void
+    build(Index const& index, Scorer const& scorer, std::vector<uint64_t> ks, term_thresholds& out)
+    {
+        build_with(index.size(), std::move(ks), out, [&](term_id_type term, topk_queue& topk) {
+            auto list = index[term];
+            auto term_scorer = make_term_scorer(scorer, term);
+            for (; list.docid() < index.num_docs(); list.next()) {
+                topk.insert(term_scorer(list.docid(), list.freq()), list.docid());
+            }
+        });
+    }
+
+    /// Computes the same table from the posting lists of `coll`, skipping `terms_to_drop` as
+    /// `wand_data` does, so that terms are numbered as in an index built without them.
+    template <typename Scorer>
+    static void build(
+        binary_freq_collection const& coll,
+        Scorer const& scorer,
+        std::vector<uint64_t> ks,
+        std::unordered_set<size_t> const& terms_to_drop,
+        term_thresholds& out)
+    {
+        std::vector<binary_freq_collection::sequence> sequences;
+        {
+            size_t term_id = 0;
+            for (auto const& seq: coll) {
+                if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                    sequences.push_back(seq);
+                }
+                term_id += 1;
+            }
+        }
+        build_with(sequences.size(), std::move(ks), out, [&](term_id_type term, topk_queue& topk) {
+            auto const& seq = sequences[term];
+            auto term_scorer = make_term_scorer(scorer, term);
+            auto freq = seq.freqs.begin();
+            for (auto docid: seq.docs) {
+                topk.insert(term_scorer(docid, *freq++), docid);
+            }
+        });
+    }
+
+    /// Returns the values of k the table was built with, in increasing order.
+    [[nodiscard]] auto ks() const noexcept -> mapper::mappable_vector<uint64_t> const&
+    {
+        return m_ks;
+    }
+
+    /// Returns the largest k the table was built with, or zero if it is empty.
+    [[nodiscard]] auto max_k() const noexcept -> uint64_t
+    {
+        return m_ks.size() > 0 ? m_ks[m_ks.size() - 1] : 0;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t
+    {
+        return m_ks.size() > 0 ? m_scores.size() / m_ks.size() : 0;
+    }
+
+    /// Returns the `ks()[level]`-th highest score of `term`.
+    [[nodiscard]] auto score(term_id_type term, std::size_t level) const -> float
+    {
+        return m_scores[term * m_ks.size() + level];
+    }
+
+    /// Returns the number of terms with at least `ks()[level]` scored postings.
+    [[nodiscard]] auto bounded_terms(std::size_t level) const -> std::size_t
+    {
+        std::size_t bounded = 0;
+        for (term_id_type term = 0; term < size(); ++term) {
+            if (score(term, level) > 0) {
+                bounded += 1;
+            }
+        }
+        return bounded;
+    }
+
+    /// Returns a threshold that the k-th score of `query` reaches, computed with the smallest
+    /// stored k not less than `k`, or zero if the table was built with smaller ones only.
+    [[nodiscard]] auto estimate(Query const& query, uint64_t k) const -> float
+    {
+        auto level = std::lower_bound(m_ks.begin(), m_ks.end(), k) - m_ks.begin();
+        if (static_cast<std::size_t>(level) == m_ks.size()) {
+            return 0.0F;
+        }
+        float threshold = 0.0F;
+        for (auto term: query.terms) {
+            if (term < size()) {
+                threshold = std::max(threshold, score(term, level));
+            }
+        }
+        return threshold;
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_ks, "m_ks")(m_scores, "m_scores");
+    }
+
+  private:
+    /// Fills `out` for `num_terms` terms, where `insert(term, topk)` inserts the scores of all
+    /// postings of `term` into `topk`. Terms are processed in parallel.
+    template <typename Insert>
+    static void build_with(
+        std::size_t num_terms, std::vector<uint64_t> ks, term_thresholds& out, Insert&& insert)
+    {
+        std::sort(ks.begin(), ks.end());
+        ks.erase(std::unique(ks.begin(), ks.end()), ks.end());
+        ks.erase(std::remove(ks.begin(), ks.end(), 0U), ks.end());
+        std::vector<float> scores(num_terms * ks.size(), 0.0F);
+        if (not ks.empty()) {
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(0, num_terms),
+                [&](tbb::blocked_range<std::size_t> const& terms) {
+                    topk_queue topk(ks.back());
+                    for (auto term = terms.begin(); term != terms.end(); ++term) {
+                        insert(static_cast<term_id_type>(term), topk);
+                        topk.finalize();
+                        auto const& results = topk.topk();
+                        for (std::size_t level = 0; level < ks.size(); ++level) {
+                            if (results.size() >= ks[level]) {
+                                scores[term * ks.size() + level] = results[ks[level] - 1].first;
+                            }
+                        }
+                        topk.clear();
+                    }
+                });
+        }
+        out.m_ks.steal(ks);
+        out.m_scores.steal(scores);
+    }
+
+    mapper::mappable_vector<uint64_t> m_ks;
+    mapper::mappable_vector<float> m_scores;
+};
+
+}  // namespace pisa
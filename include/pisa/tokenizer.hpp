@@ -2,9 +2,15 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <iterator>
 #include <string>
 #include <string_view>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <boost/config/warning_disable.hpp>
 #include <boost/iterator/filter_iterator.hpp>
 #include <boost/iterator/transform_iterator.hpp>
@@ -79,4 +85,168 @@ class TermTokenizer {
     tokens<lexer_type> lexer_{};
 };
 
+namespace detail {
+
+    [[nodiscard]] inline auto is_alpha(char ch) -> bool
+    {
+        return static_cast<unsigned char>((ch | 0x20) - 'a') < 26;
+    }
+
+    [[nodiscard]] inline auto is_alnum(char ch) -> bool
+    {
+        return is_alpha(ch) || static_cast<unsigned char>(ch - '0') < 10;
+    }
+
+#if defined(__SSE2__)
+    /// Returns a mask with bit `i` set iff byte `i` of the 16 bytes at `data` is alphanumeric.
+    [[nodiscard]] inline auto alnum_mask(char const* data) -> std::uint32_t
+    {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data));
+        auto digits = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+        auto letters = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        auto is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+        auto is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letters, _mm_set1_epi8(25)), letters);
+        return _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter));
+    }
+#endif
+
+    /// Returns the position of the first character at or after `pos` whose alphanumeric class
+    /// is `alnum`, or the size of `text` if there is none.
+    template <bool alnum>
+    [[nodiscard]] inline auto find_class(std::string_view text, std::size_t pos) -> std::size_t
+    {
+#if defined(__SSE2__)
+        for (; pos + 16 <= text.size(); pos += 16) {
+            auto mask = alnum_mask(text.data() + pos);
+            if constexpr (not alnum) {
+                mask ^= 0xFFFFU;
+            }
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while (pos < text.size() && is_alnum(text[pos]) != alnum) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    [[nodiscard]] inline auto find_alpha_end(std::string_view text, std::size_t pos) -> std::size_t
+    {
+        while (pos < text.size() && is_alpha(text[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+}  // namespace detail
+
+/// Splits text into the same terms as `TermTokenizer`, by scanning character classes instead
+/// of running a lexer.
+///
+/// Terms are views into the text, except for abbreviations, whose letters are copied without
+/// the dots to a buffer owned by the iterator; a term is valid until its iterator is
+/// incremented. Alphanumeric runs are found 16 bytes at a time when SSE2 is available.
+class FastTermTokenizer {
+  public:
+    class iterator {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::string_view const*;
+        using reference = std::string_view;
+
+        iterator() = default;
+        explicit iterator(std::string_view text) : m_text(text) { next(); }
+
+        [[nodiscard]] auto operator*() const -> std::string_view
+        {
+            if (m_abbreviation) {
+                return m_buffer;
+            }
+            return m_text.substr(m_first, m_last - m_first);
+        }
+
+        auto operator++() -> iterator&
+        {
+            next();
+            return *this;
+        }
+
+        [[nodiscard]] auto operator==(iterator const& other) const -> bool
+        {
+            return m_first == other.m_first;
+        }
+        [[nodiscard]] auto operator!=(iterator const& other) const -> bool
+        {
+            return m_first != other.m_first;
+        }
+
+      private:
+        void next()
+        {
+            m_first = detail::find_class<true>(m_text, m_cursor);
+            if (m_first == m_text.size()) {
+                m_first = std::string_view::npos;
+                return;
+            }
+            m_last = detail::find_class<false>(m_text, m_first);
+            m_cursor = m_last;
+            m_abbreviation = false;
+            if (m_last == m_text.size()) {
+                return;
+            }
+            if (m_text[m_last] == '.') {
+                m_abbreviation = read_abbreviation();
+            } else if (
+                m_text[m_last] == '\'' && m_last + 1 < m_text.size()
+                && detail::is_alpha(m_text[m_last + 1])) {
+                m_cursor = detail::find_alpha_end(m_text, m_last + 1);
+            }
+        }
+
+        /// Reads two or more runs of letters each followed by a dot, starting at `m_first`.
+        [[nodiscard]] auto read_abbreviation() -> bool
+        {
+            if (detail::find_alpha_end(m_text, m_first) != m_last) {
+                return false;
+            }
+            m_buffer.assign(m_text.data() + m_first, m_last - m_first);
+            auto groups = 1;
+            auto pos = m_last + 1;
+            while (pos < m_text.size() && detail::is_alpha(m_text[pos])) {
+                auto end = detail::find_alpha_end(m_text, pos);
+                if (end == m_text.size() || m_text[end] != '.') {
+                    break;
+                }
+                m_buffer.append(m_text.data() + pos, end - pos);
+                groups += 1;
+                pos = end + 1;
+            }
+            if (groups < 2) {
+                return false;
+            }
+            m_cursor = pos;
+            return true;
+        }
+
+        std::string_view m_text{};
+        std::size_t m_cursor = 0;
+        std::size_t m_first = std::string_view::npos;
+        std::size_t m_last = 0;
+        bool m_abbreviation = false;
+        std::string m_buffer{};
+    };
+
+    explicit FastTermTokenizer(std::string_view text) : m_text(text) {}
+
+    [[nodiscard]] auto begin() const -> iterator { return iterator(m_text); }
+    [[nodiscard]] auto end() const -> iterator { return iterator(); }
+
+  private:
+    std::string_view m_text;
+};
+
 }  // namespace pisa
@@ -1,18 +1,84 @@
 #pragma once
 
+#include "deleted_documents.hpp"
 #include "util/likely.hpp"
 #include "util/util.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <type_traits>
 
 namespace pisa {
 
 using Threshold = float;
-struct topk_queue {
-    using entry_type = std::pair<float, uint64_t>;
 
-    explicit topk_queue(uint64_t k) : m_threshold(0), m_k(k) { m_q.reserve(m_k + 1); }
-    topk_queue(topk_queue const& q) = default;
-    topk_queue& operator=(topk_queue const& q) = default;
+/// A threshold shared by the top-k queues of the threads processing parts of one query, such
+/// as docid ranges or shards.
+///
+/// It is only ever raised, to the k-th score of some part, which the k-th score of the whole
+/// query is at least. Any value read is thus a safe threshold, and relaxed ordering suffices.
+template <typename Score>
+class basic_shared_threshold {
+  public:
+    explicit basic_shared_threshold(Score initial = 0) : m_value(initial) {}
+
+    [[nodiscard]] auto load() const noexcept -> Score
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+    /// Raises the threshold to `value`, unless it is already at least as high.
+    void raise(Score value) noexcept
+    {
+        Score current = load();
+        while (current < value
+               && !m_value.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+  private:
+    std::atomic<Score> m_value;
+};
+
+/// Keeps the `k` highest scores of a query.
+///
+/// `Score` is `float` for regular scores. With quantized scores, an integer type makes all
+/// threshold comparisons integer ones.
+///
+/// For `k` of at most `sorted_max_k`, such as the usual 10, entries are kept in an array sorted by
+/// decreasing score: a new entry is placed after the entries scoring at least as much, counted
+/// without branches, which costs less than maintaining a heap of so few entries. For larger `k`,
+/// entries are kept in a min-heap. Either way, the threshold is always the k-th score. For
+/// `k` of at least `buffered_min_k`, heap maintenance costs more than it saves, so entries are
+/// appended to an unsorted buffer of `2k` entries instead, which is cut down to the `k` highest
+/// with `nth_element` whenever it fills up. The threshold is then only raised at these points, so
+/// it can lag behind the k-th score, but it never exceeds it, and the final results are the same.
+///
+/// A queue may share its threshold with the queues of other threads, see `share_threshold`.
+template <typename Score>
+struct basic_topk_queue {
+    using score_type = Score;
+    using entry_type = std::pair<Score, uint64_t>;
+
+    /// The largest `k` for which entries are kept sorted instead of in a heap.
+    static constexpr uint64_t sorted_max_k = 16;
+
+    /// The smallest `k` for which entries are buffered instead of kept in a heap.
+    static constexpr uint64_t buffered_min_k = 256;
+
+    /// Given `deleted`, documents in it are never inserted. They are checked only
+    /// after the threshold, so that most candidates cost no lookup.
+    explicit basic_topk_queue(uint64_t k, deleted_documents const* deleted = nullptr)
+        : m_threshold(0),
+          m_k(k),
+          m_sorted(k > 0 && k <= sorted_max_k),
+          m_buffered(k >= buffered_min_k),
+          m_deleted(deleted)
+    {
+        m_q.reserve(m_buffered ? 2 * m_k : m_k + 1);
+    }
+    basic_topk_queue(basic_topk_queue const& q) = default;
+    basic_topk_queue& operator=(basic_topk_queue const& q) = default;
 
     [[nodiscard]] constexpr static auto
     min_heap_order(entry_type const& lhs, entry_type const& rhs) noexcept -> bool
@@ -20,44 +86,70 @@ struct topk_queue {
         return lhs.first > rhs.first;
     }
 
-    bool insert(float score) { return insert(score, 0); }
+    bool insert(Score score)
+    {
+        if (PISA_UNLIKELY(not would_enter(score))) {
+            return false;
+        }
+        push(score, 0);
+        return true;
+    }
 
-    bool insert(float score, uint64_t docid)
+    bool insert(Score score, uint64_t docid)
     {
         if (PISA_UNLIKELY(not would_enter(score))) {
             return false;
         }
-        m_q.emplace_back(score, docid);
-        if (PISA_UNLIKELY(m_q.size() <= m_k)) {
-            std::push_heap(m_q.begin(), m_q.end(), min_heap_order);
-            if (PISA_UNLIKELY(m_q.size() == m_k)) {
-                m_threshold = m_q.front().first;
-            }
-        } else {
-            std::pop_heap(m_q.begin(), m_q.end(), min_heap_order);
-            m_q.pop_back();
-            m_threshold = m_q.front().first;
+        if (excludes(docid)) {
+            return false;
         }
+        push(score, docid);
         return true;
     }
 
-    bool would_enter(float score) const { return score >= m_threshold; }
+    bool would_enter(Score score) const
+    {
+        return score >= m_threshold && (m_shared == nullptr || score >= m_shared->load());
+    }
 
     void finalize()
     {
-        std::sort_heap(m_q.begin(), m_q.end(), min_heap_order);
+        if (m_buffered) {
+            truncate();
+            std::sort(m_q.begin(), m_q.end(), min_heap_order);
+        } else if (not m_sorted) {
+            std::sort_heap(m_q.begin(), m_q.end(), min_heap_order);
+        }
         size_t size = std::lower_bound(
                           m_q.begin(),
                           m_q.end(),
                           0,
-                          [](std::pair<float, uint64_t> l, float r) { return l.first > r; })
+                          [](entry_type l, Score r) { return l.first > r; })
             - m_q.begin();
         m_q.resize(size);
     }
 
     [[nodiscard]] std::vector<entry_type> const& topk() const noexcept { return m_q; }
 
-    void set_threshold(Threshold t) noexcept { m_threshold = t; }
+    /// Returns the `rank`-th highest score (from 1) of the finalized results, or zero if there are
+    /// fewer results, so that one query with the largest `k` gives the thresholds of smaller ones.
+    [[nodiscard]] Score score_at_rank(uint64_t rank) const noexcept
+    {
+        return rank > 0 && rank <= m_q.size() ? m_q[rank - 1].first : Score(0);
+    }
+
+    void set_threshold(Score t) noexcept { m_threshold = t; }
+
+    [[nodiscard]] Score threshold() const noexcept
+    {
+        return m_shared == nullptr ? m_threshold : std::max(m_threshold, m_shared->load());
+    }
+
+    /// Makes the queue publish its threshold to `shared` whenever it rises, and only admit
+    /// scores reaching the threshold of `shared` as well, so that the queues of all threads
+    /// processing a query prune with the best threshold found by any of them. The results of
+    /// the queues must then be merged, keeping the `k` highest.
+    void share_threshold(basic_shared_threshold<Score>* shared) noexcept { m_shared = shared; }
 
     void clear() noexcept
     {
@@ -67,10 +159,107 @@ struct topk_queue {
 
     [[nodiscard]] uint64_t size() const noexcept { return m_k; }
 
+    /// Returns whether entries are kept sorted rather than in a heap.
+    [[nodiscard]] bool is_sorted() const noexcept { return m_sorted; }
+
+    /// Returns whether entries are buffered rather than kept in a heap.
+    [[nodiscard]] bool is_buffered() const noexcept { return m_buffered; }
+
+    [[nodiscard]] auto deleted() const noexcept -> deleted_documents const* { return m_deleted; }
+
+    /// Returns whether `docid` is deleted, or filtered out, so that it would never be inserted.
+    /// Algorithms check it before scoring a candidate, to save scoring documents only to drop
+    /// them.
+    [[nodiscard]] auto excludes(uint64_t docid) const -> bool
+    {
+        return m_deleted != nullptr and PISA_UNLIKELY(m_deleted->is_deleted(docid));
+    }
+
   private:
-    float m_threshold;
+    void push(Score score, uint64_t docid)
+    {
+        m_q.emplace_back(score, docid);
+        if (m_sorted) {
+            insert_sorted();
+            return;
+        }
+        if (m_buffered) {
+            if (PISA_UNLIKELY(m_q.size() == 2 * m_k)) {
+                truncate();
+                update_threshold(m_q.back().first);
+            }
+            return;
+        }
+        if (PISA_UNLIKELY(m_q.size() <= m_k)) {
+            std::push_heap(m_q.begin(), m_q.end(), min_heap_order);
+            if (PISA_UNLIKELY(m_q.size() == m_k)) {
+                update_threshold(m_q.front().first);
+            }
+        } else {
+            std::pop_heap(m_q.begin(), m_q.end(), min_heap_order);
+            m_q.pop_back();
+            update_threshold(m_q.front().first);
+        }
+    }
+
+    /// Moves the last entry into place in the sorted entries, dropping the lowest one if there
+    /// are more than `k`.
+    void insert_sorted()
+    {
+        auto entry = m_q.back();
+        std::size_t position = 0;
+        for (auto it = m_q.begin(); it + 1 != m_q.end(); ++it) {
+            position += static_cast<std::size_t>(it->first >= entry.first);
+        }
+        std::move_backward(m_q.begin() + position, m_q.end() - 1, m_q.end());
+        m_q[position] = entry;
+        if (m_q.size() > m_k) {
+            m_q.pop_back();
+        }
+        if (PISA_UNLIKELY(m_q.size() == m_k)) {
+            update_threshold(m_q.back().first);
+        }
+    }
+
+    /// Sets the threshold to the k-th score, and publishes it if shared.
+    void update_threshold(Score kth_score)
+    {
+        m_threshold = kth_score;
+        if (m_shared != nullptr) {
+            m_shared->raise(kth_score);
+        }
+    }
+
+    /// Keeps only the `k` highest entries of the buffer, with the k-th one last.
+    void truncate()
+    {
+        if (m_q.size() > m_k) {
+            std::nth_element(m_q.begin(), m_q.begin() + (m_k - 1), m_q.end(), min_heap_order);
+            m_q.resize(m_k);
+        }
+    }
+
+    Score m_threshold;
     uint64_t m_k;
+    bool m_sorted;
+    bool m_buffered;
+    deleted_documents const* m_deleted;
+    basic_shared_threshold<Score>* m_shared = nullptr;
     std::vector<entry_type> m_q;
 };
 
+using topk_queue = basic_topk_queue<float>;
+
+/// Rounds `score` up to `Score`, e.g., to convert a threshold or an upper bound: an integer score
+/// is at least `score` if and only if it is at least its ceiling.
+template <typename Score>
+[[nodiscard]] auto ceil_score(float score) -> Score
+{
+    if constexpr (std::is_integral_v<Score>) {
+        return static_cast<Score>(std::ceil(std::max(score, 0.0F)));
+    } else {
+        return score;
+    }
+}
+
 }  // namespace pisa
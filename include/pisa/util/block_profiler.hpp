@@ -1,23 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace pisa {
 
+/// Counts the blocks of docids and of frequencies decoded by profiled posting lists.
+///
+/// Counters are laid out in one flat array per thread, with two counters per block (docids,
+/// then frequencies) and the blocks of each list stored contiguously at the offset of its term.
+/// A thread allocates its array when it opens its first list after `init`, so that decoding a
+/// block only increments a counter owned by the thread; arrays are summed over threads by
+/// `dump`.
 class block_profiler {
   public:
-    ~block_profiler()
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        for (auto const& it: m_block_freqs) {
-            delete[] it.second.second;
-        }
-    }
-
-    typedef std::atomic_uint_fast32_t counter_type;
+    using counter_type = uint32_t;
 
     static block_profiler& get()
     {
@@ -25,40 +27,89 @@ class block_profiler {
         return instance;
     }
 
-    static counter_type* open_list(uint32_t term_id, uint32_t blocks)
+    /// Sets the number of blocks of the list of each term, and discards all counts. Must be
+    /// called before any profiled list is opened, and not while lists are being decoded.
+    static void init(std::vector<uint32_t> const& list_blocks)
     {
         block_profiler& instance = get();
         std::lock_guard<std::mutex> lock(instance.m_mutex);
-        auto& v = instance.m_block_freqs[term_id];
-        if (v.second == nullptr) {
-            v.first = 2 * blocks;
-            v.second = new counter_type[v.first];
-            std::fill(v.second, v.second + v.first, 0);
+        instance.m_offsets.assign(list_blocks.size() + 1, 0);
+        for (size_t term = 0; term < list_blocks.size(); ++term) {
+            instance.m_offsets[term + 1] = instance.m_offsets[term] + 2 * list_blocks[term];
         }
-        return v.second;
+        instance.m_thread_counters.clear();
+        ++instance.m_generation;
     }
 
-    static void dump(std::ostream& os)
+    /// Returns the counters of the blocks of `term_id` in the calling thread.
+    static counter_type* open_list(uint32_t term_id, uint32_t blocks)
     {
+        thread_local local_counters local;
         block_profiler& instance = get();
-        std::lock_guard<std::mutex> lock(instance.m_mutex);
-
-        for (auto const& it: instance.m_block_freqs) {
-            os << it.first;
+        if (local.generation != instance.m_generation.load(std::memory_order_acquire)) {
+            local = instance.register_thread();
+        }
+        if (term_id + 1 >= instance.m_offsets.size()
+            || instance.m_offsets[term_id + 1] - instance.m_offsets[term_id] != 2 * blocks) {
+            throw std::out_of_range("Profiled list does not match block_profiler::init");
+        }
+        return local.counters + instance.m_offsets[term_id];
+    }
 
-            for (size_t i = 0; i < it.second.first; ++i) {
-                os << '\t' << it.second.second[i];
+    /// Returns the counters of all blocks, summed over threads, indexed like a thread's array.
+    static auto merged() -> std::vector<uint64_t>
+    {
+        block_profiler& instance = get();
+        std::lock_guard<std::mutex> lock(instance.m_mutex);
+        std::vector<uint64_t> counts(instance.m_offsets.empty() ? 0 : instance.m_offsets.back());
+        for (auto const& thread_counters: instance.m_thread_counters) {
+            for (size_t i = 0; i < counts.size(); ++i) {
+                counts[i] += thread_counters[i];
             }
+        }
+        return counts;
+    }
 
+    /// Writes one line per accessed list: its term ID, then the counters of its blocks.
+    static void dump(std::ostream& os)
+    {
+        auto counts = merged();
+        auto const& offsets = get().m_offsets;
+        for (size_t term = 0; term + 1 < offsets.size(); ++term) {
+            auto begin = counts.begin() + offsets[term];
+            auto end = counts.begin() + offsets[term + 1];
+            if (std::all_of(begin, end, [](auto count) { return count == 0; })) {
+                continue;
+            }
+            os << term;
+            for (auto it = begin; it != end; ++it) {
+                os << '\t' << *it;
+            }
             os << '\n';
         }
     }
 
   private:
-    block_profiler() {}
+    struct local_counters {
+        uint64_t generation = 0;
+        counter_type* counters = nullptr;
+    };
+
+    block_profiler() = default;
+
+    auto register_thread() -> local_counters
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_generation == 0) {
+            throw std::logic_error("block_profiler::init must be called before opening lists");
+        }
+        m_thread_counters.emplace_back(m_offsets.back(), 0);
+        return {m_generation, m_thread_counters.back().data()};
+    }
 
-    // XXX can't do vector of atomics ARGHH
-    std::map<uint32_t, std::pair<size_t, counter_type*>> m_block_freqs;
+    std::vector<uint64_t> m_offsets;
+    std::vector<std::vector<counter_type>> m_thread_counters;
+    std::atomic<uint64_t> m_generation = 0;
     std::mutex m_mutex;
 };
 
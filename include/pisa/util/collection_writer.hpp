@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <tbb/concurrent_bounded_queue.h>
+
+namespace pisa {
+
+/// Writes a file through a large buffer aligned to pages, with `O_DIRECT` where the file system
+/// supports it, so that writing a collection costs a few large writes that bypass the page
+/// cache rather than a write call per sequence. The last, partial block is written without
+/// `O_DIRECT` when the file is closed.
+class Aligned_File_Writer {
+  public:
+    static constexpr std::size_t alignment = 1U << 12U;
+
+    /// Opens `filename`, truncating it, with a buffer of `buffer_size` rounded up to a multiple
+    /// of `alignment`. Throws `std::system_error` if it cannot be opened.
+    Aligned_File_Writer(std::string const& filename, std::size_t buffer_size);
+    Aligned_File_Writer(Aligned_File_Writer const&) = delete;
+    Aligned_File_Writer(Aligned_File_Writer&&) = delete;
+    Aligned_File_Writer& operator=(Aligned_File_Writer const&) = delete;
+    Aligned_File_Writer& operator=(Aligned_File_Writer&&) = delete;
+    ~Aligned_File_Writer();
+
+    /// Appends `[data, data + size)`. Throws `std::system_error` if a write fails.
+    void write(char const* data, std::size_t size);
+
+    /// Writes out what is left in the buffer and closes the file.
+    void close();
+
+    /// Whether the file was opened with `O_DIRECT`.
+    [[nodiscard]] auto direct() const noexcept -> bool { return m_direct; }
+
+  private:
+    void write_buffer(std::size_t size);
+
+    struct Free {
+        void operator()(char* buffer) const;
+    };
+
+    std::string m_filename;
+    int m_fd = -1;
+    bool m_direct = false;
+    std::unique_ptr<char, Free> m_buffer;
+    std::size_t m_capacity;
+    std::size_t m_size = 0;
+};
+
+/// Writes a `binary_freq_collection`, i.e., its `.docs` and `.freqs` files, from posting lists
+/// produced concurrently, e.g., by threads inverting, sampling, or reordering ranges of terms.
+///
+/// As with `Ordered_Writer`, producers push every list with its position, in any order, and
+/// return right away, while a dedicated thread writes the lists in the order of their
+/// positions, through an `Aligned_File_Writer` per file, so that producing overlaps writing and
+/// writing is bound by bandwidth rather than system calls. The offsets of both files are
+/// written along with them, see `base_binary_collection::write_offsets`.
+class Freq_Collection_Writer {
+  public:
+    static constexpr std::size_t default_buffer_size = 1U << 22U;
+
+    /// Starts writing the collection `basename` of `document_count` documents. At most
+    /// `capacity` lists are queued, beyond which producers wait for the writer.
+    Freq_Collection_Writer(
+        std::string const& basename,
+        std::uint32_t document_count,
+        std::size_t buffer_size = default_buffer_size,
+        std::size_t capacity = 1024);
+    Freq_Collection_Writer(Freq_Collection_Writer const&) = delete;
+    Freq_Collection_Writer(Freq_Collection_Writer&&) = delete;
+    Freq_Collection_Writer& operator=(Freq_Collection_Writer const&) = delete;
+    Freq_Collection_Writer& operator=(Freq_Collection_Writer&&) = delete;
+    ~Freq_Collection_Writer();
+
+    /// Queues the list of `documents` and `frequencies` to be written at `position`, counting
+    /// from 0 without gaps. Safe to call from any thread.
+    void push(
+        std::size_t position,
+        std::vector<std::uint32_t> documents,
+        std::vector<std::uint32_t> frequencies);
+
+    /// Waits for all lists pushed so far to be written, and closes the files. Lists whose
+    /// predecessors were never pushed are written last, in order. Rethrows the first error
+    /// the writer ran into.
+    void close();
+
+    /// Returns the number of postings written, once closed.
+    [[nodiscard]] auto postings() const noexcept -> std::size_t { return m_postings; }
+
+  private:
+    using list_type = std::pair<std::vector<std::uint32_t>, std::vector<std::uint32_t>>;
+
+    void write_lists();
+    void join();
+
+    std::string m_basename;
+    Aligned_File_Writer m_docs;
+    Aligned_File_Writer m_freqs;
+    tbb::concurrent_bounded_queue<std::optional<std::pair<std::size_t, list_type>>> m_queue;
+    std::thread m_thread;
+    std::exception_ptr m_error;
+    std::size_t m_postings = 0;
+};
+
+}  // namespace pisa
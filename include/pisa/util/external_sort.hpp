@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <tbb/parallel_sort.h>
+
+namespace pisa {
+
+/// Reads a file of trivially copyable records through a buffer of `buffer_size` records.
+template <typename T>
+class record_reader {
+    static_assert(std::is_trivially_copyable_v<T>, "records are read as raw bytes");
+
+  public:
+    record_reader(std::string const& filename, std::size_t buffer_size)
+        : m_input(filename, std::ios::binary), m_buffer(std::max<std::size_t>(buffer_size, 1))
+    {
+        if (not m_input) {
+            throw std::runtime_error("cannot open " + filename);
+        }
+        fill();
+    }
+
+    [[nodiscard]] auto empty() const -> bool { return m_position == m_size; }
+    [[nodiscard]] auto front() const -> T const& { return m_buffer[m_position]; }
+
+    void pop()
+    {
+        if (++m_position == m_size) {
+            fill();
+        }
+    }
+
+  private:
+    void fill()
+    {
+        m_input.read(
+            reinterpret_cast<char*>(m_buffer.data()),
+            static_cast<std::streamsize>(m_buffer.size() * sizeof(T)));
+        m_size = m_input.gcount() / sizeof(T);
+        m_position = 0;
+    }
+
+    std::ifstream m_input;
+    std::vector<T> m_buffer;
+    std::size_t m_size = 0;
+    std::size_t m_position = 0;
+};
+
+/// Calls `fun` on every record of a file written by `external_sorter`, in order.
+template <typename T, typename Function>
+void for_each_record(std::string const& filename, std::size_t buffer_size, Function fun)
+{
+    for (record_reader<T> reader(filename, buffer_size); not reader.empty(); reader.pop()) {
+        fun(reader.front());
+    }
+}
+
+/// Sorts a sequence of trivially copyable records that does not fit in memory.
+///
+/// Records are buffered until they take `memory_budget` bytes, then sorted in parallel and
+/// written to a temporary run file named after the output. `merge` writes the k-way merge of
+/// the runs to the output file, or passes it to a callback, and removes the runs, reading them
+/// through buffers that share the same budget.
+template <typename T, typename Compare = std::less<T>>
+class external_sorter {
+    static_assert(std::is_trivially_copyable_v<T>, "records are written as raw bytes");
+
+  public:
+    external_sorter(std::string output, std::size_t memory_budget, Compare compare = Compare())
+        : m_output(std::move(output)),
+          m_capacity(std::max<std::size_t>(memory_budget / sizeof(T), 1)),
+          m_compare(compare)
+    {}
+
+    void push(T const& record)
+    {
+        if (m_buffer.size() == m_buffer.capacity()) {
+            m_buffer.reserve(std::min(m_capacity, 2 * m_buffer.size() + 1));
+        }
+        m_buffer.push_back(record);
+        m_size += 1;
+        if (m_buffer.size() == m_capacity) {
+            spill();
+        }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+    [[nodiscard]] auto runs() const -> std::size_t { return m_runs.size(); }
+
+    /// Writes the sorted records to the output file.
+    void merge()
+    {
+        if (m_runs.empty()) {
+            tbb::parallel_sort(m_buffer.begin(), m_buffer.end(), m_compare);
+            write(m_output, m_buffer);
+            m_buffer = {};
+            return;
+        }
+        std::ofstream output(m_output, std::ios::binary);
+        std::vector<T> output_buffer;
+        output_buffer.reserve(std::max<std::size_t>(merge_buffer_size(), 1));
+        merge([&](T const& record) {
+            output_buffer.push_back(record);
+            if (output_buffer.size() == output_buffer.capacity()) {
+                append(output, output_buffer);
+            }
+        });
+        append(output, output_buffer);
+        if (not output) {
+            throw std::runtime_error("cannot write " + m_output);
+        }
+    }
+
+    /// Calls `fun` on every record in sorted order, without writing the output file.
+    template <typename Function>
+    void merge(Function fun)
+    {
+        if (m_runs.empty()) {
+            tbb::parallel_sort(m_buffer.begin(), m_buffer.end(), m_compare);
+            for (auto const& record: m_buffer) {
+                fun(record);
+            }
+            m_buffer = {};
+            return;
+        }
+        if (not m_buffer.empty()) {
+            spill();
+        }
+        m_buffer = {};
+
+        std::size_t buffer_size = merge_buffer_size();
+        std::vector<record_reader<T>> readers;
+        readers.reserve(m_runs.size());
+        for (auto const& run: m_runs) {
+            readers.emplace_back(run, buffer_size);
+        }
+        auto greater = [&](std::size_t lhs, std::size_t rhs) {
+            return m_compare(readers[rhs].front(), readers[lhs].front());
+        };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heap(greater);
+        for (std::size_t run = 0; run < readers.size(); ++run) {
+            if (not readers[run].empty()) {
+                heap.push(run);
+            }
+        }
+
+        while (not heap.empty()) {
+            auto run = heap.top();
+            heap.pop();
+            fun(readers[run].front());
+            readers[run].pop();
+            if (not readers[run].empty()) {
+                heap.push(run);
+            }
+        }
+        readers.clear();
+        for (auto const& run: m_runs) {
+            std::remove(run.c_str());
+        }
+        m_runs.clear();
+    }
+
+  private:
+    /// Run readers and the output buffer share the memory budget.
+    [[nodiscard]] auto merge_buffer_size() const -> std::size_t
+    {
+        return m_capacity / (m_runs.size() + (m_buffer.empty() ? 1 : 2));
+    }
+
+    void spill()
+    {
+        tbb::parallel_sort(m_buffer.begin(), m_buffer.end(), m_compare);
+        m_runs.push_back(m_output + ".run" + std::to_string(m_runs.size()));
+        write(m_runs.back(), m_buffer);
+        m_buffer.clear();
+    }
+
+    static void write(std::string const& filename, std::vector<T>& records)
+    {
+        std::ofstream output(filename, std::ios::binary);
+        append(output, records);
+        if (not output) {
+            throw std::runtime_error("cannot write " + filename);
+        }
+    }
+
+    static void append(std::ofstream& output, std::vector<T>& records)
+    {
+        output.write(
+            reinterpret_cast<char const*>(records.data()),
+            static_cast<std::streamsize>(records.size() * sizeof(T)));
+        records.clear();
+    }
+
+    std::string m_output;
+    std::size_t m_capacity;
+    Compare m_compare;
+    std::vector<T> m_buffer;
+    std::vector<std::string> m_runs;
+    std::size_t m_size = 0;
+};
+
+}  // namespace pisa
@@ -26,8 +26,8 @@ void get_size_stats(
     }
 }
 
-template <typename BlockCodec, bool Profile>
-void get_size_stats(block_freq_index<BlockCodec, Profile>& coll, uint64_t& docs_size, uint64_t& freqs_size)
+template <typename Collection>
+void get_block_size_stats(Collection& coll, uint64_t& docs_size, uint64_t& freqs_size)
 {
     auto size_tree = mapper::size_tree_of(coll);
     size_tree->dump();
@@ -45,6 +45,21 @@ void get_size_stats(block_freq_index<BlockCodec, Profile>& coll, uint64_t& docs_
     docs_size = total_size - freqs_size;
 }
 
+template <typename BlockCodec, bool Profile, bool BlockMaxFreqs>
+void get_size_stats(
+    block_freq_index<BlockCodec, Profile, BlockMaxFreqs>& coll,
+    uint64_t& docs_size,
+    uint64_t& freqs_size)
+{
+    get_block_size_stats(coll, docs_size, freqs_size);
+}
+
+/// The codec tags of the lists are counted with the documents.
+inline void get_size_stats(hybrid_block_index& coll, uint64_t& docs_size, uint64_t& freqs_size)
+{
+    get_block_size_stats(coll, docs_size, freqs_size);
+}
+
 template <typename Collection>
 void dump_stats(Collection& coll, std::string const& type, uint64_t postings)
 {
@@ -8,6 +8,12 @@
     #define USE_POPCNT 0
 #endif
 
+#if defined(__BMI2__)
+    #define USE_PDEP 1
+#else
+    #define USE_PDEP 0
+#endif
+
 #if defined(__GNUC__) || defined(__clang__)
     #define __INTRIN_INLINE inline __attribute__((__always_inline__))
 #elif defined(_MSC_VER)
@@ -75,4 +81,10 @@ namespace pisa { namespace intrinsics {
 
 #endif /* USE_POPCNT */
 
+#if USE_PDEP
+
+    __INTRIN_INLINE uint64_t pdep(uint64_t x, uint64_t mask) { return _pdep_u64(x, mask); }
+
+#endif /* USE_PDEP */
+
 }}  // namespace pisa::intrinsics
@@ -1,22 +1,36 @@
 #pragma once
 #include "binary_freq_collection.hpp"
 #include "invert.hpp"
+#include "util/collection_writer.hpp"
 #include "util/progress.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <tbb/parallel_for.h>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace pisa {
 
-void emit(std::ostream& os, const uint32_t* vals, size_t n)
+inline void emit(std::ostream& os, const uint32_t* vals, size_t n)
 {
     os.write(reinterpret_cast<const char*>(vals), sizeof(*vals) * n);
 }
 
-void emit(std::ostream& os, uint32_t val)
+inline void emit(std::ostream& os, uint32_t val)
 {
     emit(os, &val, 1);
 }
 
-// sample_fn must be stable, it must return a sorted vector
+/// Writes to `output_basename` the sample of the collection `input_basename` whose list of
+/// each term keeps the postings at the positions returned by `sample_fn` for its docids, which
+/// must be sorted. Terms whose sample is empty are dropped and added to `terms_to_drop`.
+///
+/// Lists are sampled in parallel, a batch of terms at a time, and written in term order, so
+/// `sample_fn` must be safe to call concurrently and return the same sample for the same list.
 template <typename SampleFn>
 void sample_inverted_index(
     std::string const& input_basename,
@@ -31,86 +45,95 @@ void sample_inverted_index(
         fmt::format("{}.sizes", output_basename),
         boost::filesystem::copy_option::overwrite_if_exists);
 
-    std::ofstream dos(output_basename + ".docs");
-    std::ofstream fos(output_basename + ".freqs");
-
-    auto document_count = static_cast<uint32_t>(input.num_docs());
-    write_sequence(dos, gsl::make_span<uint32_t const>(&document_count, 1));
+    Freq_Collection_Writer writer(output_basename, static_cast<uint32_t>(input.num_docs()));
     pisa::progress progress("Sampling inverted index", input.size());
+
+    constexpr std::size_t batch_size = 1U << 12U;
+    using sequence_type = std::decay_t<decltype(*input.begin())>;
+    std::vector<sequence_type> batch;
+    std::vector<std::pair<std::vector<std::uint32_t>, std::vector<std::uint32_t>>> samples;
     size_t term = 0;
-    for (auto const& plist: input) {
-        auto sample = sample_fn(plist.docs);
-        if (sample.size() == 0) {
-            terms_to_drop.insert(term);
+    size_t written = 0;
+    auto flush = [&] {
+        samples.resize(batch.size());
+        tbb::parallel_for(std::size_t(0), batch.size(), [&](std::size_t idx) {
+            auto const& plist = batch[idx];
+            auto sample = sample_fn(plist.docs);
+            assert(std::is_sorted(std::begin(sample), std::end(sample)));
+            auto& [sampled_docs, sampled_freqs] = samples[idx];
+            sampled_docs.clear();
+            sampled_freqs.clear();
+            for (auto index: sample) {
+                sampled_docs.push_back(plist.docs[index]);
+                sampled_freqs.push_back(plist.freqs[index]);
+            }
+        });
+        for (auto& [sampled_docs, sampled_freqs]: samples) {
+            if (sampled_docs.empty()) {
+                terms_to_drop.insert(term);
+            } else {
+                writer.push(written++, std::move(sampled_docs), std::move(sampled_freqs));
+            }
             term += 1;
-            progress.update(1);
-            continue;
         }
-        assert(std::is_sorted(std::begin(sample), std::end(sample)));
-        assert(sample.size() > 0);
-
-        std::vector<std::uint32_t> sampled_docs;
-        std::vector<std::uint32_t> sampled_freqs;
-        for (auto index: sample) {
-            sampled_docs.push_back(plist.docs[index]);
-            sampled_freqs.push_back(plist.freqs[index]);
+        progress.update(batch.size());
+        batch.clear();
+    };
+    for (auto const& plist: input) {
+        batch.push_back(plist);
+        if (batch.size() == batch_size) {
+            flush();
         }
-
-        write_sequence(dos, gsl::span<uint32_t const>(sampled_docs));
-        write_sequence(fos, gsl::span<uint32_t const>(sampled_freqs));
-        term += 1;
-        progress.update(1);
     }
+    flush();
+    writer.close();
 }
 
-void reorder_inverted_index(
-    const std::string& input_basename,
-    const std::string& output_basename,
-    const std::vector<uint32_t>& mapping)
+/// Returns which of `num_docs` documents are kept by a sample of rate `rate` stratified by
+/// docid: the docids are split into `strata` ranges of equal length, and each range keeps the
+/// same fraction of its documents, drawn at random with `seed`. Unlike a sample of the whole
+/// range, the sampled docids are thus spread as evenly as the original ones, which matters to
+/// collections ordered by docid, e.g., reordered or sharded by docid ranges.
+[[nodiscard]] inline auto
+sample_docids_stratified(std::size_t num_docs, double rate, std::size_t strata, std::uint64_t seed)
+    -> std::vector<bool>
 {
-    std::ofstream output_mapping(output_basename + ".mapping");
-    emit(output_mapping, mapping.data(), mapping.size());
-
-    binary_collection input_sizes((input_basename + ".sizes").c_str());
-    auto sizes = *input_sizes.begin();
-
-    auto num_docs = sizes.size();
-    std::vector<uint32_t> new_sizes(num_docs);
-    for (size_t i = 0; i < num_docs; ++i) {
-        new_sizes[mapping[i]] = sizes.begin()[i];
-    }
-
-    std::ofstream output_sizes(output_basename + ".sizes");
-    emit(output_sizes, sizes.size());
-    emit(output_sizes, new_sizes.data(), num_docs);
-
-    std::ofstream output_docs(output_basename + ".docs");
-    std::ofstream output_freqs(output_basename + ".freqs");
-    emit(output_docs, 1);
-    emit(output_docs, mapping.size());
-
-    binary_freq_collection input(input_basename.c_str());
-
-    std::vector<std::pair<uint32_t, uint32_t>> pl;
-    pisa::progress reorder_progress(
-        "Reorder inverted index", std::distance(input.begin(), input.end()));
-
-    for (const auto& seq: input) {
-        for (size_t i = 0; i < seq.docs.size(); ++i) {
-            pl.emplace_back(mapping[seq.docs.begin()[i]], seq.freqs.begin()[i]);
+    std::vector<bool> kept(num_docs);
+    strata = std::max<std::size_t>(1, std::min(strata, num_docs));
+    std::mt19937_64 rng(seed);
+    std::vector<std::uint32_t> docids;
+    std::vector<std::uint32_t> sample;
+    for (std::size_t stratum = 0; stratum < strata; ++stratum) {
+        auto begin = num_docs * stratum / strata;
+        auto end = num_docs * (stratum + 1) / strata;
+        docids.resize(end - begin);
+        std::iota(docids.begin(), docids.end(), static_cast<std::uint32_t>(begin));
+        sample.clear();
+        auto sample_size = static_cast<std::size_t>(std::ceil(double(end - begin) * rate));
+        std::sample(docids.begin(), docids.end(), std::back_inserter(sample), sample_size, rng);
+        for (auto docid: sample) {
+            kept[docid] = true;
         }
+    }
+    return kept;
+}
 
-        std::sort(pl.begin(), pl.end());
+/// Writes the `.docs` and `.freqs` files of `output_basename` with the posting lists of
+/// `input_basename`, whose document `d` becomes `mapping[d]`.
+///
+/// Lists keep their lengths, hence their offsets in the output files, which are therefore written
+/// at those offsets by several threads at once, each remapping and sorting the lists of a range
+/// of terms in its own buffers.
+void reorder_postings(
+    const std::string& input_basename,
+    const std::string& output_basename,
+    const std::vector<uint32_t>& mapping);
 
-        emit(output_docs, pl.size());
-        emit(output_freqs, pl.size());
+/// Writes the collection `input_basename`, whose document `d` becomes `mapping[d]`, to
+/// `output_basename`, along with the mapping itself in `.mapping`.
+void reorder_inverted_index(
+    const std::string& input_basename,
+    const std::string& output_basename,
+    const std::vector<uint32_t>& mapping);
 
-        for (const auto& posting: pl) {
-            emit(output_docs, posting.first);
-            emit(output_freqs, posting.second);
-        }
-        pl.clear();
-        reorder_progress.update(1);
-    }
-}
 }  // namespace pisa
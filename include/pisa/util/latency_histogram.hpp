@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "util/broadword.hpp"
+
+namespace pisa {
+
+/// A histogram of latencies in nanoseconds, with the log-linear buckets of an HDR histogram.
+///
+/// Values below `2^precision_bits` have a bucket each; larger values share a bucket with the
+/// values of the same `precision_bits` most significant bits, so that quantiles are reported
+/// within a relative error of `2^(1 - precision_bits)`, i.e., less than 1% by default, over
+/// the whole range of 64-bit values. Histograms of different threads are combined with `merge`.
+class latency_histogram {
+  public:
+    static constexpr uint32_t precision_bits = 8;
+
+    latency_histogram() : m_counts(bucket_count, 0) {}
+
+    void record(uint64_t nanoseconds, uint64_t count = 1)
+    {
+        m_counts[bucket(nanoseconds)] += count;
+        m_count += count;
+        m_sum += nanoseconds * count;
+        m_min = std::min(m_min, nanoseconds);
+        m_max = std::max(m_max, nanoseconds);
+    }
+
+    void merge(latency_histogram const& other)
+    {
+        for (size_t b = 0; b < bucket_count; ++b) {
+            m_counts[b] += other.m_counts[b];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    [[nodiscard]] auto count() const -> uint64_t { return m_count; }
+    [[nodiscard]] auto sum() const -> uint64_t { return m_sum; }
+    [[nodiscard]] auto min() const -> uint64_t { return m_count > 0 ? m_min : 0; }
+    [[nodiscard]] auto max() const -> uint64_t { return m_max; }
+
+    [[nodiscard]] auto mean() const -> double
+    {
+        return m_count > 0 ? static_cast<double>(m_sum) / m_count : 0.0;
+    }
+
+    /// Returns the largest value of the bucket containing the `q`-quantile, bounded by the
+    /// largest recorded value.
+    [[nodiscard]] auto quantile(double q) const -> uint64_t
+    {
+        if (m_count == 0) {
+            return 0;
+        }
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * m_count)));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < bucket_count; ++b) {
+            seen += m_counts[b];
+            if (seen >= rank) {
+                return std::clamp(bucket_upper_bound(b), min(), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    /// Writes the `# HELP` and `# TYPE` lines of a Prometheus summary, which must precede the
+    /// samples of all histograms written with `write_prometheus` under the same `name`.
+    static void
+    write_prometheus_header(std::ostream& os, std::string_view name, std::string_view help)
+    {
+        os << "# HELP " << name << ' ' << help << '\n';
+        os << "# TYPE " << name << " summary\n";
+    }
+
+    /// Writes the samples of a Prometheus summary in seconds, with `labels` (e.g.,
+    /// `algorithm="wand"`) attached to all of them.
+    void write_prometheus(std::ostream& os, std::string_view name, std::string_view labels) const
+    {
+        auto separator = labels.empty() ? "" : ",";
+        for (double q: {0.5, 0.9, 0.95, 0.99, 0.999}) {
+            os << fmt::format(
+                "{}{{{}{}quantile=\"{}\"}} {:.9f}\n",
+                name,
+                labels,
+                separator,
+                q,
+                quantile(q) / 1e9);
+        }
+        os << fmt::format("{}_sum{{{}}} {:.9f}\n", name, labels, m_sum / 1e9);
+        os << fmt::format("{}_count{{{}}} {}\n", name, labels, m_count);
+    }
+
+  private:
+    static constexpr uint64_t exact_values = uint64_t(1) << precision_bits;
+    static constexpr uint64_t sub_buckets = exact_values / 2;
+    static constexpr size_t bucket_count = exact_values + (64 - precision_bits) * sub_buckets;
+
+    /// Values in `[2^(s + precision_bits - 1), 2^(s + precision_bits))` fall in buckets of
+    /// width `2^s`.
+    [[nodiscard]] static auto bucket(uint64_t value) -> size_t
+    {
+        if (value < exact_values) {
+            return value;
+        }
+        uint64_t shift = broadword::msb(value) - (precision_bits - 1);
+        return exact_values + (shift - 1) * sub_buckets + ((value >> shift) - sub_buckets);
+    }
+
+    [[nodiscard]] static auto bucket_upper_bound(size_t b) -> uint64_t
+    {
+        if (b < exact_values) {
+            return b;
+        }
+        uint64_t shift = (b - exact_values) / sub_buckets + 1;
+        uint64_t high = (b - exact_values) % sub_buckets + sub_buckets;
+        return ((high + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = std::numeric_limits<uint64_t>::max();
+    uint64_t m_max = 0;
+};
+
+}  // namespace pisa
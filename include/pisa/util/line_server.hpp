@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fmt/format.h>
+#include <netinet/in.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace pisa {
+
+/// A server answering newline-delimited requests over a TCP or a Unix domain socket.
+///
+/// Every request line is passed to the handler, whose response must consist of zero or more
+/// newline-terminated lines. It is sent back followed by an empty line, which marks the end
+/// of the response. Every connection is served by its own thread, answering its requests in
+/// order; handlers that need to bound the number of concurrent requests must do so themselves.
+class line_server {
+  public:
+    using handler_type = std::function<std::string(std::string const&)>;
+
+    line_server(line_server const&) = delete;
+    line_server& operator=(line_server const&) = delete;
+    line_server(line_server&& other) noexcept
+        : m_fd(std::exchange(other.m_fd, -1)), m_unix_path(std::move(other.m_unix_path))
+    {}
+    line_server& operator=(line_server&&) = delete;
+
+    ~line_server()
+    {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        if (not m_unix_path.empty()) {
+            ::unlink(m_unix_path.c_str());
+        }
+    }
+
+    /// Listens on all interfaces on the given TCP port.
+    [[nodiscard]] static auto tcp(uint16_t port) -> line_server
+    {
+        line_server server(::socket(AF_INET, SOCK_STREAM, 0));
+        int reuse = 1;
+        ::setsockopt(server.m_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        server.bind_and_listen(reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        return server;
+    }
+
+    /// Listens on a Unix domain socket created at `path`.
+    [[nodiscard]] static auto unix_socket(std::string const& path) -> line_server
+    {
+        line_server server(::socket(AF_UNIX, SOCK_STREAM, 0));
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument(fmt::format("Socket path too long: {}", path));
+        }
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        ::unlink(path.c_str());
+        server.bind_and_listen(reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        server.m_unix_path = path;
+        return server;
+    }
+
+    /// Accepts connections and answers their requests until `stop()` is called.
+    void serve(handler_type const& handler)
+    {
+        std::mutex mutex;
+        std::condition_variable all_closed;
+        std::size_t open_connections = 0;
+        while (not m_stopped.load()) {
+            int connection = ::accept(m_fd, nullptr, nullptr);
+            if (connection < 0) {
+                if (m_stopped.load()) {
+                    break;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(
+                    fmt::format("Failed to accept connection: {}", std::strerror(errno)));
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                open_connections += 1;
+            }
+            std::thread([&, connection] {
+                serve_connection(connection, handler);
+                std::lock_guard<std::mutex> lock(mutex);
+                open_connections -= 1;
+                all_closed.notify_all();
+            }).detach();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        all_closed.wait(lock, [&] { return open_connections == 0; });
+    }
+
+    /// Makes `serve()` return once the connections it is serving are closed.
+    void stop()
+    {
+        m_stopped = true;
+        ::shutdown(m_fd, SHUT_RDWR);
+    }
+
+  private:
+    explicit line_server(int fd) : m_fd(fd)
+    {
+        if (m_fd < 0) {
+            throw std::runtime_error(
+                fmt::format("Failed to create socket: {}", std::strerror(errno)));
+        }
+    }
+
+    void bind_and_listen(sockaddr* address, socklen_t length)
+    {
+        if (::bind(m_fd, address, length) < 0) {
+            throw std::runtime_error(
+                fmt::format("Failed to bind socket: {}", std::strerror(errno)));
+        }
+        if (::listen(m_fd, SOMAXCONN) < 0) {
+            throw std::runtime_error(
+                fmt::format("Failed to listen on socket: {}", std::strerror(errno)));
+        }
+    }
+
+    static void serve_connection(int connection, handler_type const& handler)
+    {
+        std::string buffer;
+        char chunk[4096];
+        ssize_t received;
+        while ((received = ::recv(connection, chunk, sizeof(chunk), 0)) > 0) {
+            buffer.append(chunk, received);
+            std::size_t begin = 0;
+            for (auto end = buffer.find('\n'); end != std::string::npos;
+                 end = buffer.find('\n', begin)) {
+                std::string response = handler(buffer.substr(begin, end - begin));
+                response.push_back('\n');
+                if (not send_all(connection, response)) {
+                    ::close(connection);
+                    return;
+                }
+                begin = end + 1;
+            }
+            buffer.erase(0, begin);
+        }
+        ::close(connection);
+    }
+
+    static bool send_all(int connection, std::string const& data)
+    {
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written =
+                ::send(connection, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written < 0) {
+                spdlog::warn("Failed to send response: {}", std::strerror(errno));
+                return false;
+            }
+            sent += written;
+        }
+        return true;
+    }
+
+    int m_fd;
+    std::string m_unix_path;
+    std::atomic_bool m_stopped{false};
+};
+
+}  // namespace pisa
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace pisa { namespace numa {
+
+    /// How a copy of an index is placed in the memory of the NUMA nodes.
+    enum class policy {
+        /// Every node gets its own copy, written by a thread running on that node, so that its
+        /// pages are allocated locally on first touch.
+        replicate,
+        /// A single copy, whose pages are interleaved across the nodes with `mbind`.
+        interleave,
+    };
+
+    /// Returns the policy called `name`, i.e., `replicate` or `interleave`. Throws
+    /// `std::invalid_argument` for unknown names.
+    [[nodiscard]] auto parse_policy(std::string_view name) -> policy;
+
+    /// Returns the CPUs of each NUMA node, as listed in `/sys/devices/system/node`, or a single
+    /// node with all online CPUs if the topology is not available.
+    [[nodiscard]] auto node_cpus() -> std::vector<std::vector<int>>;
+
+    /// Restricts the calling thread to run on `cpus`. Throws `std::system_error` on failure.
+    void pin_thread(std::vector<int> const& cpus);
+
+    /// A copy of a byte range in anonymous memory placed on one or more NUMA nodes.
+    class replica {
+      public:
+        replica() = default;
+        replica(replica const&) = delete;
+        replica(replica&& other) noexcept;
+        replica& operator=(replica const&) = delete;
+        replica& operator=(replica&& other) noexcept;
+        ~replica();
+
+        /// Copies `[data, data + size)` from a thread pinned to `cpus`, which places the copy on
+        /// their node by first touch.
+        [[nodiscard]] static auto
+        on_node(char const* data, std::size_t size, std::vector<int> const& cpus) -> replica;
+
+        /// Copies `[data, data + size)` into pages interleaved over the first `nodes` nodes. If the
+        /// kernel rejects the policy, the copy is placed by first touch, with a warning.
+        [[nodiscard]] static auto interleaved(char const* data, std::size_t size, std::size_t nodes)
+            -> replica;
+
+        [[nodiscard]] auto data() const noexcept -> char const* { return m_data; }
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+
+      private:
+        explicit replica(std::size_t size);
+        void release() noexcept;
+
+        char* m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+
+}}  // namespace pisa::numa
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <tbb/concurrent_bounded_queue.h>
+
+namespace pisa {
+
+/// Writes chunks of text produced concurrently, e.g., the formatted results of queries run in
+/// parallel, in the order of their positions, from a dedicated thread.
+///
+/// Producers push a chunk with its position, in any order, and return right away. The writer
+/// thread holds back chunks until all chunks before them have arrived, and collects them into a
+/// buffer written out once it exceeds `buffer_size`, so that writing overlaps producing and
+/// costs a few large writes.
+class Ordered_Writer {
+  public:
+    static constexpr std::size_t default_buffer_size = 1U << 20U;
+
+    explicit Ordered_Writer(
+        std::ostream& os,
+        std::size_t buffer_size = default_buffer_size,
+        std::size_t capacity = 1024)
+        : m_os(os), m_buffer_size(buffer_size)
+    {
+        m_queue.set_capacity(capacity);
+        m_thread = std::thread([this] { write_chunks(); });
+    }
+    Ordered_Writer(Ordered_Writer const&) = delete;
+    Ordered_Writer(Ordered_Writer&&) = delete;
+    Ordered_Writer& operator=(Ordered_Writer const&) = delete;
+    Ordered_Writer& operator=(Ordered_Writer&&) = delete;
+    ~Ordered_Writer() { close(); }
+
+    /// Queues `chunk` to be written at `position`. Safe to call from any thread.
+    void push(std::size_t position, std::string chunk)
+    {
+        m_queue.push(std::make_pair(position, std::move(chunk)));
+    }
+
+    /// Waits for every chunk pushed so far to be written and flushes the stream. Chunks whose
+    /// predecessors were never pushed are written last, in order.
+    void close()
+    {
+        if (not m_thread.joinable()) {
+            return;
+        }
+        m_queue.push(std::nullopt);
+        m_thread.join();
+    }
+
+  private:
+    void write_chunks()
+    {
+        std::map<std::size_t, std::string> pending;
+        std::size_t next = 0;
+        std::string buffer;
+        buffer.reserve(m_buffer_size);
+        auto append = [&](std::string const& chunk) {
+            buffer.append(chunk);
+            if (buffer.size() >= m_buffer_size) {
+                m_os.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        };
+        while (true) {
+            std::optional<std::pair<std::size_t, std::string>> chunk;
+            m_queue.pop(chunk);
+            if (not chunk) {
+                break;
+            }
+            if (chunk->first != next) {
+                pending.emplace(chunk->first, std::move(chunk->second));
+                continue;
+            }
+            append(chunk->second);
+            next += 1;
+            for (auto pos = pending.begin(); pos != pending.end() and pos->first == next;
+                 pos = pending.erase(pos)) {
+                append(pos->second);
+                next += 1;
+            }
+        }
+        for (auto const& [position, chunk]: pending) {
+            append(chunk);
+        }
+        m_os.write(buffer.data(), buffer.size());
+        m_os.flush();
+    }
+
+    std::ostream& m_os;
+    std::size_t m_buffer_size;
+    tbb::concurrent_bounded_queue<std::optional<std::pair<std::size_t, std::string>>> m_queue;
+    std::thread m_thread;
+};
+
+}  // namespace pisa
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace pisa {
+
+/// Hardware events counted by `perf_counters`.
+enum class perf_event : std::size_t {
+    cycles,
+    instructions,
+    l1d_misses,
+    llc_misses,
+    dtlb_misses,
+    branch_misses,
+};
+
+constexpr std::size_t perf_event_count = 6;
+constexpr std::array<char const*, perf_event_count> perf_event_names{
+    "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses"};
+
+/// Counts of hardware events, e.g., the difference between two readings of `perf_counters`.
+struct perf_sample {
+    std::array<std::uint64_t, perf_event_count> counts{};
+
+    [[nodiscard]] auto operator[](perf_event event) const -> std::uint64_t
+    {
+        return counts[static_cast<std::size_t>(event)];
+    }
+
+    auto operator+=(perf_sample const& other) -> perf_sample&
+    {
+        for (std::size_t event = 0; event < perf_event_count; ++event) {
+            counts[event] += other.counts[event];
+        }
+        return *this;
+    }
+
+    /// The counts of `this` minus those of an earlier reading.
+    [[nodiscard]] auto operator-(perf_sample const& earlier) const -> perf_sample
+    {
+        perf_sample difference;
+        for (std::size_t event = 0; event < perf_event_count; ++event) {
+            difference.counts[event] =
+                counts[event] >= earlier.counts[event] ? counts[event] - earlier.counts[event] : 0;
+        }
+        return difference;
+    }
+
+    /// Adds the counts divided by `runs`, and the instructions per cycle, to a `stats_line`.
+    template <typename StatsLine>
+    auto dump(StatsLine& line, double runs = 1) const -> StatsLine&
+    {
+        for (std::size_t event = 0; event < perf_event_count; ++event) {
+            line(perf_event_names[event], counts[event] / runs);
+        }
+        auto cycles = (*this)[perf_event::cycles];
+        return line("ipc", cycles > 0 ? double((*this)[perf_event::instructions]) / cycles : 0.0);
+    }
+};
+
+/// Counts the hardware events of the calling thread in user space with `perf_event_open`.
+///
+/// Each event is counted from construction on, and `read` returns the counts so far, so that
+/// the events of some work are the difference of the readings before and after it. When the
+/// hardware has fewer counters than events, the kernel multiplexes them, and counts are
+/// extrapolated from the time each event was counted. Events that cannot be opened, e.g.,
+/// because of `/proc/sys/kernel/perf_event_paranoid`, in a virtual machine, or on hardware
+/// without them, read as zero.
+class perf_counters {
+  public:
+    perf_counters();
+    perf_counters(perf_counters const&) = delete;
+    perf_counters& operator=(perf_counters const&) = delete;
+    ~perf_counters();
+
+    /// Returns whether `event` is counted.
+    [[nodiscard]] auto counts(perf_event event) const -> bool
+    {
+        return m_fds[static_cast<std::size_t>(event)] >= 0;
+    }
+
+    /// Returns whether any event is counted.
+    [[nodiscard]] auto available() const -> bool;
+
+    [[nodiscard]] auto read() const -> perf_sample;
+
+  private:
+    std::array<int, perf_event_count> m_fds{};
+};
+
+}  // namespace pisa
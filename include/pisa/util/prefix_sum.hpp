@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <x86intrin.h>
+
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/// Turns a block of decoded docid gaps into absolute docids, in place.
+///
+/// Block codecs store `d[i] - d[i - 1] - 1` for every posting but the first one,
+/// which is expected to be already absolute. After the call, `buf[i]` holds `d[i]`.
+/// This is an inclusive prefix sum of `buf[i] + 1`, computed 8 (AVX2) or 4 (SSE2)
+/// lanes at a time when available.
+PISA_ALWAYSINLINE void gaps_to_docids(uint32_t* buf, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    uint32_t running = buf[0];
+    size_t i = 1;
+#if defined(__AVX2__)
+    __m256i const ones = _mm256_set1_epi32(1);
+    __m256i const last_lane = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_set1_epi32(running);
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_add_epi32(_mm256_loadu_si256((__m256i const*)(buf + i)), ones);
+        // prefix sums within each 128-bit lane
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        // propagate the sum of the low lane into the high lane
+        __m256i low_total = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(3));
+        x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(), low_total, 0xF0));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256((__m256i*)(buf + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, last_lane);
+    }
+    running = buf[i - 1];
+#elif defined(__SSE2__)
+    __m128i const ones = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(running);
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_add_epi32(_mm_loadu_si128((__m128i const*)(buf + i)), ones);
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128((__m128i*)(buf + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    running = buf[i - 1];
+#endif
+    for (; i < n; ++i) {
+        running += buf[i] + 1;
+        buf[i] = running;
+    }
+}
+
+}  // namespace pisa
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pisa {
+
+/// A monotonic arena for the short-lived allocations of a query, such as its cursors.
+///
+/// Allocations bump a pointer into the current chunk, and deallocations are no-ops: the memory
+/// is reclaimed all at once by `reset()`, which keeps the chunks for the next query. Once the
+/// arena has grown to the largest query it serves, queries allocate nothing from the heap.
+/// An arena must only be used by one thread at a time; `local()` gives one per thread.
+class query_arena {
+  public:
+    static constexpr std::size_t default_chunk_size = 16 * 1024;
+
+    explicit query_arena(std::size_t chunk_size = default_chunk_size) : m_chunk_size(chunk_size)
+    {}
+
+    query_arena(query_arena const&) = delete;
+    query_arena& operator=(query_arena const&) = delete;
+
+    /// Returns the arena of the calling thread.
+    [[nodiscard]] static auto local() -> query_arena&
+    {
+        thread_local query_arena arena;
+        return arena;
+    }
+
+    [[nodiscard]] auto allocate(std::size_t size, std::size_t alignment) -> void*
+    {
+        while (m_chunk < m_chunks.size()) {
+            auto& chunk = m_chunks[m_chunk];
+            auto begin = reinterpret_cast<std::uintptr_t>(chunk.data.get());
+            auto offset = ((begin + m_offset + alignment - 1) & ~(alignment - 1)) - begin;
+            if (offset + size <= chunk.size) {
+                m_offset = offset + size;
+                return chunk.data.get() + offset;
+            }
+            m_chunk += 1;
+            m_offset = 0;
+        }
+        std::size_t chunk_size = std::max(m_chunk_size, size + alignment);
+        m_chunks.push_back(chunk_type{std::make_unique<std::byte[]>(chunk_size), chunk_size});
+        return allocate(size, alignment);
+    }
+
+    /// Releases all allocations at once.
+    void reset() noexcept
+    {
+        m_chunk = 0;
+        m_offset = 0;
+    }
+
+    /// Returns the memory held by the arena, in bytes.
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t
+    {
+        std::size_t capacity = 0;
+        for (auto const& chunk: m_chunks) {
+            capacity += chunk.size;
+        }
+        return capacity;
+    }
+
+    /// Resets the arena when going out of scope, e.g., at the end of a query.
+    class scope {
+      public:
+        explicit scope(query_arena& arena) : m_arena(arena) {}
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+        ~scope() { m_arena.reset(); }
+
+      private:
+        query_arena& m_arena;
+    };
+
+  private:
+    struct chunk_type {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    std::size_t m_chunk_size;
+    std::vector<chunk_type> m_chunks;
+    std::size_t m_chunk = 0;
+    std::size_t m_offset = 0;
+};
+
+/// A standard allocator drawing from a `query_arena`.
+template <typename T>
+class arena_allocator {
+  public:
+    using value_type = T;
+
+    explicit arena_allocator(query_arena& arena) noexcept : m_arena(&arena) {}
+
+    template <typename U>
+    arena_allocator(arena_allocator<U> const& other) noexcept : m_arena(&other.arena())
+    {}
+
+    [[nodiscard]] auto allocate(std::size_t n) -> T*
+    {
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) noexcept {}
+
+    [[nodiscard]] auto arena() const noexcept -> query_arena& { return *m_arena; }
+
+    template <typename U>
+    bool operator==(arena_allocator<U> const& other) const noexcept
+    {
+        return m_arena == &other.arena();
+    }
+
+    template <typename U>
+    bool operator!=(arena_allocator<U> const& other) const noexcept
+    {
+        return not(*this == other);
+    }
+
+  private:
+    query_arena* m_arena;
+};
+
+template <typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+
+}  // namespace pisa
@@ -59,8 +59,3 @@ class single_init_vector: public std::vector<single_init_entry<T>> {
     size_t m_generation = 1;
     T m_defaultValue = Default<T>::value;
 };
-
-struct degree_map_pair {
-    single_init_vector<size_t>& left;
-    single_init_vector<size_t>& right;
-};
\ No newline at end of file
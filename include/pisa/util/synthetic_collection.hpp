@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pisa {
+
+/// The shape of a synthetic collection, see `write_synthetic_collection`.
+struct synthetic_collection_params {
+    std::uint32_t documents = 1'000'000;
+    std::uint32_t terms = 100'000;
+    /// Exponent of the Zipf law of document frequencies: term `t` is in about
+    /// `max_df_ratio * documents / (t + 1)^zipf_exponent` documents.
+    double zipf_exponent = 1.0;
+    double max_df_ratio = 0.3;
+    /// Fraction of the postings of a sparse list drawn from a window of `cluster_width` times
+    /// its length around a random center, the others being drawn uniformly. 0 gives random
+    /// document IDs; 1, a collection as clustered as a good reordering would leave it.
+    double clustering = 0.5;
+    double cluster_width = 4.0;
+    /// Document lengths follow a log-normal law of this mean and shape.
+    double mean_length = 300.0;
+    double length_sigma = 0.8;
+    /// Mean frequency of a term in a document of average length, at least 1.
+    double mean_freq = 2.0;
+    std::uint64_t seed = 0;
+};
+
+/// The queries of a synthetic query log, see `synthetic_queries`.
+struct synthetic_query_params {
+    std::size_t queries = 10'000;
+    /// Exponent of the Zipf law by which terms are drawn, the most frequent terms first.
+    double zipf_exponent = 1.0;
+    /// Mean and maximum number of distinct terms of a query.
+    double mean_terms = 3.0;
+    std::size_t max_terms = 10;
+    std::uint64_t seed = 0;
+};
+
+/// Writes the `.docs`, `.freqs`, and `.sizes` files of a `binary_freq_collection` of random
+/// lists of the shape `params`, generated in parallel. A collection only depends on `params`,
+/// not on the number of threads. Returns the number of postings written.
+auto write_synthetic_collection(std::string const& basename, synthetic_collection_params params)
+    -> std::size_t;
+
+/// Returns a query log of terms of a collection of `term_count` terms, as generated by
+/// `write_synthetic_collection`, whose most frequent terms have the lowest IDs.
+[[nodiscard]] auto synthetic_queries(std::uint32_t term_count, synthetic_query_params params)
+    -> std::vector<std::vector<std::uint32_t>>;
+
+}  // namespace pisa
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace pisa {
+
+/// A set of tasks with dependencies, run in parallel within a budget of threads and memory,
+/// such as the stages of building every shard of an index.
+///
+/// A task starts once all its dependencies have finished and the threads and memory it declares
+/// fit in what the running tasks leave of the budget. Of the ready tasks that fit, the one with
+/// the highest priority starts first, and the one added first among equals; smaller tasks thus
+/// start ahead of a larger one that has to wait for memory. A task that exceeds the budget by
+/// itself still runs, alone.
+class task_graph {
+  public:
+    using task_id = std::size_t;
+
+    /// The threads and memory, in bytes, that a task uses, or that tasks can use together.
+    struct resources {
+        std::size_t threads = 1;
+        std::size_t memory = 0;
+    };
+
+    /// Adds a task running `fn` after all `dependencies`, which must have been added before, and
+    /// returns its ID. Throws `std::invalid_argument` for unknown dependencies.
+    auto add(
+        std::string name,
+        std::function<void()> fn,
+        resources needs,
+        std::vector<task_id> const& dependencies = {},
+        int priority = 0) -> task_id;
+
+    /// Runs all tasks within `budget`, with up to `budget.threads` tasks at a time, and returns
+    /// once they have finished. If a task throws, no other task starts, and the exception is
+    /// rethrown once the running tasks have finished.
+    void run(resources budget);
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_tasks.size(); }
+    [[nodiscard]] auto name(task_id id) const -> std::string const& { return m_tasks[id].name; }
+
+  private:
+    struct task {
+        std::string name;
+        std::function<void()> fn;
+        resources needs;
+        int priority;
+        std::size_t dependencies;
+        std::vector<task_id> dependents;
+    };
+
+    std::vector<task> m_tasks;
+};
+
+}  // namespace pisa
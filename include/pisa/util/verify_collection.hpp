@@ -1,48 +1,97 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
+
 #include "mio/mmap.hpp"
 #include "spdlog/spdlog.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
 
 #include "mappable/mapper.hpp"
+#include "util/progress.hpp"
 #include "util/util.hpp"
 
+/// Decodes the lists of the index in `filename` and compares them with those of `input`,
+/// exiting the process if any differs. Lists are checked in parallel over ranges of terms.
+///
+/// With `sample_rate` below 1, only that fraction of the lists, drawn at random with `seed`,
+/// is checked, which bounds the time taken on large indexes while still catching systematic
+/// encoding errors.
 template <typename InputCollection, typename Collection>
-void verify_collection(InputCollection const& input, const char* filename)
+void verify_collection(
+    InputCollection const& input,
+    const char* filename,
+    double sample_rate = 1.0,
+    std::uint64_t seed = 0)
 {
+    using sequence_type = std::decay_t<decltype(*input.begin())>;
+
     Collection coll;
     mio::mmap_source m(filename);
     pisa::mapper::map(coll, m);
-    size_t size = 0;
     spdlog::info("Checking the written data, just to be extra safe...");
-    size_t s = 0;
-    for (auto seq: input) {
-        size = seq.docs.size();
-        auto e = coll[s];
-        if (e.size() != size) {
-            spdlog::error("sequence {} has wrong length! ({} != {})", s, e.size(), size);
-            exit(1);
-        }
-        for (size_t i = 0; i < e.size(); ++i, e.next()) {
-            uint64_t docid = *(seq.docs.begin() + i);
-            uint64_t freq = *(seq.freqs.begin() + i);
 
-            if (docid != e.docid()) {
-                spdlog::error("docid in sequence {} differs at position {}!", s, i);
-                spdlog::error("{} != {}", e.docid(), docid);
-                spdlog::error("sequence length: {}", seq.docs.size());
+    std::vector<std::pair<std::size_t, sequence_type>> lists;
+    std::mt19937_64 rng(seed);
+    std::bernoulli_distribution sampled(sample_rate);
+    std::size_t s = 0;
+    for (auto const& seq: input) {
+        if (sample_rate >= 1.0 || sampled(rng)) {
+            lists.emplace_back(s, seq);
+        }
+        s += 1;
+    }
+    if (lists.empty()) {
+        spdlog::info("No lists sampled");
+        return;
+    }
+    if (lists.size() < s) {
+        spdlog::info("Checking {} of {} lists", lists.size(), s);
+    }
 
-                exit(1);
-            }
+    std::atomic_bool failed{false};
+    {
+        pisa::progress progress("Check index", lists.size());
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, lists.size()), [&](auto const& range) {
+            for (auto idx = range.begin(); idx != range.end() && not failed; ++idx) {
+                auto const& [term, seq] = lists[idx];
+                auto size = seq.docs.size();
+                auto e = coll[term];
+                if (e.size() != size) {
+                    spdlog::error("sequence {} has wrong length! ({} != {})", term, e.size(), size);
+                    failed = true;
+                    return;
+                }
+                for (size_t i = 0; i < e.size(); ++i, e.next()) {
+                    uint64_t docid = *(seq.docs.begin() + i);
+                    uint64_t freq = *(seq.freqs.begin() + i);
 
-            if (freq != e.freq()) {
-                spdlog::error("freq in sequence {} differs at position {}!", s, i);
-                spdlog::error("{} != {}", e.freq(), freq);
-                spdlog::error("sequence length: {}", seq.docs.size());
+                    if (docid != e.docid()) {
+                        spdlog::error("docid in sequence {} differs at position {}!", term, i);
+                        spdlog::error("{} != {}", e.docid(), docid);
+                        spdlog::error("sequence length: {}", seq.docs.size());
+                        failed = true;
+                        return;
+                    }
 
-                exit(1);
+                    if (freq != e.freq()) {
+                        spdlog::error("freq in sequence {} differs at position {}!", term, i);
+                        spdlog::error("{} != {}", e.freq(), freq);
+                        spdlog::error("sequence length: {}", seq.docs.size());
+                        failed = true;
+                        return;
+                    }
+                }
             }
-        }
-        s += 1;
+            progress.update(range.size());
+        });
+    }
+    if (failed) {
+        exit(1);
     }
     spdlog::info("Everything is OK!");
 }
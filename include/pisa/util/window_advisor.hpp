@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+namespace pisa {
+
+/// Advises the kernel on a file mapping read once from front to back, a window at a time: the
+/// window ahead of the reader is read ahead with `MADV_WILLNEED`, and the windows more than one
+/// window behind it are dropped, from the mapping with `MADV_DONTNEED` and from the page cache
+/// with `POSIX_FADV_DONTNEED`. Unlike `POSIX_MADV_SEQUENTIAL` on the whole mapping, this keeps
+/// the memory taken by an input larger than memory to a few windows, instead of letting it
+/// evict everything else, e.g., the index built from it.
+///
+/// Readers report the offset they reached with `advance`, which is cheap until the reader
+/// enters the next window. Pages dropped behind a reader that comes back to them are simply
+/// read again.
+class Window_Advisor {
+  public:
+    static constexpr std::size_t default_window = std::size_t(1) << 26U;
+
+    /// Advises on `[data, data + size)`, a page-aligned mapping of the file `fd`, or of no file
+    /// if `fd` is negative, with windows of `window` bytes rounded up to whole pages.
+    Window_Advisor(
+        void const* data, std::size_t size, int fd, std::size_t window = default_window);
+
+    /// Returns whether inputs of `size` bytes are worth streaming by default, i.e., whether
+    /// they take more than half of the physical memory.
+    [[nodiscard]] static auto worth_streaming(std::size_t size) -> bool;
+
+    /// Reports that a reader reached `offset`. Safe to call from any thread.
+    void advance(std::size_t offset)
+    {
+        if (offset >= m_next_window.load(std::memory_order_relaxed)) {
+            slide(offset);
+        }
+    }
+
+  private:
+    void slide(std::size_t offset);
+
+    char const* m_data;
+    std::size_t m_size;
+    int m_fd;
+    std::size_t m_window;
+    std::atomic_size_t m_next_window;
+    std::mutex m_mutex;
+    std::size_t m_dropped = 0;
+};
+
+}  // namespace pisa
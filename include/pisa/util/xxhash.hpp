@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pisa {
+
+/// Returns the 64-bit xxHash (XXH64) of `[data, data + size)`.
+[[nodiscard]] auto xxhash64(void const* data, std::size_t size, std::uint64_t seed = 0)
+    -> std::uint64_t;
+
+}  // namespace pisa
@@ -1,13 +1,19 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <numeric>
+#include <optional>
 #include <unordered_set>
 
 #include "boost/variant.hpp"
 #include "spdlog/spdlog.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
 
 #include "binary_freq_collection.hpp"
+#include "global_statistics.hpp"
 #include "mappable/mappable_vector.hpp"
 #include "util/progress.hpp"
 #include "util/util.hpp"
@@ -34,9 +40,20 @@ class wand_data {
         std::string const& scorer_name,
         BlockSize block_size,
         bool is_quantized,
-        std::unordered_set<size_t> const& terms_to_drop)
+        std::unordered_set<size_t> const& terms_to_drop,
+        uint8_t norm_len_bits = 0,
+        global_statistics const* global_stats = nullptr)
         : m_num_docs(num_docs)
     {
+        if (global_stats != nullptr && not terms_to_drop.empty()) {
+            throw std::invalid_argument("Terms cannot be dropped when using global statistics");
+        }
+        if (global_stats != nullptr && global_stats->term_count() != coll.size()) {
+            throw std::invalid_argument(fmt::format(
+                "Global statistics of {} terms given for a collection of {} terms",
+                global_stats->term_count(),
+                coll.size()));
+        }
         std::vector<uint32_t> doc_lens(num_docs);
         std::vector<float> max_term_weight;
         std::vector<uint32_t> term_occurrence_counts;
@@ -54,45 +71,90 @@ class wand_data {
 
         typename block_wand_type::builder builder(coll, params);
 
+        std::vector<binary_freq_collection::sequence> sequences;
         {
-            pisa::progress progress("Storing terms statistics", coll.size());
             size_t term_id = 0;
             for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
+                if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                    sequences.push_back(seq);
                 }
-
-                size_t term_occurrence_count = std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0);
-                term_occurrence_counts.push_back(term_occurrence_count);
-                term_posting_counts.push_back(seq.docs.size());
                 term_id += 1;
-                progress.update(1);
             }
         }
+        term_occurrence_counts.resize(sequences.size());
+        term_posting_counts.resize(sequences.size());
+        {
+            pisa::progress progress("Storing terms statistics", coll.size());
+            progress.update(coll.size() - sequences.size());
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, sequences.size()),
+                [&](tbb::blocked_range<size_t> const& terms) {
+                    for (auto term_id = terms.begin(); term_id != terms.end(); ++term_id) {
+                        auto const& seq = sequences[term_id];
+                        term_occurrence_counts[term_id] =
+                            std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0);
+                        term_posting_counts[term_id] = seq.docs.size();
+                    }
+                    progress.update(terms.size());
+                });
+        }
+        if (norm_len_bits > 0) {
+            quantize_norm_lens(doc_lens, norm_len_bits);
+        }
         m_doc_lens.steal(doc_lens);
         m_term_occurrence_counts.steal(term_occurrence_counts);
         m_term_posting_counts.steal(term_posting_counts);
 
-        auto scorer = scorer::from_name(scorer_name, *this);
+        // With global statistics, upper bounds are those of the scores of `global_wand_data`.
+        std::unique_ptr<index_scorer<wand_data>> local_scorer;
+        std::optional<global_wand_data<wand_data>> global_wdata;
+        std::unique_ptr<index_scorer<global_wand_data<wand_data>>> global_scorer;
+        if (global_stats != nullptr) {
+            global_wdata.emplace(*this, *global_stats);
+            global_scorer = scorer::from_name(scorer_name, *global_wdata);
+        } else {
+            local_scorer = scorer::from_name(scorer_name, *this);
+        }
+        auto term_scorer = [&](size_t term_id) -> term_scorer_t {
+            return global_scorer ? global_scorer->term_scorer(term_id)
+                                 : local_scorer->term_scorer(term_id);
+        };
         {
             pisa::progress progress("Storing score upper bounds", coll.size());
-            size_t term_id = 0;
-            size_t new_term_id = 0;
-            for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
+            progress.update(coll.size() - sequences.size());
+            // Terms are partitioned in parallel a batch at a time, and then appended in order, so
+            // that the output does not depend on scheduling. A batch spans a bounded number of
+            // postings to keep the partitions waiting to be appended small.
+            constexpr size_t batch_postings = size_t(1) << 24U;
+            std::vector<typename block_wand_type::builder::partition_type> partitions;
+            size_t batch_begin = 0;
+            while (batch_begin < sequences.size()) {
+                size_t batch_end = batch_begin;
+                size_t postings = 0;
+                while (batch_end < sequences.size() and postings < batch_postings) {
+                    postings += sequences[batch_end].docs.size();
+                    batch_end += 1;
                 }
-                auto v = builder.add_sequence(
-                    seq, coll, doc_lens, m_avg_len, scorer->term_scorer(new_term_id), block_size);
-                max_term_weight.push_back(v);
-                m_index_max_term_weight = std::max(m_index_max_term_weight, v);
-                term_id += 1;
-                new_term_id += 1;
-                progress.update(1);
+                partitions.resize(batch_end - batch_begin);
+                tbb::parallel_for(
+                    tbb::blocked_range<size_t>(batch_begin, batch_end),
+                    [&](tbb::blocked_range<size_t> const& terms) {
+                        for (auto term_id = terms.begin(); term_id != terms.end(); ++term_id) {
+                            partitions[term_id - batch_begin] = builder.partition(
+                                sequences[term_id],
+                                coll,
+                                term_scorer(term_id),
+                                block_size);
+                        }
+                        progress.update(terms.size());
+                    });
+                for (auto term_id = batch_begin; term_id != batch_end; ++term_id) {
+                    auto v = builder.append(
+                        sequences[term_id], std::move(partitions[term_id - batch_begin]));
+                    max_term_weight.push_back(v);
+                    m_index_max_term_weight = std::max(m_index_max_term_weight, v);
+                }
+                batch_begin = batch_end;
             }
             if (is_quantized) {
                 LinearQuantizer quantizer(
@@ -107,7 +169,22 @@ class wand_data {
         m_max_term_weight.steal(max_term_weight);
     }
 
-    float norm_len(uint64_t doc_id) const { return m_doc_lens[doc_id] / m_avg_len; }
+    /// Returns the document length divided by the average length.
+    ///
+    /// If the data was built with quantized norms, the value is read from a compact
+    /// table of 8- or 16-bit codes instead of being computed from the document length.
+    float norm_len(uint64_t doc_id) const
+    {
+        if (m_norm_len_codes_8.size() > 0) {
+            return m_norm_len_table[m_norm_len_codes_8[doc_id]];
+        }
+        if (m_norm_len_codes_16.size() > 0) {
+            return m_norm_len_table[m_norm_len_codes_16[doc_id]];
+        }
+        return m_doc_lens[doc_id] / m_avg_len;
+    }
+
+    bool has_quantized_norm_lens() const { return m_norm_len_table.size() > 0; }
 
     size_t doc_len(uint64_t doc_id) const { return m_doc_lens[doc_id]; }
 
@@ -135,6 +212,115 @@ class wand_data {
 
     const block_wand_type& get_block_wand() const { return m_block_wand; }
 
+    /// Replaces the term statistics with `stats`, those of a collection of the same documents,
+    /// e.g., the full collection of a statically pruned one, so that scorers score documents as
+    /// in that collection. The upper bounds must have been computed with the same statistics,
+    /// i.e., with `stats` as global statistics.
+    void set_term_statistics(global_statistics const& stats)
+    {
+        if (stats.num_docs() != m_num_docs || stats.collection_len() != m_collection_len
+            || stats.term_count() != m_term_posting_counts.size()) {
+            throw std::invalid_argument("The statistics are not those of the same documents");
+        }
+        std::vector<uint32_t> posting_counts(stats.term_count());
+        std::vector<uint32_t> occurrence_counts(stats.term_count());
+        for (size_t term = 0; term < stats.term_count(); ++term) {
+            posting_counts[term] = stats.term_posting_count(term);
+            occurrence_counts[term] = stats.term_occurrence_count(term);
+        }
+        m_term_posting_counts.steal(posting_counts);
+        m_term_occurrence_counts.steal(occurrence_counts);
+    }
+
+    /// Writes to `out` a copy of this data with quantized upper bounds, the same as building
+    /// it with `is_quantized` set, but without another pass over the collection.
+    void quantize(wand_data& out) const
+    {
+        LinearQuantizer quantizer(m_index_max_term_weight, configuration::get().quantization_bits);
+        copy_quantized(out, quantizer);
+    }
+
+    /// Writes to `out` a copy of this data for an index whose scores are quantized to codes by
+    /// `quantizer`: the upper bounds are the weights of the codes of the bounds, and the table
+    /// of weights is kept for the quantized scorer to score the codes with.
+    void quantize(wand_data& out, bucket_quantizer const& quantizer) const
+    {
+        auto weights = quantizer.weights();
+        copy_quantized(out, [&](float score) -> float { return weights[quantizer(score)]; });
+        out.m_impact_weights.steal(weights);
+    }
+
+    /// Computes and stores the impacts of every block, see `wand_data_raw::set_block_impacts`,
+    /// from `coll`, the collection the data was built from with `terms_to_drop`. The data must
+    /// store exact document lengths, which the impacts bound.
+    void store_block_impacts(
+        binary_freq_collection const& coll, std::unordered_set<size_t> const& terms_to_drop)
+    {
+        if (has_quantized_norm_lens()) {
+            throw std::invalid_argument("Block impacts require exact document lengths");
+        }
+        std::vector<binary_freq_collection::sequence> sequences;
+        size_t term_id = 0;
+        for (auto const& seq: coll) {
+            if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                sequences.push_back(seq);
+            }
+            term_id += 1;
+        }
+        if (sequences.size() != m_block_wand.size()) {
+            throw std::invalid_argument("The collection is not that of the WAND data");
+        }
+        if (sequences.empty()) {
+            return;
+        }
+        auto blocks = m_block_wand.blocks(m_block_wand.size() - 1).second;
+        std::vector<uint32_t> block_max_freqs(blocks, 0);
+        std::vector<uint32_t> block_min_lens(blocks, std::numeric_limits<uint32_t>::max());
+        tbb::parallel_for(std::size_t(0), sequences.size(), [&](std::size_t list) {
+            auto const& seq = sequences[list];
+            // a posting is bounded by the first block ending at or after its docid
+            auto block = m_block_wand.blocks(list).first;
+            auto freq = seq.freqs.begin();
+            for (auto docid: seq.docs) {
+                while (m_block_wand.block_docid(block) < docid) {
+                    block += 1;
+                }
+                block_max_freqs[block] = std::max(block_max_freqs[block], *freq++);
+                block_min_lens[block] = std::min(block_min_lens[block], m_doc_lens[docid]);
+            }
+        });
+        m_block_wand.set_block_impacts(block_max_freqs, block_min_lens);
+    }
+
+    /// Writes to `out` a copy of this data with the upper bounds of BM25 with parameters `k1`
+    /// and `b`, computed from the block impacts, so that the parameters can be changed without
+    /// another pass over the collection.
+    void bm25_bounds(wand_data& out, float k1, float b) const
+    {
+        std::vector<float> max_term_weight(m_max_term_weight.size(), 0.0F);
+        float index_max_term_weight = 0;
+        m_block_wand.rebound(
+            out.m_block_wand, [&](size_t list, uint32_t max_freq, uint32_t min_len) {
+                auto term_weight =
+                    bm25<wand_data>::query_term_weight(m_term_posting_counts[list], m_num_docs, k1);
+                float bound = term_weight
+                    * bm25<wand_data>::doc_term_weight(max_freq, min_len / m_avg_len, k1, b);
+                max_term_weight[list] = std::max(max_term_weight[list], bound);
+                index_max_term_weight = std::max(index_max_term_weight, bound);
+                return bound;
+            });
+        out.m_max_term_weight.steal(max_term_weight);
+        copy_statistics(out);
+        out.m_index_max_term_weight = index_max_term_weight;
+    }
+
+    /// Returns the weights of the codes of a quantized index, see `bucket_quantizer`, or an
+    /// empty span if the quantized scores are the weights themselves.
+    [[nodiscard]] auto impact_weights() const -> gsl::span<uint32_t const>
+    {
+        return gsl::make_span(m_impact_weights.data(), m_impact_weights.size());
+    }
+
     template <typename Visitor>
     void map(Visitor& visit)
     {
@@ -144,10 +330,84 @@ class wand_data {
             m_term_posting_counts, "m_term_posting_counts")(m_avg_len, "m_avg_len")(
             m_collection_len, "m_collection_len")(m_num_docs, "m_num_docs")(
             m_max_term_weight, "m_max_term_weight")(
-            m_index_max_term_weight, "m_index_max_term_weight");
+            m_index_max_term_weight, "m_index_max_term_weight")(
+            m_norm_len_table, "m_norm_len_table")(m_norm_len_codes_8, "m_norm_len_codes_8")(
+            m_norm_len_codes_16, "m_norm_len_codes_16")(m_impact_weights, "m_impact_weights");
     }
 
   private:
+    template <typename Quantizer>
+    void copy_quantized(wand_data& out, Quantizer const& quantizer) const
+    {
+        m_block_wand.quantize(out.m_block_wand, quantizer);
+        std::vector<float> max_term_weight(m_max_term_weight.size());
+        std::transform(
+            m_max_term_weight.begin(), m_max_term_weight.end(), max_term_weight.begin(), quantizer);
+        out.m_max_term_weight.steal(max_term_weight);
+        copy_statistics(out);
+    }
+
+    /// Copies to `out` everything but the upper bounds.
+    void copy_statistics(wand_data& out) const
+    {
+        out.m_num_docs = m_num_docs;
+        out.m_avg_len = m_avg_len;
+        out.m_collection_len = m_collection_len;
+        out.m_index_max_term_weight = m_index_max_term_weight;
+        copy_vector(m_doc_lens, out.m_doc_lens);
+        copy_vector(m_term_occurrence_counts, out.m_term_occurrence_counts);
+        copy_vector(m_term_posting_counts, out.m_term_posting_counts);
+        copy_vector(m_norm_len_table, out.m_norm_len_table);
+        copy_vector(m_norm_len_codes_8, out.m_norm_len_codes_8);
+        copy_vector(m_norm_len_codes_16, out.m_norm_len_codes_16);
+    }
+
+    template <typename T>
+    static void copy_vector(mapper::mappable_vector<T> const& from, mapper::mappable_vector<T>& to)
+    {
+        std::vector<T> values(from.begin(), from.end());
+        to.steal(values);
+    }
+
+    /// Maps every normalized length to one of `2^bits` levels, spaced logarithmically
+    /// between the shortest and the longest document, and keeps one representative
+    /// value per level.
+    void quantize_norm_lens(std::vector<uint32_t> const& doc_lens, uint8_t bits)
+    {
+        if (bits != 8 and bits != 16) {
+            throw std::invalid_argument(
+                fmt::format("Norm lengths can be quantized to 8 or 16 bits but {} passed", bits));
+        }
+        spdlog::info("Quantizing document norms to {} bits...", bits);
+        auto [min_len, max_len] = std::minmax_element(doc_lens.begin(), doc_lens.end());
+        float low = std::log1p(*min_len / m_avg_len);
+        float high = std::log1p(*max_len / m_avg_len);
+        size_t levels = size_t(1) << bits;
+        float step = (high - low) / float(levels - 1);
+
+        std::vector<float> table(levels);
+        for (size_t level = 0; level < levels; ++level) {
+            table[level] = std::expm1(low + step * level);
+        }
+        auto code = [&](uint32_t len) -> size_t {
+            if (step == 0) {
+                return 0;
+            }
+            auto level = std::lround((std::log1p(len / m_avg_len) - low) / step);
+            return std::clamp<long>(level, 0, levels - 1);
+        };
+        if (bits == 8) {
+            std::vector<uint8_t> codes(doc_lens.size());
+            std::transform(doc_lens.begin(), doc_lens.end(), codes.begin(), code);
+            m_norm_len_codes_8.steal(codes);
+        } else {
+            std::vector<uint16_t> codes(doc_lens.size());
+            std::transform(doc_lens.begin(), doc_lens.end(), codes.begin(), code);
+            m_norm_len_codes_16.steal(codes);
+        }
+        m_norm_len_table.steal(table);
+    }
+
     uint64_t m_num_docs = 0;
     float m_avg_len = 0;
     uint64_t m_collection_len = 0;
@@ -157,5 +417,9 @@ class wand_data {
     mapper::mappable_vector<uint32_t> m_term_occurrence_counts;
     mapper::mappable_vector<uint32_t> m_term_posting_counts;
     mapper::mappable_vector<float> m_max_term_weight;
+    mapper::mappable_vector<float> m_norm_len_table;
+    mapper::mappable_vector<uint8_t> m_norm_len_codes_8;
+    mapper::mappable_vector<uint16_t> m_norm_len_codes_16;
+    mapper::mappable_vector<uint32_t> m_impact_weights;
 };
 }  // namespace pisa
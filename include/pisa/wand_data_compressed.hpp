@@ -1,5 +1,10 @@
 #pragma once
 
+#include <array>
+#include <limits>
+
+#include <x86intrin.h>
+
 #include "boost/variant.hpp"
 #include "spdlog/spdlog.h"
 #include <range/v3/view/zip.hpp>
@@ -7,6 +12,8 @@
 #include "binary_freq_collection.hpp"
 #include "bitvector_collection.hpp"
 #include "configuration.hpp"
+#include "util/broadword.hpp"
+#include "util/likely.hpp"
 #include "util/util.hpp"
 
 #include "global_parameters.hpp"
@@ -104,20 +111,22 @@ class wand_data_compressed {
             spdlog::info("Storing max weight for each list and for each block...");
         }
 
+        using partition_type = std::pair<std::vector<uint32_t>, std::vector<float>>;
+
+        /// Computes the blocks of `seq`. It is safe to call concurrently with other partitions.
         template <typename Scorer>
-        float add_sequence(
+        [[nodiscard]] auto partition(
             binary_freq_collection::sequence const& seq,
             binary_freq_collection const& coll,
-            std::vector<uint32_t> const& doc_lens,
-            float avg_len,
             Scorer scorer,
-            BlockSize block_size)
+            BlockSize block_size) const -> partition_type
         {
-            auto t = block_size.type() == typeid(FixedBlock)
-                ? static_block_partition(seq, scorer, boost::get<FixedBlock>(block_size).size)
-                : variable_block_partition(
-                    coll, seq, scorer, boost::get<VariableBlock>(block_size).lambda);
+            return block_partition(coll, seq, scorer, block_size);
+        }
 
+        /// Appends the blocks of the next sequence and returns its maximum score.
+        float append(binary_freq_collection::sequence const& seq, partition_type t)
+        {
             float max_score = *(std::max_element(t.second.begin(), t.second.end()));
             max_term_weight.push_back(max_score);
             total_elements += seq.docs.size();
@@ -129,6 +138,18 @@ class wand_data_compressed {
             return max_term_weight.back();
         }
 
+        template <typename Scorer>
+        float add_sequence(
+            binary_freq_collection::sequence const& seq,
+            binary_freq_collection const& coll,
+            std::vector<uint32_t> const& doc_lens,
+            float avg_len,
+            Scorer scorer,
+            BlockSize block_size)
+        {
+            return append(seq, partition(seq, coll, scorer, block_size));
+        }
+
         void quantize_block_max_term_weights(float index_max_term_weight) {}
 
         void build(wand_data_compressed& wdata)
@@ -159,51 +180,117 @@ class wand_data_compressed {
         typename uniform_score_compressor::builder compressor_builder;
     };
 
+    /// Enumerates the block-max scores of a list.
+    ///
+    /// Block boundaries and scores are decoded a window at a time. A `next_geq` that lands
+    /// within the window, as most shallow moves of block-max algorithms do, just counts the
+    /// window docids below the target, several at a time with SIMD, instead of searching the
+    /// Elias-Fano sequence.
     class enumerator {
         friend class wand_data_compressed;
 
       public:
+        static constexpr uint32_t window_size = 16;
+
         enumerator(compact_elias_fano::enumerator docs_enum, float max_term_weight)
             : m_docs_enum(docs_enum), m_max_term_weight(max_term_weight)
         {
             reset();
         }
 
-        void reset()
-        {
-            uint64_t val = m_docs_enum.move(0).second;
-            m_cur_docid = val >> score_bits_size;
-            uint64_t mask = (1u << configuration::get().quantization_bits) - 1;
-            m_cur_score_index = (val & mask);
-        }
+        void reset() { fill_window(m_docs_enum.move(0).second); }
 
         void PISA_FLATTEN_FUNC next_geq(uint64_t lower_bound)
         {
-            if (docid() != lower_bound) {
-                lower_bound = lower_bound << score_bits_size;
-                auto val = m_docs_enum.next_geq(lower_bound);
-                m_cur_docid = val.second >> score_bits_size;
-                uint64_t mask = (1u << configuration::get().quantization_bits) - 1;
-                m_cur_score_index = (val.second & mask);
+            if (PISA_LIKELY(docid() >= lower_bound)) {
+                return;
+            }
+            if (lower_bound <= m_window_docids[m_window_end - 1]) {
+                m_pos = count_less(m_window_docids.data(), lower_bound);
+                return;
             }
+            if (m_docs_enum.position() == m_docs_enum.size()) {
+                // the window already ends with the end of the list
+                m_pos = m_window_end - 1;
+                return;
+            }
+            fill_window(m_docs_enum.next_geq(lower_bound << score_bits_size).second);
         }
 
         float PISA_FLATTEN_FUNC score()
         {
             if constexpr (IndexPayloadType == PayloadType::Quantized) {
-                return m_cur_score_index;
+                return m_window_scores[m_pos];
             } else {
-                return uniform_score_compressor::score(m_cur_score_index) * m_max_term_weight;
+                return uniform_score_compressor::score(m_window_scores[m_pos]) * m_max_term_weight;
             }
         }
 
-        uint64_t PISA_FLATTEN_FUNC docid() const { return m_cur_docid; }
+        uint64_t PISA_FLATTEN_FUNC docid() const { return m_window_docids[m_pos]; }
 
       private:
-        uint64_t m_cur_docid;
-        uint64_t m_cur_score_index;
-        float m_max_term_weight;
+        /// Decodes the window starting with `value`, followed by the next values of the
+        /// sequence and, if it is reached, its end.
+        void fill_window(uint64_t value)
+        {
+            uint64_t mask = (1u << configuration::get().quantization_bits) - 1;
+            m_window_end = 0;
+            while (true) {
+                m_window_docids[m_window_end] = value >> score_bits_size;
+                m_window_scores[m_window_end] = value & mask;
+                m_window_end += 1;
+                if (m_window_end == window_size
+                    || m_docs_enum.position() == m_docs_enum.size()) {
+                    break;
+                }
+                value = m_docs_enum.next().second;
+            }
+            std::fill(
+                m_window_docids.begin() + m_window_end,
+                m_window_docids.end(),
+                std::numeric_limits<uint32_t>::max());
+            m_pos = 0;
+        }
+
+        /// Returns the number of the `window_size` values less than `bound`.
+        static PISA_ALWAYSINLINE uint32_t count_less(uint32_t const* values, uint64_t bound)
+        {
+            auto key = static_cast<uint32_t>(
+                std::min<uint64_t>(bound, std::numeric_limits<uint32_t>::max()));
+            uint32_t count = 0;
+#if defined(__AVX2__)
+            // unsigned comparison, by flipping the sign bits of signed ones
+            __m256i const flip = _mm256_set1_epi32(0x80000000);
+            __m256i const keys = _mm256_xor_si256(_mm256_set1_epi32(key), flip);
+            for (uint32_t i = 0; i < window_size; i += 8) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(values + i));
+                v = _mm256_xor_si256(v, flip);
+                __m256i less = _mm256_cmpgt_epi32(keys, v);
+                count += broadword::popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+            }
+#elif defined(__SSE2__)
+            __m128i const flip = _mm_set1_epi32(0x80000000);
+            __m128i const keys = _mm_xor_si128(_mm_set1_epi32(key), flip);
+            for (uint32_t i = 0; i < window_size; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + i));
+                v = _mm_xor_si128(v, flip);
+                __m128i less = _mm_cmplt_epi32(v, keys);
+                count += broadword::popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+            }
+#else
+            for (uint32_t i = 0; i < window_size; ++i) {
+                count += values[i] < key ? 1 : 0;
+            }
+#endif
+            return count;
+        }
+
         compact_elias_fano::enumerator m_docs_enum;
+        float m_max_term_weight;
+        uint32_t m_pos = 0;
+        uint32_t m_window_end = 0;
+        std::array<uint32_t, window_size> m_window_docids;
+        std::array<uint32_t, window_size> m_window_scores;
     };
 
     uint64_t size() const { return m_docs_sequences.size(); }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <x86intrin.h>
+
 #include "spdlog/spdlog.h"
 
 #include "binary_freq_collection.hpp"
+#include "bit_vector.hpp"
 #include "global_parameters.hpp"
 #include "linear_quantizer.hpp"
 #include "mappable/mapper.hpp"
@@ -54,35 +57,67 @@ class wand_data_range {
                 posting_lists);
         }
 
+        /// The maximum score of a sequence and of each of its non-empty ranges, if it is long
+        /// enough for its ranges to be stored.
+        struct partition_type {
+            float max_score = 0.0F;
+            std::vector<std::pair<uint32_t, float>> ranges;
+        };
+
+        /// Computes the ranges of `seq`. It is safe to call concurrently with other partitions.
         template <typename Scorer>
-        float add_sequence(
+        [[nodiscard]] auto partition(
             binary_freq_collection::sequence const& term_seq,
-            binary_freq_collection const& coll,
-            std::vector<uint32_t> const& doc_lens,
-            float avg_len,
+            [[maybe_unused]] binary_freq_collection const& coll,
             Scorer scorer,
-            [[maybe_unused]] BlockSize block_size)
+            [[maybe_unused]] BlockSize block_size) const -> partition_type
         {
-            float max_score = 0.0f;
-
-            std::vector<float> b_max(blocks_num, 0.0f);
+            partition_type p;
+            bool store_ranges = term_seq.docs.size() >= min_list_lenght;
             for (auto i = 0; i < term_seq.docs.size(); ++i) {
                 uint64_t docid = *(term_seq.docs.begin() + i);
                 uint64_t freq = *(term_seq.freqs.begin() + i);
                 float score = scorer(docid, freq);
-                max_score = std::max(max_score, score);
-                size_t pos = docid / range_size;
-                float& bm = b_max[pos];
-                bm = std::max(bm, score);
+                p.max_score = std::max(p.max_score, score);
+                if (store_ranges) {
+                    uint32_t pos = docid / range_size;
+                    if (p.ranges.empty() || p.ranges.back().first != pos) {
+                        p.ranges.emplace_back(pos, 0.0F);
+                    }
+                    float& bm = p.ranges.back().second;
+                    bm = std::max(bm, score);
+                }
             }
+            return p;
+        }
+
+        /// Appends the ranges of the next sequence and returns its maximum score.
+        float append(binary_freq_collection::sequence const& term_seq, partition_type p)
+        {
             if (term_seq.docs.size() >= min_list_lenght) {
-                block_max_term_weight.insert(block_max_term_weight.end(), b_max.begin(), b_max.end());
-                blocks_start.push_back(b_max.size() + blocks_start.back());
+                auto start = block_max_term_weight.size();
+                block_max_term_weight.resize(start + blocks_num, 0.0F);
+                for (auto [pos, score]: p.ranges) {
+                    block_max_term_weight[start + pos] = score;
+                }
+                blocks_start.push_back(blocks_num + blocks_start.back());
                 total_elements += term_seq.docs.size();
             } else {
                 blocks_start.push_back(blocks_start.back());
             }
-            return max_score;
+            return p.max_score;
+        }
+
+        template <typename Scorer>
+        float add_sequence(
+            binary_freq_collection::sequence const& term_seq,
+            binary_freq_collection const& coll,
+            std::vector<uint32_t> const& doc_lens,
+            float avg_len,
+            Scorer scorer,
+            [[maybe_unused]] BlockSize block_size)
+        {
+            return append(term_seq, partition(term_seq, coll, scorer, block_size));
         }
 
         void quantize_block_max_term_weights(float index_max_term_weight)
@@ -137,23 +172,52 @@ class wand_data_range {
         return enumerator(m_blocks_start[i], m_block_max_term_weight);
     }
 
-    static std::vector<bool> compute_live_blocks(
-        std::vector<enumerator>& enums, float threshold, std::pair<uint32_t, uint32_t> document_range)
+    /// Returns, for each range of `document_range`, the sum of the maximum scores of `enums`.
+    static std::vector<float> range_upper_bounds(
+        std::vector<enumerator> const& enums, std::pair<uint32_t, uint32_t> document_range)
     {
         size_t len = ceil_div((document_range.second - document_range.first), range_size);
-        std::vector<bool> live_blocks(len);
+        std::vector<float> upper_bounds(len, 0.0F);
         for (auto&& e: enums) {
-            e.next_geq(document_range.first);
+            add_scores(
+                upper_bounds.data(),
+                &e.m_block_max_term_weight[e.block_start + document_range.first / range_size],
+                len);
         }
-        for (size_t i = 0; i < len; ++i) {
-            float score = 0.0f;
-            for (auto&& e: enums) {
-                score += e.score();
-                e.next_block();
-            }
-            live_blocks[i] = (score > threshold);
+        return upper_bounds;
+    }
+
+    /// Returns a bitmap of the ranges of `document_range` whose upper bound is above `threshold`,
+    /// i.e., whose documents can still enter the top-k.
+    ///
+    /// Lists too short to store their ranges must not be in `enums`: their maximum scores can be
+    /// subtracted from `threshold` instead.
+    static bit_vector compute_live_blocks(
+        std::vector<enumerator> const& enums,
+        float threshold,
+        std::pair<uint32_t, uint32_t> document_range)
+    {
+        auto upper_bounds = range_upper_bounds(enums, document_range);
+        bit_vector_builder live_blocks;
+        live_blocks.reserve(upper_bounds.size());
+        size_t i = 0;
+#if defined(__AVX__)
+        __m256 const thresholds = _mm256_set1_ps(threshold);
+        for (; i + 8 <= upper_bounds.size(); i += 8) {
+            __m256 live = _mm256_cmp_ps(_mm256_loadu_ps(&upper_bounds[i]), thresholds, _CMP_GT_OQ);
+            live_blocks.append_bits(_mm256_movemask_ps(live), 8);
         }
-        return live_blocks;
+#elif defined(__SSE2__)
+        __m128 const thresholds = _mm_set1_ps(threshold);
+        for (; i + 4 <= upper_bounds.size(); i += 4) {
+            __m128 live = _mm_cmpgt_ps(_mm_loadu_ps(&upper_bounds[i]), thresholds);
+            live_blocks.append_bits(_mm_movemask_ps(live), 4);
+        }
+#endif
+        for (; i < upper_bounds.size(); ++i) {
+            live_blocks.push_back(upper_bounds[i] > threshold);
+        }
+        return bit_vector(&live_blocks);
     }
 
     template <typename Visitor>
@@ -164,6 +228,25 @@ class wand_data_range {
     }
 
   private:
+    /// Adds `len` scores to `sums`.
+    static void add_scores(float* sums, float const* scores, size_t len)
+    {
+        size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 8 <= len; i += 8) {
+            _mm256_storeu_ps(
+                sums + i, _mm256_add_ps(_mm256_loadu_ps(sums + i), _mm256_loadu_ps(scores + i)));
+        }
+#elif defined(__SSE2__)
+        for (; i + 4 <= len; i += 4) {
+            _mm_storeu_ps(sums + i, _mm_add_ps(_mm_loadu_ps(sums + i), _mm_loadu_ps(scores + i)));
+        }
+#endif
+        for (; i < len; ++i) {
+            sums[i] += scores[i];
+        }
+    }
+
     uint64_t m_blocks_num;
     mapper::mappable_vector<uint64_t> m_blocks_start;
     mapper::mappable_vector<float> m_block_max_term_weight;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "boost/variant.hpp"
 #include "spdlog/spdlog.h"
 
@@ -30,20 +32,22 @@ class wand_data_raw {
             blocks_start.push_back(0);
         }
 
+        using partition_type = std::pair<std::vector<uint32_t>, std::vector<float>>;
+
+        /// Computes the blocks of `seq`. It is safe to call concurrently with other partitions.
         template <typename Scorer>
-        float add_sequence(
+        [[nodiscard]] auto partition(
             binary_freq_collection::sequence const& seq,
             binary_freq_collection const& coll,
-            std::vector<uint32_t> const& doc_lens,
-            float avg_len,
             Scorer scorer,
-            BlockSize block_size)
+            BlockSize block_size) const -> partition_type
         {
-            auto t = block_size.type() == typeid(FixedBlock)
-                ? static_block_partition(seq, scorer, boost::get<FixedBlock>(block_size).size)
-                : variable_block_partition(
-                    coll, seq, scorer, boost::get<VariableBlock>(block_size).lambda);
+            return block_partition(coll, seq, scorer, block_size);
+        }
 
+        /// Appends the blocks of the next sequence and returns its maximum score.
+        float append(binary_freq_collection::sequence const& seq, partition_type t)
+        {
             block_max_term_weight.insert(
                 block_max_term_weight.end(), t.second.begin(), t.second.end());
             block_docid.insert(block_docid.end(), t.first.begin(), t.first.end());
@@ -56,6 +60,18 @@ class wand_data_raw {
             return max_term_weight.back();
         }
 
+        template <typename Scorer>
+        float add_sequence(
+            binary_freq_collection::sequence const& seq,
+            binary_freq_collection const& coll,
+            std::vector<uint32_t> const& doc_lens,
+            float avg_len,
+            Scorer scorer,
+            BlockSize block_size)
+        {
+            return append(seq, partition(seq, coll, scorer, block_size));
+        }
+
         void quantize_block_max_term_weights(float index_max_term_weight)
         {
             LinearQuantizer quantizer(index_max_term_weight, configuration::get().quantization_bits);
@@ -98,11 +114,21 @@ class wand_data_raw {
               m_block_docid(block_docid)
         {}
 
+        /// Moves to the first block whose maximum docid is not less than `lower_bound`, or to
+        /// the last block. Traversals move a few blocks at a time, which are scanned, but the
+        /// first move of a query restricted to a docid range can skip most of the list, which
+        /// is searched instead.
         void PISA_NOINLINE next_geq(uint64_t lower_bound)
         {
-            while (cur_pos + 1 < block_number && m_block_docid[block_start + cur_pos] < lower_bound) {
-                cur_pos++;
+            uint32_t const* docids = m_block_docid.data() + block_start;
+            uint64_t last = block_number - 1;
+            for (int step = 0; step < linear_steps; ++step) {
+                if (cur_pos == last || docids[cur_pos] >= lower_bound) {
+                    return;
+                }
+                ++cur_pos;
             }
+            cur_pos = std::lower_bound(docids + cur_pos, docids + last, lower_bound) - docids;
         }
 
         float PISA_FLATTEN_FUNC score() const
@@ -115,6 +141,8 @@ class wand_data_raw {
         uint64_t PISA_FLATTEN_FUNC find_next_skip() { return m_block_docid[cur_pos + block_start]; }
 
       private:
+        static constexpr int linear_steps = 4;
+
         uint64_t cur_pos;
         uint64_t block_start;
         uint64_t block_number;
@@ -131,17 +159,110 @@ class wand_data_raw {
             m_block_docid);
     }
 
+    /// Writes to `out` a copy of this data with block upper bounds quantized by `quantizer`, a
+    /// function from a score to the quantized score.
+    template <typename Quantizer>
+    void quantize(wand_data_raw& out, Quantizer const& quantizer) const
+    {
+        std::vector<uint64_t> blocks_start(m_blocks_start.begin(), m_blocks_start.end());
+        std::vector<float> block_max_term_weight(m_block_max_term_weight.size());
+        std::transform(
+            m_block_max_term_weight.begin(),
+            m_block_max_term_weight.end(),
+            block_max_term_weight.begin(),
+            quantizer);
+        std::vector<uint32_t> block_docid(m_block_docid.begin(), m_block_docid.end());
+        out.m_blocks_start.steal(blocks_start);
+        out.m_block_max_term_weight.steal(block_max_term_weight);
+        out.m_block_docid.steal(block_docid);
+    }
+
+    /// Returns the number of lists.
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return m_blocks_start.size() == 0 ? 0 : m_blocks_start.size() - 1;
+    }
+
+    /// Returns the indexes of the first and past the last block of list `i`.
+    [[nodiscard]] auto blocks(std::size_t i) const -> std::pair<uint64_t, uint64_t>
+    {
+        return {m_blocks_start[i], m_blocks_start[i + 1]};
+    }
+
+    /// Returns the largest docid of block `block`, counted over all lists.
+    [[nodiscard]] auto block_docid(uint64_t block) const -> uint32_t
+    {
+        return m_block_docid[block];
+    }
+
+    /// Stores the impacts of every block, counted over all lists: the highest frequency and the
+    /// shortest document length of its postings. A block of postings scores at most the score
+    /// of a posting of its highest frequency in a document of its shortest length, with any
+    /// scorer increasing with the frequency and decreasing with the length, such as BM25 with
+    /// any parameters.
+    void set_block_impacts(
+        std::vector<uint32_t>& block_max_freqs, std::vector<uint32_t>& block_min_lens)
+    {
+        if (block_max_freqs.size() != m_block_docid.size()
+            || block_min_lens.size() != m_block_docid.size()) {
+            throw std::invalid_argument("Block impacts must be given for every block");
+        }
+        m_block_max_freq.steal(block_max_freqs);
+        m_block_min_len.steal(block_min_lens);
+    }
+
+    [[nodiscard]] auto has_block_impacts() const -> bool { return m_block_max_freq.size() > 0; }
+
+    [[nodiscard]] auto block_max_freq(uint64_t block) const -> uint32_t
+    {
+        return m_block_max_freq[block];
+    }
+
+    [[nodiscard]] auto block_min_len(uint64_t block) const -> uint32_t
+    {
+        return m_block_min_len[block];
+    }
+
+    /// Writes to `out` a copy of this data, impacts included, with the upper bound of every
+    /// block replaced by `bound(list, max_freq, min_len)`, given the impacts of the block.
+    template <typename Bound>
+    void rebound(wand_data_raw& out, Bound bound) const
+    {
+        if (not has_block_impacts()) {
+            throw std::logic_error("The WAND data does not store block impacts");
+        }
+        std::vector<float> block_max_term_weight(m_block_max_term_weight.size());
+        for (std::size_t list = 0; list < size(); ++list) {
+            for (auto block = m_blocks_start[list]; block < m_blocks_start[list + 1]; ++block) {
+                block_max_term_weight[block] =
+                    bound(list, m_block_max_freq[block], m_block_min_len[block]);
+            }
+        }
+        std::vector<uint64_t> blocks_start(m_blocks_start.begin(), m_blocks_start.end());
+        std::vector<uint32_t> block_docid(m_block_docid.begin(), m_block_docid.end());
+        std::vector<uint32_t> block_max_freq(m_block_max_freq.begin(), m_block_max_freq.end());
+        std::vector<uint32_t> block_min_len(m_block_min_len.begin(), m_block_min_len.end());
+        out.m_blocks_start.steal(blocks_start);
+        out.m_block_max_term_weight.steal(block_max_term_weight);
+        out.m_block_docid.steal(block_docid);
+        out.m_block_max_freq.steal(block_max_freq);
+        out.m_block_min_len.steal(block_min_len);
+    }
+
     template <typename Visitor>
     void map(Visitor& visit)
     {
         visit(m_blocks_start, "m_blocks_start")(m_block_max_term_weight, "m_block_max_term_weight")(
-            m_block_docid, "m_block_docid");
+            m_block_docid, "m_block_docid")(m_block_max_freq, "m_block_max_freq")(
+            m_block_min_len, "m_block_min_len");
     }
 
   private:
     mapper::mappable_vector<uint64_t> m_blocks_start;
     mapper::mappable_vector<float> m_block_max_term_weight;
     mapper::mappable_vector<uint32_t> m_block_docid;
+    mapper::mappable_vector<uint32_t> m_block_max_freq;
+    mapper::mappable_vector<uint32_t> m_block_min_len;
 };
 
 }  // namespace pisa
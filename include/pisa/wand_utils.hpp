@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
 #include "boost/variant.hpp"
+#include "tbb/parallel_for.h"
 
 #include "binary_freq_collection.hpp"
 #include "configuration.hpp"
+#include "optimal_score_partition.hpp"
 #include "score_opt_partition.hpp"
 
 namespace pisa {
@@ -18,7 +23,17 @@ struct VariableBlock {
     explicit VariableBlock(const float in_lambda) : lambda(in_lambda) {}
 };
 
-using BlockSize = boost::variant<FixedBlock, VariableBlock>;
+/// Blocks of at most `max_size` postings and `avg_size` postings on average, placed to minimize
+/// the error of their upper bounds.
+struct OptimalBlock {
+    float avg_size;
+    uint64_t max_size;
+    explicit OptimalBlock(const float in_avg_size)
+        : avg_size(in_avg_size), max_size(std::max<uint64_t>(4 * in_avg_size, 1))
+    {}
+};
+
+using BlockSize = boost::variant<FixedBlock, VariableBlock, OptimalBlock>;
 
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
@@ -53,6 +68,13 @@ std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
     return std::make_pair(block_docid, block_max_term_weight);
 }
 
+/// Lists longer than this are partitioned into variable blocks a segment of this many postings
+/// at a time, in parallel, so that the longest lists do not hold up a whole build.
+constexpr std::size_t variable_block_segment_size = std::size_t(1) << 16U;
+
+/// Partitions `seq` into variable blocks. Each segment of `segment_size` postings is
+/// partitioned on its own, which costs one forced block boundary per segment but bounds the
+/// memory of the dynamic program and lets the segments of a long list run in parallel.
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
     binary_freq_collection const& coll,
@@ -62,7 +84,8 @@ std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
     // Antonio Mallia, Giuseppe Ottaviano, Elia Porciani, Nicola Tonellotto, and Rossano Venturini.
     // 2017. Faster BlockMax WAND with Variable-sized Blocks. In Proc. SIGIR
     double eps1 = 0.01,
-    double eps2 = 0.4)
+    double eps2 = 0.4,
+    std::size_t segment_size = variable_block_segment_size)
 {
     // Auxiliary vector
     using doc_score_t = std::pair<uint64_t, float>;
@@ -77,9 +100,68 @@ std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
             return {doc, scorer(doc, freq)};
         });
 
-    auto p = score_opt_partition(doc_score.begin(), 0, doc_score.size(), eps1, eps2, lambda);
+    if (doc_score.size() <= segment_size) {
+        auto p = score_opt_partition(doc_score.begin(), 0, doc_score.size(), eps1, eps2, lambda);
+        return std::make_pair(p.docids, p.max_values);
+    }
+
+    std::vector<score_opt_partition> segments((doc_score.size() + segment_size - 1) / segment_size);
+    tbb::parallel_for(std::size_t(0), segments.size(), [&](std::size_t segment) {
+        auto begin = segment * segment_size;
+        auto size = std::min(segment_size, doc_score.size() - begin);
+        segments[segment] =
+            score_opt_partition(doc_score.begin() + begin, 0, size, eps1, eps2, lambda);
+    });
+    std::vector<uint32_t> block_docid;
+    std::vector<float> block_max_term_weight;
+    for (auto const& p: segments) {
+        block_docid.insert(block_docid.end(), p.docids.begin(), p.docids.end());
+        block_max_term_weight.insert(
+            block_max_term_weight.end(), p.max_values.begin(), p.max_values.end());
+    }
+    return std::make_pair(block_docid, block_max_term_weight);
+}
+
+template <typename Scorer>
+std::pair<std::vector<uint32_t>, std::vector<float>> optimal_block_partition(
+    binary_freq_collection::sequence const& seq, Scorer scorer, OptimalBlock block_size)
+{
+    std::vector<float> scores;
+    scores.reserve(seq.docs.size());
+    std::transform(
+        seq.docs.begin(),
+        seq.docs.end(),
+        seq.freqs.begin(),
+        std::back_inserter(scores),
+        [&](const uint64_t& doc, const uint64_t& freq) { return scorer(doc, freq); });
+
+    auto max_blocks = static_cast<uint64_t>(std::ceil(scores.size() / block_size.avg_size));
+    optimal_score_partition p(scores, max_blocks, block_size.max_size);
+
+    std::vector<uint32_t> block_docid;
+    for (auto end: p.block_ends()) {
+        block_docid.push_back(
+            end < seq.docs.size() ? *(seq.docs.begin() + end) - 1 : *(seq.docs.end() - 1));
+    }
+    return std::make_pair(block_docid, p.block_max_scores());
+}
 
-    return std::make_pair(p.docids, p.max_values);
+/// Returns the last document ID and the maximum score of each block of `seq`.
+template <typename Scorer>
+std::pair<std::vector<uint32_t>, std::vector<float>> block_partition(
+    binary_freq_collection const& coll,
+    binary_freq_collection::sequence const& seq,
+    Scorer scorer,
+    BlockSize block_size)
+{
+    if (block_size.type() == typeid(FixedBlock)) {
+        return static_block_partition(seq, scorer, boost::get<FixedBlock>(block_size).size);
+    }
+    if (block_size.type() == typeid(OptimalBlock)) {
+        return optimal_block_partition(seq, scorer, boost::get<OptimalBlock>(block_size));
+    }
+    return variable_block_partition(
+        coll, seq, scorer, boost::get<VariableBlock>(block_size).lambda);
 }
 
 }  // namespace pisa
@@ -0,0 +1,34 @@
+#!/bin/sh
+
+print_usage()
+{
+    echo "USAGE:"
+    echo "\tsample-index <INPUT_BASENAME> <OUTPUT_BASENAME> <ENCODING> <SCORER> [sampling flags]"
+    echo ""
+    echo "Samples the inverted index <INPUT_BASENAME> into <OUTPUT_BASENAME> and builds"
+    echo "<OUTPUT_BASENAME>.<ENCODING> and its WAND data <OUTPUT_BASENAME>.wand."
+    echo "Tools are run from \$PISA_BIN if set, or from the PATH otherwise."
+    exit 1
+}
+
+INPUT_BASENAME=$1
+OUTPUT_BASENAME=$2
+ENCODING=$3
+SCORER=$4
+if [ -z "${INPUT_BASENAME}" ]; then print_usage; exit 1; fi;
+if [ -z "${OUTPUT_BASENAME}" ]; then print_usage; exit 1; fi;
+if [ -z "${ENCODING}" ]; then print_usage; exit 1; fi;
+if [ -z "${SCORER}" ]; then print_usage; exit 1; fi;
+shift 4
+
+BIN=${PISA_BIN:+${PISA_BIN}/}
+
+run()
+{
+    echo "$@"
+    "$@" || exit 1
+}
+
+run ${BIN}sample_inverted_index -c ${INPUT_BASENAME} -o ${OUTPUT_BASENAME} "$@"
+run ${BIN}create_wand_data -c ${OUTPUT_BASENAME} -o ${OUTPUT_BASENAME}.wand -s ${SCORER} -b 64
+run ${BIN}create_freq_index -e ${ENCODING} -c ${OUTPUT_BASENAME} -o ${OUTPUT_BASENAME}.${ENCODING}
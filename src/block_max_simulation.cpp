@@ -0,0 +1,159 @@
+#include "block_max_simulation.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <utility>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+
+#include "scorer/bm25.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+namespace pisa {
+
+namespace {
+
+    using scorer_type = bm25<wand_data<wand_data_raw>>;
+
+    /// The blocks of a list: the last document of each, and the largest score of its postings.
+    struct simulated_blocks {
+        std::vector<std::uint32_t> last_docs;
+        std::vector<float> max_scores;
+        std::vector<std::uint32_t> sizes;
+        std::vector<bool> scored;
+    };
+
+}  // namespace
+
+Block_Max_Simulation::Block_Max_Simulation(
+    std::vector<binary_freq_collection::sequence> const& lists,
+    std::vector<std::uint32_t> const& document_sizes,
+    std::size_t k,
+    std::size_t block_size)
+    : m_lists(lists), m_norm_lens(document_sizes.size()), m_k(k), m_block_size(block_size)
+{
+    auto total = std::accumulate(document_sizes.begin(), document_sizes.end(), double(0));
+    auto avg_len = document_sizes.empty() ? 1.0 : total / document_sizes.size();
+    std::transform(
+        document_sizes.begin(), document_sizes.end(), m_norm_lens.begin(), [&](auto size) {
+            return static_cast<float>(size / avg_len);
+        });
+}
+
+auto Block_Max_Simulation::estimate(Query const& query) const -> block_max_estimate
+{
+    block_max_estimate estimate{1};
+    std::vector<simulated_blocks> blocks;
+    std::vector<std::pair<std::uint32_t, float>> scores;
+    for (auto [term, weight]: query_weights(query)) {
+        if (term >= m_lists.size()) {
+            continue;
+        }
+        auto const& list = m_lists[term];
+        auto term_weight = static_cast<float>(weight)
+            * scorer_type::query_term_weight(list.docs.size(), m_norm_lens.size());
+        auto& list_blocks = blocks.emplace_back();
+        auto freq = list.freqs.begin();
+        std::size_t position = 0;
+        for (auto doc: list.docs) {
+            auto score = term_weight * scorer_type::doc_term_weight(*freq++, m_norm_lens[doc]);
+            scores.emplace_back(doc, score);
+            if (position % m_block_size == 0) {
+                list_blocks.last_docs.push_back(doc);
+                list_blocks.max_scores.push_back(score);
+                list_blocks.sizes.push_back(0);
+            }
+            list_blocks.last_docs.back() = doc;
+            list_blocks.max_scores.back() = std::max(list_blocks.max_scores.back(), score);
+            list_blocks.sizes.back() += 1;
+            position += 1;
+        }
+        list_blocks.scored.resize(list_blocks.last_docs.size(), false);
+        estimate.blocks += list_blocks.last_docs.size();
+        estimate.postings += list.docs.size();
+    }
+
+    // The k-th largest score of a document, summed over the lists, or 0 for fewer documents.
+    std::sort(scores.begin(), scores.end());
+    std::vector<float> document_scores;
+    for (auto pos = scores.begin(); pos != scores.end();) {
+        float score = 0;
+        auto doc = pos->first;
+        for (; pos != scores.end() && pos->first == doc; ++pos) {
+            score += pos->second;
+        }
+        document_scores.push_back(score);
+    }
+    float threshold = 0;
+    if (m_k > 0 && document_scores.size() >= m_k) {
+        std::nth_element(
+            document_scores.begin(),
+            std::next(document_scores.begin(), m_k - 1),
+            document_scores.end(),
+            std::greater<>());
+        threshold = document_scores[m_k - 1];
+    }
+
+    // Each interval ends with the last document of a block, and is covered by a single block
+    // of each list, or by none past its end.
+    std::vector<std::uint32_t> boundaries;
+    for (auto const& list_blocks: blocks) {
+        boundaries.insert(
+            boundaries.end(), list_blocks.last_docs.begin(), list_blocks.last_docs.end());
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+    std::vector<std::size_t> current(blocks.size(), 0);
+    for (auto boundary: boundaries) {
+        float upper_bound = 0;
+        for (std::size_t list = 0; list < blocks.size(); ++list) {
+            auto const& last_docs = blocks[list].last_docs;
+            while (current[list] < last_docs.size() && last_docs[current[list]] < boundary) {
+                current[list] += 1;
+            }
+            if (current[list] < last_docs.size()) {
+                upper_bound += blocks[list].max_scores[current[list]];
+            }
+        }
+        if (upper_bound < threshold) {
+            continue;
+        }
+        for (std::size_t list = 0; list < blocks.size(); ++list) {
+            if (current[list] < blocks[list].last_docs.size()) {
+                blocks[list].scored[current[list]] = true;
+            }
+        }
+    }
+    for (auto const& list_blocks: blocks) {
+        for (std::size_t block = 0; block < list_blocks.scored.size(); ++block) {
+            if (list_blocks.scored[block]) {
+                estimate.scored_blocks += 1;
+                estimate.scored_postings += list_blocks.sizes[block];
+            }
+        }
+    }
+    return estimate;
+}
+
+auto Block_Max_Simulation::estimate(std::vector<Query> const& queries) const
+    -> block_max_estimate
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<std::size_t>(0, queries.size()),
+        block_max_estimate{},
+        [&](tbb::blocked_range<std::size_t> const& range, block_max_estimate estimate) {
+            for (auto query = range.begin(); query != range.end(); ++query) {
+                estimate += this->estimate(queries[query]);
+            }
+            return estimate;
+        },
+        [](block_max_estimate lhs, block_max_estimate const& rhs) {
+            lhs += rhs;
+            return lhs;
+        });
+}
+
+}  // namespace pisa
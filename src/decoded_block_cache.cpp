@@ -0,0 +1,79 @@
+#include "decoded_block_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace pisa {
+
+decoded_block_cache::decoded_block_cache(
+    std::vector<std::uint32_t> const& terms,
+    std::vector<std::uint32_t> const& blocks,
+    std::size_t block_size,
+    std::size_t capacity)
+{
+    assert(terms.size() == blocks.size());
+    auto max_blocks = capacity / block_bytes(block_size);
+    for (std::size_t idx = 0; idx < terms.size() && m_slot_count < max_blocks; ++idx) {
+        auto term = terms[idx];
+        if (blocks[idx] == 0) {
+            continue;
+        }
+        if (term >= m_first_slot.size()) {
+            m_first_slot.resize(term + 1, no_slot);
+            m_term_blocks.resize(term + 1, 0);
+        }
+        if (m_first_slot[term] != no_slot) {
+            continue;
+        }
+        auto admitted = std::min<std::size_t>(blocks[idx], max_blocks - m_slot_count);
+        m_first_slot[term] = static_cast<std::uint32_t>(m_slot_count);
+        m_term_blocks[term] = static_cast<std::uint32_t>(admitted);
+        m_slot_count += admitted;
+    }
+    m_slots = std::make_unique<std::atomic<std::uint32_t const*>[]>(m_slot_count);
+    for (std::size_t slot = 0; slot < m_slot_count; ++slot) {
+        m_slots[slot].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+decoded_block_cache::~decoded_block_cache()
+{
+    for (std::size_t slot = 0; slot < m_slot_count; ++slot) {
+        delete[] m_slots[slot].load(std::memory_order_relaxed);
+    }
+}
+
+auto decoded_block_cache::insert(
+    term_slots slots,
+    std::uint32_t block,
+    gsl::span<std::uint32_t const> docs,
+    gsl::span<std::uint32_t const> freqs) -> std::uint32_t const*
+{
+    assert(docs.size() == freqs.size());
+    auto size = static_cast<std::size_t>(docs.size());
+    auto* data = new std::uint32_t[2 * size + 1];
+    data[0] = static_cast<std::uint32_t>(size);
+    std::copy(docs.begin(), docs.end(), data + 1);
+    std::copy(freqs.begin(), freqs.end(), data + 1 + size);
+    std::uint32_t const* expected = nullptr;
+    if (slots.slots[block].compare_exchange_strong(
+            expected, data, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return data;
+    }
+    // Another thread cached the same block first.
+    delete[] data;
+    return expected;
+}
+
+auto decoded_block_cache::cached_blocks() const -> std::size_t
+{
+    std::size_t cached = 0;
+    for (std::size_t slot = 0; slot < m_slot_count; ++slot) {
+        if (m_slots[slot].load(std::memory_order_relaxed) != nullptr) {
+            ++cached;
+        }
+    }
+    return cached;
+}
+
+}  // namespace pisa
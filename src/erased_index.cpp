@@ -0,0 +1,93 @@
+#include "erased_index.hpp"
+
+#include <optional>
+#include <stdexcept>
+
+#include "index_types.hpp"
+#include "mappable/file_header.hpp"
+#include "mappable/mapper.hpp"
+
+namespace pisa {
+
+namespace {
+
+    template <typename Index>
+    class Index_Model final: public Erased_Index::Model {
+      public:
+        Index_Model(char const* data, std::size_t size, uint64_t flags, mapper::mapped_file file)
+            : m_file(std::move(file))
+        {
+            mapper::detail::map_file(m_index, data, size, flags, "<TOP>");
+        }
+
+        [[nodiscard]] auto size() const -> std::size_t override { return m_index.size(); }
+        [[nodiscard]] auto num_docs() const -> uint64_t override { return m_index.num_docs(); }
+
+        [[nodiscard]] auto enumerator(std::size_t term) const -> erased_enumerator override
+        {
+            using enumerator_type = typename Index::document_enumerator;
+            auto list = m_index[term];
+            auto size = list.size();
+            return erased_enumerator(
+                std::make_unique<enumerator_block_source<enumerator_type>>(
+                    std::move(list), m_index.num_docs()),
+                size,
+                m_index.num_docs());
+        }
+
+      private:
+        mapper::mapped_file m_file;
+        Index m_index;
+    };
+
+    auto make_model(
+        std::string const& encoding,
+        char const* data,
+        std::size_t size,
+        uint64_t flags,
+        mapper::mapped_file file) -> std::shared_ptr<Erased_Index::Model const>
+    {
+        /**/
+        if (false) {  // NOLINT
+#define LOOP_BODY(R, DATA, T)                                                                \
+    }                                                                                        \
+    else if (encoding == BOOST_PP_STRINGIZE(T))                                              \
+    {                                                                                        \
+        return std::make_shared<Index_Model<BOOST_PP_CAT(T, _index)>>(                       \
+            data, size, flags, std::move(file));                                             \
+        /**/
+
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+        }
+        throw std::invalid_argument("Unknown index encoding: " + encoding);
+    }
+
+    auto encoding_of(char const* data, std::size_t size) -> std::string
+    {
+        auto header = mapper::file_header::read(data, size);
+        if (not header) {
+            throw std::invalid_argument(
+                "The index has no header recording its encoding; it must be given explicitly");
+        }
+        return header->description.type;
+    }
+
+}  // namespace
+
+auto Erased_Index::map(char const* data, std::size_t size, uint64_t flags) -> Erased_Index
+{
+    auto encoding = encoding_of(data, size);
+    return Erased_Index(make_model(encoding, data, size, flags, mapper::mapped_file{}), encoding);
+}
+
+auto Erased_Index::open(std::string const& filename, mapper::load_mode mode) -> Erased_Index
+{
+    mapper::mapped_file file(filename, mode);
+    auto data = file.data();
+    auto size = file.size();
+    auto encoding = encoding_of(data, size);
+    return Erased_Index(make_model(encoding, data, size, 0, std::move(file)), encoding);
+}
+
+}  // namespace pisa
@@ -0,0 +1,102 @@
+#include "global_statistics.hpp"
+
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+
+namespace pisa {
+
+namespace {
+
+    /// Statistics of one shard, indexed by its own term IDs.
+    struct shard_statistics {
+        std::vector<std::string> terms;
+        std::vector<uint64_t> term_posting_counts;
+        std::vector<uint64_t> term_occurrence_counts;
+        uint64_t num_docs = 0;
+        uint64_t collection_len = 0;
+    };
+
+    auto read_shard_statistics(std::string const& collection, std::string const& terms_file)
+        -> shard_statistics
+    {
+        shard_statistics stats;
+        stats.terms = io::read_string_vector(terms_file);
+        binary_freq_collection coll(collection.c_str());
+        for (auto const& seq: coll) {
+            stats.term_posting_counts.push_back(seq.docs.size());
+            stats.term_occurrence_counts.push_back(
+                std::accumulate(seq.freqs.begin(), seq.freqs.end(), uint64_t(0)));
+        }
+        if (stats.term_posting_counts.size() != stats.terms.size()) {
+            throw std::invalid_argument(fmt::format(
+                "{} has {} terms but {} has {} posting lists",
+                terms_file,
+                stats.terms.size(),
+                collection,
+                stats.term_posting_counts.size()));
+        }
+        stats.num_docs = coll.num_docs();
+        binary_collection sizes((collection + ".sizes").c_str());
+        auto lengths = *sizes.begin();
+        stats.collection_len = std::accumulate(lengths.begin(), lengths.end(), uint64_t(0));
+        return stats;
+    }
+
+}  // namespace
+
+void compute_global_statistics(
+    std::string const& collection_basename,
+    std::string const& terms_basename,
+    std::size_t shard_count,
+    std::string const& output_basename)
+{
+    std::vector<shard_statistics> shards(shard_count);
+    spdlog::info("Reading the statistics of {} shards", shard_count);
+    tbb::parallel_for(std::size_t(0), shard_count, [&](std::size_t shard) {
+        shards[shard] = read_shard_statistics(
+            fmt::format("{}.{:03d}", collection_basename, shard),
+            fmt::format("{}.{:03d}.terms", terms_basename, shard));
+    });
+
+    spdlog::info("Summing statistics over shards");
+    uint64_t num_docs = 0;
+    uint64_t collection_len = 0;
+    std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> term_counts;
+    for (auto const& stats: shards) {
+        num_docs += stats.num_docs;
+        collection_len += stats.collection_len;
+        for (std::size_t term = 0; term < stats.terms.size(); ++term) {
+            auto& counts = term_counts[stats.terms[term]];
+            counts.first += stats.term_posting_counts[term];
+            counts.second += stats.term_occurrence_counts[term];
+        }
+    }
+    spdlog::info("{} documents and {} distinct terms", num_docs, term_counts.size());
+
+    tbb::parallel_for(std::size_t(0), shard_count, [&](std::size_t shard) {
+        auto& stats = shards[shard];
+        for (std::size_t term = 0; term < stats.terms.size(); ++term) {
+            auto const& counts = term_counts.at(stats.terms[term]);
+            stats.term_posting_counts[term] = counts.first;
+            stats.term_occurrence_counts[term] = counts.second;
+        }
+        global_statistics global(
+            num_docs,
+            collection_len,
+            std::move(stats.term_posting_counts),
+            std::move(stats.term_occurrence_counts));
+        mapper::freeze(global, fmt::format("{}.{:03d}", output_basename, shard).c_str());
+    });
+}
+
+}  // namespace pisa
@@ -0,0 +1,178 @@
+#include "mappable/file_header.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "util/xxhash.hpp"
+
+namespace pisa { namespace mapper {
+
+    namespace {
+
+        /// Cannot be mistaken for the freeze flags that start files without a header.
+        constexpr std::array<char, 8> magic{'\x89', 'P', 'I', 'S', 'A', '\r', '\n', '\x1a'};
+        constexpr std::size_t alignment = 64;
+        constexpr std::size_t max_type_length = 256;
+
+        template <typename T>
+        void write_value(std::ostream& os, T value)
+        {
+            os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+        }
+
+        /// Reads fields of a header, throwing if it is truncated.
+        class header_reader {
+          public:
+            header_reader(char const* data, std::size_t size) : m_data(data), m_size(size) {}
+
+            template <typename T>
+            auto read() -> T
+            {
+                T value;
+                std::memcpy(&value, bytes(sizeof(value)), sizeof(value));
+                return value;
+            }
+
+            auto read_string(std::size_t length) -> std::string
+            {
+                return std::string(bytes(length), length);
+            }
+
+          private:
+            auto bytes(std::size_t count) -> char const*
+            {
+                if (m_size - m_pos < count) {
+                    throw std::runtime_error("Truncated file header");
+                }
+                auto ptr = m_data + m_pos;
+                m_pos += count;
+                return ptr;
+            }
+
+            char const* m_data;
+            std::size_t m_size;
+            std::size_t m_pos = 0;
+        };
+
+    }  // namespace
+
+    auto file_header::size() const -> std::size_t
+    {
+        std::size_t bytes = magic.size() + 2 * sizeof(std::uint32_t) + description.type.size()
+            + 3 * sizeof(std::uint64_t) + sections.size() * sizeof(section);
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    void file_header::write(std::ostream& os) const
+    {
+        if (description.type.size() > max_type_length) {
+            throw std::invalid_argument("File type name too long: " + description.type);
+        }
+        os.write(magic.data(), magic.size());
+        write_value<std::uint32_t>(os, version);
+        write_value<std::uint32_t>(os, description.type.size());
+        os.write(description.type.data(), description.type.size());
+        write_value<std::uint64_t>(os, description.num_docs);
+        write_value<std::uint64_t>(os, data_size);
+        write_value<std::uint64_t>(os, sections.size());
+        for (auto const& s: sections) {
+            write_value(os, s.offset);
+            write_value(os, s.length);
+            write_value(os, s.checksum);
+        }
+        auto written = magic.size() + 2 * sizeof(std::uint32_t) + description.type.size()
+            + 3 * sizeof(std::uint64_t) + sections.size() * sizeof(section);
+        std::array<char, alignment> padding{};
+        os.write(padding.data(), size() - written);
+    }
+
+    auto file_header::read(char const* data, std::size_t size) -> std::optional<file_header>
+    {
+        if (size < magic.size() || not std::equal(magic.begin(), magic.end(), data)) {
+            return std::nullopt;
+        }
+        header_reader reader(data + magic.size(), size - magic.size());
+        file_header header;
+        header.version = reader.read<std::uint32_t>();
+        if (header.version != current_version) {
+            throw std::runtime_error(
+                "Unsupported file header version: " + std::to_string(header.version));
+        }
+        auto type_length = reader.read<std::uint32_t>();
+        if (type_length > max_type_length) {
+            throw std::runtime_error("Corrupted file header");
+        }
+        header.description.type = reader.read_string(type_length);
+        header.description.num_docs = reader.read<std::uint64_t>();
+        header.data_size = reader.read<std::uint64_t>();
+        auto sections = reader.read<std::uint64_t>();
+        if (sections > size / sizeof(section)) {
+            throw std::runtime_error("Corrupted file header");
+        }
+        header.sections.resize(sections);
+        for (auto& s: header.sections) {
+            s.offset = reader.read<std::uint64_t>();
+            s.length = reader.read<std::uint64_t>();
+            s.checksum = reader.read<std::uint64_t>();
+        }
+        return header;
+    }
+
+    auto file_header::read(std::string const& filename) -> std::optional<file_header>
+    {
+        std::ifstream is(filename, std::ios::binary);
+        if (not is) {
+            throw std::runtime_error("Cannot open " + filename);
+        }
+        std::vector<char> fixed(magic.size() + 2 * sizeof(std::uint32_t));
+        is.read(fixed.data(), fixed.size());
+        if (not std::equal(magic.begin(), magic.end(), fixed.begin())) {
+            return std::nullopt;
+        }
+        std::vector<char> buffer(fixed.begin(), fixed.end());
+        std::uint32_t type_length;
+        std::memcpy(&type_length, fixed.data() + magic.size() + sizeof(std::uint32_t), 4);
+        buffer.resize(fixed.size() + std::min<std::size_t>(type_length, max_type_length + 1)
+                      + 3 * sizeof(std::uint64_t));
+        is.read(buffer.data() + fixed.size(), buffer.size() - fixed.size());
+        std::uint64_t sections = 0;
+        if (is) {
+            std::memcpy(&sections, buffer.data() + buffer.size() - sizeof(sections), 8);
+        }
+        auto prefix = buffer.size();
+        buffer.resize(prefix + std::min<std::uint64_t>(sections, 1U << 20U) * sizeof(section));
+        is.read(buffer.data() + prefix, buffer.size() - prefix);
+        buffer.resize(prefix + is.gcount());
+        return read(buffer.data(), buffer.size());
+    }
+
+    void check_file_type(std::string const& filename, std::string_view type)
+    {
+        auto header = file_header::read(filename);
+        if (header && header->description.type != type) {
+            throw std::invalid_argument(
+                filename + " holds a " + header->description.type + " structure, not "
+                + std::string(type));
+        }
+    }
+
+    auto verify_checksums(char const* data, std::size_t size) -> bool
+    {
+        auto header = file_header::read(data, size);
+        if (not header) {
+            return true;
+        }
+        auto base = data + header->size();
+        if (header->size() + header->data_size != size) {
+            return false;
+        }
+        return std::all_of(header->sections.begin(), header->sections.end(), [&](auto const& s) {
+            return s.offset + s.length <= header->data_size
+                && xxhash64(base + s.offset, s.length) == s.checksum;
+        });
+    }
+
+}}  // namespace pisa::mapper
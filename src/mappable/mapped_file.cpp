@@ -0,0 +1,187 @@
+#include "mappable/mapped_file.hpp"
+
+#include <array>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "util/util.hpp"
+
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace pisa { namespace mapper {
+
+    namespace {
+
+        constexpr std::array<std::pair<std::string_view, load_mode>, 5> load_mode_names{{
+            {"mmap", load_mode::mmap},
+            {"populate", load_mode::populate},
+            {"hugepage", load_mode::hugepage},
+            {"hugetlb-2mb", load_mode::hugetlb_2mb},
+            {"hugetlb-1gb", load_mode::hugetlb_1gb},
+        }};
+
+        [[noreturn]] void throw_errno(std::string const& what)
+        {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        void advise_huge_pages(void* addr, std::size_t length)
+        {
+#ifdef MADV_HUGEPAGE
+            if (::madvise(addr, length, MADV_HUGEPAGE) != 0) {
+                spdlog::warn("Transparent huge pages are not available");
+            }
+#else
+            spdlog::warn("Transparent huge pages are not supported on this platform");
+#endif
+        }
+
+        /// Maps `length` bytes of anonymous memory backed by huge pages of `1 << page_bits`
+        /// bytes, or returns `MAP_FAILED`.
+        auto map_hugetlb(std::size_t length, int page_bits) -> void*
+        {
+#ifdef MAP_HUGETLB
+            return ::mmap(
+                nullptr,
+                length,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (page_bits << MAP_HUGE_SHIFT),
+                -1,
+                0);
+#else
+            return MAP_FAILED;
+#endif
+        }
+
+        void read_file(int fd, char* buffer, std::size_t size, std::string const& filename)
+        {
+            std::size_t offset = 0;
+            while (offset < size) {
+                auto bytes = ::pread(fd, buffer + offset, size - offset, offset);
+                if (bytes < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (bytes <= 0) {
+                    throw_errno("Cannot read " + filename);
+                }
+                offset += bytes;
+            }
+        }
+
+    }  // namespace
+
+    auto parse_load_mode(std::string_view name) -> load_mode
+    {
+        for (auto [mode_name, mode]: load_mode_names) {
+            if (mode_name == name) {
+                return mode;
+            }
+        }
+        throw std::invalid_argument("Unknown load mode: " + std::string(name));
+    }
+
+    mapped_file::mapped_file(std::string const& filename, load_mode mode)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw_errno("Cannot open " + filename);
+        }
+        try {
+            struct stat file_stat {};
+            if (::fstat(fd, &file_stat) != 0) {
+                throw_errno("Cannot stat " + filename);
+            }
+            m_size = file_stat.st_size;
+            if (m_size == 0) {
+                ::close(fd);
+                return;
+            }
+            if (mode == load_mode::hugetlb_2mb || mode == load_mode::hugetlb_1gb) {
+                int page_bits = mode == load_mode::hugetlb_2mb ? 21 : 30;
+                m_length = ceil_div(m_size, std::size_t(1) << page_bits) << page_bits;
+                void* addr = map_hugetlb(m_length, page_bits);
+                if (addr == MAP_FAILED) {
+                    spdlog::warn(
+                        "Cannot allocate {} bytes of huge pages, falling back to transparent huge "
+                        "pages",
+                        m_length);
+                    m_length = m_size;
+                    addr = ::mmap(
+                        nullptr,
+                        m_length,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1,
+                        0);
+                    if (addr == MAP_FAILED) {
+                        throw_errno("Cannot allocate memory for " + filename);
+                    }
+                    advise_huge_pages(addr, m_length);
+                }
+                m_data = static_cast<char*>(addr);
+                read_file(fd, m_data, m_size, filename);
+                ::mprotect(addr, m_length, PROT_READ);
+            } else {
+                int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+                if (mode == load_mode::populate) {
+                    flags |= MAP_POPULATE;
+                }
+#endif
+                m_length = m_size;
+                void* addr = ::mmap(nullptr, m_length, PROT_READ, flags, fd, 0);
+                if (addr == MAP_FAILED) {
+                    throw_errno("Cannot map " + filename);
+                }
+                m_data = static_cast<char*>(addr);
+                if (mode == load_mode::hugepage) {
+                    advise_huge_pages(addr, m_length);
+                }
+            }
+        } catch (...) {
+            release();
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_length(std::exchange(other.m_length, 0))
+    {}
+
+    mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_length = std::exchange(other.m_length, 0);
+        }
+        return *this;
+    }
+
+    mapped_file::~mapped_file() { release(); }
+
+    void mapped_file::release() noexcept
+    {
+        if (m_data != nullptr) {
+            ::munmap(m_data, m_length);
+            m_data = nullptr;
+        }
+    }
+
+}}  // namespace pisa::mapper
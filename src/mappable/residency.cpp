@@ -0,0 +1,106 @@
+#include "mappable/residency.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace pisa { namespace mapper {
+
+    namespace {
+
+        /// Calls `fn(begin, end)` for every page overlapping `[data, data + size)` that is
+        /// resident, with the addresses of the page clipped to the range.
+        template <typename Fn>
+        void for_each_resident_page(void const* data, std::size_t size, Fn fn)
+        {
+            if (data == nullptr || size == 0) {
+                return;
+            }
+            auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            auto address = reinterpret_cast<std::uintptr_t>(data);
+            auto begin = address & ~(std::uintptr_t(page_size) - 1);
+            auto end = address + size;
+            auto pages = (end - begin + page_size - 1) / page_size;
+
+            std::vector<unsigned char> residency(pages);
+            if (::mincore(reinterpret_cast<void*>(begin), end - begin, residency.data()) != 0) {
+                return;
+            }
+            for (std::size_t page = 0; page < pages; ++page) {
+                if ((residency[page] & 1U) != 0) {
+                    auto page_begin = std::max<std::uintptr_t>(begin + page * page_size, address);
+                    auto page_end = std::min<std::uintptr_t>(begin + (page + 1) * page_size, end);
+                    fn(page_begin, page_end);
+                }
+            }
+        }
+
+    }  // namespace
+
+    auto resident_bytes(void const* data, std::size_t size) -> std::size_t
+    {
+        std::size_t resident = 0;
+        for_each_resident_page(data, size, [&](auto begin, auto end) { resident += end - begin; });
+        return resident;
+    }
+
+    auto resident_ranges(void const* data, std::size_t size) -> byte_ranges
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(data);
+        byte_ranges ranges;
+        for_each_resident_page(data, size, [&](auto begin, auto end) {
+            std::size_t offset = begin - address;
+            if (not ranges.empty() && ranges.back().second == offset) {
+                ranges.back().second = end - address;
+            } else {
+                ranges.emplace_back(offset, end - address);
+            }
+        });
+        return ranges;
+    }
+
+    void write_residency_snapshot(
+        std::string const& filename, std::size_t size, byte_ranges const& ranges)
+    {
+        auto partial = filename + ".tmp";
+        {
+            std::ofstream os(partial);
+            os << size << '\n';
+            for (auto [begin, end]: ranges) {
+                os << begin << ' ' << end << '\n';
+            }
+            if (not os) {
+                throw std::runtime_error("Unable to write residency snapshot: " + partial);
+            }
+        }
+        if (std::rename(partial.c_str(), filename.c_str()) != 0) {
+            throw std::runtime_error("Unable to replace residency snapshot: " + filename);
+        }
+    }
+
+    auto read_residency_snapshot(std::string const& filename, std::size_t size)
+        -> std::optional<byte_ranges>
+    {
+        std::ifstream is(filename);
+        std::size_t snapshot_size = 0;
+        if (not(is >> snapshot_size) || snapshot_size != size) {
+            return std::nullopt;
+        }
+        byte_ranges ranges;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        while (is >> begin >> end) {
+            if (begin < end && end <= size) {
+                ranges.emplace_back(begin, end);
+            }
+        }
+        return ranges;
+    }
+
+}}  // namespace pisa::mapper
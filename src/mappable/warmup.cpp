@@ -0,0 +1,90 @@
+#include "mappable/warmup.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <tbb/parallel_for.h>
+
+#include "util/do_not_optimize_away.hpp"
+
+namespace pisa { namespace mapper {
+
+    namespace {
+
+        /// Ranges of at least this many pages are read by several threads.
+        constexpr std::size_t parallel_pages = 1U << 14U;
+        /// Number of pages read by a thread at a time.
+        constexpr std::size_t pages_per_chunk = 1U << 8U;
+
+        void touch_pages(char const* begin, char const* end, std::size_t page_size)
+        {
+            std::uint8_t sum = 0;
+            for (auto page = begin; page < end; page += page_size) {
+                sum += *reinterpret_cast<std::uint8_t const volatile*>(page);
+            }
+            do_not_optimize_away(sum);
+        }
+
+    }  // namespace
+
+    void warmup_memory(void const* data, std::size_t size)
+    {
+        if (data == nullptr || size == 0) {
+            return;
+        }
+        auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        auto address = reinterpret_cast<std::uintptr_t>(data);
+        auto aligned = address & ~(std::uintptr_t(page_size) - 1);
+        auto begin = reinterpret_cast<char const*>(aligned);
+        auto end = reinterpret_cast<char const*>(address + size);
+        auto length = static_cast<std::size_t>(end - begin);
+
+        // Advice is only a hint: memory that is not a file mapping may reject it.
+        ::madvise(const_cast<char*>(begin), length, MADV_WILLNEED);
+
+        auto pages = (length + page_size - 1) / page_size;
+        if (pages < parallel_pages) {
+            touch_pages(begin, end, page_size);
+            return;
+        }
+        auto chunks = (pages + pages_per_chunk - 1) / pages_per_chunk;
+        tbb::parallel_for(std::size_t(0), chunks, [&](std::size_t chunk) {
+            auto offset = chunk * pages_per_chunk * page_size;
+            auto chunk_length = std::min(length - offset, pages_per_chunk * page_size);
+            touch_pages(begin + offset, begin + offset + chunk_length, page_size);
+        });
+    }
+
+    void warmup_ranges(void const* data, std::size_t size, byte_ranges const& ranges)
+    {
+        auto bytes = static_cast<char const*>(data);
+        tbb::parallel_for(std::size_t(0), ranges.size(), [&](std::size_t idx) {
+            auto [begin, end] = ranges[idx];
+            end = std::min(end, size);
+            if (begin < end) {
+                warmup_memory(bytes + begin, end - begin);
+            }
+        });
+    }
+
+    void evict_memory(void const* data, std::size_t size, std::string const& filename)
+    {
+        if (data != nullptr && size > 0) {
+            auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            auto address = reinterpret_cast<std::uintptr_t>(data);
+            auto aligned = address & ~(std::uintptr_t(page_size) - 1);
+            // Advice is only a hint, so failures are ignored.
+            ::madvise(reinterpret_cast<char*>(aligned), address + size - aligned, MADV_DONTNEED);
+        }
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+
+}}  // namespace pisa::mapper
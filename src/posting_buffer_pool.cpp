@@ -0,0 +1,169 @@
+#include "posting_buffer_pool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <tbb/parallel_for.h>
+
+namespace pisa {
+
+namespace {
+
+    [[noreturn]] void throw_errno(std::string const& what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void read_range(int fd, posting_buffer_pool::byte_range range, std::uint8_t* buffer)
+    {
+        std::size_t done = 0;
+        while (done < range.length) {
+            auto bytes = ::pread(fd, buffer + done, range.length - done, range.offset + done);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes <= 0) {
+                throw_errno("Cannot read posting list range");
+            }
+            done += bytes;
+        }
+    }
+
+}  // namespace
+
+auto posting_buffer_pool::shard::find(std::uint64_t offset) -> frame
+{
+    auto pos = slots.find(offset);
+    if (pos == slots.end()) {
+        stats.misses += 1;
+        return nullptr;
+    }
+    stats.hits += 1;
+    auto& entry = clock[pos->second];
+    entry.usage = std::min<std::uint8_t>(entry.usage + 1, max_usage);
+    return entry.data;
+}
+
+auto posting_buffer_pool::shard::insert(std::uint64_t offset, frame data) -> frame
+{
+    stats.bytes_read += data->size() - frame_padding;
+    if (auto pos = slots.find(offset); pos != slots.end()) {
+        // read concurrently by another query
+        return clock[pos->second].data;
+    }
+    if (data->size() > capacity) {
+        return data;
+    }
+    std::size_t position = clock.size();
+    if (free_slots.empty()) {
+        clock.emplace_back();
+    } else {
+        position = free_slots.back();
+        free_slots.pop_back();
+    }
+    clock[position] = slot{offset, data, 1};
+    slots.emplace(offset, position);
+    bytes += data->size();
+
+    while (bytes > capacity) {
+        hand = hand < clock.size() ? hand : 0;
+        auto& entry = clock[hand];
+        if (entry.data != nullptr && entry.usage > 0) {
+            entry.usage -= 1;
+        } else if (entry.data != nullptr) {
+            bytes -= entry.data->size();
+            slots.erase(entry.offset);
+            entry.data = nullptr;
+            free_slots.push_back(hand);
+            stats.evictions += 1;
+        }
+        hand += 1;
+    }
+    return data;
+}
+
+posting_buffer_pool::posting_buffer_pool(
+    std::string const& filename, std::size_t capacity, std::size_t shards)
+    : m_fd(::open(filename.c_str(), O_RDONLY))
+{
+    if (m_fd < 0) {
+        throw_errno("Cannot open " + filename);
+    }
+    shards = std::max<std::size_t>(shards, 1);
+    for (std::size_t idx = 0; idx < shards; ++idx) {
+        m_shards.push_back(std::make_unique<shard>());
+        m_shards.back()->capacity = capacity / shards;
+    }
+}
+
+posting_buffer_pool::~posting_buffer_pool()
+{
+    ::close(m_fd);
+}
+
+auto posting_buffer_pool::shard_of(std::uint64_t offset) -> shard&
+{
+    auto hash = (offset * UINT64_C(0x9E3779B97F4A7C15)) >> 32U;
+    return *m_shards[hash % m_shards.size()];
+}
+
+auto posting_buffer_pool::fetch(std::vector<byte_range> const& ranges) -> std::vector<frame>
+{
+    std::vector<frame> frames(ranges.size());
+    std::vector<std::size_t> missing;
+    std::unordered_map<std::uint64_t, std::size_t> first_missing;
+    for (std::size_t idx = 0; idx < ranges.size(); ++idx) {
+        auto& cache = shard_of(ranges[idx].offset);
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        frames[idx] = cache.find(ranges[idx].offset);
+        if (frames[idx] == nullptr && first_missing.emplace(ranges[idx].offset, idx).second) {
+            missing.push_back(idx);
+        }
+    }
+
+    tbb::parallel_for(std::size_t(0), missing.size(), [&](std::size_t pos) {
+        auto idx = missing[pos];
+        auto buffer =
+            std::make_shared<std::vector<std::uint8_t>>(ranges[idx].length + frame_padding);
+        read_range(m_fd, ranges[idx], buffer->data());
+        auto& cache = shard_of(ranges[idx].offset);
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        frames[idx] = cache.insert(ranges[idx].offset, std::move(buffer));
+    });
+
+    for (std::size_t idx = 0; idx < ranges.size(); ++idx) {
+        if (frames[idx] == nullptr) {
+            frames[idx] = frames[first_missing.at(ranges[idx].offset)];
+        }
+    }
+    return frames;
+}
+
+auto posting_buffer_pool::cached_bytes() const -> std::size_t
+{
+    std::size_t bytes = 0;
+    for (auto const& cache: m_shards) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        bytes += cache->bytes;
+    }
+    return bytes;
+}
+
+auto posting_buffer_pool::stats() const -> statistics
+{
+    statistics total;
+    for (auto const& cache: m_shards) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        total.hits += cache->stats.hits;
+        total.misses += cache->stats.misses;
+        total.bytes_read += cache->stats.bytes_read;
+        total.evictions += cache->stats.evictions;
+    }
+    return total;
+}
+
+}  // namespace pisa
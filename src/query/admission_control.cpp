@@ -0,0 +1,85 @@
+#include "query/admission_control.hpp"
+
+#include <algorithm>
+
+namespace pisa {
+
+auto admission_controller::admit(std::size_t bytes, std::optional<std::size_t> fallback_bytes)
+    -> ticket
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto take = [&](std::size_t reserved, decision outcome) {
+        m_used += reserved;
+        if (outcome == decision::admitted) {
+            m_counters.admitted += 1;
+        } else {
+            m_counters.downgraded += 1;
+        }
+        return ticket(this, reserved, outcome);
+    };
+    if (m_waiters.empty() && fits(bytes)) {
+        return take(bytes, decision::admitted);
+    }
+    if (fallback_bytes && fits(*fallback_bytes)) {
+        return take(*fallback_bytes, decision::downgraded);
+    }
+    if (m_waiters.size() >= m_max_waiting) {
+        m_counters.rejected += 1;
+        return ticket(nullptr, 0, decision::rejected);
+    }
+
+    // Waiting queries are admitted in the order they arrived, each once it is the first one and
+    // fits, so that a large query is not passed over by smaller ones forever.
+    auto number = m_next_waiter++;
+    m_waiters.push_back(number);
+    m_counters.waited += 1;
+    std::optional<decision> outcome;
+    m_released.wait_for(lock, m_max_wait, [&] {
+        if (m_waiters.front() != number) {
+            return false;
+        }
+        if (fits(bytes)) {
+            outcome = decision::admitted;
+        } else if (fallback_bytes && fits(*fallback_bytes)) {
+            outcome = decision::downgraded;
+        }
+        return outcome.has_value();
+    });
+    m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), number));
+    // The next query may fit too, or be first now that this one gave up.
+    m_released.notify_all();
+    if (not outcome) {
+        m_counters.rejected += 1;
+        return ticket(nullptr, 0, decision::rejected);
+    }
+    return take(*outcome == decision::admitted ? bytes : *fallback_bytes, *outcome);
+}
+
+void admission_controller::release(std::size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_used -= bytes;
+    }
+    m_released.notify_all();
+}
+
+auto admission_controller::used() const -> std::size_t
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used;
+}
+
+auto admission_controller::waiting() const -> std::size_t
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_waiters.size();
+}
+
+auto admission_controller::stats() const -> counters
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_counters;
+}
+
+}  // namespace pisa
@@ -0,0 +1,128 @@
+#include "query/binary_queries.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace pisa {
+
+namespace {
+
+    constexpr uint32_t no_id = 0xFFFFFFFF;
+
+    [[nodiscard]] auto padded_words(std::size_t bytes) -> std::size_t { return (bytes + 3) / 4; }
+
+}  // namespace
+
+auto binary_queries::query_view::id() const -> std::optional<std::string_view>
+{
+    if (m_data[0] == no_id) {
+        return std::nullopt;
+    }
+    return std::string_view(reinterpret_cast<char const*>(m_data + 3), m_data[0]);
+}
+
+auto binary_queries::query_view::terms() const -> gsl::span<term_id_type const>
+{
+    auto id_words = m_data[0] == no_id ? 0 : padded_words(m_data[0]);
+    return gsl::span<term_id_type const>(m_data + 3 + id_words, m_data[1]);
+}
+
+auto binary_queries::query_view::term_weights() const -> gsl::span<float const>
+{
+    if (m_data[2] == 0) {
+        return gsl::span<float const>();
+    }
+    auto terms = this->terms();
+    return gsl::span<float const>(
+        reinterpret_cast<float const*>(terms.data() + terms.size()), terms.size());
+}
+
+auto binary_queries::query_view::to_query() const -> Query
+{
+    Query query;
+    if (auto id = this->id(); id) {
+        query.id = std::string(*id);
+    }
+    auto terms = this->terms();
+    query.terms.assign(terms.begin(), terms.end());
+    auto weights = term_weights();
+    query.term_weights.assign(weights.begin(), weights.end());
+    return query;
+}
+
+binary_queries::binary_queries(std::string const& filename) : m_file(filename)
+{
+    auto header_size = magic.size() + sizeof(uint64_t);
+    if (m_file.size() < header_size || std::string_view(m_file.data(), magic.size()) != magic) {
+        throw std::invalid_argument(fmt::format("{} is not a binary query file", filename));
+    }
+    std::memcpy(&m_size, m_file.data() + magic.size(), sizeof(uint64_t));
+    m_offsets = reinterpret_cast<uint64_t const*>(m_file.data() + header_size);
+    m_queries = reinterpret_cast<uint32_t const*>(m_offsets + m_size + 1);
+    auto offsets_end = header_size + sizeof(uint64_t) * (m_size + 1);
+    if (m_file.size() < offsets_end || m_offsets[m_size] != (m_file.size() - offsets_end) / 4) {
+        throw std::invalid_argument(fmt::format("Binary query file {} is truncated", filename));
+    }
+}
+
+auto binary_queries::operator[](std::size_t query) const -> query_view
+{
+    return query_view(m_queries + m_offsets[query]);
+}
+
+auto binary_queries::to_queries() const -> std::vector<Query>
+{
+    std::vector<Query> queries;
+    queries.reserve(m_size);
+    for (std::size_t query = 0; query < m_size; ++query) {
+        queries.push_back((*this)[query].to_query());
+    }
+    return queries;
+}
+
+auto binary_queries::is_binary_query_file(std::string const& filename) -> bool
+{
+    std::ifstream is(filename, std::ios::binary);
+    std::string header(magic.size(), '\0');
+    return is.read(header.data(), header.size()) && header == magic;
+}
+
+void binary_queries::write(std::ostream& os, gsl::span<Query const> queries)
+{
+    auto write_words = [&](auto const* data, std::size_t count) {
+        os.write(reinterpret_cast<char const*>(data), count * 4);
+    };
+    uint64_t size = queries.size();
+    os.write(magic.data(), magic.size());
+    os.write(reinterpret_cast<char const*>(&size), sizeof(size));
+    uint64_t offset = 0;
+    for (auto const& query: queries) {
+        os.write(reinterpret_cast<char const*>(&offset), sizeof(offset));
+        auto id_words = query.id ? padded_words(query.id->size()) : 0;
+        offset += 3 + id_words + query.terms.size() * (query.term_weights.empty() ? 1 : 2);
+    }
+    os.write(reinterpret_cast<char const*>(&offset), sizeof(offset));
+    for (auto const& query: queries) {
+        if (not query.term_weights.empty() && query.term_weights.size() != query.terms.size()) {
+            throw std::invalid_argument("Query must have as many term weights as terms");
+        }
+        uint32_t header[] = {
+            query.id ? static_cast<uint32_t>(query.id->size()) : no_id,
+            static_cast<uint32_t>(query.terms.size()),
+            query.term_weights.empty() ? 0U : 1U};
+        write_words(header, 3);
+        if (query.id) {
+            std::string id = *query.id;
+            id.resize(padded_words(id.size()) * 4, '\0');
+            os.write(id.data(), id.size());
+        }
+        write_words(query.terms.data(), query.terms.size());
+        write_words(query.term_weights.data(), query.term_weights.size());
+    }
+}
+
+}  // namespace pisa
@@ -1,6 +1,9 @@
 #include "query/queries.hpp"
 
-#include <boost/algorithm/string.hpp>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
 #include <range/v3/view/enumerate.hpp>
 #include <spdlog/spdlog.h>
 
@@ -11,63 +14,130 @@
 
 namespace pisa {
 
-auto split_query_at_colon(std::string const& query_string)
+auto split_query_at_colon(std::string_view query_string)
     -> std::pair<std::optional<std::string>, std::string_view>
 {
     // query id : terms (or ids)
-    auto colon = std::find(query_string.begin(), query_string.end(), ':');
-    std::optional<std::string> id;
-    if (colon != query_string.end()) {
-        id = std::string(query_string.begin(), colon);
-    }
-    auto pos = colon == query_string.end() ? query_string.begin() : std::next(colon);
-    auto raw_query = std::string_view(&*pos, std::distance(pos, query_string.end()));
-    return {std::move(id), std::move(raw_query)};
+    auto colon = query_string.find(':');
+    if (colon == std::string_view::npos) {
+        return {std::nullopt, query_string};
+    }
+    return {std::string(query_string.substr(0, colon)), query_string.substr(colon + 1)};
 }
 
-auto parse_query_terms(std::string const& query_string, TermProcessor term_processor) -> Query
+namespace {
+
+    /// Parses the weight of a term, which follows a `^`.
+    auto parse_weight(std::string_view weight, std::string_view query) -> float
+    {
+        std::string buffer(weight);
+        char* end = nullptr;
+        float value = std::strtof(buffer.c_str(), &end);
+        if (buffer.empty() || end != buffer.c_str() + buffer.size()) {
+            spdlog::error("Could not parse term weight `{}` of query `{}`", weight, query);
+            exit(1);
+        }
+        return value;
+    }
+
+    /// Sets the weights of the terms of `query` from `first` on. The weights of the previous terms
+    /// are set to 1 if the query has none yet, so that they are stored only if needed.
+    void set_weights(Query& query, std::size_t first, float weight)
+    {
+        if (query.term_weights.empty() && weight == 1.0F) {
+            return;
+        }
+        query.term_weights.resize(first, 1.0F);
+        query.term_weights.resize(query.terms.size(), weight);
+    }
+
+}  // namespace
+
+auto parse_query_terms(std::string_view query_string, TermProcessor const& term_processor)
+    -> Query
 {
     auto [id, raw_query] = split_query_at_colon(query_string);
-    TermTokenizer tokenizer(raw_query);
-    std::vector<term_id_type> parsed_query;
-    for (auto term_iter = tokenizer.begin(); term_iter != tokenizer.end(); ++term_iter) {
-        auto raw_term = *term_iter;
-        auto term = term_processor(raw_term);
-        if (term) {
-            if (!term_processor.is_stopword(*term)) {
-                parsed_query.push_back(std::move(*term));
+    Query query{std::move(id), {}, {}};
+    auto add_terms = [&](std::string_view text, float weight) {
+        auto first = query.terms.size();
+        TermTokenizer tokenizer(text);
+        for (auto term_iter = tokenizer.begin(); term_iter != tokenizer.end(); ++term_iter) {
+            auto raw_term = *term_iter;
+            auto term = term_processor(raw_term);
+            if (term) {
+                if (!term_processor.is_stopword(*term)) {
+                    query.terms.push_back(*term);
+                } else {
+                    spdlog::warn("Term `{}` is a stopword and will be ignored", raw_term);
+                }
             } else {
-                spdlog::warn("Term `{}` is a stopword and will be ignored", raw_term);
+                spdlog::warn("Term `{}` not found and will be ignored", raw_term);
             }
+        }
+        set_weights(query, first, weight);
+    };
+    if (raw_query.find('^') == std::string_view::npos) {
+        add_terms(raw_query, 1.0F);
+        return query;
+    }
+    // Weights apply to all terms of the whitespace-separated token they end.
+    auto is_space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    auto pos = raw_query.begin();
+    while (pos != raw_query.end()) {
+        auto token_end = std::find_if(pos, raw_query.end(), is_space);
+        auto token = raw_query.substr(
+            std::distance(raw_query.begin(), pos), std::distance(pos, token_end));
+        auto caret = token.rfind('^');
+        if (caret == std::string_view::npos) {
+            add_terms(token, 1.0F);
         } else {
-            spdlog::warn("Term `{}` not found and will be ignored", raw_term);
+            add_terms(token.substr(0, caret), parse_weight(token.substr(caret + 1), raw_query));
         }
+        pos = std::find_if_not(token_end, raw_query.end(), is_space);
     }
-    return {std::move(id), std::move(parsed_query), {}};
+    return query;
 }
 
-auto parse_query_ids(std::string const& query_string) -> Query
+auto parse_query_ids(std::string_view query_string) -> Query
 {
     auto [id, raw_query] = split_query_at_colon(query_string);
-    std::vector<term_id_type> parsed_query;
-    std::vector<std::string> term_ids;
-    boost::split(term_ids, raw_query, boost::is_any_of("\t, ,\v,\f,\r,\n"));
-
-    auto is_empty = [](const std::string& val) { return val.empty(); };
-    // remove_if move matching elements to the end, preparing them for erase.
-    term_ids.erase(std::remove_if(term_ids.begin(), term_ids.end(), is_empty), term_ids.end());
-
-    try {
-        auto to_int = [](const std::string& val) { return std::stoi(val); };
-        std::transform(term_ids.begin(), term_ids.end(), std::back_inserter(parsed_query), to_int);
-    } catch (std::invalid_argument& err) {
-        spdlog::error("Could not parse term identifiers of query `{}`", raw_query);
-        exit(1);
-    }
-    return {std::move(id), std::move(parsed_query), {}};
+    auto is_separator = [](char c) {
+        return c == ',' || std::isspace(static_cast<unsigned char>(c)) != 0;
+    };
+    auto is_digit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+    Query query{std::move(id), {}, {}};
+    auto pos = raw_query.begin();
+    while (pos != raw_query.end()) {
+        if (is_separator(*pos)) {
+            ++pos;
+            continue;
+        }
+        if (not is_digit(*pos)) {
+            spdlog::error("Could not parse term identifiers of query `{}`", raw_query);
+            exit(1);
+        }
+        // As with `std::stoi`, anything between the digits and the next separator is ignored.
+        term_id_type term = 0;
+        for (; pos != raw_query.end() && is_digit(*pos); ++pos) {
+            term = term * 10 + (*pos - '0');
+        }
+        query.terms.push_back(term);
+        float weight = 1.0F;
+        if (pos != raw_query.end() && *pos == '^') {
+            auto weight_end = std::find_if(std::next(pos), raw_query.end(), is_separator);
+            weight = parse_weight(
+                raw_query.substr(
+                    std::distance(raw_query.begin(), pos) + 1, std::distance(pos, weight_end) - 1),
+                raw_query);
+            pos = weight_end;
+        }
+        set_weights(query, query.terms.size() - 1, weight);
+        pos = std::find_if(pos, raw_query.end(), is_separator);
+    }
+    return query;
 }
 
-std::function<void(const std::string)> resolve_query_parser(
+std::function<void(std::string const&)> resolve_query_parser(
     std::vector<Query>& queries,
     std::optional<std::string> const& terms_file,
     std::optional<std::string> const& stopwords_filename,
@@ -117,4 +187,75 @@ term_freq_vec query_freqs(term_id_vec terms)
     return query_term_freqs;
 }
 
+auto query_freqs(term_id_vec const& terms, query_arena& arena) -> arena_vector<term_freq_pair>
+{
+    arena_vector<term_id_type> sorted(
+        terms.begin(), terms.end(), arena_allocator<term_id_type>(arena));
+    std::sort(sorted.begin(), sorted.end());
+    arena_vector<term_freq_pair> query_term_freqs{arena_allocator<term_freq_pair>(arena)};
+    query_term_freqs.reserve(sorted.size());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (i == 0 || sorted[i] != sorted[i - 1]) {
+            query_term_freqs.emplace_back(sorted[i], 1);
+        } else {
+            query_term_freqs.back().second += 1;
+        }
+    }
+    return query_term_freqs;
+}
+
+auto query_weights(Query const& query) -> term_weight_vec
+{
+    if (query.term_weights.empty()) {
+        auto term_freqs = query_freqs(query.terms);
+        return term_weight_vec(term_freqs.begin(), term_freqs.end());
+    }
+    if (query.term_weights.size() != query.terms.size()) {
+        throw std::invalid_argument("Query must have as many term weights as terms");
+    }
+    term_weight_vec weighted_terms;
+    weighted_terms.reserve(query.terms.size());
+    for (size_t i = 0; i < query.terms.size(); ++i) {
+        weighted_terms.emplace_back(query.terms[i], query.term_weights[i]);
+    }
+    std::sort(weighted_terms.begin(), weighted_terms.end());
+    term_weight_vec query_term_weights;
+    for (auto [term, weight]: weighted_terms) {
+        if (query_term_weights.empty() || query_term_weights.back().first != term) {
+            query_term_weights.emplace_back(term, weight);
+        } else {
+            query_term_weights.back().second += weight;
+        }
+    }
+    return query_term_weights;
+}
+
+auto query_weights(Query const& query, query_arena& arena) -> arena_vector<term_weight_pair>
+{
+    arena_vector<term_weight_pair> query_term_weights{arena_allocator<term_weight_pair>(arena)};
+    if (query.term_weights.empty()) {
+        auto term_freqs = query_freqs(query.terms, arena);
+        query_term_weights.assign(term_freqs.begin(), term_freqs.end());
+        return query_term_weights;
+    }
+    if (query.term_weights.size() != query.terms.size()) {
+        throw std::invalid_argument("Query must have as many term weights as terms");
+    }
+    arena_vector<term_weight_pair> weighted_terms{arena_allocator<term_weight_pair>(arena)};
+    weighted_terms.reserve(query.terms.size());
+    for (size_t i = 0; i < query.terms.size(); ++i) {
+        weighted_terms.emplace_back(query.terms[i], query.term_weights[i]);
+    }
+    std::sort(weighted_terms.begin(), weighted_terms.end());
+    query_term_weights.reserve(weighted_terms.size());
+    for (auto [term, weight]: weighted_terms) {
+        if (query_term_weights.empty() || query_term_weights.back().first != term) {
+            query_term_weights.emplace_back(term, weight);
+        } else {
+            query_term_weights.back().second += weight;
+        }
+    }
+    return query_term_weights;
+}
+
 }  // namespace pisa
@@ -0,0 +1,133 @@
+#include "query/query_trace.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace pisa { namespace query_trace_file {
+
+    namespace {
+
+        void write_varint(std::ostream& os, std::uint64_t value)
+        {
+            while (value >= 128U) {
+                os.put(static_cast<char>((value & 127U) | 128U));
+                value >>= 7U;
+            }
+            os.put(static_cast<char>(value));
+        }
+
+        void write_string(std::ostream& os, std::string const& value)
+        {
+            write_varint(os, value.size());
+            os.write(value.data(), value.size());
+        }
+
+        [[nodiscard]] auto read_varint(std::istream& is) -> std::uint64_t
+        {
+            std::uint64_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                auto byte = is.get();
+                if (byte == std::istream::traits_type::eof()) {
+                    throw std::invalid_argument("Truncated trace file");
+                }
+                value |= static_cast<std::uint64_t>(byte & 127) << shift;
+                if ((byte & 128) == 0) {
+                    return value;
+                }
+            }
+            throw std::invalid_argument("Corrupted trace file");
+        }
+
+        [[nodiscard]] auto read_string(std::istream& is, std::size_t length) -> std::string
+        {
+            std::string value(length, '\0');
+            if (not is.read(value.data(), length)) {
+                throw std::invalid_argument("Truncated trace file");
+            }
+            return value;
+        }
+
+    }  // namespace
+
+    void write(std::ostream& os, trace_header const& header, std::vector<query_trace> const& traces)
+    {
+        os.write(magic.data(), magic.size());
+        write_string(os, header.algorithm);
+        write_string(os, header.encoding);
+        write_varint(os, header.k);
+        write_varint(os, traces.size());
+        for (auto const& trace: traces) {
+            if (trace.id) {
+                write_varint(os, trace.id->size() + 1);
+                os.write(trace.id->data(), trace.id->size());
+            } else {
+                write_varint(os, 0);
+            }
+            write_varint(os, trace.terms.size());
+            for (auto term: trace.terms) {
+                write_varint(os, term);
+            }
+            write_varint(os, trace.nanoseconds);
+            write_varint(os, trace.events.size());
+            std::uint64_t last = 0;
+            for (auto const& event: trace.events) {
+                write_varint(os, static_cast<std::uint64_t>(event.type));
+                write_varint(os, event.nanoseconds - last);
+                last = event.nanoseconds;
+                if (event.type == trace_event::kind::threshold) {
+                    char bytes[sizeof(float)];
+                    std::memcpy(bytes, &event.threshold, sizeof(float));
+                    os.write(bytes, sizeof(float));
+                } else {
+                    write_varint(os, event.term);
+                    write_varint(os, event.block);
+                }
+            }
+        }
+        if (not os) {
+            throw std::runtime_error("Unable to write trace file");
+        }
+    }
+
+    auto read(std::istream& is) -> std::pair<trace_header, std::vector<query_trace>>
+    {
+        if (read_string(is, magic.size()) != magic) {
+            throw std::invalid_argument("Not a trace file");
+        }
+        trace_header header;
+        header.algorithm = read_string(is, read_varint(is));
+        header.encoding = read_string(is, read_varint(is));
+        header.k = read_varint(is);
+        std::vector<query_trace> traces(read_varint(is));
+        for (auto& trace: traces) {
+            if (auto id_length = read_varint(is); id_length > 0) {
+                trace.id = read_string(is, id_length - 1);
+            }
+            trace.terms.resize(read_varint(is));
+            for (auto& term: trace.terms) {
+                term = read_varint(is);
+            }
+            trace.nanoseconds = read_varint(is);
+            trace.events.resize(read_varint(is));
+            std::uint64_t last = 0;
+            for (auto& event: trace.events) {
+                auto type = read_varint(is);
+                if (type > static_cast<std::uint64_t>(trace_event::kind::threshold)) {
+                    throw std::invalid_argument("Corrupted trace file");
+                }
+                event.type = static_cast<trace_event::kind>(type);
+                event.nanoseconds = last + read_varint(is);
+                last = event.nanoseconds;
+                if (event.type == trace_event::kind::threshold) {
+                    auto bytes = read_string(is, sizeof(float));
+                    std::memcpy(&event.threshold, bytes.data(), sizeof(float));
+                } else {
+                    event.term = read_varint(is);
+                    event.block = read_varint(is);
+                }
+            }
+        }
+        return {std::move(header), std::move(traces)};
+    }
+
+}}  // namespace pisa::query_trace_file
@@ -0,0 +1,239 @@
+#include "util/collection_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "binary_collection.hpp"
+
+namespace pisa {
+
+namespace {
+
+    [[noreturn]] void throw_errno(std::string const& what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    template <typename T>
+    void write_sequence(Aligned_File_Writer& writer, std::vector<T> const& sequence)
+    {
+        auto length = static_cast<std::uint32_t>(sequence.size());
+        writer.write(reinterpret_cast<char const*>(&length), sizeof(length));
+        writer.write(reinterpret_cast<char const*>(sequence.data()), length * sizeof(T));
+    }
+
+    void write_offsets(std::string const& filename, std::vector<std::uint64_t> const& offsets)
+    {
+        std::ofstream os(filename, std::ios::binary);
+        os.write(
+            reinterpret_cast<char const*>(offsets.data()), offsets.size() * sizeof(offsets[0]));
+        if (not os) {
+            throw std::runtime_error("Unable to write " + filename);
+        }
+    }
+
+}  // namespace
+
+void Aligned_File_Writer::Free::operator()(char* buffer) const
+{
+    std::free(buffer);
+}
+
+Aligned_File_Writer::Aligned_File_Writer(std::string const& filename, std::size_t buffer_size)
+    : m_filename(filename),
+      m_capacity(std::max(alignment, (buffer_size + alignment - 1) / alignment * alignment))
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    // Some file systems, e.g., tmpfs, reject `O_DIRECT`, in which case the file is written
+    // through the page cache, still a buffer at a time.
+    m_fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+    m_direct = m_fd >= 0;
+#endif
+    if (m_fd < 0) {
+        m_fd = ::open(filename.c_str(), flags, 0644);
+    }
+    if (m_fd < 0) {
+        throw_errno("Unable to open " + filename);
+    }
+    m_buffer.reset(static_cast<char*>(std::aligned_alloc(alignment, m_capacity)));
+    if (not m_buffer) {
+        ::close(m_fd);
+        throw std::bad_alloc();
+    }
+}
+
+Aligned_File_Writer::~Aligned_File_Writer()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void Aligned_File_Writer::write(char const* data, std::size_t size)
+{
+    while (size > 0) {
+        auto count = std::min(size, m_capacity - m_size);
+        std::memcpy(m_buffer.get() + m_size, data, count);
+        m_size += count;
+        data += count;
+        size -= count;
+        if (m_size == m_capacity) {
+            write_buffer(m_size);
+            m_size = 0;
+        }
+    }
+}
+
+void Aligned_File_Writer::close()
+{
+    if (m_fd < 0) {
+        return;
+    }
+    if (m_size > 0) {
+#ifdef O_DIRECT
+        // A direct write must be a multiple of the block size, which the tail is not.
+        if (m_direct && ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) & ~O_DIRECT) != 0) {
+            throw_errno("Unable to write " + m_filename);
+        }
+#endif
+        write_buffer(m_size);
+        m_size = 0;
+    }
+    auto fd = m_fd;
+    m_fd = -1;
+    if (::close(fd) != 0) {
+        throw_errno("Unable to close " + m_filename);
+    }
+}
+
+void Aligned_File_Writer::write_buffer(std::size_t size)
+{
+    std::size_t written = 0;
+    while (written < size) {
+        auto result = ::write(m_fd, m_buffer.get() + written, size - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("Unable to write " + m_filename);
+        }
+        written += static_cast<std::size_t>(result);
+    }
+}
+
+Freq_Collection_Writer::Freq_Collection_Writer(
+    std::string const& basename,
+    std::uint32_t document_count,
+    std::size_t buffer_size,
+    std::size_t capacity)
+    : m_basename(basename),
+      m_docs(basename + ".docs", buffer_size),
+      m_freqs(basename + ".freqs", buffer_size)
+{
+    write_sequence(m_docs, std::vector<std::uint32_t>{document_count});
+    m_queue.set_capacity(capacity);
+    m_thread = std::thread([this] { write_lists(); });
+}
+
+Freq_Collection_Writer::~Freq_Collection_Writer()
+{
+    join();
+}
+
+void Freq_Collection_Writer::push(
+    std::size_t position,
+    std::vector<std::uint32_t> documents,
+    std::vector<std::uint32_t> frequencies)
+{
+    m_queue.push(std::make_pair(
+        position, std::make_pair(std::move(documents), std::move(frequencies))));
+}
+
+void Freq_Collection_Writer::close()
+{
+    join();
+    if (m_error) {
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+}
+
+void Freq_Collection_Writer::join()
+{
+    if (not m_thread.joinable()) {
+        return;
+    }
+    m_queue.push(std::nullopt);
+    m_thread.join();
+}
+
+void Freq_Collection_Writer::write_lists()
+{
+    std::map<std::size_t, list_type> pending;
+    std::size_t next = 0;
+    // After an error, lists are still taken off the queue, so that producers never wait for a
+    // writer that is gone, but no longer written.
+    // Offsets of the sequences in words, with the number of documents first in `.docs`.
+    std::vector<std::uint64_t> docs_offsets{0, 2};
+    std::vector<std::uint64_t> freqs_offsets{0};
+    auto write = [&](list_type const& list) {
+        if (m_error) {
+            return;
+        }
+        try {
+            write_sequence(m_docs, list.first);
+            write_sequence(m_freqs, list.second);
+            m_postings += list.first.size();
+            docs_offsets.push_back(docs_offsets.back() + 1 + list.first.size());
+            freqs_offsets.push_back(freqs_offsets.back() + 1 + list.second.size());
+        } catch (...) {
+            m_error = std::current_exception();
+        }
+    };
+    while (true) {
+        std::optional<std::pair<std::size_t, list_type>> list;
+        m_queue.pop(list);
+        if (not list) {
+            break;
+        }
+        if (list->first != next) {
+            pending.emplace(list->first, std::move(list->second));
+            continue;
+        }
+        write(list->second);
+        next += 1;
+        for (auto pos = pending.begin(); pos != pending.end() and pos->first == next;
+             pos = pending.erase(pos)) {
+            write(pos->second);
+            next += 1;
+        }
+    }
+    for (auto const& [position, list]: pending) {
+        write(list);
+    }
+    try {
+        m_docs.close();
+        m_freqs.close();
+        if (not m_error) {
+            write_offsets(binary_collection::offsets_filename(m_basename + ".docs"), docs_offsets);
+            write_offsets(
+                binary_collection::offsets_filename(m_basename + ".freqs"), freqs_offsets);
+        }
+    } catch (...) {
+        if (not m_error) {
+            m_error = std::current_exception();
+        }
+    }
+}
+
+}  // namespace pisa
@@ -0,0 +1,180 @@
+#include "util/inverted_index_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
+namespace pisa {
+
+namespace {
+
+    [[noreturn]] void throw_errno(std::string const& what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    /// A file of a given size, written at arbitrary offsets, possibly by several threads.
+    class positional_file {
+      public:
+        positional_file(std::string const& filename, std::uint64_t size)
+            : m_fd(::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644))
+        {
+            if (m_fd < 0) {
+                throw_errno("Cannot open " + filename);
+            }
+            if (::ftruncate(m_fd, size) != 0) {
+                ::close(m_fd);
+                throw_errno("Cannot resize " + filename);
+            }
+        }
+        positional_file(positional_file const&) = delete;
+        positional_file& operator=(positional_file const&) = delete;
+        ~positional_file() { ::close(m_fd); }
+
+        void write(std::vector<std::uint32_t> const& values, std::uint64_t offset) const
+        {
+            auto const* data = reinterpret_cast<char const*>(values.data());
+            std::size_t length = values.size() * sizeof(values[0]);
+            std::size_t done = 0;
+            while (done < length) {
+                auto bytes = ::pwrite(m_fd, data + done, length - done, offset + done);
+                if (bytes < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (bytes <= 0) {
+                    throw_errno("Cannot write posting list");
+                }
+                done += bytes;
+            }
+        }
+
+      private:
+        int m_fd;
+    };
+
+    /// Buffers in which a thread remaps and sorts the postings of a list.
+    struct reorder_buffers {
+        /// Postings encoded as `document << 32 | frequency`, to be sorted by document.
+        std::vector<std::uint64_t> postings;
+        std::vector<std::uint64_t> sorted;
+        std::vector<std::uint32_t> docs;
+        std::vector<std::uint32_t> freqs;
+    };
+
+    /// Sorts postings encoded as `document << 32 | frequency` by their documents, which hold in
+    /// `document_bits` bits, with a least significant digit radix sort for long lists.
+    void sort_postings(
+        std::vector<std::uint64_t>& postings, std::vector<std::uint64_t>& buffer, int document_bits)
+    {
+        constexpr int digit_bits = 8;
+        constexpr std::size_t min_radix_sort_size = 256;
+        if (postings.size() < min_radix_sort_size) {
+            std::sort(postings.begin(), postings.end());
+            return;
+        }
+        buffer.resize(postings.size());
+        for (int shift = 32; shift < 32 + document_bits; shift += digit_bits) {
+            std::array<std::size_t, 1U << digit_bits> offsets{};
+            for (auto posting: postings) {
+                offsets[(posting >> shift) & (offsets.size() - 1)] += 1;
+            }
+            std::size_t offset = 0;
+            for (auto& count: offsets) {
+                offset += std::exchange(count, offset);
+            }
+            for (auto posting: postings) {
+                buffer[offsets[(posting >> shift) & (offsets.size() - 1)]++] = posting;
+            }
+            postings.swap(buffer);
+        }
+    }
+
+}  // namespace
+
+void reorder_postings(
+    const std::string& input_basename,
+    const std::string& output_basename,
+    const std::vector<uint32_t>& mapping)
+{
+    binary_freq_collection input(input_basename.c_str());
+
+    // Offsets of the lists, in words, which are those of the input: each list is preceded by its
+    // length, and the documents by a list of the number of documents.
+    std::vector<binary_freq_collection::sequence> lists;
+    std::vector<std::uint64_t> offsets{0};
+    for (auto const& seq: input) {
+        lists.push_back(seq);
+        offsets.push_back(offsets.back() + 1 + seq.docs.size());
+    }
+    positional_file output_docs(output_basename + ".docs", (2 + offsets.back()) * sizeof(uint32_t));
+    positional_file output_freqs(output_basename + ".freqs", offsets.back() * sizeof(uint32_t));
+    output_docs.write({1, static_cast<uint32_t>(mapping.size())}, 0);
+
+    int document_bits = 1;
+    while (document_bits < 32 && (std::uint64_t(1) << document_bits) < mapping.size()) {
+        ++document_bits;
+    }
+
+    pisa::progress reorder_progress("Reorder inverted index", lists.size());
+    tbb::enumerable_thread_specific<reorder_buffers> thread_buffers;
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, lists.size()), [&](auto const& terms) {
+        auto& buffers = thread_buffers.local();
+        for (auto term = terms.begin(); term != terms.end(); ++term) {
+            auto const& list = lists[term];
+            auto size = list.docs.size();
+            buffers.postings.resize(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                buffers.postings[i] =
+                    std::uint64_t(mapping[list.docs.begin()[i]]) << 32U | list.freqs.begin()[i];
+            }
+            sort_postings(buffers.postings, buffers.sorted, document_bits);
+
+            buffers.docs.resize(size + 1);
+            buffers.freqs.resize(size + 1);
+            buffers.docs[0] = size;
+            buffers.freqs[0] = size;
+            for (std::size_t i = 0; i < size; ++i) {
+                buffers.docs[i + 1] = buffers.postings[i] >> 32U;
+                buffers.freqs[i + 1] = static_cast<std::uint32_t>(buffers.postings[i]);
+            }
+            output_docs.write(buffers.docs, (2 + offsets[term]) * sizeof(uint32_t));
+            output_freqs.write(buffers.freqs, offsets[term] * sizeof(uint32_t));
+        }
+        reorder_progress.update(terms.size());
+    });
+}
+
+void reorder_inverted_index(
+    const std::string& input_basename,
+    const std::string& output_basename,
+    const std::vector<uint32_t>& mapping)
+{
+    std::ofstream output_mapping(output_basename + ".mapping");
+    emit(output_mapping, mapping.data(), mapping.size());
+
+    binary_collection input_sizes((input_basename + ".sizes").c_str());
+    auto sizes = *input_sizes.begin();
+
+    auto num_docs = sizes.size();
+    std::vector<uint32_t> new_sizes(num_docs);
+    for (size_t i = 0; i < num_docs; ++i) {
+        new_sizes[mapping[i]] = sizes.begin()[i];
+    }
+
+    std::ofstream output_sizes(output_basename + ".sizes");
+    emit(output_sizes, sizes.size());
+    emit(output_sizes, new_sizes.data(), num_docs);
+
+    reorder_postings(input_basename, output_basename, mapping);
+}
+
+}  // namespace pisa
@@ -0,0 +1,178 @@
+#include "util/numa.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace pisa { namespace numa {
+
+    namespace {
+
+        /// Mode of `mbind` interleaving pages over a set of nodes, from `linux/mempolicy.h`.
+        constexpr int mpol_interleave = 3;
+
+        [[noreturn]] void throw_errno(std::string const& what)
+        {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        /// Parses a CPU list such as `0-3,8-11`.
+        auto parse_cpu_list(std::string const& list) -> std::vector<int>
+        {
+            std::vector<int> cpus;
+            std::istringstream is(list);
+            std::string range;
+            while (std::getline(is, range, ',')) {
+                if (range.empty()) {
+                    continue;
+                }
+                auto dash = range.find('-');
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+    }  // namespace
+
+    auto parse_policy(std::string_view name) -> policy
+    {
+        if (name == "replicate") {
+            return policy::replicate;
+        }
+        if (name == "interleave") {
+            return policy::interleave;
+        }
+        throw std::invalid_argument("Unknown NUMA policy: " + std::string(name));
+    }
+
+    auto node_cpus() -> std::vector<std::vector<int>>
+    {
+        std::vector<std::vector<int>> nodes;
+        for (int node = 0;; ++node) {
+            std::ifstream is("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (not is) {
+                break;
+            }
+            std::string list;
+            std::getline(is, list);
+            nodes.push_back(parse_cpu_list(list));
+        }
+        if (nodes.empty()) {
+            std::vector<int> cpus(std::max(1U, std::thread::hardware_concurrency()));
+            for (std::size_t cpu = 0; cpu < cpus.size(); ++cpu) {
+                cpus[cpu] = static_cast<int>(cpu);
+            }
+            nodes.push_back(std::move(cpus));
+        }
+        return nodes;
+    }
+
+    void pin_thread(std::vector<int> const& cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu: cpus) {
+            CPU_SET(cpu, &set);
+        }
+        if (::sched_setaffinity(0, sizeof(set), &set) != 0) {
+            throw_errno("Cannot pin thread");
+        }
+    }
+
+    replica::replica(std::size_t size) : m_size(size)
+    {
+        if (size == 0) {
+            return;
+        }
+        void* addr =
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw_errno("Cannot allocate NUMA replica");
+        }
+        m_data = static_cast<char*>(addr);
+    }
+
+    replica::replica(replica&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0))
+    {}
+
+    replica& replica::operator=(replica&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    replica::~replica() { release(); }
+
+    void replica::release() noexcept
+    {
+        if (m_data != nullptr) {
+            ::munmap(m_data, m_size);
+            m_data = nullptr;
+        }
+    }
+
+    auto replica::on_node(char const* data, std::size_t size, std::vector<int> const& cpus)
+        -> replica
+    {
+        replica copy(size);
+        std::exception_ptr error;
+        std::thread writer([&]() {
+            try {
+                pin_thread(cpus);
+                std::memcpy(copy.m_data, data, size);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        });
+        writer.join();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return copy;
+    }
+
+    auto replica::interleaved(char const* data, std::size_t size, std::size_t nodes) -> replica
+    {
+        replica copy(size);
+        std::vector<unsigned long> mask(nodes / (8 * sizeof(unsigned long)) + 1);
+        for (std::size_t node = 0; node < nodes; ++node) {
+            mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        }
+#ifdef SYS_mbind
+        auto bound = ::syscall(
+            SYS_mbind, copy.m_data, size, mpol_interleave, mask.data(), nodes + 1, 0);
+#else
+        long bound = -1;
+#endif
+        if (size > 0 && bound != 0) {
+            spdlog::warn("Cannot interleave the index over {} NUMA nodes", nodes);
+        }
+        std::memcpy(copy.m_data, data, size);
+        return copy;
+    }
+
+}}  // namespace pisa::numa
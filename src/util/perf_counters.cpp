@@ -0,0 +1,88 @@
+#include "util/perf_counters.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace pisa {
+
+namespace {
+
+    /// The type and configuration of the `perf_event_attr` of each event.
+    struct event_config {
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+    constexpr auto cache_miss(std::uint64_t cache) -> std::uint64_t
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8U)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16U);
+    }
+
+    constexpr std::array<event_config, perf_event_count> event_configs{{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+
+    [[nodiscard]] auto open_event(event_config config) -> int
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = config.type;
+        attr.config = config.config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // The calling thread, on any CPU.
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+}  // namespace
+
+perf_counters::perf_counters()
+{
+    std::transform(event_configs.begin(), event_configs.end(), m_fds.begin(), open_event);
+}
+
+perf_counters::~perf_counters()
+{
+    for (auto fd: m_fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+auto perf_counters::available() const -> bool
+{
+    return std::any_of(m_fds.begin(), m_fds.end(), [](int fd) { return fd >= 0; });
+}
+
+auto perf_counters::read() const -> perf_sample
+{
+    perf_sample sample;
+    for (std::size_t event = 0; event < perf_event_count; ++event) {
+        // The count, the time the event was enabled, and the time it was counted.
+        std::array<std::uint64_t, 3> values{};
+        if (m_fds[event] < 0
+            || ::read(m_fds[event], values.data(), sizeof(values)) != sizeof(values)) {
+            continue;
+        }
+        auto [count, enabled, running] = values;
+        sample.counts[event] = running > 0 && running < enabled
+            ? static_cast<std::uint64_t>(static_cast<double>(count) * enabled / running)
+            : count;
+    }
+    return sample;
+}
+
+}  // namespace pisa
@@ -0,0 +1,192 @@
+#include "util/synthetic_collection.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include <tbb/parallel_for.h>
+
+#include "util/collection_writer.hpp"
+
+namespace pisa {
+
+namespace {
+
+    /// Derives independent seeds from one, so that every list, range of documents, or query
+    /// has its own generator, whichever thread draws it.
+    [[nodiscard]] auto split_seed(std::uint64_t seed, std::uint64_t stream) -> std::uint64_t
+    {
+        std::uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31U);
+    }
+
+    enum class stream_kind : std::uint64_t { lengths = 1, lists = 2, queries = 3 };
+
+    [[nodiscard]] auto generator(std::uint64_t seed, stream_kind kind, std::uint64_t stream)
+        -> std::mt19937_64
+    {
+        auto kind_seed = split_seed(seed, static_cast<std::uint64_t>(kind));
+        return std::mt19937_64(split_seed(kind_seed, stream));
+    }
+
+    constexpr std::size_t length_chunk = 1U << 16U;
+
+    void validate(synthetic_collection_params const& params)
+    {
+        if (params.documents == 0 || params.terms == 0) {
+            throw std::invalid_argument("A collection needs documents and terms");
+        }
+        if (params.max_df_ratio <= 0.0 || params.max_df_ratio > 1.0) {
+            throw std::invalid_argument("The largest document frequency ratio must be in (0, 1]");
+        }
+        if (params.clustering < 0.0 || params.clustering > 1.0) {
+            throw std::invalid_argument("Clustering must be in [0, 1]");
+        }
+        if (params.mean_freq < 1.0 || params.mean_length < 1.0) {
+            throw std::invalid_argument("Mean frequencies and lengths must be at least 1");
+        }
+    }
+
+    /// Draws the documents of a list of about `df` postings.
+    [[nodiscard]] auto draw_documents(
+        std::mt19937_64& rng, std::uint32_t df, synthetic_collection_params const& params)
+        -> std::vector<std::uint32_t>
+    {
+        std::vector<std::uint32_t> documents;
+        auto num_docs = params.documents;
+        std::uniform_int_distribution<std::uint32_t> any_document(0, num_docs - 1);
+        if (df >= num_docs / 4) {
+            // Dense lists are drawn document by document, skipping geometric gaps, which
+            // leaves nothing to cluster.
+            documents.reserve(df + df / 8);
+            std::geometric_distribution<std::uint32_t> gap(static_cast<double>(df) / num_docs);
+            for (std::uint64_t doc = gap(rng); doc < num_docs; doc += gap(rng) + 1) {
+                documents.push_back(static_cast<std::uint32_t>(doc));
+            }
+            if (documents.empty()) {
+                documents.push_back(any_document(rng));
+            }
+            return documents;
+        }
+        documents.reserve(df);
+        auto width = std::max<std::uint64_t>(
+            1, std::min<std::uint64_t>(num_docs, std::llround(params.cluster_width * df)));
+        std::uniform_int_distribution<std::uint64_t> offset(0, width - 1);
+        std::bernoulli_distribution clustered(params.clustering);
+        std::uint64_t center = any_document(rng);
+        for (std::uint32_t posting = 0; posting < df; ++posting) {
+            if (clustered(rng)) {
+                auto doc = (center + num_docs - width / 2 + offset(rng)) % num_docs;
+                documents.push_back(static_cast<std::uint32_t>(doc));
+            } else {
+                documents.push_back(any_document(rng));
+            }
+        }
+        // Duplicates are dropped, so lists are slightly shorter than `df`, the more so the more
+        // clustered they are.
+        std::sort(documents.begin(), documents.end());
+        documents.erase(std::unique(documents.begin(), documents.end()), documents.end());
+        return documents;
+    }
+
+}  // namespace
+
+auto write_synthetic_collection(std::string const& basename, synthetic_collection_params params)
+    -> std::size_t
+{
+    validate(params);
+    auto num_docs = params.documents;
+
+    std::vector<std::uint32_t> lengths(num_docs);
+    auto chunks = (num_docs + length_chunk - 1) / length_chunk;
+    tbb::parallel_for(std::size_t(0), chunks, [&](std::size_t chunk) {
+        auto rng = generator(params.seed, stream_kind::lengths, chunk);
+        auto sigma = params.length_sigma;
+        std::lognormal_distribution<double> length(
+            std::log(params.mean_length) - sigma * sigma / 2, sigma);
+        auto last = std::min<std::size_t>(num_docs, (chunk + 1) * length_chunk);
+        for (auto doc = chunk * length_chunk; doc < last; ++doc) {
+            lengths[doc] = static_cast<std::uint32_t>(std::max(1.0, std::round(length(rng))));
+        }
+    });
+    auto average_length =
+        std::accumulate(lengths.begin(), lengths.end(), 0.0) / static_cast<double>(num_docs);
+
+    // The postings of each document add up to at most its size.
+    std::vector<std::atomic_uint32_t> term_occurrences(num_docs);
+    auto max_df = std::max(1.0, params.max_df_ratio * num_docs);
+    std::size_t postings = 0;
+    {
+        Freq_Collection_Writer writer(basename, num_docs);
+        tbb::parallel_for(std::uint32_t(0), params.terms, [&](std::uint32_t term) {
+            auto rng = generator(params.seed, stream_kind::lists, term);
+            auto df = static_cast<std::uint32_t>(
+                std::max(1.0, std::round(max_df / std::pow(term + 1.0, params.zipf_exponent))));
+            auto documents = draw_documents(rng, df, params);
+            std::vector<std::uint32_t> frequencies(documents.size());
+            for (std::size_t posting = 0; posting < documents.size(); ++posting) {
+                auto doc = documents[posting];
+                // Longer documents repeat their terms more often.
+                auto extra = (params.mean_freq - 1.0) * lengths[doc] / average_length;
+                std::geometric_distribution<std::uint32_t> freq(1.0 / (1.0 + extra));
+                frequencies[posting] = 1 + freq(rng);
+                term_occurrences[doc].fetch_add(frequencies[posting], std::memory_order_relaxed);
+            }
+            writer.push(term, std::move(documents), std::move(frequencies));
+        });
+        writer.close();
+        postings = writer.postings();
+    }
+
+    for (std::uint32_t doc = 0; doc < num_docs; ++doc) {
+        lengths[doc] = std::max(lengths[doc], term_occurrences[doc].load());
+    }
+    std::ofstream sizes(basename + ".sizes", std::ios::binary);
+    sizes.write(reinterpret_cast<char const*>(&num_docs), sizeof(num_docs));
+    sizes.write(reinterpret_cast<char const*>(lengths.data()), lengths.size() * sizeof(lengths[0]));
+    if (not sizes) {
+        throw std::runtime_error("Unable to write " + basename + ".sizes");
+    }
+    return postings;
+}
+
+auto synthetic_queries(std::uint32_t term_count, synthetic_query_params params)
+    -> std::vector<std::vector<std::uint32_t>>
+{
+    if (term_count == 0 || params.max_terms == 0 || params.mean_terms < 1.0) {
+        throw std::invalid_argument("Queries need terms");
+    }
+    std::vector<double> cumulative(term_count);
+    double total = 0;
+    for (std::uint32_t term = 0; term < term_count; ++term) {
+        total += 1.0 / std::pow(term + 1.0, params.zipf_exponent);
+        cumulative[term] = total;
+    }
+    auto max_terms = std::min<std::size_t>(params.max_terms, term_count);
+    std::vector<std::vector<std::uint32_t>> queries(params.queries);
+    tbb::parallel_for(std::size_t(0), params.queries, [&](std::size_t idx) {
+        auto rng = generator(params.seed, stream_kind::queries, idx);
+        std::geometric_distribution<std::size_t> extra_terms(1.0 / params.mean_terms);
+        std::uniform_real_distribution<double> draw(0.0, total);
+        auto length = std::min(max_terms, 1 + extra_terms(rng));
+        auto& query = queries[idx];
+        while (query.size() < length) {
+            auto term = static_cast<std::uint32_t>(std::distance(
+                cumulative.begin(),
+                std::upper_bound(cumulative.begin(), cumulative.end(), draw(rng))));
+            term = std::min(term, term_count - 1);
+            if (std::find(query.begin(), query.end(), term) == query.end()) {
+                query.push_back(term);
+            }
+        }
+    });
+    return queries;
+}
+
+}  // namespace pisa
@@ -0,0 +1,133 @@
+#include "util/task_graph.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <fmt/format.h>
+
+namespace pisa {
+
+auto task_graph::add(
+    std::string name,
+    std::function<void()> fn,
+    resources needs,
+    std::vector<task_id> const& dependencies,
+    int priority) -> task_id
+{
+    task_id id = m_tasks.size();
+    for (auto dependency: dependencies) {
+        if (dependency >= id) {
+            throw std::invalid_argument(
+                fmt::format("Task {} depends on unknown task {}", name, dependency));
+        }
+    }
+    for (auto dependency: dependencies) {
+        m_tasks[dependency].dependents.push_back(id);
+    }
+    m_tasks.push_back(
+        task{std::move(name), std::move(fn), needs, priority, dependencies.size(), {}});
+    return id;
+}
+
+void task_graph::run(resources budget)
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::size_t> waiting(m_tasks.size());
+    std::vector<task_id> ready;
+    for (task_id id = 0; id < m_tasks.size(); ++id) {
+        waiting[id] = m_tasks[id].dependencies;
+        if (waiting[id] == 0) {
+            ready.push_back(id);
+        }
+    }
+    resources used{0, 0};
+    std::size_t running = 0;
+    std::size_t finished = 0;
+    std::exception_ptr error;
+
+    // Returns the position in `ready` of the task to start next, or its end if none fits.
+    auto next_task = [&] {
+        auto next = ready.end();
+        for (auto it = ready.begin(); it != ready.end(); ++it) {
+            auto const& needs = m_tasks[*it].needs;
+            bool fits = running == 0
+                || (used.threads + needs.threads <= budget.threads
+                    && used.memory + needs.memory <= budget.memory);
+            if (fits
+                && (next == ready.end() || m_tasks[*it].priority > m_tasks[*next].priority
+                    || (m_tasks[*it].priority == m_tasks[*next].priority && *it < *next))) {
+                next = it;
+            }
+        }
+        return next;
+    };
+
+    auto worker = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto next = ready.end();
+            changed.wait(lock, [&] {
+                if (error || finished == m_tasks.size()) {
+                    return true;
+                }
+                next = next_task();
+                return next != ready.end();
+            });
+            if (error || finished == m_tasks.size()) {
+                return;
+            }
+            task_id id = *next;
+            ready.erase(next);
+            auto const& needs = m_tasks[id].needs;
+            used.threads += needs.threads;
+            used.memory += needs.memory;
+            running += 1;
+            lock.unlock();
+
+            std::exception_ptr task_error;
+            try {
+                m_tasks[id].fn();
+            } catch (...) {
+                task_error = std::current_exception();
+            }
+
+            lock.lock();
+            used.threads -= needs.threads;
+            used.memory -= needs.memory;
+            running -= 1;
+            finished += 1;
+            if (task_error) {
+                if (not error) {
+                    error = task_error;
+                }
+            } else {
+                for (auto dependent: m_tasks[id].dependents) {
+                    if (--waiting[dependent] == 0) {
+                        ready.push_back(dependent);
+                    }
+                }
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    auto worker_count = std::max<std::size_t>(1, std::min(budget.threads, m_tasks.size()));
+    for (std::size_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread: workers) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}  // namespace pisa
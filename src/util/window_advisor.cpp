@@ -0,0 +1,62 @@
+#include "util/window_advisor.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace pisa {
+
+Window_Advisor::Window_Advisor(void const* data, std::size_t size, int fd, std::size_t window)
+    : m_data(static_cast<char const*>(data)), m_size(size), m_fd(fd), m_next_window(0)
+{
+    auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    m_window = std::max(page_size, (window + page_size - 1) / page_size * page_size);
+    if (m_data != nullptr && m_size > 0) {
+        ::madvise(const_cast<char*>(m_data), std::min(m_window, m_size), MADV_WILLNEED);
+    }
+    slide(0);
+}
+
+auto Window_Advisor::worth_streaming(std::size_t size) -> bool
+{
+    auto pages = ::sysconf(_SC_PHYS_PAGES);
+    auto page_size = ::sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0) {
+        return false;
+    }
+    return size > static_cast<std::size_t>(pages) * static_cast<std::size_t>(page_size) / 2;
+}
+
+void Window_Advisor::slide(std::size_t offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (offset < m_next_window.load(std::memory_order_relaxed) || m_data == nullptr) {
+        return;
+    }
+    auto window_begin = offset / m_window * m_window;
+    auto ahead_begin = window_begin + m_window;
+    if (ahead_begin < m_size) {
+        // Advice is only a hint, so failures are ignored.
+        ::madvise(
+            const_cast<char*>(m_data + ahead_begin),
+            std::min(m_window, m_size - ahead_begin),
+            MADV_WILLNEED);
+    }
+    if (window_begin >= m_window && window_begin - m_window > m_dropped) {
+        auto drop_end = window_begin - m_window;
+        ::madvise(const_cast<char*>(m_data + m_dropped), drop_end - m_dropped, MADV_DONTNEED);
+        if (m_fd >= 0) {
+            ::posix_fadvise(
+                m_fd,
+                static_cast<off_t>(m_dropped),
+                static_cast<off_t>(drop_end - m_dropped),
+                POSIX_FADV_DONTNEED);
+        }
+        m_dropped = drop_end;
+    }
+    m_next_window.store(ahead_begin, std::memory_order_relaxed);
+}
+
+}  // namespace pisa
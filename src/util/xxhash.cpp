@@ -0,0 +1,99 @@
+#include "util/xxhash.hpp"
+
+#include <cstring>
+
+namespace pisa {
+
+namespace {
+
+    constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+    constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+    auto rotl(std::uint64_t value, int bits) -> std::uint64_t
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    auto read64(unsigned char const* ptr) -> std::uint64_t
+    {
+        std::uint64_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    auto read32(unsigned char const* ptr) -> std::uint64_t
+    {
+        std::uint32_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    auto round(std::uint64_t acc, std::uint64_t input) -> std::uint64_t
+    {
+        acc += input * prime2;
+        return rotl(acc, 31) * prime1;
+    }
+
+    auto merge_round(std::uint64_t acc, std::uint64_t value) -> std::uint64_t
+    {
+        acc ^= round(0, value);
+        return acc * prime1 + prime4;
+    }
+
+}  // namespace
+
+auto xxhash64(void const* data, std::size_t size, std::uint64_t seed) -> std::uint64_t
+{
+    auto const* ptr = static_cast<unsigned char const*>(data);
+    auto const* end = ptr + size;
+    std::uint64_t hash;
+
+    if (size >= 32) {
+        std::uint64_t v1 = seed + prime1 + prime2;
+        std::uint64_t v2 = seed + prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - prime1;
+        auto const* limit = end - 32;
+        do {
+            v1 = round(v1, read64(ptr));
+            v2 = round(v2, read64(ptr + 8));
+            v3 = round(v3, read64(ptr + 16));
+            v4 = round(v4, read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += size;
+
+    for (; ptr + 8 <= end; ptr += 8) {
+        hash ^= round(0, read64(ptr));
+        hash = rotl(hash, 27) * prime1 + prime4;
+    }
+    if (ptr + 4 <= end) {
+        hash ^= read32(ptr) * prime1;
+        hash = rotl(hash, 23) * prime2 + prime3;
+        ptr += 4;
+    }
+    for (; ptr < end; ++ptr) {
+        hash ^= *ptr * prime5;
+        hash = rotl(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+}  // namespace pisa
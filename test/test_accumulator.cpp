@@ -0,0 +1,152 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "accumulator/accumulator_pool.hpp"
+#include "accumulator/compact_accumulator.hpp"
+#include "accumulator/lazy_accumulator.hpp"
+#include "accumulator/simple_accumulator.hpp"
+#include "topk_queue.hpp"
+
+using namespace pisa;
+
+using postings_type = std::vector<std::pair<uint32_t, float>>;
+
+template <typename Accumulator>
+auto aggregate_scores(Accumulator& accumulator, postings_type const& postings)
+    -> std::vector<float>
+{
+    topk_queue topk(10);
+    accumulator.init();
+    for (auto [docid, score]: postings) {
+        accumulator.accumulate(docid, score);
+    }
+    accumulator.aggregate(topk);
+    topk.finalize();
+    std::vector<float> scores;
+    for (auto [score, docid]: topk.topk()) {
+        scores.push_back(score);
+    }
+    return scores;
+}
+
+TEMPLATE_TEST_CASE(
+    "Accumulators aggregate the top-k scores",
+    "[accumulator]",
+    Simple_Accumulator,
+    Lazy_Accumulator<1>,
+    Lazy_Accumulator<3>,
+    Lazy_Accumulator<4>,
+    Lazy_Accumulator<8>,
+    Lazy_Accumulator<16>)
+{
+    std::size_t num_docs = 1003;
+    std::mt19937 gen(1234);
+    TestType accumulator(num_docs);
+    // More queries than the cycle of the smaller counters, so that they wrap around.
+    for (int query = 0; query < 40; ++query) {
+        postings_type postings;
+        std::vector<float> scores(num_docs, 0.0F);
+        auto count = gen() % 300;
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            auto docid = static_cast<uint32_t>(gen() % num_docs);
+            auto score = static_cast<float>(gen() % 1000) / 10.0F;
+            postings.emplace_back(docid, score);
+            scores[docid] += score;
+        }
+        topk_queue expected(10);
+        for (uint64_t docid = 0; docid < num_docs; ++docid) {
+            expected.insert(scores[docid], docid);
+        }
+        expected.finalize();
+        std::vector<float> expected_scores;
+        for (auto [score, docid]: expected.topk()) {
+            expected_scores.push_back(score);
+        }
+        REQUIRE(aggregate_scores(accumulator, postings) == expected_scores);
+    }
+}
+
+TEST_CASE("Quantized accumulators aggregate exact top-k scores", "[accumulator]")
+{
+    std::size_t num_docs = 1003;
+    std::mt19937 gen(1234);
+    Quantized_Accumulator accumulator(num_docs);
+    for (int query = 0; query < 10; ++query) {
+        postings_type postings;
+        std::vector<float> scores(num_docs, 0.0F);
+        auto count = gen() % 300;
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            auto docid = static_cast<uint32_t>(gen() % num_docs);
+            auto score = static_cast<float>(gen() % 256);
+            postings.emplace_back(docid, score);
+            scores[docid] += score;
+        }
+        topk_queue expected(10);
+        for (uint64_t docid = 0; docid < num_docs; ++docid) {
+            expected.insert(scores[docid], docid);
+        }
+        expected.finalize();
+        std::vector<float> expected_scores;
+        for (auto [score, docid]: expected.topk()) {
+            expected_scores.push_back(score);
+        }
+        REQUIRE(aggregate_scores(accumulator, postings) == expected_scores);
+    }
+
+    // sums saturate rather than wrap around
+    accumulator.init();
+    for (int idx = 0; idx < 300; ++idx) {
+        accumulator.accumulate(7, 255.0F);
+    }
+    REQUIRE(accumulator[7] == 0xFFFFU);
+}
+
+TEST_CASE("Bfloat16 accumulators aggregate approximate top-k scores", "[accumulator]")
+{
+    std::size_t num_docs = 1003;
+    std::mt19937 gen(1234);
+    Bfloat16_Accumulator accumulator(num_docs);
+    for (int query = 0; query < 10; ++query) {
+        postings_type postings;
+        std::vector<float> scores(num_docs, 0.0F);
+        auto count = gen() % 300;
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            auto docid = static_cast<uint32_t>(gen() % num_docs);
+            auto score = static_cast<float>(gen() % 1000) / 10.0F;
+            postings.emplace_back(docid, score);
+            scores[docid] += score;
+        }
+        topk_queue expected(10);
+        for (uint64_t docid = 0; docid < num_docs; ++docid) {
+            expected.insert(scores[docid], docid);
+        }
+        expected.finalize();
+        auto actual = aggregate_scores(accumulator, postings);
+        REQUIRE(actual.size() == expected.topk().size());
+        for (std::size_t rank = 0; rank < actual.size(); ++rank) {
+            REQUIRE(actual[rank] == Approx(expected.topk()[rank].first).epsilon(0.01));
+        }
+    }
+}
+
+TEST_CASE("Accumulator pools reuse released accumulators", "[accumulator]")
+{
+    Accumulator_Pool<Lazy_Accumulator<4>> pool(1003);
+    {
+        auto first = pool.acquire();
+        auto second = pool.acquire();
+        REQUIRE(first.get() != second.get());
+        REQUIRE(first->size() == 1003);
+        REQUIRE(pool.allocated() == 2);
+    }
+    for (int query = 0; query < 10; ++query) {
+        auto accumulator = pool.acquire();
+        postings_type postings{{1, 2.0F}, {5, 3.0F}, {1, 4.0F}};
+        REQUIRE(aggregate_scores(*accumulator, postings) == std::vector<float>{6.0F, 3.0F});
+    }
+    REQUIRE(pool.allocated() == 2);
+}
@@ -0,0 +1,67 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <chrono>
+#include <optional>
+#include <thread>
+
+#include "query/admission_control.hpp"
+
+using namespace pisa;
+using decision = admission_controller::decision;
+
+TEST_CASE("Queries are admitted within the memory budget", "[admission_control]")
+{
+    admission_controller controller(100, 0, std::chrono::milliseconds(0));
+    {
+        auto first = controller.admit(60);
+        REQUIRE(first.decision() == decision::admitted);
+        REQUIRE(controller.used() == 60);
+
+        auto second = controller.admit(30);
+        REQUIRE(second.decision() == decision::admitted);
+        REQUIRE(controller.used() == 90);
+
+        // nothing may wait, so a query that does not fit is rejected, unless its fallback fits
+        REQUIRE(controller.admit(20).decision() == decision::rejected);
+        auto downgraded = controller.admit(20, 10);
+        REQUIRE(downgraded.decision() == decision::downgraded);
+        REQUIRE(downgraded.bytes() == 10);
+        REQUIRE(controller.used() == 100);
+    }
+    REQUIRE(controller.used() == 0);
+
+    // a query larger than the budget runs alone
+    auto large = controller.admit(1000);
+    REQUIRE(large.decision() == decision::admitted);
+    REQUIRE(controller.admit(1).decision() == decision::rejected);
+
+    auto stats = controller.stats();
+    REQUIRE(stats.admitted == 3);
+    REQUIRE(stats.downgraded == 1);
+    REQUIRE(stats.rejected == 2);
+}
+
+TEST_CASE("Queries wait for memory to be released", "[admission_control]")
+{
+    admission_controller controller(100, 1, std::chrono::seconds(10));
+    std::optional<admission_controller::ticket> running(controller.admit(80));
+
+    std::optional<decision> waited;
+    std::thread waiter([&] { waited = controller.admit(50).decision(); });
+    while (controller.waiting() == 0) {
+        std::this_thread::yield();
+    }
+    // only one query may wait
+    REQUIRE(controller.admit(50).decision() == decision::rejected);
+    running.reset();
+    waiter.join();
+    REQUIRE(waited == decision::admitted);
+    REQUIRE(controller.stats().waited == 1);
+
+    admission_controller impatient(100, 1, std::chrono::milliseconds(10));
+    auto held = impatient.admit(80);
+    REQUIRE(impatient.admit(50).decision() == decision::rejected);
+    REQUIRE(impatient.waiting() == 0);
+    REQUIRE(impatient.used() == 80);
+}
@@ -0,0 +1,113 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <tbb/blocked_range.h>
+#include <mio/mmap.hpp>
+#include <tbb/parallel_for.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "pisa_config.hpp"
+#include "temporary_directory.hpp"
+#include "util/window_advisor.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Access the lists of a collection with offsets at random")
+{
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "collection").string();
+    for (auto extension: {".docs", ".freqs"}) {
+        boost::filesystem::copy_file(
+            PISA_SOURCE_DIR "/test/test_data/test_collection" + std::string(extension),
+            basename + extension);
+    }
+
+    using list_type = std::pair<std::vector<uint32_t>, std::vector<uint32_t>>;
+    std::vector<list_type> expected;
+    {
+        binary_freq_collection coll(basename.c_str());
+        REQUIRE_FALSE(coll.has_offsets());
+        REQUIRE_THROWS_AS(coll[0], std::logic_error);
+        for (auto const& list: coll) {
+            expected.emplace_back(
+                std::vector<uint32_t>(list.docs.begin(), list.docs.end()),
+                std::vector<uint32_t>(list.freqs.begin(), list.freqs.end()));
+        }
+    }
+
+    binary_freq_collection::write_offsets(basename.c_str());
+    binary_freq_collection coll(basename.c_str());
+    REQUIRE(coll.has_offsets());
+    REQUIRE(coll.size() == expected.size());
+
+    auto values = [](auto const& sequence) {
+        return std::vector<uint32_t>(sequence.begin(), sequence.end());
+    };
+    for (std::size_t term = expected.size(); term > 0; --term) {
+        auto list = coll[term - 1];
+        REQUIRE(values(list.docs) == expected[term - 1].first);
+        REQUIRE(values(list.freqs) == expected[term - 1].second);
+    }
+
+    // Ranges of lists, read by different threads from an iterator to their first list.
+    std::atomic_size_t mismatches{0};
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>(0, coll.size(), 7), [&](auto const& range) {
+            auto it = coll.iterator_at(range.begin());
+            for (auto term = range.begin(); term != range.end(); ++term, ++it) {
+                if (values(it->docs) != expected[term].first
+                    || values(it->freqs) != expected[term].second) {
+                    mismatches += 1;
+                }
+            }
+        });
+    REQUIRE(mismatches == 0);
+    REQUIRE(coll.iterator_at(coll.size()) == coll.end());
+}
+
+TEST_CASE("Ignore offsets that do not match the collection")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "collection.docs").string();
+    boost::filesystem::copy_file(PISA_SOURCE_DIR "/test/test_data/test_collection.docs", filename);
+    binary_collection::write_offsets(filename.c_str());
+    REQUIRE(binary_collection(filename.c_str()).has_offsets());
+
+    std::ofstream(filename, std::ios::app).write("\0\0\0\0", 4);
+    REQUIRE_FALSE(binary_collection(filename.c_str()).has_offsets());
+}
+
+TEST_CASE("Read a mapping advised a window at a time")
+{
+    REQUIRE_FALSE(Window_Advisor::worth_streaming(0));
+    REQUIRE(Window_Advisor::worth_streaming(std::numeric_limits<std::size_t>::max()));
+
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "values").string();
+    std::vector<uint32_t> values(1U << 18U);
+    std::iota(values.begin(), values.end(), 0);
+    std::ofstream(filename, std::ios::binary)
+        .write(reinterpret_cast<char const*>(values.data()), values.size() * sizeof(uint32_t));
+
+    mio::mmap_source m(filename);
+    auto data = reinterpret_cast<uint32_t const*>(m.data());
+    Window_Advisor advisor(m.data(), m.size(), m.file_handle(), 1U << 12U);
+    std::size_t mismatches = 0;
+    for (std::size_t pos = 0; pos < values.size(); ++pos) {
+        advisor.advance(pos * sizeof(uint32_t));
+        mismatches += data[pos] != values[pos] ? 1 : 0;
+    }
+    REQUIRE(mismatches == 0);
+    // Dropped pages are read again.
+    REQUIRE(std::equal(values.begin(), values.end(), data));
+}
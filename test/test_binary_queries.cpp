@@ -0,0 +1,60 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "query/binary_queries.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Write and map binary query files", "[queries]")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "queries.bin").string();
+    std::vector<Query> queries{
+        {std::string("101"), {3, 1, 4}, {}},
+        {std::nullopt, {1, 5}, {0.5, 2.0}},
+        {std::string("a query id of some length"), {}, {}},
+        {std::string(""), {9}, {}}};
+    {
+        std::ofstream os(filename, std::ios::binary);
+        binary_queries::write(os, queries);
+    }
+
+    REQUIRE(binary_queries::is_binary_query_file(filename));
+    binary_queries mapped(filename);
+    REQUIRE(mapped.size() == queries.size());
+    for (std::size_t idx = 0; idx < queries.size(); ++idx) {
+        auto view = mapped[idx];
+        auto const& expected = queries[idx];
+        REQUIRE(view.id().has_value() == expected.id.has_value());
+        if (expected.id) {
+            REQUIRE(*view.id() == *expected.id);
+        }
+        auto terms = view.terms();
+        REQUIRE(std::vector<term_id_type>(terms.begin(), terms.end()) == expected.terms);
+        auto weights = view.term_weights();
+        REQUIRE(std::vector<float>(weights.begin(), weights.end()) == expected.term_weights);
+    }
+    auto loaded = mapped.to_queries();
+    REQUIRE(loaded.size() == queries.size());
+    REQUIRE(loaded[1].terms == queries[1].terms);
+    REQUIRE(loaded[1].term_weights == queries[1].term_weights);
+
+    auto text_filename = (tmpdir.path() / "queries.txt").string();
+    std::ofstream(text_filename) << "101:3 1 4\n";
+    REQUIRE_FALSE(binary_queries::is_binary_query_file(text_filename));
+    REQUIRE_THROWS_AS(binary_queries(text_filename), std::invalid_argument);
+
+    auto truncated_filename = (tmpdir.path() / "truncated.bin").string();
+    {
+        std::ifstream is(filename, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        std::ofstream(truncated_filename, std::ios::binary)
+            << contents.substr(0, contents.size() - 4);
+    }
+    REQUIRE_THROWS_AS(binary_queries(truncated_filename), std::invalid_argument);
+}
@@ -0,0 +1,37 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "query/binary_results.hpp"
+#include "temporary_directory.hpp"
+#include "util/ordered_writer.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Binary results are read back in query order", "[binary_results]")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "results").string();
+    std::vector<std::vector<std::pair<float, uint64_t>>> results{
+        {{3.5, 10}, {2.25, 4}, {1.0, 7}}, {}, {{0.5, 1}}};
+    {
+        std::ofstream os(filename, std::ios::binary);
+        os.write(binary_result::magic.data(), binary_result::magic.size());
+        Ordered_Writer writer(os);
+        for (auto query = results.size(); query > 0; --query) {
+            writer.push(query - 1, binary_result_records(query - 1, results[query - 1]));
+        }
+    }
+    std::vector<binary_result> expected{{0, 10, 3.5}, {0, 4, 2.25}, {0, 7, 1.0}, {2, 1, 0.5}};
+    REQUIRE(read_binary_results(filename) == expected);
+
+    {
+        std::ofstream os(filename, std::ios::binary);
+        os << "qid\tQ0\tdoc\t0\t1.0\tR0\n";
+    }
+    REQUIRE_THROWS_AS(read_binary_results(filename), std::invalid_argument);
+}
@@ -2,6 +2,7 @@
 #include "catch2/catch.hpp"
 
 #include <cstdlib>
+#include <memory>
 
 #include <rapidcheck.h>
 
@@ -211,6 +212,38 @@ TEST_CASE("bit_vector_unary_enumerator")
     }
 }
 
+TEST_CASE("bit_vector_unary_enumerator_long_skips")
+{
+    // skips over many words, up to the last one, in sparse and dense bit vectors
+    for (double density: {0.01, 0.5, 0.99}) {
+        auto v = random_bit_vector(20'000, density);
+        v.back() = true;
+        v[v.size() - 2] = false;
+        pisa::bit_vector bitmap(v);
+        std::vector<size_t> ones;
+        std::vector<size_t> zeros;
+        for (size_t i = 0; i < v.size(); ++i) {
+            (v[i] ? ones : zeros).push_back(i);
+        }
+
+        for (size_t r = 0; r < ones.size(); r += 97) {
+            for (size_t k = r; k < ones.size(); k += 131) {
+                pisa::bit_vector::unary_enumerator e(bitmap, ones[r]);
+                MY_REQUIRE_EQUAL(ones[k], e.skip_no_move(k - r), "r = " << r << " k = " << k);
+                e.skip(k - r);
+                MY_REQUIRE_EQUAL(ones[k], e.next(), "r = " << r << " k = " << k);
+            }
+        }
+        for (size_t r = 0; r < zeros.size(); r += 97) {
+            for (size_t k = r; k < zeros.size(); k += 131) {
+                pisa::bit_vector::unary_enumerator e(bitmap, zeros[r]);
+                e.skip0(k - r);
+                MY_REQUIRE_EQUAL(zeros[k], e.position(), "r = " << r << " k = " << k);
+            }
+        }
+    }
+}
+
 TEST_CASE("bvb_reverse")
 {
     rc::check([](std::vector<bool> v) {
@@ -226,3 +259,87 @@ TEST_CASE("bvb_reverse")
         test_equal_bits(v, bitmap, "In-place reverse");
     });
 }
+
+TEST_CASE("bvb_append")
+{
+    rc::check([](std::vector<bool> lhs, std::vector<bool> rhs) {
+        pisa::bit_vector_builder bvb;
+        for (auto elem: lhs) {
+            bvb.push_back(elem);
+        }
+        pisa::bit_vector_builder other;
+        for (auto elem: rhs) {
+            other.push_back(elem);
+        }
+        bvb.append(other);
+        lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+        bvb.push_back(true);
+        lhs.push_back(true);
+
+        pisa::bit_vector bitmap(&bvb);
+        test_equal_bits(lhs, bitmap, "Append");
+    });
+}
+
+TEST_CASE("bvb_or_bits")
+{
+    rc::check([](std::vector<uint8_t> lengths) {
+        pisa::bit_vector_builder expected;
+        pisa::bit_vector_builder actual;
+        std::vector<std::pair<uint64_t, uint64_t>> fields;
+        for (auto length: lengths) {
+            auto len = length % 65;
+            auto bits = len == 0 ? 0 : uint64_t(-1) >> (64 - len);
+            fields.emplace_back(bits, len);
+            expected.append_bits(bits, len);
+        }
+        actual.zero_extend(expected.size());
+        uint64_t pos = 0;
+        for (auto [bits, len]: fields) {
+            actual.or_bits(pos, bits, len);
+            pos += len;
+        }
+        REQUIRE(actual.move_bits() == expected.move_bits());
+    });
+}
+
+TEST_CASE("bvb_append_all")
+{
+    rc::check([](std::vector<bool> prefix, std::vector<std::vector<bool>> parts) {
+        pisa::bit_vector_builder bvb;
+        for (auto elem: prefix) {
+            bvb.push_back(elem);
+        }
+        std::vector<bool> expected = prefix;
+        std::vector<std::unique_ptr<pisa::bit_vector_builder>> builders;
+        std::vector<pisa::bit_vector_builder const*> ptrs;
+        for (auto const& part: parts) {
+            builders.push_back(std::make_unique<pisa::bit_vector_builder>());
+            for (auto elem: part) {
+                builders.back()->push_back(elem);
+                expected.push_back(elem);
+            }
+            ptrs.push_back(builders.back().get());
+        }
+        bvb.append_all(ptrs);
+        REQUIRE(bvb.size() == expected.size());
+        bvb.push_back(true);
+        expected.push_back(true);
+
+        pisa::bit_vector bitmap(&bvb);
+        test_equal_bits(expected, bitmap, "Parallel append");
+    });
+}
+
+TEST_CASE("select_in_word")
+{
+    rc::check([](uint64_t word) {
+        uint64_t k = 0;
+        for (uint64_t pos = 0; pos < 64; ++pos) {
+            if ((word >> pos) & 1U) {
+                REQUIRE(pisa::broadword::select_in_word(word, k) == pos);
+                k += 1;
+            }
+        }
+    });
+}
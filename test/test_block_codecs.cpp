@@ -4,7 +4,9 @@
 #include <cstdlib>
 #include <vector>
 
+#include "codec/avx512bp.hpp"
 #include "codec/block_codecs.hpp"
+#include "codec/dense_block.hpp"
 #include "codec/maskedvbyte.hpp"
 #include "codec/qmx.hpp"
 #include "codec/simdbp.hpp"
@@ -29,12 +31,14 @@ void test_block_codec()
             if (tcase == 1) {
                 sum_of_values = std::accumulate(values.begin(), values.end(), 0);
             }
-            std::vector<uint8_t> encoded;
+            // blocks are appended to what is already encoded
+            std::vector<uint8_t> encoded{0xAB};
             BlockCodec::encode(values.data(), sum_of_values, values.size(), encoded);
+            REQUIRE(encoded[0] == 0xAB);
 
-            std::vector<uint32_t> decoded(values.size());
-            uint8_t const* out =
-                BlockCodec::decode(encoded.data(), decoded.data(), sum_of_values, values.size());
+            std::vector<uint32_t> decoded(values.size() + pisa::decode_overflow<BlockCodec>::value);
+            uint8_t const* out = BlockCodec::decode(
+                encoded.data() + 1, decoded.data(), sum_of_values, values.size());
 
             REQUIRE(encoded.size() == out - encoded.data());
             REQUIRE(std::equal(values.begin(), values.end(), decoded.begin()));
@@ -47,11 +51,58 @@ TEST_CASE("block_codecs")
     test_block_codec<pisa::optpfor_block>();
     test_block_codec<pisa::varint_G8IU_block>();
     test_block_codec<pisa::streamvbyte_block>();
+    test_block_codec<pisa::streamvbyte_delta_block>();
     test_block_codec<pisa::maskedvbyte_block>();
     test_block_codec<pisa::interpolative_block>();
     test_block_codec<pisa::qmx_block>();
     test_block_codec<pisa::varintgb_block>();
     test_block_codec<pisa::simple8b_block>();
     test_block_codec<pisa::simdbp_block>();
+    test_block_codec<pisa::avx512bp_block>();
+    test_block_codec<pisa::basic_interpolative_block<64>>();
+    test_block_codec<pisa::basic_interpolative_block<256>>();
+    test_block_codec<pisa::basic_varintgb_block<64>>();
+    test_block_codec<pisa::basic_varintgb_block<256>>();
+    test_block_codec<pisa::basic_simdbp_block<256>>();
+    test_block_codec<pisa::dense_block<pisa::varintgb_block>>();
+    test_block_codec<pisa::dense_block<pisa::simdbp_block>>();
     test_block_codec<pisa::simple16_block>();
 }
+
+TEST_CASE("dense_block")
+{
+    using codec_type = pisa::dense_block<pisa::varintgb_block>;
+    for (uint32_t max_gap: {1, 2, 8, 1000}) {
+        std::vector<uint32_t> values(codec_type::block_size);
+        std::generate(values.begin(), values.end(), [&]() { return (uint32_t)rand() % max_gap; });
+        uint32_t sum_of_values = std::accumulate(values.begin(), values.end(), 0);
+        std::vector<uint8_t> encoded;
+        codec_type::encode(values.data(), sum_of_values, values.size(), encoded);
+        std::vector<uint8_t> plain;
+        pisa::varintgb_block::encode(values.data(), sum_of_values, values.size(), plain);
+        REQUIRE(encoded.size() <= plain.size() + 1);
+        REQUIRE((encoded[0] == codec_type::bitmap_block) == (max_gap <= 8));
+
+        std::vector<uint32_t> decoded(values.size());
+        uint8_t const* out =
+            codec_type::decode(encoded.data(), decoded.data(), sum_of_values, values.size());
+        REQUIRE(encoded.size() == out - encoded.data());
+        REQUIRE(values == decoded);
+    }
+}
+
+TEST_CASE("interpolative_block prefix")
+{
+    using codec_type = pisa::interpolative_block;
+    std::vector<uint32_t> values(codec_type::block_size);
+    std::generate(values.begin(), values.end(), []() { return (uint32_t)rand() % (1 << 12); });
+    uint32_t sum_of_values = std::accumulate(values.begin(), values.end(), 0);
+    std::vector<uint8_t> encoded;
+    codec_type::encode(values.data(), sum_of_values, values.size(), encoded);
+
+    for (size_t k: {1, 16, 63, 64, 127, 128}) {
+        std::vector<uint32_t> decoded(values.size());
+        codec_type::decode_prefix(encoded.data(), decoded.data(), sum_of_values, values.size(), k);
+        REQUIRE(std::equal(values.begin(), values.begin() + k, decoded.begin()));
+    }
+}
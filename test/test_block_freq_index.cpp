@@ -3,7 +3,9 @@
 
 #include "test_generic_sequence.hpp"
 
+#include "codec/avx512bp.hpp"
 #include "codec/block_codecs.hpp"
+#include "codec/dense_block.hpp"
 #include "codec/maskedvbyte.hpp"
 #include "codec/qmx.hpp"
 #include "codec/simdbp.hpp"
@@ -72,6 +74,7 @@ TEST_CASE("block_freq_index")
     test_block_freq_index<pisa::optpfor_block>();
     test_block_freq_index<pisa::varint_G8IU_block>();
     test_block_freq_index<pisa::streamvbyte_block>();
+    test_block_freq_index<pisa::streamvbyte_delta_block>();
     test_block_freq_index<pisa::maskedvbyte_block>();
     test_block_freq_index<pisa::varintgb_block>();
     test_block_freq_index<pisa::interpolative_block>();
@@ -79,4 +82,118 @@ TEST_CASE("block_freq_index")
     test_block_freq_index<pisa::simple8b_block>();
     test_block_freq_index<pisa::simple16_block>();
     test_block_freq_index<pisa::simdbp_block>();
+    test_block_freq_index<pisa::avx512bp_block>();
+    test_block_freq_index<pisa::basic_interpolative_block<64>>();
+    test_block_freq_index<pisa::basic_interpolative_block<256>>();
+    test_block_freq_index<pisa::basic_varintgb_block<64>>();
+    test_block_freq_index<pisa::basic_varintgb_block<256>>();
+    test_block_freq_index<pisa::basic_simdbp_block<256>>();
+    test_block_freq_index<pisa::dense_block<pisa::varintgb_block>>();
+    test_block_freq_index<pisa::dense_block<pisa::simdbp_block>>();
+}
+
+TEST_CASE("block_freq_index laid out by term frequency")
+{
+    pisa::global_parameters params;
+    uint64_t universe = 20000;
+    using collection_type = pisa::block_freq_index<pisa::simdbp_block>;
+    collection_type::builder b(universe, params);
+
+    typedef std::vector<uint64_t> vec_type;
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(20);
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+        uint64_t n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(), []() { return (rand() % 256) + 1; });
+        b.add_posting_list(n, plist.first.begin(), plist.second.begin(), 0);
+    }
+    collection_type coll;
+    b.build(coll);
+
+    // Out of range and repeated terms are skipped.
+    std::vector<uint32_t> hot_terms{7, 3, 19, 3, 100, 0};
+    Temporary_Directory tmpdir;
+    auto filename = tmpdir.path().string() + "temp.bin";
+    {
+        collection_type laid_out;
+        coll.lay_out(hot_terms, laid_out);
+        pisa::mapper::freeze(laid_out, filename.c_str());
+    }
+
+    collection_type laid_out;
+    mio::mmap_source m(filename.c_str());
+    pisa::mapper::map(laid_out, m);
+    REQUIRE(laid_out.size() == posting_lists.size());
+    REQUIRE(laid_out.list_range(7).first == 0);
+    REQUIRE(laid_out.list_range(3).first == laid_out.list_range(7).second);
+    REQUIRE(laid_out.list_range(19).first == laid_out.list_range(3).second);
+    REQUIRE(laid_out.list_range(0).first == laid_out.list_range(19).second);
+    REQUIRE(laid_out.list_range(1).first == laid_out.list_range(0).second);
+    REQUIRE(laid_out.list_range(18).second == coll.list_range(19).second);
+
+    for (size_t i = 0; i < posting_lists.size(); ++i) {
+        auto const& plist = posting_lists[i];
+        auto [begin, end] = laid_out.list_range(i);
+        auto [expected_begin, expected_end] = coll.list_range(i);
+        REQUIRE(end - begin == expected_end - expected_begin);
+        auto doc_enum = laid_out[i];
+        REQUIRE(plist.first.size() == doc_enum.size());
+        for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+            MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(), "i = " << i << " p = " << p);
+            MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(), "i = " << i << " p = " << p);
+        }
+        REQUIRE(laid_out.num_docs() == doc_enum.docid());
+    }
+
+    collection_type::builder invalid(universe, params);
+    invalid.add_posting_list(
+        posting_lists[0].first.size(),
+        posting_lists[0].first.begin(),
+        posting_lists[0].second.begin(),
+        0);
+    collection_type invalid_coll;
+    REQUIRE_THROWS_AS(invalid.build(invalid_coll, {1}), std::invalid_argument);
+}
+
+TEST_CASE("block_freq_index resolves the lists of many terms at once")
+{
+    pisa::global_parameters params;
+    uint64_t universe = 20000;
+    using collection_type = pisa::block_freq_index<pisa::simdbp_block>;
+    collection_type::builder b(universe, params);
+
+    std::vector<std::pair<std::vector<uint64_t>, std::vector<uint64_t>>> posting_lists(50);
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 100;
+        uint64_t n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.assign(n, 1);
+        b.add_posting_list(n, plist.first.begin(), plist.second.begin(), 0);
+    }
+    collection_type coll;
+    b.build(coll);
+
+    // Unsorted and repeated terms, as in a batch of queries.
+    std::vector<uint32_t> terms{42, 3, 17, 3, 49, 0, 17, 1, 48};
+    auto check = [&](collection_type const& index) {
+        auto ranges = index.list_ranges(terms);
+        auto lists = index.lists(terms);
+        REQUIRE(ranges.size() == terms.size());
+        REQUIRE(lists.size() == terms.size());
+        for (size_t idx = 0; idx < terms.size(); ++idx) {
+            REQUIRE(ranges[idx] == coll.list_range(terms[idx]));
+            REQUIRE(lists[idx].size() == posting_lists[terms[idx]].first.size());
+            REQUIRE(lists[idx].docid() == posting_lists[terms[idx]].first.front());
+        }
+        for (size_t term = 0; term < index.size(); ++term) {
+            REQUIRE(index[term].docid() == posting_lists[term].first.front());
+        }
+    };
+    check(coll);
+
+    coll.decode_endpoints();
+    check(coll);
+    REQUIRE(coll.list_range(48).second == coll.list_range(49).first);
 }
@@ -0,0 +1,135 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "codec/block_codecs.hpp"
+#include "codec/simdbp.hpp"
+#include "codec/varintgb.hpp"
+#include "temporary_directory.hpp"
+
+#include "block_freq_index.hpp"
+#include "block_index_merge.hpp"
+#include "mappable/mapper.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using posting_lists = std::vector<std::pair<std::vector<uint64_t>, std::vector<uint64_t>>>;
+
+template <typename Index>
+void build_index(Index& index, uint64_t num_docs, posting_lists const& lists)
+{
+    pisa::global_parameters params;
+    typename Index::builder builder(num_docs, params);
+    for (auto const& [docs, freqs]: lists) {
+        builder.add_posting_list(docs.size(), docs.begin(), freqs.begin(), 0);
+    }
+    builder.build(index);
+}
+
+template <typename Index>
+auto frozen(Index& index, std::string const& filename) -> std::vector<char>
+{
+    pisa::mapper::freeze(index, filename.c_str());
+    std::ifstream is(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+/// Returns the lengths of the lists of either index, which include multiples of the block size,
+/// so that both the copying and the re-encoding paths are taken.
+auto list_lengths(uint64_t block_size, uint64_t universe) -> std::vector<uint64_t>
+{
+    std::vector<uint64_t> lengths{
+        1, block_size - 1, block_size, 2 * block_size, 3 * block_size + 7};
+    for (int i = 0; i < 20; ++i) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+        lengths.push_back(uint64_t(universe / avg_gap));
+    }
+    return lengths;
+}
+
+auto random_lists(std::vector<uint64_t> const& lengths, uint64_t universe) -> posting_lists
+{
+    posting_lists lists;
+    for (auto n: lengths) {
+        std::vector<uint64_t> freqs(n);
+        std::generate(freqs.begin(), freqs.end(), []() { return (rand() % 256) + 1; });
+        lists.emplace_back(random_sequence(universe, n, true), std::move(freqs));
+    }
+    return lists;
+}
+
+template <typename BlockCodec>
+void test_block_index_merge()
+{
+    using index_type = pisa::block_freq_index<BlockCodec>;
+    uint64_t block_size = BlockCodec::block_size;
+    uint64_t first_docs = 10000;
+    uint64_t second_docs = 5000;
+
+    auto first_lengths = list_lengths(block_size, first_docs);
+    auto second_lengths = list_lengths(block_size, second_docs);
+    std::reverse(second_lengths.begin(), second_lengths.end());
+    // Terms only in the second index.
+    second_lengths.push_back(block_size + 1);
+    second_lengths.push_back(2 * block_size);
+    auto first_lists = random_lists(first_lengths, first_docs);
+    auto second_lists = random_lists(second_lengths, second_docs);
+
+    auto expected_lists = first_lists;
+    expected_lists.resize(second_lists.size());
+    for (size_t term = 0; term < second_lists.size(); ++term) {
+        auto& [docs, freqs] = expected_lists[term];
+        for (auto doc: second_lists[term].first) {
+            docs.push_back(doc + first_docs);
+        }
+        auto const& second_freqs = second_lists[term].second;
+        freqs.insert(freqs.end(), second_freqs.begin(), second_freqs.end());
+    }
+
+    index_type first;
+    index_type second;
+    index_type expected;
+    build_index(first, first_docs, first_lists);
+    build_index(second, second_docs, second_lists);
+    build_index(expected, first_docs + second_docs, expected_lists);
+
+    pisa::global_parameters params;
+    typename index_type::builder builder(first_docs + second_docs, params);
+    auto stats = pisa::merge_block_indexes(first, second, builder);
+    index_type merged;
+    builder.build(merged);
+
+    REQUIRE(stats.copied_blocks > 0);
+    REQUIRE(stats.encoded_blocks > 0);
+    REQUIRE(merged.size() == expected_lists.size());
+    REQUIRE(merged.num_docs() == first_docs + second_docs);
+    for (size_t term = 0; term < expected_lists.size(); ++term) {
+        auto const& [docs, freqs] = expected_lists[term];
+        auto list = merged[term];
+        REQUIRE(list.size() == docs.size());
+        for (size_t p = 0; p < docs.size(); ++p, list.next()) {
+            MY_REQUIRE_EQUAL(docs[p], list.docid(), "term = " << term << " p = " << p);
+            MY_REQUIRE_EQUAL(freqs[p], list.freq(), "term = " << term << " p = " << p);
+        }
+        REQUIRE(list.docid() == merged.num_docs());
+    }
+
+    // Copied and re-encoded blocks are laid out exactly as in an index built from scratch.
+    Temporary_Directory tmpdir;
+    auto merged_bytes = frozen(merged, (tmpdir.path() / "merged").string());
+    auto expected_bytes = frozen(expected, (tmpdir.path() / "expected").string());
+    REQUIRE(merged_bytes == expected_bytes);
+}
+
+TEST_CASE("Merge block indexes")
+{
+    test_block_index_merge<pisa::interpolative_block>();
+    test_block_index_merge<pisa::optpfor_block>();
+    test_block_index_merge<pisa::varintgb_block>();
+    test_block_index_merge<pisa::simdbp_block>();
+}
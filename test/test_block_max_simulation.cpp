@@ -0,0 +1,63 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "block_max_simulation.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/queries.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Estimate the blocks block-max WAND scores", "[block_max_simulation]")
+{
+    std::string basename(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_freq_collection collection(basename.c_str());
+    std::vector<binary_freq_collection::sequence> lists(collection.begin(), collection.end());
+    binary_collection sizes_collection((basename + ".sizes").c_str());
+    auto sizes = *sizes_collection.begin();
+    std::vector<std::uint32_t> document_sizes(sizes.begin(), sizes.end());
+
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    std::vector<Query> queries;
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    std::size_t blocks = 0;
+    std::size_t postings = 0;
+    for (auto const& query: queries) {
+        for (auto [term, weight]: query_weights(query)) {
+            postings += lists[term].docs.size();
+            blocks += (lists[term].docs.size() + 63) / 64;
+        }
+    }
+
+    Block_Max_Simulation simulation(lists, document_sizes, 10, 64);
+    auto estimate = simulation.estimate(queries);
+    REQUIRE(estimate.queries == queries.size());
+    REQUIRE(estimate.blocks == blocks);
+    REQUIRE(estimate.postings == postings);
+    REQUIRE(estimate.scored_blocks > 0);
+    REQUIRE(estimate.scored_blocks <= estimate.blocks);
+    REQUIRE(estimate.scored_postings <= estimate.postings);
+
+    SECTION("Without a threshold, every block is scored")
+    {
+        Block_Max_Simulation unbounded(lists, document_sizes, collection.num_docs() + 1, 64);
+        auto all = unbounded.estimate(queries);
+        REQUIRE(all.scored_blocks == all.blocks);
+        REQUIRE(all.scored_postings == all.postings);
+    }
+
+    SECTION("A single block per list is always scored")
+    {
+        Block_Max_Simulation single_blocks(lists, document_sizes, 10, collection.num_docs());
+        auto all = single_blocks.estimate(queries);
+        REQUIRE(all.scored_blocks == all.blocks);
+    }
+}
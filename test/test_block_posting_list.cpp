@@ -3,7 +3,9 @@
 
 #include "test_generic_sequence.hpp"
 
+#include "codec/avx512bp.hpp"
 #include "codec/block_codecs.hpp"
+#include "codec/dense_block.hpp"
 #include "codec/maskedvbyte.hpp"
 #include "codec/qmx.hpp"
 #include "codec/simdbp.hpp"
@@ -40,12 +42,73 @@ void test_block_posting_list_ops(
         MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
         MY_REQUIRE_EQUAL(freqs[i], e.freq(), "i = " << i << " size = " << n);
     }
+    // docids alone, and skips reading frequencies only now and then, which decode
+    // partially decodable blocks only as far as needed
+    e.reset();
+    for (size_t i = 0; i < n; ++i, e.next()) {
+        MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
+    }
+    REQUIRE(universe == e.docid());
+    e.reset();
+    for (size_t i = 0; i < n; i += 1 + rand() % 400) {
+        e.next_geq(docs[i]);
+        MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
+        if (rand() % 4 == 0) {
+            MY_REQUIRE_EQUAL(freqs[i], e.freq(), "i = " << i << " size = " << n);
+        }
+        for (size_t steps = rand() % 40; steps > 0 && i + 1 < n; --steps) {
+            e.next();
+            ++i;
+            MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
+        }
+    }
+    e.reset();
+    for (size_t i = 0; i < n; i += 1 + rand() % 40) {
+        e.move(i);
+        MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
+    }
     e.reset();
     e.next_geq(docs.back() + 1);
     REQUIRE(universe == e.docid());
     e.reset();
     e.next_geq(universe);
     REQUIRE(universe == e.docid());
+
+    // batches of docids in and out of the list, dense and sparse
+    for (size_t gap: {1, 3, 50, 1000}) {
+        std::vector<uint64_t> targets;
+        for (uint64_t docid = rand() % gap; docid < universe + 10; docid += 1 + rand() % gap) {
+            targets.push_back(docid);
+        }
+        std::vector<size_t> found;
+        e.reset();
+        e.next_geq_many(targets, [&](size_t i, uint64_t freq) {
+            auto it = std::lower_bound(docs.begin(), docs.end(), targets[i]);
+            REQUIRE(it != docs.end());
+            MY_REQUIRE_EQUAL(*it, targets[i], "i = " << i << " size = " << n);
+            MY_REQUIRE_EQUAL(freqs[it - docs.begin()], freq, "i = " << i << " size = " << n);
+            found.push_back(i);
+        });
+        size_t expected = std::count_if(targets.begin(), targets.end(), [&](auto docid) {
+            return std::binary_search(docs.begin(), docs.end(), docid);
+        });
+        REQUIRE(found.size() == expected);
+        REQUIRE(std::is_sorted(found.begin(), found.end()));
+    }
+
+    e.reset();
+    size_t pos = 0;
+    while (e.docid() < universe) {
+        auto block_docs = e.block_docids();
+        auto block_freqs = e.block_freqs();
+        REQUIRE(block_docs.size() == block_freqs.size());
+        for (size_t i = 0; i < block_docs.size(); ++i, ++pos) {
+            MY_REQUIRE_EQUAL(docs[pos], block_docs[i], "pos = " << pos << " size = " << n);
+            MY_REQUIRE_EQUAL(freqs[pos], block_freqs[i], "pos = " << pos << " size = " << n);
+        }
+        e.next_block();
+    }
+    REQUIRE(pos == n);
 }
 
 void random_posting_data(
@@ -104,11 +167,45 @@ void test_block_posting_list_reordering()
     }
 }
 
+template <typename BlockCodec>
+void test_block_posting_list_max_freqs()
+{
+    using posting_list_type = pisa::block_posting_list<BlockCodec, false, true>;
+    uint64_t block_size = BlockCodec::block_size;
+    uint64_t universe = 20000;
+    for (size_t t = 0; t < 20; ++t) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+        uint64_t n = uint64_t(universe / avg_gap);
+
+        std::vector<uint64_t> docs, freqs;
+        random_posting_data(n, universe, docs, freqs);
+        std::vector<uint8_t> data;
+        posting_list_type::write(data, n, docs.begin(), freqs.begin());
+
+        test_block_posting_list_ops<posting_list_type>(data.data(), n, universe, docs, freqs);
+
+        typename posting_list_type::document_enumerator e(data.data(), universe);
+        typename posting_list_type::block_max_enumerator block_maxes(data.data());
+        REQUIRE(block_maxes.max_freq() == *std::max_element(freqs.begin(), freqs.end()));
+        for (size_t i = 0; i < n; ++i, e.next()) {
+            size_t block_begin = i / block_size * block_size;
+            size_t block_end = std::min(block_begin + block_size, n);
+            auto block_max_freq = *std::max_element(
+                std::next(freqs.begin(), block_begin), std::next(freqs.begin(), block_end));
+            block_maxes.next_geq(docs[i]);
+            MY_REQUIRE_EQUAL(docs[block_end - 1], block_maxes.docid(), "i = " << i);
+            MY_REQUIRE_EQUAL(block_max_freq, block_maxes.score(), "i = " << i);
+            MY_REQUIRE_EQUAL(block_max_freq, e.block_max_freq(), "i = " << i);
+        }
+    }
+}
+
 TEST_CASE("block_posting_list")
 {
     test_block_posting_list<pisa::optpfor_block>();
     test_block_posting_list<pisa::varint_G8IU_block>();
     test_block_posting_list<pisa::streamvbyte_block>();
+    test_block_posting_list<pisa::streamvbyte_delta_block>();
     test_block_posting_list<pisa::maskedvbyte_block>();
     test_block_posting_list<pisa::varintgb_block>();
     test_block_posting_list<pisa::interpolative_block>();
@@ -116,6 +213,20 @@ TEST_CASE("block_posting_list")
     test_block_posting_list<pisa::simple8b_block>();
     test_block_posting_list<pisa::simple16_block>();
     test_block_posting_list<pisa::simdbp_block>();
+    test_block_posting_list<pisa::avx512bp_block>();
+    test_block_posting_list<pisa::basic_interpolative_block<64>>();
+    test_block_posting_list<pisa::basic_interpolative_block<256>>();
+    test_block_posting_list<pisa::basic_varintgb_block<64>>();
+    test_block_posting_list<pisa::basic_varintgb_block<256>>();
+    test_block_posting_list<pisa::basic_simdbp_block<256>>();
+    test_block_posting_list<pisa::dense_block<pisa::varintgb_block>>();
+    test_block_posting_list<pisa::dense_block<pisa::simdbp_block>>();
+}
+TEST_CASE("block_posting_list_max_freqs")
+{
+    test_block_posting_list_max_freqs<pisa::varintgb_block>();
+    test_block_posting_list_max_freqs<pisa::interpolative_block>();
+    test_block_posting_list_max_freqs<pisa::simdbp_block>();
 }
 TEST_CASE("block_posting_list_reordering")
 {
@@ -0,0 +1,78 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "block_posting_list.hpp"
+#include "codec/simdbp.hpp"
+#include "util/block_profiler.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Block profiler sums the block accesses of all threads")
+{
+    using posting_list_type = pisa::block_posting_list<pisa::simdbp_block, true>;
+    uint64_t universe = 100000;
+    std::vector<std::vector<uint8_t>> lists(5);
+    std::vector<uint32_t> list_blocks;
+    for (size_t term = 0; term < lists.size(); ++term) {
+        uint64_t n = 100 + term * 1000;
+        auto docs = random_sequence(universe, n, true);
+        std::vector<uint64_t> freqs(n, 1);
+        posting_list_type::write(lists[term], n, docs.begin(), freqs.begin());
+        list_blocks.push_back(pisa::ceil_div(n, pisa::simdbp_block::block_size));
+    }
+    pisa::block_profiler::init(list_blocks);
+
+    size_t n_threads = 4;
+    std::vector<std::thread> threads;
+    for (size_t tid = 0; tid < n_threads; ++tid) {
+        threads.emplace_back([&, tid]() {
+            // the first list is never opened, and odd threads do not read frequencies
+            for (size_t term = 1; term < lists.size(); ++term) {
+                posting_list_type::document_enumerator e(lists[term].data(), universe, term);
+                for (size_t i = 0; i < e.size(); ++i, e.next()) {
+                    if (tid % 2 == 0) {
+                        e.freq();
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    auto counts = pisa::block_profiler::merged();
+    size_t offset = 2 * list_blocks[0];
+    REQUIRE(std::all_of(counts.begin(), counts.begin() + offset, [](auto c) { return c == 0; }));
+    for (size_t term = 1; term < lists.size(); ++term) {
+        for (size_t block = 0; block < list_blocks[term]; ++block) {
+            REQUIRE(counts[offset + 2 * block] == n_threads);
+            REQUIRE(counts[offset + 2 * block + 1] == n_threads / 2);
+        }
+        offset += 2 * list_blocks[term];
+    }
+    REQUIRE(offset == counts.size());
+
+    std::ostringstream os;
+    pisa::block_profiler::dump(os);
+    std::istringstream is(os.str());
+    std::string line;
+    uint32_t term = 1;
+    while (std::getline(is, line)) {
+        REQUIRE(line.substr(0, line.find('\t')) == std::to_string(term++));
+    }
+    REQUIRE(term == lists.size());
+
+    pisa::block_profiler::init(list_blocks);
+    auto cleared = pisa::block_profiler::merged();
+    REQUIRE(std::all_of(cleared.begin(), cleared.end(), [](auto c) { return c == 0; }));
+    REQUIRE_THROWS_AS(
+        posting_list_type::document_enumerator(lists[1].data(), universe, lists.size()),
+        std::out_of_range);
+}
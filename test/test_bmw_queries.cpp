@@ -7,9 +7,11 @@
 
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "pisa_config.hpp"
 #include "query/algorithm.hpp"
+#include "query/conjunctive_rewrite.hpp"
 #include "wand_data.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
@@ -136,3 +138,186 @@ TEST_CASE("block_max_wand", "[bmw][query][ranked][integration]", )
         }
     }
 }
+
+TEST_CASE("block_max_wand with block maxima in the list headers", "[bmw][query][ranked][integration]")
+{
+    // The frequencies serve as quantized scores, so that the maximum frequencies stored in the
+    // lists are their block-max scores.
+    using Index = block_freq_index<pisa::interpolative_block, false, true>;
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", dropped_term_ids);
+    Index index;
+    global_parameters params;
+    Index::builder builder(data->collection.num_docs(), params);
+    for (auto const& plist: data->collection) {
+        builder.add_posting_list(plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), 0);
+    }
+    builder.build(index);
+
+    auto const& block_max = block_max_data(index, data->wdata);
+    REQUIRE(&block_max == &index);
+    topk_queue topk_1(10);
+    block_max_wand_query block_max_wand_q(topk_1);
+    topk_queue topk_2(10);
+    ranked_or_query ranked_or_q(topk_2);
+    auto scorer = scorer::from_name("quantized", data->wdata);
+    for (auto const& q: data->queries) {
+        block_max_wand_q(
+            make_block_max_scored_cursors(index, block_max, *scorer, q), index.num_docs());
+        ranked_or_q(make_scored_cursors(index, *scorer, q), index.num_docs());
+        topk_1.finalize();
+        topk_2.finalize();
+        REQUIRE(topk_1.topk().size() == topk_2.topk().size());
+        for (size_t i = 0; i < topk_1.topk().size(); ++i) {
+            REQUIRE(topk_1.topk()[i].first == topk_2.topk()[i].first);
+        }
+        topk_1.clear();
+        topk_2.clear();
+    }
+}
+
+TEST_CASE("block_max_wand with prefetching and arena cursors", "[bmw][query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", dropped_term_ids);
+    block_simdbp_index index;
+    global_parameters params;
+    block_simdbp_index::builder builder(data->collection.num_docs(), params);
+    for (auto const& plist: data->collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+    static_assert(has_prefetch_v<block_simdbp_index::document_enumerator>);
+
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    topk_queue topk_1(10);
+    block_max_wand_query block_max_wand_q(topk_1);
+    topk_queue topk_2(10);
+    block_max_wand_query prefetching_q(topk_2, {}, 4);
+    for (auto const& q: data->queries) {
+        block_max_wand_q(
+            make_block_max_scored_cursors(index, data->wdata, *scorer, q), index.num_docs());
+        query_arena::scope arena_scope(query_arena::local());
+        prefetching_q(
+            make_block_max_scored_cursors(index, data->wdata, *scorer, q, query_arena::local()),
+            index.num_docs());
+        topk_1.finalize();
+        topk_2.finalize();
+        REQUIRE(topk_1.topk() == topk_2.topk());
+        topk_1.clear();
+        topk_2.clear();
+    }
+}
+
+TEST_CASE("Block-max algorithms with integer scores", "[bmw][query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("quantized", dropped_term_ids);
+    auto scorer = scorer::from_name("quantized", data->wdata);
+    auto num_docs = data->index.num_docs();
+    auto require_same_results = [](auto const& expected, auto const& actual) {
+        REQUIRE(expected.size() == actual.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE(static_cast<float>(actual[i].first) == expected[i].first);
+        }
+    };
+    for (auto const& q: data->queries) {
+        topk_queue expected(10);
+        ranked_or_query ranked_or_q(expected);
+        ranked_or_q(make_scored_cursors(data->index, *scorer, q), num_docs);
+        expected.finalize();
+        {
+            basic_topk_queue<uint32_t> topk(10);
+            basic_block_max_wand_query<uint32_t> block_max_wand_q(topk);
+            block_max_wand_q(
+                make_block_max_scored_cursors<uint32_t>(data->index, data->wdata, *scorer, q),
+                num_docs);
+            topk.finalize();
+            require_same_results(expected.topk(), topk.topk());
+        }
+        {
+            basic_topk_queue<uint32_t> topk(10);
+            basic_block_max_maxscore_query<uint32_t> block_max_maxscore_q(topk);
+            block_max_maxscore_q(
+                make_block_max_scored_cursors<uint32_t>(data->index, data->wdata, *scorer, q),
+                num_docs);
+            topk.finalize();
+            require_same_results(expected.topk(), topk.topk());
+        }
+    }
+}
+
+TEST_CASE("Block-max cursors add quantized impacts", "[bmw][query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("quantized", dropped_term_ids);
+    quantized<WandTypePlain> scorer(data->wdata);
+    auto erased_scorer = scorer::from_name("quantized", data->wdata);
+    auto num_docs = data->index.num_docs();
+    static_assert(std::is_same_v<
+                  score_term_scorer_type_t<quantized<WandTypePlain>, uint32_t>,
+                  integer_weighted_term_scorer<uint32_t>>);
+    static_assert(std::is_same_v<
+                  score_term_scorer_type_t<quantized<WandTypePlain>, float>,
+                  weighted_term_scorer_type_t<quantized<WandTypePlain>>>);
+    for (auto const& q: data->queries) {
+        basic_topk_queue<uint32_t> expected(10);
+        basic_block_max_wand_query<uint32_t> expected_q(expected);
+        expected_q(
+            make_block_max_scored_cursors<uint32_t>(data->index, data->wdata, *erased_scorer, q),
+            num_docs);
+        expected.finalize();
+
+        basic_topk_queue<uint32_t> topk(10);
+        basic_block_max_wand_query<uint32_t> block_max_wand_q(topk);
+        auto cursors = make_block_max_scored_cursors<uint32_t>(data->index, data->wdata, scorer, q);
+        for (auto& cursor: cursors) {
+            auto freq = cursor.docs_enum.freq();
+            REQUIRE(cursor.scorer(cursor.docs_enum.docid(), freq) == cursor.q_weight * freq);
+        }
+        block_max_wand_q(std::move(cursors), num_docs);
+        topk.finalize();
+        REQUIRE(topk.topk() == expected.topk());
+    }
+}
+
+TEST_CASE("Conjunctive subqueries seed block_max_wand", "[bmw][query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    auto num_docs = data->index.num_docs();
+    conjunctive_rewriter rewriter;
+    std::size_t seeded_queries = 0;
+    for (auto const& q: data->queries) {
+        auto subqueries = rewriter.rewrite(data->index, data->wdata, q, 10);
+        REQUIRE(subqueries.size() <= 2);
+        for (auto const& subquery: subqueries) {
+            REQUIRE(subquery.terms.size() >= 2);
+            REQUIRE(subquery.terms.size() < query_weights(q).size());
+        }
+        auto threshold =
+            conjunctive_threshold(data->index, data->wdata, *scorer, subqueries, 10);
+
+        topk_queue expected(10);
+        block_max_wand_query expected_q(expected);
+        expected_q(make_block_max_scored_cursors(data->index, data->wdata, *scorer, q), num_docs);
+        expected.finalize();
+        REQUIRE(threshold <= expected.score_at_rank(10));
+
+        topk_queue topk(10);
+        topk.set_threshold(threshold);
+        block_max_wand_query block_max_wand_q(topk);
+        block_max_wand_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q), num_docs);
+        topk.finalize();
+        REQUIRE(topk.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < topk.topk().size(); ++i) {
+            REQUIRE(topk.topk()[i].first == Approx(expected.topk()[i].first).epsilon(0.01));
+        }
+        seeded_queries += threshold > 0 ? 1 : 0;
+    }
+    REQUIRE(seeded_queries > 0);
+}
@@ -0,0 +1,124 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "codec/block_codecs.hpp"
+#include "temporary_directory.hpp"
+
+#include "block_freq_index.hpp"
+#include "buffered_index.hpp"
+#include "mappable/mapper.hpp"
+#include "mio/mmap.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+TEST_CASE("Buffered index reads the lists of a block index")
+{
+    using collection_type = pisa::block_freq_index<pisa::optpfor_block>;
+    pisa::global_parameters params;
+    uint64_t universe = 20000;
+    collection_type::builder b(universe, params);
+
+    std::vector<std::pair<std::vector<uint64_t>, std::vector<uint64_t>>> posting_lists(30);
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+        uint64_t n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(
+            plist.second.begin(), plist.second.end(), []() { return (rand() % 256) + 1; });
+        b.add_posting_list(n, plist.first.begin(), plist.second.begin(), 0);
+    }
+
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "temp.bin").string();
+    {
+        collection_type coll;
+        b.build(coll);
+        pisa::mapper::freeze(coll, filename.c_str());
+    }
+
+    collection_type coll;
+    mio::mmap_source m(filename.c_str());
+    pisa::mapper::map(coll, m);
+    // Small enough to evict lists between queries.
+    pisa::posting_buffer_pool pool(filename, 4096);
+    pisa::buffered_index<collection_type> index(coll, m.data(), pool);
+
+    std::vector<pisa::term_id_type> terms{3, 17, 3, 29, 0};
+    auto lists = index.fetch(terms);
+    REQUIRE(pool.stats().misses == 4);
+    for (auto term: terms) {
+        auto const& plist = posting_lists[term];
+        auto doc_enum = lists[term];
+        REQUIRE(plist.first.size() == doc_enum.size());
+        for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+            MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(), "term = " << term << " p = " << p);
+            MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(), "term = " << term << " p = " << p);
+        }
+        REQUIRE(coll.num_docs() == doc_enum.docid());
+    }
+    REQUIRE_THROWS_AS(lists[1], std::out_of_range);
+
+    SECTION("Cached lists are not read again")
+    {
+        pisa::posting_buffer_pool large_pool(filename, uint64_t(1) << 30U);
+        pisa::buffered_index<collection_type> cached_index(coll, m.data(), large_pool);
+        auto first = cached_index.fetch(std::vector<pisa::term_id_type>{3, 17});
+        auto second = cached_index.fetch(std::vector<pisa::term_id_type>{17, 3, 5});
+        REQUIRE(large_pool.stats().misses == 3);
+        REQUIRE(large_pool.stats().hits == 2);
+        REQUIRE(second[3].docid() == coll[3].docid());
+    }
+
+    SECTION("Evicted lists stay valid while in use")
+    {
+        auto other = index.fetch(std::vector<pisa::term_id_type>{5, 6, 7, 8, 9});
+        REQUIRE(pool.stats().misses == 9);
+        auto doc_enum = lists[29];
+        doc_enum.move(posting_lists[29].first.size() - 1);
+        REQUIRE(doc_enum.docid() == posting_lists[29].first.back());
+    }
+}
+
+TEST_CASE("Buffer pool evicts the least used ranges first")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "data.bin").string();
+    {
+        std::ofstream os(filename);
+        for (int byte = 0; byte < 300; ++byte) {
+            os.put(static_cast<char>(byte));
+        }
+    }
+    using range = pisa::posting_buffer_pool::byte_range;
+    auto frame_size = 10 + pisa::posting_buffer_pool::frame_padding;
+    pisa::posting_buffer_pool pool(filename, 3 * frame_size, 1);
+
+    REQUIRE((*pool.fetch({range{0, 10}})[0])[5] == 5);
+    REQUIRE((*pool.fetch({range{0, 10}})[0])[5] == 5);
+    auto frames = pool.fetch({range{10, 10}, range{20, 10}, range{30, 10}});
+    REQUIRE((*frames[2])[0] == 30);
+    REQUIRE(pool.stats().evictions == 1);
+    REQUIRE(pool.cached_bytes() == 3 * frame_size);
+
+    // The first range was used twice, so the second one was evicted instead.
+    auto again = pool.fetch({range{0, 10}, range{10, 10}});
+    auto stats = pool.stats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 5);
+    REQUIRE(stats.bytes_read == 50);
+    REQUIRE(stats.hit_rate() == Approx(2.0 / 7.0));
+
+    SECTION("Ranges larger than a shard are not cached")
+    {
+        auto large = pool.fetch({range{100, 200}});
+        REQUIRE((*large[0])[99] == 199);
+        REQUIRE(pool.cached_bytes() == 3 * frame_size);
+        REQUIRE(pool.fetch({range{100, 200}})[0] != large[0]);
+    }
+}
@@ -0,0 +1,74 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <numeric>
+#include <vector>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "query/candidate_features.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Candidate features match the postings", "[candidate_features][query][integration]")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+
+    global_parameters params;
+    block_simdbp_index index;
+    block_simdbp_index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    topk_queue topk(100);
+    wand_query wand_q(topk);
+    for (auto const& query: queries) {
+        topk.clear();
+        wand_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        topk.finalize();
+        auto features = extract_candidate_features(index, wdata, scorer, query, topk.topk());
+        auto term_freqs = query_freqs(query.terms);
+        REQUIRE(features.size() == topk.topk().size());
+        for (std::size_t rank = 0; rank < features.size(); ++rank) {
+            auto const& candidate = features[rank];
+            REQUIRE(candidate.docid == topk.topk()[rank].second);
+            REQUIRE(candidate.score == topk.topk()[rank].first);
+            REQUIRE(candidate.doc_length == wdata.doc_len(candidate.docid));
+            REQUIRE(candidate.freqs.size() == term_freqs.size());
+            for (std::size_t term_idx = 0; term_idx < term_freqs.size(); ++term_idx) {
+                auto list = index[term_freqs[term_idx].first];
+                list.next_geq(candidate.docid);
+                uint32_t freq = list.docid() == candidate.docid ? list.freq() : 0;
+                REQUIRE(candidate.freqs[term_idx] == freq);
+            }
+            auto sum = std::accumulate(
+                candidate.term_scores.begin(), candidate.term_scores.end(), 0.0F);
+            REQUIRE(sum == Approx(candidate.score).epsilon(0.001));
+        }
+    }
+}
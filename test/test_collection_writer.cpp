@@ -0,0 +1,68 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "binary_freq_collection.hpp"
+#include "pisa_config.hpp"
+#include "temporary_directory.hpp"
+#include "util/collection_writer.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Write a collection from lists produced in parallel")
+{
+    tbb::task_scheduler_init init(4);
+    binary_freq_collection input(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    std::vector<std::pair<std::vector<std::uint32_t>, std::vector<std::uint32_t>>> lists;
+    for (auto const& seq: input) {
+        lists.emplace_back(
+            std::vector<std::uint32_t>(seq.docs.begin(), seq.docs.end()),
+            std::vector<std::uint32_t>(seq.freqs.begin(), seq.freqs.end()));
+    }
+
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "collection").string();
+    // A buffer of a single page, so that most lists span several buffers.
+    auto buffer_size = GENERATE(std::size_t(1), Freq_Collection_Writer::default_buffer_size);
+    std::size_t postings = 0;
+    {
+        Freq_Collection_Writer writer(basename, input.num_docs(), buffer_size, 16);
+        tbb::parallel_for(std::size_t(0), lists.size(), [&](std::size_t term) {
+            writer.push(term, lists[term].first, lists[term].second);
+        });
+        writer.close();
+        postings = writer.postings();
+    }
+
+    binary_freq_collection output(basename.c_str());
+    REQUIRE(output.num_docs() == input.num_docs());
+    REQUIRE(output.has_offsets());
+    REQUIRE(output.size() == lists.size());
+    REQUIRE(std::vector<std::uint32_t>(output[3].docs.begin(), output[3].docs.end())
+            == lists[3].first);
+    std::size_t term = 0;
+    std::size_t expected_postings = 0;
+    for (auto const& seq: output) {
+        REQUIRE(term < lists.size());
+        REQUIRE(std::vector<std::uint32_t>(seq.docs.begin(), seq.docs.end()) == lists[term].first);
+        REQUIRE(
+            std::vector<std::uint32_t>(seq.freqs.begin(), seq.freqs.end()) == lists[term].second);
+        expected_postings += lists[term].first.size();
+        term += 1;
+    }
+    REQUIRE(term == lists.size());
+    REQUIRE(postings == expected_postings);
+}
+
+TEST_CASE("Fail to write a collection to a missing directory")
+{
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "missing" / "collection").string();
+    REQUIRE_THROWS_AS(Freq_Collection_Writer(basename, 10), std::system_error);
+}
@@ -4,6 +4,7 @@
 #include "test_generic_sequence.hpp"
 
 #include "codec/compact_elias_fano.hpp"
+#include <algorithm>
 #include <cstdlib>
 #include <vector>
 
@@ -82,3 +83,42 @@ TEST_CASE_METHOD(sequence_initialization, "compact_elias_fano_weakly_monotone")
     std::vector<uint64_t> seq = random_sequence(universe, n, false);
     test_sequence(pisa::compact_elias_fano(), params, universe, seq);
 }
+
+TEST_CASE_METHOD(sequence_initialization, "compact_elias_fano_intersect")
+{
+    // values of the sequence and others, from dense runs to long jumps
+    std::vector<uint32_t> values;
+    for (size_t i = 0; i < n; i += (i % 1000 < 100) ? 1 : 97) {
+        values.push_back(seq[i]);
+        values.push_back(seq[i] + 1);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    pisa::compact_elias_fano::enumerator expected(bv, 0, universe, seq.size(), params);
+    expected.move(0);
+    std::vector<std::pair<size_t, uint64_t>> expected_found;
+    for (size_t i = 0; i < values.size(); ++i) {
+        auto [position, value] = expected.next_geq(values[i]);
+        if (value == values[i]) {
+            expected_found.emplace_back(i, position);
+        }
+    }
+
+    pisa::compact_elias_fano::enumerator r(bv, 0, universe, seq.size(), params);
+    r.move(0);
+    std::vector<std::pair<size_t, uint64_t>> found;
+    r.intersect(values.data(), values.size(), [&](size_t i, uint64_t position) {
+        found.emplace_back(i, position);
+    });
+    REQUIRE(found == expected_found);
+    REQUIRE(r.value() == expected.value());
+    if (r.position() < r.size()) {
+        REQUIRE(r.next() == expected.next());
+    }
+
+    // values beyond the universe leave the enumerator at the end
+    std::vector<uint32_t> beyond{static_cast<uint32_t>(universe)};
+    r.intersect(beyond.data(), beyond.size(), [](size_t, uint64_t) { FAIL(); });
+    REQUIRE(r.position() == r.size());
+}
@@ -0,0 +1,112 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "codec/block_codecs.hpp"
+#include "codec/simdbp.hpp"
+#include "codec/streamvbyte.hpp"
+
+#include "block_posting_list.hpp"
+#include "decoded_block_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+
+using pisa::decoded_block_cache;
+
+TEST_CASE("Admit blocks within the capacity", "[decoded_block_cache]")
+{
+    auto bytes = decoded_block_cache::block_bytes(128);
+    // term 4 repeated, term 5 without blocks, term 2 only partly
+    decoded_block_cache cache({4, 1, 4, 5, 2, 3}, {3, 2, 3, 0, 10, 1}, 128, 8 * bytes + 1);
+    REQUIRE(cache.admitted_blocks() == 8);
+    REQUIRE(cache.slots(4).blocks == 3);
+    REQUIRE(cache.slots(1).blocks == 2);
+    REQUIRE(cache.slots(2).blocks == 3);
+    REQUIRE(cache.slots(5).slots == nullptr);
+    REQUIRE(cache.slots(3).slots == nullptr);
+    REQUIRE(cache.slots(1000).blocks == 0);
+    REQUIRE(cache.cached_blocks() == 0);
+
+    auto slots = cache.slots(1);
+    REQUIRE(decoded_block_cache::find(slots, 1) == nullptr);
+    std::vector<std::uint32_t> docs{1, 5, 9};
+    std::vector<std::uint32_t> freqs{2, 1, 7};
+    auto const* cached = decoded_block_cache::insert(slots, 1, docs, freqs);
+    REQUIRE(decoded_block_cache::find(slots, 1) == cached);
+    REQUIRE(std::vector<std::uint32_t>(cached, cached + 7)
+            == std::vector<std::uint32_t>{3, 1, 5, 9, 2, 1, 7});
+    // the first block inserted stays
+    std::vector<std::uint32_t> other{0, 0, 0};
+    REQUIRE(decoded_block_cache::insert(slots, 1, other, other) == cached);
+    REQUIRE(decoded_block_cache::find(cache.slots(4), 1) == nullptr);
+    REQUIRE(cache.cached_blocks() == 1);
+}
+
+template <typename BlockCodec>
+void test_cached_list()
+{
+    using posting_list_type = pisa::block_posting_list<BlockCodec>;
+    uint64_t universe = 20000;
+    uint64_t n = 5000;
+    auto docs = random_sequence(universe, n, true);
+    std::vector<uint64_t> freqs(n);
+    std::generate(freqs.begin(), freqs.end(), []() { return (rand() % 256) + 1; });
+    std::vector<uint8_t> data;
+    posting_list_type::write(data, n, docs.begin(), freqs.begin());
+
+    auto blocks = pisa::ceil_div(n, BlockCodec::block_size);
+    // the last blocks of the list are not cached
+    decoded_block_cache cache(
+        {0}, {static_cast<uint32_t>(blocks)}, BlockCodec::block_size,
+        (blocks - 3) * decoded_block_cache::block_bytes(BlockCodec::block_size));
+    REQUIRE(cache.slots(0).blocks == blocks - 3);
+
+    using enumerator_type = typename posting_list_type::document_enumerator;
+    auto check = [&](size_t step) {
+        enumerator_type e(data.data(), universe, 0, cache.slots(0));
+        for (size_t i = 0; i < n; i += step) {
+            e.next_geq(docs[i]);
+            MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " step = " << step);
+            if (i % 3 == 0) {
+                MY_REQUIRE_EQUAL(freqs[i], e.freq(), "i = " << i << " step = " << step);
+            }
+        }
+        e.next_geq(universe);
+        REQUIRE(e.docid() == universe);
+    };
+    // skipping blocks leaves them out of the cache, then reading all blocks fills it
+    check(1000);
+    REQUIRE(cache.cached_blocks() < cache.admitted_blocks());
+    check(1);
+    REQUIRE(cache.cached_blocks() == cache.admitted_blocks());
+    check(1);
+    check(7);
+
+    // threads racing to cache the same blocks
+    decoded_block_cache shared(
+        {0}, {static_cast<uint32_t>(blocks)}, BlockCodec::block_size, 1U << 20U);
+    std::atomic<size_t> mismatches{0};
+    tbb::parallel_for(0, 8, [&](int) {
+        enumerator_type e(data.data(), universe, 0, shared.slots(0));
+        for (size_t i = 0; i < n; ++i, e.next()) {
+            if (e.docid() != docs[i] || e.freq() != freqs[i]) {
+                ++mismatches;
+            }
+        }
+    });
+    REQUIRE(mismatches == 0);
+    REQUIRE(shared.cached_blocks() == blocks);
+}
+
+TEST_CASE("Read blocks from the decoded block cache", "[decoded_block_cache]")
+{
+    test_cached_list<pisa::optpfor_block>();
+    test_cached_list<pisa::streamvbyte_block>();
+    test_cached_list<pisa::simdbp_block>();
+}
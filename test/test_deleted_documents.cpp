@@ -0,0 +1,261 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "deleted_documents.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "temporary_directory.hpp"
+#include "topk_queue.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+/// Deletes a contiguous range, which makes whole blocks deleted, and scattered documents.
+auto deleted_ids(uint64_t num_docs) -> std::vector<uint64_t>
+{
+    std::vector<uint64_t> docs(num_docs / 10);
+    std::iota(docs.begin(), docs.end(), 0);
+    for (uint64_t docid = docs.size(); docid < num_docs; docid += 3) {
+        docs.push_back(docid);
+    }
+    return docs;
+}
+
+struct DeletionData {
+    DeletionData()
+        : collection(PISA_SOURCE_DIR "/test/test_data/test_collection"),
+          document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes"),
+          wdata(
+              document_sizes.begin()->begin(),
+              collection.num_docs(),
+              collection,
+              "bm25",
+              BlockSize(FixedBlock(5)),
+              false,
+              {}),
+          deleted(collection.num_docs(), deleted_ids(collection.num_docs()))
+    {
+        single_index::builder builder(collection.num_docs(), params);
+        for (auto const& plist: collection) {
+            uint64_t freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+        }
+        builder.build(index);
+
+        std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+        io::for_each_line(
+            qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+        blocks.emplace(index, wdata, deleted);
+    }
+
+    global_parameters params;
+    binary_freq_collection collection;
+    binary_collection document_sizes;
+    single_index index;
+    std::vector<Query> queries;
+    wand_data<wand_data_raw> wdata;
+    deleted_documents deleted;
+    std::optional<deleted_blocks> blocks;
+};
+
+/// Returns the top 10 results of exhaustive evaluation, after removing `deleted`.
+template <typename Scorer>
+auto expected_results(
+    DeletionData const& data,
+    Scorer const& scorer,
+    Query const& query,
+    deleted_documents const& deleted) -> std::vector<std::pair<float, uint64_t>>
+{
+    topk_queue topk(data.index.num_docs());
+    ranked_or_query ranked_or_q(topk);
+    ranked_or_q(make_scored_cursors(data.index, scorer, query), data.index.num_docs());
+    topk.finalize();
+    std::vector<std::pair<float, uint64_t>> results;
+    for (auto const& entry: topk.topk()) {
+        if (not deleted.is_deleted(entry.second) and results.size() < 10) {
+            results.push_back(entry);
+        }
+    }
+    return results;
+}
+
+void check_results(
+    topk_queue& topk,
+    std::vector<std::pair<float, uint64_t>> const& expected,
+    deleted_documents const& deleted)
+{
+    topk.finalize();
+    REQUIRE(topk.topk().size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        REQUIRE(topk.topk()[i].first == Approx(expected[i].first));
+        REQUIRE_FALSE(deleted.is_deleted(topk.topk()[i].second));
+    }
+}
+
+TEST_CASE("Deleted documents", "[deleted][unit]")
+{
+    std::vector<uint64_t> docs{1, 5, 5, 9};
+    deleted_documents deleted(10, docs);
+    REQUIRE(deleted.num_docs() == 10);
+    REQUIRE(deleted.count() == 3);
+    for (uint64_t docid = 0; docid < 10; ++docid) {
+        REQUIRE(deleted.is_deleted(docid) == (docid == 1 or docid == 5 or docid == 9));
+    }
+    REQUIRE_THROWS_AS(deleted_documents(10, std::vector<uint64_t>{10}), std::out_of_range);
+
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "deleted").string();
+    mapper::freeze(deleted, filename.c_str());
+    deleted_documents mapped;
+    mio::mmap_source m(filename.c_str());
+    mapper::map(mapped, m);
+    REQUIRE(mapped.count() == 3);
+    REQUIRE(mapped.is_deleted(5));
+    REQUIRE_FALSE(mapped.is_deleted(6));
+
+    topk_queue topk(2, &mapped);
+    REQUIRE_FALSE(topk.insert(10.0, 5));
+    REQUIRE(topk.insert(1.0, 6));
+    REQUIRE(topk.insert(2.0, 7));
+    topk.finalize();
+    REQUIRE(topk.topk() == std::vector<std::pair<float, uint64_t>>{{2.0, 7}, {1.0, 6}});
+    REQUIRE(topk.excludes(5));
+    REQUIRE_FALSE(topk.excludes(6));
+
+    auto filter = deleted_documents::keeping(10, docs);
+    REQUIRE(filter.num_docs() == 10);
+    REQUIRE(filter.count() == 7);
+    for (uint64_t docid = 0; docid < 10; ++docid) {
+        REQUIRE(filter.is_deleted(docid) != (docid == 1 or docid == 5 or docid == 9));
+    }
+    REQUIRE_THROWS_AS(
+        deleted_documents::keeping(10, std::vector<uint64_t>{10}), std::out_of_range);
+}
+
+TEST_CASE("Query algorithms skip deleted documents", "[deleted][query][integration]")
+{
+    DeletionData data;
+    auto num_docs = data.index.num_docs();
+    REQUIRE(data.blocks->size() == data.index.size());
+    deleted_block_max_data<wand_data<wand_data_raw>> block_max(data.wdata, *data.blocks);
+    uint64_t deleted_block_count = 0;
+    for (uint64_t term = 0; term < data.blocks->size(); ++term) {
+        deleted_block_count += data.blocks->block_ends(term).size();
+    }
+    REQUIRE(deleted_block_count > 0);
+
+    scorer::with_scorer("bm25", data.wdata, [&](auto const& scorer) {
+        for (auto const& query: data.queries) {
+            auto expected = expected_results(data, scorer, query, data.deleted);
+            {
+                topk_queue topk(10, &data.deleted);
+                ranked_or_query ranked_or_q(topk);
+                ranked_or_q(make_scored_cursors(data.index, scorer, query), num_docs);
+                check_results(topk, expected, data.deleted);
+            }
+            {
+                topk_queue topk(10, &data.deleted);
+                wand_query wand_q(topk);
+                wand_q(make_max_scored_cursors(data.index, data.wdata, scorer, query), num_docs);
+                check_results(topk, expected, data.deleted);
+            }
+            {
+                topk_queue topk(10, &data.deleted);
+                maxscore_query maxscore_q(topk);
+                maxscore_q(
+                    make_max_scored_cursors(data.index, data.wdata, scorer, query), num_docs);
+                check_results(topk, expected, data.deleted);
+            }
+            {
+                topk_queue topk(10, &data.deleted);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                Simple_Accumulator accumulator(num_docs);
+                ranked_or_taat_q(
+                    make_scored_cursors(data.index, scorer, query), num_docs, accumulator);
+                check_results(topk, expected, data.deleted);
+            }
+            for (bool skip_blocks: {false, true}) {
+                topk_queue topk(10, &data.deleted);
+                block_max_wand_query block_max_wand_q(topk);
+                if (skip_blocks) {
+                    block_max_wand_q(
+                        make_block_max_scored_cursors(data.index, block_max, scorer, query),
+                        num_docs);
+                } else {
+                    block_max_wand_q(
+                        make_block_max_scored_cursors(data.index, data.wdata, scorer, query),
+                        num_docs);
+                }
+                check_results(topk, expected, data.deleted);
+            }
+            {
+                topk_queue topk(10, &data.deleted);
+                block_max_maxscore_query block_max_maxscore_q(topk);
+                block_max_maxscore_q(
+                    make_block_max_scored_cursors(data.index, block_max, scorer, query),
+                    num_docs);
+                check_results(topk, expected, data.deleted);
+            }
+        }
+    });
+}
+
+TEST_CASE("Query algorithms restricted to a filter", "[deleted][query][integration]")
+{
+    DeletionData data;
+    auto num_docs = data.index.num_docs();
+    // a dense range, whose blocks are kept, and scattered documents, whose blocks are mostly not
+    std::vector<uint64_t> kept;
+    for (uint64_t docid = 0; docid < num_docs; ++docid) {
+        if ((docid >= num_docs / 2 and docid < num_docs / 2 + num_docs / 10) or docid % 50 == 0) {
+            kept.push_back(docid);
+        }
+    }
+    auto filter = deleted_documents::keeping(num_docs, kept);
+    deleted_blocks blocks(data.index, data.wdata, filter);
+    deleted_block_max_data<wand_data<wand_data_raw>> block_max(data.wdata, blocks);
+
+    scorer::with_scorer("bm25", data.wdata, [&](auto const& scorer) {
+        for (auto const& query: data.queries) {
+            auto expected = expected_results(data, scorer, query, filter);
+            {
+                topk_queue topk(10, &filter);
+                maxscore_query maxscore_q(topk);
+                maxscore_q(
+                    make_max_scored_cursors(data.index, data.wdata, scorer, query), num_docs);
+                check_results(topk, expected, filter);
+            }
+            {
+                topk_queue topk(10, &filter);
+                block_max_wand_query block_max_wand_q(topk);
+                block_max_wand_q(
+                    make_block_max_scored_cursors(data.index, block_max, scorer, query),
+                    num_docs);
+                check_results(topk, expected, filter);
+            }
+            {
+                topk_queue topk(10, &filter);
+                block_max_maxscore_query block_max_maxscore_q(topk);
+                block_max_maxscore_q(
+                    make_block_max_scored_cursors(data.index, block_max, scorer, query),
+                    num_docs);
+                check_results(topk, expected, filter);
+            }
+        }
+    });
+}
@@ -0,0 +1,196 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "block_freq_index.hpp"
+#include "codec/block_codecs.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "delta_index.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using index_type = block_freq_index<interpolative_block>;
+using wand_type = wand_data<wand_data_raw>;
+
+struct DeltaIndexData {
+    static constexpr uint64_t new_terms = 5;
+
+    DeltaIndexData()
+        : collection(PISA_SOURCE_DIR "/test/test_data/test_collection"),
+          document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes"),
+          wdata(
+              document_sizes.begin()->begin(),
+              collection.num_docs(),
+              collection,
+              "bm25",
+              BlockSize(FixedBlock(5)),
+              false,
+              {}),
+          delta(collection.num_docs())
+    {
+        global_parameters params;
+        index_type::builder builder(collection.num_docs(), params);
+        for (auto const& plist: collection) {
+            uint64_t occurrences = std::accumulate(plist.freqs.begin(), plist.freqs.end(), 0);
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), occurrences);
+        }
+        builder.build(index);
+
+        for (auto const& plist: collection) {
+            docs.emplace_back(plist.docs.begin(), plist.docs.end());
+            freqs.emplace_back(plist.freqs.begin(), plist.freqs.end());
+        }
+        docs.resize(collection.size() + new_terms);
+        freqs.resize(collection.size() + new_terms);
+
+        std::mt19937 gen(1902);
+        std::uniform_int_distribution<uint32_t> term_dist(0, collection.size() + new_terms - 1);
+        std::uniform_int_distribution<int> length_dist(1, 30);
+        for (int doc = 0; doc < 100; ++doc) {
+            std::vector<uint32_t> terms(length_dist(gen));
+            std::generate(terms.begin(), terms.end(), [&] { return term_dist(gen); });
+            if (doc == 0) {
+                for (uint32_t term = collection.size(); term < docs.size(); ++term) {
+                    terms.push_back(term);
+                }
+            }
+            auto docid = delta.add_document(terms);
+            std::sort(terms.begin(), terms.end());
+            for (auto first = terms.begin(); first != terms.end();) {
+                auto last = std::upper_bound(first, terms.end(), *first);
+                docs[*first].push_back(docid);
+                freqs[*first].push_back(std::distance(first, last));
+                first = last;
+            }
+        }
+    }
+
+    binary_freq_collection collection;
+    binary_collection document_sizes;
+    wand_type wdata;
+    index_type index;
+    delta_index delta;
+    std::vector<std::vector<uint32_t>> docs;
+    std::vector<std::vector<uint32_t>> freqs;
+};
+
+template <typename Index>
+void check_lists(Index const& index, DeltaIndexData const& data)
+{
+    REQUIRE(index.size() == data.docs.size());
+    REQUIRE(index.num_docs() == data.collection.num_docs() + 100);
+    for (uint64_t term = 0; term < index.size(); ++term) {
+        auto list = index[term];
+        REQUIRE(list.size() == data.docs[term].size());
+        for (size_t pos = 0; pos < data.docs[term].size(); ++pos, list.next()) {
+            REQUIRE(list.docid() == data.docs[term][pos]);
+            REQUIRE(list.freq() == data.freqs[term][pos]);
+        }
+        REQUIRE(list.docid() == index.num_docs());
+    }
+}
+
+TEST_CASE("Segmented index yields base postings followed by delta postings")
+{
+    DeltaIndexData data;
+    segmented_index<index_type> index(data.index, data.delta);
+    check_lists(index, data);
+
+    std::mt19937 gen(1902);
+    std::uniform_int_distribution<uint64_t> dist(0, index.num_docs());
+    for (uint64_t term = 0; term < index.size(); ++term) {
+        auto const& docs = data.docs[term];
+        auto list = index[term];
+        for (int i = 0; i < 10; ++i) {
+            auto lower_bound = std::max(dist(gen), list.docid());
+            list.next_geq(lower_bound);
+            auto expected = std::lower_bound(docs.begin(), docs.end(), lower_bound);
+            if (expected == docs.end()) {
+                REQUIRE(list.docid() == index.num_docs());
+                break;
+            }
+            REQUIRE(list.docid() == *expected);
+            REQUIRE(list.freq() == data.freqs[term][expected - docs.begin()]);
+            REQUIRE(list.position() == static_cast<uint64_t>(expected - docs.begin()));
+        }
+        list.reset();
+        REQUIRE(list.docid() == docs.front());
+    }
+
+    REQUIRE_THROWS_AS(
+        segmented_index<index_type>(data.index, delta_index(0)), std::invalid_argument);
+}
+
+TEST_CASE("Compact a delta segment into a new block index")
+{
+    DeltaIndexData data;
+    segmented_index<index_type> index(data.index, data.delta);
+    global_parameters params;
+    index_type::builder builder(index.num_docs(), params);
+    compact(index, builder);
+    index_type compacted;
+    builder.build(compacted);
+    check_lists(compacted, data);
+
+    SECTION("New documents can extend a segmented index")
+    {
+        delta_index newer(index.num_docs());
+        newer.add_document(std::vector<uint32_t>{0, 0, 1});
+        segmented_index<segmented_index<index_type>> extended(index, newer);
+        REQUIRE(extended.num_docs() == index.num_docs() + 1);
+        auto list = extended[0];
+        list.next_geq(index.num_docs());
+        REQUIRE(list.docid() == index.num_docs());
+        REQUIRE(list.freq() == 2);
+    }
+}
+
+TEST_CASE("Score a segmented index with ranked OR")
+{
+    DeltaIndexData data;
+    segmented_index<index_type> index(data.index, data.delta);
+    segmented_wand_data<wand_type> wdata(data.wdata, index);
+    REQUIRE(wdata.num_docs() == index.num_docs());
+    REQUIRE(wdata.collection_len() == data.wdata.collection_len() + data.delta.collection_len());
+    for (uint64_t term = 0; term < index.size(); ++term) {
+        REQUIRE(wdata.term_posting_count(term) == data.docs[term].size());
+        uint64_t occurrences =
+            std::accumulate(data.freqs[term].begin(), data.freqs[term].end(), uint64_t(0));
+        REQUIRE(wdata.term_occurrence_count(term) == occurrences);
+    }
+
+    std::vector<uint32_t> terms{0, 1, static_cast<uint32_t>(data.collection.size())};
+    Query query{std::nullopt, terms, {}};
+    scorer::with_scorer("bm25", wdata, [&](auto const& scorer) {
+        topk_queue topk(10);
+        ranked_or_query ranked_or_q(topk);
+        ranked_or_q(make_scored_cursors(index, scorer, query), index.num_docs());
+        topk.finalize();
+
+        std::vector<float> expected(index.num_docs(), 0.0);
+        for (auto term: terms) {
+            auto term_scorer = make_term_scorer(scorer, term);
+            for (size_t pos = 0; pos < data.docs[term].size(); ++pos) {
+                auto doc = data.docs[term][pos];
+                expected[doc] += term_scorer(doc, data.freqs[term][pos]);
+            }
+        }
+        std::sort(expected.begin(), expected.end(), std::greater<>());
+        REQUIRE(topk.topk().size() == 10);
+        for (size_t i = 0; i < topk.topk().size(); ++i) {
+            REQUIRE(topk.topk()[i].first == Approx(expected[i]));
+        }
+    });
+}
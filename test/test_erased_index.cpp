@@ -0,0 +1,117 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include "test_common.hpp"
+#include "temporary_directory.hpp"
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "erased_index.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+template <typename Index>
+void build_index(binary_freq_collection const& collection, Index& index)
+{
+    global_parameters params;
+    typename Index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        builder.add_posting_list(plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), 0);
+    }
+    builder.build(index);
+}
+
+template <typename Index>
+void test_erased_index(std::string const& encoding)
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+    auto scorer = scorer::from_name("bm25", wdata);
+
+    Index index;
+    build_index(collection, index);
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / encoding).string();
+    mapper::freeze(
+        index, filename.c_str(), mapper::file_description{encoding, collection.num_docs()});
+
+    auto erased = Erased_Index::open(filename);
+    REQUIRE(erased.encoding() == encoding);
+    REQUIRE(erased.size() == index.size());
+    REQUIRE(erased.num_docs() == index.num_docs());
+
+    for (std::size_t term = 0; term < index.size(); ++term) {
+        auto expected = index[term];
+        auto actual = erased[term];
+        REQUIRE(actual.size() == expected.size());
+        for (; expected.docid() < index.num_docs(); expected.next(), actual.next()) {
+            REQUIRE(actual.docid() == expected.docid());
+            REQUIRE(actual.freq() == expected.freq());
+        }
+        REQUIRE(actual.docid() == index.num_docs());
+
+        expected = index[term];
+        actual = erased[term];
+        for (uint64_t lower_bound = 0; lower_bound <= index.num_docs(); lower_bound += 37) {
+            expected.next_geq(lower_bound);
+            actual.next_geq(lower_bound);
+            REQUIRE(actual.docid() == expected.docid());
+        }
+    }
+
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    std::vector<Query> queries;
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    for (auto const& query: queries) {
+        topk_queue expected(10);
+        ranked_or_query expected_query(expected);
+        expected_query(make_scored_cursors(index, *scorer, query), index.num_docs());
+        expected.finalize();
+
+        topk_queue actual(10);
+        ranked_or_query actual_query(actual);
+        actual_query(make_scored_cursors(erased, *scorer, query), erased.num_docs());
+        actual.finalize();
+
+        REQUIRE(actual.topk() == expected.topk());
+    }
+}
+
+TEST_CASE("Erased indexes traverse and query like their typed index")
+{
+    test_erased_index<single_index>("single");
+    test_erased_index<block_simdbp_index>("block_simdbp");
+    test_erased_index<block_varintg8iu_index>("block_varintg8iu");
+}
+
+TEST_CASE("Erased indexes require an encoding header")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    block_simdbp_index index;
+    build_index(collection, index);
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "index").string();
+    mapper::freeze(index, filename.c_str());
+    REQUIRE_THROWS_AS(Erased_Index::open(filename), std::invalid_argument);
+}
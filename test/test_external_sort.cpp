@@ -0,0 +1,64 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "temporary_directory.hpp"
+#include "util/external_sort.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Sort records within a memory budget")
+{
+    Temporary_Directory tmpdir;
+    auto output = (tmpdir.path() / "sorted").string();
+    std::mt19937 gen(1902);
+    std::uniform_int_distribution<uint32_t> dist(0, 1000);
+
+    for (std::size_t budget_records: {3, 7, 100, 10000}) {
+        std::vector<uint32_t> records(1000);
+        std::generate(records.begin(), records.end(), [&] { return dist(gen); });
+
+        external_sorter<uint32_t> sorter(output, budget_records * sizeof(uint32_t));
+        for (auto record: records) {
+            sorter.push(record);
+        }
+        REQUIRE(sorter.size() == records.size());
+        REQUIRE(sorter.runs() == (budget_records < records.size() ? 1000 / budget_records : 0));
+        sorter.merge();
+
+        std::vector<uint32_t> sorted;
+        for_each_record<uint32_t>(output, 16, [&](uint32_t record) { sorted.push_back(record); });
+        std::sort(records.begin(), records.end());
+        REQUIRE(sorted == records);
+        REQUIRE(std::distance(
+                    boost::filesystem::directory_iterator(tmpdir.path()),
+                    boost::filesystem::directory_iterator())
+                == 1);
+    }
+}
+
+TEST_CASE("Stream merged records to a callback")
+{
+    Temporary_Directory tmpdir;
+    auto output = (tmpdir.path() / "sorted").string();
+    std::mt19937 gen(1902);
+    std::uniform_int_distribution<uint32_t> dist(0, 1000);
+
+    for (std::size_t budget_records: {3, 100, 10000}) {
+        std::vector<uint32_t> records(1000);
+        std::generate(records.begin(), records.end(), [&] { return dist(gen); });
+
+        external_sorter<uint32_t> sorter(output, budget_records * sizeof(uint32_t));
+        for (auto record: records) {
+            sorter.push(record);
+        }
+        std::vector<uint32_t> sorted;
+        sorter.merge([&](uint32_t record) { sorted.push_back(record); });
+        std::sort(records.begin(), records.end());
+        REQUIRE(sorted == records);
+        REQUIRE(boost::filesystem::is_empty(tmpdir.path()));
+    }
+}
@@ -0,0 +1,164 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "test_common.hpp"
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "fat_block_index.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using index_type = fat_block_index<interpolative_block>;
+using wand_type = wand_data<wand_data_raw>;
+
+struct FatBlockIndexData {
+    FatBlockIndexData()
+        : collection(PISA_SOURCE_DIR "/test/test_data/test_collection"),
+          document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes"),
+          wdata(
+              document_sizes.begin()->begin(),
+              collection.num_docs(),
+              collection,
+              "bm25",
+              BlockSize(FixedBlock(5)),
+              false,
+              {}),
+          scorer(scorer::from_name("bm25", wdata))
+    {
+        global_parameters params;
+        index_type::builder builder(collection.num_docs(), params);
+        size_t term_id = 0;
+        for (auto const& plist: collection) {
+            builder.add_posting_list(
+                plist.docs.size(),
+                plist.docs.begin(),
+                plist.freqs.begin(),
+                scorer->term_scorer(term_id++));
+        }
+        builder.build(index);
+
+        std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+        io::for_each_line(
+            qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    }
+
+    binary_freq_collection collection;
+    binary_collection document_sizes;
+    wand_type wdata;
+    std::unique_ptr<index_scorer<wand_type>> scorer;
+    index_type index;
+    std::vector<Query> queries;
+};
+
+TEST_CASE("Fat block posting lists")
+{
+    FatBlockIndexData data;
+    REQUIRE(data.index.size() == data.collection.size());
+    std::mt19937 gen(1902);
+
+    size_t term_id = 0;
+    for (auto const& plist: data.collection) {
+        std::vector<uint32_t> docs(plist.docs.begin(), plist.docs.end());
+        std::vector<uint32_t> freqs(plist.freqs.begin(), plist.freqs.end());
+        auto term_scorer = data.scorer->term_scorer(term_id);
+        auto list = data.index[term_id];
+        auto block_maxes = data.index.getenum(term_id);
+        REQUIRE(list.size() == docs.size());
+
+        float max_score = 0;
+        float block_max = 0;
+        size_t block_end = 0;
+        for (size_t pos = 0; pos < docs.size(); ++pos, list.next()) {
+            REQUIRE(list.docid() == docs[pos]);
+            REQUIRE(list.freq() == freqs[pos]);
+            if (pos == block_end) {
+                block_max = 0;
+                block_end = std::min(pos + interpolative_block::block_size, docs.size());
+                for (size_t other = pos; other < block_end; ++other) {
+                    block_max = std::max(block_max, term_scorer(docs[other], freqs[other]));
+                }
+            }
+            block_maxes.next_geq(docs[pos]);
+            REQUIRE(block_maxes.docid() == docs[block_end - 1]);
+            REQUIRE(block_maxes.score() == block_max);
+            REQUIRE(list.block_max_score() == block_max);
+            max_score = std::max(max_score, block_max);
+        }
+        REQUIRE(list.docid() == data.index.num_docs());
+        REQUIRE(data.index.max_term_weight(term_id) == max_score);
+
+        std::uniform_int_distribution<uint32_t> dist(0, data.index.num_docs());
+        list.reset();
+        for (int i = 0; i < 10; ++i) {
+            uint32_t lower_bound = std::max<uint32_t>(dist(gen), list.docid());
+            list.next_geq(lower_bound);
+            auto expected = std::lower_bound(docs.begin(), docs.end(), lower_bound);
+            if (expected == docs.end()) {
+                REQUIRE(list.docid() == data.index.num_docs());
+                break;
+            }
+            REQUIRE(list.docid() == *expected);
+            REQUIRE(list.freq() == freqs[expected - docs.begin()]);
+        }
+        term_id += 1;
+    }
+}
+
+TEST_CASE("Block-max queries on fat blocks match exhaustive ranked OR")
+{
+    FatBlockIndexData data;
+    auto const& scorer = *data.scorer;
+    topk_queue expected(10);
+    topk_queue actual(10);
+    ranked_or_query ranked_or_q(expected);
+
+    auto check = [&](auto&& run) {
+        for (auto const& query: data.queries) {
+            expected.clear();
+            actual.clear();
+            ranked_or_q(make_scored_cursors(data.index, scorer, query), data.index.num_docs());
+            expected.finalize();
+            run(query);
+            actual.finalize();
+            REQUIRE(actual.topk().size() == expected.topk().size());
+            for (size_t i = 0; i < expected.topk().size(); ++i) {
+                REQUIRE(actual.topk()[i].first == Approx(expected.topk()[i].first).epsilon(0.01));
+            }
+        }
+    };
+
+    SECTION("block_max_wand")
+    {
+        block_max_wand_query query_alg(actual);
+        check([&](Query const& query) {
+            query_alg(
+                make_block_max_scored_cursors(
+                    data.index, block_max_data(data.index, data.wdata), scorer, query),
+                data.index.num_docs());
+        });
+    }
+    SECTION("block_max_maxscore")
+    {
+        block_max_maxscore_query query_alg(actual);
+        check([&](Query const& query) {
+            query_alg(
+                make_block_max_scored_cursors(
+                    data.index, block_max_data(data.index, data.wdata), scorer, query),
+                data.index.num_docs());
+        });
+    }
+}
@@ -3,6 +3,7 @@
 
 #include "test_generic_sequence.hpp"
 
+#include "binary_collection.hpp"
 #include "forward_index.hpp"
 
 #include <vector>
@@ -22,8 +23,36 @@ TEST_CASE("write_and_read")
     // then
     REQUIRE(fwd.size() == fwd_read.size());
     REQUIRE(fwd.term_count() == fwd_read.term_count());
+    REQUIRE(fwd_read.compressed());
     for (uint32_t doc = 0; doc < fwd.size(); ++doc) {
         REQUIRE(fwd.term_count(doc) == fwd_read.term_count(doc));
-        REQUIRE(std::equal(fwd[doc].begin(), fwd[doc].end(), fwd_read[doc].begin()));
+        REQUIRE(fwd.terms(doc) == fwd_read.terms(doc));
+    }
+}
+
+TEST_CASE("Forward index holds the terms of each document", "[forward_index]")
+{
+    using namespace pisa;
+    std::string invind_input("test_data/test_collection");
+    binary_collection coll((invind_input + ".docs").c_str());
+    auto num_docs = *(*coll.begin()).begin();
+    std::vector<std::vector<uint32_t>> expected(num_docs);
+    uint32_t tid = 0;
+    for (auto it = ++coll.begin(); it != coll.end(); ++it, ++tid) {
+        if (it->size() >= 10) {
+            for (auto doc: *it) {
+                expected[doc].push_back(tid);
+            }
+        }
+    }
+
+    auto compressed = GENERATE(true, false);
+    CAPTURE(compressed);
+    auto fwd = forward_index::from_inverted_index(invind_input, 10, compressed);
+    REQUIRE(fwd.size() == num_docs);
+    REQUIRE(fwd.term_count() == tid);
+    for (uint32_t doc = 0; doc < num_docs; ++doc) {
+        REQUIRE(fwd.term_count(doc) == expected[doc].size());
+        REQUIRE(fwd.terms(doc) == expected[doc]);
     }
 }
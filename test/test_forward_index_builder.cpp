@@ -390,3 +390,52 @@ TEST_CASE("Build forward index", "[parsing][forward_index][integration]")
         }
     }
 }
+
+TEST_CASE("Build inverted index", "[parsing][forward_index][integration]")
+{
+    tbb::task_scheduler_init init;
+    auto next_record = [](std::istream& in) -> std::optional<Document_Record> {
+        Plaintext_Record record;
+        if (in >> record) {
+            return Document_Record(record.trecid(), record.content(), record.url());
+        }
+        return std::nullopt;
+    };
+    auto identity = [](std::string&& term) -> std::string { return std::move(term); };
+    auto read_file = [](std::string const& filename) {
+        std::ifstream is(filename);
+        return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    };
+
+    std::string input(PISA_SOURCE_DIR "/test/test_data/clueweb1k.plaintext");
+    int batch_size = GENERATE(123, 1000);
+    Temporary_Directory tmpdir;
+    auto dir = tmpdir.path();
+    std::string fwd = (dir / "fwd").string();
+    std::string expected = (dir / "expected").string();
+    std::string output = (dir / "inv").string();
+    Forward_Index_Builder builder;
+    {
+        std::ifstream is(input);
+        builder.build(is, fwd, next_record, identity, parse_plaintext_content, batch_size, 2);
+        auto term_count = load_lines(fwd + ".terms").size();
+        invert::invert_forward_index(fwd, expected, term_count, batch_size, 2);
+    }
+    {
+        std::ifstream is(input);
+        builder.build_inverted(
+            is, output, next_record, identity, parse_plaintext_content, batch_size, 2);
+    }
+
+    for (auto suffix: {".docs", ".freqs", ".sizes"}) {
+        REQUIRE(read_file(output + suffix) == read_file(expected + suffix));
+    }
+    for (auto suffix: {".terms", ".termlex", ".documents", ".doclex", ".urls"}) {
+        REQUIRE(read_file(output + suffix) == read_file(fwd + suffix));
+    }
+    REQUIRE(not boost::filesystem::exists(output));
+    auto batch_files = ls(dir, [](auto const& filename) {
+        return filename.find("batch") != std::string::npos;
+    });
+    REQUIRE(batch_files.empty());
+}
@@ -60,6 +60,13 @@ void test_freq_index()
                 MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(), "i = " << i << " p = " << p);
             }
             REQUIRE(coll.num_docs() == doc_enum.docid());
+
+            doc_enum.reset();
+            std::vector<uint64_t> freqs(std::min<size_t>(plist.second.size(), 64));
+            doc_enum.move(plist.second.size() - freqs.size());
+            doc_enum.freqs(freqs);
+            REQUIRE(std::equal(freqs.begin(), freqs.end(), plist.second.end() - freqs.size()));
+            REQUIRE(doc_enum.position() == plist.second.size() - freqs.size());
         }
     }
 }
@@ -75,6 +82,9 @@ TEST_CASE("freq_index")
     test_freq_index<indexed_sequence, positive_sequence<>>();
 
     test_freq_index<partitioned_sequence<>, positive_sequence<partitioned_sequence<strict_sequence>>>();
+    test_freq_index<
+        partitioned_sequence<indexed_sequence, true>,
+        positive_sequence<partitioned_sequence<strict_sequence>>>();
     test_freq_index<
         uniform_partitioned_sequence<>,
         positive_sequence<uniform_partitioned_sequence<strict_sequence>>>();
@@ -0,0 +1,106 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gsl/span>
+
+#include "document_lexicon.hpp"
+#include "front_coded_vector.hpp"
+#include "payload_vector.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto random_terms(std::size_t count, std::mt19937& gen) -> std::vector<std::string>
+{
+    std::uniform_int_distribution<std::size_t> length(0, 12);
+    std::uniform_int_distribution<int> letter('a', 'd');
+    std::vector<std::string> terms;
+    while (terms.size() < count) {
+        std::string term(length(gen), 'a');
+        std::generate(term.begin(), term.end(), [&] { return static_cast<char>(letter(gen)); });
+        terms.push_back(std::move(term));
+    }
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    return terms;
+}
+
+}  // namespace
+
+TEST_CASE("Front-coded vector", "[front_coded_vector][unit]")
+{
+    std::mt19937 gen(1902);
+    auto count = GENERATE(as<std::size_t>(), 0, 1, 15, 16, 17, 1000);
+    auto bucket_size = GENERATE(as<std::uint64_t>(), 1, 4, 16);
+    auto terms = random_terms(count, gen);
+
+    std::ostringstream os;
+    encode_front_coded_vector(terms.begin(), terms.end(), bucket_size).to_stream(os);
+    auto bytes = os.str();
+    REQUIRE(Front_Coded_Vector::is_front_coded(bytes));
+    auto lexicon = Front_Coded_Vector::from(bytes);
+    REQUIRE(lexicon.size() == terms.size());
+
+    std::vector<std::string> decoded;
+    lexicon.for_each([&](auto term) { decoded.emplace_back(term); });
+    REQUIRE(decoded == terms);
+    std::string buffer;
+    for (std::size_t idx = 0; idx < terms.size(); ++idx) {
+        REQUIRE(lexicon[idx] == terms[idx]);
+        REQUIRE(lexicon.get(idx, buffer) == terms[idx]);
+        REQUIRE(lexicon.find(terms[idx]) == std::optional<std::uint64_t>(idx));
+    }
+    REQUIRE_THROWS_AS(lexicon[terms.size()], std::out_of_range);
+    for (auto const& term: random_terms(100, gen)) {
+        auto pos = std::lower_bound(terms.begin(), terms.end(), term);
+        if (pos == terms.end() or *pos != term) {
+            REQUIRE_FALSE(lexicon.find(term));
+        }
+    }
+}
+
+TEST_CASE("Front coding compresses sorted terms", "[front_coded_vector][unit]")
+{
+    std::vector<std::string> terms;
+    for (int idx = 0; idx < 1000; ++idx) {
+        terms.push_back("international" + std::to_string(1000 + idx));
+    }
+    std::ostringstream front_coded;
+    encode_front_coded_vector(terms.begin(), terms.end()).to_stream(front_coded);
+    std::ostringstream plain;
+    encode_payload_vector(gsl::make_span(terms)).to_stream(plain);
+    REQUIRE(front_coded.str().size() * 4 < plain.str().size());
+    REQUIRE_FALSE(Front_Coded_Vector::is_front_coded(plain.str()));
+}
+
+TEST_CASE("Document lexicon", "[front_coded_vector][unit]")
+{
+    std::vector<std::string> titles;
+    for (int idx = 0; idx < 100; ++idx) {
+        titles.push_back("http://example.com/page" + std::to_string(idx));
+    }
+    Temporary_Directory tmpdir;
+    auto front_coding = GENERATE(false, true);
+    auto filename = (tmpdir.path() / "documents").string();
+    if (front_coding) {
+        encode_front_coded_vector(titles.begin(), titles.end()).to_file(filename);
+    } else {
+        encode_payload_vector(gsl::make_span(titles)).to_file(filename);
+    }
+    Document_Lexicon lexicon(filename);
+    REQUIRE(lexicon.is_front_coded() == front_coding);
+    REQUIRE(lexicon.size() == titles.size());
+    std::string buffer;
+    // out of order, as the results of a query
+    for (std::size_t idx = titles.size(); idx > 0; --idx) {
+        REQUIRE(lexicon.lookup(idx - 1, buffer) == titles[idx - 1]);
+    }
+}
@@ -0,0 +1,64 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <vector>
+
+#include "query/fusion.hpp"
+#include "query/queries.hpp"
+
+using namespace pisa;
+
+using ranking = std::vector<std::pair<float, uint64_t>>;
+
+TEST_CASE("Parse fusion methods")
+{
+    REQUIRE(fusion_method_from_name("rrf") == fusion_method::rrf);
+    REQUIRE(fusion_method_from_name("combsum") == fusion_method::combsum);
+    REQUIRE(fusion_method_from_name("combmnz") == fusion_method::combmnz);
+    REQUIRE_FALSE(fusion_method_from_name("borda"));
+}
+
+TEST_CASE("Fuse rankings")
+{
+    std::vector<ranking> rankings{{{3.0, 1}, {2.0, 2}, {1.0, 3}}, {{4.0, 2}, {0.5, 4}}};
+
+    SECTION("Reciprocal rank fusion")
+    {
+        auto fused = fuse_rankings(rankings, fusion_method::rrf, 10, 1.0);
+        REQUIRE(fused.size() == 4);
+        REQUIRE(fused[0].second == 2);
+        REQUIRE(fused[0].first == Approx(1.0 / 3 + 1.0 / 2));
+        REQUIRE(fused[1] == std::make_pair(0.5F, uint64_t(1)));
+        REQUIRE(fused[2].second == 4);
+        REQUIRE(fused[3].second == 3);
+    }
+    SECTION("Ties are broken by docid")
+    {
+        auto fused = fuse_rankings(
+            std::vector<ranking>{{{1.0, 7}}, {{1.0, 5}}}, fusion_method::rrf, 10);
+        REQUIRE(fused[0].second == 5);
+        REQUIRE(fused[1].second == 7);
+    }
+    SECTION("CombSUM")
+    {
+        auto fused = fuse_rankings(rankings, fusion_method::combsum, 2);
+        REQUIRE(fused == ranking{{6.0, 2}, {3.0, 1}});
+    }
+    SECTION("CombMNZ")
+    {
+        auto fused = fuse_rankings(rankings, fusion_method::combmnz, 10);
+        REQUIRE(fused == ranking{{12.0, 2}, {3.0, 1}, {1.0, 3}, {0.5, 4}});
+    }
+    SECTION("Nothing to fuse")
+    {
+        REQUIRE(fuse_rankings(std::vector<ranking>{}, fusion_method::rrf, 10).empty());
+    }
+}
+
+TEST_CASE("Group query variants by ID")
+{
+    std::vector<Query> queries{
+        {"a", {1}, {}}, {"b", {2}, {}}, {std::nullopt, {3}, {}}, {"a", {4}, {}}};
+    auto groups = group_variants(queries);
+    REQUIRE(groups == std::vector<std::vector<std::size_t>>{{0, 3}, {1}, {2}});
+}
@@ -0,0 +1,152 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <tbb/task_scheduler_init.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "global_statistics.hpp"
+#include "mappable/mapper.hpp"
+#include "pisa_config.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "util/inverted_index_utils.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+namespace {
+
+/// Writes the shard of the test collection with the documents `d` such that
+/// `d % shard_count == shard`, numbered `d / shard_count`, and the terms with postings in
+/// them, named after their IDs. Returns the IDs of these terms in the collection.
+auto write_shard(
+    binary_freq_collection const& collection,
+    std::vector<uint32_t> const& sizes,
+    std::string const& basename,
+    uint32_t shard,
+    uint32_t shard_count) -> std::vector<uint32_t>
+{
+    std::vector<uint32_t> shard_terms;
+    uint32_t num_docs = (collection.num_docs() + shard_count - 1 - shard) / shard_count;
+    std::ofstream docs(basename + ".docs");
+    std::ofstream freqs(basename + ".freqs");
+    std::ofstream terms(basename + ".terms");
+    emit(docs, 1);
+    emit(docs, num_docs);
+    uint32_t term = 0;
+    for (auto const& seq: collection) {
+        std::vector<uint32_t> shard_docs;
+        std::vector<uint32_t> shard_freqs;
+        for (size_t i = 0; i < seq.docs.size(); ++i) {
+            if (seq.docs.begin()[i] % shard_count == shard) {
+                shard_docs.push_back(seq.docs.begin()[i] / shard_count);
+                shard_freqs.push_back(seq.freqs.begin()[i]);
+            }
+        }
+        if (not shard_docs.empty()) {
+            emit(docs, shard_docs.size());
+            emit(docs, shard_docs.data(), shard_docs.size());
+            emit(freqs, shard_freqs.size());
+            emit(freqs, shard_freqs.data(), shard_freqs.size());
+            terms << "term" << term << '\n';
+            shard_terms.push_back(term);
+        }
+        ++term;
+    }
+    std::ofstream shard_sizes(basename + ".sizes");
+    emit(shard_sizes, num_docs);
+    for (uint32_t doc = shard; doc < collection.num_docs(); doc += shard_count) {
+        emit(shard_sizes, sizes[doc]);
+    }
+    return shard_terms;
+}
+
+}  // namespace
+
+TEST_CASE("Shards scored with global statistics match the whole collection")
+{
+    tbb::task_scheduler_init init;
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection size_collection(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::vector<uint32_t> sizes(size_collection.begin()->begin(), size_collection.begin()->end());
+    std::unordered_set<size_t> dropped_terms;
+    wand_data<wand_data_raw> full_wdata(
+        sizes.begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        dropped_terms);
+
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "shard").string();
+    auto stats_basename = (tmpdir.path() / "stats").string();
+    uint32_t shard_count = 3;
+    std::vector<std::vector<uint32_t>> shard_terms;
+    for (uint32_t shard = 0; shard < shard_count; ++shard) {
+        shard_terms.push_back(write_shard(
+            collection, sizes, fmt::format("{}.{:03d}", basename, shard), shard, shard_count));
+    }
+    compute_global_statistics(basename, basename, shard_count, stats_basename);
+
+    auto full_scorer = scorer::from_name("bm25", full_wdata);
+    std::vector<float> max_term_weights(collection.size(), 0.0);
+    for (uint32_t shard = 0; shard < shard_count; ++shard) {
+        CAPTURE(shard);
+        auto shard_basename = fmt::format("{}.{:03d}", basename, shard);
+        mio::mmap_source stats_source(fmt::format("{}.{:03d}", stats_basename, shard).c_str());
+        global_statistics stats;
+        mapper::map(stats, stats_source);
+        REQUIRE(stats.num_docs() == collection.num_docs());
+        REQUIRE(stats.collection_len() == full_wdata.collection_len());
+        REQUIRE(stats.term_count() == shard_terms[shard].size());
+
+        binary_freq_collection shard_collection(shard_basename.c_str());
+        binary_collection shard_sizes((shard_basename + ".sizes").c_str());
+        wand_data<wand_data_raw> shard_wdata(
+            shard_sizes.begin()->begin(),
+            shard_collection.num_docs(),
+            shard_collection,
+            "bm25",
+            BlockSize(FixedBlock(5)),
+            false,
+            dropped_terms,
+            0,
+            &stats);
+
+        global_wand_data<wand_data<wand_data_raw>> scoring_wdata(shard_wdata, stats);
+        auto shard_scorer = scorer::from_name("bm25", scoring_wdata);
+        uint32_t local_term = 0;
+        for (auto const& seq: shard_collection) {
+            auto term = shard_terms[shard][local_term];
+            REQUIRE(stats.term_posting_count(local_term) == full_wdata.term_posting_count(term));
+            REQUIRE(
+                stats.term_occurrence_count(local_term)
+                == full_wdata.term_occurrence_count(term));
+            auto shard_term_scorer = shard_scorer->term_scorer(local_term);
+            auto full_term_scorer = full_scorer->term_scorer(term);
+            for (size_t i = 0; i < seq.docs.size(); ++i) {
+                auto doc = seq.docs.begin()[i];
+                auto freq = seq.freqs.begin()[i];
+                REQUIRE(
+                    shard_term_scorer(doc, freq)
+                    == Approx(full_term_scorer(doc * shard_count + shard, freq)));
+            }
+            max_term_weights[term] =
+                std::max(max_term_weights[term], shard_wdata.max_term_weight(local_term));
+            ++local_term;
+        }
+    }
+    for (size_t term = 0; term < collection.size(); ++term) {
+        REQUIRE(max_term_weights[term] == Approx(full_wdata.max_term_weight(term)));
+    }
+}
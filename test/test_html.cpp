@@ -17,3 +17,30 @@ TEST_CASE("Parse HTML", "[html][unit]")
                                                   {"<a><!-- comment --></a>", ""}}));
     GIVEN("Input: " << input) { CHECK(cleantext(input) == expected); }
 }
+
+TEST_CASE("Strip HTML tags", "[html][unit]")
+{
+    auto [input, expected] = GENERATE(table<std::string, std::string>(
+        {{"text", "text"},
+         {"<a>text</a>", "text"},
+         {"<a>text</a>text", "text text"},
+         {"<a><!-- comment --></a>", ""},
+         {"<a href=\"x>y\" title='<b>'>link</a>", "link"},
+         {"<P>one<BR/>two</P>", "one two"},
+         {"a<script type=\"text/javascript\">if (a</b) {}</script>b", "a b"},
+         {"a<STYLE>p { color: red; }</Style >b", "a b"},
+         {"<scripted>kept</scripted>", "kept"},
+         {"<!DOCTYPE html><?xml version=\"1.0\"?>text", "text"},
+         {"fish &amp; chips &lt;3&gt; &quot;x&quot;&nbsp;&apos;", "fish & chips <3> \"x\" '"},
+         {"caf&#233; &#x4E2D;&#X6587;", "caf\xc3\xa9 \xe4\xb8\xad\xe6\x96\x87"},
+         {"&unknown; & &#; a < b", "&unknown; & &#; a < b"},
+         {"text<!-- unterminated", "text"},
+         {"text<a href=\"unterminated", "text"},
+         {"<script>never closed", ""}}));
+    GIVEN("Input: " << input)
+    {
+        std::string out = "kept ";
+        strip_tags(input, out);
+        CHECK(out == "kept " + expected);
+    }
+}
@@ -0,0 +1,143 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "hybrid_block_index.hpp"
+
+using namespace pisa;
+
+namespace {
+
+struct posting_list {
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> freqs;
+};
+
+auto random_list(std::mt19937& gen, uint32_t num_docs, uint32_t n) -> posting_list
+{
+    std::vector<uint32_t> all(num_docs);
+    std::iota(all.begin(), all.end(), 0);
+    std::shuffle(all.begin(), all.end(), gen);
+    posting_list list;
+    list.docs.assign(all.begin(), all.begin() + n);
+    std::sort(list.docs.begin(), list.docs.end());
+    std::geometric_distribution<uint32_t> freq(0.3);
+    for (uint32_t i = 0; i < n; ++i) {
+        list.freqs.push_back(freq(gen) + 1);
+    }
+    return list;
+}
+
+}  // namespace
+
+TEST_CASE("Hybrid block index lists", "[index][hybrid]")
+{
+    std::mt19937 gen(1902);
+    uint32_t num_docs = 10000;
+    std::vector<posting_list> lists;
+    for (uint32_t n: {1, 5, 127, 128, 129, 1000, 5000, 9000}) {
+        lists.push_back(random_list(gen, num_docs, n));
+    }
+
+    global_parameters params;
+    hybrid_block_index::builder builder(num_docs, params);
+    std::vector<std::optional<uint8_t>> codecs;
+    for (size_t term = 0; term < lists.size(); ++term) {
+        auto const& list = lists[term];
+        if (term % 5 == 4) {
+            builder.add_posting_list(
+                list.docs.size(), list.docs.begin(), list.freqs.begin(), uint64_t(0));
+            codecs.push_back(std::nullopt);
+        } else {
+            uint8_t codec = term % hybrid_codec_count;
+            builder.add_posting_list(
+                codec, list.docs.size(), list.docs.begin(), list.freqs.begin());
+            codecs.push_back(codec);
+        }
+    }
+    hybrid_block_index index;
+    builder.build(index);
+    REQUIRE(index.size() == lists.size());
+    REQUIRE(index.num_docs() == num_docs);
+
+    for (size_t term = 0; term < lists.size(); ++term) {
+        CAPTURE(term);
+        auto const& list = lists[term];
+        auto e = index[term];
+        REQUIRE(e.size() == list.docs.size());
+        REQUIRE(e.codec() == index.codec(term));
+        if (codecs[term]) {
+            REQUIRE(index.codec(term) == *codecs[term]);
+        } else {
+            std::vector<uint8_t> smallest;
+            std::vector<uint8_t> encoded;
+            hybrid_block_index::encode_smallest(
+                smallest, list.docs.size(), list.docs.begin(), list.freqs.begin());
+            hybrid_block_index::encode(
+                index.codec(term),
+                encoded,
+                list.docs.size(),
+                list.docs.begin(),
+                list.freqs.begin());
+            REQUIRE(encoded.size() == smallest.size());
+        }
+        for (size_t pos = 0; pos < list.docs.size(); ++pos, e.next()) {
+            REQUIRE(e.position() == pos);
+            REQUIRE(e.docid() == list.docs[pos]);
+            REQUIRE(e.freq() == list.freqs[pos]);
+        }
+        REQUIRE(e.docid() == num_docs);
+
+        e.reset();
+        for (uint32_t lower_bound = 0; lower_bound < num_docs; lower_bound += 97) {
+            e.next_geq(lower_bound);
+            auto pos = std::lower_bound(list.docs.begin(), list.docs.end(), lower_bound)
+                - list.docs.begin();
+            if (pos < list.docs.size()) {
+                REQUIRE(e.position() == pos);
+                REQUIRE(e.docid() == list.docs[pos]);
+                REQUIRE(e.freq() == list.freqs[pos]);
+            } else {
+                REQUIRE(e.docid() == num_docs);
+            }
+        }
+        auto pos = list.docs.size() / 2;
+        e.move(pos);
+        REQUIRE(e.docid() == list.docs[pos]);
+    }
+
+    SECTION("Invalid codec tags are rejected")
+    {
+        auto const& list = lists.front();
+        REQUIRE_THROWS_AS(
+            builder.add_posting_list(
+                uint8_t(hybrid_codec_count), 1, list.docs.begin(), list.freqs.begin()),
+            std::invalid_argument);
+        REQUIRE(parse_hybrid_codec("optpfor") == 2);
+        REQUIRE_THROWS_AS(parse_hybrid_codec("pef"), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Select hybrid codecs under a space budget", "[index][hybrid]")
+{
+    using costs_type = std::array<hybrid_codec_cost, hybrid_codec_count>;
+    std::vector<costs_type> costs{
+        // Codec 1 is dominated by codec 2, and codec 3 lies above the hull of 0 and 2.
+        costs_type{{{100, 50.0}, {300, 45.0}, {200, 10.0}, {150, 40.0}}},
+        costs_type{{{120, 30.0}, {100, 60.0}, {500, 0.0}, {110, 55.0}}},
+        costs_type{{{10, 0.0}, {20, 0.0}, {30, 0.0}, {40, 0.0}}}};
+
+    REQUIRE(select_hybrid_codecs(costs, std::nullopt) == std::vector<uint8_t>{2, 2, 0});
+    REQUIRE(select_hybrid_codecs(costs, 210) == std::vector<uint8_t>{0, 1, 0});
+    // List 1 saves the most time per byte, and then list 0 no longer fits.
+    REQUIRE(select_hybrid_codecs(costs, 230) == std::vector<uint8_t>{0, 0, 0});
+    REQUIRE(select_hybrid_codecs(costs, 330) == std::vector<uint8_t>{2, 0, 0});
+    REQUIRE(select_hybrid_codecs(costs, 10000) == std::vector<uint8_t>{2, 2, 0});
+    REQUIRE(select_hybrid_codecs(costs, 0) == std::vector<uint8_t>{0, 1, 0});
+}
@@ -0,0 +1,160 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "accumulator/simple_accumulator.hpp"
+#include "binary_freq_collection.hpp"
+#include "cursor/impact_cursor.hpp"
+#include "impact_index.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm/anytime_saat_query.hpp"
+#include "query/queries.hpp"
+
+using namespace pisa;
+
+using index_type = impact_index<interpolative_block>;
+
+struct ImpactIndexData {
+    ImpactIndexData() : collection(PISA_SOURCE_DIR "/test/test_data/test_collection")
+    {
+        global_parameters params;
+        index_type::builder builder(collection.num_docs(), params);
+        for (auto const& plist: collection) {
+            builder.add_posting_list(plist.docs.size(), plist.docs.begin(), plist.freqs.begin());
+        }
+        builder.build(index);
+
+        std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+        io::for_each_line(
+            qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    }
+
+    binary_freq_collection collection;
+    index_type index;
+    std::vector<Query> queries;
+};
+
+TEST_CASE("Impact-ordered posting lists")
+{
+    ImpactIndexData data;
+    REQUIRE(data.index.size() == data.collection.size());
+
+    size_t term_id = 0;
+    for (auto const& plist: data.collection) {
+        auto list = data.index[term_id++];
+        REQUIRE(list.size() == plist.docs.size());
+
+        std::vector<std::pair<uint32_t, uint32_t>> postings;
+        uint32_t previous_impact = std::numeric_limits<uint32_t>::max();
+        for (auto const& segment: list.segments()) {
+            REQUIRE(segment.impact() < previous_impact);
+            previous_impact = segment.impact();
+            std::vector<uint32_t> docs;
+            segment.for_each([&](uint32_t docid) { docs.push_back(docid); });
+            REQUIRE(docs.size() == segment.size());
+            REQUIRE(std::is_sorted(docs.begin(), docs.end()));
+            for (auto docid: docs) {
+                postings.emplace_back(docid, segment.impact());
+            }
+        }
+        std::sort(postings.begin(), postings.end());
+
+        std::vector<std::pair<uint32_t, uint32_t>> expected;
+        std::transform(
+            plist.docs.begin(),
+            plist.docs.end(),
+            plist.freqs.begin(),
+            std::back_inserter(expected),
+            [](auto docid, auto freq) { return std::make_pair(docid, freq); });
+        REQUIRE(postings == expected);
+    }
+}
+
+TEST_CASE("Anytime score-at-a-time query processing")
+{
+    ImpactIndexData data;
+    topk_queue topk(10);
+    Simple_Accumulator accumulator(data.index.num_docs());
+
+    SECTION("Exhaustive processing matches exact impact sums")
+    {
+        anytime_saat_query query_alg(topk);
+        for (auto const& query: data.queries) {
+            topk.clear();
+            auto cursors = make_impact_cursors(data.index, query);
+            query_alg(cursors, accumulator);
+            topk.finalize();
+
+            std::unordered_map<uint32_t, float> scores;
+            uint64_t total_postings = 0;
+            for (auto const& cursor: cursors) {
+                total_postings += cursor.postings.size();
+                for (auto const& segment: cursor.postings.segments()) {
+                    segment.for_each([&](uint32_t docid) {
+                        scores[docid] += cursor.q_weight * segment.impact();
+                    });
+                }
+            }
+            std::vector<float> expected;
+            for (auto const& entry: scores) {
+                expected.push_back(entry.second);
+            }
+            std::sort(expected.begin(), expected.end(), std::greater<>());
+            expected.resize(std::min<size_t>(expected.size(), 10));
+
+            REQUIRE(query_alg.postings_processed() == total_postings);
+            REQUIRE(topk.topk().size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                REQUIRE(topk.topk()[i].first == Approx(expected[i]));
+            }
+        }
+    }
+
+    SECTION("Postings budget is never exceeded")
+    {
+        uint64_t budget = GENERATE(uint64_t(0), uint64_t(1), uint64_t(100), uint64_t(10000));
+        anytime_saat_query query_alg(topk, budget);
+        for (auto const& query: data.queries) {
+            topk.clear();
+            auto cursors = make_impact_cursors(data.index, query);
+            query_alg(cursors, accumulator);
+            topk.finalize();
+
+            uint64_t total_postings = 0;
+            for (auto const& cursor: cursors) {
+                total_postings += cursor.postings.size();
+            }
+            REQUIRE(query_alg.postings_processed() == std::min(budget, total_postings));
+        }
+    }
+}
+
+TEST_CASE("Impact-ordered lists of the longest terms only")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    std::size_t min_length = 100;
+    global_parameters params;
+    index_type::builder builder(collection.num_docs(), params);
+    std::vector<std::size_t> lengths;
+    for (auto const& plist: collection) {
+        lengths.push_back(plist.docs.size());
+        if (plist.docs.size() >= min_length) {
+            builder.add_posting_list(plist.docs.size(), plist.docs.begin(), plist.freqs.begin());
+        } else {
+            builder.add_empty_list();
+        }
+    }
+    index_type index;
+    builder.build(index);
+
+    REQUIRE(index.size() == lengths.size());
+    REQUIRE(not index.stores(index.size()));
+    for (std::size_t term = 0; term < lengths.size(); ++term) {
+        REQUIRE(index.stores(term) == (lengths[term] >= min_length));
+        REQUIRE(index[term].size() == (index.stores(term) ? lengths[term] : 0));
+    }
+}
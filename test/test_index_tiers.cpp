@@ -0,0 +1,113 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <vector>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "index_tiers.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Posting lists are split by score", "[index_tiers]")
+{
+    std::vector<uint32_t> docs{1, 3, 4, 7, 9, 12};
+    std::vector<uint32_t> freqs{1, 2, 3, 4, 5, 6};
+    std::vector<float> scores{0.5, 3.0, 1.0, 2.5, 0.1, 2.0};
+    auto tiers = posting_tiers::split(docs.begin(), freqs.begin(), scores, 0.5, 1);
+    REQUIRE(tiers.first_docs == std::vector<uint32_t>{3, 7, 12});
+    REQUIRE(tiers.first_freqs == std::vector<uint32_t>{2, 4, 6});
+    REQUIRE(tiers.second_docs == std::vector<uint32_t>{1, 4, 9});
+    REQUIRE(tiers.second_freqs == std::vector<uint32_t>{1, 3, 5});
+    REQUIRE(tiers.first_max_score == 3.0F);
+    REQUIRE(tiers.second_max_score == 1.0F);
+
+    auto all = posting_tiers::split(docs.begin(), freqs.begin(), scores, 0.1, 10);
+    REQUIRE(all.first_docs == docs);
+    REQUIRE(all.second_docs.empty());
+    REQUIRE(all.second_max_score == 0.0F);
+}
+
+TEST_CASE(
+    "Tiered queries return the results of the full index", "[index_tiers][query][integration]")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+
+    global_parameters params;
+    block_simdbp_index index;
+    block_simdbp_index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+
+    auto ratio = GENERATE(0.01, 0.1, 0.5);
+    block_simdbp_index::builder first_builder(collection.num_docs(), params);
+    block_simdbp_index::builder second_builder(collection.num_docs(), params);
+    index_tiers::builder tiers_builder;
+    term_id_type term = 0;
+    for (auto const& plist: collection) {
+        auto term_scorer = make_term_scorer(scorer, term++);
+        std::vector<float> scores;
+        for (std::size_t idx = 0; idx < plist.docs.size(); ++idx) {
+            scores.push_back(term_scorer(plist.docs.begin()[idx], plist.freqs.begin()[idx]));
+        }
+        auto tiers =
+            posting_tiers::split(plist.docs.begin(), plist.freqs.begin(), scores, ratio, 8);
+        auto add = [](auto& builder, auto const& docs, auto const& freqs) {
+            uint64_t freqs_sum = std::accumulate(freqs.begin(), freqs.end(), uint64_t(0));
+            builder.add_posting_list(docs.size(), docs.begin(), freqs.begin(), freqs_sum);
+        };
+        add(first_builder, tiers.first_docs, tiers.first_freqs);
+        if (not tiers.second_docs.empty()) {
+            add(second_builder, tiers.second_docs, tiers.second_freqs);
+        }
+        tiers_builder.add_term(tiers);
+    }
+    block_simdbp_index first_tier;
+    first_builder.build(first_tier);
+    block_simdbp_index second_tier;
+    second_builder.build(second_tier);
+    index_tiers tiers;
+    tiers_builder.build(tiers);
+    REQUIRE(tiers.size() == index.size());
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    topk_queue expected(10);
+    wand_query expected_q(expected);
+    topk_queue topk(10);
+    tiered_query tiered_q(topk);
+    for (auto const& query: queries) {
+        expected.clear();
+        expected_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        expected.finalize();
+        topk.clear();
+        tiered_q(first_tier, second_tier, tiers, scorer, query);
+        REQUIRE(topk.topk().size() == expected.topk().size());
+        for (std::size_t rank = 0; rank < topk.topk().size(); ++rank) {
+            REQUIRE(topk.topk()[rank].first == Approx(expected.topk()[rank].first).epsilon(0.001));
+        }
+    }
+}
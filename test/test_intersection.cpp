@@ -204,13 +204,13 @@ TEST_CASE("compute intersection", "[intersection][unit]")
             {0.1, 0.4, 1.0}  // weights
         };
         auto [mask, len, max] = GENERATE(table<Mask, std::size_t, float>({
-            {0b001, 3, 1.84583f},
-            {0b010, 3, 1.84583f},
+            {0b001, 3, 0.184583f},
+            {0b010, 3, 0.738332f},
             {0b100, 3, 1.84583f},
-            {0b011, 1, 3.69165f},
-            {0b101, 2, 3.69165f},
-            {0b110, 2, 3.69165f},
-            {0b111, 1, 5.53748f},
+            {0b011, 1, 0.922915f},
+            {0b101, 2, 2.03041f},
+            {0b110, 2, 2.58416f},
+            {0b111, 1, 2.76874f},
         }));
         WHEN("Computed intersection with mask " << mask)
         {
@@ -274,3 +274,40 @@ TEST_CASE("for_all_subsets", "[intersection][unit]")
         }
     }
 }
+
+TEST_CASE("for_all_subset_intersections", "[intersection][unit]")
+{
+    InMemoryIndex index{{
+                            {0, 1, 2, 3, 5, 8},  // 0
+                            {0, 1, 2},  // 1
+                            {1, 2, 5, 8, 9},  // 2
+                            {0, 2, 5, 8},  // 3
+                            {2, 8},  // 4
+                        },
+                        {
+                            {1, 2, 1, 1, 3, 1},  // 0
+                            {1, 1, 4},  // 1
+                            {2, 1, 1, 5, 1},  // 2
+                            {1, 3, 1, 1},  // 3
+                            {1, 2},  // 4
+                        },
+                        10};
+    InMemoryWand wand{{4.0, 1.0, 3.0, 2.0, 5.0}, 10};
+    Query query{"Q1", {0, 2, 3, 4, 1}, {}};
+    auto max_term_count = GENERATE(std::optional<std::uint8_t>{}, std::optional<std::uint8_t>{3});
+
+    std::vector<Mask> expected_masks;
+    for_all_subsets(query, max_term_count, [&](Query const&, Mask const& mask) {
+        expected_masks.push_back(mask);
+    });
+    std::vector<Mask> masks;
+    auto check = [&](Query const&, Mask const& mask, Intersection actual) {
+        auto expected = Intersection::compute(index, wand, query, mask);
+        INFO("Mask " << mask);
+        CHECK(actual.length == expected.length);
+        CHECK(actual.max_score == Approx(expected.max_score));
+        masks.push_back(mask);
+    };
+    for_all_subset_intersections(index, wand, query, max_term_count, check);
+    CHECK(masks == expected_masks);
+}
@@ -0,0 +1,120 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "intersection_cache.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Select the most frequent term pairs")
+{
+    std::vector<Query> queries{
+        {std::nullopt, {1, 2, 3}, {}},
+        {std::nullopt, {2, 1}, {}},
+        {std::nullopt, {3, 1, 1}, {}},
+        {std::nullopt, {2, 1, 4}, {}}};
+    using term_pair = intersection_cache::term_pair;
+    REQUIRE(
+        intersection_cache::select_pairs(queries, 2)
+        == std::vector<term_pair>{{1, 2}, {1, 3}});
+}
+
+TEST_CASE("Ranked AND with precomputed intersections")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+
+    global_parameters params;
+    block_interpolative_index index;
+    block_interpolative_index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+    intersection_cache::builder cache_builder(index.num_docs());
+    for (auto pair: intersection_cache::select_pairs(queries, 50)) {
+        auto [docs, scores] = intersection_cache::intersect(index, scorer, pair);
+        cache_builder.add_pair(pair, std::move(docs), std::move(scores));
+    }
+    intersection_cache built;
+    cache_builder.build(built);
+    Temporary_Directory tmpdir;
+    auto cache_path = (tmpdir.path() / "intersections").string();
+    mapper::freeze(built, cache_path.c_str());
+    intersection_cache cache;
+    mio::mmap_source source(cache_path.c_str());
+    mapper::map(cache, source);
+    REQUIRE(cache.size() == 50);
+
+    auto require_same_results = [](auto const& expected, auto const& actual) {
+        REQUIRE(expected.size() == actual.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE(expected[i].first == Approx(actual[i].first));
+        }
+    };
+
+    size_t cached_queries = 0;
+    for (auto const& query: queries) {
+        auto pair = cache.best_pair(query);
+        if (not pair) {
+            continue;
+        }
+        cached_queries += 1;
+        REQUIRE(pair->second.terms.size() + 2 <= query.terms.size());
+
+        topk_queue expected(10);
+        ranked_and_query ranked_and_q(expected);
+        ranked_and_q(make_scored_cursors(index, scorer, query), index.num_docs());
+        expected.finalize();
+
+        topk_queue actual(10);
+        ranked_and_query cached_ranked_and_q(actual);
+        cached_ranked_and_q(
+            cache.cursor(pair->first),
+            make_scored_cursors(index, scorer, pair->second),
+            index.num_docs());
+        actual.finalize();
+        require_same_results(expected.topk(), actual.topk());
+
+        topk_queue block_max(10);
+        block_max_ranked_and_query block_max_ranked_and_q(block_max);
+        block_max_ranked_and_q(
+            cache.cursor(pair->first),
+            make_block_max_scored_cursors(index, wdata, scorer, pair->second),
+            index.num_docs());
+        block_max.finalize();
+        require_same_results(expected.topk(), block_max.topk());
+    }
+    REQUIRE(cached_queries > 0);
+}
@@ -248,6 +248,45 @@ TEST_CASE("Invert a range of documents from a collection", "[invert][unit]")
     REQUIRE(index.document_sizes == expected.document_sizes);
 }
 
+TEST_CASE("Invert a range of documents with a counting sort", "[invert][unit]")
+{
+    tbb::task_scheduler_init init;
+    std::vector<std::vector<Term_Id>> collection = {
+        /* Doc 0 */ {2_t, 0_t, 3_t, 9_t, 0_t},
+        /* Doc 1 */ {5_t, 0_t, 3_t, 4_t, 2_t, 6_t, 7_t, 4_t, 5_t},
+        /* Doc 2 */ {5_t, 1_t, 8_t, 9_t, 8_t, 8_t},
+        /* Doc 3 */ {8_t, 5_t, 9_t},
+        /* Doc 4 */ {8_t, 6_t, 9_t, 6_t, 6_t, 5_t, 4_t, 3_t, 1_t, 0_t, 6_t}};
+
+    std::vector<gsl::span<Term_Id const>> document_range;
+    std::transform(
+        collection.begin(), collection.end(), std::back_inserter(document_range), [](auto const& vec) {
+            return gsl::span<Term_Id const>(vec);
+        });
+    size_t threads = GENERATE(1, 3);
+    uint32_t term_count = 11;
+
+    auto index = invert::invert_range_flat(document_range, 10_d, term_count, threads);
+    auto expected = invert::invert_range(document_range, 10_d, threads);
+
+    REQUIRE(index.document_sizes == expected.document_sizes);
+    for (uint32_t term = 0; term < term_count; ++term) {
+        auto documents = index.term_documents(term);
+        auto frequencies = index.term_frequencies(term);
+        if (auto pos = expected.documents.find(Term_Id(term)); pos != expected.documents.end()) {
+            REQUIRE(std::vector<Document_Id>(documents.begin(), documents.end()) == pos->second);
+            REQUIRE(
+                std::vector<Frequency>(frequencies.begin(), frequencies.end())
+                == expected.frequencies.at(Term_Id(term)));
+        } else {
+            REQUIRE(documents.empty());
+            REQUIRE(frequencies.empty());
+        }
+    }
+    REQUIRE_THROWS_AS(
+        invert::invert_range_flat(document_range, 10_d, 9, threads), std::out_of_range);
+}
+
 TEST_CASE("Invert collection", "[invert][unit]")
 {
     tbb::task_scheduler_init init;
@@ -329,3 +368,47 @@ TEST_CASE("Invert collection", "[invert][unit]")
         }
     }
 }
+
+TEST_CASE("Invert collection in external memory", "[invert][unit]")
+{
+    tbb::task_scheduler_init init;
+    Temporary_Directory tmpdir;
+    auto collection_filename = (tmpdir.path() / "collection.plaintext").string();
+    {
+        std::vector<uint32_t> collection_data{
+            /* size */ 1,  /* count */ 5,
+            /* size */ 5,  /* Doc 0 */ 2, 0, 3, 9, 0,
+            /* size */ 9,  /* Doc 1 */ 5, 0, 3, 4, 2, 6, 7, 4, 5,
+            /* size */ 6,  /* Doc 2 */ 5, 1, 8, 9, 8, 8,
+            /* size */ 3,  /* Doc 3 */ 8, 5, 9,
+            /* size */ 11, /* Doc 4 */ 8, 6, 9, 6, 6, 5, 4, 3, 1, 0, 6};
+        std::ofstream os(collection_filename);
+        os.write(
+            reinterpret_cast<char*>(collection_data.data()),
+            collection_data.size() * sizeof(uint32_t));
+    }
+    auto read = [](std::string const& filename) {
+        mio::mmap_source mm(filename.c_str());
+        return std::vector<uint32_t>(
+            reinterpret_cast<uint32_t const*>(mm.data()),
+            reinterpret_cast<uint32_t const*>(mm.data()) + mm.size() / sizeof(uint32_t));
+    };
+    auto expected_basename = (tmpdir.path() / "expected").string();
+    invert::invert_forward_index(collection_filename, expected_basename, 10, 5, 1);
+
+    size_t memory_budget = GENERATE(1, 12, 36, 120, 1 << 20);
+    auto index_basename = (tmpdir.path() / "idx").string();
+    invert::invert_forward_index_external(collection_filename, index_basename, 10, memory_budget);
+    REQUIRE(read(index_basename + ".docs") == read(expected_basename + ".docs"));
+    REQUIRE(read(index_basename + ".freqs") == read(expected_basename + ".freqs"));
+    REQUIRE(read(index_basename + ".sizes") == read(expected_basename + ".sizes"));
+    auto run_files = pisa::ls(tmpdir.path().string(), [](auto const& filename) {
+        return filename.find("run") != std::string::npos;
+    });
+    REQUIRE(run_files.empty());
+
+    REQUIRE_THROWS_AS(
+        invert::invert_forward_index_external(
+            collection_filename, index_basename, 9, memory_budget),
+        std::runtime_error);
+}
@@ -0,0 +1,76 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "util/latency_histogram.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Latency histogram quantiles are within its precision")
+{
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> dist(10.0, 2.0);
+    std::vector<uint64_t> values(100000);
+    std::generate(values.begin(), values.end(), [&]() { return uint64_t(dist(rng)); });
+    latency_histogram histogram;
+    for (auto value: values) {
+        histogram.record(value);
+    }
+    std::sort(values.begin(), values.end());
+    REQUIRE(histogram.count() == values.size());
+    REQUIRE(histogram.min() == values.front());
+    REQUIRE(histogram.max() == values.back());
+    for (double q: {0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+        CAPTURE(q);
+        auto rank = std::max<size_t>(1, std::ceil(q * values.size()));
+        auto expected = values[rank - 1];
+        auto actual = histogram.quantile(q);
+        REQUIRE(actual >= expected);
+        REQUIRE(actual <= expected + expected / 128);
+    }
+}
+
+TEST_CASE("Merged latency histograms equal one histogram of all values")
+{
+    latency_histogram all;
+    latency_histogram first;
+    latency_histogram second;
+    for (uint64_t value = 0; value < 100000; value += 7) {
+        all.record(value * value);
+        (value % 2 == 0 ? first : second).record(value * value);
+    }
+    first.merge(second);
+    REQUIRE(first.count() == all.count());
+    REQUIRE(first.sum() == all.sum());
+    REQUIRE(first.min() == all.min());
+    REQUIRE(first.max() == all.max());
+    for (double q: {0.25, 0.5, 0.75, 0.99}) {
+        REQUIRE(first.quantile(q) == all.quantile(q));
+    }
+}
+
+TEST_CASE("Latency histogram is written as a Prometheus summary in seconds")
+{
+    latency_histogram histogram;
+    histogram.record(1'031);
+    histogram.record(3'000'000'000);
+    std::ostringstream os;
+    latency_histogram::write_prometheus_header(os, "query_latency_seconds", "Query latency.");
+    histogram.write_prometheus(os, "query_latency_seconds", "phase=\"total\"");
+    auto text = os.str();
+    REQUIRE(text.find("# TYPE query_latency_seconds summary\n") != std::string::npos);
+    REQUIRE(
+        text.find("query_latency_seconds{phase=\"total\",quantile=\"0.5\"} 0.000001031\n")
+        != std::string::npos);
+    REQUIRE(
+        text.find("query_latency_seconds{phase=\"total\",quantile=\"0.999\"} 3.000000000\n")
+        != std::string::npos);
+    REQUIRE(
+        text.find("query_latency_seconds_sum{phase=\"total\"} 3.000001031\n")
+        != std::string::npos);
+    REQUIRE(text.find("query_latency_seconds_count{phase=\"total\"} 2\n") != std::string::npos);
+}
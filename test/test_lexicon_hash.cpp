@@ -0,0 +1,73 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gsl/span>
+
+#include "lexicon_hash.hpp"
+#include "payload_vector.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto random_terms(std::size_t count, std::mt19937& gen) -> std::vector<std::string>
+{
+    std::uniform_int_distribution<std::size_t> length(0, 20);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> terms;
+    while (terms.size() < count) {
+        std::string term(length(gen), 'a');
+        std::generate(term.begin(), term.end(), [&] { return static_cast<char>(letter(gen)); });
+        terms.push_back(std::move(term));
+    }
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    return terms;
+}
+
+}  // namespace
+
+TEST_CASE("Look up lexicon terms with a perfect hash", "[lexicon_hash][unit]")
+{
+    std::mt19937 gen(1902);
+    auto count = GENERATE(as<std::size_t>(), 0, 1, 2, 10, 1000, 100000);
+    auto terms = random_terms(count, gen);
+    auto lexicon_buffer = encode_payload_vector(gsl::make_span(terms));
+    Payload_Vector<> lexicon(lexicon_buffer);
+
+    std::ostringstream os;
+    Lexicon_Hash_Buffer::build(lexicon).to_stream(os);
+    auto bytes = os.str();
+    auto hash = Lexicon_Hash::from(bytes);
+    REQUIRE(hash.size() == terms.size());
+
+    for (std::size_t term_id = 0; term_id < terms.size(); ++term_id) {
+        REQUIRE(hash.find(lexicon, terms[term_id]) == std::optional<std::size_t>(term_id));
+    }
+    for (auto const& term: random_terms(1000, gen)) {
+        auto pos = std::lower_bound(terms.begin(), terms.end(), term);
+        if (pos == terms.end() or *pos != term) {
+            REQUIRE_FALSE(hash.find(lexicon, term));
+        }
+    }
+}
+
+TEST_CASE("Reject lexicons with duplicate terms", "[lexicon_hash][unit]")
+{
+    std::vector<std::string> terms{"a", "b", "b"};
+    auto lexicon_buffer = encode_payload_vector(gsl::make_span(terms));
+    REQUIRE_THROWS_AS(
+        Lexicon_Hash_Buffer::build(Payload_Vector<>(lexicon_buffer)), std::invalid_argument);
+}
+
+TEST_CASE("Reject files that are not lexicon hashes", "[lexicon_hash][unit]")
+{
+    std::string bytes(64, '\0');
+    REQUIRE_THROWS_AS(Lexicon_Hash::from(bytes), std::runtime_error);
+}
@@ -0,0 +1,71 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "temporary_directory.hpp"
+#include "util/line_server.hpp"
+
+using namespace pisa;
+
+[[nodiscard]] auto connect_to(std::string const& path) -> int
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+/// Reads from the socket until `count` responses, each ending with an empty line, arrived.
+[[nodiscard]] auto read_responses(int fd, int count) -> std::string
+{
+    std::string received;
+    char chunk[256];
+    auto complete = [&]() {
+        int responses = 0;
+        for (auto pos = received.find("\n\n"); pos != std::string::npos;
+             pos = received.find("\n\n", pos + 2)) {
+            responses += 1;
+        }
+        return responses >= count;
+    };
+    while (not complete()) {
+        auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+        REQUIRE(n > 0);
+        received.append(chunk, n);
+    }
+    return received;
+}
+
+TEST_CASE("Answer requests over a Unix socket")
+{
+    Temporary_Directory tmpdir;
+    auto path = (tmpdir.path() / "server.sock").string();
+    auto server = line_server::unix_socket(path);
+    std::thread serving([&] {
+        server.serve([](std::string const& request) {
+            return fmt::format("{}\n{}\n", request, request.size());
+        });
+    });
+
+    int first = connect_to(path);
+    int second = connect_to(path);
+    std::string requests = "hello\nquery:";
+    ::send(first, requests.data(), requests.size(), 0);
+    ::send(second, "x\n", 2, 0);
+    REQUIRE(read_responses(second, 1) == "x\n1\n\n");
+    ::send(first, "terms\n", 6, 0);
+    REQUIRE(read_responses(first, 2) == "hello\n5\n\nquery:terms\n11\n\n");
+
+    ::close(first);
+    ::close(second);
+    server.stop();
+    serving.join();
+}
@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "linear_quantizer.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto random_scores(std::size_t count, float max) -> std::vector<float>
+{
+    std::mt19937 gen(1234);
+    std::exponential_distribution<float> dist(4.0F / max);
+    std::vector<float> scores(count);
+    std::generate(scores.begin(), scores.end(), [&]() { return std::min(dist(gen), max); });
+    scores.push_back(0.0F);
+    scores.push_back(max);
+    return scores;
+}
+
+}  // namespace
+
+TEST_CASE("Bulk linear quantization matches quantizing one by one", "[quantizer]")
+{
+    auto scores = random_scores(1000, 20.0F);
+    LinearQuantizer quantizer(20.0F, 8);
+    std::vector<std::uint32_t> quants(scores.size());
+    quantizer.quantize(scores, quants);
+    for (std::size_t i = 0; i < scores.size(); ++i) {
+        REQUIRE(quants[i] == quantizer(scores[i]));
+    }
+}
+
+TEST_CASE("Bucket quantizers order codes as scores", "[quantizer]")
+{
+    float max = 20.0F;
+    auto scores = random_scores(10000, max);
+    auto bits = GENERATE(std::uint8_t(1), std::uint8_t(4), std::uint8_t(8), std::uint8_t(12));
+    auto quantizer = GENERATE_REF(
+        bucket_quantizer::logarithmic(max, bits), bucket_quantizer::quantiles(scores, max, bits));
+    auto buckets = std::uint32_t(1) << bits;
+    REQUIRE(quantizer.bounds().size() == buckets);
+    REQUIRE(quantizer.bounds().back() == max);
+
+    std::vector<std::uint32_t> codes(scores.size());
+    quantizer.quantize(scores, codes);
+    auto const& bounds = quantizer.bounds();
+    for (std::size_t i = 0; i < scores.size(); ++i) {
+        auto code = codes[i];
+        REQUIRE(code == quantizer(scores[i]));
+        if (scores[i] == 0) {
+            REQUIRE(code == 0);
+            continue;
+        }
+        // the code is that of the first bucket ending at or above the score
+        REQUIRE(code >= 1);
+        REQUIRE(code <= buckets);
+        REQUIRE(scores[i] <= bounds[code - 1]);
+        if (code > 1) {
+            REQUIRE(scores[i] > bounds[code - 2]);
+        }
+    }
+
+    auto weights = quantizer.weights();
+    REQUIRE(weights.size() == buckets + 1);
+    REQUIRE(weights[0] == 0);
+    REQUIRE(weights[1] >= 1);
+    REQUIRE(std::is_sorted(weights.begin(), weights.end()));
+}
+
+TEST_CASE("Quantile buckets hold about as many scores each", "[quantizer]")
+{
+    auto scores = random_scores(1U << 16U, 20.0F);
+    auto quantizer = bucket_quantizer::quantiles(scores, 20.0F, 4);
+    std::vector<std::size_t> counts(17, 0);
+    for (auto score: scores) {
+        counts[quantizer(score)] += 1;
+    }
+    for (std::size_t code = 1; code <= 16; ++code) {
+        REQUIRE(counts[code] == Approx(scores.size() / 16).epsilon(0.05));
+    }
+}
+
+TEST_CASE("Logarithmic buckets widen with the scores", "[quantizer]")
+{
+    auto quantizer = bucket_quantizer::logarithmic(10.0F, 8);
+    auto const& bounds = quantizer.bounds();
+    float previous_width = bounds[0];
+    for (std::size_t bucket = 1; bucket < bounds.size(); ++bucket) {
+        float width = bounds[bucket] - bounds[bucket - 1];
+        REQUIRE(width >= previous_width * 0.99F);
+        previous_width = width;
+    }
+    REQUIRE(bounds.back() / bounds.front() > 1000);
+}
+
+TEST_CASE("Bucket quantizers reject invalid buckets", "[quantizer]")
+{
+    REQUIRE_THROWS_AS(bucket_quantizer::logarithmic(1.0F, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(bucket_quantizer::logarithmic(1.0F, 17), std::invalid_argument);
+    REQUIRE_THROWS_AS(bucket_quantizer({1.0F, 2.0F, 3.0F}), std::invalid_argument);
+    REQUIRE_THROWS_AS(bucket_quantizer({2.0F, 1.0F}), std::invalid_argument);
+}
@@ -3,9 +3,15 @@
 
 #include "test_common.hpp"
 
+#include <fstream>
+#include <numeric>
+
 #include "mio/mmap.hpp"
 
 #include "mappable/mapper.hpp"
+#include "mappable/residency.hpp"
+#include "mappable/warmup.hpp"
+#include "util/xxhash.hpp"
 
 TEST_CASE("basic_map")
 {
@@ -74,3 +80,169 @@ TEST_CASE("complex_struct_map")
 
     std::remove("temp.bin");
 }
+
+TEST_CASE("map_with_load_modes")
+{
+    pisa::mapper::mappable_vector<uint32_t> vec;
+    std::vector<uint32_t> nums(10000);
+    std::iota(nums.begin(), nums.end(), 0);
+    vec.assign(nums);
+    pisa::mapper::freeze(vec, "temp.bin");
+
+    auto mode = GENERATE(
+        pisa::mapper::load_mode::mmap,
+        pisa::mapper::load_mode::populate,
+        pisa::mapper::load_mode::hugepage,
+        pisa::mapper::load_mode::hugetlb_2mb,
+        pisa::mapper::load_mode::hugetlb_1gb);
+    {
+        pisa::mapper::mappable_vector<uint32_t> mapped_vec;
+        pisa::mapper::mapped_file m("temp.bin", mode);
+        pisa::mapper::map(mapped_vec, m);
+        REQUIRE(vec.size() == mapped_vec.size());
+        REQUIRE(std::equal(vec.begin(), vec.end(), mapped_vec.begin()));
+    }
+
+    std::remove("temp.bin");
+}
+
+TEST_CASE("parse_load_mode")
+{
+    REQUIRE(pisa::mapper::parse_load_mode("mmap") == pisa::mapper::load_mode::mmap);
+    REQUIRE(pisa::mapper::parse_load_mode("hugetlb-2mb") == pisa::mapper::load_mode::hugetlb_2mb);
+    REQUIRE_THROWS_AS(pisa::mapper::parse_load_mode("huge"), std::invalid_argument);
+}
+
+TEST_CASE("xxhash64")
+{
+    REQUIRE(pisa::xxhash64("", 0) == 0xEF46DB3751D8E999ULL);
+    REQUIRE(pisa::xxhash64("a", 1) == 0xD24EC4F1A98C6E5BULL);
+    std::string text = "Nobody inspects the spammish repetition";
+    REQUIRE(pisa::xxhash64(text.data(), text.size()) == 0xFBCEA83C8A378BF1ULL);
+}
+
+TEST_CASE("map_with_header")
+{
+    complex_struct s;
+    s.init();
+    pisa::mapper::freeze(s, "temp.bin", pisa::mapper::file_description{"complex", 42});
+
+    {
+        auto header = pisa::mapper::file_header::read("temp.bin");
+        REQUIRE(header.has_value());
+        REQUIRE(header->description.type == "complex");
+        REQUIRE(header->description.num_docs == 42);
+        REQUIRE(header->sections.size() == 1);
+        REQUIRE(header->sections[0].length == 2 * sizeof(uint32_t));
+        REQUIRE(header->size() % 64 == 0);
+
+        REQUIRE_NOTHROW(pisa::mapper::check_file_type("temp.bin", "complex"));
+        REQUIRE_THROWS_AS(
+            pisa::mapper::check_file_type("temp.bin", "other"), std::invalid_argument);
+
+        mio::mmap_source m("temp.bin");
+        complex_struct mapped_s;
+        pisa::mapper::map(mapped_s, m);
+        REQUIRE(s.m_a == mapped_s.m_a);
+        REQUIRE(std::equal(s.m_b.begin(), s.m_b.end(), mapped_s.m_b.begin()));
+        REQUIRE(pisa::mapper::verify_checksums(m.data(), m.size()));
+
+        pisa::mapper::mappable_vector<uint64_t> wrong_type;
+        REQUIRE_THROWS_AS(pisa::mapper::map(wrong_type, m), std::runtime_error);
+    }
+
+    {
+        std::fstream fs("temp.bin", std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(-1, std::ios::end);
+        fs.put(7);
+    }
+    {
+        mio::mmap_source m("temp.bin");
+        REQUIRE_FALSE(pisa::mapper::verify_checksums(m.data(), m.size()));
+    }
+
+    std::remove("temp.bin");
+}
+
+TEST_CASE("map_without_header")
+{
+    complex_struct s;
+    s.init();
+    pisa::mapper::freeze(s, "temp.bin");
+
+    REQUIRE_FALSE(pisa::mapper::file_header::read("temp.bin").has_value());
+    REQUIRE_NOTHROW(pisa::mapper::check_file_type("temp.bin", "other"));
+    mio::mmap_source m("temp.bin");
+    REQUIRE(pisa::mapper::verify_checksums(m.data(), m.size()));
+
+    std::remove("temp.bin");
+}
+
+TEST_CASE("residency_tree_of")
+{
+    complex_struct cs;
+    cs.init();
+    std::vector<uint32_t> big(1U << 16U);
+    std::iota(big.begin(), big.end(), 0);
+    cs.m_b.steal(big);
+    pisa::mapper::freeze(cs, "temp.bin");
+
+    {
+        complex_struct mapped_cs;
+        mio::mmap_source m("temp.bin");
+        pisa::mapper::map(mapped_cs, m);
+        REQUIRE(mapped_cs.m_b[100] == 100);  // touches the page holding it
+
+        auto tree = pisa::mapper::residency_tree_of(mapped_cs);
+        REQUIRE(tree->size == pisa::mapper::size_of(mapped_cs));
+        REQUIRE(tree->children.size() == 1);
+        auto const& vector_node = *tree->children[0];
+        REQUIRE(vector_node.name == "m_b");
+        REQUIRE(vector_node.resident > 0);
+        REQUIRE(vector_node.resident <= vector_node.size);
+        REQUIRE(tree->resident == vector_node.resident);
+        REQUIRE(
+            pisa::mapper::resident_bytes(mapped_cs.m_b.data(), mapped_cs.m_b.size() * 4)
+            == vector_node.resident);
+    }
+
+    std::remove("temp.bin");
+}
+
+TEST_CASE("residency_snapshot")
+{
+    std::vector<uint32_t> data(1U << 20U);
+    std::iota(data.begin(), data.end(), 0);
+    {
+        std::ofstream os("temp.bin", std::ios::binary);
+        os.write(reinterpret_cast<char const*>(data.data()), data.size() * sizeof(uint32_t));
+    }
+    {
+        mio::mmap_source m("temp.bin");
+        pisa::mapper::byte_ranges hot{{4096, 8192}, {1U << 21U, (1U << 21U) + 100}};
+        pisa::mapper::warmup_ranges(m.data(), m.size(), hot);
+
+        auto resident = pisa::mapper::resident_ranges(m.data(), m.size());
+        REQUIRE(not resident.empty());
+        std::size_t total = 0;
+        for (std::size_t idx = 0; idx < resident.size(); ++idx) {
+            REQUIRE(resident[idx].first < resident[idx].second);
+            REQUIRE(resident[idx].second <= m.size());
+            if (idx > 0) {
+                REQUIRE(resident[idx - 1].second < resident[idx].first);
+            }
+            total += resident[idx].second - resident[idx].first;
+        }
+        REQUIRE(total == pisa::mapper::resident_bytes(m.data(), m.size()));
+        for (auto [begin, end]: hot) {
+            REQUIRE(pisa::mapper::resident_bytes(m.data() + begin, end - begin) == end - begin);
+        }
+
+        pisa::mapper::write_residency_snapshot("temp.snapshot", m.size(), resident);
+        REQUIRE(pisa::mapper::read_residency_snapshot("temp.snapshot", m.size()) == resident);
+        REQUIRE_FALSE(pisa::mapper::read_residency_snapshot("temp.snapshot", m.size() + 1));
+        REQUIRE_FALSE(pisa::mapper::read_residency_snapshot("missing.snapshot", m.size()));
+    }
+    std::remove("temp.bin");
+    std::remove("temp.snapshot");
+}
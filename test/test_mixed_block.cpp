@@ -0,0 +1,28 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "mixed_block.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Select optpfor candidates from bit widths")
+{
+    auto const& possLogs = optpfor_block::codec_type::possLogs;
+    std::vector<uint32_t> values(mixed_block::block_size);
+    std::generate(values.begin(), values.end(), []() { return (uint32_t)rand() % 4; });
+    values[17] = 1000;
+
+    auto all = mixed_block::pfor_candidates(values.data(), values.size(), 0);
+    REQUIRE(all.size() == possLogs.size());
+
+    auto candidates = mixed_block::pfor_candidates(values.data(), values.size(), 2);
+    REQUIRE(candidates.size() == std::min<size_t>(2, possLogs.size()));
+    // A single large value is better stored as an exception than by packing every value on
+    // enough bits to fit it.
+    for (auto param: candidates) {
+        REQUIRE(possLogs[param] < 10);
+    }
+}
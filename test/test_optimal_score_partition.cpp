@@ -0,0 +1,120 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <limits>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include <range/v3/view/zip.hpp>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "optimal_score_partition.hpp"
+#include "pisa_config.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+/// Returns the smallest error of a partition of `scores` into `blocks` blocks of at most
+/// `max_block_size` postings, by trying all of them.
+auto brute_force_error(
+    std::vector<float> const& scores, size_t begin, size_t blocks, size_t max_block_size) -> double
+{
+    if (begin == scores.size()) {
+        return blocks == 0 ? 0.0 : std::numeric_limits<double>::infinity();
+    }
+    if (blocks == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double best = std::numeric_limits<double>::infinity();
+    double max = 0.0;
+    double sum = 0.0;
+    for (size_t end = begin + 1; end <= scores.size() and end - begin <= max_block_size; ++end) {
+        max = std::max<double>(max, scores[end - 1]);
+        sum += scores[end - 1];
+        double error = max * (end - begin) - sum;
+        best = std::min(best, error + brute_force_error(scores, end, blocks - 1, max_block_size));
+    }
+    return best;
+}
+
+TEST_CASE("Optimal score partition of a small list", "[wand_data][unit]")
+{
+    std::vector<float> scores{1, 1, 1, 5, 5, 5, 1, 1};
+    optimal_score_partition partition(scores, 2, 8);
+    REQUIRE(partition.block_ends() == std::vector<uint32_t>{3, 8});
+    REQUIRE(partition.block_max_scores() == std::vector<float>{1, 5});
+    REQUIRE(partition.error() == Approx(8.0));
+
+    SECTION("Block size limit")
+    {
+        optimal_score_partition limited(scores, 2, 3);
+        REQUIRE(limited.block_ends() == std::vector<uint32_t>{3, 6, 8});
+        REQUIRE(limited.error() == Approx(0.0));
+    }
+    SECTION("Empty list")
+    {
+        std::vector<float> empty;
+        REQUIRE(optimal_score_partition(empty, 1, 8).block_ends().empty());
+    }
+}
+
+TEST_CASE("Optimal score partition is optimal for its number of blocks", "[wand_data][unit]")
+{
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> score(0.0, 10.0);
+    auto max_block_size = GENERATE(size_t(3), size_t(12));
+    for (int run = 0; run < 50; ++run) {
+        std::vector<float> scores(12);
+        std::generate(scores.begin(), scores.end(), [&] { return score(gen); });
+        for (size_t max_blocks = 1; max_blocks <= scores.size(); ++max_blocks) {
+            optimal_score_partition partition(scores, max_blocks, max_block_size);
+            auto blocks = partition.block_ends().size();
+            REQUIRE(blocks <= std::max<size_t>(max_blocks, ceil_div(scores.size(), max_block_size)));
+            REQUIRE(partition.block_ends().back() == scores.size());
+            REQUIRE(
+                partition.error()
+                == Approx(brute_force_error(scores, 0, blocks, max_block_size)).margin(1e-4));
+        }
+    }
+}
+
+TEST_CASE("Optimal blocks bound the scores of the collection", "[wand_data][integration]")
+{
+    using WandType = wand_data<wand_data_raw>;
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids;
+    WandType wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(OptimalBlock(16)),
+        false,
+        dropped_term_ids);
+
+    auto scorer = scorer::from_name("bm25", wdata);
+    size_t term_id = 0;
+    for (auto const& seq: collection) {
+        auto w = wdata.getenum(term_id);
+        auto s = scorer->term_scorer(term_id);
+        size_t blocks = 1;
+        uint64_t block_docid = w.docid();
+        for (auto&& [docid, freq]: ranges::views::zip(seq.docs, seq.freqs)) {
+            w.next_geq(docid);
+            if (w.docid() != block_docid) {
+                block_docid = w.docid();
+                blocks += 1;
+            }
+            REQUIRE(docid <= w.docid());
+            REQUIRE(w.score() >= s(docid, freq));
+            REQUIRE(w.score() <= wdata.max_term_weight(term_id));
+        }
+        REQUIRE(blocks <= ceil_div(seq.docs.size(), 16));
+        term_id += 1;
+    }
+}
@@ -0,0 +1,51 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "util/ordered_writer.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Write chunks in order of position")
+{
+    std::ostringstream os;
+    {
+        Ordered_Writer writer(os, 4);
+        writer.push(2, "c\n");
+        writer.push(0, "a\n");
+        writer.push(1, "b\n");
+    }
+    REQUIRE(os.str() == "a\nb\nc\n");
+}
+
+TEST_CASE("Write chunks after missing positions last")
+{
+    std::ostringstream os;
+    Ordered_Writer writer(os);
+    writer.push(3, "d");
+    writer.push(0, "a");
+    writer.close();
+    writer.close();
+    REQUIRE(os.str() == "ad");
+}
+
+TEST_CASE("Write chunks produced concurrently")
+{
+    tbb::task_scheduler_init init(4);
+    std::ostringstream os;
+    Ordered_Writer writer(os, 64, 16);
+    tbb::parallel_for(size_t(0), size_t(10000), [&](size_t idx) {
+        writer.push(idx, std::to_string(idx) + '\n');
+    });
+    writer.close();
+    std::ostringstream expected;
+    for (size_t idx = 0; idx < 10000; ++idx) {
+        expected << idx << '\n';
+    }
+    REQUIRE(os.str() == expected.str());
+}
@@ -0,0 +1,142 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "intersection_cache.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "pair_bounds.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+struct bounded_cursor {
+    float max_weight;
+};
+
+TEST_CASE("Bounds of the term pairs of a query", "[pair_bounds][unit]")
+{
+    pair_bounds::builder builder;
+    builder.add_pair({3, 2}, 4.5);
+    builder.add_pair({1, 4}, 1.0);
+    pair_bounds bounds;
+    builder.build(bounds);
+    REQUIRE(bounds.size() == 2);
+    REQUIRE(bounds.find(2, 3) == 4.5);
+    REQUIRE(bounds.find(3, 2) == 4.5);
+    REQUIRE_FALSE(bounds.find(1, 2));
+
+    std::vector<bounded_cursor> cursors{{2.0}, {3.0}, {4.0}};
+    query_pair_bounds pairs(bounds, Query{std::nullopt, {3, 1, 2}, {}}, cursors);
+    REQUIRE(pairs.pair(0, 1) == 5.0);
+    REQUIRE(pairs.pair(1, 2) == 4.5);
+    REQUIRE(pairs.pair(2, 1) == 4.5);
+    REQUIRE(pairs.prefix_upper_bounds({0, 1, 2}) == std::vector<float>{2.0, 5.0, 6.5});
+    REQUIRE(pairs.prefix_upper_bounds({1, 2, 0}) == std::vector<float>{3.0, 4.5, 6.5});
+
+    SECTION("A pair never bounds tighter than its terms")
+    {
+        std::vector<bounded_cursor> weighted{{2.0}, {8.0}};
+        query_pair_bounds pairs(bounds, Query{std::nullopt, {1, 4, 4}, {}}, weighted);
+        REQUIRE(pairs.pair(0, 1) == 8.0);
+    }
+    SECTION("Cursors must match the query")
+    {
+        REQUIRE_THROWS_AS(
+            query_pair_bounds(bounds, Query{std::nullopt, {1, 2}, {}}, cursors),
+            std::invalid_argument);
+    }
+}
+
+TEST_CASE("WAND and MaxScore with term-pair bounds", "[pair_bounds][query][integration]")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+
+    global_parameters params;
+    block_interpolative_index index;
+    block_interpolative_index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+    pair_bounds::builder bounds_builder;
+    size_t tighter = 0;
+    for (auto pair: intersection_cache::select_pairs(queries, 100)) {
+        auto scores = intersection_cache::intersect(index, scorer, pair).second;
+        float max_score = scores.empty() ? 0.0F : *std::max_element(scores.begin(), scores.end());
+        if (max_score < wdata.max_term_weight(pair.first) + wdata.max_term_weight(pair.second)) {
+            tighter += 1;
+        }
+        bounds_builder.add_pair(pair, max_score);
+    }
+    REQUIRE(tighter > 0);
+    pair_bounds built;
+    bounds_builder.build(built);
+    Temporary_Directory tmpdir;
+    auto bounds_path = (tmpdir.path() / "pairs").string();
+    mapper::freeze(built, bounds_path.c_str());
+    pair_bounds bounds;
+    mio::mmap_source source(bounds_path.c_str());
+    mapper::map(bounds, source);
+    REQUIRE(bounds.size() == 100);
+
+    auto require_same_results = [](auto const& expected, auto const& actual) {
+        REQUIRE(expected.size() == actual.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE(expected[i].first == Approx(actual[i].first));
+        }
+    };
+
+    for (auto const& query: queries) {
+        topk_queue expected(10);
+        ranked_or_query ranked_or_q(expected);
+        ranked_or_q(make_scored_cursors(index, scorer, query), index.num_docs());
+        expected.finalize();
+
+        {
+            topk_queue topk(10);
+            wand_query wand_q(topk);
+            auto cursors = make_max_scored_cursors(index, wdata, scorer, query);
+            wand_q(cursors, index.num_docs(), query_pair_bounds(bounds, query, cursors));
+            topk.finalize();
+            require_same_results(expected.topk(), topk.topk());
+        }
+        {
+            topk_queue topk(10);
+            maxscore_query maxscore_q(topk);
+            auto cursors = make_max_scored_cursors(index, wdata, scorer, query);
+            maxscore_q(cursors, index.num_docs(), query_pair_bounds(bounds, query, cursors));
+            topk.finalize();
+            require_same_results(expected.topk(), topk.topk());
+        }
+    }
+}
@@ -230,6 +230,22 @@ TEST_CASE("partition_fwd_index", "[invert][integration]")
                     REQUIRE(actual_titles == expected_titles);
                 }
             }
+            AND_THEN("Shard lexicons match their terms and titles")
+            {
+                for (auto shard_id: shard_ids) {
+                    auto basename = fmt::format("{}.{:03d}", output_basename, shard_id.as_int());
+                    auto term_buffer = Payload_Vector_Buffer::from_file(basename + ".termlex");
+                    auto term_lexicon = Payload_Vector<std::string>(term_buffer);
+                    REQUIRE(
+                        std::vector<std::string>(term_lexicon.begin(), term_lexicon.end())
+                        == io::read_string_vector(basename + ".terms"));
+                    auto doc_buffer = Payload_Vector_Buffer::from_file(basename + ".doclex");
+                    auto doc_lexicon = Payload_Vector<std::string>(doc_buffer);
+                    REQUIRE(
+                        std::vector<std::string>(doc_lexicon.begin(), doc_lexicon.end())
+                        == io::read_string_vector(basename + ".documents"));
+                }
+            }
             AND_THEN("Documents are identical wrt terms")
             {
                 auto full = binary_collection(fwd_basename.c_str());
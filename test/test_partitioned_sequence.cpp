@@ -43,11 +43,11 @@ class partitioned_sequence_test {
 };
 }  // namespace pisa
 
-template <typename BaseSequence>
+template <typename BaseSequence, bool SkipDirectory = false>
 void test_partitioned_sequence(uint64_t universe, std::vector<uint64_t> const& seq)
 {
     pisa::global_parameters params;
-    typedef pisa::partitioned_sequence<BaseSequence> sequence_type;
+    typedef pisa::partitioned_sequence<BaseSequence, SkipDirectory> sequence_type;
 
     pisa::bit_vector_builder bvb;
     sequence_type::write(bvb, seq.begin(), universe, seq.size(), params);
@@ -82,6 +82,8 @@ TEST_CASE("partitioned_sequence")
         auto seq = random_sequence(universe, n, true);
         test_partitioned_sequence<indexed_sequence>(universe, seq);
         test_partitioned_sequence<strict_sequence>(universe, seq);
+        test_partitioned_sequence<indexed_sequence, true>(universe, seq);
+        test_partitioned_sequence<strict_sequence, true>(universe, seq);
     }
 
     // test also short (singleton partition) sequences with large universe
@@ -93,5 +95,14 @@ TEST_CASE("partitioned_sequence")
             v += initial_gap;
         test_partitioned_sequence<indexed_sequence>(universe, short_seq);
         test_partitioned_sequence<strict_sequence>(universe, short_seq);
+        test_partitioned_sequence<indexed_sequence, true>(universe, short_seq);
+    }
+
+    // long sequences, spanning many groups of the skip directory
+    for (auto avg_gap: {1.5, 20.0}) {
+        uint64_t n = 200000;
+        uint64_t universe = uint64_t(n * avg_gap);
+        auto seq = random_sequence(universe, n, true);
+        test_partitioned_sequence<indexed_sequence, true>(universe, seq);
     }
 }
@@ -0,0 +1,75 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "util/do_not_optimize_away.hpp"
+#include "util/perf_counters.hpp"
+
+using namespace pisa;
+
+namespace {
+
+/// Collects the pairs of a `stats_line` instead of printing them.
+struct recording_line {
+    std::map<std::string, double> values;
+
+    template <typename T>
+    auto operator()(char const* key, T value) -> recording_line&
+    {
+        values[key] = static_cast<double>(value);
+        return *this;
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Add and subtract samples of hardware events", "[perf]")
+{
+    perf_sample earlier;
+    perf_sample later;
+    for (std::size_t event = 0; event < perf_event_count; ++event) {
+        earlier.counts[event] = 10 * event;
+        later.counts[event] = 100 * event;
+    }
+    later.counts[static_cast<std::size_t>(perf_event::cycles)] = 400;
+    earlier.counts[static_cast<std::size_t>(perf_event::cycles)] = 200;
+
+    auto difference = later - earlier;
+    REQUIRE(difference[perf_event::cycles] == 200);
+    REQUIRE(difference[perf_event::instructions] == 90);
+    REQUIRE(difference[perf_event::branch_misses] == 450);
+    // Extrapolated counts of multiplexed events may go backwards.
+    REQUIRE((earlier - later)[perf_event::instructions] == 0);
+
+    auto sum = difference;
+    sum += difference;
+    REQUIRE(sum[perf_event::llc_misses] == 2 * difference[perf_event::llc_misses]);
+
+    recording_line line;
+    difference.dump(line, 2);
+    REQUIRE(line.values.at("cycles") == Approx(100));
+    REQUIRE(line.values.at("instructions") == Approx(45));
+    REQUIRE(line.values.at("ipc") == Approx(90.0 / 200));
+}
+
+TEST_CASE("Count the hardware events of the calling thread", "[perf]")
+{
+    perf_counters counters;
+    auto before = counters.read();
+    std::uint64_t sum = 0;
+    for (std::uint64_t value = 0; value < 1'000'000; ++value) {
+        sum += value * value;
+    }
+    do_not_optimize_away(sum);
+    auto events = counters.read() - before;
+    // Counting may be forbidden where the tests run, but counted events do not go unseen.
+    if (counters.counts(perf_event::instructions)) {
+        REQUIRE(events[perf_event::instructions] > 0);
+    }
+    if (not counters.available()) {
+        REQUIRE(events[perf_event::cycles] == 0);
+    }
+}
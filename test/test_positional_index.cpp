@@ -0,0 +1,83 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "block_freq_index.hpp"
+#include "codec/simdbp.hpp"
+#include "positional_index.hpp"
+#include "query/algorithm/phrase_query.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Positions are decoded block by block", "[positional_index]")
+{
+    uint64_t n = 3 * simdbp_block::block_size + 17;
+    std::vector<uint32_t> freqs;
+    std::vector<uint32_t> positions;
+    for (uint64_t posting = 0; posting < n; ++posting) {
+        uint32_t freq = posting % 5 + 1;
+        freqs.push_back(freq);
+        for (uint32_t occurrence = 0; occurrence < freq; ++occurrence) {
+            positions.push_back(posting % 7 + occurrence * (posting % 3 + 1));
+        }
+    }
+    positional_index<simdbp_block>::builder builder;
+    builder.add_list(n, freqs.begin(), positions.begin());
+    builder.add_list(1, freqs.begin(), positions.begin());
+    positional_index<simdbp_block> index;
+    builder.build(index);
+    REQUIRE(index.size() == 2);
+
+    auto list = index[0];
+    REQUIRE(list.size() == n);
+    // read backwards, so that every block is decoded again
+    std::vector<std::vector<uint32_t>> decoded(n);
+    for (uint64_t posting = n; posting > 0; --posting) {
+        auto span = list.positions(posting - 1);
+        decoded[posting - 1].assign(span.begin(), span.end());
+    }
+    auto expected = positions.begin();
+    for (uint64_t posting = 0; posting < n; ++posting) {
+        REQUIRE(decoded[posting].size() == freqs[posting]);
+        for (auto position: decoded[posting]) {
+            REQUIRE(position == *expected++);
+        }
+    }
+    auto single = index[1].positions(0);
+    REQUIRE(std::vector<uint32_t>(single.begin(), single.end()) == std::vector<uint32_t>{0});
+}
+
+TEST_CASE("Phrase queries verify the positions of conjunctive candidates", "[positional_index]")
+{
+    // documents: 0 = "a b c", 1 = "b a c a b", 2 = "a c b", 3 = "c"
+    std::vector<std::vector<uint64_t>> docs{{0, 1, 2}, {0, 1, 2}, {0, 1, 2, 3}};
+    std::vector<std::vector<uint64_t>> freqs{{1, 2, 1}, {1, 2, 1}, {1, 1, 1, 1}};
+    std::vector<std::vector<uint32_t>> positions{{0, 1, 3, 0}, {1, 0, 4, 2}, {2, 2, 1, 0}};
+
+    global_parameters params;
+    block_freq_index<simdbp_block>::builder index_builder(4, params);
+    positional_index<simdbp_block>::builder positions_builder;
+    for (std::size_t term = 0; term < docs.size(); ++term) {
+        index_builder.add_posting_list(
+            docs[term].size(), docs[term].begin(), freqs[term].begin(), 0);
+        positions_builder.add_list(
+            freqs[term].size(), freqs[term].begin(), positions[term].begin());
+    }
+    block_freq_index<simdbp_block> index;
+    index_builder.build(index);
+    positional_index<simdbp_block> positional;
+    positions_builder.build(positional);
+
+    auto phrase = [&](std::vector<uint32_t> terms) {
+        Query query{{}, terms, {}};
+        return phrase_query{}(index, positional, query);
+    };
+    REQUIRE(phrase({0, 1}) == std::vector<uint32_t>{0, 1});
+    REQUIRE(phrase({1, 0}) == std::vector<uint32_t>{1});
+    REQUIRE(phrase({0, 1, 2}) == std::vector<uint32_t>{0});
+    REQUIRE(phrase({0, 2}) == std::vector<uint32_t>{1, 2});
+    REQUIRE(phrase({0, 2, 0}) == std::vector<uint32_t>{1});
+    REQUIRE(phrase({2, 1}) == std::vector<uint32_t>{2});
+}
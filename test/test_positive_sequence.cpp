@@ -35,6 +35,15 @@ void test_positive_sequence()
         MY_REQUIRE_EQUAL(i, val.first, "i = " << i);
         MY_REQUIRE_EQUAL(values[i], val.second, "i = " << i);
     }
+
+    // decode runs, both right after the previous one and after a jump
+    std::vector<uint64_t> run(100);
+    for (size_t i = 0; i + run.size() <= n; i += run.size() + (i % 3 == 0 ? 0 : 7)) {
+        r.decode(i, run);
+        for (size_t j = 0; j < run.size(); ++j) {
+            MY_REQUIRE_EQUAL(values[i + j], run[j], "i = " << i << " j = " << j);
+        }
+    }
 }
 
 TEST_CASE("positive_sequence")
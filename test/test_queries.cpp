@@ -3,6 +3,7 @@
 #include <catch2/catch.hpp>
 
 #include "query/algorithm.hpp"
+#include "query/warmup.hpp"
 #include "temporary_directory.hpp"
 
 using namespace pisa;
@@ -23,6 +24,46 @@ TEST_CASE("Parse query term ids with query id")
     REQUIRE(q.terms == std::vector<std::uint32_t>{1, 2, 3, 4});
 }
 
+TEST_CASE("Parse query term ids from a view")
+{
+    std::string line = "q1:7,8\t9 10\n";
+    auto q = parse_query_ids(std::string_view(line).substr(0, line.size() - 1));
+    REQUIRE(q.id == "q1");
+    REQUIRE(q.terms == std::vector<std::uint32_t>{7, 8, 9, 10});
+    REQUIRE(parse_query_ids("").terms.empty());
+    REQUIRE(parse_query_ids("2:").terms.empty());
+}
+
+TEST_CASE("Parse weighted query term ids")
+{
+    auto q = parse_query_ids("q1:1^0.5 2,3^2 1");
+    REQUIRE(q.terms == std::vector<std::uint32_t>{1, 2, 3, 1});
+    REQUIRE(q.term_weights == std::vector<float>{0.5, 1, 2, 1});
+    REQUIRE(parse_query_ids("1 2").term_weights.empty());
+}
+
+TEST_CASE("Sum the weights of repeated query terms")
+{
+    REQUIRE(query_weights(Query{{}, {3, 1, 3}, {}}) == term_weight_vec{{1, 1.0F}, {3, 2.0F}});
+    REQUIRE(
+        query_weights(Query{{}, {3, 1, 3}, {0.25, 2.0, 0.5}})
+        == term_weight_vec{{1, 2.0F}, {3, 0.75F}});
+    query_arena arena;
+    auto weights = query_weights(Query{{}, {3, 1, 3}, {0.25, 2.0, 0.5}}, arena);
+    REQUIRE(
+        term_weight_vec(weights.begin(), weights.end())
+        == term_weight_vec{{1, 2.0F}, {3, 0.75F}});
+    REQUIRE_THROWS_AS(query_weights(Query{{}, {3, 1}, {0.5}}), std::invalid_argument);
+}
+
+TEST_CASE("Rank the terms of a query log by frequency")
+{
+    std::vector<Query> queries{{{}, {3, 1}, {}}, {{}, {2, 3}, {}}, {{}, {1, 3, 4}, {}}};
+    REQUIRE(query_log_terms(queries) == std::vector<term_id_type>{3, 1, 2, 4});
+    REQUIRE(query_log_terms(queries, 2) == std::vector<term_id_type>{3, 1});
+    REQUIRE(query_log_terms(queries, 10).size() == 4);
+}
+
 TEST_CASE("Compute parsing function")
 {
     Temporary_Directory tmpdir;
@@ -61,6 +102,12 @@ TEST_CASE("Compute parsing function")
             REQUIRE(queries[0].terms == std::vector<term_id_type>{2, 4});
             REQUIRE(queries[0].term_weights == std::vector<float>{});
         }
+        THEN("Parse term weights")
+        {
+            parse("1:a^3 he^0.5  usa");
+            REQUIRE(queries[0].terms == std::vector<term_id_type>{2, 4});
+            REQUIRE(queries[0].term_weights == std::vector<float>{0.5, 1});
+        }
     }
     WHEN("With terms, stopwords, and stemmer")
     {
@@ -134,3 +181,58 @@ TEST_CASE("Check if term is stopword")
     REQUIRE(!tprocessor.is_stopword(4));
     REQUIRE(!tprocessor.is_stopword(5));
 }
+
+TEST_CASE("Term processor caches term IDs of repeated tokens")
+{
+    Temporary_Directory tmpdir;
+    auto lexfile = tmpdir.path() / "lex";
+    encode_payload_vector(
+        gsl::make_span(std::vector<std::string>{"account", "coffee", "he", "she", "usa", "world"}))
+        .to_file(lexfile.string());
+
+    TermProcessor tprocessor(std::make_optional(lexfile.string()), std::nullopt, std::nullopt);
+    auto copy = tprocessor;
+    REQUIRE(tprocessor("Coffee") == std::optional<term_id_type>{1});
+    REQUIRE(copy("Coffee") == std::optional<term_id_type>{1});
+    REQUIRE(tprocessor("tea") == std::nullopt);
+    REQUIRE(tprocessor("tea") == std::nullopt);
+    REQUIRE(tprocessor.cache().hits() == 2);
+    REQUIRE(tprocessor.cache().misses() == 2);
+
+    TermProcessor uncached(std::make_optional(lexfile.string()), std::nullopt, std::nullopt, 0);
+    REQUIRE(uncached("World") == std::optional<term_id_type>{5});
+    REQUIRE(uncached.cache().hits() + uncached.cache().misses() == 0);
+}
+
+TEST_CASE("Term processor looks up terms with the lexicon hash")
+{
+    Temporary_Directory tmpdir;
+    auto lexfile = (tmpdir.path() / "lex").string();
+    std::vector<std::string> terms{"account", "coffee", "he", "she", "usa", "world"};
+    auto lexicon = encode_payload_vector(gsl::make_span(terms));
+    lexicon.to_file(lexfile);
+    Lexicon_Hash_Buffer::build(Payload_Vector<>(lexicon)).to_file(lexicon_hash_filename(lexfile));
+
+    TermProcessor tprocessor(std::make_optional(lexfile), std::nullopt, std::nullopt);
+    for (std::size_t term_id = 0; term_id < terms.size(); ++term_id) {
+        REQUIRE(tprocessor(terms[term_id]) == std::optional<term_id_type>(term_id));
+    }
+    REQUIRE(tprocessor("tea") == std::nullopt);
+    REQUIRE(tprocessor("zzz") == std::nullopt);
+}
+
+TEST_CASE("Term processor looks up terms in a front-coded lexicon")
+{
+    Temporary_Directory tmpdir;
+    auto lexfile = (tmpdir.path() / "lex").string();
+    std::vector<std::string> terms{"account", "coffee", "he", "she", "usa", "world"};
+    encode_front_coded_vector(terms.begin(), terms.end(), 4).to_file(lexfile);
+
+    TermProcessor tprocessor(std::make_optional(lexfile), std::nullopt, std::nullopt);
+    for (std::size_t term_id = 0; term_id < terms.size(); ++term_id) {
+        REQUIRE(tprocessor(terms[term_id]) == std::optional<term_id_type>(term_id));
+    }
+    REQUIRE(tprocessor("a") == std::nullopt);
+    REQUIRE(tprocessor("tea") == std::nullopt);
+    REQUIRE(tprocessor("zzz") == std::nullopt);
+}
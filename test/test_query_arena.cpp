@@ -0,0 +1,48 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "util/query_arena.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Arena allocations are aligned and reused after a reset", "[query_arena]")
+{
+    query_arena arena(256);
+    auto* first = arena.allocate(3, 1);
+    auto* second = arena.allocate(sizeof(uint64_t), alignof(uint64_t));
+    REQUIRE(reinterpret_cast<std::uintptr_t>(second) % alignof(uint64_t) == 0);
+    REQUIRE(second != first);
+    REQUIRE(arena.capacity() == 256);
+
+    auto* large = arena.allocate(1000, 16);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(large) % 16 == 0);
+    auto capacity = arena.capacity();
+    REQUIRE(capacity > 256);
+
+    arena.reset();
+    REQUIRE(arena.allocate(3, 1) == first);
+    REQUIRE(arena.allocate(1000, 16) != nullptr);
+    REQUIRE(arena.capacity() == capacity);
+}
+
+TEST_CASE("Arena vectors grow within the arena", "[query_arena]")
+{
+    query_arena arena;
+    std::size_t capacity = 0;
+    for (int query = 0; query < 3; ++query) {
+        query_arena::scope scope(arena);
+        arena_vector<uint32_t> values{arena_allocator<uint32_t>(arena)};
+        for (uint32_t value = 0; value < 1000; ++value) {
+            values.push_back(value);
+        }
+        REQUIRE(values.size() == 1000);
+        REQUIRE(values.back() == 999);
+        if (query == 0) {
+            capacity = arena.capacity();
+        }
+        REQUIRE(arena.capacity() == capacity);
+    }
+}
@@ -0,0 +1,94 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "query/query_planner.hpp"
+
+using namespace pisa;
+
+auto features(std::size_t terms, std::uint64_t shortest_list, std::uint64_t postings)
+    -> query_features
+{
+    query_features f;
+    f.terms = terms;
+    f.shortest_list = shortest_list;
+    f.postings = postings;
+    f.max_score = 10;
+    f.min_term_max_score = 4;
+    return f;
+}
+
+TEST_CASE("Planner picks a disjunctive algorithm from the cost model")
+{
+    query_planner planner;
+    REQUIRE(planner.disjunctive(features(2, 100, 1000)) == planned_algorithm::ranked_or_taat);
+    REQUIRE(planner.disjunctive(features(2, 50'000, 100'000)) == planned_algorithm::block_max_wand);
+    REQUIRE(
+        planner.disjunctive(features(6, 10'000, 100'000)) == planned_algorithm::block_max_maxscore);
+    REQUIRE(planner.disjunctive(features(100, 10, 100'000)) == planned_algorithm::long_maxscore);
+    REQUIRE(planner.disjunctive(features(100, 10, 1000)) == planned_algorithm::ranked_or_taat);
+}
+
+TEST_CASE("Planner processes long queries score-at-a-time if stored in impact order")
+{
+    query_planner planner;
+    auto f = features(2, 500'000, 2'000'000);
+    REQUIRE(planner.disjunctive(f) == planned_algorithm::block_max_wand);
+    f.impact_ordered = true;
+    REQUIRE(planner.disjunctive(f) == planned_algorithm::impact_saat);
+    auto g = features(2, 1000, 4000);
+    g.impact_ordered = true;
+    REQUIRE(planner.disjunctive(g) == planned_algorithm::ranked_or_taat);
+    REQUIRE(planned_algorithm_name(planned_algorithm::impact_saat) == "impact_saat");
+}
+
+TEST_CASE("Planner tries the intersection first for selective or high-threshold queries")
+{
+    query_planner planner;
+    REQUIRE_FALSE(planner.conjunctive_first(features(1, 10, 10)));
+    REQUIRE_FALSE(planner.conjunctive_first(features(2, 40'000, 100'000)));
+    REQUIRE(planner.conjunctive_first(features(2, 100, 1'000'000)));
+
+    auto f = features(2, 40'000, 100'000);
+    f.threshold = 7;
+    REQUIRE(planner.conjunctive_first(f));
+    f.threshold = 5;
+    REQUIRE_FALSE(planner.conjunctive_first(f));
+}
+
+TEST_CASE("Planner keeps the intersection only if it is safe")
+{
+    query_planner planner;
+    auto f = features(2, 100, 1'000'000);
+    std::vector<planned_algorithm> runs;
+
+    WHEN("The intersection fills the top-k above the score of partial matches")
+    {
+        topk_queue topk(2);
+        auto algorithm = planner.execute(f, topk, [&](planned_algorithm choice) {
+            runs.push_back(choice);
+            topk.insert(8, 1);
+            topk.insert(7, 2);
+        });
+        REQUIRE(algorithm == planned_algorithm::block_max_ranked_and);
+        REQUIRE(runs == std::vector<planned_algorithm>{planned_algorithm::block_max_ranked_and});
+        REQUIRE(topk.topk().size() == 2);
+    }
+    WHEN("A partial match could outscore the intersection")
+    {
+        topk_queue topk(2);
+        auto algorithm = planner.execute(f, topk, [&](planned_algorithm choice) {
+            runs.push_back(choice);
+            topk.insert(8, 1);
+            topk.insert(5, 2);
+        });
+        REQUIRE(algorithm == planned_algorithm::block_max_wand);
+        REQUIRE(
+            runs
+            == std::vector<planned_algorithm>{
+                planned_algorithm::block_max_ranked_and, planned_algorithm::block_max_wand});
+        REQUIRE(topk.topk().size() == 2);
+    }
+}
@@ -0,0 +1,104 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "query/query_trace.hpp"
+#include "topk_queue.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto block_event(std::uint64_t nanoseconds, std::uint32_t term, std::uint32_t block, bool freqs)
+    -> trace_event
+{
+    trace_event event;
+    event.type = freqs ? trace_event::kind::freqs_block : trace_event::kind::docs_block;
+    event.nanoseconds = nanoseconds;
+    event.term = term;
+    event.block = block;
+    return event;
+}
+
+auto threshold_event(std::uint64_t nanoseconds, float threshold) -> trace_event
+{
+    trace_event event;
+    event.type = trace_event::kind::threshold;
+    event.nanoseconds = nanoseconds;
+    event.threshold = threshold;
+    return event;
+}
+
+}  // namespace
+
+TEST_CASE("Write and read trace files", "[trace]")
+{
+    trace_header header{"block_max_wand", "block_simdbp", 10};
+    std::vector<query_trace> traces(3);
+    traces[0].id = "101";
+    traces[0].terms = {3, 1, 300000};
+    traces[0].nanoseconds = 123456;
+    traces[0].events = {
+        block_event(10, 3, 0, false),
+        block_event(250, 3, 0, true),
+        threshold_event(300, 1.5),
+        block_event(1U << 20U, 300000, 4000, false),
+        threshold_event(1U << 21U, 7.25)};
+    traces[1].terms = {5};
+    traces[2].id = "";
+
+    std::stringstream buffer;
+    query_trace_file::write(buffer, header, traces);
+    auto [read_header, read_traces] = query_trace_file::read(buffer);
+    REQUIRE(read_header.algorithm == header.algorithm);
+    REQUIRE(read_header.encoding == header.encoding);
+    REQUIRE(read_header.k == header.k);
+    REQUIRE(read_traces == traces);
+
+    SECTION("Truncated files are rejected")
+    {
+        auto bytes = buffer.str();
+        std::istringstream truncated(bytes.substr(0, bytes.size() - 3));
+        REQUIRE_THROWS_AS(query_trace_file::read(truncated), std::invalid_argument);
+        std::istringstream other("PISAQRY1");
+        REQUIRE_THROWS_AS(query_trace_file::read(other), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Record the events of a query", "[trace]")
+{
+    query_trace trace;
+    trace.events.push_back(threshold_event(0, 1));
+
+    // Nothing is recorded outside of a traced query.
+    query_tracer::decoded_block(1, 2, false);
+    query_tracer::local().start(trace);
+    REQUIRE(trace.events.empty());
+
+    query_tracer::decoded_block(1, 2, false);
+    query_tracer::decoded_block(1, 2, true);
+    topk_queue topk(2);
+    traced_query_stats::insert(topk, 1.0F, 0);
+    traced_query_stats::insert(topk, 3.0F, 1);
+    traced_query_stats::insert(topk, 2.0F, 2);
+    traced_query_stats::insert(topk, 0.5F, 3);
+    query_tracer::local().finish();
+    query_tracer::decoded_block(4, 5, false);
+
+    REQUIRE(trace.events.size() == 4);
+    REQUIRE(trace.events[0].type == trace_event::kind::docs_block);
+    REQUIRE(trace.events[0].term == 1);
+    REQUIRE(trace.events[0].block == 2);
+    REQUIRE(trace.events[1].type == trace_event::kind::freqs_block);
+    REQUIRE(trace.events[2].type == trace_event::kind::threshold);
+    REQUIRE(trace.events[2].threshold == Approx(1.0));
+    REQUIRE(trace.events[3].type == trace_event::kind::threshold);
+    REQUIRE(trace.events[3].threshold == Approx(2.0));
+    for (std::size_t idx = 1; idx < trace.events.size(); ++idx) {
+        REQUIRE(trace.events[idx - 1].nanoseconds <= trace.events[idx].nanoseconds);
+    }
+    REQUIRE(trace.events.back().nanoseconds <= trace.nanoseconds);
+}
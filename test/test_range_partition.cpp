@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "range_partition.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Docid ranges are balanced by postings", "[range_partition]")
+{
+    std::vector<std::uint64_t> histogram{10, 0, 0, 50, 5, 5, 5, 5, 20, 0};
+    auto ranges = balanced_docid_ranges(histogram, 10, 95, 3);
+    REQUIRE(ranges.size() == 3);
+    REQUIRE(ranges[0].begin == 0);
+    REQUIRE(ranges[0].end == 30);
+    REQUIRE(ranges[1].begin == 30);
+    REQUIRE(ranges[1].end == 50);
+    REQUIRE(ranges[2].begin == 50);
+    REQUIRE(ranges[2].end == 95);
+
+    // every range gets a bucket as long as there are enough of them
+    ranges = balanced_docid_ranges(histogram, 10, 95, 10);
+    for (std::size_t part = 0; part < ranges.size(); ++part) {
+        REQUIRE(ranges[part].end > ranges[part].begin);
+    }
+    REQUIRE(ranges.back().end == 95);
+    REQUIRE_THROWS_AS(balanced_docid_ranges(histogram, 10, 95, 0), std::invalid_argument);
+}
+
+TEST_CASE("Partitioned docid ranges hold all postings", "[range_partition]")
+{
+    std::string input(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    Temporary_Directory tmpdir;
+    auto output = (tmpdir.path() / "ranges").string();
+    binary_freq_collection collection(input.c_str());
+    auto num_docs = collection.num_docs();
+
+    auto terms_filename = (tmpdir.path() / "terms").string();
+    {
+        std::ofstream os(terms_filename);
+        for (std::size_t term = 0; term < collection.size(); ++term) {
+            os << "term" << term << '\n';
+        }
+    }
+
+    auto histogram = postings_histogram(collection, 16);
+    std::uint64_t postings = 0;
+    for (auto const& list: collection) {
+        postings += list.docs.size();
+    }
+    REQUIRE(std::accumulate(histogram.begin(), histogram.end(), std::uint64_t(0)) == postings);
+
+    std::size_t parts = 4;
+    auto ranges = balanced_docid_ranges(histogram, 16, num_docs, parts);
+    partition_docid_ranges(input, output, ranges, terms_filename);
+
+    std::vector<std::vector<std::uint32_t>> docs(collection.size());
+    std::vector<std::vector<std::uint32_t>> freqs(collection.size());
+    binary_collection sizes((input + ".sizes").c_str());
+    auto document_sizes = *sizes.begin();
+    for (std::size_t part = 0; part < parts; ++part) {
+        auto basename = fmt::format("{}.{:03d}", output, part);
+        binary_freq_collection range(basename.c_str());
+        REQUIRE(range.num_docs() == ranges[part].end - ranges[part].begin);
+        std::vector<std::string> terms;
+        std::ifstream is(basename + ".terms");
+        io::for_each_line(is, [&](auto const& term) { terms.push_back(term); });
+
+        std::uint64_t range_postings = 0;
+        bool valid_lists = true;
+        auto term = terms.begin();
+        for (auto const& list: range) {
+            REQUIRE(term != terms.end());
+            auto id = std::stoul(term->substr(4));
+            valid_lists = valid_lists && list.docs.size() > 0
+                && list.docs.back() < range.num_docs();
+            for (auto docid: list.docs) {
+                docs[id].push_back(docid + ranges[part].begin);
+            }
+            freqs[id].insert(freqs[id].end(), list.freqs.begin(), list.freqs.end());
+            range_postings += list.docs.size();
+            ++term;
+        }
+        REQUIRE(term == terms.end());
+        REQUIRE(valid_lists);
+        // no range is more than a bucket of postings away from its share
+        auto share = static_cast<double>(postings) / parts;
+        auto max_bucket = *std::max_element(histogram.begin(), histogram.end());
+        REQUIRE(std::abs(static_cast<double>(range_postings) - share) <= max_bucket);
+
+        binary_collection range_sizes((basename + ".sizes").c_str());
+        auto part_sizes = *range_sizes.begin();
+        REQUIRE(part_sizes.size() == range.num_docs());
+        REQUIRE(std::equal(
+            part_sizes.begin(), part_sizes.end(), document_sizes.begin() + ranges[part].begin));
+    }
+
+    std::size_t term = 0;
+    for (auto const& list: collection) {
+        REQUIRE(std::equal(
+            list.docs.begin(), list.docs.end(), docs[term].begin(), docs[term].end()));
+        REQUIRE(std::equal(
+            list.freqs.begin(), list.freqs.end(), freqs[term].begin(), freqs[term].end()));
+        ++term;
+    }
+
+    std::ifstream shards(output + ".shards", std::ios::binary);
+    std::vector<std::uint32_t> document_shards(num_docs);
+    shards.read(
+        reinterpret_cast<char*>(document_shards.data()), num_docs * sizeof(std::uint32_t));
+    REQUIRE(shards.gcount() == static_cast<std::streamsize>(num_docs * sizeof(std::uint32_t)));
+    for (std::size_t part = 0; part < parts; ++part) {
+        REQUIRE(document_shards[ranges[part].begin] == part);
+        REQUIRE(document_shards[ranges[part].end - 1] == part);
+    }
+}
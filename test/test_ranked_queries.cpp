@@ -2,17 +2,23 @@
 
 #include <catch2/catch.hpp>
 #include <functional>
+#include <set>
+#include <unordered_map>
 
 #include <tbb/task_scheduler_init.h>
 
 #include "accumulator/lazy_accumulator.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "pisa_config.hpp"
 #include "query/algorithm.hpp"
+#include "query/docid_range.hpp"
+#include "query/rescore.hpp"
 #include "test_common.hpp"
+#include "wand_data_range.hpp"
 
 using namespace pisa;
 
@@ -86,6 +92,19 @@ class ranked_or_taat_query_acc: public ranked_or_taat_query {
     }
 };
 
+template <typename Acc>
+class windowed_taat_query_128: public windowed_taat_query {
+  public:
+    explicit windowed_taat_query_128(topk_queue& topk) : windowed_taat_query(topk, 128) {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        Acc accumulator(128);
+        windowed_taat_query::operator()(cursors, max_docid, accumulator);
+    }
+};
+
 template <typename T>
 class range_query_128: public range_query<T> {
   public:
@@ -98,21 +117,43 @@ class range_query_128: public range_query<T> {
     }
 };
 
+template <typename T>
+class parallel_range_query_128: public parallel_range_query<T> {
+  public:
+    using parallel_range_query<T>::parallel_range_query;
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        parallel_range_query<T>::operator()(cursors, max_docid, 128);
+    }
+};
+
 TEMPLATE_TEST_CASE(
     "Ranked query test",
     "[query][ranked][integration]",
     ranked_or_taat_query_acc<Simple_Accumulator>,
     ranked_or_taat_query_acc<Lazy_Accumulator<4>>,
+    windowed_taat_query_128<Simple_Accumulator>,
+    windowed_taat_query_128<Lazy_Accumulator<4>>,
     wand_query,
     maxscore_query,
+    long_maxscore_query,
     block_max_wand_query,
     block_max_maxscore_query,
+    dynamic_block_max_maxscore_query,
     range_query_128<ranked_or_taat_query_acc<Simple_Accumulator>>,
     range_query_128<ranked_or_taat_query_acc<Lazy_Accumulator<4>>>,
     range_query_128<wand_query>,
     range_query_128<maxscore_query>,
     range_query_128<block_max_wand_query>,
-    range_query_128<block_max_maxscore_query>)
+    range_query_128<block_max_maxscore_query>,
+    range_query_128<dynamic_block_max_maxscore_query>,
+    parallel_range_query_128<ranked_or_taat_query_acc<Simple_Accumulator>>,
+    parallel_range_query_128<wand_query>,
+    parallel_range_query_128<maxscore_query>,
+    parallel_range_query_128<block_max_wand_query>,
+    parallel_range_query_128<block_max_maxscore_query>)
 {
     for (auto quantized: {false, true}) {
         for (auto&& s_name: {"bm25", "qld"}) {
@@ -145,6 +186,46 @@ TEMPLATE_TEST_CASE(
     }
 }
 
+TEMPLATE_TEST_CASE(
+    "Queries restricted to a docid range",
+    "[query][ranked][integration]",
+    ranked_or_taat_query_acc<Simple_Accumulator>,
+    windowed_taat_query_128<Simple_Accumulator>,
+    wand_query,
+    maxscore_query,
+    long_maxscore_query,
+    block_max_wand_query,
+    block_max_maxscore_query,
+    dynamic_block_max_maxscore_query)
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    docid_range docids{data->index.num_docs() / 3, 2 * data->index.num_docs() / 3};
+    for (auto const& q: data->queries) {
+        topk_queue expected(10);
+        ranked_or_query or_q(expected);
+        auto or_cursors = make_scored_cursors(data->index, *scorer, q);
+        seek_cursors(or_cursors, docids.begin);
+        or_q(or_cursors, docids.end);
+        expected.finalize();
+
+        topk_queue actual(10);
+        TestType op_q(actual);
+        auto cursors = make_block_max_scored_cursors(data->index, data->wdata, *scorer, q);
+        seek_cursors(cursors, docids.begin);
+        op_q(cursors, docids.end_within(data->index.num_docs()));
+        actual.finalize();
+
+        REQUIRE(actual.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < expected.topk().size(); ++i) {
+            REQUIRE(actual.topk()[i].first == Approx(expected.topk()[i].first).epsilon(0.1));
+            REQUIRE(actual.topk()[i].second >= docids.begin);
+            REQUIRE(actual.topk()[i].second < docids.end);
+        }
+    }
+}
+
 TEMPLATE_TEST_CASE("Ranked AND query test", "[query][ranked][integration]", block_max_ranked_and_query)
 {
     for (auto quantized: {false, true}) {
@@ -179,6 +260,402 @@ TEMPLATE_TEST_CASE("Ranked AND query test", "[query][ranked][integration]", bloc
     }
 }
 
+TEST_CASE("SvS intersection matches leapfrogging", "[query][ranked][integration]")
+{
+    for (auto quantized: {false, true}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get("bm25", quantized, dropped_term_ids);
+        auto scorer = scorer::from_name("bm25", data->wdata);
+        topk_queue topk_1(10);
+        ranked_and_simd_query simd_q(topk_1);
+        topk_queue topk_2(10);
+        ranked_and_query and_q(topk_2);
+        for (auto const& q: data->queries) {
+            REQUIRE(
+                and_simd_query{}(make_cursors(data->index, q), data->index.num_docs())
+                == and_query{}(make_cursors(data->index, q), data->index.num_docs()));
+
+            simd_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+            and_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+            topk_1.finalize();
+            topk_2.finalize();
+            REQUIRE(topk_1.topk().size() == topk_2.topk().size());
+            for (size_t i = 0; i < topk_1.topk().size(); ++i) {
+                REQUIRE(topk_1.topk()[i].first == Approx(topk_2.topk()[i].first).epsilon(0.1));
+            }
+            topk_1.clear();
+            topk_2.clear();
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE(
+    "Weighted query test",
+    "[query][ranked][integration]",
+    wand_query,
+    maxscore_query,
+    long_maxscore_query,
+    block_max_wand_query,
+    block_max_maxscore_query)
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    for (auto query: data->queries) {
+        topk_queue unweighted(10);
+        ranked_or_query unweighted_q(unweighted);
+        unweighted_q(make_scored_cursors(data->index, *scorer, query), data->index.num_docs());
+        unweighted.finalize();
+
+        query.term_weights.assign(query.terms.size(), 2.0F);
+        topk_queue doubled(10);
+        ranked_or_query doubled_q(doubled);
+        doubled_q(make_scored_cursors(data->index, *scorer, query), data->index.num_docs());
+        doubled.finalize();
+        REQUIRE(doubled.topk().size() == unweighted.topk().size());
+        for (size_t i = 0; i < doubled.topk().size(); ++i) {
+            REQUIRE(doubled.topk()[i].first == Approx(2 * unweighted.topk()[i].first));
+        }
+
+        for (size_t i = 0; i < query.terms.size(); ++i) {
+            query.term_weights[i] = 0.5F + i % 3;
+        }
+        topk_queue expected(10);
+        ranked_or_query expected_q(expected);
+        expected_q(make_scored_cursors(data->index, *scorer, query), data->index.num_docs());
+        expected.finalize();
+        topk_queue actual(10);
+        TestType op_q(actual);
+        op_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, query),
+            data->index.num_docs());
+        actual.finalize();
+        REQUIRE(actual.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < expected.topk().size(); ++i) {
+            REQUIRE(actual.topk()[i].first == Approx(expected.topk()[i].first).epsilon(0.1));
+        }
+    }
+}
+
+TEST_CASE("Long MaxScore matches ranked OR on long queries", "[query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    for (size_t first = 0; first < data->queries.size(); first += 20) {
+        Query query;
+        for (size_t idx = first; idx < std::min(first + 20, data->queries.size()); ++idx) {
+            auto const& terms = data->queries[idx].terms;
+            query.terms.insert(query.terms.end(), terms.begin(), terms.end());
+        }
+        topk_queue expected(10);
+        ranked_or_query or_q(expected);
+        or_q(make_scored_cursors(data->index, *scorer, query), data->index.num_docs());
+        expected.finalize();
+        topk_queue actual(10);
+        long_maxscore_query long_q(actual);
+        long_q(
+            make_max_scored_cursors(data->index, data->wdata, *scorer, query),
+            data->index.num_docs());
+        actual.finalize();
+        REQUIRE(actual.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < expected.topk().size(); ++i) {
+            REQUIRE(actual.topk()[i].first == Approx(expected.topk()[i].first).epsilon(0.1));
+        }
+    }
+}
+
+TEST_CASE(
+    "Clipped MaxScore returns exact scores on weighted queries", "[query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    for (size_t first = 0; first < data->queries.size(); first += 20) {
+        Query query;
+        for (size_t idx = first; idx < std::min(first + 20, data->queries.size()); ++idx) {
+            auto const& terms = data->queries[idx].terms;
+            query.terms.insert(query.terms.end(), terms.begin(), terms.end());
+        }
+        // skewed weights, as in learned sparse queries
+        for (size_t i = 0; i < query.terms.size(); ++i) {
+            query.term_weights.push_back(i % 5 == 0 ? 2.0F : 0.05F);
+        }
+        topk_queue all(data->index.num_docs());
+        ranked_or_query or_q(all);
+        or_q(make_scored_cursors(data->index, *scorer, query), data->index.num_docs());
+        all.finalize();
+        std::unordered_map<uint64_t, float> scores;
+        for (auto [score, docid]: all.topk()) {
+            scores[docid] = score;
+        }
+
+        topk_queue exact(10);
+        long_maxscore_query exact_q(exact, 0.0);
+        exact_q(
+            make_max_scored_cursors(data->index, data->wdata, *scorer, query),
+            data->index.num_docs());
+        exact.finalize();
+        REQUIRE(exact.topk().size() == std::min<size_t>(10, all.topk().size()));
+        for (size_t i = 0; i < exact.topk().size(); ++i) {
+            REQUIRE(exact.topk()[i].first == Approx(all.topk()[i].first).epsilon(0.1));
+        }
+
+        topk_queue clipped(10);
+        long_maxscore_query clipped_q(clipped, 0.5);
+        clipped_q(
+            make_max_scored_cursors(data->index, data->wdata, *scorer, query),
+            data->index.num_docs());
+        clipped.finalize();
+        REQUIRE(!clipped.topk().empty());
+        for (size_t i = 0; i < clipped.topk().size(); ++i) {
+            auto [score, docid] = clipped.topk()[i];
+            REQUIRE(score == Approx(scores.at(docid)).epsilon(0.1));
+            REQUIRE(score <= exact.topk()[i].first + 0.001);
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE(
+    "OR counts the union of the lists", "[query][integration]", single_index, block_simdbp_index)
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<TestType>::get("bm25", false, dropped_term_ids);
+    for (auto const& q: data->queries) {
+        std::set<uint64_t> expected;
+        auto terms = q.terms;
+        remove_duplicate_terms(terms);
+        for (auto term: terms) {
+            auto list = data->index[term];
+            for (; list.docid() < data->index.num_docs(); list.next()) {
+                expected.insert(list.docid());
+            }
+        }
+        auto num_docs = data->index.num_docs();
+        REQUIRE(or_query<false>{}(make_cursors(data->index, q), num_docs) == expected.size());
+        REQUIRE(or_query<true>{}(make_cursors(data->index, q), num_docs) == expected.size());
+    }
+}
+
+TEST_CASE("Batched TAAT matches ranked OR", "[query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    for (std::uint32_t window_size: {100U, batch_ranked_or_taat_query::default_window_size}) {
+        batch_ranked_or_taat_query batch_q(10, window_size);
+        auto results = batch_q(data->index, *scorer, gsl::make_span(data->queries));
+        REQUIRE(results.size() == data->queries.size());
+        for (std::size_t query_idx = 0; query_idx < data->queries.size(); ++query_idx) {
+            topk_queue topk(10);
+            ranked_or_query or_q(topk);
+            or_q(
+                make_scored_cursors(data->index, *scorer, data->queries[query_idx]),
+                data->index.num_docs());
+            topk.finalize();
+            REQUIRE(results[query_idx].size() == topk.topk().size());
+            for (size_t i = 0; i < topk.topk().size(); ++i) {
+                REQUIRE(results[query_idx][i].first == Approx(topk.topk()[i].first).epsilon(0.1));
+            }
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE(
+    "Interleaved ranked AND matches ranked AND",
+    "[query][ranked][integration]",
+    single_index,
+    block_simdbp_index)
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<TestType>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    for (std::uint32_t lines: {0U, interleaved_ranked_and_query::default_prefetch_lines}) {
+        interleaved_ranked_and_query interleaved_q(10, lines);
+        auto results = interleaved_q(data->index, *scorer, gsl::make_span(data->queries));
+        REQUIRE(results.size() == data->queries.size());
+        for (std::size_t query_idx = 0; query_idx < data->queries.size(); ++query_idx) {
+            topk_queue topk(10);
+            ranked_and_query and_q(topk);
+            and_q(
+                make_scored_cursors(data->index, *scorer, data->queries[query_idx]),
+                data->index.num_docs());
+            topk.finalize();
+            REQUIRE(results[query_idx] == topk.topk());
+        }
+    }
+}
+
+TEST_CASE("Dynamic block-max MaxScore counts its work", "[query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    topk_queue topk_1(10);
+    block_max_maxscore_query static_q(topk_1);
+    topk_queue topk_2(10);
+    dynamic_block_max_maxscore_query dynamic_q(topk_2);
+    uint64_t postings = 0;
+    for (auto const& q: data->queries) {
+        auto cursors = make_block_max_scored_cursors(data->index, data->wdata, *scorer, q);
+        for (auto const& cursor: cursors) {
+            postings += cursor.docs_enum.size();
+        }
+        static_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        dynamic_q(cursors, data->index.num_docs());
+        topk_1.clear();
+        topk_2.clear();
+    }
+    REQUIRE(static_q.scored_postings() <= postings);
+    REQUIRE(dynamic_q.scored_postings() <= postings);
+    REQUIRE(dynamic_q.skipped_windows() <= dynamic_q.windows());
+}
+
+TEMPLATE_TEST_CASE(
+    "Queries stop on their postings budget",
+    "[query][ranked][integration]",
+    block_max_wand_query,
+    maxscore_query)
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    std::size_t approximate = 0;
+    for (auto const& q: data->queries) {
+        topk_queue exact_topk(10);
+        TestType exact_q(exact_topk);
+        exact_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        exact_topk.finalize();
+        REQUIRE_FALSE(exact_q.is_approximate());
+
+        topk_queue unbounded_topk(10);
+        TestType unbounded_q(unbounded_topk, query_budget(exact_q.scored_postings() + 1, {}));
+        unbounded_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        unbounded_topk.finalize();
+        REQUIRE_FALSE(unbounded_q.is_approximate());
+        REQUIRE(unbounded_topk.topk() == exact_topk.topk());
+
+        topk_queue topk(10);
+        TestType budget_q(topk, query_budget(10, {}));
+        budget_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        topk.finalize();
+        REQUIRE(budget_q.scored_postings() < 10 + q.terms.size());
+        if (budget_q.is_approximate()) {
+            approximate += 1;
+            REQUIRE(budget_q.scored_postings() >= 10);
+        } else {
+            REQUIRE(topk.topk() == exact_topk.topk());
+        }
+    }
+    REQUIRE(approximate > 0);
+}
+
+TEMPLATE_TEST_CASE(
+    "Queries stop once their threshold stabilizes",
+    "[query][ranked][integration]",
+    block_max_wand_query,
+    maxscore_query)
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    std::size_t approximate = 0;
+    for (auto const& q: data->queries) {
+        topk_queue exact_topk(10);
+        TestType exact_q(exact_topk);
+        exact_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        exact_topk.finalize();
+
+        query_budget budget;
+        budget.stop_when_stable(1, 0.0);
+        REQUIRE_FALSE(budget.is_unlimited());
+        topk_queue topk(10);
+        TestType stable_q(topk, budget);
+        stable_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        topk.finalize();
+        REQUIRE(stable_q.scored_postings() <= exact_q.scored_postings());
+        if (stable_q.is_approximate()) {
+            approximate += 1;
+            REQUIRE(topk.topk().size() == 10);
+        } else {
+            REQUIRE(topk.topk() == exact_topk.topk());
+        }
+    }
+    REQUIRE(approximate > 0);
+}
+
+TEST_CASE("Rescoring candidates returns their exact top k", "[query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    for (auto const& q: data->queries) {
+        topk_queue expected(100);
+        ranked_or_query or_q(expected);
+        or_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+        expected.finalize();
+
+        // the first stage only needs to get the right candidates, not their scores or order
+        std::vector<std::pair<float, uint64_t>> candidates;
+        for (auto it = expected.topk().rbegin(); it != expected.topk().rend(); ++it) {
+            candidates.emplace_back(0.0F, it->second);
+        }
+        auto actual = rescore_candidates(data->index, *scorer, q, candidates, 10);
+        REQUIRE(actual.size() == std::min<std::size_t>(10, expected.topk().size()));
+        for (size_t i = 0; i < actual.size(); ++i) {
+            REQUIRE(actual[i].first == Approx(expected.topk()[i].first));
+        }
+    }
+}
+
+TEST_CASE("Reordering moved cursors restores their docid order", "[query][unit]")
+{
+    struct fake_enum {
+        uint64_t doc;
+        [[nodiscard]] auto docid() const -> uint64_t { return doc; }
+    };
+    struct fake_cursor {
+        fake_enum docs_enum;
+    };
+    std::vector<uint64_t> docids = GENERATE(
+        std::vector<uint64_t>{9, 1, 4, 4, 7},
+        std::vector<uint64_t>{2, 3, 1, 5, 6},
+        std::vector<uint64_t>{10, 11, 12, 1, 2},
+        std::vector<uint64_t>{3, 3, 3, 3, 3});
+    std::size_t moved = GENERATE(0, 1, 2, 3);
+    CAPTURE(docids, moved);
+    // the cursors after the moved ones are sorted
+    std::sort(docids.begin() + moved, docids.end());
+
+    std::vector<fake_cursor> cursors;
+    for (auto docid: docids) {
+        cursors.push_back({{docid}});
+    }
+    std::vector<fake_cursor*> ordered;
+    for (auto& cursor: cursors) {
+        ordered.push_back(&cursor);
+    }
+    reorder_moved_cursors(ordered, moved);
+    std::sort(docids.begin(), docids.end());
+    std::vector<uint64_t> actual;
+    for (auto* cursor: ordered) {
+        actual.push_back(cursor->docs_enum.docid());
+    }
+    REQUIRE(actual == docids);
+}
+
 TEST_CASE("Top k")
 {
     for (auto&& s_name: {"bm25", "qld"}) {
@@ -205,3 +682,163 @@ TEST_CASE("Top k")
         }
     }
 }
+
+TEST_CASE("Statically dispatched scorers match type-erased ones", "[query][ranked][integration]")
+{
+    for (auto&& s_name: {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, false, dropped_term_ids);
+        auto dynamic_scorer = scorer::from_name(s_name, data->wdata);
+        scorer::with_scorer(s_name, data->wdata, [&](auto const& static_scorer) {
+            topk_queue topk_1(10);
+            wand_query wand_q(topk_1);
+            topk_queue topk_2(10);
+            wand_query wand_dynamic_q(topk_2);
+            for (auto const& q: data->queries) {
+                wand_q(
+                    make_max_scored_cursors(data->index, data->wdata, static_scorer, q),
+                    data->index.num_docs());
+                wand_dynamic_q(
+                    make_max_scored_cursors(data->index, data->wdata, *dynamic_scorer, q),
+                    data->index.num_docs());
+                topk_1.finalize();
+                topk_2.finalize();
+                REQUIRE(topk_1.topk() == topk_2.topk());
+                topk_1.clear();
+                topk_2.clear();
+            }
+        });
+    }
+}
+
+TEST_CASE("Range queries visit only live ranges", "[query][ranked][integration]")
+{
+    using WandTypeRange = wand_data_range<128, 1024>;
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    wand_data<WandTypeRange> wdata_range(
+        data->document_sizes.begin()->begin(),
+        data->collection.num_docs(),
+        data->collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    auto num_docs = data->index.num_docs();
+    std::pair<uint32_t, uint32_t> doc_range(0, num_docs);
+
+    size_t skipped_ranges = 0;
+    for (auto const& q: data->queries) {
+        topk_queue expected(10);
+        ranked_or_query or_q(expected);
+        or_q(make_scored_cursors(data->index, *scorer, q), num_docs);
+        expected.finalize();
+        if (expected.topk().size() < 10) {
+            continue;
+        }
+
+        // Any document scoring at least the k-th score is in a live range.
+        float threshold = expected.topk().back().first * 0.999F;
+        std::vector<WandTypeRange::enumerator> enums;
+        for (auto [term, weight]: query_freqs(q.terms)) {
+            if (data->index[term].size() >= 1024) {
+                for (size_t i = 0; i < weight; ++i) {
+                    enums.push_back(wdata_range.getenum(term));
+                }
+            } else {
+                threshold -= weight * data->wdata.max_term_weight(term);
+            }
+        }
+        auto live_ranges = WandTypeRange::compute_live_blocks(enums, threshold, doc_range);
+        REQUIRE(live_ranges.size() == ceil_div(num_docs, 128));
+        auto upper_bounds = WandTypeRange::range_upper_bounds(enums, doc_range);
+        for (size_t range = 0; range < live_ranges.size(); ++range) {
+            REQUIRE(live_ranges[range] == (upper_bounds[range] > threshold));
+            skipped_ranges += live_ranges[range] ? 0 : 1;
+        }
+
+        topk_queue topk(10);
+        range_query<wand_query> range_q(topk);
+        range_q(
+            make_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            num_docs,
+            128,
+            live_ranges);
+        topk.finalize();
+
+        topk_queue taat_topk(10);
+        range_taat_query<ranked_or_taat_query> range_taat_q(taat_topk);
+        Simple_Accumulator accumulator(num_docs);
+        range_taat_q(
+            make_scored_cursors(data->index, *scorer, q), num_docs, 128, live_ranges, accumulator);
+        taat_topk.finalize();
+
+        REQUIRE(topk.topk().size() == expected.topk().size());
+        REQUIRE(taat_topk.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < expected.topk().size(); ++i) {
+            REQUIRE(topk.topk()[i].first == Approx(expected.topk()[i].first));
+            REQUIRE(taat_topk.topk()[i].first == Approx(expected.topk()[i].first));
+        }
+    }
+    REQUIRE(skipped_ranges > 0);
+}
+
+TEST_CASE("Query stats count the traversal of each query", "[query][ranked][integration]")
+{
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    auto& counters = query_stats::local();
+    query_counters wand_total;
+    query_counters block_max_wand_total;
+    for (auto const& q: data->queries) {
+        uint64_t postings = 0;
+        for (auto const& cursor: make_scored_cursors(data->index, *scorer, q)) {
+            postings += cursor.docs_enum.size();
+        }
+
+        counters.reset();
+        topk_queue or_topk(10);
+        basic_ranked_or_query<query_stats> or_q(or_topk);
+        or_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+        or_topk.finalize();
+        REQUIRE(counters.postings_decoded == postings);
+        REQUIRE(counters.postings_scored == postings);
+        REQUIRE(counters.threshold_updates <= postings);
+        auto or_counters = counters;
+
+        counters.reset();
+        topk_queue wand_topk(10);
+        basic_wand_query<query_stats> wand_q(wand_topk);
+        wand_q(
+            make_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        wand_topk.finalize();
+        REQUIRE(wand_topk.topk().size() == or_topk.topk().size());
+        REQUIRE(counters.postings_scored <= or_counters.postings_scored);
+        wand_total.pivot_moves += counters.pivot_moves;
+        wand_total.threshold_updates += counters.threshold_updates;
+
+        counters.reset();
+        topk_queue block_max_wand_topk(10);
+        basic_block_max_wand_query<float, query_stats> block_max_wand_q(block_max_wand_topk);
+        block_max_wand_q(
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        REQUIRE(counters.postings_scored == block_max_wand_q.scored_postings());
+        block_max_wand_total.blocks_skipped += counters.blocks_skipped;
+
+        counters.reset();
+        topk_queue uncounted_topk(10);
+        basic_wand_query<no_query_stats> uncounted_q(uncounted_topk);
+        uncounted_q(
+            make_max_scored_cursors(data->index, data->wdata, *scorer, q),
+            data->index.num_docs());
+        REQUIRE(counters.postings_decoded == 0);
+        REQUIRE(counters.threshold_updates == 0);
+    }
+    REQUIRE(wand_total.pivot_moves > 0);
+    REQUIRE(wand_total.threshold_updates > 0);
+    REQUIRE(block_max_wand_total.blocks_skipped > 0);
+}
@@ -0,0 +1,83 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "forward_index.hpp"
+#include "pisa_config.hpp"
+#include "recursive_graph_bisection.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Weight terms by their frequency in a query log", "[bp]")
+{
+    auto weights = bp::query_term_weights({0, 4, 2}, 4, 10.0);
+    REQUIRE(weights == std::vector<double>{1.0, 11.0, 6.0, 1.0});
+    REQUIRE(bp::query_term_weights({}, 2, 10.0) == std::vector<double>{1.0, 1.0});
+}
+
+TEST_CASE("Add impact terms to the documents of the top postings of query terms", "[bp]")
+{
+    std::string basename(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_freq_collection collection(basename.c_str());
+    auto fwd = forward_index::from_inverted_index(basename, 0, true);
+    std::vector<std::size_t> frequencies(fwd.term_count(), 0);
+    frequencies[0] = 3;
+    frequencies[7] = 1;
+    auto weights = bp::query_term_weights(frequencies, fwd.term_count(), 2.0);
+    auto extended = bp::add_impact_terms(fwd, collection, weights, 0.25);
+
+    REQUIRE(extended.size() == fwd.size());
+    REQUIRE(extended.term_count() == fwd.term_count() + 2);
+    REQUIRE(weights.size() == extended.term_count());
+    REQUIRE(weights[fwd.term_count()] == weights[0]);
+    REQUIRE(weights[fwd.term_count() + 1] == weights[7]);
+
+    std::vector<std::size_t> impact_postings(2, 0);
+    for (uint32_t document = 0; document < fwd.size(); ++document) {
+        auto terms = extended.terms(document);
+        auto original = fwd.terms(document);
+        REQUIRE(std::equal(original.begin(), original.end(), terms.begin()));
+        for (auto pos = std::next(terms.begin(), original.size()); pos != terms.end(); ++pos) {
+            auto term = *pos == fwd.term_count() ? 0U : 7U;
+            REQUIRE(std::binary_search(original.begin(), original.end(), term));
+            impact_postings[*pos - fwd.term_count()] += 1;
+        }
+    }
+    std::vector<std::size_t> list_sizes;
+    for (auto const& list: collection) {
+        list_sizes.push_back(list.docs.size());
+    }
+    REQUIRE(impact_postings[0] == static_cast<std::size_t>(std::ceil(0.25 * list_sizes[0])));
+    REQUIRE(impact_postings[1] == static_cast<std::size_t>(std::ceil(0.25 * list_sizes[7])));
+}
+
+TEST_CASE("Bisect documents with weighted terms", "[bp]")
+{
+    std::string basename(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_freq_collection collection(basename.c_str());
+    auto fwd = forward_index::from_inverted_index(basename, 0, true);
+    std::vector<std::size_t> frequencies(fwd.term_count(), 0);
+    for (std::size_t term = 0; term < frequencies.size(); term += 3) {
+        frequencies[term] = term % 7;
+    }
+    auto weights = bp::query_term_weights(frequencies, fwd.term_count(), 10.0);
+    fwd = bp::add_impact_terms(fwd, collection, weights, 0.1);
+
+    std::vector<double> gains(fwd.size(), 0.0);
+    std::vector<uint32_t> documents(fwd.size());
+    std::iota(documents.begin(), documents.end(), 0U);
+    document_range<std::vector<uint32_t>::iterator> range(
+        documents.begin(), documents.end(), fwd, gains, &weights);
+    progress p("Graph bisection", range.size() * 4);
+    recursive_graph_bisection(range, 4, 2, p);
+
+    std::sort(documents.begin(), documents.end());
+    std::vector<uint32_t> expected(fwd.size());
+    std::iota(expected.begin(), expected.end(), 0U);
+    REQUIRE(documents == expected);
+}
@@ -0,0 +1,53 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "pisa_config.hpp"
+#include "temporary_directory.hpp"
+#include "util/inverted_index_utils.hpp"
+
+TEST_CASE("Reorder inverted index", "[reorder]")
+{
+    using pisa::binary_freq_collection;
+    std::string input(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    Temporary_Directory tmpdir;
+    std::string output = (tmpdir.path() / "reordered").string();
+    auto original = binary_freq_collection(input.c_str());
+
+    std::vector<uint32_t> mapping(original.num_docs());
+    std::iota(mapping.begin(), mapping.end(), 0U);
+    std::shuffle(mapping.begin(), mapping.end(), std::mt19937{1});
+    pisa::reorder_inverted_index(input, output, mapping);
+    auto reordered = binary_freq_collection(output.c_str());
+
+    REQUIRE(reordered.num_docs() == original.num_docs());
+    auto oit = original.begin();
+    auto rit = reordered.begin();
+    for (; oit != original.end(); ++oit, ++rit) {
+        REQUIRE(rit != reordered.end());
+        std::vector<std::pair<uint32_t, uint32_t>> expected;
+        for (size_t i = 0; i < oit->docs.size(); ++i) {
+            expected.emplace_back(mapping[oit->docs.begin()[i]], oit->freqs.begin()[i]);
+        }
+        std::sort(expected.begin(), expected.end());
+        std::vector<std::pair<uint32_t, uint32_t>> actual;
+        for (size_t i = 0; i < rit->docs.size(); ++i) {
+            actual.emplace_back(rit->docs.begin()[i], rit->freqs.begin()[i]);
+        }
+        REQUIRE(actual == expected);
+    }
+    REQUIRE(rit == reordered.end());
+
+    pisa::binary_collection sizes_original((input + ".sizes").c_str());
+    pisa::binary_collection sizes_reordered((output + ".sizes").c_str());
+    auto original_sizes = *sizes_original.begin();
+    auto reordered_sizes = *sizes_reordered.begin();
+    for (size_t doc = 0; doc < original.num_docs(); ++doc) {
+        REQUIRE(original_sizes.begin()[doc] == reordered_sizes.begin()[mapping[doc]]);
+    }
+}
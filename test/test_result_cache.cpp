@@ -0,0 +1,73 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "query/queries.hpp"
+#include "query/result_cache.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Cache keys are normalized")
+{
+    Query query{"q1", {3, 1, 3, 2}, {}};
+    Query permuted{"q2", {1, 3, 2, 3}, {}};
+    Query deduplicated{std::nullopt, {1, 2, 3}, {}};
+    auto key = result_cache::key(query, 10, "wand", "bm25");
+    REQUIRE(key == result_cache::key(permuted, 10, "wand", "bm25"));
+    REQUIRE(key != result_cache::key(deduplicated, 10, "wand", "bm25"));
+    REQUIRE(key != result_cache::key(query, 100, "wand", "bm25"));
+    REQUIRE(key != result_cache::key(query, 10, "maxscore", "bm25"));
+    REQUIRE(key != result_cache::key(query, 10, "wand", "qld"));
+}
+
+TEST_CASE("Evict least recently used results")
+{
+    result_cache cache(2, 1);
+    cache.put("a", {{1.0, 1}});
+    cache.put("b", {{2.0, 2}});
+    REQUIRE(cache.get("a") == result_cache::result_type{{1.0, 1}});
+    cache.put("c", {{3.0, 3}});
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.evictions() == 1);
+    REQUIRE_FALSE(cache.get("b"));
+    REQUIRE(cache.get("a"));
+    REQUIRE(cache.get("c") == result_cache::result_type{{3.0, 3}});
+    REQUIRE(cache.hits() == 3);
+    REQUIRE(cache.misses() == 1);
+    REQUIRE(cache.hit_rate() == Approx(0.75));
+}
+
+TEST_CASE("Zero capacity disables caching")
+{
+    result_cache cache(0);
+    cache.put("a", {{1.0, 1}});
+    REQUIRE(cache.size() == 0);
+    REQUIRE_FALSE(cache.get("a"));
+}
+
+TEST_CASE("Compute missing results concurrently")
+{
+    tbb::task_scheduler_init init;
+    result_cache cache(64);
+    std::atomic_size_t computed{0};
+    std::vector<result_cache::result_type> results(1000);
+    tbb::parallel_for(size_t(0), results.size(), [&](size_t idx) {
+        Query query{std::nullopt, {static_cast<term_id_type>(idx % 10)}, {}};
+        results[idx] =
+            cache.get_or_compute(result_cache::key(query, 10, "ranked_or", "bm25"), [&]() {
+                computed += 1;
+                return result_cache::result_type{{1.0, idx % 10}};
+            });
+    });
+    for (size_t idx = 0; idx < results.size(); ++idx) {
+        REQUIRE(results[idx] == result_cache::result_type{{1.0, idx % 10}});
+    }
+    REQUIRE(cache.size() == 10);
+    REQUIRE(cache.hits() + cache.misses() == results.size());
+    REQUIRE(cache.misses() == computed.load());
+}
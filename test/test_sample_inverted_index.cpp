@@ -3,6 +3,7 @@
 
 #include "test_generic_sequence.hpp"
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <unordered_set>
 #include <vector>
@@ -162,3 +163,24 @@ TEST_CASE("sample_inverted_index_reverse")
         REQUIRE(*soit++ == *ssit++);
     }
 }
+
+TEST_CASE("sample_docids_stratified")
+{
+    std::size_t num_docs = GENERATE(1, 10, 1000, 1003);
+    double rate = GENERATE(0.01, 0.1, 0.5, 1.0);
+    std::size_t strata = GENERATE(1, 7, 100);
+    CAPTURE(num_docs, rate, strata);
+
+    auto kept = pisa::sample_docids_stratified(num_docs, rate, strata, 17);
+    REQUIRE(kept.size() == num_docs);
+    REQUIRE(kept == pisa::sample_docids_stratified(num_docs, rate, strata, 17));
+
+    // every stratum keeps the same fraction of its documents
+    auto actual_strata = std::min(strata, num_docs);
+    for (std::size_t stratum = 0; stratum < actual_strata; ++stratum) {
+        auto begin = num_docs * stratum / actual_strata;
+        auto end = num_docs * (stratum + 1) / actual_strata;
+        auto count = std::count(kept.begin() + begin, kept.begin() + end, true);
+        REQUIRE(count == static_cast<long>(std::ceil(double(end - begin) * rate)));
+    }
+}
@@ -0,0 +1,153 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch.hpp>
+
+#include <numeric>
+#include <vector>
+
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/score_memo.hpp"
+#include "topk_queue.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Memoize term scores", "[score_memo][unit]")
+{
+    score_memo memo(5);
+    REQUIRE(memo.capacity() == 8);
+    float score = 0;
+    REQUIRE_FALSE(memo.get(1, 2, score));
+    memo.put(1, 2, 3.5);
+    REQUIRE(memo.get(1, 2, score));
+    REQUIRE(score == 3.5);
+    REQUIRE_FALSE(memo.get(2, 1, score));
+    REQUIRE(memo.hits() == 1);
+    REQUIRE(memo.misses() == 2);
+
+    // a colliding entry replaces the previous one
+    score_memo single(1);
+    single.put(1, 2, 3.5);
+    single.put(4, 5, 6.5);
+    REQUIRE_FALSE(single.get(1, 2, score));
+    REQUIRE(single.get(4, 5, score));
+    REQUIRE(score == 6.5);
+
+    memo.clear();
+    REQUIRE_FALSE(memo.get(1, 2, score));
+    REQUIRE(memo.hits() == 0);
+
+    int computed = 0;
+    auto scorer = [&](uint32_t doc, uint32_t freq) {
+        computed += 1;
+        return float(doc + freq);
+    };
+    memoized_term_scorer<decltype(scorer)> memoized{scorer, 7, &memo};
+    REQUIRE(memoized(10, 2) == 12.0);
+    REQUIRE(memoized(10, 2) == 12.0);
+    REQUIRE(computed == 1);
+}
+
+struct IndexData {
+    IndexData()
+        : collection(PISA_SOURCE_DIR "/test/test_data/test_collection"),
+          document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes"),
+          wdata(
+              document_sizes.begin()->begin(),
+              collection.num_docs(),
+              collection,
+              "bm25",
+              BlockSize(FixedBlock(5)),
+              false,
+              {})
+    {
+        single_index::builder builder(collection.num_docs(), params);
+        for (auto const& plist: collection) {
+            uint64_t freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+        }
+        builder.build(index);
+
+        std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+        io::for_each_line(
+            qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    }
+
+    global_parameters params;
+    binary_freq_collection collection;
+    binary_collection document_sizes;
+    single_index index;
+    std::vector<Query> queries;
+    wand_data<wand_data_raw> wdata;
+};
+
+/// Returns variants of `query`: itself, without its last term, and with its first term repeated,
+/// which weights it twice.
+auto variants(Query const& query) -> std::vector<Query>
+{
+    std::vector<Query> variants{query, query, query};
+    if (variants[1].terms.size() > 1) {
+        variants[1].terms.pop_back();
+    }
+    if (not query.terms.empty()) {
+        variants[2].terms.push_back(query.terms.front());
+    }
+    return variants;
+}
+
+void check_same_results(topk_queue& expected, topk_queue& actual)
+{
+    expected.finalize();
+    actual.finalize();
+    REQUIRE(expected.topk().size() == actual.topk().size());
+    for (size_t i = 0; i < expected.topk().size(); ++i) {
+        REQUIRE(expected.topk()[i].first == Approx(actual.topk()[i].first));
+    }
+}
+
+TEST_CASE("Query variants share memoized term scores", "[score_memo][query][integration]")
+{
+    IndexData data;
+    auto num_docs = data.index.num_docs();
+    score_memo memo(1U << 16U);
+    scorer::with_scorer("bm25", data.wdata, [&](auto const& scorer) {
+        for (auto const& query: data.queries) {
+            for (auto const& variant: variants(query)) {
+                {
+                    topk_queue expected(10);
+                    maxscore_query expected_q(expected);
+                    expected_q(
+                        make_max_scored_cursors(data.index, data.wdata, scorer, variant), num_docs);
+                    topk_queue actual(10);
+                    maxscore_query actual_q(actual);
+                    actual_q(
+                        make_max_scored_cursors(data.index, data.wdata, scorer, variant, memo),
+                        num_docs);
+                    check_same_results(expected, actual);
+                }
+                {
+                    topk_queue expected(10);
+                    block_max_wand_query expected_q(expected);
+                    expected_q(
+                        make_block_max_scored_cursors(data.index, data.wdata, scorer, variant),
+                        num_docs);
+                    topk_queue actual(10);
+                    block_max_wand_query actual_q(actual);
+                    actual_q(
+                        make_block_max_scored_cursors(data.index, data.wdata, scorer, variant, memo),
+                        num_docs);
+                    check_same_results(expected, actual);
+                }
+            }
+        }
+    });
+    REQUIRE(memo.hits() > 0);
+}
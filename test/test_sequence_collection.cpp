@@ -55,3 +55,31 @@ TEST_CASE("sequence_collection")
     test_sequence_collection<pisa::partitioned_sequence<>>();
     test_sequence_collection<pisa::uniform_partitioned_sequence<>>();
 }
+
+TEST_CASE("sequence_collection built in parallel chunks")
+{
+    pisa::global_parameters params;
+    uint64_t universe = 100000;
+    using collection_type = pisa::sequence_collection<pisa::partitioned_sequence<>>;
+    collection_type::builder b(params);
+
+    // enough sequences for several chunks, added after and before single ones
+    std::vector<std::vector<uint64_t>> sequences(80);
+    for (auto& seq: sequences) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 4;
+        seq = random_sequence(universe, uint64_t(universe / avg_gap), true);
+    }
+    b.add_sequence(sequences[0].begin(), sequences[0].back() + 1, sequences[0].size());
+    b.add_sequences(std::vector<std::vector<uint64_t>>(sequences.begin() + 1, sequences.end() - 1));
+    b.add_sequences(std::vector<std::vector<uint64_t>>{});
+    b.add_sequence(sequences.back().begin(), sequences.back().back() + 1, sequences.back().size());
+    REQUIRE_THROWS_AS(
+        b.add_sequences(std::vector<std::vector<uint64_t>>(1)), std::invalid_argument);
+
+    collection_type coll;
+    b.build(coll);
+    REQUIRE(coll.size() == sequences.size());
+    for (size_t i = 0; i < sequences.size(); ++i) {
+        test_sequence(coll[i], sequences[i]);
+    }
+}
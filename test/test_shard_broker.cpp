@@ -0,0 +1,100 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <tbb/task_scheduler_init.h>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "query/shard_broker.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Merge shard results")
+{
+    tbb::task_scheduler_init init;
+    std::vector<std::vector<float>> shard_scores{
+        {1.0, 7.0, 3.0, 2.5}, {6.0, 0.5, 4.0}, {}, {5.0, 8.0, 3.5, 9.0, 1.5}};
+
+    auto results = sharded_query(shard_scores.size(), 5, [&](Shard_Id shard, topk_queue& topk) {
+        auto const& scores = shard_scores[shard.as_int()];
+        for (size_t docid = 0; docid < scores.size(); ++docid) {
+            topk.insert(scores[docid], docid);
+        }
+    });
+
+    std::vector<std::tuple<float, int, uint64_t>> actual;
+    for (auto const& result: results) {
+        actual.emplace_back(result.score, result.shard.as_int(), result.docid);
+    }
+    std::vector<std::tuple<float, int, uint64_t>> expected{
+        {9.0, 3, 3}, {8.0, 3, 1}, {7.0, 0, 1}, {6.0, 1, 0}, {5.0, 3, 0}};
+    REQUIRE(actual == expected);
+}
+
+TEST_CASE("Sharded query matches unsharded query")
+{
+    tbb::task_scheduler_init init;
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+
+    global_parameters params;
+    block_interpolative_index index;
+    block_interpolative_index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    // Every shard is a contiguous docid range of the same index, so that the docids and
+    // scores of all shards are directly comparable with the unsharded results.
+    size_t shard_count = 4;
+    uint64_t shard_size = ceil_div(index.num_docs(), shard_count);
+    auto scorer = scorer::from_name("bm25", wdata);
+    for (auto const& query: queries) {
+        topk_queue topk(10);
+        ranked_or_query ranked_or_q(topk);
+        ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
+        topk.finalize();
+
+        auto results = sharded_query(shard_count, 10, [&](Shard_Id shard, topk_queue& shard_topk) {
+            uint64_t begin = shard.as_int() * shard_size;
+            uint64_t end = std::min(begin + shard_size, index.num_docs());
+            auto cursors = make_max_scored_cursors(index, wdata, *scorer, query);
+            for (auto&& cursor: cursors) {
+                cursor.docs_enum.next_geq(begin);
+            }
+            wand_query wand_q(shard_topk);
+            wand_q(cursors, end);
+        });
+
+        REQUIRE(results.size() == topk.topk().size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            REQUIRE(results[i].score == Approx(topk.topk()[i].first));
+        }
+    }
+}
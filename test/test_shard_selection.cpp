@@ -0,0 +1,84 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <vector>
+
+#include <tbb/task_scheduler_init.h>
+
+#include "query/shard_broker.hpp"
+#include "query/shard_selection.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto shard_ids(std::vector<int> const& ids) -> std::vector<Shard_Id>
+{
+    std::vector<Shard_Id> shards;
+    for (auto id: ids) {
+        shards.push_back(Shard_Id(id));
+    }
+    return shards;
+}
+
+}  // namespace
+
+TEST_CASE("ReDDE scales the results of each shard by its sampling rate")
+{
+    // Shard 0 has 4 documents, 2 of which are sampled; shard 1 has 6, 1 of which is sampled;
+    // shard 2 has 2, both sampled.
+    auto document_shards = shard_ids({0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 2, 2});
+    std::vector<bool> sampled{
+        true, true, false, false, true, false, false, false, false, false, true, true};
+    shard_selector selector(document_shards, sampled);
+    REQUIRE(selector.shard_count() == 3);
+
+    std::vector<topk_queue::entry_type> results{{9.0, 0}, {8.0, 10}, {7.0, 1}, {6.0, 4}};
+    shard_selection selection;
+    // Shard 1: 6, shard 0: 2 * 2 = 4, shard 2: 1.
+    REQUIRE(selector.select(results, selection) == shard_ids({1, 0, 2}));
+    selection.max_shards = 2;
+    REQUIRE(selector.select(results, selection) == shard_ids({1, 0}));
+    selection.depth = 2;
+    REQUIRE(selector.select(results, selection) == shard_ids({0, 2}));
+}
+
+TEST_CASE("Rank-S votes decay with rank and are cut by a threshold")
+{
+    auto document_shards = shard_ids({0, 0, 1, 1, 2, 2});
+    std::vector<bool> sampled(document_shards.size(), true);
+    shard_selector selector(document_shards, sampled);
+
+    std::vector<topk_queue::entry_type> results{{9.0, 2}, {8.0, 0}, {7.0, 1}, {6.0, 4}};
+    shard_selection selection;
+    selection.method = parse_shard_selection_method("rank_s");
+    selection.rank_s_base = 2.0;
+    // Shard 1: 1/2, shard 0: 1/4 + 1/8, shard 2: 1/16.
+    selection.rank_s_threshold = 0.1;
+    REQUIRE(selector.select(results, selection) == shard_ids({1, 0}));
+    selection.rank_s_threshold = 0.01;
+    REQUIRE(selector.select(results, selection) == shard_ids({1, 0, 2}));
+    REQUIRE_THROWS_AS(parse_shard_selection_method("cori"), std::invalid_argument);
+}
+
+TEST_CASE("Sharded query only runs on selected shards")
+{
+    tbb::task_scheduler_init init;
+    std::vector<std::vector<float>> shard_scores{
+        {1.0, 7.0, 3.0, 2.5}, {6.0, 0.5, 4.0}, {}, {5.0, 8.0, 3.5, 9.0, 1.5}};
+
+    auto results =
+        sharded_query(shard_ids({1, 0}), 3, [&](Shard_Id shard, topk_queue& topk) {
+            auto const& scores = shard_scores[shard.as_int()];
+            for (size_t docid = 0; docid < scores.size(); ++docid) {
+                topk.insert(scores[docid], docid);
+            }
+        });
+
+    std::vector<std::tuple<float, int, uint64_t>> actual;
+    for (auto const& result: results) {
+        actual.emplace_back(result.score, result.shard.as_int(), result.docid);
+    }
+    std::vector<std::tuple<float, int, uint64_t>> expected{{7.0, 0, 1}, {6.0, 1, 0}, {4.0, 1, 2}};
+    REQUIRE(actual == expected);
+}
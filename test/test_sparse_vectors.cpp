@@ -0,0 +1,92 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "io.hpp"
+#include "sparse_vectors.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Parse sparse vector records", "[sparse_vectors][unit]")
+{
+    std::string id;
+    std::vector<std::pair<std::string, float>> weights;
+    auto parse = [&](std::string_view line) {
+        id.clear();
+        weights.clear();
+        sparse_vectors::parse_record(
+            line,
+            [&](std::string_view value) { id = value; },
+            [&](std::string_view term, float weight) { weights.emplace_back(term, weight); });
+    };
+
+    parse(R"({"id": "D1", "contents": "a \"b\"", "vector": {"a": 1.5, "b": 2, "c": 3e-1}})");
+    CHECK(id == "D1");
+    CHECK(
+        weights
+        == std::vector<std::pair<std::string, float>>{{"a", 1.5}, {"b", 2.0}, {"c", 0.3F}});
+
+    parse(R"( { "extra" : [1, {"x": null}, true], "vector":{}, "id":"D\u00e92\ud83d\ude00" } )");
+    CHECK(id == "D\xc3\xa9" "2\xf0\x9f\x98\x80");
+    CHECK(weights.empty());
+
+    parse(R"({"id": "D3", "vector": {"café": 0.5, "a\\b": 1}})");
+    CHECK(
+        weights
+        == std::vector<std::pair<std::string, float>>{{"caf\xc3\xa9", 0.5}, {"a\\b", 1.0}});
+
+    CHECK_THROWS_AS(parse(R"({"id": "D4"})"), std::invalid_argument);
+    CHECK_THROWS_AS(parse(R"({"id": "D4", "vector": {"a": x}})"), std::invalid_argument);
+    CHECK_THROWS_AS(parse(R"({"id": "D4", "vector": {"a": 1}} x)"), std::invalid_argument);
+    CHECK_THROWS_AS(parse(R"({"id": "D4", "vector": {"a": 1})"), std::invalid_argument);
+}
+
+TEST_CASE("Import sparse vectors", "[sparse_vectors][unit]")
+{
+    Temporary_Directory tmp;
+    auto input = (tmp.path() / "vectors.jsonl").string();
+    auto output = (tmp.path() / "coll").string();
+    {
+        std::ofstream os(input);
+        os << R"({"id": "D0", "vector": {"b": 1.0, "a": 4.0}})" << '\n';
+        os << '\n';
+        os << R"({"id": "D1", "vector": {"c": 2.0, "a": 0.0, "b": 0.5}})" << '\n';
+        os << R"({"id": "D2", "vector": {}})" << '\n';
+        os << R"({"id": "D3", "vector": {"b": 1.0, "b": 1.0, "c": -1.0}})";
+    }
+    // a small batch size splits the input into several batches
+    auto batch_bytes = GENERATE(std::size_t(1), std::size_t(1) << 20U);
+    auto stats = sparse_vectors::import_jsonl(input, output, 4, batch_bytes);
+    CHECK(stats.documents == 4);
+    CHECK(stats.terms == 3);
+    CHECK(stats.postings == 5);
+    CHECK(stats.max_weight == 4.0);
+
+    CHECK(io::read_string_vector(output + ".terms") == std::vector<std::string>{"a", "b", "c"});
+    CHECK(
+        io::read_string_vector(output + ".documents")
+        == std::vector<std::string>{"D0", "D1", "D2", "D3"});
+
+    // weights are quantized to 4 bits with a scale of 16 / 4.0
+    binary_freq_collection collection(output.c_str());
+    REQUIRE(collection.num_docs() == 4);
+    std::vector<std::vector<std::uint32_t>> documents;
+    std::vector<std::vector<std::uint32_t>> impacts;
+    for (auto const& list: collection) {
+        documents.emplace_back(list.docs.begin(), list.docs.end());
+        impacts.emplace_back(list.freqs.begin(), list.freqs.end());
+    }
+    CHECK(documents == std::vector<std::vector<std::uint32_t>>{{0}, {0, 1, 3}, {1}});
+    CHECK(impacts == std::vector<std::vector<std::uint32_t>>{{16}, {4, 2, 8}, {8}});
+
+    binary_collection sizes((output + ".sizes").c_str());
+    auto sizes_seq = *sizes.begin();
+    CHECK(std::vector<std::uint32_t>(sizes_seq.begin(), sizes_seq.end())
+          == std::vector<std::uint32_t>{2, 2, 0, 1});
+}
@@ -0,0 +1,168 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "scorer/scorer.hpp"
+#include "static_pruning.hpp"
+#include "temporary_directory.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto read_queries() -> std::vector<Query>
+{
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    return queries;
+}
+
+}  // namespace
+
+TEST_CASE("Prune a collection", "[static_pruning][integration]")
+{
+    std::string input(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_freq_collection collection(input.c_str());
+    binary_collection document_sizes((input + ".sizes").c_str());
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+    auto lists = collection_lists(collection);
+    Temporary_Directory tmpdir;
+    auto output = (tmpdir.path() / "pruned").string();
+
+    auto policy = GENERATE(pruning_policy::term_centric, pruning_policy::document_centric);
+    auto thresholds = policy == pruning_policy::term_centric
+        ? term_centric_thresholds(lists, scorer, 10, 0.7F)
+        : document_centric_thresholds(lists, collection.num_docs(), scorer, 0.3);
+    auto stats = prune_inverted_index(input, output, scorer, policy, thresholds);
+
+    binary_freq_collection pruned(output.c_str());
+    auto pruned_lists = collection_lists(pruned);
+    REQUIRE(pruned.num_docs() == collection.num_docs());
+    REQUIRE(pruned_lists.size() == lists.size());
+    REQUIRE(stats.kept_postings < stats.postings);
+    std::size_t postings = 0;
+    std::size_t kept_postings = 0;
+    for (std::size_t term = 0; term < lists.size(); ++term) {
+        auto const& seq = lists[term];
+        auto const& pruned_seq = pruned_lists[term];
+        postings += seq.docs.size();
+        kept_postings += pruned_seq.docs.size();
+        // the kept postings are those of the list scoring at least their threshold, or else
+        // the highest-scoring one
+        auto term_scorer = scorer.term_scorer(term);
+        std::vector<uint32_t> expected_docs;
+        std::vector<uint32_t> expected_freqs;
+        std::pair<float, std::size_t> best{-1.0F, 0};
+        for (std::size_t idx = 0; idx < seq.docs.size(); ++idx) {
+            auto docid = *(seq.docs.begin() + idx);
+            auto freq = *(seq.freqs.begin() + idx);
+            auto threshold =
+                policy == pruning_policy::term_centric ? thresholds[term] : thresholds[docid];
+            auto score = term_scorer(docid, freq);
+            if (score >= threshold) {
+                expected_docs.push_back(docid);
+                expected_freqs.push_back(freq);
+            }
+            if (score > best.first) {
+                best = {score, idx};
+            }
+        }
+        if (expected_docs.empty()) {
+            expected_docs.push_back(*(seq.docs.begin() + best.second));
+            expected_freqs.push_back(*(seq.freqs.begin() + best.second));
+        }
+        REQUIRE(std::vector<uint32_t>(pruned_seq.docs.begin(), pruned_seq.docs.end())
+                == expected_docs);
+        REQUIRE(std::vector<uint32_t>(pruned_seq.freqs.begin(), pruned_seq.freqs.end())
+                == expected_freqs);
+        if (policy == pruning_policy::term_centric && seq.docs.size() <= 10) {
+            REQUIRE(pruned_seq.docs.size() == seq.docs.size());
+        }
+    }
+    REQUIRE(stats.postings == postings);
+    REQUIRE(stats.kept_postings == kept_postings);
+
+    double overlap = 0;
+    auto queries = read_queries();
+    std::vector<float> accumulator(collection.num_docs(), 0.0F);
+    for (auto const& query: queries) {
+        auto expected = exhaustive_topk(lists, scorer, query, 10, accumulator);
+        auto actual = exhaustive_topk(pruned_lists, scorer, query, 10, accumulator);
+        REQUIRE(expected.size() <= 10);
+        overlap += topk_overlap(expected, actual);
+    }
+    REQUIRE(overlap / queries.size() > 0.5);
+}
+
+TEST_CASE("Score a pruned collection as the full one", "[static_pruning]")
+{
+    std::string input(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_freq_collection collection(input.c_str());
+    binary_collection document_sizes((input + ".sizes").c_str());
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+    auto lists = collection_lists(collection);
+    Temporary_Directory tmpdir;
+    auto output = (tmpdir.path() / "pruned").string();
+    prune_inverted_index(
+        input,
+        output,
+        scorer,
+        pruning_policy::term_centric,
+        term_centric_thresholds(lists, scorer, 10, 0.7F));
+
+    binary_freq_collection pruned(output.c_str());
+    auto stats = collection_statistics(wdata, collection.size());
+    wand_data<wand_data_raw> pruned_wdata(
+        document_sizes.begin()->begin(),
+        pruned.num_docs(),
+        pruned,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {},
+        0,
+        &stats);
+    pruned_wdata.set_term_statistics(stats);
+    bm25<wand_data<wand_data_raw>> pruned_scorer(pruned_wdata);
+    auto pruned_lists = collection_lists(pruned);
+    for (std::uint32_t term = 0; term < pruned_lists.size(); ++term) {
+        REQUIRE(pruned_wdata.term_posting_count(term) == wdata.term_posting_count(term));
+        auto term_scorer = scorer.term_scorer(term);
+        auto pruned_term_scorer = pruned_scorer.term_scorer(term);
+        float max_score = 0;
+        auto freq = pruned_lists[term].freqs.begin();
+        for (auto docid: pruned_lists[term].docs) {
+            REQUIRE(pruned_term_scorer(docid, *freq) == Approx(term_scorer(docid, *freq)));
+            max_score = std::max(max_score, term_scorer(docid, *freq++));
+        }
+        REQUIRE(pruned_wdata.max_term_weight(term) == Approx(max_score));
+    }
+    REQUIRE_THROWS_AS(
+        pruned_wdata.set_term_statistics(global_statistics()), std::invalid_argument);
+}
@@ -0,0 +1,115 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <tbb/task_scheduler_init.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "temporary_directory.hpp"
+#include "util/synthetic_collection.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto read_file(std::string const& filename) -> std::string
+{
+    std::ifstream is(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+TEST_CASE("Generate a synthetic collection", "[synthetic]")
+{
+    synthetic_collection_params params;
+    params.documents = 5000;
+    params.terms = 300;
+    params.clustering = GENERATE(0.0, 0.8);
+    params.seed = 7;
+    CAPTURE(params.clustering);
+
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "synthetic").string();
+    std::size_t postings = 0;
+    {
+        tbb::task_scheduler_init init(4);
+        postings = write_synthetic_collection(basename, params);
+    }
+
+    binary_freq_collection collection(basename.c_str());
+    REQUIRE(collection.num_docs() == params.documents);
+    std::vector<std::uint32_t> occurrences(params.documents, 0);
+    std::size_t terms = 0;
+    std::size_t read_postings = 0;
+    std::size_t first_length = 0;
+    for (auto const& list: collection) {
+        REQUIRE(list.docs.size() > 0);
+        REQUIRE(list.docs.size() == list.freqs.size());
+        REQUIRE(std::adjacent_find(list.docs.begin(), list.docs.end(), std::greater_equal<>())
+                == list.docs.end());
+        REQUIRE(*std::prev(list.docs.end()) < params.documents);
+        auto freq = list.freqs.begin();
+        for (auto doc: list.docs) {
+            REQUIRE(*freq >= 1);
+            occurrences[doc] += *freq++;
+        }
+        if (terms == 0) {
+            first_length = list.docs.size();
+        }
+        REQUIRE(list.docs.size() <= first_length);
+        read_postings += list.docs.size();
+        terms += 1;
+    }
+    REQUIRE(terms == params.terms);
+    REQUIRE(read_postings == postings);
+
+    binary_collection sizes_collection((basename + ".sizes").c_str());
+    auto sizes = *sizes_collection.begin();
+    REQUIRE(sizes.size() == params.documents);
+    for (std::size_t doc = 0; doc < params.documents; ++doc) {
+        REQUIRE(sizes.begin()[doc] >= occurrences[doc]);
+    }
+
+    SECTION("The collection does not depend on the number of threads")
+    {
+        auto other = (tmpdir.path() / "serial").string();
+        {
+            tbb::task_scheduler_init init(1);
+            write_synthetic_collection(other, params);
+        }
+        for (auto extension: {".docs", ".freqs", ".sizes"}) {
+            REQUIRE(read_file(basename + extension) == read_file(other + extension));
+        }
+    }
+}
+
+TEST_CASE("Generate a synthetic query log", "[synthetic]")
+{
+    synthetic_query_params params;
+    params.queries = 500;
+    params.max_terms = 6;
+    params.seed = 3;
+    auto queries = synthetic_queries(100, params);
+    REQUIRE(queries.size() == 500);
+    std::size_t first_term = 0;
+    for (auto query: queries) {
+        REQUIRE(not query.empty());
+        REQUIRE(query.size() <= 6);
+        std::sort(query.begin(), query.end());
+        REQUIRE(std::adjacent_find(query.begin(), query.end()) == query.end());
+        REQUIRE(query.back() < 100);
+        first_term += static_cast<std::size_t>(query.front() == 0);
+    }
+    // The most frequent term is the most likely to be drawn.
+    REQUIRE(first_term > 0);
+    REQUIRE(synthetic_queries(100, params) == queries);
+    REQUIRE_THROWS_AS(synthetic_queries(0, params), std::invalid_argument);
+}
@@ -0,0 +1,133 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "util/task_graph.hpp"
+
+using namespace pisa;
+
+namespace {
+
+void wait_a_little() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }
+
+}  // namespace
+
+TEST_CASE("Tasks run after their dependencies", "[task_graph]")
+{
+    task_graph graph;
+    std::mutex mutex;
+    std::vector<task_graph::task_id> order;
+    auto record = [&](task_graph::task_id id) {
+        return [&, id] {
+            wait_a_little();
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(id);
+        };
+    };
+    // Shards of three stages each, with a final task depending on the first stage of all shards.
+    std::vector<std::vector<task_graph::task_id>> dependencies;
+    std::vector<task_graph::task_id> first_stages;
+    for (std::size_t shard = 0; shard < 8; ++shard) {
+        auto first = graph.add("first", record(graph.size()), {1, 0});
+        dependencies.push_back({});
+        auto second = graph.add("second", record(graph.size()), {1, 0}, {first});
+        dependencies.push_back({first});
+        graph.add("third", record(graph.size()), {1, 0}, {second});
+        dependencies.push_back({second});
+        first_stages.push_back(first);
+    }
+    graph.add("all", record(graph.size()), {1, 0}, first_stages);
+    dependencies.push_back(first_stages);
+
+    graph.run({4, 0});
+    REQUIRE(order.size() == graph.size());
+    std::vector<std::size_t> position(graph.size());
+    for (std::size_t pos = 0; pos < order.size(); ++pos) {
+        position[order[pos]] = pos;
+    }
+    for (task_graph::task_id id = 0; id < graph.size(); ++id) {
+        for (auto dependency: dependencies[id]) {
+            REQUIRE(position[dependency] < position[id]);
+        }
+    }
+}
+
+TEST_CASE("Tasks run within the budget", "[task_graph]")
+{
+    task_graph graph;
+    std::atomic<std::size_t> threads{0};
+    std::atomic<std::size_t> memory{0};
+    std::atomic<bool> exceeded{false};
+    std::atomic<std::size_t> most_threads{0};
+    auto task = [&](task_graph::resources needs) {
+        return [&, needs] {
+            auto t = threads += needs.threads;
+            auto m = memory += needs.memory;
+            if (t > 8 || m > 100) {
+                exceeded = true;
+            }
+            auto previous = most_threads.load();
+            while (previous < t && not most_threads.compare_exchange_weak(previous, t)) {
+            }
+            wait_a_little();
+            threads -= needs.threads;
+            memory -= needs.memory;
+        };
+    };
+    for (std::size_t i = 0; i < 32; ++i) {
+        task_graph::resources needs{1 + i % 4, 10 + 20 * (i % 3)};
+        graph.add("task", task(needs), needs);
+    }
+    graph.run({8, 100});
+    REQUIRE_FALSE(exceeded);
+    REQUIRE(most_threads > 1);
+}
+
+TEST_CASE("Tasks exceeding the budget run alone", "[task_graph]")
+{
+    task_graph graph;
+    std::atomic<std::size_t> running{0};
+    std::atomic<bool> shared{false};
+    graph.add("small", [] { wait_a_little(); }, {1, 10});
+    graph.add(
+        "large",
+        [&] {
+            if (++running > 1) {
+                shared = true;
+            }
+            wait_a_little();
+            --running;
+        },
+        {1, 1000});
+    graph.add("small", [] { wait_a_little(); }, {1, 10});
+    graph.run({4, 100});
+    REQUIRE_FALSE(shared);
+}
+
+TEST_CASE("Higher priority tasks start first", "[task_graph]")
+{
+    task_graph graph;
+    std::vector<int> order;
+    for (int priority: {0, 2, 1}) {
+        graph.add("task", [&, priority] { order.push_back(priority); }, {1, 0}, {}, priority);
+    }
+    graph.run({1, 0});
+    REQUIRE(order == std::vector<int>{2, 1, 0});
+}
+
+TEST_CASE("A failing task stops the graph", "[task_graph]")
+{
+    task_graph graph;
+    std::atomic<bool> dependent_ran{false};
+    auto failing = graph.add("failing", [] { throw std::runtime_error("failed"); }, {1, 0});
+    graph.add("dependent", [&] { dependent_ran = true; }, {1, 0}, {failing});
+    REQUIRE_THROWS_AS(graph.run({2, 0}), std::runtime_error);
+    REQUIRE_FALSE(dependent_ran);
+    REQUIRE_THROWS_AS(graph.add("invalid", [] {}, {1, 0}, {5}), std::invalid_argument);
+}
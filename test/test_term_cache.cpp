@@ -0,0 +1,85 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <cctype>
+#include <string>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "term_cache.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto upper(std::string const& token) -> std::string
+{
+    std::string term;
+    for (char ch: token) {
+        term.push_back(static_cast<char>(std::toupper(ch)));
+    }
+    return term;
+}
+
+}  // namespace
+
+TEST_CASE("Memoize processed tokens")
+{
+    term_cache<std::string> cache(2);
+    std::vector<std::string> computed;
+    auto process = [&](std::string const& token) {
+        computed.push_back(token);
+        return upper(token);
+    };
+    REQUIRE(cache.get_or_compute("a", process) == "A");
+    REQUIRE(cache.get_or_compute("b", process) == "B");
+    REQUIRE(cache.get_or_compute("a", process) == "A");
+    // Rotates: "a" and "b" move to the previous generation.
+    REQUIRE(cache.get_or_compute("c", process) == "C");
+    // Promotes "a" back to the current generation.
+    REQUIRE(cache.get_or_compute("a", process) == "A");
+    // Rotates again, dropping "b", which was not used since the last rotation.
+    REQUIRE(cache.get_or_compute("d", process) == "D");
+    REQUIRE(cache.get_or_compute("a", process) == "A");
+    REQUIRE(cache.get_or_compute("b", process) == "B");
+    REQUIRE(computed == std::vector<std::string>{"a", "b", "c", "d", "b"});
+    REQUIRE(cache.hits() == 3);
+    REQUIRE(cache.misses() == 5);
+    REQUIRE(cache.hit_rate() == Approx(0.375));
+}
+
+TEST_CASE("Zero capacity disables term caching")
+{
+    term_cache<std::string> cache(0);
+    std::size_t computed = 0;
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(cache.get_or_compute("a", [&](std::string const& token) {
+            computed += 1;
+            return upper(token);
+        }) == "A");
+    }
+    REQUIRE(computed == 3);
+    REQUIRE(cache.hits() + cache.misses() == 0);
+}
+
+TEST_CASE("Cache processed tokens in every thread")
+{
+    tbb::task_scheduler_init init;
+    term_cache<std::string> cache(4);
+    std::atomic_size_t computed{0};
+    std::vector<std::string> terms(1000);
+    tbb::parallel_for(size_t(0), terms.size(), [&](size_t idx) {
+        terms[idx] = cache.get_or_compute(std::to_string(idx % 10), [&](std::string const& token) {
+            computed += 1;
+            return token + "!";
+        });
+    });
+    for (size_t idx = 0; idx < terms.size(); ++idx) {
+        REQUIRE(terms[idx] == std::to_string(idx % 10) + "!");
+    }
+    REQUIRE(cache.hits() + cache.misses() == terms.size());
+    REQUIRE(cache.misses() == computed.load());
+}
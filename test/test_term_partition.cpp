@@ -0,0 +1,155 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <fmt/format.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "accumulator/lazy_accumulator.hpp"
+#include "accumulator/simple_accumulator.hpp"
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "term_partition.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Terms are assigned to nodes by capacity", "[term_partition]")
+{
+    std::vector<std::uint64_t> list_sizes{10, 100, 50, 50, 10};
+    std::vector<double> equal{1, 1};
+    auto nodes = assign_terms_to_nodes(list_sizes, equal);
+    std::vector<std::uint64_t> loads(2, 0);
+    for (std::size_t term = 0; term < list_sizes.size(); ++term) {
+        loads[nodes[term]] += list_sizes[term];
+    }
+    REQUIRE(loads == std::vector<std::uint64_t>{110, 110});
+
+    // the longest list goes to the node with the largest capacity
+    std::vector<double> unequal{1, 3};
+    nodes = assign_terms_to_nodes(list_sizes, unequal);
+    REQUIRE(nodes[1] == 1);
+
+    term_partition partition(std::vector<std::uint32_t>{1, 0, 1, 1, 0}, 3);
+    REQUIRE(partition.node_count() == 3);
+    REQUIRE(partition.local_term(0) == 0);
+    REQUIRE(partition.local_term(1) == 0);
+    REQUIRE(partition.local_term(3) == 2);
+    REQUIRE(partition.local_term(4) == 1);
+    Query query{std::nullopt, {3, 1, 4}, {}};
+    auto node_queries = partition.split(query);
+    REQUIRE(node_queries.size() == 3);
+    REQUIRE(node_queries[0].terms == std::vector<term_id_type>{0, 1});
+    REQUIRE(node_queries[1].terms == std::vector<term_id_type>{2});
+    REQUIRE(node_queries[2].terms.empty());
+
+    REQUIRE_THROWS_AS(assign_terms_to_nodes(list_sizes, {}), std::invalid_argument);
+}
+
+template <typename Acc>
+void test_pipelined_query()
+{
+    tbb::task_scheduler_init init;
+    std::string input(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_freq_collection collection(input.c_str());
+    binary_collection document_sizes((input + ".sizes").c_str());
+    auto build = [](binary_freq_collection const& lists, auto& index) {
+        global_parameters params;
+        typename std::decay_t<decltype(index)>::builder builder(lists.num_docs(), params);
+        for (auto const& plist: lists) {
+            uint64_t freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+        }
+        builder.build(index);
+    };
+    auto make_wand_data = [&](binary_freq_collection const& lists) {
+        return std::make_unique<wand_data<wand_data_raw>>(
+            document_sizes.begin()->begin(),
+            lists.num_docs(),
+            lists,
+            "bm25",
+            BlockSize(FixedBlock(5)),
+            false,
+            std::unordered_set<size_t>{});
+    };
+    ef_index index;
+    build(collection, index);
+    auto wdata = make_wand_data(collection);
+
+    std::vector<std::uint64_t> list_sizes;
+    for (auto const& list: collection) {
+        list_sizes.push_back(list.docs.size());
+    }
+    std::size_t node_count = 3;
+    Temporary_Directory tmpdir;
+    auto output = (tmpdir.path() / "nodes").string();
+    term_partition partition(
+        assign_terms_to_nodes(list_sizes, std::vector<double>(node_count, 1.0)), node_count);
+    partition_terms(input, output, partition);
+    auto loaded = term_partition::from_file(output + ".nodes", node_count);
+    for (std::uint32_t term = 0; term < list_sizes.size(); ++term) {
+        REQUIRE(loaded.node(term) == partition.node(term));
+    }
+
+    std::vector<ef_index> node_indexes(node_count);
+    std::vector<std::unique_ptr<wand_data<wand_data_raw>>> node_wdata;
+    for (std::size_t node = 0; node < node_count; ++node) {
+        binary_freq_collection lists(fmt::format("{}.{:03d}", output, node).c_str());
+        build(lists, node_indexes[node]);
+        node_wdata.push_back(make_wand_data(lists));
+    }
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    auto scorer = scorer::from_name("bm25", *wdata);
+    std::vector<std::unique_ptr<index_scorer<wand_data<wand_data_raw>>>> node_scorers;
+    for (auto const& node_data: node_wdata) {
+        node_scorers.push_back(scorer::from_name("bm25", *node_data));
+    }
+    std::vector<Acc> accumulators(3, Acc(128));
+    for (auto const& query: queries) {
+        topk_queue expected(10);
+        ranked_or_query ranked_or_q(expected);
+        ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
+        expected.finalize();
+
+        auto node_queries = partition.split(query);
+        using cursor_type = decltype(make_scored_cursors(index, *scorer, query));
+        std::vector<cursor_type> node_cursors;
+        for (std::size_t node = 0; node < node_count; ++node) {
+            node_cursors.push_back(
+                make_scored_cursors(node_indexes[node], *node_scorers[node], node_queries[node]));
+        }
+        topk_queue actual(10);
+        pipelined_taat_query pipelined_q(actual, 128);
+        pipelined_q(node_cursors, index.num_docs(), accumulators);
+        actual.finalize();
+
+        REQUIRE(actual.topk().size() == expected.topk().size());
+        for (std::size_t idx = 0; idx < expected.topk().size(); ++idx) {
+            REQUIRE(actual.topk()[idx].first == Approx(expected.topk()[idx].first).epsilon(0.01));
+        }
+    }
+}
+
+TEST_CASE("Pipelined query over term-partitioned nodes", "[term_partition][query]")
+{
+    SECTION("Simple accumulator") { test_pipelined_query<Simple_Accumulator>(); }
+    SECTION("Lazy accumulator") { test_pipelined_query<Lazy_Accumulator<4>>(); }
+}
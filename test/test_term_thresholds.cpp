@@ -0,0 +1,101 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "term_thresholds.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Term thresholds are safe initial thresholds", "[term_thresholds][query][integration]")
+{
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+
+    global_parameters params;
+    block_interpolative_index index;
+    block_interpolative_index::builder builder(collection.num_docs(), params);
+    for (auto const& plist: collection) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    builder.build(index);
+
+    std::vector<Query> queries;
+    std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(
+        qfile, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    bm25<wand_data<wand_data_raw>> scorer(wdata);
+    term_thresholds built;
+    term_thresholds::build(index, scorer, {100, 10}, built);
+    Temporary_Directory tmpdir;
+    auto thresholds_path = (tmpdir.path() / "thresholds").string();
+    mapper::freeze(built, thresholds_path.c_str());
+    term_thresholds thresholds;
+    mio::mmap_source source(thresholds_path.c_str());
+    mapper::map(thresholds, source);
+    REQUIRE(std::vector<uint64_t>(thresholds.ks().begin(), thresholds.ks().end())
+            == std::vector<uint64_t>{10, 100});
+    REQUIRE(thresholds.max_k() == 100);
+    REQUIRE(thresholds.size() == index.size());
+    REQUIRE(thresholds.estimate(queries.front(), 1000) == 0.0F);
+
+    term_thresholds from_collection;
+    term_thresholds::build(collection, scorer, {10, 100}, {}, from_collection);
+    REQUIRE(from_collection.size() == thresholds.size());
+    for (term_id_type term = 0; term < thresholds.size(); ++term) {
+        REQUIRE(from_collection.score(term, 0) == thresholds.score(term, 0));
+        REQUIRE(from_collection.score(term, 1) == thresholds.score(term, 1));
+        REQUIRE(thresholds.score(term, 1) <= thresholds.score(term, 0));
+    }
+
+    std::size_t seeded = 0;
+    for (auto const& query: queries) {
+        topk_queue expected(10);
+        wand_query expected_q(expected);
+        expected_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        expected.finalize();
+
+        REQUIRE(thresholds.estimate(query, 5) == thresholds.estimate(query, 10));
+        auto threshold = thresholds.estimate(query, 10);
+        if (threshold > 0) {
+            seeded += 1;
+            REQUIRE(expected.topk().size() == 10);
+            REQUIRE(threshold <= expected.topk().back().first);
+        }
+
+        topk_queue topk(10);
+        topk.set_threshold(threshold);
+        wand_query wand_q(topk);
+        wand_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        topk.finalize();
+        REQUIRE(topk.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < topk.topk().size(); ++i) {
+            REQUIRE(topk.topk()[i].first == Approx(expected.topk()[i].first));
+        }
+    }
+    REQUIRE(seeded > 0);
+}
@@ -2,6 +2,7 @@
 
 #include <catch2/catch.hpp>
 #include <functional>
+#include <random>
 
 #include <boost/iterator/filter_iterator.hpp>
 #include <boost/spirit/include/lex_lexertl.hpp>
@@ -24,6 +25,32 @@ TEST_CASE("TermTokenizer")
             "a", "1", "12", "w0rd", "token", "izer", "pup", "USa", "us", "hel", "lo"});
 }
 
+TEST_CASE("FastTermTokenizer produces the same terms as TermTokenizer")
+{
+    auto tokenize = [](std::string const& str) {
+        TermTokenizer tokenizer(str);
+        FastTermTokenizer fast_tokenizer(str);
+        return std::make_pair(
+            std::vector<std::string>(tokenizer.begin(), tokenizer.end()),
+            std::vector<std::string>(fast_tokenizer.begin(), fast_tokenizer.end()));
+    };
+    {
+        auto [expected, actual] = tokenize("a 1 12 w0rd, token-izer. pup's, U.S.a., us., hel.lo");
+        REQUIRE(actual == expected);
+    }
+    std::mt19937 gen(1902);
+    std::string alphabet = "abcdefghijXYZ0123456789.'.' -\n\xc3\xa9";
+    std::uniform_int_distribution<std::size_t> letter(0, alphabet.size() - 1);
+    std::uniform_int_distribution<std::size_t> length(0, 80);
+    for (int i = 0; i < 10000; ++i) {
+        std::string str(length(gen), ' ');
+        std::generate(str.begin(), str.end(), [&] { return alphabet[letter(gen)]; });
+        CAPTURE(str);
+        auto [expected, actual] = tokenize(str);
+        REQUIRE(actual == expected);
+    }
+}
+
 TEST_CASE("Parse query terms to ids")
 {
     Temporary_Directory tmpdir;
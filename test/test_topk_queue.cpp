@@ -0,0 +1,121 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+
+#include "concurrent_topk_queue.hpp"
+#include "topk_queue.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Top-k queue keeps the highest scores", "[topk_queue]")
+{
+    auto k = GENERATE(
+        as<uint64_t>{}, 1, 10, topk_queue::sorted_max_k, 17, topk_queue::buffered_min_k, 1000);
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> dist(0.0F, 100.0F);
+    std::vector<std::pair<float, uint64_t>> entries;
+    for (uint64_t docid = 0; docid < 10'000; ++docid) {
+        entries.emplace_back(dist(gen), docid);
+    }
+
+    topk_queue topk(k);
+    REQUIRE(topk.is_sorted() == (k <= topk_queue::sorted_max_k));
+    REQUIRE(topk.is_buffered() == (k >= topk_queue::buffered_min_k));
+    for (auto [score, docid]: entries) {
+        auto threshold = topk.threshold();
+        REQUIRE(topk.insert(score, docid) == (score >= threshold));
+        REQUIRE(topk.threshold() >= threshold);
+    }
+    auto threshold = topk.threshold();
+    topk.finalize();
+
+    std::sort(entries.begin(), entries.end(), topk_queue::min_heap_order);
+    entries.resize(k);
+    REQUIRE(topk.topk() == entries);
+    REQUIRE(threshold <= entries.back().first);
+}
+
+TEST_CASE("Top-k queue drops non-positive scores", "[topk_queue]")
+{
+    auto k = GENERATE(as<uint64_t>{}, 2, 10, 100, topk_queue::buffered_min_k);
+    topk_queue topk(k);
+    topk.insert(2.0F, 1);
+    topk.insert(0.0F, 2);
+    topk.insert(1.0F, 3);
+    topk.finalize();
+    REQUIRE(topk.topk() == std::vector<std::pair<float, uint64_t>>{{2.0F, 1}, {1.0F, 3}});
+    topk.clear();
+    REQUIRE(topk.topk().empty());
+    REQUIRE(topk.threshold() == 0.0F);
+}
+
+TEST_CASE("Top-k queue gives the scores at smaller ranks", "[topk_queue]")
+{
+    auto k = GENERATE(as<uint64_t>{}, 10, topk_queue::buffered_min_k);
+    topk_queue topk(k);
+    std::vector<float> scores;
+    for (uint64_t docid = 0; docid < 3 * k; ++docid) {
+        scores.push_back(float((docid * 7919) % 1000 + 1));
+        topk.insert(scores.back(), docid);
+    }
+    topk.finalize();
+    std::sort(scores.begin(), scores.end(), std::greater<>());
+    for (uint64_t rank: {uint64_t(1), k / 2, k}) {
+        REQUIRE(topk.score_at_rank(rank) == scores[rank - 1]);
+    }
+    REQUIRE(topk.score_at_rank(0) == 0.0F);
+    REQUIRE(topk.score_at_rank(k + 1) == 0.0F);
+}
+
+TEST_CASE("Top-k queues sharing a threshold", "[topk_queue]")
+{
+    basic_shared_threshold<float> shared(1.0F);
+    shared.raise(0.5F);
+    REQUIRE(shared.load() == 1.0F);
+
+    topk_queue first(2);
+    topk_queue second(2);
+    first.share_threshold(&shared);
+    second.share_threshold(&shared);
+    REQUIRE(first.threshold() == 1.0F);
+    REQUIRE_FALSE(first.insert(0.5F, 1));
+    first.insert(4.0F, 2);
+    first.insert(3.0F, 3);
+    // the k-th score of the first queue is published to the second one
+    REQUIRE(shared.load() == 3.0F);
+    REQUIRE(second.threshold() == 3.0F);
+    REQUIRE_FALSE(second.insert(2.0F, 4));
+    REQUIRE(second.insert(5.0F, 5));
+    second.clear();
+    REQUIRE(second.threshold() == 3.0F);
+}
+
+TEST_CASE("Concurrent top-k queue keeps the highest scores of all threads", "[topk_queue]")
+{
+    auto k = GENERATE(as<uint64_t>{}, 1, 10, topk_queue::buffered_min_k);
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> dist(0.0F, 100.0F);
+    std::vector<std::pair<float, uint64_t>> entries;
+    for (uint64_t docid = 0; docid < 100'000; ++docid) {
+        entries.emplace_back(dist(gen), docid);
+    }
+
+    concurrent_topk_queue topk(k);
+    tbb::parallel_for(std::size_t(0), entries.size(), [&](std::size_t idx) {
+        topk.local().insert(entries[idx].first, entries[idx].second);
+    });
+    auto results = topk.topk();
+
+    // equal scores may come in any order
+    std::sort(entries.begin(), entries.end(), std::greater<>());
+    entries.resize(k);
+    std::sort(results.begin(), results.end(), std::greater<>());
+    REQUIRE(results == entries);
+    REQUIRE(topk.threshold() <= entries.back().first);
+}
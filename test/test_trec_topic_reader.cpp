@@ -144,3 +144,32 @@ TEST_CASE("Invalid topic", "[unit]")
         REQUIRE_THROWS(reader.next_topic());
     }
 }
+
+TEST_CASE("Read topics in parallel chunks", "[unit]")
+{
+    std::string text;
+    for (int num = 300; num < 400; ++num) {
+        text += "<top>\n<num> Number: " + std::to_string(num) + "\n<title> title "
+            + std::to_string(num) + "\n<desc> Description:\nSome description.\n"
+            + "<narr> Narrative:\nSome narrative.\n</top>\n\n";
+    }
+    auto chunk_size = GENERATE(as<std::size_t>{}, 1, 50, 1000, 1U << 20U);
+    CAPTURE(chunk_size);
+
+    auto offsets = pisa::topic_chunks(text, chunk_size);
+    REQUIRE(offsets.front() == 0);
+    REQUIRE(offsets.back() == text.size());
+    for (std::size_t chunk = 1; chunk + 1 < offsets.size(); ++chunk) {
+        REQUIRE(text.compare(offsets[chunk], 5, "<top>") == 0);
+        REQUIRE(offsets[chunk] - offsets[chunk - 1] >= chunk_size);
+    }
+
+    auto nums = pisa::transform_topics(
+        text,
+        [](pisa::trec_topic const& topic) { return topic.num + ":" + topic.title; },
+        chunk_size);
+    REQUIRE(nums.size() == 100);
+    for (int num = 300; num < 400; ++num) {
+        REQUIRE(nums[num - 300] == std::to_string(num) + ":title " + std::to_string(num));
+    }
+}
@@ -2,6 +2,7 @@
 #include "catch2/catch.hpp"
 
 #include <functional>
+#include <unordered_map>
 
 #include <range/v3/view/iota.hpp>
 #include <range/v3/view/zip.hpp>
@@ -13,6 +14,7 @@
 #include "pisa_config.hpp"
 #include "query/queries.hpp"
 #include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
 #include "wand_data_range.hpp"
 
 #include "scorer/scorer.hpp"
@@ -128,3 +130,363 @@ TEST_CASE("wand_data_range")
         }
     }
 }
+
+TEST_CASE("Quantized norm lengths")
+{
+    tbb::task_scheduler_init init;
+    using WandType = wand_data<wand_data_raw>;
+
+    auto scorer_name = "bm25";
+    auto bits = GENERATE(uint8_t(8), uint8_t(16));
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids;
+    WandType exact(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        scorer_name,
+        BlockSize(FixedBlock(5)),
+        false,
+        dropped_term_ids);
+    WandType quantized(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        scorer_name,
+        BlockSize(FixedBlock(5)),
+        false,
+        dropped_term_ids,
+        bits);
+
+    REQUIRE_FALSE(exact.has_quantized_norm_lens());
+    REQUIRE(quantized.has_quantized_norm_lens());
+
+    float tolerance = bits == 8 ? 0.01 : 0.0001;
+    for (size_t doc = 0; doc < collection.num_docs(); ++doc) {
+        for (uint64_t freq: {1, 3, 20}) {
+            REQUIRE(
+                bm25<WandType>::doc_term_weight(freq, quantized.norm_len(doc))
+                == Approx(bm25<WandType>::doc_term_weight(freq, exact.norm_len(doc)))
+                       .epsilon(tolerance));
+        }
+    }
+
+    auto scorer = scorer::from_name(scorer_name, quantized);
+    size_t term_id = 0;
+    for (auto const& seq: collection) {
+        auto w = quantized.getenum(term_id);
+        auto s = scorer->term_scorer(term_id);
+        for (auto&& [docid, freq]: ranges::views::zip(seq.docs, seq.freqs)) {
+            w.next_geq(docid);
+            REQUIRE(w.score() >= s(docid, freq));
+        }
+        term_id += 1;
+    }
+}
+
+TEST_CASE("Block scoring matches per-posting scoring", "[scorer]")
+{
+    tbb::task_scheduler_init init;
+    using WandType = wand_data<wand_data_raw>;
+
+    auto scorer_name = GENERATE(
+        std::string("bm25"), std::string("qld"), std::string("pl2"), std::string("dph"));
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    WandType wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        scorer_name,
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        size_t term_id = 0;
+        for (auto const& seq: collection) {
+            std::vector<uint32_t> docs(seq.docs.begin(), seq.docs.end());
+            std::vector<uint32_t> freqs(seq.freqs.begin(), seq.freqs.end());
+            std::vector<float> scores(docs.size());
+            auto term_scorer = make_weighted_term_scorer(scorer, term_id, 2.0);
+            score_postings(term_scorer, docs, freqs, scores);
+            for (size_t i = 0; i < docs.size(); ++i) {
+                REQUIRE(scores[i] == Approx(term_scorer(docs[i], freqs[i])));
+            }
+            term_id += 1;
+        }
+    });
+}
+
+TEST_CASE("Variable blocks of long lists are partitioned by segments", "[wand_data]")
+{
+    tbb::task_scheduler_init init;
+    using WandType = wand_data<wand_data_raw>;
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    WandType wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+
+    auto segment_size = GENERATE(std::size_t(16), std::size_t(100), variable_block_segment_size);
+    scorer::with_scorer("bm25", wdata, [&](auto const& scorer) {
+        size_t term_id = 0;
+        for (auto const& seq: collection) {
+            auto term_scorer = scorer.term_scorer(term_id);
+            auto [block_docids, block_maxes] = variable_block_partition(
+                collection, seq, term_scorer, 12.0, 0.01, 0.4, segment_size);
+            REQUIRE(block_docids.size() == block_maxes.size());
+            REQUIRE(block_docids.back() == *(seq.docs.end() - 1));
+            REQUIRE(std::is_sorted(block_docids.begin(), block_docids.end()));
+            // every block max is that of the postings up to its last docid
+            size_t block = 0;
+            float max = 0;
+            auto freq = seq.freqs.begin();
+            for (auto doc = seq.docs.begin(); doc != seq.docs.end(); ++doc, ++freq) {
+                if (*doc > block_docids[block]) {
+                    REQUIRE(block_maxes[block] == max);
+                    block += 1;
+                    max = 0;
+                }
+                max = std::max(max, term_scorer(*doc, *freq));
+            }
+            REQUIRE(block + 1 == block_docids.size());
+            REQUIRE(block_maxes.back() == max);
+            term_id += 1;
+        }
+    });
+}
+
+TEST_CASE("Quantizing WAND data matches building it quantized")
+{
+    tbb::task_scheduler_init init;
+    using WandType = wand_data<wand_data_raw>;
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids;
+    auto build = [&](bool is_quantized) {
+        return WandType(
+            document_sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            "bm25",
+            BlockSize(FixedBlock(5)),
+            is_quantized,
+            dropped_term_ids);
+    };
+    WandType exact = build(false);
+    WandType expected = build(true);
+    WandType quantized;
+    exact.quantize(quantized);
+
+    REQUIRE(quantized.num_docs() == expected.num_docs());
+    REQUIRE(quantized.avg_len() == expected.avg_len());
+    REQUIRE(quantized.index_max_term_weight() == expected.index_max_term_weight());
+    for (size_t doc = 0; doc < collection.num_docs(); ++doc) {
+        REQUIRE(quantized.norm_len(doc) == expected.norm_len(doc));
+    }
+    size_t term_id = 0;
+    for (auto const& seq: collection) {
+        REQUIRE(quantized.max_term_weight(term_id) == expected.max_term_weight(term_id));
+        REQUIRE(quantized.term_posting_count(term_id) == expected.term_posting_count(term_id));
+        auto actual_blocks = quantized.getenum(term_id);
+        auto expected_blocks = expected.getenum(term_id);
+        for (auto docid: seq.docs) {
+            actual_blocks.next_geq(docid);
+            expected_blocks.next_geq(docid);
+            REQUIRE(actual_blocks.docid() == expected_blocks.docid());
+            REQUIRE(actual_blocks.score() == expected_blocks.score());
+        }
+        term_id += 1;
+    }
+}
+
+TEST_CASE("WAND data quantized to buckets bounds the weights of the codes", "[wand_data]")
+{
+    tbb::task_scheduler_init init;
+    using WandType = wand_data<wand_data_raw>;
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    WandType exact(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        BlockSize(FixedBlock(5)),
+        false,
+        {});
+    auto quantizer = bucket_quantizer::logarithmic(exact.index_max_term_weight(), 6);
+    WandType bucketed;
+    exact.quantize(bucketed, quantizer);
+    REQUIRE(bucketed.impact_weights().size() == 65);
+    REQUIRE(exact.impact_weights().empty());
+
+    bm25<WandType> scorer(exact);
+    quantized<WandType> code_scorer(bucketed);
+    size_t term_id = 0;
+    for (auto const& seq: collection) {
+        auto term_scorer = scorer.term_scorer(term_id);
+        auto code_term_scorer = make_term_scorer(code_scorer, term_id);
+        auto blocks = bucketed.getenum(term_id);
+        for (auto&& [docid, freq]: ranges::views::zip(seq.docs, seq.freqs)) {
+            auto score = code_term_scorer(docid, quantizer(term_scorer(docid, freq)));
+            blocks.next_geq(docid);
+            REQUIRE(blocks.score() >= score);
+            REQUIRE(bucketed.max_term_weight(term_id) >= score);
+        }
+        term_id += 1;
+    }
+}
+
+TEST_CASE("BM25 bounds from block impacts", "[wand_data]")
+{
+    tbb::task_scheduler_init init;
+    using WandType = wand_data<wand_data_raw>;
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    auto block_size = GENERATE(BlockSize(FixedBlock(5)), BlockSize(VariableBlock(12.0)));
+    WandType wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        "bm25",
+        block_size,
+        false,
+        {});
+    WandType without_impacts;
+    REQUIRE_THROWS_AS(wdata.bm25_bounds(without_impacts, 0.9, 0.4), std::logic_error);
+    wdata.store_block_impacts(collection, {});
+
+    auto [k1, b] = GENERATE(std::make_pair(0.9F, 0.4F), std::make_pair(1.2F, 0.75F));
+    WandType bounds;
+    wdata.bm25_bounds(bounds, k1, b);
+    REQUIRE(bounds.num_docs() == wdata.num_docs());
+    size_t term_id = 0;
+    for (auto const& seq: collection) {
+        auto term_weight = bm25<WandType>::query_term_weight(seq.docs.size(), wdata.num_docs(), k1);
+        auto exact_blocks = wdata.getenum(term_id);
+        auto blocks = bounds.getenum(term_id);
+        for (auto&& [docid, freq]: ranges::views::zip(seq.docs, seq.freqs)) {
+            float score =
+                term_weight * bm25<WandType>::doc_term_weight(freq, wdata.norm_len(docid), k1, b);
+            blocks.next_geq(docid);
+            exact_blocks.next_geq(docid);
+            REQUIRE(blocks.docid() == exact_blocks.docid());
+            REQUIRE(blocks.score() >= score);
+            REQUIRE(bounds.max_term_weight(term_id) >= score);
+            if (k1 == bm25<WandType>::k1 && b == bm25<WandType>::b) {
+                REQUIRE(blocks.score() >= Approx(exact_blocks.score()));
+            }
+        }
+        term_id += 1;
+    }
+}
+
+TEMPLATE_TEST_CASE(
+    "WAND data does not depend on the number of threads",
+    "[wand_data]",
+    wand_data<wand_data_raw>,
+    wand_data<wand_data_compressed<>>,
+    (wand_data<wand_data_range<64, 1024>>))
+{
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids{1, 10, 100};
+    auto block_size = GENERATE(BlockSize(FixedBlock(5)), BlockSize(VariableBlock(12.0)));
+    auto build = [&](int threads) {
+        tbb::task_scheduler_init init(threads);
+        return TestType(
+            document_sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            "bm25",
+            block_size,
+            false,
+            dropped_term_ids);
+    };
+    auto sequential = build(1);
+    auto parallel = build(4);
+    // Range data stores the blocks of long lists only.
+    constexpr bool short_lists_have_blocks =
+        not std::is_same_v<TestType, wand_data<wand_data_range<64, 1024>>>;
+
+    REQUIRE(parallel.index_max_term_weight() == sequential.index_max_term_weight());
+    size_t term_id = 0;
+    size_t new_term_id = 0;
+    for (auto const& seq: collection) {
+        if (dropped_term_ids.find(term_id++) != dropped_term_ids.end()) {
+            continue;
+        }
+        REQUIRE(parallel.max_term_weight(new_term_id) == sequential.max_term_weight(new_term_id));
+        REQUIRE(
+            parallel.term_occurrence_count(new_term_id)
+            == sequential.term_occurrence_count(new_term_id));
+        REQUIRE(parallel.term_posting_count(new_term_id) == seq.docs.size());
+        if (short_lists_have_blocks or seq.docs.size() >= 1024) {
+            auto expected_blocks = sequential.getenum(new_term_id);
+            auto actual_blocks = parallel.getenum(new_term_id);
+            for (auto docid: seq.docs) {
+                expected_blocks.next_geq(docid);
+                actual_blocks.next_geq(docid);
+                REQUIRE(actual_blocks.docid() == expected_blocks.docid());
+                REQUIRE(actual_blocks.score() == expected_blocks.score());
+            }
+        }
+        new_term_id += 1;
+    }
+}
+
+TEST_CASE("Compressed block-max enumerator skips within and across its window", "[wand_data]")
+{
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids;
+    auto build = [&](auto wand_type) {
+        return decltype(wand_type)(
+            document_sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            "bm25",
+            BlockSize(FixedBlock(5)),
+            false,
+            dropped_term_ids);
+    };
+    auto raw = build(wand_data<wand_data_raw>{});
+    auto compressed = build(wand_data<wand_data_compressed<>>{});
+
+    size_t term_id = 0;
+    for (auto const& seq: collection) {
+        // Scores of the blocks, ending at their docid, visited one posting at a time.
+        std::unordered_map<uint64_t, float> block_scores;
+        auto dense = compressed.getenum(term_id);
+        for (auto docid: seq.docs) {
+            dense.next_geq(docid);
+            block_scores.emplace(dense.docid(), dense.score());
+        }
+        for (size_t stride: {1, 3, 17, 100}) {
+            auto expected = raw.getenum(term_id);
+            auto actual = compressed.getenum(term_id);
+            for (size_t pos = 0; pos < seq.docs.size(); pos += stride) {
+                expected.next_geq(seq.docs[pos]);
+                actual.next_geq(seq.docs[pos]);
+                REQUIRE(actual.docid() == expected.docid());
+                REQUIRE(actual.score() == block_scores.at(actual.docid()));
+            }
+            actual.next_geq(collection.num_docs());
+            REQUIRE(actual.docid() >= collection.num_docs());
+        }
+        term_id += 1;
+    }
+}
@@ -0,0 +1,155 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <zlib.h>
+
+#include "parsing/warc.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+using namespace pisa::parsing::warc;
+
+namespace {
+
+auto warc_record(std::string const& type, std::string const& trecid, std::string const& body)
+    -> std::string
+{
+    auto block = fmt::format("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n{}", body);
+    std::string header = fmt::format("WARC/1.0\r\nWARC-Type: {}\r\n", type);
+    if (not trecid.empty()) {
+        header += fmt::format("WARC-TREC-ID: {}\r\n", trecid);
+    }
+    header += fmt::format(
+        "WARC-Target-URI: http://{}.com\r\nContent-Length: {}\r\n\r\n", trecid, block.size());
+    return header + block + "\r\n\r\n";
+}
+
+/// Writes each of `members` as a separate gzip member, as in ClueWeb files.
+void write_gzip(std::string const& path, std::vector<std::string> const& members)
+{
+    std::ofstream os(path, std::ios::binary);
+    for (auto const& member: members) {
+        z_stream zs{};
+        REQUIRE(deflateInit2(&zs, 6, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        std::string out(deflateBound(&zs, member.size()) + 32, '\0');
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(member.data()));
+        zs.avail_in = member.size();
+        zs.next_out = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = out.size();
+        REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+        os.write(out.data(), out.size() - zs.avail_out);
+        deflateEnd(&zs);
+    }
+}
+
+auto read_all(Record_Reader& reader) -> std::vector<std::string>
+{
+    std::vector<std::string> titles;
+    while (auto record = reader.next()) {
+        titles.push_back(record->title());
+    }
+    return titles;
+}
+
+}  // namespace
+
+TEST_CASE("Read WARC records from plain and gzip files", "[parsing][warc]")
+{
+    Temporary_Directory tmpdir;
+    std::vector<std::string> records{
+        "WARC/1.0\r\nWARC-Type: warcinfo\r\nContent-Length: 4\r\n\r\ninfo\r\n\r\n",
+        warc_record("response", "doc-0", "<p>first document</p>"),
+        warc_record("request", "doc-1", "ignored"),
+        warc_record("response", "", "no trec id"),
+        warc_record("response", "doc-2", std::string(3000, 'x'))};
+    std::string contents;
+    for (auto const& record: records) {
+        contents += record;
+    }
+    auto plain = (tmpdir.path() / "plain.warc").string();
+    std::ofstream(plain, std::ios::binary) << contents;
+    auto gzip = (tmpdir.path() / "records.warc.gz").string();
+    write_gzip(gzip, records);
+
+    for (auto const& path: {plain, gzip}) {
+        Record_Reader reader(path);
+        auto first = reader.next();
+        REQUIRE(first.has_value());
+        REQUIRE(first->title() == "doc-0");
+        REQUIRE(first->url() == "http://doc-0.com");
+        REQUIRE(first->content() == "<p>first document</p>");
+        auto second = reader.next();
+        REQUIRE(second.has_value());
+        REQUIRE(second->title() == "doc-2");
+        REQUIRE(second->content() == std::string(3000, 'x'));
+        REQUIRE_FALSE(reader.next().has_value());
+    }
+
+    SECTION("Chunks split headers anywhere")
+    {
+        Decompressed_File file(gzip, 7);
+        std::string decompressed;
+        while (file.read(decompressed)) {
+        }
+        REQUIRE(decompressed == contents);
+    }
+
+    SECTION("Truncated files throw")
+    {
+        auto truncated = (tmpdir.path() / "truncated.warc").string();
+        std::ofstream(truncated, std::ios::binary) << contents.substr(0, contents.size() - 100);
+        Record_Reader reader(truncated);
+        REQUIRE(reader.next().has_value());
+        REQUIRE_THROWS_AS(read_all(reader), std::runtime_error);
+    }
+}
+
+TEST_CASE("Read WARC files in parallel", "[parsing][warc]")
+{
+    Temporary_Directory tmpdir;
+    std::vector<std::string> files;
+    std::vector<std::string> expected;
+    for (int file = 0; file < 5; ++file) {
+        std::vector<std::string> records;
+        for (int doc = 0; doc < 100; ++doc) {
+            auto trecid = fmt::format("doc-{}-{}", file, doc);
+            records.push_back(warc_record("response", trecid, "content of " + trecid));
+            expected.push_back(trecid);
+        }
+        files.push_back((tmpdir.path() / fmt::format("{}.warc.gz", file)).string());
+        write_gzip(files.back(), records);
+    }
+    files.push_back((tmpdir.path() / "missing.warc.gz").string());
+
+    auto threads = GENERATE(1, 2, 8);
+    Parallel_Reader reader(files, threads, 16);
+    std::vector<std::string> titles;
+    while (auto record = reader.next()) {
+        REQUIRE(record->content() == "content of " + record->title());
+        titles.push_back(record->title());
+    }
+    REQUIRE_FALSE(reader.next().has_value());
+    for (int file = 0; file < 5; ++file) {
+        auto prefix = fmt::format("doc-{}-", file);
+        std::vector<std::string> file_titles;
+        std::copy_if(
+            titles.begin(), titles.end(), std::back_inserter(file_titles), [&](auto const& title) {
+                return title.rfind(prefix, 0) == 0;
+            });
+        REQUIRE(file_titles == std::vector<std::string>(
+                    expected.begin() + file * 100, expected.begin() + (file + 1) * 100));
+    }
+    REQUIRE(titles.size() == expected.size());
+
+    SECTION("Stopping early releases the readers")
+    {
+        Parallel_Reader partial(files, threads, 4);
+        REQUIRE(partial.next().has_value());
+    }
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <range/v3/view/enumerate.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "accumulator/simple_accumulator.hpp"
+#include "app.hpp"
+#include "cursor/impact_cursor.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "query/algorithm/anytime_saat_query.hpp"
+#include "query/warmup.hpp"
+#include "timer.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+
+void perftest(
+    std::string const& index_filename,
+    std::vector<Query> const& queries,
+    uint64_t k,
+    uint64_t postings_budget,
+    size_t runs,
+    bool print)
+{
+    impact_simdbp_index index;
+    spdlog::info("Loading index from {}", index_filename);
+    mio::mmap_source m(index_filename.c_str());
+    mapper::map(index, m);
+
+    spdlog::info("Warming up posting lists");
+    warmup_lists(index, query_log_terms(queries));
+
+    spdlog::info("K: {}", k);
+    spdlog::info("Postings budget: {}", postings_budget);
+
+    topk_queue topk(k);
+    Simple_Accumulator accumulator(index.num_docs());
+    anytime_saat_query query_alg(topk, postings_budget);
+    auto run_query = [&](Query const& query) {
+        topk.clear();
+        query_alg(make_impact_cursors(index, query), accumulator);
+        topk.finalize();
+    };
+
+    std::vector<double> query_times;
+    uint64_t postings_processed = 0;
+    for (size_t run = 0; run <= runs; ++run) {
+        for (auto const& query: queries) {
+            auto usecs = run_with_timer<std::chrono::microseconds>([&]() { run_query(query); });
+            if (run != 0) {  // first run is not timed
+                query_times.push_back(usecs.count());
+                postings_processed += query_alg.postings_processed();
+            }
+        }
+    }
+
+    if (print) {
+        for (auto&& [qid, query]: ranges::views::enumerate(queries)) {
+            run_query(query);
+            for (auto&& [rank, result]: ranges::views::enumerate(topk.topk())) {
+                std::cout << fmt::format(
+                    "{}\t{}\t{}\t{}\n",
+                    query.id.value_or(std::to_string(qid)),
+                    rank,
+                    result.second,
+                    result.first);
+            }
+        }
+    }
+
+    std::sort(query_times.begin(), query_times.end());
+    double avg =
+        std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
+    double q50 = query_times[query_times.size() / 2];
+    double q90 = query_times[90 * query_times.size() / 100];
+    double q95 = query_times[95 * query_times.size() / 100];
+    double q99 = query_times[99 * query_times.size() / 100];
+    double avg_postings = double(postings_processed) / query_times.size();
+
+    spdlog::info("---- impact_simdbp anytime_saat");
+    spdlog::info("Mean: {}", avg);
+    spdlog::info("50% quantile: {}", q50);
+    spdlog::info("90% quantile: {}", q90);
+    spdlog::info("95% quantile: {}", q95);
+    spdlog::info("99% quantile: {}", q99);
+    spdlog::info("Mean postings processed: {}", avg_postings);
+
+    stats_line()("type", "impact_simdbp")("query", "anytime_saat")("budget", postings_budget)(
+        "avg", avg)("q50", q50)("q90", q90)("q95", q95)("q99", q99)("postings", avg_postings);
+}
+
+int main(int argc, const char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string index_filename;
+    uint64_t postings_budget = std::numeric_limits<uint64_t>::max();
+    bool print = false;
+
+    App<arg::Query<arg::QueryMode::Ranked>> app{
+        "Benchmarks score-at-a-time anytime query processing on an impact-ordered index"};
+    app.add_option("-i,--index", index_filename, "Impact-ordered index filename")->required();
+    app.add_option(
+        "-b,--budget", postings_budget, "Maximum number of postings processed per query");
+    app.add_flag("--print", print, "Print query results");
+    CLI11_PARSE(app, argc, argv);
+
+    perftest(index_filename, app.queries(), app.k(), postings_budget, 2, print);
+    return 0;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <thread>
@@ -7,9 +10,16 @@
 #include <CLI/CLI.hpp>
 #include <range/v3/view/getlines.hpp>
 #include <range/v3/view/transform.hpp>
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
 
 #include "io.hpp"
+#include "mappable/file_header.hpp"
+#include "mappable/mapped_file.hpp"
+#include "query/binary_queries.hpp"
+#include "query/docid_range.hpp"
 #include "query/queries.hpp"
+#include "query/query_budget.hpp"
 
 namespace pisa {
 
@@ -44,16 +54,65 @@ namespace arg {
         bool m_wand_compressed = false;
     };
 
-    struct Index: public Encoding {
-        explicit Index(CLI::App* app) : Encoding(app)
+    struct LoadMode {
+        explicit LoadMode(CLI::App* app)
+        {
+            auto valid_load_mode = [](std::string const& name) {
+                try {
+                    [[maybe_unused]] auto mode = mapper::parse_load_mode(name);
+                } catch (std::invalid_argument const& error) {
+                    return std::string(error.what());
+                }
+                return std::string();
+            };
+            app->add_option(
+                   "--load-mode",
+                   m_load_mode,
+                   "How the index is loaded: mmap, populate, hugepage, hugetlb-2mb, or hugetlb-1gb",
+                   true)
+                ->check(valid_load_mode);
+        }
+
+        [[nodiscard]] auto load_mode() const -> mapper::load_mode
+        {
+            return mapper::parse_load_mode(m_load_mode);
+        }
+
+      private:
+        std::string m_load_mode = "mmap";
+    };
+
+    struct Index: public Encoding, public LoadMode {
+        explicit Index(CLI::App* app) : Encoding(app), LoadMode(app)
         {
             app->add_option("-i,--index", m_index, "Inverted index filename")->required();
+            app->add_flag(
+                "--verify-index", m_verify, "Verify the index checksums in the background");
         }
 
         [[nodiscard]] auto index_filename() const -> std::string const& { return m_index; }
 
+        /// Throws `std::invalid_argument` if the index file header records a type other than
+        /// the encoding. With `--verify-index`, the checksums of the index are also verified by
+        /// a background thread, which exits the process if they do not match.
+        void check_index() const
+        {
+            mapper::check_file_type(m_index, index_encoding());
+            if (m_verify) {
+                std::thread([filename = m_index]() {
+                    mapper::mapped_file file(filename);
+                    if (not mapper::verify_checksums(file.data(), file.size())) {
+                        spdlog::critical("Checksums of {} do not match", filename);
+                        std::_Exit(EXIT_FAILURE);
+                    }
+                    spdlog::info("Checksums of {} verified", filename);
+                }).detach();
+            }
+        }
+
       private:
         std::string m_index;
+        bool m_verify = false;
     };
 
     enum class QueryMode : bool { Ranked, Unranked };
@@ -82,15 +141,40 @@ namespace arg {
             return std::nullopt;
         }
 
+        /// Reads the queries from a binary query file written by `map_queries`, or else parses
+        /// the lines of the query file, or of the standard input, in parallel.
         [[nodiscard]] auto queries() const -> std::vector<::pisa::Query>
         {
-            std::vector<::pisa::Query> q;
-            auto parse_query = resolve_query_parser(q, m_term_lexicon, m_stop_words, m_stemmer);
+            if (m_query_file && binary_queries::is_binary_query_file(*m_query_file)) {
+                if (m_term_lexicon) {
+                    spdlog::warn("Queries of {} are already mapped to IDs", *m_query_file);
+                }
+                return binary_queries(*m_query_file).to_queries();
+            }
+            std::vector<std::string> lines;
+            auto read_line = [&](std::string const& line) { lines.push_back(line); };
             if (m_query_file) {
                 std::ifstream is(*m_query_file);
-                io::for_each_line(is, parse_query);
+                io::for_each_line(is, read_line);
             } else {
-                io::for_each_line(std::cin, parse_query);
+                io::for_each_line(std::cin, read_line);
+            }
+            std::optional<TermProcessor> term_processor;
+            if (m_term_lexicon) {
+                term_processor.emplace(m_term_lexicon, m_stop_words, m_stemmer);
+            }
+            std::vector<::pisa::Query> q(lines.size());
+            tbb::parallel_for(std::size_t(0), lines.size(), [&](std::size_t idx) {
+                q[idx] = term_processor ? parse_query_terms(lines[idx], *term_processor)
+                                        : parse_query_ids(lines[idx]);
+            });
+            if (term_processor) {
+                auto const& cache = term_processor->cache();
+                spdlog::info(
+                    "Term cache: {} hits, {} misses, hit rate: {}",
+                    cache.hits(),
+                    cache.misses(),
+                    cache.hit_rate());
             }
             return q;
         }
@@ -123,7 +207,16 @@ namespace arg {
             auto* wand = app->add_option("-w,--wand", m_wand_data_path, "WAND data filename");
             auto* scorer =
                 app->add_option("-s,--scorer", m_scorer, "Query processing algorithm")->needs(wand);
-            app->add_flag("--quantize", m_quantize, "Quantizes the scores")->needs(scorer);
+            m_option =
+                app->add_flag("--quantize", m_quantize, "Quantizes the scores")->needs(scorer);
+            app->add_option(
+                   "--quantizer",
+                   m_quantizer,
+                   "Quantization buckets: linear (equal widths), log (widening geometrically), "
+                   "or quantile (holding equal numbers of postings)",
+                   true)
+                ->check(CLI::IsMember({"linear", "log", "quantile"}))
+                ->needs(m_option);
         }
 
         [[nodiscard]] auto scorer() const -> std::optional<std::string> const& { return m_scorer; }
@@ -132,11 +225,15 @@ namespace arg {
             return m_wand_data_path;
         }
         [[nodiscard]] auto quantize() const { return m_quantize; }
+        [[nodiscard]] auto quantizer() const -> std::string const& { return m_quantizer; }
+        [[nodiscard]] auto* quantize_option() { return m_option; }
 
       private:
         std::optional<std::string> m_scorer;
         std::optional<std::string> m_wand_data_path;
         bool m_quantize = false;
+        std::string m_quantizer = "linear";
+        CLI::Option* m_option;
     };
 
     struct Scorer {
@@ -170,13 +267,117 @@ namespace arg {
     struct Threads {
         explicit Threads(CLI::App* app)
         {
-            app->add_option("--threads", m_threads, "Number of threads");
+            m_option = app->add_option("--threads", m_threads, "Number of threads");
         }
 
         [[nodiscard]] auto threads() const -> std::size_t { return m_threads; }
+        [[nodiscard]] auto* threads_option() { return m_option; }
 
       private:
         std::size_t m_threads = std::thread::hardware_concurrency();
+        CLI::Option* m_option;
+    };
+
+    struct DeletedDocuments {
+        explicit DeletedDocuments(CLI::App* app)
+        {
+            auto* deleted = app->add_option(
+                "--deleted", m_deleted_filename, "Deleted documents, excluded from results");
+            app->add_option(
+                   "--deleted-blocks",
+                   m_deleted_blocks_filename,
+                   "Blocks of deleted documents, skipped by block-max algorithms")
+                ->needs(deleted);
+        }
+
+        [[nodiscard]] auto deleted_documents_file() const -> std::optional<std::string> const&
+        {
+            return m_deleted_filename;
+        }
+        [[nodiscard]] auto deleted_blocks_file() const -> std::optional<std::string> const&
+        {
+            return m_deleted_blocks_filename;
+        }
+
+      private:
+        std::optional<std::string> m_deleted_filename;
+        std::optional<std::string> m_deleted_blocks_filename;
+    };
+
+    struct QueryBudget {
+        explicit QueryBudget(CLI::App* app)
+        {
+            app->add_option(
+                "--postings-budget",
+                m_postings,
+                "Maximum number of postings scored per query by block_max_wand and maxscore");
+            app->add_option(
+                "--time-budget",
+                m_microseconds,
+                "Maximum time in microseconds per query of block_max_wand and maxscore");
+            auto stable = app->add_option(
+                "--stop-when-stable",
+                m_stable_window,
+                "Stop block_max_wand and maxscore queries, unsafely, once their threshold has not "
+                "grown by --stable-growth over this many scored documents");
+            app->add_option(
+                   "--stable-growth",
+                   m_stable_growth,
+                   "Relative threshold growth below which a query is stable",
+                   true)
+                ->needs(stable);
+        }
+
+        [[nodiscard]] auto query_budget() const -> pisa::query_budget
+        {
+            std::optional<std::chrono::microseconds> time{};
+            if (m_microseconds) {
+                time = std::chrono::microseconds(*m_microseconds);
+            }
+            pisa::query_budget budget(m_postings, time);
+            if (m_stable_window) {
+                budget.stop_when_stable(*m_stable_window, m_stable_growth);
+            }
+            return budget;
+        }
+
+      private:
+        std::optional<std::uint64_t> m_postings;
+        std::optional<std::uint64_t> m_microseconds;
+        std::optional<std::uint64_t> m_stable_window;
+        double m_stable_growth = 0.01;
+    };
+
+    struct ClipRatio {
+        explicit ClipRatio(CLI::App* app)
+        {
+            app->add_option(
+                "--clip-ratio",
+                m_clip_ratio,
+                "Lists scoring below this fraction of the best one are never essential in "
+                "clipped_maxscore",
+                true);
+        }
+
+        [[nodiscard]] auto clip_ratio() const -> float { return m_clip_ratio; }
+
+      private:
+        float m_clip_ratio = 0.1;
+    };
+
+    struct DocidRange {
+        explicit DocidRange(CLI::App* app)
+        {
+            app->add_option(
+                "--docid-begin", m_range.begin, "Process only documents from this docid on");
+            app->add_option(
+                "--docid-end", m_range.end, "Process only documents before this docid");
+        }
+
+        [[nodiscard]] auto docids() const -> pisa::docid_range { return m_range; }
+
+      private:
+        pisa::docid_range m_range;
     };
 
 }  // namespace arg
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <CLI/CLI.hpp>
+#include <boost/filesystem.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "timer.hpp"
+#include "util/task_graph.hpp"
+
+using namespace pisa;
+
+namespace {
+
+/// Quotes `arg` for the shell.
+auto quote(std::string const& arg) -> std::string
+{
+    std::string quoted = "'";
+    for (char c: arg) {
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+/// Returns `{program} {args...}` with the program and arguments quoted, followed by `extra`,
+/// which the shell splits into arguments.
+auto command(std::string const& program, std::vector<std::string> const& args, std::string extra)
+    -> std::string
+{
+    std::string cmd = quote(program);
+    for (auto const& arg: args) {
+        cmd += ' ';
+        cmd += quote(arg);
+    }
+    if (not extra.empty()) {
+        cmd += ' ';
+        cmd += extra;
+    }
+    return cmd;
+}
+
+/// Runs `cmd` in a shell. Throws `std::runtime_error` unless it exits successfully.
+void run(std::string const& name, std::string const& cmd)
+{
+    spdlog::info("[{}] {}", name, cmd);
+    int status = 0;
+    auto elapsed =
+        run_with_timer<std::chrono::milliseconds>([&] { status = std::system(cmd.c_str()); });
+    if (status == -1 || not WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error(fmt::format("[{}] failed: {}", name, cmd));
+    }
+    spdlog::info("[{}] done in {} ms", name, elapsed.count());
+}
+
+auto count_lines(std::string const& filename) -> std::size_t
+{
+    std::ifstream is(filename);
+    if (not is) {
+        throw std::runtime_error(fmt::format("Cannot read {}", filename));
+    }
+    return std::count(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>(), '\n');
+}
+
+auto file_size(std::string const& filename) -> std::size_t
+{
+    boost::system::error_code error;
+    auto size = boost::filesystem::file_size(filename, error);
+    return error ? 0 : static_cast<std::size_t>(size);
+}
+
+auto physical_memory() -> std::size_t
+{
+    auto pages = sysconf(_SC_PHYS_PAGES);
+    auto page_size = sysconf(_SC_PAGE_SIZE);
+    return pages > 0 && page_size > 0 ? static_cast<std::size_t>(pages) * page_size : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string input_basename;
+    std::string output_basename;
+    std::size_t shard_count = 0;
+    std::string encoding;
+    std::string scorer;
+    bool global_stats = false;
+    std::size_t threads = std::thread::hardware_concurrency();
+    std::size_t stage_threads = 4;
+    std::optional<std::size_t> memory_budget_mib;
+    std::optional<std::string> bin_dir;
+    std::string invert_args;
+    std::string compress_args;
+    std::string wand_args = "-b 64";
+
+    CLI::App app{
+        "Builds the inverted index, WAND data, and compressed index of every shard of a "
+        "partitioned forward index, running the stages of all shards in parallel."};
+    app.add_option("-i,--input", input_basename, "Basename of the shards of partition_fwd_index")
+        ->required();
+    app.add_option("--shards", shard_count, "Number of shards")->required();
+    app.add_option(
+           "-o,--output",
+           output_basename,
+           "Basename of the output: shard i is built into <output>.inv.i, <output>.wand.i, and "
+           "<output>.<encoding>.i")
+        ->required();
+    app.add_option("-e,--encoding", encoding, "Index encoding")->required();
+    app.add_option("-s,--scorer", scorer, "Scorer of the WAND data")->required();
+    app.add_flag(
+        "--global-stats",
+        global_stats,
+        "Score the WAND data of every shard with the statistics of the whole collection, written "
+        "to <output>.stats.i once all shards are inverted");
+    app.add_option("-j,--threads", threads, "Number of threads of all stages together", true);
+    app.add_option("--stage-threads", stage_threads, "Number of threads of each stage", true);
+    app.add_option(
+        "--memory-budget",
+        memory_budget_mib,
+        "Memory, in MiB, that the running stages are estimated to use together (default: the "
+        "physical memory)");
+    app.add_option(
+        "--bin",
+        bin_dir,
+        "Directory of the PISA tools (default: the directory of this tool)");
+    app.add_option("--invert-args", invert_args, "Additional arguments of invert");
+    app.add_option("--compress-args", compress_args, "Additional arguments of create_freq_index");
+    app.add_option("--wand-args", wand_args, "Block arguments of create_wand_data", true);
+    CLI11_PARSE(app, argc, argv);
+
+    threads = std::max<std::size_t>(threads, 1);
+    stage_threads = std::clamp<std::size_t>(stage_threads, 1, threads);
+    std::size_t memory_budget =
+        memory_budget_mib ? *memory_budget_mib << 20U : physical_memory();
+    auto bin = bin_dir ? boost::filesystem::path(*bin_dir)
+                       : boost::filesystem::path(argv[0]).parent_path();
+    auto tool = [&](char const* name) {
+        return bin.empty() ? std::string(name) : (bin / name).string();
+    };
+    auto shard_name = [](std::string const& basename, std::size_t shard) {
+        return fmt::format("{}.{:03d}", basename, shard);
+    };
+    auto inverted = fmt::format("{}.inv", output_basename);
+    auto wand = fmt::format("{}.wand", output_basename);
+    auto stats = fmt::format("{}.stats", output_basename);
+    auto index = fmt::format("{}.{}", output_basename, encoding);
+    auto stage_threads_arg = std::to_string(stage_threads);
+
+    // The memory of each stage is estimated from the size of the forward index of the shard,
+    // which is about that of its inverted index: inverting holds a batch of postings and
+    // compressing the whole encoded index, while WAND data are built list by list. Later stages
+    // have higher priorities, so that shards are finished first, and the inverting of some
+    // shards, mostly reading and writing files, overlaps with the compressing of others.
+    enum stage_priority { invert_priority, stats_priority, wand_priority, compress_priority };
+    task_graph graph;
+    std::vector<task_graph::task_id> inverts;
+    std::size_t terms_size = 0;
+    for (std::size_t shard = 0; shard < shard_count; ++shard) {
+        auto input = shard_name(input_basename, shard);
+        auto size = file_size(input);
+        if (size == 0) {
+            spdlog::error("Shard {} not found", input);
+            return 1;
+        }
+        terms_size += file_size(input + ".terms");
+        inverts.push_back(graph.add(
+            fmt::format("invert {}", shard),
+            [&, input, shard] {
+                auto term_count = count_lines(input + ".terms");
+                run(fmt::format("invert {}", shard),
+                    command(
+                        tool("invert"),
+                        {"-i",
+                         input,
+                         "-o",
+                         shard_name(inverted, shard),
+                         "--term-count",
+                         std::to_string(term_count),
+                         "--threads",
+                         stage_threads_arg},
+                        invert_args));
+            },
+            {stage_threads, size},
+            {},
+            invert_priority));
+    }
+    std::optional<task_graph::task_id> stats_task;
+    if (global_stats) {
+        stats_task = graph.add(
+            "global statistics",
+            [&] {
+                run("global statistics",
+                    command(
+                        tool("compute_global_statistics"),
+                        {"-c",
+                         inverted,
+                         "--terms",
+                         input_basename,
+                         "--shards",
+                         std::to_string(shard_count),
+                         "-o",
+                         stats,
+                         "-j",
+                         stage_threads_arg},
+                        ""));
+            },
+            {stage_threads, 8 * terms_size},
+            inverts,
+            stats_priority);
+    }
+    for (std::size_t shard = 0; shard < shard_count; ++shard) {
+        auto size = file_size(shard_name(input_basename, shard));
+        std::vector<task_graph::task_id> wand_dependencies{inverts[shard]};
+        std::vector<std::string> wand_global_stats;
+        if (stats_task) {
+            wand_dependencies.push_back(*stats_task);
+            wand_global_stats = {"--global-stats", shard_name(stats, shard)};
+        }
+        graph.add(
+            fmt::format("create_wand_data {}", shard),
+            [&, shard, wand_global_stats] {
+                std::vector<std::string> args{
+                    "-c",
+                    shard_name(inverted, shard),
+                    "-o",
+                    shard_name(wand, shard),
+                    "-s",
+                    scorer,
+                    "-j",
+                    stage_threads_arg};
+                args.insert(args.end(), wand_global_stats.begin(), wand_global_stats.end());
+                run(fmt::format("create_wand_data {}", shard),
+                    command(tool("create_wand_data"), args, wand_args));
+            },
+            {stage_threads, size / 4},
+            wand_dependencies,
+            wand_priority);
+        graph.add(
+            fmt::format("create_freq_index {}", shard),
+            [&, shard] {
+                run(fmt::format("create_freq_index {}", shard),
+                    command(
+                        tool("create_freq_index"),
+                        {"-e",
+                         encoding,
+                         "-c",
+                         shard_name(inverted, shard),
+                         "-o",
+                         shard_name(index, shard),
+                         "--threads",
+                         stage_threads_arg},
+                        compress_args));
+            },
+            {stage_threads, 2 * size},
+            {inverts[shard]},
+            compress_priority);
+    }
+
+    spdlog::info(
+        "Building {} shards with {} threads, {} per stage, within {} MiB",
+        shard_count,
+        threads,
+        stage_threads,
+        memory_budget >> 20U);
+    try {
+        auto elapsed = run_with_timer<std::chrono::seconds>(
+            [&] { graph.run({threads, memory_budget}); });
+        spdlog::info("Built {} shards in {} s", shard_count, elapsed.count());
+    } catch (std::exception const& error) {
+        spdlog::error("{}", error.what());
+        return 1;
+    }
+    return 0;
+}
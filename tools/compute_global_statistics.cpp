@@ -0,0 +1,40 @@
+#include <string>
+#include <thread>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/spdlog.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "global_statistics.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    std::string collection_basename;
+    std::string terms_basename;
+    std::string output_basename;
+    std::size_t shard_count = 0;
+    std::size_t threads = std::thread::hardware_concurrency();
+
+    CLI::App app{
+        "Computes the statistics of a sharded collection, with which every shard scores its "
+        "documents as in the whole collection."};
+    app.add_option("-c,--collection", collection_basename, "Basename of the shard collections")
+        ->required();
+    app.add_option(
+           "--terms",
+           terms_basename,
+           "Basename of the shard forward indexes, whose `.terms` files list the shard terms")
+        ->required();
+    app.add_option("--shards", shard_count, "Number of shards")->required();
+    app.add_option("-o,--output", output_basename, "Basename of the shard statistics")
+        ->required();
+    app.add_option("-j,--threads", threads, "Number of threads");
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::task_scheduler_init init(threads);
+    spdlog::info("Number of threads: {}", threads);
+    compute_global_statistics(collection_basename, terms_basename, shard_count, output_basename);
+    return 0;
+}
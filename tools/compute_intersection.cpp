@@ -9,6 +9,8 @@
 #include <range/v3/view/filter.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
 
 #include "app.hpp"
 #include "index_types.hpp"
@@ -24,13 +26,14 @@ using pisa::intersection::Mask;
 template <typename IndexType, typename WandType, typename QueryRange>
 void intersect(
     std::string const& index_filename,
+    mapper::load_mode load_mode,
     std::optional<std::string> const& wand_data_filename,
     QueryRange&& queries,
     IntersectionType intersection_type,
     std::optional<std::uint8_t> max_term_count = std::nullopt)
 {
     IndexType index;
-    mio::mmap_source m(index_filename.c_str());
+    mapper::mapped_file m(index_filename, load_mode);
     mapper::map(index, m);
 
     WandType wdata;
@@ -46,30 +49,35 @@ void intersect(
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
 
-    std::size_t qid = 0U;
+    std::vector<Query> query_log(queries.begin(), queries.end());
+    std::vector<std::string> output(query_log.size());
 
-    auto print_intersection = [&](auto const& query, auto const& mask) {
-        auto intersection = Intersection::compute(index, wdata, query, mask);
-        std::cout << fmt::format(
-            "{}\t{}\t{}\t{}\n",
-            query.id ? *query.id : std::to_string(qid),
-            mask.to_ulong(),
-            intersection.length,
-            intersection.max_score);
-    };
-
-    for (auto&& query: queries) {
+    // Queries are processed in parallel, and their lines are written in the original order.
+    tbb::parallel_for(std::size_t(0), query_log.size(), [&](std::size_t qid) {
+        auto const& query = query_log[qid];
+        auto id = query.id ? *query.id : std::to_string(qid);
+        auto& lines = output[qid];
         if (intersection_type == IntersectionType::Combinations) {
-            for_all_subsets(query, max_term_count, print_intersection);
+            for_all_subset_intersections(
+                index,
+                wdata,
+                query,
+                max_term_count,
+                [&](auto const&, auto const& mask, auto const& intersection) {
+                    lines += fmt::format(
+                        "{}\t{}\t{}\t{}\n",
+                        id,
+                        mask.to_ulong(),
+                        intersection.length,
+                        intersection.max_score);
+                });
         } else {
             auto intersection = Intersection::compute(index, wdata, query);
-            std::cout << fmt::format(
-                "{}\t{}\t{}\n",
-                query.id ? *query.id : std::to_string(qid),
-                intersection.length,
-                intersection.max_score);
+            lines = fmt::format("{}\t{}\t{}\n", id, intersection.length, intersection.max_score);
         }
-        qid += 1;
+    });
+    for (auto const& lines: output) {
+        std::cout << lines;
     }
 }
 
@@ -86,7 +94,7 @@ int main(int argc, const char** argv)
     bool combinations = false;
     bool header = false;
 
-    App<arg::Index, arg::WandData, arg::Query<arg::QueryMode::Unranked>> app{
+    App<arg::Index, arg::WandData, arg::Query<arg::QueryMode::Unranked>, arg::Threads> app{
         "Computes intersections of posting lists."};
     auto* combinations_flag = app.add_flag(
         "--combinations", combinations, "Compute intersections for combinations of terms in query");
@@ -99,11 +107,12 @@ int main(int argc, const char** argv)
     app.add_option("--max-query-len", max_query_len, "Maximum query length");
     app.add_flag("--header", header, "Write TSV header");
     CLI11_PARSE(app, argc, argv);
+    app.check_index();
 
     auto queries = app.queries();
     auto filtered_queries = ranges::views::filter(queries, [&](auto&& query) {
         auto size = query.terms.size();
-        return size < min_query_len || size > max_query_len;
+        return size >= min_query_len && size <= max_query_len;
     });
 
     if (header) {
@@ -114,6 +123,8 @@ int main(int argc, const char** argv)
         }
     }
 
+    tbb::task_scheduler_init init(app.threads());
+
     IntersectionType intersection_type =
         combinations ? IntersectionType::Combinations : IntersectionType::Query;
 
@@ -125,6 +136,7 @@ int main(int argc, const char** argv)
     {                                                       \
         intersect<BOOST_PP_CAT(T, _index), wand_raw_index>( \
             app.index_filename(),                           \
+            app.load_mode(),                                \
             app.wand_data_path(),                           \
             filtered_queries,                               \
             intersection_type,                              \
@@ -25,8 +25,13 @@ int main(int argc, char** argv)
     }
 
     std::size_t count = -1;  // Takes care of the first 'fake' sequence
-    for (auto&& p: coll) {
-        count += p.size();
+    if (coll.has_offsets()) {
+        // Every word but the length of each sequence is a posting.
+        count += coll.end().position() - coll.size();
+    } else {
+        for (auto&& p: coll) {
+            count += p.size();
+        }
     }
 
     std::cout << count << '\n';
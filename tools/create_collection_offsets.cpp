@@ -0,0 +1,25 @@
+#include <string>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "binary_freq_collection.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+    std::string input_basename;
+
+    CLI::App app{"Writes the offsets of the lists of a collection, for random access."};
+    app.add_option("-c,--collection", input_basename, "Collection basename")->required();
+    CLI11_PARSE(app, argc, argv);
+
+    binary_freq_collection::write_offsets(input_basename.c_str());
+    spdlog::info(
+        "Offsets written to {0}.docs.offsets and {0}.freqs.offsets", input_basename);
+    return 0;
+}
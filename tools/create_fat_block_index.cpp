@@ -0,0 +1,100 @@
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "fat_block_index.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "scorer/scorer.hpp"
+#include "util/progress.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using wand_raw_index = wand_data<wand_data_raw>;
+
+template <typename IndexType>
+void create_fat_block_index(
+    std::string const& index_filename,
+    mapper::load_mode load_mode,
+    std::string const& wand_data_filename,
+    std::string const& scorer_name,
+    std::string const& output_filename)
+{
+    IndexType index;
+    spdlog::info("Loading index from {}", index_filename);
+    mapper::mapped_file m(index_filename, load_mode);
+    mapper::map(index, m);
+
+    wand_raw_index wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    global_parameters params;
+    fat_block_simdbp_index::builder builder(index.num_docs(), params);
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        pisa::progress progress("Computing block-max scores", index.size());
+        std::vector<uint32_t> docs;
+        std::vector<uint32_t> freqs;
+        for (size_t term = 0; term < index.size(); ++term) {
+            docs.clear();
+            freqs.clear();
+            for (auto list = index[term]; list.docid() < index.num_docs(); list.next()) {
+                docs.push_back(list.docid());
+                freqs.push_back(list.freq());
+            }
+            builder.add_posting_list(
+                docs.size(), docs.begin(), freqs.begin(), make_term_scorer(scorer, term));
+            progress.update(1);
+        }
+    });
+
+    fat_block_simdbp_index fat_index;
+    builder.build(fat_index);
+    mapper::freeze(
+        fat_index,
+        output_filename.c_str(),
+        mapper::file_description{"fat_block_simdbp", fat_index.num_docs()});
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string output_filename;
+    std::string wand_data_filename;
+
+    App<arg::Index, arg::Scorer> app{
+        "Creates an index storing block-max scores in its posting lists, to be queried as "
+        "`fat_block_simdbp`"};
+    app.add_option("-w,--wand", wand_data_filename, "WAND data filename")->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    CLI11_PARSE(app, argc, argv);
+    app.check_index();
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                         \
+    }                                                                                 \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                           \
+    {                                                                                 \
+        create_fat_block_index<BOOST_PP_CAT(T, _index)>(                              \
+            app.index_filename(),                                                     \
+            app.load_mode(),                                                          \
+            wand_data_filename,                                                       \
+            app.scorer(),                                                             \
+            output_filename);                                                         \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+
+    return 0;
+}
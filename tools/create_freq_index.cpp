@@ -4,16 +4,21 @@
 #include <numeric>
 #include <optional>
 #include <thread>
+#include <type_traits>
 
 #include "boost/algorithm/string/predicate.hpp"
 #include "spdlog/spdlog.h"
+#include <gsl/span>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <tbb/task_scheduler_init.h>
 
 #include "app.hpp"
 #include "mappable/mapper.hpp"
 
 #include "configuration.hpp"
+#include "index_tiers.hpp"
 #include "index_types.hpp"
+#include "query/warmup.hpp"
 #include "util/index_build_utils.hpp"
 #include "util/util.hpp"
 #include "util/verify_collection.hpp"  // XXX move to index_build_utils
@@ -57,16 +62,67 @@ void dump_index_specific_stats(pisa::pefopt_index const& coll, std::string const
         "freqs_avg_part", long_postings / freqs_partitions);
 }
 
+template <typename Collection>
+void lay_out_lists(Collection&, std::vector<term_id_type> const&, std::string const& type)
+{
+    spdlog::warn("Lists of {} indexes are always stored in term order", type);
+}
+
+template <typename BlockCodec, bool Profile, bool BlockMaxFreqs>
+void lay_out_lists(
+    block_freq_index<BlockCodec, Profile, BlockMaxFreqs>& coll,
+    std::vector<term_id_type> const& hot_terms,
+    std::string const& type)
+{
+    spdlog::info("Laying out the lists of {} query terms first", hot_terms.size());
+    block_freq_index<BlockCodec, Profile, BlockMaxFreqs> laid_out;
+    coll.lay_out(hot_terms, laid_out);
+    coll.swap(laid_out);
+}
+
+/// Returns the scores of about 2^20 postings of `input`, evenly spread over them, to place the
+/// buckets of a quantile quantizer.
+template <typename Scorer>
+auto sample_scores(binary_freq_collection const& input, Scorer const& scorer)
+    -> std::vector<float>
+{
+    constexpr size_t max_samples = 1U << 20U;
+    size_t postings = 0;
+    for (auto const& plist: input) {
+        postings += plist.docs.size();
+    }
+    size_t stride = std::max<size_t>(postings / max_samples, 1);
+    std::vector<float> sample;
+    sample.reserve(postings / stride + 1);
+    size_t term_id = 0;
+    size_t next = 0;
+    for (auto const& plist: input) {
+        auto term_scorer = make_term_scorer(scorer, term_id);
+        for (; next < plist.docs.size(); next += stride) {
+            sample.push_back(
+                term_scorer(*(plist.docs.begin() + next), *(plist.freqs.begin() + next)));
+        }
+        next -= plist.docs.size();
+        term_id += 1;
+    }
+    spdlog::info("Placing quantization buckets at the quantiles of {} scores", sample.size());
+    return sample;
+}
+
 template <typename CollectionType, typename WandType>
 void create_collection(
     binary_freq_collection const& input,
     pisa::global_parameters const& params,
     const std::optional<std::string>& output_filename,
     bool check,
+    double check_sample,
     std::string const& seq_type,
     std::optional<std::string> const& wand_data_filename,
     std::optional<std::string> const& scorer_name,
-    bool quantized)
+    bool quantized,
+    std::string const& quantizer_name,
+    std::optional<std::string> const& quantized_wand_filename,
+    std::optional<std::vector<term_id_type>> const& hot_terms)
 {
     using namespace pisa;
     spdlog::info("Processing {} documents", input.num_docs());
@@ -88,45 +144,75 @@ void create_collection(
             mapper::map(wdata, md, mapper::map_flags::warmup);
         }
 
-        std::unique_ptr<index_scorer<WandType>> scorer;
-
-        if (scorer_name) {
-            scorer = scorer::from_name(*scorer_name, wdata);
-        }
+        if (quantized) {
+            auto bits = configuration::get().quantization_bits;
+            scorer::with_scorer(*scorer_name, wdata, [&](auto const& scorer) {
+                auto quantize_lists = [&](auto const& quantizer) {
+                    // the builder copies the postings, so a single buffer serves all lists
+                    std::vector<float> scores;
+                    std::vector<uint32_t> quants;
+                    size_t term_id = 0;
+                    for (auto const& plist: input) {
+                        size_t size = plist.docs.size();
+                        scores.resize(size);
+                        quants.resize(size);
+                        score_postings(
+                            make_term_scorer(scorer, term_id),
+                            gsl::make_span(plist.docs.begin(), size),
+                            gsl::make_span(plist.freqs.begin(), size),
+                            gsl::make_span(scores));
+                        quantizer.quantize(scores, quants);
+                        uint64_t quants_sum =
+                            std::accumulate(quants.begin(), quants.end(), uint64_t(0));
+                        builder.add_posting_list(
+                            size, plist.docs.begin(), quants.begin(), quants_sum);
 
-        size_t term_id = 0;
-        for (auto const& plist: input) {
-            size_t size = plist.docs.size();
-            if (quantized) {
-                LinearQuantizer quantizer(
-                    wdata.index_max_term_weight(), configuration::get().quantization_bits);
-                auto term_scorer = scorer->term_scorer(term_id);
-                std::vector<uint64_t> quants;
-                for (size_t pos = 0; pos < size; ++pos) {
-                    uint64_t doc = *(plist.docs.begin() + pos);
-                    uint64_t freq = *(plist.freqs.begin() + pos);
-                    float score = term_scorer(doc, freq);
-                    uint64_t quant_score = quantizer(score);
-                    quants.push_back(quant_score);
+                        progress.update(1);
+                        postings += size;
+                        term_id += 1;
+                    }
+                    if (quantized_wand_filename) {
+                        spdlog::info(
+                            "Writing quantized WAND data to {}", *quantized_wand_filename);
+                        WandType quantized_wdata;
+                        if constexpr (std::is_same_v<
+                                          std::decay_t<decltype(quantizer)>,
+                                          LinearQuantizer>) {
+                            wdata.quantize(quantized_wdata);
+                        } else {
+                            wdata.quantize(quantized_wdata, quantizer);
+                        }
+                        mapper::freeze(quantized_wdata, quantized_wand_filename->c_str());
+                    }
+                };
+                auto max = wdata.index_max_term_weight();
+                if (quantizer_name == "log") {
+                    quantize_lists(bucket_quantizer::logarithmic(max, bits));
+                } else if (quantizer_name == "quantile") {
+                    quantize_lists(
+                        bucket_quantizer::quantiles(sample_scores(input, scorer), max, bits));
+                } else {
+                    quantize_lists(LinearQuantizer(max, bits));
                 }
-                assert(quants.size() == size);
-                uint64_t quants_sum =
-                    std::accumulate(quants.begin(), quants.begin() + quants.size(), uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), quants.begin(), quants_sum);
-            } else {
+            });
+        } else {
+            for (auto const& plist: input) {
+                size_t size = plist.docs.size();
                 uint64_t freqs_sum =
                     std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
                 builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
-            }
 
-            progress.update(1);
-            postings += size;
-            term_id += 1;
+                progress.update(1);
+                postings += size;
+            }
         }
     }
 
     CollectionType coll;
     builder.build(coll);
+    if (hot_terms) {
+        lay_out_lists(coll, *hot_terms, seq_type);
+    }
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
     spdlog::info("{} collection built in {} seconds", seq_type, elapsed_secs);
 
@@ -137,17 +223,83 @@ void create_collection(
     dump_index_specific_stats(coll, seq_type);
 
     if (output_filename) {
-        mapper::freeze(coll, (*output_filename).c_str());
+        mapper::freeze(
+            coll, (*output_filename).c_str(), mapper::file_description{seq_type, coll.num_docs()});
         if (check and quantized) {
             spdlog::warn("Index construction cannot be verified for quantized indexes.");
         }
         if (check and not quantized) {
             verify_collection<binary_freq_collection, CollectionType>(
-                input, (*output_filename).c_str());
+                input, (*output_filename).c_str(), check_sample);
         }
     }
 }
 
+template <typename CollectionType, typename WandType>
+void create_tiers(
+    binary_freq_collection const& input,
+    pisa::global_parameters const& params,
+    std::string const& tiers_basename,
+    std::string const& wand_data_filename,
+    std::string const& scorer_name,
+    double ratio,
+    std::size_t min_postings)
+{
+    spdlog::info("Splitting the index into tiers with ratio {}", ratio);
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    typename CollectionType::builder first_builder(input.num_docs(), params);
+    typename CollectionType::builder second_builder(input.num_docs(), params);
+    index_tiers::builder tiers_builder;
+    size_t first_postings = 0;
+    size_t second_postings = 0;
+    {
+        pisa::progress progress("Create tiers", input.size());
+        scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+            std::vector<float> scores;
+            size_t term_id = 0;
+            for (auto const& plist: input) {
+                auto term_scorer = make_term_scorer(scorer, term_id);
+                scores.resize(plist.docs.size());
+                std::transform(
+                    plist.docs.begin(),
+                    plist.docs.end(),
+                    plist.freqs.begin(),
+                    scores.begin(),
+                    [&](uint32_t doc, uint32_t freq) { return term_scorer(doc, freq); });
+                auto tiers = posting_tiers::split(
+                    plist.docs.begin(), plist.freqs.begin(), scores, ratio, min_postings);
+                auto add = [](auto& builder, auto const& docs, auto const& freqs) {
+                    uint64_t freqs_sum = std::accumulate(freqs.begin(), freqs.end(), uint64_t(0));
+                    builder.add_posting_list(docs.size(), docs.begin(), freqs.begin(), freqs_sum);
+                };
+                add(first_builder, tiers.first_docs, tiers.first_freqs);
+                if (not tiers.second_docs.empty()) {
+                    add(second_builder, tiers.second_docs, tiers.second_freqs);
+                }
+                tiers_builder.add_term(tiers);
+                first_postings += tiers.first_docs.size();
+                second_postings += tiers.second_docs.size();
+                progress.update(1);
+                term_id += 1;
+            }
+        });
+    }
+    spdlog::info("First tier: {} postings, second tier: {}", first_postings, second_postings);
+
+    CollectionType first_tier;
+    first_builder.build(first_tier);
+    mapper::freeze(first_tier, (tiers_basename + ".tier1").c_str());
+    CollectionType second_tier;
+    second_builder.build(second_tier);
+    mapper::freeze(second_tier, (tiers_basename + ".tier2").c_str());
+    index_tiers tiers;
+    tiers_builder.build(tiers);
+    mapper::freeze(tiers, (tiers_basename + ".tiers").c_str());
+}
+
 using wand_raw_index = wand_data<wand_data_raw>;
 
 int main(int argc, char** argv)
@@ -158,16 +310,89 @@ int main(int argc, char** argv)
     std::string input_basename;
     std::optional<std::string> output_filename;
     bool check = false;
+    double check_sample = 1.0;
+    std::optional<std::string> quantized_wand_filename;
+    std::optional<std::string> tiers_basename;
+    double tier_ratio = 0.1;
+    std::size_t tier_min_postings = 256;
+    pisa::global_parameters params;
+    int ef_log_sampling0 = params.ef_log_sampling0;
+    int ef_log_sampling1 = params.ef_log_sampling1;
+    int log_partition_size = params.log_partition_size;
 
-    App<arg::Encoding, arg::Quantize> app{"Compresses an inverted index"};
+    App<arg::Encoding, arg::Quantize, arg::Query<arg::QueryMode::Unranked>, arg::Threads> app{
+        "Compresses an inverted index"};
     app.add_option("-c,--collection", input_basename, "Collection basename")->required();
     app.add_option("-o,--output", output_filename, "Output filename")->required();
-    app.add_flag("--check", check, "Check the correctness of the index");
+    auto* check_option = app.add_flag("--check", check, "Check the correctness of the index");
+    app.add_option(
+           "--check-sample",
+           check_sample,
+           "Fraction of the lists, drawn at random, checked by --check",
+           true)
+        ->check(CLI::Range(0.0, 1.0))
+        ->needs(check_option);
+    app.add_option(
+           "--quantized-wand",
+           quantized_wand_filename,
+           "Also write the WAND data with quantized upper bounds to this file")
+        ->needs(app.quantize_option());
+    auto* tiers_option = app.add_option(
+        "--tiers",
+        tiers_basename,
+        "Also split the index into two tiers by the scores of its postings, written to "
+        "<basename>.tier1, <basename>.tier2, and <basename>.tiers (requires --scorer, not "
+        "--quantize)");
+    tiers_option->excludes(app.quantize_option());
+    app.add_option(
+           "--tier-ratio", tier_ratio, "Fraction of the postings of a list in the first tier", true)
+        ->check(CLI::Range(0.0, 1.0))
+        ->needs(tiers_option);
+    app.add_option(
+           "--tier-min-postings",
+           tier_min_postings,
+           "Minimum number of postings of a list in the first tier",
+           true)
+        ->needs(tiers_option);
+    app.add_option("--ef-log-sampling0", ef_log_sampling0, "Log2 of Elias-Fano skip sampling", true)
+        ->check(CLI::Range(1, 62));
+    app.add_option("--ef-log-sampling1", ef_log_sampling1, "Log2 of Elias-Fano move sampling", true)
+        ->check(CLI::Range(1, 62));
+    app.add_option(
+           "--log-partition-size",
+           log_partition_size,
+           "Log2 of the size of the partitions of pefuniform lists",
+           true)
+        ->check(CLI::Range(1, 30));
     CLI11_PARSE(app, argc, argv);
 
+    if (app.quantizer() != "linear" && not quantized_wand_filename) {
+        spdlog::error("--quantizer {} requires --quantized-wand", app.quantizer());
+        return 1;
+    }
+    if (app.quantizer() != "linear" && app.index_encoding() == "block_quantized_simdbp") {
+        // its block maxima would be codes, which do not add up as scores
+        spdlog::error("block_quantized_simdbp requires --quantizer linear");
+        return 1;
+    }
+    if (tiers_basename && not app.scorer()) {
+        spdlog::error("--tiers requires --scorer");
+        return 1;
+    }
+
+    tbb::task_scheduler_init init(app.threads());
+    params.ef_log_sampling0 = ef_log_sampling0;
+    params.ef_log_sampling1 = ef_log_sampling1;
+    params.log_partition_size = log_partition_size;
+
     binary_freq_collection input(input_basename.c_str());
 
-    pisa::global_parameters params;
+    // With queries, block index lists are stored by decreasing frequency of their terms in the
+    // queries, so that the lists the queries read are contiguous.
+    std::optional<std::vector<term_id_type>> hot_terms;
+    if (app.query_file()) {
+        hot_terms = query_log_terms(app.queries());
+    }
 
     if (false) {
 #define LOOP_BODY(R, DATA, T)                                       \
@@ -179,10 +404,24 @@ int main(int argc, char** argv)
             params,                                                 \
             output_filename,                                        \
             check,                                                  \
+            check_sample,                                           \
             app.index_encoding(),                                   \
             app.wand_data_path(),                                   \
             app.scorer(),                                           \
-            app.quantize());                                        \
+            app.quantize(),                                         \
+            app.quantizer(),                                        \
+            quantized_wand_filename,                                \
+            hot_terms);                                             \
+        if (tiers_basename) {                                       \
+            create_tiers<BOOST_PP_CAT(T, _index), wand_raw_index>(  \
+                input,                                              \
+                params,                                             \
+                *tiers_basename,                                    \
+                *app.wand_data_path(),                              \
+                *app.scorer(),                                      \
+                tier_ratio,                                         \
+                tier_min_postings);                                 \
+        }                                                           \
         /**/
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
 #undef LOOP_BODY
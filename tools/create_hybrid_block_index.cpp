@@ -0,0 +1,181 @@
+#include <array>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "app.hpp"
+#include "binary_freq_collection.hpp"
+#include "dec_time_prediction.hpp"
+#include "hybrid_block_index.hpp"
+#include "mappable/mapper.hpp"
+#include "mixed_block.hpp"
+#include "util/progress.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+using namespace pisa::time_prediction;
+
+using sequence_type = binary_freq_collection::sequence;
+
+/// Adds the predicted time of decoding `values` with every hybrid codec to `times`.
+void predict_block(
+    std::vector<uint32_t> const& values,
+    uint32_t sum_of_values,
+    predictors_vec_type const& predictors,
+    std::array<double, hybrid_codec_count>& times)
+{
+    thread_local std::vector<uint8_t> buf;
+    feature_vector fv;
+    values_statistics(values, fv);
+    for (uint8_t codec = 0; codec < hybrid_codec_count; ++codec) {
+        with_hybrid_codec(codec, [&](auto c) {
+            using codec_type = std::tuple_element_t<decltype(c)::value, hybrid_codecs>;
+            buf.clear();
+            codec_type::encode(values.data(), sum_of_values, values.size(), buf);
+        });
+        fv[feature_type::size] = buf.size();
+        times[codec] += predictors[codec](fv);
+    }
+}
+
+/// Returns the size of the list with every hybrid codec and the time of decoding all of its
+/// blocks, as predicted from the features also written by `profile_decoding`, times `weight`.
+[[nodiscard]] auto list_costs(
+    sequence_type const& list, uint64_t weight, predictors_vec_type const& predictors)
+    -> std::array<hybrid_codec_cost, hybrid_codec_count>
+{
+    std::array<hybrid_codec_cost, hybrid_codec_count> costs{};
+    thread_local std::vector<uint8_t> buf;
+    uint32_t n = list.docs.size();
+    for (uint8_t codec = 0; codec < hybrid_codec_count; ++codec) {
+        buf.clear();
+        hybrid_block_index::encode(codec, buf, n, list.docs.begin(), list.freqs.begin());
+        costs[codec].space = buf.size();
+    }
+    if (weight == 0) {
+        return costs;
+    }
+
+    std::array<double, hybrid_codec_count> times{};
+    thread_local std::vector<uint32_t> docs_buf;
+    thread_local std::vector<uint32_t> freqs_buf;
+    uint64_t block_size = std::tuple_element_t<0, hybrid_codecs>::block_size;
+    int64_t last_doc = -1;
+    uint32_t block_base = 0;
+    for (uint64_t begin = 0; begin < n; begin += block_size) {
+        auto end = std::min<uint64_t>(begin + block_size, n);
+        docs_buf.clear();
+        freqs_buf.clear();
+        for (auto pos = begin; pos < end; ++pos) {
+            uint32_t doc = list.docs.begin()[pos];
+            docs_buf.push_back(doc - last_doc - 1);
+            freqs_buf.push_back(list.freqs.begin()[pos] - 1);
+            last_doc = doc;
+        }
+        predict_block(
+            docs_buf, last_doc - block_base - (docs_buf.size() - 1), predictors, times);
+        predict_block(freqs_buf, uint32_t(-1), predictors, times);
+        block_base = last_doc + 1;
+    }
+    for (uint8_t codec = 0; codec < hybrid_codec_count; ++codec) {
+        costs[codec].time = weight * times[codec];
+    }
+    return costs;
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string input_basename;
+    std::string output_filename;
+    std::string predictors_filename;
+    std::optional<uint64_t> space_budget;
+
+    App<arg::Query<arg::QueryMode::Unranked>, arg::Threads> app{
+        "Creates a `block_hybrid` index, choosing the codec of every list to minimize the "
+        "decoding time of the query log predicted by the codec predictors, under a space budget"};
+    app.add_option("-c,--collection", input_basename, "Collection basename")->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    app.add_option(
+           "--predictors",
+           predictors_filename,
+           "Decoding time predictors of the hybrid codecs, fitted on `profile_decoding` output")
+        ->required();
+    app.add_option(
+        "--space-budget",
+        space_budget,
+        "Maximum size of the posting lists in bytes; without it, every list gets its fastest "
+        "codec");
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::task_scheduler_init init(app.threads());
+    binary_freq_collection input(input_basename.c_str());
+    std::vector<sequence_type> lists(input.begin(), input.end());
+    auto predictors = load_predictors(predictors_filename.c_str(), hybrid_codec_count);
+
+    // The lists of terms not in the query log are never decoded, so they cost no time.
+    std::vector<uint64_t> weights(lists.size(), 0);
+    for (auto const& query: app.queries()) {
+        for (auto term: query.terms) {
+            if (term < weights.size()) {
+                weights[term] += 1;
+            }
+        }
+    }
+
+    std::vector<std::array<hybrid_codec_cost, hybrid_codec_count>> costs(lists.size());
+    {
+        pisa::progress progress("Predicting list costs", lists.size());
+        tbb::parallel_for(size_t(0), lists.size(), [&](size_t term) {
+            costs[term] = list_costs(lists[term], weights[term], predictors);
+            progress.update(1);
+        });
+    }
+    auto selection = select_hybrid_codecs(costs, space_budget);
+
+    std::array<size_t, hybrid_codec_count> lists_per_codec{};
+    uint64_t space = 0;
+    double time = 0;
+    for (size_t term = 0; term < lists.size(); ++term) {
+        lists_per_codec[selection[term]] += 1;
+        space += costs[term][selection[term]].space;
+        time += costs[term][selection[term]].time;
+    }
+    if (space_budget && space > *space_budget) {
+        spdlog::warn("The smallest lists take {} bytes, over the budget", space);
+    }
+    for (uint8_t codec = 0; codec < hybrid_codec_count; ++codec) {
+        spdlog::info("{}: {} lists", hybrid_codec_names[codec], lists_per_codec[codec]);
+    }
+    spdlog::info("Lists size: {} bytes, predicted decoding time: {:.0f} ns", space, time);
+
+    global_parameters params;
+    hybrid_block_index::builder builder(input.num_docs(), params);
+    {
+        pisa::progress progress("Encoding lists", lists.size());
+        for (size_t term = 0; term < lists.size(); ++term) {
+            auto const& list = lists[term];
+            builder.add_posting_list(
+                selection[term], list.docs.size(), list.docs.begin(), list.freqs.begin());
+            progress.update(1);
+        }
+    }
+    hybrid_block_index index;
+    builder.build(index);
+    mapper::freeze(
+        index, output_filename.c_str(), mapper::file_description{"block_hybrid", input.num_docs()});
+
+    stats_line()("type", "block_hybrid")("lists_bytes", space)("predicted_time_ns", time)(
+        "simdbp_lists", lists_per_codec[0])("varintgb_lists", lists_per_codec[1])(
+        "optpfor_lists", lists_per_codec[2])("interpolative_lists", lists_per_codec[3]);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <boost/filesystem.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "impact_index.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "util/progress.hpp"
+
+using namespace pisa;
+
+template <typename IndexType>
+void create_impact_index(
+    std::string const& index_filename,
+    mapper::load_mode load_mode,
+    std::string const& output_filename,
+    std::size_t min_length)
+{
+    IndexType index;
+    spdlog::info("Loading index from {}", index_filename);
+    mapper::mapped_file m(index_filename, load_mode);
+    mapper::map(index, m);
+
+    global_parameters params;
+    impact_simdbp_index::builder builder(index.num_docs(), params);
+    std::size_t stored_lists = 0;
+    std::size_t stored_postings = 0;
+    std::size_t postings = 0;
+    {
+        pisa::progress progress("Reordering postings by impact", index.size());
+        std::vector<uint32_t> docs;
+        std::vector<uint32_t> impacts;
+        for (size_t term = 0; term < index.size(); ++term) {
+            auto size = index[term].size();
+            postings += size;
+            if (size < min_length) {
+                builder.add_empty_list();
+                progress.update(1);
+                continue;
+            }
+            stored_lists += 1;
+            stored_postings += size;
+            docs.clear();
+            impacts.clear();
+            for (auto list = index[term]; list.docid() < index.num_docs(); list.next()) {
+                docs.push_back(list.docid());
+                impacts.push_back(list.freq());
+            }
+            builder.add_posting_list(docs.size(), docs.begin(), impacts.begin());
+            progress.update(1);
+        }
+    }
+
+    spdlog::info(
+        "Storing {} of {} lists, with {} of {} postings, in impact order",
+        stored_lists,
+        index.size(),
+        stored_postings,
+        postings);
+
+    impact_simdbp_index impact_index;
+    builder.build(impact_index);
+    auto bytes = mapper::freeze(impact_index, output_filename.c_str());
+    spdlog::info(
+        "Impact-ordered index of {} bytes, {:.2f}% of the index",
+        bytes,
+        100.0 * bytes / boost::filesystem::file_size(index_filename));
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string output_filename;
+    std::size_t min_length = 0;
+
+    App<arg::Index> app{
+        "Creates an impact-ordered index from an index built with `create_freq_index --quantize`"};
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    app.add_option(
+        "--min-length",
+        min_length,
+        "Store only the lists of at least this many postings, to be queried along with the "
+        "index (0 stores all)");
+    CLI11_PARSE(app, argc, argv);
+    app.check_index();
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                              \
+    }                                                                                      \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                \
+    {                                                                                      \
+        create_impact_index<BOOST_PP_CAT(T, _index)>(                                      \
+            app.index_filename(), app.load_mode(), output_filename, min_length);           \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "index_types.hpp"
+#include "intersection_cache.hpp"
+#include "mappable/mapper.hpp"
+#include "scorer/scorer.hpp"
+#include "util/progress.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+template <typename IndexType, typename WandType>
+void create_intersection_cache(
+    std::string const& index_filename,
+    mapper::load_mode load_mode,
+    std::string const& wand_data_filename,
+    std::vector<Query> const& queries,
+    std::string const& scorer_name,
+    std::size_t pair_count,
+    std::string const& output_filename)
+{
+    IndexType index;
+    mapper::mapped_file m(index_filename, load_mode);
+    mapper::map(index, m);
+
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    auto pairs = intersection_cache::select_pairs(queries, pair_count);
+    spdlog::info("Selected {} term pairs from {} queries", pairs.size(), queries.size());
+
+    intersection_cache::builder builder(index.num_docs());
+    std::size_t postings = 0;
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        progress intersect_progress("Intersecting term pairs", pairs.size());
+        for (auto pair: pairs) {
+            auto [docs, scores] = intersection_cache::intersect(index, scorer, pair);
+            postings += docs.size();
+            builder.add_pair(pair, std::move(docs), std::move(scores));
+            intersect_progress.update(1);
+        }
+    });
+    spdlog::info("Materialized {} postings", postings);
+
+    intersection_cache cache;
+    builder.build(cache);
+    mapper::freeze(cache, output_filename.c_str());
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    std::size_t pair_count = 0;
+    std::string output_filename;
+
+    App<arg::Index, arg::WandData, arg::Query<arg::QueryMode::Unranked>, arg::Scorer> app{
+        "Precomputes intersections of the term pairs most frequent in a query log."};
+    app.add_option("--pairs", pair_count, "Number of term pairs to precompute")->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    CLI11_PARSE(app, argc, argv);
+    app.check_index();
+
+    if (not app.wand_data_path()) {
+        spdlog::error("WAND data is required");
+        return 1;
+    }
+
+    auto params = std::make_tuple(
+        app.index_filename(),
+        app.load_mode(),
+        *app.wand_data_path(),
+        app.queries(),
+        app.scorer(),
+        pair_count,
+        output_filename);
+
+    /**/
+    if (false) {  // NOLINT
+#define LOOP_BODY(R, DATA, T)                                                                   \
+    }                                                                                           \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                     \
+    {                                                                                           \
+        if (app.is_wand_compressed()) {                                                         \
+            std::apply(                                                                         \
+                create_intersection_cache<BOOST_PP_CAT(T, _index), wand_uniform_index>, params); \
+        } else {                                                                                \
+            std::apply(                                                                         \
+                create_intersection_cache<BOOST_PP_CAT(T, _index), wand_raw_index>, params);    \
+        }                                                                                       \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+}
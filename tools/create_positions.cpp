@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "codec/simdbp.hpp"
+#include "mappable/mapper.hpp"
+#include "positional_index.hpp"
+#include "util/progress.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string input_basename;
+    std::string forward_index_filename;
+    std::string output_filename;
+
+    CLI::App app{"Creates the positional index of a collection for phrase queries."};
+    app.add_option("-c,--collection", input_basename, "Collection basename")->required();
+    app.add_option(
+           "-f,--fwd", forward_index_filename, "Forward index the collection was inverted from")
+        ->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    CLI11_PARSE(app, argc, argv);
+
+    binary_freq_collection input(input_basename.c_str());
+
+    // positions are laid out term after term, in the order of their postings
+    std::vector<uint64_t> term_offsets{0};
+    for (auto const& plist: input) {
+        uint64_t occurrences = 0;
+        for (auto freq: plist.freqs) {
+            occurrences += freq;
+        }
+        term_offsets.push_back(term_offsets.back() + occurrences);
+    }
+    std::vector<uint32_t> positions(term_offsets.back());
+    std::vector<uint64_t> term_cursors(term_offsets.begin(), term_offsets.end() - 1);
+
+    binary_collection fwd(forward_index_filename.c_str());
+    auto doc_it = fwd.begin();
+    if (doc_it->size() != 1 || *doc_it->begin() != input.num_docs()) {
+        spdlog::error("The forward index does not match the collection");
+        return 1;
+    }
+    {
+        progress invert_progress("Inverting positions", input.num_docs());
+        for (++doc_it; doc_it != fwd.end(); ++doc_it) {
+            uint32_t position = 0;
+            for (auto term: *doc_it) {
+                if (term >= term_cursors.size()
+                    || term_cursors[term] == term_offsets[term + 1]) {
+                    spdlog::error("The forward index does not match the collection");
+                    return 1;
+                }
+                positions[term_cursors[term]++] = position++;
+            }
+            invert_progress.update(1);
+        }
+    }
+
+    positional_index<simdbp_block>::builder builder;
+    std::size_t term = 0;
+    for (auto const& plist: input) {
+        if (term_cursors[term] != term_offsets[term + 1]) {
+            spdlog::error("The forward index does not match the collection");
+            return 1;
+        }
+        builder.add_list(
+            plist.freqs.size(), plist.freqs.begin(), positions.begin() + term_offsets[term]);
+        term += 1;
+    }
+
+    positional_index<simdbp_block> index;
+    builder.build(index);
+    mapper::freeze(index, output_filename.c_str());
+    spdlog::info("Stored the positions of {} terms", index.size());
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "scorer/scorer.hpp"
+#include "term_thresholds.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+template <typename IndexType, typename WandType>
+void create_term_thresholds(
+    std::string const& index_filename,
+    mapper::load_mode load_mode,
+    std::string const& wand_data_filename,
+    std::string const& scorer_name,
+    std::vector<uint64_t> const& ks,
+    std::string const& output_filename)
+{
+    IndexType index;
+    mapper::mapped_file m(index_filename, load_mode);
+    mapper::map(index, m);
+
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    term_thresholds thresholds;
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        term_thresholds::build(index, scorer, ks, thresholds);
+    });
+    for (std::size_t level = 0; level < thresholds.ks().size(); ++level) {
+        spdlog::info(
+            "{} out of {} terms have at least {} scored postings",
+            thresholds.bounded_terms(level),
+            thresholds.size(),
+            thresholds.ks()[level]);
+    }
+    mapper::freeze(thresholds, output_filename.c_str());
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    std::string output_filename;
+    std::vector<uint64_t> ks;
+
+    App<arg::Index, arg::WandData, arg::Scorer> app{
+        "Computes the k-th highest score of each term, to estimate query thresholds."};
+    app.add_option("-k", ks, "The numbers of top results the thresholds are estimated for")
+        ->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    CLI11_PARSE(app, argc, argv);
+    app.check_index();
+
+    if (not app.wand_data_path()) {
+        spdlog::error("WAND data is required");
+        return 1;
+    }
+
+    auto params = std::make_tuple(
+        app.index_filename(),
+        app.load_mode(),
+        *app.wand_data_path(),
+        app.scorer(),
+        ks,
+        output_filename);
+
+    /**/
+    if (false) {  // NOLINT
+#define LOOP_BODY(R, DATA, T)                                                                    \
+    }                                                                                            \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                      \
+    {                                                                                            \
+        if (app.is_wand_compressed()) {                                                          \
+            std::apply(                                                                          \
+                create_term_thresholds<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);    \
+        } else {                                                                                 \
+            std::apply(create_term_thresholds<BOOST_PP_CAT(T, _index), wand_raw_index>, params); \
+        }                                                                                        \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+}
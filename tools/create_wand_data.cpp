@@ -1,13 +1,21 @@
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include "boost/variant.hpp"
+#include "mio/mmap.hpp"
 #include "spdlog/spdlog.h"
+#include "tbb/task_scheduler_init.h"
 
 #include "binary_collection.hpp"
 #include "binary_freq_collection.hpp"
+#include "global_statistics.hpp"
 #include "mappable/mapper.hpp"
+#include "scorer/scorer.hpp"
+#include "term_thresholds.hpp"
 #include "util/util.hpp"
 #include "wand_data.hpp"
 #include "wand_data_compressed.hpp"
@@ -22,13 +30,20 @@ int main(int argc, const char** argv)
 
     std::optional<float> lambda{};
     std::optional<uint64_t> fixed_block_size{};
+    std::optional<float> optimal_block_size{};
     std::string input_basename;
     std::string output_filename;
     std::string scorer_name;
     bool compress = false;
     bool range = false;
     bool quantize = false;
+    bool block_impacts = false;
+    int norm_len_bits = 0;
     std::string terms_to_drop_filename;
+    size_t threads = std::thread::hardware_concurrency();
+    std::optional<std::string> term_thresholds_filename{};
+    std::optional<std::string> global_stats_filename{};
+    std::vector<uint64_t> term_thresholds_ks = term_thresholds::default_ks;
 
     CLI::App app{"create_wand_data - a tool for creating additional data for query processing."};
     app.add_option("-c,--collection", input_basename, "Collection basename")->required();
@@ -39,22 +54,65 @@ int main(int argc, const char** argv)
     auto block_lambda_opt =
         block_group->add_option("-l,--lambda", lambda, "Lambda parameter for variable blocks")
             ->excludes(block_size_opt);
+    auto block_optimal_opt = block_group
+                                 ->add_option(
+                                     "--optimal-block-size",
+                                     optimal_block_size,
+                                     "Average size of variable blocks with minimal score error")
+                                 ->excludes(block_size_opt)
+                                 ->excludes(block_lambda_opt);
     block_group->require_option();
 
-    app.add_flag("--compress", compress, "Compress additional data");
+    auto* compress_opt = app.add_flag("--compress", compress, "Compress additional data");
     app.add_flag("--quantize", quantize, "Quantize scores");
+    app.add_option(
+        "--quantize-norms",
+        norm_len_bits,
+        "Store document length norms quantized to the given number of bits (8 or 16)");
     app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
+    auto* block_impacts_opt = app.add_flag(
+        "--block-impacts",
+        block_impacts,
+        "Also store the highest frequency and the shortest document of every block, from which "
+        "BM25 bounds can be computed for other parameters");
+    block_impacts_opt->excludes(compress_opt);
     app.add_flag("--range", range, "Create docid-range based data")
+        ->excludes(block_impacts_opt)
         ->excludes(block_size_opt)
-        ->excludes(block_lambda_opt);
+        ->excludes(block_lambda_opt)
+        ->excludes(block_optimal_opt);
     app.add_option(
         "--terms-to-drop",
         terms_to_drop_filename,
         "A filename containing a list of term IDs that we want to drop");
+    app.add_option(
+        "--global-stats",
+        global_stats_filename,
+        "Global statistics of the shard, as computed by `compute_global_statistics`, with which "
+        "documents are scored");
+    app.add_option("-j,--threads", threads, "Number of threads");
+    auto term_thresholds_opt = app.add_option(
+        "--term-thresholds",
+        term_thresholds_filename,
+        "Also write the k-th highest score of each term to this file");
+    app.add_option(
+           "--term-thresholds-k",
+           term_thresholds_ks,
+           "The values of k of the term thresholds",
+           true)
+        ->needs(term_thresholds_opt);
 
     CLI11_PARSE(app, argc, argv);
 
-    std::string partition_type_name = (lambda) ? "variable partition" : "static partition";
+    tbb::task_scheduler_init init(threads);
+    spdlog::info("Number of threads: {}", threads);
+
+    std::string partition_type_name = "static partition";
+    if (lambda) {
+        partition_type_name = "variable partition";
+    } else if (optimal_block_size) {
+        partition_type_name = "optimal partition";
+    }
     spdlog::info("Block based wand creation with {}", partition_type_name);
 
     binary_collection sizes_coll((input_basename + ".sizes").c_str());
@@ -73,12 +131,54 @@ int main(int argc, const char** argv)
         if (lambda) {
             spdlog::info("Lambda {}", *lambda);
             return VariableBlock(*lambda);
+        } else if (optimal_block_size) {
+            spdlog::info("Average block size: {}", *optimal_block_size);
+            return OptimalBlock(*optimal_block_size);
         } else {
             spdlog::info("Fixed block size: {}", *fixed_block_size);
             return FixedBlock(*fixed_block_size);
         }
     }();
 
+    mio::mmap_source global_stats_source;
+    std::optional<global_statistics> global_stats;
+    if (global_stats_filename) {
+        global_stats_source = mio::mmap_source(global_stats_filename->c_str());
+        global_stats.emplace();
+        mapper::map(*global_stats, global_stats_source);
+        spdlog::info(
+            "Scoring with the statistics of a collection of {} documents",
+            global_stats->num_docs());
+    }
+    global_statistics const* global_stats_ptr = global_stats ? &*global_stats : nullptr;
+
+    auto write = [&](auto const& wdata) {
+        mapper::freeze(wdata, output_filename.c_str());
+        if (term_thresholds_filename) {
+            spdlog::info("Computing term thresholds...");
+            term_thresholds thresholds;
+            auto build_thresholds = [&](auto const& scoring_wdata) {
+                scorer::with_scorer(scorer_name, scoring_wdata, [&](auto const& scorer) {
+                    term_thresholds::build(
+                        coll, scorer, term_thresholds_ks, dropped_term_ids, thresholds);
+                });
+            };
+            if (global_stats) {
+                build_thresholds(global_wand_data(wdata, *global_stats));
+            } else {
+                build_thresholds(wdata);
+            }
+            for (std::size_t level = 0; level < thresholds.ks().size(); ++level) {
+                spdlog::info(
+                    "{} out of {} terms have at least {} scored postings",
+                    thresholds.bounded_terms(level),
+                    thresholds.size(),
+                    thresholds.ks()[level]);
+            }
+            mapper::freeze(thresholds, term_thresholds_filename->c_str());
+        }
+    };
+
     if (compress) {
         wand_data<wand_data_compressed<>> wdata(
             sizes_coll.begin()->begin(),
@@ -87,8 +187,10 @@ int main(int argc, const char** argv)
             scorer_name,
             block_size,
             quantize,
-            dropped_term_ids);
-        mapper::freeze(wdata, output_filename.c_str());
+            dropped_term_ids,
+            norm_len_bits,
+            global_stats_ptr);
+        write(wdata);
     } else if (range) {
         wand_data<wand_data_range<128, 1024>> wdata(
             sizes_coll.begin()->begin(),
@@ -97,8 +199,10 @@ int main(int argc, const char** argv)
             scorer_name,
             block_size,
             quantize,
-            dropped_term_ids);
-        mapper::freeze(wdata, output_filename.c_str());
+            dropped_term_ids,
+            norm_len_bits,
+            global_stats_ptr);
+        write(wdata);
     } else {
         wand_data<wand_data_raw> wdata(
             sizes_coll.begin()->begin(),
@@ -107,7 +211,13 @@ int main(int argc, const char** argv)
             scorer_name,
             block_size,
             quantize,
-            dropped_term_ids);
-        mapper::freeze(wdata, output_filename.c_str());
+            dropped_term_ids,
+            norm_len_bits,
+            global_stats_ptr);
+        if (block_impacts) {
+            spdlog::info("Storing block impacts...");
+            wdata.store_block_impacts(coll, dropped_term_ids);
+        }
+        write(wdata);
     }
 }
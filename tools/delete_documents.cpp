@@ -0,0 +1,191 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "deleted_documents.hpp"
+#include "fat_block_index.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "payload_vector.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
+
+template <typename IndexType, typename WandType>
+void write_deleted_blocks(
+    std::string const& index_filename,
+    std::string const& wand_data_filename,
+    deleted_documents const& deleted,
+    std::string const& output_filename)
+{
+    IndexType index;
+    mio::mmap_source m(index_filename.c_str());
+    mapper::map(index, m);
+
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md);
+
+    deleted_blocks blocks(index, block_max_data(index, wdata), deleted);
+    mapper::freeze(blocks, output_filename.c_str());
+}
+
+/// Returns the IDs of the documents listed in `is`, either as IDs or as titles to look up in
+/// `documents`.
+auto read_documents(std::istream& is, Payload_Vector<> const& documents, bool docids)
+    -> std::vector<uint64_t>
+{
+    std::vector<uint64_t> deleted;
+    if (docids) {
+        std::copy(
+            std::istream_iterator<uint64_t>(is),
+            std::istream_iterator<uint64_t>(),
+            std::back_inserter(deleted));
+        return deleted;
+    }
+    std::unordered_map<std::string, bool> titles;
+    for (auto line = std::istream_iterator<io::Line>(is); line != std::istream_iterator<io::Line>();
+         ++line) {
+        titles.emplace(*line, false);
+    }
+    uint64_t docid = 0;
+    for (auto title: documents) {
+        if (auto pos = titles.find(std::string(title)); pos != titles.end()) {
+            deleted.push_back(docid);
+            pos->second = true;
+        }
+        docid += 1;
+    }
+    for (auto const& [title, found]: titles) {
+        if (not found) {
+            spdlog::warn("Document not found: {}", title);
+        }
+    }
+    return deleted;
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string documents_filename;
+    std::optional<std::string> input_filename;
+    std::optional<std::string> previous_filename;
+    std::string output_filename;
+    bool docids = false;
+    bool keep = false;
+    std::string index_filename;
+    std::string index_encoding;
+    std::string wand_data_filename;
+    bool compressed_wand = false;
+    bool quantized = false;
+    std::string blocks_filename;
+
+    CLI::App app{
+        "Marks documents as deleted, so that they are excluded from query results without "
+        "rebuilding the index"};
+    app.add_option("--documents", documents_filename, "Document lexicon")->required();
+    app.add_option(
+        "--input", input_filename, "Document titles to delete, one per line (default: stdin)");
+    app.add_flag("--docids", docids, "Read document IDs instead of titles");
+    app.add_flag(
+        "--keep",
+        keep,
+        "Keep only the input documents and delete the others, to filter queries to them");
+    app.add_option("--previous", previous_filename, "Documents deleted previously, to keep");
+    app.add_option("-o,--output", output_filename, "Output deleted documents")->required();
+    auto* index = app.add_option(
+        "-i,--index", index_filename, "Inverted index, to find blocks of deleted documents");
+    auto* encoding = app.add_option("-e,--encoding", index_encoding, "Index encoding");
+    auto* wand = app.add_option("-w,--wand", wand_data_filename, "WAND data filename");
+    app.add_flag("--compressed-wand", compressed_wand, "Compressed WAND data file")->needs(wand);
+    app.add_flag("--quantized", quantized, "Quantized scores")->needs(wand);
+    auto* blocks = app.add_option(
+        "--blocks-output",
+        blocks_filename,
+        "Output blocks of the WAND data whose documents are all deleted");
+    blocks->needs(index)->needs(encoding)->needs(wand);
+    index->needs(blocks);
+    CLI11_PARSE(app, argc, argv);
+
+    mio::mmap_source mdoc(documents_filename.c_str());
+    auto documents = Payload_Vector<>::from(mdoc);
+
+    std::vector<uint64_t> docs;
+    if (input_filename) {
+        std::ifstream is(*input_filename);
+        docs = read_documents(is, documents, docids);
+    } else {
+        docs = read_documents(std::cin, documents, docids);
+    }
+    if (keep) {
+        auto filter = deleted_documents::keeping(documents.size(), docs);
+        docs.clear();
+        for (uint64_t docid = 0; docid < filter.num_docs(); ++docid) {
+            if (filter.is_deleted(docid)) {
+                docs.push_back(docid);
+            }
+        }
+    }
+    if (previous_filename) {
+        deleted_documents previous;
+        mio::mmap_source mprev(previous_filename->c_str());
+        mapper::map(previous, mprev);
+        for (uint64_t docid = 0; docid < previous.num_docs(); ++docid) {
+            if (previous.is_deleted(docid)) {
+                docs.push_back(docid);
+            }
+        }
+    }
+
+    deleted_documents deleted(documents.size(), docs);
+    spdlog::info("{} of {} documents deleted", deleted.count(), deleted.num_docs());
+    mapper::freeze(deleted, output_filename.c_str());
+
+    if (blocks_filename.empty()) {
+        return 0;
+    }
+    auto run = [&](auto write) {
+        write(index_filename, wand_data_filename, deleted, blocks_filename);
+    };
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                     \
+    }                                                                                             \
+    else if (index_encoding == BOOST_PP_STRINGIZE(T))                                             \
+    {                                                                                             \
+        if (compressed_wand) {                                                                    \
+            if (quantized) {                                                                      \
+                run(write_deleted_blocks<BOOST_PP_CAT(T, _index), wand_uniform_index_quantized>); \
+            } else {                                                                              \
+                run(write_deleted_blocks<BOOST_PP_CAT(T, _index), wand_uniform_index>);           \
+            }                                                                                     \
+        } else {                                                                                  \
+            run(write_deleted_blocks<BOOST_PP_CAT(T, _index), wand_raw_index>);                   \
+        }
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else if (index_encoding == "fat_block_simdbp") {
+        run(write_deleted_blocks<fat_block_simdbp_index, wand_raw_index>);
+    } else {
+        spdlog::error("Unknown type {}", index_encoding);
+        return 1;
+    }
+    return 0;
+}
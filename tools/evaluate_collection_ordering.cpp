@@ -1,49 +1,207 @@
 #include <algorithm>
-#include <fstream>
+#include <cmath>
 #include <iostream>
 #include <numeric>
+#include <optional>
 #include <random>
+#include <string>
 #include <thread>
+#include <vector>
 
-#include "mappable/mapper.hpp"
+#include "CLI/CLI.hpp"
 #include "spdlog/spdlog.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_reduce.h"
+#include "tbb/task_scheduler_init.h"
 
+#include "app.hpp"
+#include "binary_collection.hpp"
 #include "binary_freq_collection.hpp"
+#include "block_max_simulation.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
 #include "util/index_build_utils.hpp"
 #include "util/util.hpp"
 
-int main(int argc, const char** argv)
+using namespace pisa;
+
+using sequence_type = binary_freq_collection::sequence;
+
+struct log_gap_stats {
+    double log_gaps = 0.0;
+    std::size_t gaps = 0;
+};
+
+/// Sums the log2 of the document ID gaps of all lists, in parallel over terms.
+[[nodiscard]] auto log_gaps(std::vector<sequence_type> const& lists) -> log_gap_stats
 {
-    using namespace pisa;
+    std::vector<float> log2_data(256);
+    for (size_t i = 0; i < 256; ++i) {
+        log2_data[i] = log2f(i);
+    }
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, lists.size()),
+        log_gap_stats{},
+        [&](tbb::blocked_range<size_t> const& range, log_gap_stats stats) {
+            for (auto term = range.begin(); term != range.end(); ++term) {
+                auto const& docs = lists[term].docs;
+                if (docs.size() == 0) {
+                    continue;
+                }
+                stats.gaps += docs.size();
+                stats.log_gaps += log2f(docs.begin()[0] + 1);
+                for (size_t i = 1; i < docs.size(); ++i) {
+                    auto gap = docs.begin()[i] - docs.begin()[i - 1];
+                    stats.log_gaps += gap < 256 ? log2_data[gap] : log2f(gap);
+                }
+            }
+            return stats;
+        },
+        [](log_gap_stats lhs, log_gap_stats const& rhs) {
+            lhs.log_gaps += rhs.log_gaps;
+            lhs.gaps += rhs.gaps;
+            return lhs;
+        });
+}
 
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <collection basename>" << std::endl;
-        return 1;
+/// Compresses the `sample` lists with `CollectionType` and returns the size of the index.
+template <typename CollectionType>
+[[nodiscard]] auto compressed_size(
+    std::vector<sequence_type> const& lists, std::vector<size_t> const& sample, uint64_t num_docs)
+    -> std::size_t
+{
+    global_parameters params;
+    typename CollectionType::builder builder(num_docs, params);
+    for (auto term: sample) {
+        auto const& list = lists[term];
+        uint64_t freqs_sum = std::accumulate(list.freqs.begin(), list.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            list.docs.size(), list.docs.begin(), list.freqs.begin(), freqs_sum);
+    }
+    CollectionType coll;
+    builder.build(coll);
+    return mapper::size_tree_of(coll)->size;
+}
+
+[[nodiscard]] auto compressed_size(
+    std::string const& encoding,
+    std::vector<sequence_type> const& lists,
+    std::vector<size_t> const& sample,
+    uint64_t num_docs) -> std::optional<std::size_t>
+{
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                     \
+    }                                                                             \
+    else if (encoding == BOOST_PP_STRINGIZE(T))                                   \
+    {                                                                             \
+        return compressed_size<BOOST_PP_CAT(T, _index)>(lists, sample, num_docs); \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
     }
+    return std::nullopt;
+}
+
+int main(int argc, char** argv)
+{
+    std::string input_basename;
+    std::vector<std::string> encodings;
+    std::size_t sample_size = 1000;
+    std::uint64_t seed = 0;
+    std::size_t k = 10;
+    std::size_t block_size = Block_Max_Simulation::default_block_size;
 
-    const std::string input_basename = argv[1];
+    App<arg::Threads, arg::Query<arg::QueryMode::Unranked>> app{
+        "Evaluates the document ordering of a collection by the log-gaps of its posting lists, "
+        "by the compressed size of a sample of lists, and by the blocks block-max WAND scores "
+        "for a sample of queries"};
+    app.add_option("collection", input_basename, "Collection basename")->required();
+    app.add_option(
+        "-e,--encoding", encodings, "Index encodings whose compressed size to estimate");
+    app.add_option(
+        "--sample-lists", sample_size, "Number of lists compressed to estimate sizes", true);
+    app.add_option("--seed", seed, "Seed of the list sample", true);
+    app.add_option("-k", k, "Number of documents retrieved by the simulated queries", true);
+    app.add_option(
+        "--block-size", block_size, "Postings per block of the simulated block-max scores", true);
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::task_scheduler_init init(app.threads());
     binary_freq_collection input(input_basename.c_str());
+    std::vector<sequence_type> lists(input.begin(), input.end());
 
     spdlog::info("Computing statistics about document ID space");
+    auto stats = log_gaps(lists);
+    spdlog::info("Average LogGap of documents: {}", stats.log_gaps / stats.gaps);
 
-    std::vector<float> log2_data(256);
-    for (size_t i = 0; i < 256; ++i) {
-        log2_data[i] = log2f(i);
+    if (app.query_file()) {
+        binary_collection sizes_collection((input_basename + ".sizes").c_str());
+        auto sizes = *sizes_collection.begin();
+        std::vector<std::uint32_t> document_sizes(sizes.begin(), sizes.end());
+        auto queries = app.queries();
+        spdlog::info(
+            "Simulating {} queries with blocks of {} postings", queries.size(), block_size);
+        Block_Max_Simulation simulation(lists, document_sizes, k, block_size);
+        auto estimate = simulation.estimate(queries);
+        auto per_query = [&](std::size_t count) {
+            return static_cast<double>(count) / std::max<std::size_t>(estimate.queries, 1);
+        };
+        spdlog::info(
+            "Per query, blocks scored: {:.1f} of {:.1f}, postings scored: {:.1f} of {:.1f}",
+            per_query(estimate.scored_blocks),
+            per_query(estimate.blocks),
+            per_query(estimate.scored_postings),
+            per_query(estimate.postings));
+        stats_line()("queries", estimate.queries)("k", k)("block_size", block_size)(
+            "blocks", estimate.blocks)("scored_blocks", estimate.scored_blocks)(
+            "postings", estimate.postings)("scored_postings", estimate.scored_postings)(
+            "scored_blocks_per_query", per_query(estimate.scored_blocks));
+    }
+
+    if (encodings.empty()) {
+        return 0;
+    }
+
+    // Term IDs do not depend on the document ordering, so the same seed samples the same lists
+    // for every ordering of a collection.
+    std::vector<size_t> sample(lists.size());
+    std::iota(sample.begin(), sample.end(), 0);
+    if (sample_size < lists.size()) {
+        std::mt19937_64 rng(seed);
+        std::shuffle(sample.begin(), sample.end(), rng);
+        sample.resize(sample_size);
+        std::sort(sample.begin(), sample.end());
+    }
+    std::size_t sample_postings = 0;
+    for (auto term: sample) {
+        sample_postings += lists[term].docs.size();
+    }
+    if (sample_postings == 0) {
+        spdlog::error("No postings to compress");
+        return 1;
     }
+    spdlog::info("Compressing {} lists with {} postings", sample.size(), sample_postings);
 
-    double all_log_gaps = 0.0f;
-    size_t no_gaps = 0;
-    for (const auto& seq: input) {
-        no_gaps += seq.docs.size();
-        all_log_gaps += log2f(seq.docs.begin()[0] + 1);
-        for (size_t i = 1; i < seq.docs.size(); ++i) {
-            auto gap = seq.docs.begin()[i] - seq.docs.begin()[i - 1];
-            if (gap < 256)
-                all_log_gaps += log2_data[gap];
-            else
-                all_log_gaps += log2f(gap);
+    std::vector<std::optional<std::size_t>> sizes(encodings.size());
+    tbb::parallel_for(size_t(0), encodings.size(), [&](size_t idx) {
+        sizes[idx] = compressed_size(encodings[idx], lists, sample, input.num_docs());
+    });
+    for (size_t idx = 0; idx < encodings.size(); ++idx) {
+        if (not sizes[idx]) {
+            spdlog::error("Unknown type {}", encodings[idx]);
+            continue;
         }
+        auto estimated_size = static_cast<double>(*sizes[idx]) * lists.size() / sample.size();
+        spdlog::info(
+            "{}: {:.3f} bits per posting, estimated index size {:.0f} bytes",
+            encodings[idx],
+            8.0 * *sizes[idx] / sample_postings,
+            estimated_size);
+        stats_line()("type", encodings[idx])("sample_lists", sample.size())(
+            "sample_postings", sample_postings)("sample_bytes", *sizes[idx])(
+            "bits_per_posting", 8.0 * *sizes[idx] / sample_postings)(
+            "estimated_bytes", estimated_size);
     }
-    double average_log_gap = all_log_gaps / no_gaps;
-    spdlog::info("Average LogGap of documents: {}", average_log_gap);
+    return 0;
 }
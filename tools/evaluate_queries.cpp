@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <string>
 #include <thread>
 
 #include <CLI/CLI.hpp>
@@ -14,15 +20,30 @@
 #include <tbb/parallel_for.h>
 #include <tbb/task_scheduler_init.h>
 
+#include "accumulator/accumulator_pool.hpp"
+#include "accumulator/compact_accumulator.hpp"
 #include "accumulator/lazy_accumulator.hpp"
 #include "app.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/impact_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
+#include "deleted_documents.hpp"
+#include "document_lexicon.hpp"
+#include "impact_index.hpp"
 #include "index_types.hpp"
+#include "intersection_cache.hpp"
 #include "io.hpp"
+#include "pair_bounds.hpp"
 #include "query/algorithm.hpp"
+#include "query/binary_results.hpp"
+#include "query/candidate_features.hpp"
+#include "query/fusion.hpp"
+#include "query/query_planner.hpp"
+#include "query/rescore.hpp"
+#include "query/result_cache.hpp"
 #include "scorer/scorer.hpp"
+#include "util/ordered_writer.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
@@ -33,6 +54,7 @@ using ranges::views::enumerate;
 template <typename IndexType, typename WandType>
 void evaluate_queries(
     const std::string& index_filename,
+    mapper::load_mode load_mode,
     const std::optional<std::string>& wand_data_filename,
     const std::vector<Query>& queries,
     const std::optional<std::string>& thresholds_filename,
@@ -42,15 +64,61 @@ void evaluate_queries(
     std::string const& documents_filename,
     std::string const& scorer_name,
     std::string const& run_id,
-    std::string const& iteration)
+    std::string const& iteration,
+    std::size_t cache_size,
+    std::optional<std::string> const& intersection_cache_filename,
+    std::optional<std::string> const& pair_bounds_filename,
+    std::optional<std::string> const& deleted_filename,
+    std::optional<std::string> const& deleted_blocks_filename,
+    std::size_t batch_size,
+    query_budget const& budget,
+    float clip_ratio,
+    std::optional<std::string> const& features_filename,
+    std::optional<fusion_method> fusion,
+    float rrf_k,
+    std::size_t interleave,
+    std::optional<std::string> const& rescore_index_filename,
+    std::optional<std::string> const& rescore_wand_filename,
+    std::string const& rescore_scorer_name,
+    uint64_t rescore_depth,
+    std::optional<std::string> const& impact_index_filename,
+    std::optional<std::string> const& binary_output_filename)
 {
     IndexType index;
-    mio::mmap_source m(index_filename.c_str());
+    mapper::mapped_file m(index_filename, load_mode);
     mapper::map(index, m);
 
-    WandType wdata;
+    // With an exact index, queries retrieve `rescore_depth` candidates, e.g., from a quantized
+    // index, and return the top `k` of them rescored exactly.
+    auto const output_k = k;
+    IndexType rescore_index;
+    mapper::mapped_file mrescore;
+    wand_data<wand_data_raw> rescore_wdata;
+    mio::mmap_source mrescore_wand;
+    std::unique_ptr<index_scorer<wand_data<wand_data_raw>>> rescorer;
+    if (rescore_index_filename) {
+        mrescore = mapper::mapped_file(*rescore_index_filename, load_mode);
+        mapper::map(rescore_index, mrescore);
+        if (rescore_index.num_docs() != index.num_docs()) {
+            spdlog::error(
+                "The rescoring index has {} documents, but the index has {}",
+                rescore_index.num_docs(),
+                index.num_docs());
+            std::abort();
+        }
+        std::error_code error;
+        mrescore_wand.map(*rescore_wand_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(rescore_wdata, mrescore_wand, mapper::map_flags::warmup);
+        rescorer = scorer::from_name(rescore_scorer_name, rescore_wdata);
+        k = std::max(k, rescore_depth);
+        spdlog::info("Rescoring the top {} candidates with {}", k, rescore_scorer_name);
+    }
 
-    auto scorer = scorer::from_name(scorer_name, wdata);
+    WandType wdata;
 
     mio::mmap_source md;
     if (wand_data_filename) {
@@ -63,112 +131,561 @@ void evaluate_queries(
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
 
-    std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
-
-    if (query_type == "wand" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            wand_query wand_q(topk);
-            wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "block_max_wand" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_wand_query block_max_wand_q(topk);
-            block_max_wand_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "block_max_maxscore" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_maxscore_query block_max_maxscore_q(topk);
-            block_max_maxscore_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "block_max_ranked_and" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_ranked_and_query block_max_ranked_and_q(topk);
-            block_max_ranked_and_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_and" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            ranked_and_query ranked_and_q(topk);
-            ranked_and_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_or" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            ranked_or_query ranked_or_q(topk);
-            ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "maxscore" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            maxscore_query maxscore_q(topk);
-            maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_or_taat" && wand_data_filename) {
-        query_fun = [&, accumulator = Simple_Accumulator(index.num_docs())](Query query) mutable {
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            ranked_or_taat_q(
-                make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_or_taat_lazy" && wand_data_filename) {
-        query_fun = [&, accumulator = Lazy_Accumulator<4>(index.num_docs())](Query query) mutable {
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            ranked_or_taat_q(
-                make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-            topk.finalize();
-            return topk.topk();
-        };
-    } else {
-        spdlog::error("Unsupported query type: {}", query_type);
+    // Planned queries whose lists are all stored in impact order may be processed
+    // score-at-a-time.
+    impact_simdbp_index impact_index;
+    mio::mmap_source mimpact;
+    if (impact_index_filename) {
+        if (scorer_name != "quantized") {
+            spdlog::error("An impact-ordered index requires the quantized scorer");
+            std::abort();
+        }
+        std::error_code error;
+        mimpact.map(*impact_index_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(impact_index, mimpact);
+        if (impact_index.size() != index.size() || impact_index.num_docs() != index.num_docs()) {
+            spdlog::error("The impact-ordered index does not match the index");
+            std::abort();
+        }
     }
+    auto impact_ordered = [&](Query const& query) {
+        return impact_index_filename
+            && std::all_of(query.terms.begin(), query.terms.end(), [&](auto term) {
+                   return impact_index.stores(term);
+               });
+    };
 
-    auto source = std::make_shared<mio::mmap_source>(documents_filename.c_str());
-    auto docmap = Payload_Vector<>::from(*source);
+    intersection_cache intersections;
+    mio::mmap_source mi;
+    if (intersection_cache_filename) {
+        std::error_code error;
+        mi.map(*intersection_cache_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(intersections, mi, mapper::map_flags::warmup);
+    }
+    auto cached_pair = [&](Query const& query) -> std::optional<std::pair<std::size_t, Query>> {
+        if (not intersection_cache_filename) {
+            return std::nullopt;
+        }
+        return intersections.best_pair(query);
+    };
 
-    std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(queries.size());
-    auto start_batch = std::chrono::steady_clock::now();
-    tbb::parallel_for(size_t(0), queries.size(), [&, query_fun](size_t query_idx) {
-        raw_results[query_idx] = query_fun(queries[query_idx]);
-    });
-    auto end_batch = std::chrono::steady_clock::now();
+    pair_bounds pairs;
+    mio::mmap_source mpairs;
+    if (pair_bounds_filename) {
+        std::error_code error;
+        mpairs.map(*pair_bounds_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(pairs, mpairs, mapper::map_flags::warmup);
+    }
 
-    for (size_t query_idx = 0; query_idx < raw_results.size(); ++query_idx) {
-        auto results = raw_results[query_idx];
-        auto qid = queries[query_idx].id;
+    deleted_documents deleted;
+    mio::mmap_source mdel;
+    if (deleted_filename) {
+        mdel.map(*deleted_filename);
+        mapper::map(deleted, mdel);
+        if (deleted.num_docs() != index.num_docs()) {
+            spdlog::error(
+                "Deleted documents are given for {} documents, but the index has {}",
+                deleted.num_docs(),
+                index.num_docs());
+            std::abort();
+        }
+        spdlog::info("Excluding {} deleted documents", deleted.count());
+    }
+    auto const* deleted_docs = deleted_filename ? &deleted : nullptr;
+    deleted_blocks blocks;
+    mio::mmap_source mblocks;
+    if (deleted_blocks_filename) {
+        mblocks.map(*deleted_blocks_filename);
+        mapper::map(blocks, mblocks);
+    }
+    // Block-max algorithms see the maxima of fully deleted blocks as zero, if given.
+    auto with_block_max_data = [&](auto&& fn) {
+        auto const& data = block_max_data(index, wdata);
+        if (deleted_blocks_filename) {
+            fn(deleted_block_max_data<std::decay_t<decltype(data)>>(data, blocks));
+        } else {
+            fn(data);
+        }
+    };
+
+    Document_Lexicon docmap(documents_filename);
+
+    std::optional<result_cache> cache;
+    if (cache_size > 0) {
+        cache.emplace(cache_size);
+    }
+
+    // Accumulators are shared by the queries running in parallel, instead of being copied with
+    // every copy of the query function.
+    Accumulator_Pool<Simple_Accumulator> simple_accumulators(index.num_docs());
+    Accumulator_Pool<Lazy_Accumulator<4>> lazy_accumulators(index.num_docs());
+    Accumulator_Pool<Bfloat16_Accumulator> bfloat16_accumulators(index.num_docs());
+    Accumulator_Pool<Quantized_Accumulator> quantized_accumulators(index.num_docs());
+    Accumulator_Pool<Simple_Accumulator> simple_window_accumulators(
+        windowed_taat_query::default_window_size);
+    Accumulator_Pool<Lazy_Accumulator<4>> lazy_window_accumulators(
+        windowed_taat_query::default_window_size);
+
+    query_planner planner;
+    std::array<std::atomic<std::size_t>, planned_algorithm_count> planned{};
+    std::atomic<std::size_t> approximate{0};
+
+    auto qid_of = [&](size_t query_idx) {
+        return queries[query_idx].id.value_or(std::to_string(query_idx));
+    };
+    // Results are formatted by the threads running the queries, and written in query order by
+    // the writer thread while later queries still run. Binary results are written as records
+    // of the position of the query, whose ID is on that line of `{binary_output}.queries`.
+    auto format_results = [&](size_t position, std::string const& qid, auto const& results) {
+        if (binary_output_filename) {
+            return binary_result_records(static_cast<uint32_t>(position), results);
+        }
+        thread_local std::string title;
+        std::string lines;
         for (auto&& [rank, result]: enumerate(results)) {
-            std::cout << fmt::format(
+            fmt::format_to(
+                std::back_inserter(lines),
                 "{}\t{}\t{}\t{}\t{}\t{}\n",
-                qid.value_or(std::to_string(query_idx)),
+                qid,
                 iteration,
-                docmap[result.second],
+                docmap.lookup(result.second, title),
                 rank,
                 result.first,
                 run_id);
         }
+        return lines;
+    };
+    std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(queries.size());
+    std::ofstream binary_output;
+    if (binary_output_filename) {
+        binary_output.open(*binary_output_filename, std::ios::binary);
+        binary_output.write(binary_result::magic.data(), binary_result::magic.size());
+    }
+    Ordered_Writer writer(binary_output_filename ? binary_output : std::cout);
+    std::vector<std::string> output_qids;
+    // Fused rankings are written once all their variants are done.
+    auto write_results = [&](size_t query_idx) {
+        if (rescorer) {
+            raw_results[query_idx] = rescore_candidates(
+                rescore_index, *rescorer, queries[query_idx], raw_results[query_idx], output_k);
+        }
+        if (not fusion) {
+            writer.push(
+                query_idx,
+                format_results(query_idx, qid_of(query_idx), raw_results[query_idx]));
+        }
+    };
+
+    auto start_batch = std::chrono::steady_clock::now();
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        // Batched TAAT decodes the lists of terms shared by queries of a batch only once.
+        if (batch_size > 1 && query_type == "ranked_or_taat" && wand_data_filename) {
+            auto batch_count = (queries.size() + batch_size - 1) / batch_size;
+            tbb::parallel_for(size_t(0), batch_count, [&](size_t batch_idx) {
+                auto first = batch_idx * batch_size;
+                auto count = std::min(batch_size, queries.size() - first);
+                batch_ranked_or_taat_query batch_q(
+                    k, batch_ranked_or_taat_query::default_window_size, deleted_docs);
+                auto results =
+                    batch_q(index, scorer, gsl::make_span(queries).subspan(first, count));
+                std::move(results.begin(), results.end(), raw_results.begin() + first);
+                for (auto query_idx = first; query_idx < first + count; ++query_idx) {
+                    write_results(query_idx);
+                }
+            });
+            return;
+        }
+        // Interleaved conjunctions overlap the block loads of a group of queries on each thread.
+        if (interleave > 1 && query_type == "ranked_and" && wand_data_filename) {
+            auto group_count = (queries.size() + interleave - 1) / interleave;
+            tbb::parallel_for(size_t(0), group_count, [&](size_t group_idx) {
+                auto first = group_idx * interleave;
+                auto count = std::min(interleave, queries.size() - first);
+                interleaved_ranked_and_query interleaved_q(
+                    k, interleaved_ranked_and_query::default_prefetch_lines, deleted_docs);
+                auto results =
+                    interleaved_q(index, scorer, gsl::make_span(queries).subspan(first, count));
+                std::move(results.begin(), results.end(), raw_results.begin() + first);
+                for (auto query_idx = first; query_idx < first + count; ++query_idx) {
+                    write_results(query_idx);
+                }
+            });
+            return;
+        }
+
+        std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
+
+        if (query_type == "wand" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                wand_query wand_q(topk);
+                auto cursors = make_max_scored_cursors(index, wdata, scorer, query);
+                if (pair_bounds_filename) {
+                    wand_q(cursors, index.num_docs(), query_pair_bounds(pairs, query, cursors));
+                } else {
+                    wand_q(cursors, index.num_docs());
+                }
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "block_max_wand" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                return with_block_max_score_type(scorer_name, [&](auto score) {
+                    using Score = decltype(score);
+                    basic_topk_queue<Score> topk(k, deleted_docs);
+                    basic_block_max_wand_query<Score> block_max_wand_q(topk, budget);
+                    with_block_max_data([&](auto const& block_max) {
+                        block_max_wand_q(
+                            make_block_max_scored_cursors<Score>(index, block_max, scorer, query),
+                            index.num_docs());
+                    });
+                    if (block_max_wand_q.is_approximate()) {
+                        approximate += 1;
+                    }
+                    topk.finalize();
+                    return std::vector<std::pair<float, uint64_t>>(
+                        topk.topk().begin(), topk.topk().end());
+                });
+            };
+        } else if (query_type == "block_max_maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                return with_block_max_score_type(scorer_name, [&](auto score) {
+                    using Score = decltype(score);
+                    basic_topk_queue<Score> topk(k, deleted_docs);
+                    basic_block_max_maxscore_query<Score> block_max_maxscore_q(topk);
+                    with_block_max_data([&](auto const& block_max) {
+                        block_max_maxscore_q(
+                            make_block_max_scored_cursors<Score>(index, block_max, scorer, query),
+                            index.num_docs());
+                    });
+                    topk.finalize();
+                    return std::vector<std::pair<float, uint64_t>>(
+                        topk.topk().begin(), topk.topk().end());
+                });
+            };
+        } else if (query_type == "dynamic_block_max_maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                return with_block_max_score_type(scorer_name, [&](auto score) {
+                    using Score = decltype(score);
+                    basic_topk_queue<Score> topk(k, deleted_docs);
+                    basic_dynamic_block_max_maxscore_query<Score> dynamic_block_max_maxscore_q(
+                        topk);
+                    with_block_max_data([&](auto const& block_max) {
+                        dynamic_block_max_maxscore_q(
+                            make_block_max_scored_cursors<Score>(index, block_max, scorer, query),
+                            index.num_docs());
+                    });
+                    topk.finalize();
+                    return std::vector<std::pair<float, uint64_t>>(
+                        topk.topk().begin(), topk.topk().end());
+                });
+            };
+        } else if (query_type == "block_max_ranked_and" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                block_max_ranked_and_query block_max_ranked_and_q(topk);
+                with_block_max_data([&](auto const& block_max) {
+                    if (auto pair = cached_pair(query); pair) {
+                        block_max_ranked_and_q(
+                            intersections.cursor(pair->first),
+                            make_block_max_scored_cursors(index, block_max, scorer, pair->second),
+                            index.num_docs());
+                    } else {
+                        block_max_ranked_and_q(
+                            make_block_max_scored_cursors(index, block_max, scorer, query),
+                            index.num_docs());
+                    }
+                });
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_and" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                ranked_and_query ranked_and_q(topk);
+                if (auto pair = cached_pair(query); pair) {
+                    ranked_and_q(
+                        intersections.cursor(pair->first),
+                        make_scored_cursors(index, scorer, pair->second),
+                        index.num_docs());
+                } else {
+                    ranked_and_q(make_scored_cursors(index, scorer, query), index.num_docs());
+                }
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "and_simd" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                ranked_and_simd_query ranked_and_q(topk);
+                ranked_and_q(make_scored_cursors(index, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                ranked_or_query ranked_or_q(topk);
+                ranked_or_q(make_scored_cursors(index, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                maxscore_query maxscore_q(topk, budget);
+                auto cursors = make_max_scored_cursors(index, wdata, scorer, query);
+                if (pair_bounds_filename) {
+                    maxscore_q(
+                        cursors, index.num_docs(), query_pair_bounds(pairs, query, cursors));
+                } else {
+                    maxscore_q(cursors, index.num_docs());
+                }
+                if (maxscore_q.is_approximate()) {
+                    approximate += 1;
+                }
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "long_maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                long_maxscore_query long_maxscore_q(topk);
+                long_maxscore_q(
+                    make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "clipped_maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                long_maxscore_query clipped_maxscore_q(topk, clip_ratio);
+                clipped_maxscore_q(
+                    make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or_taat" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                auto accumulator = simple_accumulators.acquire();
+                topk_queue topk(k, deleted_docs);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                ranked_or_taat_q(
+                    make_scored_cursors(index, scorer, query), index.num_docs(), *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or_taat_lazy" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                auto accumulator = lazy_accumulators.acquire();
+                topk_queue topk(k, deleted_docs);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                ranked_or_taat_q(
+                    make_scored_cursors(index, scorer, query), index.num_docs(), *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or_taat_bf16" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                auto accumulator = bfloat16_accumulators.acquire();
+                topk_queue topk(k, deleted_docs);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                ranked_or_taat_q(
+                    make_scored_cursors(index, scorer, query), index.num_docs(), *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or_taat_quantized" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                auto accumulator = quantized_accumulators.acquire();
+                topk_queue topk(k, deleted_docs);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                ranked_or_taat_q(
+                    make_scored_cursors(index, scorer, query), index.num_docs(), *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "windowed_taat" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                auto accumulator = simple_window_accumulators.acquire();
+                topk_queue topk(k, deleted_docs);
+                windowed_taat_query windowed_taat_q(topk);
+                windowed_taat_q(
+                    make_max_scored_cursors(index, wdata, scorer, query),
+                    index.num_docs(),
+                    *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "windowed_taat_lazy" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                auto accumulator = lazy_window_accumulators.acquire();
+                topk_queue topk(k, deleted_docs);
+                windowed_taat_query windowed_taat_q(topk);
+                windowed_taat_q(
+                    make_max_scored_cursors(index, wdata, scorer, query),
+                    index.num_docs(),
+                    *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "planned" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k, deleted_docs);
+                auto features = query_features::compute(index, wdata, query, std::nullopt);
+                features.impact_ordered = impact_ordered(query);
+                auto algorithm = planner.execute(features, topk, [&](planned_algorithm choice) {
+                    switch (choice) {
+                    case planned_algorithm::block_max_ranked_and:
+                        with_block_max_data([&](auto const& block_max) {
+                            block_max_ranked_and_query block_max_ranked_and_q(topk);
+                            block_max_ranked_and_q(
+                                make_block_max_scored_cursors(index, block_max, scorer, query),
+                                index.num_docs());
+                        });
+                        break;
+                    case planned_algorithm::block_max_maxscore:
+                        with_block_max_data([&](auto const& block_max) {
+                            block_max_maxscore_query block_max_maxscore_q(topk);
+                            block_max_maxscore_q(
+                                make_block_max_scored_cursors(index, block_max, scorer, query),
+                                index.num_docs());
+                        });
+                        break;
+                    case planned_algorithm::block_max_wand:
+                        with_block_max_data([&](auto const& block_max) {
+                            block_max_wand_query block_max_wand_q(topk);
+                            block_max_wand_q(
+                                make_block_max_scored_cursors(index, block_max, scorer, query),
+                                index.num_docs());
+                        });
+                        break;
+                    case planned_algorithm::long_maxscore: {
+                        long_maxscore_query long_maxscore_q(topk);
+                        long_maxscore_q(
+                            make_max_scored_cursors(index, wdata, scorer, query),
+                            index.num_docs());
+                        break;
+                    }
+                    case planned_algorithm::ranked_or_taat: {
+                        auto accumulator = simple_accumulators.acquire();
+                        ranked_or_taat_query ranked_or_taat_q(topk);
+                        ranked_or_taat_q(
+                            make_scored_cursors(index, scorer, query),
+                            index.num_docs(),
+                            *accumulator);
+                        break;
+                    }
+                    case planned_algorithm::impact_saat: {
+                        auto accumulator = simple_accumulators.acquire();
+                        anytime_saat_query impact_saat_q(topk);
+                        impact_saat_q(make_impact_cursors(impact_index, query), *accumulator);
+                        break;
+                    }
+                    }
+                });
+                planned[static_cast<std::size_t>(algorithm)] += 1;
+                return topk.topk();
+            };
+        } else {
+            spdlog::error("Unsupported query type: {}", query_type);
+        }
+
+        if (cache) {
+            query_fun = [&, uncached_fun = std::move(query_fun)](Query query) mutable {
+                return cache->get_or_compute(
+                    result_cache::key(query, k, query_type, scorer_name),
+                    [&]() { return uncached_fun(query); });
+            };
+        }
+
+        tbb::parallel_for(size_t(0), queries.size(), [&, query_fun](size_t query_idx) {
+            raw_results[query_idx] = query_fun(queries[query_idx]);
+            write_results(query_idx);
+        });
+    });
+    auto end_batch = std::chrono::steady_clock::now();
+
+    if (features_filename) {
+        std::vector<std::vector<candidate_features>> features(queries.size());
+        scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+            tbb::parallel_for(size_t(0), queries.size(), [&](size_t query_idx) {
+                features[query_idx] = extract_candidate_features(
+                    index, wdata, scorer, queries[query_idx], raw_results[query_idx]);
+            });
+        });
+        auto end_features = std::chrono::steady_clock::now();
+        spdlog::info(
+            "Time taken to extract features: {}ms",
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_features - end_batch)
+                .count());
+        std::ofstream os(*features_filename);
+        std::string title;
+        for (size_t query_idx = 0; query_idx < features.size(); ++query_idx) {
+            auto qid = queries[query_idx].id.value_or(std::to_string(query_idx));
+            auto term_freqs = query_freqs(queries[query_idx].terms);
+            for (auto&& [rank, candidate]: enumerate(features[query_idx])) {
+                os << fmt::format(
+                    "{}\t{}\t{}\t{}\t{}",
+                    qid,
+                    docmap.lookup(candidate.docid, title),
+                    rank,
+                    candidate.score,
+                    candidate.doc_length);
+                for (size_t term_idx = 0; term_idx < term_freqs.size(); ++term_idx) {
+                    os << fmt::format(
+                        "\t{}:{}:{}",
+                        term_freqs[term_idx].first,
+                        candidate.freqs[term_idx],
+                        candidate.term_scores[term_idx]);
+                }
+                os << '\n';
+            }
+        }
+    }
+
+    if (fusion) {
+        // The variants of a query share its ID, and their results are fused into one ranking.
+        auto groups = group_variants(queries);
+        for (auto const& group: groups) {
+            output_qids.push_back(qid_of(group.front()));
+        }
+        tbb::parallel_for(size_t(0), groups.size(), [&](size_t group_idx) {
+            std::vector<std::vector<std::pair<float, uint64_t>>> rankings;
+            for (auto query_idx: groups[group_idx]) {
+                rankings.push_back(std::move(raw_results[query_idx]));
+            }
+            writer.push(
+                group_idx,
+                format_results(
+                    group_idx,
+                    output_qids[group_idx],
+                    fuse_rankings(rankings, *fusion, output_k, rrf_k)));
+        });
+    }
+    writer.close();
+    if (binary_output_filename) {
+        if (not fusion) {
+            for (size_t query_idx = 0; query_idx < queries.size(); ++query_idx) {
+                output_qids.push_back(qid_of(query_idx));
+            }
+        }
+        std::ofstream os(*binary_output_filename + ".queries");
+        for (auto const& qid: output_qids) {
+            os << qid << '\n';
+        }
     }
     auto end_print = std::chrono::steady_clock::now();
     double batch_ms =
@@ -177,6 +694,25 @@ void evaluate_queries(
         std::chrono::duration_cast<std::chrono::milliseconds>(end_print - start_batch).count();
     spdlog::info("Time taken to process queries: {}ms", batch_ms);
     spdlog::info("Time taken to process queries with printing: {}ms", batch_with_print_ms);
+    if (not budget.is_unlimited()) {
+        spdlog::info("Queries stopped on their budget: {}", approximate.load());
+    }
+    if (query_type == "planned") {
+        for (std::size_t idx = 0; idx < planned_algorithm_count; ++idx) {
+            spdlog::info(
+                "Planned {}: {} queries",
+                planned_algorithm_name(static_cast<planned_algorithm>(idx)),
+                planned[idx].load());
+        }
+    }
+    if (cache) {
+        spdlog::info(
+            "Result cache: {} hits, {} misses, {} evictions, hit rate: {}",
+            cache->hits(),
+            cache->misses(),
+            cache->evictions(),
+            cache->hit_rate());
+    }
 }
 
 using wand_raw_index = wand_data<wand_data_raw>;
@@ -190,18 +726,114 @@ int main(int argc, const char** argv)
     std::string documents_file;
     std::string run_id = "R0";
     bool quantized = false;
+    std::size_t cache_size = 0;
+    std::optional<std::string> intersection_cache_file;
+    std::optional<std::string> pair_bounds_file;
+    std::size_t batch_size = 1;
+    std::optional<std::string> features_file;
 
-    App<arg::Index, arg::WandData, arg::Query<arg::QueryMode::Ranked>, arg::Algorithm, arg::Scorer, arg::Thresholds, arg::Threads>
+    App<arg::Index,
+        arg::WandData,
+        arg::Query<arg::QueryMode::Ranked>,
+        arg::Algorithm,
+        arg::Scorer,
+        arg::Thresholds,
+        arg::Threads,
+        arg::DeletedDocuments,
+        arg::QueryBudget,
+        arg::ClipRatio>
         app{"Retrieves query results in TREC format."};
     app.add_option("-r,--run", run_id, "Run identifier");
     app.add_option("--documents", documents_file, "Document lexicon")->required();
     app.add_flag("--quantized", quantized, "Quantized scores");
+    app.add_option(
+        "--cache-size", cache_size, "Maximum number of query results to cache (0 disables)");
+    app.add_option(
+        "--intersection-cache",
+        intersection_cache_file,
+        "Precomputed intersections of term pairs used by ranked_and and block_max_ranked_and");
+    app.add_option(
+        "--pair-bounds",
+        pair_bounds_file,
+        "Maximum scores of term pairs used by wand and maxscore to tighten their bounds");
+    app.add_option(
+        "--batch-size",
+        batch_size,
+        "Number of queries processed together by ranked_or_taat, sharing the decoding of their "
+        "common terms");
+    std::size_t interleave = 1;
+    app.add_option(
+        "--interleave",
+        interleave,
+        "Number of queries interleaved on each thread by ranked_and, prefetching the blocks of "
+        "one while processing the others");
+    app.add_option(
+        "--features",
+        features_file,
+        "Also write the per-term features of the results, for reranking, to this file");
+
+    std::optional<std::string> fusion_name;
+    float rrf_k = default_rrf_k;
+    app.add_option(
+           "--fuse",
+           fusion_name,
+           "Fuse the results of the queries sharing an ID, such as the variants of a query, "
+           "into one ranking: rrf, combsum, or combmnz")
+        ->check([](std::string const& name) {
+            return fusion_method_from_name(name) ? std::string()
+                                                 : std::string("Must be rrf, combsum, or combmnz");
+        })
+        ->excludes("--features");
+    app.add_option("--rrf-k", rrf_k, "Constant of reciprocal rank fusion")->needs("--fuse");
+
+    std::optional<std::string> rescore_index_file;
+    std::optional<std::string> rescore_wand_file;
+    std::string rescore_scorer = "bm25";
+    uint64_t rescore_depth = 10'000;
+    auto* rescore_index_opt = app.add_option(
+        "--rescore-index",
+        rescore_index_file,
+        "Index with the same encoding and documents, e.g., unquantized, whose exact scores rank "
+        "the candidates retrieved from the index");
+    app.add_option(
+           "--rescore-wand", rescore_wand_file, "Raw WAND data of the rescoring index")
+        ->needs(rescore_index_opt);
+    rescore_index_opt->needs("--rescore-wand");
+    app.add_option(
+           "--rescore-scorer", rescore_scorer, "Scorer of the rescoring index", true)
+        ->needs(rescore_index_opt);
+    app.add_option(
+           "--rescore-depth",
+           rescore_depth,
+           "Number of candidates retrieved from the index to rescore",
+           true)
+        ->needs(rescore_index_opt);
+
+    std::optional<std::string> impact_index_file;
+    app.add_option(
+        "--impact-index",
+        impact_index_file,
+        "Impact-ordered index of the longest lists, with the same docids and impacts, processed "
+        "score-at-a-time by planned queries whose lists are all stored (quantized scorer)");
+
+    std::optional<std::string> binary_output_file;
+    app.add_option(
+        "--binary-output",
+        binary_output_file,
+        "Write the docids and scores of the results as binary records to this file instead "
+        "of TREC lines to the standard output, and the query IDs to FILE.queries");
 
     CLI11_PARSE(app, argc, argv);
+    app.check_index();
 
     tbb::task_scheduler_init init(app.threads());
     spdlog::info("Number of threads: {}", app.threads());
 
+    if (features_file && not app.wand_data_path()) {
+        spdlog::error("--features requires the WAND data");
+        return 1;
+    }
+
     if (run_id.empty()) {
         run_id = "PISA";
     }
@@ -210,6 +842,7 @@ int main(int argc, const char** argv)
 
     auto params = std::make_tuple(
         app.index_filename(),
+        app.load_mode(),
         app.wand_data_path(),
         app.queries(),
         app.thresholds_file(),
@@ -219,7 +852,25 @@ int main(int argc, const char** argv)
         documents_file,
         app.scorer(),
         run_id,
-        iteration);
+        iteration,
+        cache_size,
+        intersection_cache_file,
+        pair_bounds_file,
+        app.deleted_documents_file(),
+        app.deleted_blocks_file(),
+        batch_size,
+        app.query_budget(),
+        app.clip_ratio(),
+        features_file,
+        fusion_name ? fusion_method_from_name(*fusion_name) : std::nullopt,
+        rrf_k,
+        interleave,
+        rescore_index_file,
+        rescore_wand_file,
+        rescore_scorer,
+        rescore_depth,
+        impact_index_file,
+        binary_output_file);
 
     /**/
     if (false) {  // NOLINT
@@ -1,34 +1,73 @@
+#include <array>
 #include <fstream>
+#include <optional>
 #include <string>
+#include <vector>
 
+#include "pisa/query/binary_queries.hpp"
+#include "pisa/query/queries.hpp"
+#include "pisa/query/term_processor.hpp"
 #include "pisa/query/trec_topic_reader.hpp"
 
 #include "CLI/CLI.hpp"
+#include "mio/mmap.hpp"
+#include "spdlog/spdlog.h"
 
 int main(int argc, char const* argv[])
 {
     std::string input_filename;
     std::string output_basename;
+    std::optional<std::string> terms_file;
+    std::optional<std::string> stopwords_file;
+    std::optional<std::string> stemmer;
 
     CLI::App app{"trec2query - a tool for converting TREC queries to PISA queries."};
     app.add_option("-i,--input", input_filename, "TREC query input file")->required();
     app.add_option("-o,--output", output_basename, "Output basename")->required();
+    auto* terms = app.add_option(
+        "--terms", terms_file, "Term lexicon to map topics to IDs, written as binary queries");
+    app.add_option("--stopwords", stopwords_file, "List of blacklisted stop words to filter out")
+        ->needs(terms);
+    app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms);
     CLI11_PARSE(app, argc, argv);
 
-    std::ofstream title_file;
-    title_file.open(output_basename + ".title");
-    std::ofstream desc_file;
-    desc_file.open(output_basename + ".desc");
-    std::ofstream narr_file;
-    narr_file.open(output_basename + ".narr");
+    // Topics are parsed, and mapped to term IDs, in parallel chunks of the mapped file.
+    mio::mmap_source input(input_filename);
+    std::string_view text(input.data(), input.size());
+    std::array<std::string, 3> const fields{"title", "desc", "narr"};
 
-    auto input_file = std::ifstream(input_filename);
-    pisa::trec_topic_reader reader(input_file);
+    if (not terms_file) {
+        auto lines = pisa::transform_topics(text, [](pisa::trec_topic const& topic) {
+            return std::array<std::string, 3>{
+                topic.num + ":" + topic.title,
+                topic.num + ":" + topic.desc,
+                topic.num + ":" + topic.narr};
+        });
+        for (std::size_t field = 0; field < fields.size(); ++field) {
+            std::ofstream os(output_basename + "." + fields[field]);
+            for (auto const& topic: lines) {
+                os << topic[field] << '\n';
+            }
+        }
+        return 0;
+    }
 
-    while (auto topic = reader.next_topic()) {
-        auto t = *topic;
-        title_file << t.num << ":" << t.title << std::endl;
-        desc_file << t.num << ":" << t.desc << std::endl;
-        narr_file << t.num << ":" << t.narr << std::endl;
+    pisa::TermProcessor term_processor(terms_file, stopwords_file, stemmer);
+    auto queries = pisa::transform_topics(text, [&](pisa::trec_topic const& topic) {
+        return std::array<pisa::Query, 3>{
+            pisa::parse_query_terms(topic.num + ":" + topic.title, term_processor),
+            pisa::parse_query_terms(topic.num + ":" + topic.desc, term_processor),
+            pisa::parse_query_terms(topic.num + ":" + topic.narr, term_processor)};
+    });
+    for (std::size_t field = 0; field < fields.size(); ++field) {
+        std::vector<pisa::Query> field_queries;
+        field_queries.reserve(queries.size());
+        for (auto& topic: queries) {
+            field_queries.push_back(std::move(topic[field]));
+        }
+        std::ofstream os(output_basename + "." + fields[field], std::ios::binary);
+        pisa::binary_queries::write(os, field_queries);
     }
+    spdlog::info("Mapped {} topics to term IDs", queries.size());
+    return 0;
 }
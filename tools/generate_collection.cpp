@@ -0,0 +1,104 @@
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "app.hpp"
+#include "util/synthetic_collection.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+    std::string output_basename;
+    std::optional<std::string> queries_filename;
+    synthetic_collection_params params;
+    synthetic_query_params query_params;
+
+    App<arg::Threads> app{
+        "Generates a collection of random lists of Zipf-distributed lengths, and optionally a "
+        "query log, to benchmark codecs and query algorithms without real data."};
+    app.add_option("-o,--output", output_basename, "Output collection basename")->required();
+    app.add_option("-n,--documents", params.documents, "Number of documents", true);
+    app.add_option("-t,--terms", params.terms, "Number of terms", true);
+    app.add_option(
+        "--zipf", params.zipf_exponent, "Exponent of the Zipf law of list lengths", true);
+    app.add_option(
+           "--max-df-ratio",
+           params.max_df_ratio,
+           "Fraction of the documents containing the most frequent term",
+           true)
+        ->check(CLI::Range(0.0, 1.0));
+    app.add_option(
+           "--clustering",
+           params.clustering,
+           "Fraction of the postings of a list drawn close together, from 0 (random ordering) "
+           "to 1 (well reordered)",
+           true)
+        ->check(CLI::Range(0.0, 1.0));
+    app.add_option(
+        "--cluster-width",
+        params.cluster_width,
+        "Width of the range of documents of a list's clustered postings, relative to its length",
+        true);
+    app.add_option(
+        "--mean-length", params.mean_length, "Mean of the log-normal document lengths", true);
+    app.add_option(
+        "--length-sigma", params.length_sigma, "Shape of the log-normal document lengths", true);
+    app.add_option(
+        "--mean-freq",
+        params.mean_freq,
+        "Mean frequency of a term in a document of average length",
+        true);
+    app.add_option("--seed", params.seed, "Seed of the collection and the queries", true);
+    auto* queries_option = app.add_option(
+        "-q,--queries", queries_filename, "Also write a query log of term IDs to this file");
+    app.add_option("--query-count", query_params.queries, "Number of queries", true)
+        ->needs(queries_option);
+    app.add_option(
+           "--query-zipf",
+           query_params.zipf_exponent,
+           "Exponent of the Zipf law by which query terms are drawn, frequent terms first",
+           true)
+        ->needs(queries_option);
+    app.add_option(
+           "--query-terms", query_params.mean_terms, "Mean number of terms of a query", true)
+        ->needs(queries_option);
+    app.add_option(
+           "--max-query-terms",
+           query_params.max_terms,
+           "Maximum number of terms of a query",
+           true)
+        ->needs(queries_option);
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::task_scheduler_init init(app.threads());
+    try {
+        spdlog::info(
+            "Generating {} lists over {} documents", params.terms, params.documents);
+        auto postings = write_synthetic_collection(output_basename, params);
+        spdlog::info("Wrote {} postings to {}", postings, output_basename);
+        if (queries_filename) {
+            query_params.seed = params.seed;
+            auto queries = synthetic_queries(params.terms, query_params);
+            std::ofstream os(*queries_filename);
+            for (auto const& query: queries) {
+                for (std::size_t pos = 0; pos < query.size(); ++pos) {
+                    os << (pos > 0 ? "\t" : "") << query[pos];
+                }
+                os << '\n';
+            }
+            spdlog::info("Wrote {} queries to {}", queries.size(), *queries_filename);
+        }
+    } catch (std::exception const& error) {
+        spdlog::error("{}", error.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <string>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "app.hpp"
+#include "configuration.hpp"
+#include "sparse_vectors.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string input_filename;
+    std::string output_basename;
+    std::size_t bits = configuration::get().quantization_bits;
+    std::size_t batch_size = 16;
+
+    App<arg::Threads> app{
+        "Builds a collection of quantized impacts from learned sparse vectors in JSONL format."};
+    app.add_option("-i,--input", input_filename, "JSONL file of documents")->required();
+    app.add_option("-o,--output", output_basename, "Output collection basename")->required();
+    app.add_option("--bits", bits, "Number of bits of quantized impacts", true);
+    app.add_option(
+        "-b,--batch-size", batch_size, "Size in MiB of the input parsed in one task", true);
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::task_scheduler_init init(app.threads());
+    spdlog::info("Number of threads: {}", app.threads());
+    auto stats = sparse_vectors::import_jsonl(
+        input_filename, output_basename, bits, std::max<std::size_t>(batch_size, 1) << 20U);
+    spdlog::info(
+        "Imported {} documents with {} terms and {} postings; the largest weight {} is "
+        "quantized to {}",
+        stats.documents,
+        stats.terms,
+        stats.postings,
+        stats.max_weight,
+        std::size_t(1) << bits);
+    return 0;
+}
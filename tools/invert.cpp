@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <optional>
 #include <thread>
 #include <vector>
 
@@ -24,6 +25,7 @@ int main(int argc, char** argv)
     size_t threads = std::thread::hardware_concurrency();
     size_t term_count;
     ptrdiff_t batch_size = 100'000;
+    std::optional<size_t> memory_budget;
 
     App<arg::Threads> app{"Turns a forward index into an inverted index."};
     app.add_option("-i,--input", input_basename, "Forward index filename")->required();
@@ -31,13 +33,24 @@ int main(int argc, char** argv)
     /// TODO(michal): This should not be required but knowing term count ahead of time makes things
     ///               much simpler. Maybe we can store it in the forward index?
     app.add_option("--term-count", term_count, "Term count")->required();
-    app.add_option("-b,--batch-size", batch_size, "Number of documents to process at a time", true);
+    auto* batch_size_option = app.add_option(
+        "-b,--batch-size", batch_size, "Number of documents to process at a time", true);
+    app.add_option(
+           "--memory-budget",
+           memory_budget,
+           "Invert in external memory, keeping at most this many MiB of postings in memory")
+        ->excludes(batch_size_option);
     CLI11_PARSE(app, argc, argv);
 
     tbb::task_scheduler_init init(threads);
     spdlog::info("Number of threads: {}", threads);
-    invert::invert_forward_index(
-        input_basename, output_basename, term_count, batch_size, app.threads());
+    if (memory_budget) {
+        invert::invert_forward_index_external(
+            input_basename, output_basename, term_count, *memory_budget << 20U);
+    } else {
+        invert::invert_forward_index(
+            input_basename, output_basename, term_count, batch_size, app.threads());
+    }
 
     return 0;
 }
@@ -1,8 +1,11 @@
 #include <CLI/CLI.hpp>
+#include <boost/filesystem.hpp>
 #include <mio/mmap.hpp>
 #include <spdlog/spdlog.h>
 
+#include "front_coded_vector.hpp"
 #include "io.hpp"
+#include "lexicon_hash.hpp"
 #include "payload_vector.hpp"
 
 using namespace pisa;
@@ -13,12 +16,22 @@ int main(int argc, char** argv)
     std::string lexicon_file;
     std::size_t idx;
     std::string value;
+    bool hash = false;
+    bool front_coding = false;
 
     CLI::App app{"Build, print, or query lexicon"};
     app.require_subcommand();
     auto build = app.add_subcommand("build", "Build a lexicon");
     build->add_option("input", text_file, "Input text file")->required();
     build->add_option("output", lexicon_file, "Output file")->required();
+    auto hash_flag = build->add_flag(
+        "--hash", hash, "Also build a perfect hash of the lexicon for constant-time rlookup");
+    build
+        ->add_flag(
+            "--front-coding",
+            front_coding,
+            "Store every 16th term in full, and only suffixes of the others")
+        ->excludes(hash_flag);
     auto lookup = app.add_subcommand("lookup", "Retrieve the payload at index");
     lookup->add_option("lexicon", lexicon_file, "Lexicon file path")->required();
     lookup->add_option("idx", idx, "Index of requested element")->required();
@@ -32,12 +45,45 @@ int main(int argc, char** argv)
     try {
         if (*build) {
             std::ifstream is(text_file);
-            encode_payload_vector(
-                std::istream_iterator<io::Line>(is), std::istream_iterator<io::Line>())
-                .to_file(lexicon_file);
+            if (front_coding) {
+                encode_front_coded_vector(
+                    std::istream_iterator<io::Line>(is), std::istream_iterator<io::Line>())
+                    .to_file(lexicon_file);
+                return 0;
+            }
+            auto buffer = encode_payload_vector(
+                std::istream_iterator<io::Line>(is), std::istream_iterator<io::Line>());
+            buffer.to_file(lexicon_file);
+            if (hash) {
+                Lexicon_Hash_Buffer::build(Payload_Vector<>(buffer))
+                    .to_file(lexicon_hash_filename(lexicon_file));
+            }
             return 0;
         }
         mio::mmap_source m(lexicon_file.c_str());
+        if (Front_Coded_Vector::is_front_coded(m)) {
+            auto lexicon = Front_Coded_Vector::from(m);
+            if (*print) {
+                lexicon.for_each([](auto elem) { std::cout << elem << '\n'; });
+                return 0;
+            } else if (*lookup) {
+                if (idx < lexicon.size()) {
+                    std::cout << lexicon[idx] << '\n';
+                    return 0;
+                }
+                spdlog::error(
+                    "Requested index {} too large for vector of size {}", idx, lexicon.size());
+                return 1;
+            } else if (*rlookup) {
+                if (auto term_id = lexicon.find(value); term_id) {
+                    std::cout << *term_id << '\n';
+                    return 0;
+                }
+                spdlog::error("Requested term {} was not found", value);
+                return 1;
+            }
+            return 1;
+        }
         auto lexicon = Payload_Vector<>::from(m);
         if (*print) {
             for (auto const& elem: lexicon) {
@@ -54,6 +100,16 @@ int main(int argc, char** argv)
                 return 1;
             }
         } else if (*rlookup) {
+            if (auto hash_file = lexicon_hash_filename(lexicon_file);
+                boost::filesystem::exists(hash_file)) {
+                mio::mmap_source mh(hash_file.c_str());
+                if (auto term_id = Lexicon_Hash::from(mh).find(lexicon, value); term_id) {
+                    std::cout << *term_id << '\n';
+                    return 0;
+                }
+                spdlog::error("Requested term {} was not found", value);
+                return 1;
+            }
             auto pos = std::lower_bound(lexicon.begin(), lexicon.end(), std::string_view(value));
             if (pos != lexicon.end() and *pos == std::string_view(value)) {
                 std::cout << std::distance(lexicon.begin(), pos) << '\n';
@@ -1,8 +1,13 @@
+#include <fstream>
+#include <optional>
+
 #include <CLI/CLI.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/range/adaptor/transformed.hpp>
+#include <tbb/task_scheduler_init.h>
 
 #include "app.hpp"
+#include "query/binary_queries.hpp"
 #include "query/queries.hpp"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
@@ -16,16 +21,31 @@ int main(int argc, const char** argv)
 
     std::string separator = "\t";
     bool query_id = false;
+    std::optional<std::string> output_filename;
 
-    App<arg::Query<arg::QueryMode::Unranked>> app{
+    App<arg::Query<arg::QueryMode::Unranked>, arg::Threads> app{
         "A tool for transforming textual queries to IDs."};
     app.add_option("--sep", separator, "Separator");
     app.add_flag("--query-id", query_id, "Print query ID (as id:T1 T2 ... TN)");
+    app.add_option(
+        "-o,--output",
+        output_filename,
+        "Write the queries, with their IDs and term weights, to a binary query file instead");
     CLI11_PARSE(app, argc, argv);
 
+    tbb::task_scheduler_init init(app.threads());
+    auto queries = app.queries();
+
+    if (output_filename) {
+        std::ofstream os(*output_filename, std::ios::binary);
+        binary_queries::write(os, queries);
+        spdlog::info("Wrote {} queries to {}", queries.size(), *output_filename);
+        return 0;
+    }
+
     using boost::adaptors::transformed;
     using boost::algorithm::join;
-    for (auto&& q: app.queries()) {
+    for (auto&& q: queries) {
         if (query_id and q.id) {
             std::cout << *(q.id) << ":";
         }
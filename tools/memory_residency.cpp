@@ -0,0 +1,111 @@
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "mappable/residency.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+/// Prints the mapped and resident bytes of `node` and of its descendants down to `max_depth`,
+/// one line each, prefixed by the path of names leading to it.
+void print_node(
+    mapper::size_node const& node,
+    std::string const& path,
+    std::size_t depth,
+    std::size_t max_depth)
+{
+    auto percent = node.size > 0 ? 100.0 * double(node.resident) / double(node.size) : 0.0;
+    std::cout << fmt::format("{}\t{}\t{}\t{:.1f}\n", path, node.size, node.resident, percent);
+    if (depth == max_depth) {
+        return;
+    }
+    for (auto const& child: node.children) {
+        print_node(*child, path + "." + child->name, depth + 1, max_depth);
+    }
+}
+
+template <typename IndexType, typename WandType>
+void report(
+    std::string const& index_filename,
+    mapper::load_mode load_mode,
+    std::optional<std::string> const& wand_data_filename,
+    std::vector<std::string> const& files,
+    std::size_t max_depth)
+{
+    std::cout << "section\tmapped\tresident\tresident_percent\n";
+
+    IndexType index;
+    mapper::mapped_file m(index_filename, load_mode);
+    mapper::map(index, m);
+    print_node(*mapper::residency_tree_of(index, "index"), "index", 0, max_depth);
+
+    if (wand_data_filename) {
+        WandType wdata;
+        mio::mmap_source md(wand_data_filename->c_str());
+        mapper::map(wdata, md);
+        print_node(*mapper::residency_tree_of(wdata, "wand"), "wand", 0, max_depth);
+    }
+
+    for (auto const& filename: files) {
+        mio::mmap_source source(filename.c_str());
+        mapper::size_node node;
+        node.size = source.size();
+        node.resident = mapper::resident_bytes(source.data(), source.size());
+        print_node(node, filename, 0, 0);
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    std::vector<std::string> files;
+    std::size_t max_depth = 3;
+
+    App<arg::Index, arg::WandData> app{
+        "Reports the bytes of each section of an index and its WAND data that are resident in "
+        "memory, out of those mapped."};
+    app.add_option(
+        "--file", files, "Other files to report as a whole, e.g., term or document lexicons");
+    app.add_option("--depth", max_depth, "Depth of the sections to report", true);
+    CLI11_PARSE(app, argc, argv);
+    app.check_index();
+
+    auto params = std::make_tuple(
+        app.index_filename(), app.load_mode(), app.wand_data_path(), files, max_depth);
+
+    /**/
+    if (false) {  // NOLINT
+#define LOOP_BODY(R, DATA, T)                                                              \
+    }                                                                                      \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                \
+    {                                                                                      \
+        if (app.is_wand_compressed()) {                                                    \
+            std::apply(report<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);       \
+        } else {                                                                           \
+            std::apply(report<BOOST_PP_CAT(T, _index), wand_raw_index>, params);           \
+        }                                                                                  \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+}
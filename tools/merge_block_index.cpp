@@ -0,0 +1,131 @@
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <gsl/span>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "block_index_merge.hpp"
+#include "index_types.hpp"
+#include "invert.hpp"
+#include "mappable/mapper.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using wand_raw_index = wand_data<wand_data_raw>;
+
+/// Appends the document lengths stored in the WAND data to `lengths`.
+void append_document_lengths(
+    std::string const& wand_data_filename, uint64_t num_docs, std::vector<uint32_t>& lengths)
+{
+    wand_raw_index wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md);
+    if (wdata.num_docs() != num_docs) {
+        throw std::invalid_argument(fmt::format(
+            "WAND data {} has {} documents, but its index has {}",
+            wand_data_filename,
+            wdata.num_docs(),
+            num_docs));
+    }
+    for (uint64_t docid = 0; docid < num_docs; ++docid) {
+        lengths.push_back(wdata.doc_len(docid));
+    }
+}
+
+template <typename IndexType>
+void merge_block_index(
+    std::string const& first_filename,
+    std::string const& second_filename,
+    std::string const& output_filename,
+    std::optional<std::string> const& first_wand_filename,
+    std::optional<std::string> const& second_wand_filename,
+    std::optional<std::string> const& sizes_filename)
+{
+    IndexType first;
+    spdlog::info("Loading index from {}", first_filename);
+    mio::mmap_source mf(first_filename.c_str());
+    mapper::map(first, mf);
+
+    IndexType second;
+    spdlog::info("Loading index from {}", second_filename);
+    mio::mmap_source ms(second_filename.c_str());
+    mapper::map(second, ms);
+
+    global_parameters params;
+    typename IndexType::builder builder(first.num_docs() + second.num_docs(), params);
+    auto stats = merge_block_indexes(first, second, builder);
+    spdlog::info(
+        "Copied {} blocks and re-encoded {} blocks", stats.copied_blocks, stats.encoded_blocks);
+
+    IndexType merged;
+    builder.build(merged);
+    mapper::freeze(merged, output_filename.c_str());
+
+    if (sizes_filename) {
+        std::vector<uint32_t> lengths;
+        append_document_lengths(*first_wand_filename, first.num_docs(), lengths);
+        append_document_lengths(*second_wand_filename, second.num_docs(), lengths);
+        std::ofstream os(*sizes_filename);
+        write_sequence(os, gsl::span<uint32_t const>(lengths));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string first_filename;
+    std::string second_filename;
+    std::string output_filename;
+    std::optional<std::string> first_wand_filename;
+    std::optional<std::string> second_wand_filename;
+    std::optional<std::string> sizes_filename;
+
+    App<arg::Encoding> app{
+        "Merges two block indexes over consecutive document ranges, copying encoded blocks "
+        "wherever possible. Documents of the second index follow those of the first."};
+    app.add_option("--first", first_filename, "First index filename")->required();
+    app.add_option("--second", second_filename, "Second index filename")->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    auto* first_wand =
+        app.add_option("--first-wand", first_wand_filename, "WAND data of the first index");
+    auto* second_wand =
+        app.add_option("--second-wand", second_wand_filename, "WAND data of the second index");
+    app.add_option(
+           "--sizes",
+           sizes_filename,
+           "Output document sizes of the merged index, read from the WAND data of its inputs, "
+           "to build its WAND data")
+        ->needs(first_wand)
+        ->needs(second_wand);
+    CLI11_PARSE(app, argc, argv);
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                               \
+    }                                                       \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T)) \
+    {                                                       \
+        merge_block_index<BOOST_PP_CAT(T, _index)>(         \
+            first_filename,                                 \
+            second_filename,                                \
+            output_filename,                                \
+            first_wand_filename,                            \
+            second_wand_filename,                           \
+            sizes_filename);                                \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+
+    return 0;
+}
@@ -3,20 +3,18 @@
 #include <fstream>
 #include <iostream>
 #include <numeric>
+#include <optional>
 #include <thread>
 
-#include "boost/lexical_cast.hpp"
+#include "CLI/CLI.hpp"
 #include "spdlog/spdlog.h"
 
 #include "mappable/mapper.hpp"
 
-#include "stxxl/io"
-#include "stxxl/sort"
-#include "stxxl/vector"
-
 #include "configuration.hpp"
 #include "index_types.hpp"
 #include "mixed_block.hpp"
+#include "util/external_sort.hpp"
 #include "util/index_build_utils.hpp"
 #include "util/progress.hpp"
 #include "util/semiasync_queue.hpp"
@@ -36,24 +34,10 @@ struct lambda_point {
         {
             return lhs.lambda < rhs.lambda;
         }
-
-        static lambda_point min_value()
-        {
-            lambda_point val;
-            val.lambda = std::numeric_limits<float>::min();
-            return val;
-        }
-
-        static lambda_point max_value()
-        {
-            lambda_point val;
-            val.lambda = std::numeric_limits<float>::max();
-            return val;
-        }
     };
 };
 
-typedef stxxl::vector<lambda_point> lambda_vector_type;
+typedef pisa::external_sorter<lambda_point, lambda_point::comparator> lambda_sorter_type;
 
 template <typename InputCollectionType>
 struct lambdas_computer: pisa::semiasync_queue::job {
@@ -62,7 +46,7 @@ struct lambdas_computer: pisa::semiasync_queue::job {
         typename InputCollectionType::document_enumerator e,
         pisa::predictors_vec_type const& predictors,
         std::vector<uint32_t>& counts,
-        lambda_vector_type& lambda_points)
+        lambda_sorter_type& lambda_points)
         : m_block_id_base(block_id_base),
           m_e(e),
           m_predictors(predictors),
@@ -132,9 +116,9 @@ struct lambdas_computer: pisa::semiasync_queue::job {
 
     virtual void commit()
     {
-        // m_lambda_points.insert(m_lambda_points.end(),
-        //                        m_points_buf.begin(), m_points_buf.end());
-        std::copy(m_points_buf.begin(), m_points_buf.end(), std::back_inserter(m_lambda_points));
+        for (auto const& point: m_points_buf) {
+            m_lambda_points.push(point);
+        }
     }
 
     block_id_type m_block_id_base;
@@ -143,7 +127,7 @@ struct lambdas_computer: pisa::semiasync_queue::job {
     std::vector<uint32_t> m_counts;
     double m_lambda;
     std::vector<lambda_point> m_points_buf;
-    lambda_vector_type& m_lambda_points;
+    lambda_sorter_type& m_lambda_points;
 };
 
 template <typename InputCollectionType>
@@ -152,8 +136,8 @@ void compute_lambdas(
     size_t num_blocks,
     const char* predictors_filename,
     const char* block_stats_filename,
-    const char* lambdas_filename)
-
+    const char* lambdas_filename,
+    size_t memory_budget)
 {
     using namespace pisa;
     using namespace time_prediction;
@@ -173,9 +157,7 @@ void compute_lambdas(
     size_t freq_zero_lists = 0;
     size_t freq_zero_blocks = 0;
 
-    stxxl::syscall_file lpfile(
-        lambdas_filename, stxxl::file::DIRECT | stxxl::file::CREAT | stxxl::file::RDWR);
-    lambda_vector_type lambda_points(&lpfile);
+    lambda_sorter_type lambda_points(lambdas_filename, memory_budget);
 
     semiasync_queue queue(1 << 24);
 
@@ -215,7 +197,7 @@ void compute_lambdas(
 
     queue.complete();
 
-    spdlog::info("{} lambda points", lambda_points.size());
+    spdlog::info("{} lambda points in {} runs", lambda_points.size(), lambda_points.runs());
     spdlog::info("Sorting lambda points");
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
 
@@ -224,8 +206,7 @@ void compute_lambdas(
         "is_heuristic", configuration::get().heuristic_greedy);
 
     tick = get_time_usecs();
-    static const size_t sort_memory = size_t(16) * 1024 * 1024 * 1024;  // XXX
-    stxxl::sort(lambda_points.begin(), lambda_points.end(), lambda_point::comparator(), sort_memory);
+    lambda_points.merge();
 
     elapsed_secs = (get_time_usecs() - tick) / 1000000;
     stats_line()("worker_threads", std::thread::hardware_concurrency())(
@@ -280,7 +261,8 @@ void optimal_hybrid_index(
     const char* input_filename,
     const char* output_filename,
     const char* lambdas_filename,
-    size_t budget)
+    size_t budget,
+    size_t memory_budget)
 {
     using namespace pisa;
 
@@ -311,12 +293,14 @@ void optimal_hybrid_index(
         spdlog::info("To recompute lambdas, remove file");
     } else {
         compute_lambdas(
-            input_coll, num_blocks, predictors_filename, block_stats_filename, lambdas_filename);
+            input_coll,
+            num_blocks,
+            predictors_filename,
+            block_stats_filename,
+            lambdas_filename,
+            memory_budget);
     }
 
-    stxxl::syscall_file lpfile(lambdas_filename, stxxl::file::DIRECT | stxxl::file::RDONLY);
-    lambda_vector_type lambda_points(&lpfile);
-
     double tick = get_time_usecs();
 
     spdlog::info("Computing space-time tradeoffs");
@@ -330,11 +314,15 @@ void optimal_hybrid_index(
     float first_nonzero_lambda = true;
 
     std::ofstream lambdas_log;
-    if (budget == 0) {
+    if (budget == 0 && output_filename) {
         lambdas_log.open(output_filename, std::ios::out);
     }
 
-    for (auto const& lpid: lambda_vector_type::bufreader_type(lambda_points)) {
+    for (record_reader<lambda_point> lambda_points(
+             lambdas_filename, memory_budget / sizeof(lambda_point));
+         not lambda_points.empty();
+         lambda_points.pop()) {
+        auto const& lpid = lambda_points.front();
         assert(lpid.block_id < num_blocks);
         cur_space -= block_spaces[lpid.block_id];
         cur_time -= block_times[lpid.block_id];
@@ -355,7 +343,7 @@ void optimal_hybrid_index(
 
             if (budget == 0) {
                 // just print out a sample of the trade-offs
-                if (seen_lambdas % (num_blocks / 2000) == 0) {
+                if (seen_lambdas % std::max<size_t>(num_blocks / 2000, 1) == 0) {
                     lambdas_log << lpid.lambda << '\t' << cur_space << '\t' << cur_time << '\n';
                 }
                 seen_lambdas += 1;
@@ -443,51 +431,52 @@ int main(int argc, const char** argv)
 {
     using namespace pisa;
 
-    if (argc < 5) {
-        std::cerr << "Usage: " << argv[0]
-                  << " <index type> <predictors> <block_stats> <input_index> <lambdas_filename> "
-                     "<budget> [output_index] [--check <collection_basename>]"
-                  << std::endl;
-        return 1;
-    }
-
-    std::string type = argv[1];
-    const char* predictors_filename = argv[2];
-    const char* block_stats_filename = argv[3];
-    const char* input_filename = argv[4];
-    const char* lambdas_filename = argv[5];
-    size_t budget = boost::lexical_cast<size_t>(argv[6]);
-    const char* output_filename = nullptr;
-    if (argc > 7) {
-        output_filename = argv[7];
-    }
-
-    bool check = false;
-    const char* collection_basename = nullptr;
-    if (argc > 9 && std::string(argv[8]) == "--check") {
-        check = true;
-        collection_basename = argv[9];
-    }
+    std::string type;
+    std::string predictors_filename;
+    std::string block_stats_filename;
+    std::string input_filename;
+    std::string lambdas_filename;
+    size_t budget = 0;
+    std::optional<std::string> output_filename;
+    std::optional<std::string> collection_basename;
+    size_t memory_budget_mb = 1024;
+
+    CLI::App app{"Builds a block_mixed index with the fastest block encodings fitting a budget"};
+    app.add_option("-t,--type", type, "Input index type")->required();
+    app.add_option("--predictors", predictors_filename, "Decoding time predictors")->required();
+    app.add_option("--block-stats", block_stats_filename, "Block access counts")->required();
+    app.add_option("-i,--input", input_filename, "Input index filename")->required();
+    app.add_option("--lambdas", lambdas_filename, "Sorted lambdas filename, reused if it exists")
+        ->required();
+    app.add_option("--budget", budget, "Space budget in bytes, or 0 to print the trade-offs")
+        ->required();
+    app.add_option("-o,--output", output_filename, "Output filename");
+    app.add_option("--check", collection_basename, "Collection basename to check the index with");
+    app.add_option("--memory-budget", memory_budget_mb, "Memory for sorting lambdas in MiB", true);
+    CLI11_PARSE(app, argc, argv);
 
     pisa::global_parameters params;
+    size_t memory_budget = memory_budget_mb << 20U;
+    const char* output = output_filename ? output_filename->c_str() : nullptr;
 
     if (false) {
-#define LOOP_BODY(R, DATA, T)                                                                     \
-    }                                                                                             \
-    else if (type == BOOST_PP_STRINGIZE(T))                                                       \
-    {                                                                                             \
-        optimal_hybrid_index<BOOST_PP_CAT(T, _index)>(                                            \
-            params,                                                                               \
-            predictors_filename,                                                                  \
-            block_stats_filename,                                                                 \
-            input_filename,                                                                       \
-            output_filename,                                                                      \
-            lambdas_filename,                                                                     \
-            budget);                                                                              \
-        if (check) {                                                                              \
-            binary_freq_collection input(collection_basename);                                    \
-            verify_collection<binary_freq_collection, block_mixed_index>(input, output_filename); \
-        }                                                                                         \
+#define LOOP_BODY(R, DATA, T)                                                              \
+    }                                                                                      \
+    else if (type == BOOST_PP_STRINGIZE(T))                                                \
+    {                                                                                      \
+        optimal_hybrid_index<BOOST_PP_CAT(T, _index)>(                                     \
+            params,                                                                        \
+            predictors_filename.c_str(),                                                   \
+            block_stats_filename.c_str(),                                                  \
+            input_filename.c_str(),                                                        \
+            output,                                                                        \
+            lambdas_filename.c_str(),                                                      \
+            budget,                                                                        \
+            memory_budget);                                                                \
+        if (collection_basename && output) {                                               \
+            binary_freq_collection input(collection_basename->c_str());                    \
+            verify_collection<binary_freq_collection, block_mixed_index>(input, output);   \
+        }                                                                                  \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
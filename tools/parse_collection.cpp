@@ -1,4 +1,6 @@
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <CLI/CLI.hpp>
 #include <KrovetzStemmer/KrovetzStemmer.hpp>
@@ -12,6 +14,8 @@
 #include <warcpp/warcpp.hpp>
 
 #include "forward_index_builder.hpp"
+#include "parsing/warc.hpp"
+#include "term_cache.hpp"
 
 using namespace pisa;
 
@@ -139,7 +143,9 @@ record_parser(std::string const& type, std::istream& is)
     std::abort();
 }
 
-std::function<std::string(std::string&&)> term_processor(std::optional<std::string> const& type)
+/// Stemmed terms are memoized in `cache`, since stemming dominates term processing.
+std::function<std::string(std::string&&)> term_processor(
+    std::optional<std::string> const& type, std::shared_ptr<term_cache<std::string>> cache)
 {
     if (not type) {
         return [](std::string&& term) -> std::string {
@@ -148,16 +154,21 @@ std::function<std::string(std::string&&)> term_processor(std::optional<std::stri
         };
     }
     if (*type == "porter2") {
-        return [](std::string&& term) -> std::string {
-            boost::algorithm::to_lower(term);
-            return porter2::Stemmer{}.stem(term);
+        return [cache = std::move(cache)](std::string&& term) -> std::string {
+            return cache->get_or_compute(term, [](std::string term) {
+                boost::algorithm::to_lower(term);
+                thread_local porter2::Stemmer stemmer{};
+                return stemmer.stem(term);
+            });
         };
     }
     if (*type == "krovetz") {
-        static stem::KrovetzStemmer kstemmer;
-        return [](std::string&& term) -> std::string {
-            boost::algorithm::to_lower(term);
-            return kstemmer.kstem_stemmer(term);
+        return [cache = std::move(cache)](std::string&& term) -> std::string {
+            return cache->get_or_compute(term, [](std::string term) {
+                boost::algorithm::to_lower(term);
+                thread_local stem::KrovetzStemmer stemmer{};
+                return stemmer.kstem_stemmer(term);
+            });
         };
     }
     spdlog::error("Unknown stemmer type: {}", *type);
@@ -165,13 +176,30 @@ std::function<std::string(std::string&&)> term_processor(std::optional<std::stri
 }
 
 std::function<void(std::string&& constent, std::function<void(std::string&&)>)>
-content_parser(std::optional<std::string> const& type)
+content_parser(std::optional<std::string> const& type, std::string const& tokenizer)
 {
     if (not type) {
         return parse_plaintext_content;
     }
     if (*type == "html") {
-        return parse_html_content;
+        if (tokenizer == "fast") {
+            return parse_html_content<FastTermTokenizer>;
+        }
+        if (tokenizer == "lexer") {
+            return parse_html_content<TermTokenizer>;
+        }
+        spdlog::error("Unknown tokenizer type: {}", tokenizer);
+        std::abort();
+    }
+    if (*type == "html-fast") {
+        if (tokenizer == "fast") {
+            return parse_fast_html_content<FastTermTokenizer>;
+        }
+        if (tokenizer == "lexer") {
+            return parse_fast_html_content<TermTokenizer>;
+        }
+        spdlog::error("Unknown tokenizer type: {}", tokenizer);
+        std::abort();
     }
     spdlog::error("Unknown content parser type: {}", *type);
     std::abort();
@@ -192,25 +220,51 @@ int main(int argc, char** argv)
     };
 
     std::string input_basename;
+    std::vector<std::string> input_files;
+    std::optional<std::size_t> reader_threads = std::nullopt;
     std::string output_filename;
     std::string format = "plaintext";
     size_t threads = std::thread::hardware_concurrency();
     ptrdiff_t batch_size = 100'000;
     std::optional<std::string> stemmer = std::nullopt;
     std::optional<std::string> content_parser_type = std::nullopt;
+    std::string tokenizer = "lexer";
+    std::size_t term_cache_size = 1U << 16U;
     bool debug = false;
+    bool invert = false;
 
     CLI::App app{"parse_collection - parse collection and store as forward index."};
     app.add_option("-o,--output", output_filename, "Forward index filename")
         ->required()
         ->check(valid_basename);
     app.add_option("-j,--threads", threads, "Thread count");
+    app.add_option(
+           "-i,--input",
+           input_files,
+           "WARC files (optionally gzip or zstd compressed) to read instead of standard input")
+        ->check(CLI::ExistingFile);
+    app.add_option(
+        "--reader-threads",
+        reader_threads,
+        "Number of input files decompressed concurrently (default: min(files, threads))");
     app.add_option(
         "-b,--batch-size", batch_size, "Number of documents to process in one thread", true);
     app.add_option("-f,--format", format, "Input format", true);
     app.add_option("--stemmer", stemmer, "Stemmer type");
-    app.add_option("--content-parser", content_parser_type, "Content parser type");
+    app.add_option(
+        "--content-parser", content_parser_type, "Content parser type: html or html-fast");
+    app.add_option(
+        "--tokenizer", tokenizer, "Tokenizer of the HTML content parser: lexer or fast", true);
+    app.add_option(
+        "--term-cache-size",
+        term_cache_size,
+        "Number of stemmed terms to cache in each thread (0 disables)",
+        true);
     app.add_flag("--debug", debug, "Print debug messages");
+    app.add_flag(
+        "--invert",
+        invert,
+        "Write an inverted index to the output basename instead of a forward index");
 
     size_t batch_count, document_count;
     CLI::App* merge_cmd = app.add_subcommand(
@@ -228,22 +282,56 @@ int main(int argc, char** argv)
         spdlog::set_level(spdlog::level::debug);
     }
 
+    if (not input_files.empty() and format != "warc") {
+        spdlog::error("Input files are only supported with --format warc");
+        return 1;
+    }
+
     tbb::task_scheduler_init init(threads);
     spdlog::info("Number of threads: {}", threads);
 
+    std::unique_ptr<parsing::warc::Parallel_Reader> reader;
+    std::function<std::optional<Document_Record>()> next_record =
+        [parse = record_parser(format, std::cin)]() { return parse(std::cin); };
+    if (not input_files.empty()) {
+        auto num_readers = reader_threads.value_or(std::min(input_files.size(), threads));
+        spdlog::info("Reading {} files with {} threads", input_files.size(), num_readers);
+        reader = std::make_unique<parsing::warc::Parallel_Reader>(input_files, num_readers);
+        next_record = [&]() { return reader->next(); };
+    }
+
+    auto stem_cache = std::make_shared<term_cache<std::string>>(term_cache_size);
     Forward_Index_Builder builder;
     if (*merge_cmd) {
-        builder.merge(output_filename, document_count, batch_count);
+        if (invert) {
+            builder.merge_inverted(output_filename, document_count, batch_count);
+        } else {
+            builder.merge(output_filename, document_count, batch_count);
+        }
+    } else if (invert) {
+        builder.build_inverted(
+            next_record,
+            output_filename,
+            term_processor(stemmer, stem_cache),
+            content_parser(content_parser_type, tokenizer),
+            batch_size,
+            threads);
     } else {
         builder.build(
-            std::cin,
+            next_record,
             output_filename,
-            record_parser(format, std::cin),
-            term_processor(stemmer),
-            content_parser(content_parser_type),
+            term_processor(stemmer, stem_cache),
+            content_parser(content_parser_type, tokenizer),
             batch_size,
             threads);
     }
+    if (stemmer and not *merge_cmd) {
+        spdlog::info(
+            "Term cache: {} hits, {} misses, hit rate: {}",
+            stem_cache->hits(),
+            stem_cache->misses(),
+            stem_cache->hit_rate());
+    }
 
     return 0;
 }
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "binary_freq_collection.hpp"
+#include "range_partition.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string input_basename;
+    std::string output_basename;
+    std::size_t range_count = 0;
+    std::size_t buckets = 1U << 16U;
+    std::optional<std::string> terms_filename;
+    std::optional<std::string> documents_filename;
+    std::size_t threads = std::thread::hardware_concurrency();
+
+    CLI::App app{
+        "Splits an inverted index into consecutive docid ranges with about as many postings "
+        "each, e.g., to serve a reordered index from several nodes."};
+    app.add_option("-c,--collection", input_basename, "Collection basename")->required();
+    app.add_option("-o,--output", output_basename, "Basename of the ranges")->required();
+    app.add_option("-r,--ranges", range_count, "Number of ranges")->required();
+    app.add_option(
+        "--buckets",
+        buckets,
+        "Number of docid buckets whose postings are counted; ranges end at bucket boundaries",
+        true);
+    app.add_option("--terms", terms_filename, "Terms of the collection, one per line");
+    app.add_option(
+        "--documents",
+        documents_filename,
+        "Titles of the documents of the collection, one per line");
+    app.add_option("-j,--threads", threads, "Number of threads");
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::task_scheduler_init init(threads);
+    if (range_count == 0) {
+        spdlog::error("--ranges must be positive");
+        return 1;
+    }
+
+    binary_freq_collection input(input_basename.c_str());
+    if (not input.has_offsets()) {
+        spdlog::warn(
+            "{} has no offsets, its postings are counted by a single thread; "
+            "see create_collection_offsets",
+            input_basename);
+    }
+    auto num_docs = input.num_docs();
+    buckets = std::max<std::size_t>(buckets, 1);
+    auto bucket_width = std::max<std::uint64_t>((num_docs + buckets - 1) / buckets, 1);
+    auto histogram = postings_histogram(input, bucket_width);
+    auto ranges = balanced_docid_ranges(histogram, bucket_width, num_docs, range_count);
+
+    std::uint64_t total = 0;
+    for (auto count: histogram) {
+        total += count;
+    }
+    for (std::size_t part = 0; part < ranges.size(); ++part) {
+        auto first = ranges[part].begin / bucket_width;
+        auto last = (ranges[part].end + bucket_width - 1) / bucket_width;
+        std::uint64_t postings = 0;
+        for (auto bucket = first; bucket < last; ++bucket) {
+            postings += histogram[bucket];
+        }
+        spdlog::info(
+            "Range {}: docids [{}, {}), {} postings ({:.2f}% of all)",
+            part,
+            ranges[part].begin,
+            ranges[part].end,
+            postings,
+            total > 0 ? 100.0 * postings / total : 0.0);
+    }
+
+    partition_docid_ranges(
+        input_basename, output_basename, ranges, terms_filename, documents_filename);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "binary_freq_collection.hpp"
+#include "term_partition.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string input_basename;
+    std::string output_basename;
+    std::size_t node_count = 0;
+    std::vector<double> capacities;
+
+    CLI::App app{
+        "Splits an inverted index by terms, assigning every list to one of several nodes of a "
+        "term-partitioned index, served by pipelined_queries."};
+    app.add_option("-c,--collection", input_basename, "Collection basename")->required();
+    app.add_option("-o,--output", output_basename, "Basename of the nodes")->required();
+    auto nodes_option =
+        app.add_option("-n,--nodes", node_count, "Number of nodes of equal capacity");
+    app.add_option(
+           "--capacities",
+           capacities,
+           "Capacity of each node, e.g., its memory, to which its postings are proportional")
+        ->excludes(nodes_option);
+    CLI11_PARSE(app, argc, argv);
+
+    if (capacities.empty()) {
+        capacities.assign(node_count, 1.0);
+    }
+    if (capacities.empty()) {
+        spdlog::error("Either --nodes or --capacities must be given");
+        return 1;
+    }
+
+    binary_freq_collection input(input_basename.c_str());
+    std::vector<std::uint64_t> list_sizes;
+    list_sizes.reserve(input.size());
+    for (auto const& list: input) {
+        list_sizes.push_back(list.docs.size());
+    }
+    try {
+        term_partition partition(assign_terms_to_nodes(list_sizes, capacities), capacities.size());
+        std::vector<std::uint64_t> postings(partition.node_count(), 0);
+        std::vector<std::size_t> terms(partition.node_count(), 0);
+        for (std::uint32_t term = 0; term < list_sizes.size(); ++term) {
+            postings[partition.node(term)] += list_sizes[term];
+            terms[partition.node(term)] += 1;
+        }
+        for (std::size_t node = 0; node < partition.node_count(); ++node) {
+            spdlog::info("Node {}: {} terms, {} postings", node, terms[node], postings[node]);
+        }
+        partition_terms(input_basename, output_basename, partition);
+    } catch (std::invalid_argument const& error) {
+        spdlog::error(error.what());
+        return 1;
+    }
+    return 0;
+}
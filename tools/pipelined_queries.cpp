@@ -0,0 +1,182 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/stringize.hpp>
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "accumulator/simple_accumulator.hpp"
+#include "app.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "document_lexicon.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "query/algorithm/pipelined_taat_query.hpp"
+#include "scorer/scorer.hpp"
+#include "term_partition.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+struct pipeline_options {
+    std::string index_basename;
+    std::string wand_basename;
+    std::string partition_filename;
+    std::string documents_filename;
+    std::size_t node_count = 0;
+    std::size_t window_size = pipelined_taat_query::default_window_size;
+    std::size_t in_flight = 4;
+};
+
+template <typename IndexType, typename WandType>
+void pipelined_queries(
+    pipeline_options const& options,
+    std::vector<Query> const& queries,
+    uint64_t k,
+    std::string const& scorer_name,
+    std::string const& run_id)
+{
+    struct node {
+        mio::mmap_source index_source;
+        mio::mmap_source wand_source;
+        IndexType index;
+        WandType wdata;
+    };
+    auto partition = term_partition::from_file(options.partition_filename, options.node_count);
+    if (partition.node_count() > options.node_count) {
+        spdlog::error(
+            "Terms are assigned to {} nodes, but only {} are loaded",
+            partition.node_count(),
+            options.node_count);
+        return;
+    }
+
+    std::vector<std::unique_ptr<node>> nodes;
+    for (std::size_t n = 0; n < options.node_count; ++n) {
+        spdlog::info("Loading node {}", n);
+        auto loaded = std::unique_ptr<node>(new node{
+            mio::mmap_source(fmt::format("{}.{:03d}", options.index_basename, n).c_str()),
+            mio::mmap_source(fmt::format("{}.{:03d}", options.wand_basename, n).c_str()),
+            IndexType{},
+            WandType{}});
+        mapper::map(loaded->index, loaded->index_source);
+        mapper::map(loaded->wdata, loaded->wand_source, mapper::map_flags::warmup);
+        nodes.push_back(std::move(loaded));
+    }
+    std::vector<std::unique_ptr<index_scorer<WandType>>> scorers;
+    for (auto const& n: nodes) {
+        scorers.push_back(scorer::from_name(scorer_name, n->wdata));
+    }
+    Document_Lexicon documents(options.documents_filename);
+    auto max_docid = nodes.front()->index.num_docs();
+
+    using cursor_type =
+        decltype(make_scored_cursors(nodes.front()->index, *scorers.front(), Query{}));
+    std::vector<Simple_Accumulator> accumulators(
+        std::max<std::size_t>(options.in_flight, 1),
+        Simple_Accumulator(static_cast<std::ptrdiff_t>(options.window_size)));
+    topk_queue topk(k);
+    pipelined_taat_query pipelined_q(topk, options.window_size);
+    std::string title;
+
+    auto start_batch = std::chrono::steady_clock::now();
+    for (std::size_t idx = 0; idx < queries.size(); ++idx) {
+        auto node_queries = partition.split(queries[idx]);
+        std::vector<cursor_type> node_cursors;
+        for (std::size_t n = 0; n < nodes.size(); ++n) {
+            node_cursors.push_back(
+                make_scored_cursors(nodes[n]->index, *scorers[n], node_queries[n]));
+        }
+        topk.clear();
+        pipelined_q(node_cursors, max_docid, accumulators);
+        topk.finalize();
+        auto qid = queries[idx].id.value_or(std::to_string(idx));
+        for (std::size_t rank = 0; rank < topk.topk().size(); ++rank) {
+            auto [score, docid] = topk.topk()[rank];
+            std::cout << fmt::format(
+                "{}\tQ0\t{}\t{}\t{}\t{}\n",
+                qid,
+                documents.lookup(docid, title),
+                rank,
+                score,
+                run_id);
+        }
+    }
+    auto end_batch = std::chrono::steady_clock::now();
+    double batch_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_batch - start_batch).count();
+    spdlog::info("Time taken to process queries: {}ms", batch_ms);
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    pipeline_options options;
+    std::string encoding;
+    std::string scorer_name;
+    std::string run_id = "R0";
+    bool compressed_wand = false;
+
+    App<arg::Query<arg::QueryMode::Ranked>> app{
+        "Retrieves query results in TREC format from a term-partitioned index, as split by "
+        "partition_terms, passing window accumulators through its nodes."};
+    app.add_option("-e,--encoding", encoding, "Index encoding")->required();
+    app.add_option("-i,--index", options.index_basename, "Basename of the node indexes")
+        ->required();
+    app.add_option("-w,--wand", options.wand_basename, "Basename of the node WAND data")
+        ->required();
+    app.add_flag("--compressed-wand", compressed_wand, "Compressed WAND data files");
+    app.add_option("--nodes", options.node_count, "Number of nodes")->required();
+    app.add_option(
+           "--partition",
+           options.partition_filename,
+           "Node of every term, as written to `.nodes` by partition_terms")
+        ->required();
+    app.add_option("--documents", options.documents_filename, "Document lexicon")->required();
+    app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
+    app.add_option("--window", options.window_size, "Documents per window", true);
+    app.add_option(
+        "--in-flight", options.in_flight, "Windows passed through the nodes at a time", true);
+    app.add_option("-r,--run", run_id, "Run identifier");
+    CLI11_PARSE(app, argc, argv);
+
+    if (options.node_count == 0) {
+        spdlog::error("--nodes must be positive");
+        return 1;
+    }
+    auto params = std::make_tuple(options, app.queries(), app.k(), scorer_name, run_id);
+
+    /**/
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                \
+    }                                                                                        \
+    else if (encoding == BOOST_PP_STRINGIZE(T))                                              \
+    {                                                                                        \
+        if (compressed_wand) {                                                               \
+            std::apply(                                                                      \
+                pipelined_queries<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);     \
+        } else {                                                                             \
+            std::apply(pipelined_queries<BOOST_PP_CAT(T, _index), wand_raw_index>, params);  \
+        }                                                                                    \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", encoding);
+    }
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <map>
+#include <optional>
 #include <random>
 
 #include "boost/lexical_cast.hpp"
@@ -6,25 +8,63 @@
 #include "spdlog/spdlog.h"
 
 #include "dec_time_prediction.hpp"
+#include "hybrid_block_index.hpp"
 #include "index_types.hpp"
 #include "mappable/mapper.hpp"
 #include "util/do_not_optimize_away.hpp"
+#include "util/perf_counters.hpp"
 #include "util/util.hpp"
 
 namespace pisa {
 
-double measure_decoding_time(size_t sum_of_values, size_t n, std::vector<uint8_t> const& buf)
+/// Number of times each block is decoded by `measure_decoding_time`.
+constexpr size_t decoding_runs = 256;
+
+/// The hardware events of the decoding runs, summed by type of block.
+struct decoding_events {
+    perf_counters counters;
+    std::map<int, std::pair<perf_sample, size_t>> types;
+
+    /// Adds the events of the runs of one block of type `type` to the line and to the sums.
+    void add(stats_line& line, int type, perf_sample const& sample)
+    {
+        sample.dump(line, decoding_runs);
+        auto& [sum, blocks] = types[type];
+        sum += sample;
+        blocks += 1;
+    }
+
+    /// Prints the mean events of decoding a block of each type.
+    void dump() const
+    {
+        for (auto const& [type, entry]: types) {
+            auto const& [sum, blocks] = entry;
+            stats_line line;
+            line("type", type)("blocks", blocks);
+            sum.dump(line, static_cast<double>(blocks * decoding_runs));
+        }
+    }
+};
+
+/// Returns the mean time of decoding the block `buf`, in nanoseconds, and, if `events` is
+/// given, stores the hardware events of all runs in `*sample`.
+template <typename BlockCodec = mixed_block>
+double measure_decoding_time(
+    size_t sum_of_values,
+    size_t n,
+    std::vector<uint8_t> const& buf,
+    decoding_events const* events = nullptr,
+    perf_sample* sample = nullptr)
 {
-    static const size_t runs = 256;
-    std::vector<uint32_t> out_buf(mixed_block::block_size);
+    std::vector<uint32_t> out_buf(decode_buffer_size<BlockCodec>);
 
     // dry run to ignore one-time initializations (static variables, ...)
-    mixed_block::decode(buf.data(), out_buf.data(), sum_of_values, n);
+    BlockCodec::decode(buf.data(), out_buf.data(), sum_of_values, n);
 
     size_t spacing = 1 << 10;
-    thread_local std::vector<uint8_t> readbuf(runs * spacing);
-    thread_local std::vector<uint8_t const*> positions(runs);
-    for (size_t run = 0; run < runs; ++run) {
+    thread_local std::vector<uint8_t> readbuf(decoding_runs * spacing);
+    thread_local std::vector<uint8_t const*> positions(decoding_runs);
+    for (size_t run = 0; run < decoding_runs; ++run) {
         // try random alignments
         // XXX switch to c++ gens
         uint8_t* position = readbuf.data() + run * spacing + (rand() % 64);
@@ -32,16 +72,25 @@ double measure_decoding_time(size_t sum_of_values, size_t n, std::vector<uint8_t
         positions[run] = position;
     }
 
+    perf_sample before;
+    if (events != nullptr) {
+        before = events->counters.read();
+    }
     double tick = get_time_usecs();
     for (auto position: positions) {
-        mixed_block::decode(position, out_buf.data(), sum_of_values, n);
+        BlockCodec::decode(position, out_buf.data(), sum_of_values, n);
         do_not_optimize_away(out_buf[0]);
     }
+    double elapsed = get_time_usecs() - tick;
+    if (events != nullptr) {
+        *sample = events->counters.read() - before;
+    }
 
-    return (get_time_usecs() - tick) / runs * 1000;
+    return elapsed / decoding_runs * 1000;
 }
 
-void profile_block(std::vector<uint32_t> const& values, uint32_t sum_of_values)
+void profile_block(
+    std::vector<uint32_t> const& values, uint32_t sum_of_values, decoding_events* events)
 {
     using namespace time_prediction;
     std::vector<uint8_t> buf;
@@ -59,15 +108,48 @@ void profile_block(std::vector<uint32_t> const& values, uint32_t sum_of_values)
                 continue;
             }
 
-            double time = measure_decoding_time(sum_of_values, n, buf);
+            perf_sample sample;
+            double time = measure_decoding_time(sum_of_values, n, buf, events, &sample);
 
-            stats_line()("type", (int)t)("time", time)(fv);
+            stats_line line;
+            line("type", (int)t)("time", time)(fv);
+            if (events != nullptr) {
+                events->add(line, t, sample);
+            }
         }
     }
 }
 
+/// Profiles the block with every codec of `hybrid_block_index`, whose tags are the types of the
+/// lines, to fit the predictors of `create_hybrid_block_index`.
+void profile_hybrid_block(
+    std::vector<uint32_t> const& values, uint32_t sum_of_values, decoding_events* events)
+{
+    using namespace time_prediction;
+    std::vector<uint8_t> buf;
+    feature_vector fv;
+    values_statistics(values, fv);
+
+    for (uint8_t codec = 0; codec < hybrid_codec_count; ++codec) {
+        with_hybrid_codec(codec, [&](auto c) {
+            using codec_type = std::tuple_element_t<decltype(c)::value, hybrid_codecs>;
+            buf.clear();
+            codec_type::encode(values.data(), sum_of_values, values.size(), buf);
+            fv[feature_type::size] = buf.size();
+            perf_sample sample;
+            double time = measure_decoding_time<codec_type>(
+                sum_of_values, values.size(), buf, events, &sample);
+            stats_line line;
+            line("type", (int)codec)("time", time)(fv);
+            if (events != nullptr) {
+                events->add(line, codec, sample);
+            }
+        });
+    }
+}
+
 template <typename IndexType>
-void profile_decoding(const char* index_filename, double p)
+void profile_decoding(const char* index_filename, double p, bool hybrid, bool counters)
 {
     std::default_random_engine rng(1729);
     std::uniform_real_distribution<double> dist01(0.0, 1.0);
@@ -78,6 +160,12 @@ void profile_decoding(const char* index_filename, double p)
     mapper::map(index, m);
 
     std::vector<uint32_t> values;
+    auto profile = hybrid ? profile_hybrid_block : profile_block;
+    std::optional<decoding_events> events;
+    if (counters) {
+        events.emplace();
+    }
+    auto* events_ptr = events ? &*events : nullptr;
 
     for (size_t l = 0; l < index.size(); ++l) {
         if (l % 1000000 == 0) {
@@ -89,31 +177,48 @@ void profile_decoding(const char* index_filename, double p)
             // only measure full blocks
             if (block.size == mixed_block::block_size && dist01(rng) < p) {
                 block.decode_doc_gaps(values);
-                profile_block(values, block.doc_gaps_universe);
+                profile(values, block.doc_gaps_universe, events_ptr);
                 block.decode_freqs(values);
-                profile_block(values, uint32_t(-1));
+                profile(values, uint32_t(-1), events_ptr);
             }
         }
     }
 
     spdlog::info("{} lists processed", index.size());
+    if (events) {
+        events->dump();
+    }
 }
 }  // namespace pisa
 
-int main(int /* argc */, const char** argv)
+int main(int argc, const char** argv)
 {
     using namespace pisa;
 
     std::string type = argv[1];
     const char* index_filename = argv[2];
     double p = boost::lexical_cast<double>(argv[3]);
+    // With a further argument `hybrid`, profile the codecs of `block_hybrid` lists instead of
+    // the block types of `block_mixed`. With `--counters`, also count the hardware events of
+    // decoding each block, and print their means by type of block at the end.
+    bool hybrid = false;
+    bool counters = false;
+    for (int arg = 4; arg < argc; ++arg) {
+        hybrid = hybrid || std::string(argv[arg]) == "hybrid";
+        counters = counters || std::string(argv[arg]) == "--counters";
+    }
+    if (counters && not perf_counters().available()) {
+        spdlog::error(
+            "No hardware event can be counted, see /proc/sys/kernel/perf_event_paranoid");
+        return 1;
+    }
 
     if (false) {
-#define LOOP_BODY(R, DATA, T)                                         \
-    }                                                                 \
-    else if (type == BOOST_PP_STRINGIZE(T))                           \
-    {                                                                 \
-        profile_decoding<BOOST_PP_CAT(T, _index)>(index_filename, p); \
+#define LOOP_BODY(R, DATA, T)                                                           \
+    }                                                                                   \
+    else if (type == BOOST_PP_STRINGIZE(T))                                             \
+    {                                                                                   \
+        profile_decoding<BOOST_PP_CAT(T, _index)>(index_filename, p, hybrid, counters); \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
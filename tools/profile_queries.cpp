@@ -1,6 +1,9 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <optional>
 #include <thread>
+#include <type_traits>
 
 #include "boost/algorithm/string/classification.hpp"
 #include "boost/algorithm/string/split.hpp"
@@ -9,20 +12,33 @@
 
 #include "mio/mmap.hpp"
 
+#include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "mappable/mapper.hpp"
 #include "query/algorithm.hpp"
+#include "query/query_stats.hpp"
 #include "scorer/scorer.hpp"
+#include "timer.hpp"
+#include "util/block_profiler.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/latency_histogram.hpp"
+#include "util/perf_counters.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 
 using namespace pisa;
 
+/// Runs the queries on all threads, and stores the traversal counters of query `i` in
+/// `counters[i]`, and, if `events` is given, the hardware events it caused in `(*events)[i]`.
 template <typename QueryOperator>
-void op_profile(QueryOperator const& query_op, std::vector<Query> const& queries)
+void op_profile(
+    QueryOperator const& query_op,
+    std::vector<Query> const& queries,
+    std::vector<query_counters>& counters,
+    std::vector<perf_sample>* events)
 {
     using namespace pisa;
 
@@ -33,13 +49,25 @@ void op_profile(QueryOperator const& query_op, std::vector<Query> const& queries
     for (size_t tid = 0; tid < n_threads; ++tid) {
         threads[tid] = std::thread([&, tid]() {
             auto query_op_copy = query_op;  // copy one query_op per thread
+            std::optional<perf_counters> perf;
+            if (events != nullptr) {
+                perf.emplace();
+            }
             for (size_t i = tid; i < queries.size(); i += n_threads) {
                 if (i % 10000 == 0) {
                     std::lock_guard<std::mutex> lock(io_mutex);
                     spdlog::info("{} queries processed", i);
                 }
 
-                query_op_copy(queries[i]);
+                query_stats::local().reset();
+                if (perf) {
+                    auto before = perf->read();
+                    query_op_copy(queries[i]);
+                    (*events)[i] = perf->read() - before;
+                } else {
+                    query_op_copy(queries[i]);
+                }
+                counters[i] = query_stats::local();
             }
         });
     }
@@ -48,15 +76,111 @@ void op_profile(QueryOperator const& query_op, std::vector<Query> const& queries
         thread.join();
 }
 
-template <typename IndexType>
-struct add_profiling {
-    typedef IndexType type;
-};
+/// Times each query on the calling thread while `load` other threads run the whole log in a
+/// loop, starting from evenly spread queries, and prints the latency quantiles of the queries
+/// for each load, in microseconds.
+template <typename QueryOperator>
+void op_profile_under_load(
+    QueryOperator const& query_op,
+    std::vector<Query> const& queries,
+    std::vector<size_t> const& loads,
+    std::string const& index_type,
+    std::string const& query_type)
+{
+    if (queries.empty()) {
+        return;
+    }
+    for (auto load: loads) {
+        std::atomic_bool stop = false;
+        std::atomic<uint64_t> background_queries = 0;
+        std::vector<std::thread> threads;
+        for (size_t tid = 0; tid < load; ++tid) {
+            threads.emplace_back([&, tid]() {
+                auto query_op_copy = query_op;  // copy one query_op per thread
+                size_t i = (tid + 1) * queries.size() / (load + 1);
+                while (not stop) {
+                    do_not_optimize_away(query_op_copy(queries[i]));
+                    background_queries += 1;
+                    i = (i + 1) % queries.size();
+                }
+            });
+        }
+
+        auto query_op_copy = query_op;
+        latency_histogram latencies;
+        std::chrono::microseconds elapsed{0};
+        for (size_t run = 0; run < 2; ++run) {  // first run is not timed
+            background_queries = 0;
+            elapsed = run_with_timer<std::chrono::microseconds>([&]() {
+                for (auto const& query: queries) {
+                    auto nsecs = run_with_timer<std::chrono::nanoseconds>(
+                        [&]() { do_not_optimize_away(query_op_copy(query)); });
+                    if (run > 0) {
+                        latencies.record(nsecs.count());
+                    }
+                }
+            });
+        }
+        double background_qps = background_queries / (elapsed.count() / 1'000'000.0);
+        stop = true;
+        for (auto& thread: threads) {
+            thread.join();
+        }
 
-template <typename BlockType>
-struct add_profiling<block_freq_index<BlockType, false>> {
-    typedef block_freq_index<BlockType, true> type;
-};
+        auto usecs = [](double nsecs) { return nsecs / 1000.0; };
+        spdlog::info(
+            "{} load threads: mean {}, 50% quantile {}, 99% quantile {}, background {} QPS",
+            load,
+            usecs(latencies.mean()),
+            usecs(latencies.quantile(0.5)),
+            usecs(latencies.quantile(0.99)),
+            background_qps);
+        stats_line()("type", index_type)("query", query_type)("load_threads", load)(
+            "avg", usecs(latencies.mean()))("q50", usecs(latencies.quantile(0.5)))(
+            "q90", usecs(latencies.quantile(0.9)))("q95", usecs(latencies.quantile(0.95)))(
+            "q99", usecs(latencies.quantile(0.99)))("background_qps", background_qps);
+    }
+}
+
+/// Prints the hardware events of each query, then their mean over all queries, in `format`.
+void print_events(
+    std::string const& query_type,
+    std::vector<perf_sample> const& events,
+    std::string const& format)
+{
+    perf_sample total;
+    for (auto const& sample: events) {
+        total += sample;
+    }
+    double queries = std::max<size_t>(events.size(), 1);
+    if (format == "json") {
+        for (size_t i = 0; i < events.size(); ++i) {
+            stats_line line;
+            line("query", query_type)("qid", i);
+            events[i].dump(line);
+        }
+        stats_line line;
+        line("query", query_type)("qid", "mean");
+        total.dump(line, queries);
+        return;
+    }
+    std::cout << "query\tqid";
+    for (auto name: perf_event_names) {
+        std::cout << '\t' << name;
+    }
+    std::cout << '\n';
+    auto write_row = [&](auto qid, perf_sample const& sample, double runs) {
+        std::cout << query_type << '\t' << qid;
+        for (auto count: sample.counts) {
+            std::cout << '\t' << count / runs;
+        }
+        std::cout << '\n';
+    };
+    for (size_t i = 0; i < events.size(); ++i) {
+        write_row(i, events[i], 1);
+    }
+    write_row("mean", total, queries);
+}
 
 template <typename IndexType>
 void profile(
@@ -65,7 +189,10 @@ void profile(
     const std::optional<std::string>& wand_data_filename,
     std::vector<Query> const& queries,
     std::string const& type,
-    std::string const& query_type)
+    std::string const& query_type,
+    std::optional<std::string> const& stats_format,
+    std::optional<std::string> const& counters_format,
+    std::vector<size_t> const& load_threads)
 {
     using namespace pisa;
 
@@ -74,6 +201,16 @@ void profile(
     spdlog::info("Loading index from {}", index_filename);
     mio::mmap_source m(index_filename);
     mapper::map(index, m);
+    if constexpr (not std::is_same_v<typename add_profiling<IndexType>::type, IndexType>) {
+        // profiled lists register with the profiler when opened, so count blocks without it
+        IndexType plain_index;
+        mapper::map(plain_index, m);
+        std::vector<uint32_t> list_blocks(plain_index.size());
+        for (size_t term = 0; term < plain_index.size(); ++term) {
+            list_blocks[term] = plain_index[term].num_blocks();
+        }
+        block_profiler::init(list_blocks);
+    }
 
     WandType wdata;
     mio::mmap_source md;
@@ -97,6 +234,9 @@ void profile(
     for (auto const& t: query_types) {
         spdlog::info("Query type: {}", t);
         std::function<uint64_t(Query)> query_fun;
+        std::atomic<uint64_t> scored_postings = 0;
+        std::atomic<uint64_t> windows = 0;
+        std::atomic<uint64_t> skipped_windows = 0;
         if (t == "and") {
             query_fun = [&](Query query) {
                 and_query and_q;
@@ -138,10 +278,62 @@ void profile(
                 topk.finalize();
                 return topk.topk().size();
             };
+        } else if (t == "block_max_maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(10);
+                block_max_maxscore_query block_max_maxscore_q(topk);
+                block_max_maxscore_q(
+                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                scored_postings += block_max_maxscore_q.scored_postings();
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else if (t == "dynamic_block_max_maxscore" && wand_data_filename) {
+            query_fun = [&](Query query) {
+                topk_queue topk(10);
+                dynamic_block_max_maxscore_query dynamic_block_max_maxscore_q(topk);
+                dynamic_block_max_maxscore_q(
+                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                scored_postings += dynamic_block_max_maxscore_q.scored_postings();
+                skipped_windows += dynamic_block_max_maxscore_q.skipped_windows();
+                windows += dynamic_block_max_maxscore_q.windows();
+                topk.finalize();
+                return topk.topk().size();
+            };
         } else {
             spdlog::error("Unsupported query type: {}", t);
+            continue;
+        }
+        if (not load_threads.empty()) {
+            op_profile_under_load(query_fun, queries, load_threads, type, t);
+            continue;
+        }
+        std::vector<query_counters> counters(queries.size());
+        std::vector<perf_sample> events(counters_format ? queries.size() : 0);
+        op_profile(query_fun, queries, counters, counters_format ? &events : nullptr);
+        if (stats_format == "json") {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                stats_line()("query", t)("qid", i)(counters[i]);
+            }
+        } else if (stats_format == "tsv") {
+            std::cout << "query\tqid\t";
+            query_counters::write_tsv_header(std::cout);
+            std::cout << '\n';
+            for (size_t i = 0; i < queries.size(); ++i) {
+                std::cout << t << '\t' << i << '\t';
+                counters[i].write_tsv(std::cout);
+                std::cout << '\n';
+            }
+        }
+        if (counters_format) {
+            print_events(t, events, *counters_format);
+        }
+        if (scored_postings > 0) {
+            spdlog::info("Scored postings: {}", scored_postings.load());
+        }
+        if (windows > 0) {
+            spdlog::info("Skipped windows: {} out of {}", skipped_windows.load(), windows.load());
         }
-        op_profile(query_fun, queries);
     }
 
     block_profiler::dump(std::cout);
@@ -151,6 +343,65 @@ int main(int argc, const char** argv)
 {
     using namespace pisa;
 
+    // Options after the other arguments:
+    // - `--stats tsv` or `--stats json` prints the traversal counters of each query, in builds
+    //   with PISA_ENABLE_QUERY_STATS;
+    // - `--load-threads N[,N...]` times the queries while N threads run other queries, for each
+    //   given N, instead of profiling them;
+    // - `--counters tsv` or `--counters json` prints the hardware events of each query, and
+    //   their mean, counted with `perf_event_open`.
+    std::optional<std::string> stats_format;
+    std::optional<std::string> counters_format;
+    std::vector<size_t> load_threads;
+    while (argc > 2) {
+        std::string option = argv[argc - 2];
+        std::string value = argv[argc - 1];
+        if (option == "--stats") {
+            stats_format = value;
+        } else if (option == "--counters") {
+            counters_format = value;
+        } else if (option == "--load-threads") {
+            std::vector<std::string> loads;
+            boost::algorithm::split(loads, value, boost::is_any_of(","));
+            for (auto const& load: loads) {
+                load_threads.push_back(boost::lexical_cast<size_t>(load));
+            }
+        } else {
+            break;
+        }
+        argc -= 2;
+    }
+    if (stats_format) {
+        if (not default_query_stats::enabled) {
+            spdlog::error("--stats requires a build with PISA_ENABLE_QUERY_STATS");
+            return 1;
+        }
+        if (stats_format != "tsv" && stats_format != "json") {
+            spdlog::error("Unknown stats format {}", *stats_format);
+            return 1;
+        }
+        if (not load_threads.empty()) {
+            spdlog::error("--stats cannot be used with --load-threads");
+            return 1;
+        }
+    }
+
+    if (counters_format) {
+        if (counters_format != "tsv" && counters_format != "json") {
+            spdlog::error("Unknown counters format {}", *counters_format);
+            return 1;
+        }
+        if (not load_threads.empty()) {
+            spdlog::error("--counters cannot be used with --load-threads");
+            return 1;
+        }
+        if (not perf_counters().available()) {
+            spdlog::error(
+                "No hardware event can be counted, see /proc/sys/kernel/perf_event_paranoid");
+            return 1;
+        }
+    }
+
     std::string type = argv[1];
     const char* query_type = argv[2];
     const char* index_filename = argv[3];
@@ -163,7 +414,7 @@ int main(int argc, const char** argv)
 
     std::vector<Query> queries;
     term_id_vec q;
-    if (std::string(argv[args]) == "--file") {
+    if (argc > int(args) && std::string(argv[args]) == "--file") {
         args++;
         args++;
         std::filebuf fb;
@@ -178,12 +429,19 @@ int main(int argc, const char** argv)
     }
 
     if (false) {
-#define LOOP_BODY(R, DATA, T)                                               \
-    }                                                                       \
-    else if (type == BOOST_PP_STRINGIZE(T))                                 \
-    {                                                                       \
-        profile<BOOST_PP_CAT(T, _index)>(                                   \
-            index_filename, wand_data_filename, queries, type, query_type); \
+#define LOOP_BODY(R, DATA, T)                         \
+    }                                                 \
+    else if (type == BOOST_PP_STRINGIZE(T))           \
+    {                                                 \
+        profile<BOOST_PP_CAT(T, _index)>(             \
+            index_filename,                           \
+            wand_data_filename,                       \
+            queries,                                  \
+            type,                                     \
+            query_type,                               \
+            stats_format,                             \
+            counters_format,                          \
+            load_threads);                            \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
@@ -0,0 +1,218 @@
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "app.hpp"
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "mappable/mapper.hpp"
+#include "scorer/scorer.hpp"
+#include "static_pruning.hpp"
+#include "util/util.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+struct pruning_options {
+    std::string input_basename;
+    std::string output_basename;
+    std::string scorer_name;
+    pruning_policy policy;
+    std::size_t k;
+    float epsilon;
+    double ratio;
+    std::optional<std::string> wand_output;
+    std::uint64_t block_size;
+    bool compress;
+};
+
+/// Reports how many documents of the top k of every query over the full collection are found
+/// in the top k over the pruned one, both scored with the statistics of the full collection.
+template <typename Scorer>
+void report_overlap(
+    binary_freq_collection const& full,
+    binary_freq_collection const& pruned,
+    Scorer const& scorer,
+    std::vector<Query> const& queries,
+    std::size_t k)
+{
+    auto full_lists = collection_lists(full);
+    auto pruned_lists = collection_lists(pruned);
+    std::vector<float> accumulator(full.num_docs(), 0.0F);
+    double overlap_sum = 0;
+    std::size_t identical = 0;
+    for (auto const& query: queries) {
+        auto expected = exhaustive_topk(full_lists, scorer, query, k, accumulator);
+        auto actual = exhaustive_topk(pruned_lists, scorer, query, k, accumulator);
+        auto overlap = topk_overlap(expected, actual);
+        overlap_sum += overlap;
+        if (overlap == 1.0) {
+            identical += 1;
+        }
+    }
+    auto mean_overlap = queries.empty() ? 1.0 : overlap_sum / queries.size();
+    spdlog::info(
+        "Top-{} overlap with the full collection: {:.4f} on average, identical for {} of {} "
+        "queries",
+        k,
+        mean_overlap,
+        identical,
+        queries.size());
+    stats_line()("k", k)("queries", queries.size())("mean_overlap", mean_overlap)(
+        "identical_topk", identical);
+}
+
+template <typename Wand>
+void prune(Wand const& wdata, pruning_options const& options, std::vector<Query> const& queries)
+{
+    binary_freq_collection input(options.input_basename.c_str());
+    if (wdata.num_docs() != input.num_docs()) {
+        throw std::invalid_argument("The WAND data is not that of the collection");
+    }
+    scorer::with_scorer(options.scorer_name, wdata, [&](auto const& scorer) {
+        auto lists = collection_lists(input);
+        std::vector<float> thresholds;
+        if (options.policy == pruning_policy::term_centric) {
+            spdlog::info("Pruning terms to {} of their top-{} score", options.epsilon, options.k);
+            thresholds = term_centric_thresholds(lists, scorer, options.k, options.epsilon);
+        } else {
+            spdlog::info("Pruning documents to {} of their terms", options.ratio);
+            thresholds =
+                document_centric_thresholds(lists, input.num_docs(), scorer, options.ratio);
+        }
+        auto stats = prune_inverted_index(
+            options.input_basename, options.output_basename, scorer, options.policy, thresholds);
+        spdlog::info(
+            "Kept {} of {} postings ({:.2f}%)",
+            stats.kept_postings,
+            stats.postings,
+            100.0 * stats.kept_postings / std::max<std::size_t>(stats.postings, 1));
+        stats_line()("postings", stats.postings)("kept_postings", stats.kept_postings);
+
+        if (not queries.empty()) {
+            binary_freq_collection pruned(options.output_basename.c_str());
+            report_overlap(input, pruned, scorer, queries, options.k);
+        }
+    });
+
+    if (options.wand_output) {
+        spdlog::info("Building the WAND data of the pruned collection");
+        auto stats = collection_statistics(wdata, input.size());
+        binary_freq_collection pruned(options.output_basename.c_str());
+        binary_collection sizes((options.output_basename + ".sizes").c_str());
+        auto build = [&](auto& pruned_wdata) {
+            // scores are those of the full collection, and so are the upper bounds
+            pruned_wdata.set_term_statistics(stats);
+            mapper::freeze(pruned_wdata, options.wand_output->c_str());
+        };
+        if (options.compress) {
+            wand_data<wand_data_compressed<>> pruned_wdata(
+                sizes.begin()->begin(),
+                pruned.num_docs(),
+                pruned,
+                options.scorer_name,
+                FixedBlock(options.block_size),
+                false,
+                {},
+                0,
+                &stats);
+            build(pruned_wdata);
+        } else {
+            wand_data<wand_data_raw> pruned_wdata(
+                sizes.begin()->begin(),
+                pruned.num_docs(),
+                pruned,
+                options.scorer_name,
+                FixedBlock(options.block_size),
+                false,
+                {},
+                0,
+                &stats);
+            build(pruned_wdata);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    pruning_options options{};
+    std::string policy = "term";
+    options.epsilon = 0.5;
+    options.ratio = 0.5;
+    options.block_size = 64;
+    std::size_t threads = std::thread::hardware_concurrency();
+
+    App<arg::WandData, arg::Scorer, arg::Query<arg::QueryMode::Ranked>> app{
+        "Statically prunes a collection, dropping the postings least likely to reach the top k."};
+    app.add_option("-c,--collection", options.input_basename, "Collection basename")
+        ->required();
+    app.add_option("-o,--output", options.output_basename, "Pruned collection basename")
+        ->required();
+    app.add_option("--policy", policy, "Pruning policy: term or document", true)
+        ->check([](std::string const& name) {
+            return name == "term" || name == "document" ? std::string()
+                                                        : std::string("Must be term or document");
+        });
+    app.add_option(
+        "--epsilon",
+        options.epsilon,
+        "Term policy: drop the postings of a term scoring less than this fraction of its k-th "
+        "highest score",
+        true);
+    app.add_option(
+        "--ratio",
+        options.ratio,
+        "Document policy: keep the postings of this fraction of the terms of every document",
+        true);
+    app.add_option(
+        "--wand-output",
+        options.wand_output,
+        "Write the WAND data of the pruned collection, scoring as the full collection");
+    app.add_option(
+        "-b,--block-size", options.block_size, "Block size of the written WAND data", true);
+    app.add_flag("--compress", options.compress, "Compress the written WAND data");
+    app.add_option("-j,--threads", threads, "Number of threads");
+    CLI11_PARSE(app, argc, argv);
+
+    if (not app.wand_data_path()) {
+        spdlog::error("The WAND data of the collection is required");
+        return 1;
+    }
+    if (options.epsilon < 0 || options.epsilon > 1 || options.ratio <= 0 || options.ratio > 1) {
+        spdlog::error("--epsilon must be in [0, 1] and --ratio in (0, 1]");
+        return 1;
+    }
+    options.scorer_name = app.scorer();
+    options.policy =
+        policy == "term" ? pruning_policy::term_centric : pruning_policy::document_centric;
+    options.k = app.k();
+    // The overlap is only reported for queries given in a file.
+    std::vector<Query> queries;
+    if (app.query_file()) {
+        queries = app.queries();
+    }
+
+    tbb::task_scheduler_init init(threads);
+    mio::mmap_source md(app.wand_data_path()->c_str());
+    if (app.is_wand_compressed()) {
+        wand_data<wand_data_compressed<>> wdata;
+        mapper::map(wdata, md);
+        prune(wdata, options, queries);
+    } else {
+        wand_data<wand_data_raw> wdata;
+        mapper::map(wdata, md);
+        prune(wdata, options, queries);
+    }
+    return 0;
+}
@@ -1,8 +1,14 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <numeric>
 #include <optional>
+#include <random>
 #include <string>
+#include <thread>
 
 #include <CLI/CLI.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -12,19 +18,35 @@
 #include <spdlog/sinks/null_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
 
+#include "accumulator/compact_accumulator.hpp"
 #include "accumulator/lazy_accumulator.hpp"
 #include "app.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
+#include "deleted_documents.hpp"
+#include "cursor/impact_cursor.hpp"
+#include "fat_block_index.hpp"
+#include "impact_index.hpp"
 #include "index_types.hpp"
 #include "mappable/mapper.hpp"
+#include "positional_index.hpp"
 #include "query/algorithm.hpp"
+#include "query/conjunctive_rewrite.hpp"
+#include "query/query_planner.hpp"
+#include "query/query_stats.hpp"
+#include "query/warmup.hpp"
+#include "scorer/score_memo.hpp"
 #include "scorer/scorer.hpp"
+#include "term_thresholds.hpp"
 #include "timer.hpp"
 #include "topk_queue.hpp"
+#include "util/latency_histogram.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
@@ -32,6 +54,71 @@
 using namespace pisa;
 using ranges::views::enumerate;
 
+/// The phases of a query timed separately by `op_perftest`.
+enum class query_phase : std::size_t { cursors, traversal, finalize };
+constexpr std::array<char const*, 3> query_phase_names{"cursors", "traversal", "finalize"};
+
+/// Splits the time of the query being timed on the calling thread into phases, when started by
+/// `op_perftest`. Each `end_phase` adds the time since the previous one, or since the start of
+/// the query, to a phase; the time after the last one is not attributed to any phase.
+class phase_timer {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    [[nodiscard]] static auto local() -> phase_timer&
+    {
+        thread_local phase_timer timer;
+        return timer;
+    }
+
+    void start()
+    {
+        m_active = true;
+        m_ended.fill(false);
+        m_durations.fill(0);
+        m_last = clock::now();
+    }
+
+    void end_phase(query_phase phase)
+    {
+        if (m_active) {
+            auto now = clock::now();
+            auto p = static_cast<std::size_t>(phase);
+            m_durations[p] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last)
+                                  .count();
+            m_ended[p] = true;
+            m_last = now;
+        }
+    }
+
+    /// Stops timing, and returns the duration of each phase in nanoseconds, if it ended.
+    auto stop() -> std::array<std::optional<uint64_t>, query_phase_names.size()>
+    {
+        m_active = false;
+        std::array<std::optional<uint64_t>, query_phase_names.size()> durations;
+        for (std::size_t p = 0; p < durations.size(); ++p) {
+            if (m_ended[p]) {
+                durations[p] = m_durations[p];
+            }
+        }
+        return durations;
+    }
+
+  private:
+    bool m_active = false;
+    clock::time_point m_last;
+    std::array<bool, query_phase_names.size()> m_ended{};
+    std::array<uint64_t, query_phase_names.size()> m_durations{};
+};
+
+void end_phase(query_phase phase) { phase_timer::local().end_phase(phase); }
+
+/// Latencies of whole queries and of their phases, in nanoseconds.
+struct query_latencies {
+    latency_histogram total;
+    std::array<latency_histogram, query_phase_names.size()> phases;
+};
+
 template <typename Fn>
 void extract_times(
     Fn fn,
@@ -55,6 +142,31 @@ void extract_times(
     }
 }
 
+/// Runs each query once, and writes the counters of its traversal, as TSV or as JSON lines.
+template <typename Fn>
+void extract_stats(
+    Fn fn,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& query_type,
+    std::string const& format,
+    std::ostream& os)
+{
+    for (auto&& [qid, query]: enumerate(queries)) {
+        query_stats::local().reset();
+        do_not_optimize_away(fn(query, thresholds[qid]));
+        auto const& counters = query_stats::local();
+        auto id = query.id.value_or(std::to_string(qid));
+        if (format == "json") {
+            stats_line()("query", query_type)("qid", id)(counters);
+        } else {
+            os << query_type << '\t' << id << '\t';
+            counters.write_tsv(os);
+            os << '\n';
+        }
+    }
+}
+
 template <typename Functor>
 void op_perftest(
     Functor query_func,
@@ -64,59 +176,241 @@ void op_perftest(
     std::string const& query_type,
     size_t runs,
     std::uint64_t k,
-    bool safe)
+    bool safe,
+    std::size_t threads,
+    std::ostream* prometheus)
 {
-    std::vector<double> query_times;
-    std::size_t num_reruns = 0;
+    std::atomic_size_t num_reruns{0};
     spdlog::info("Safe: {}", safe);
+    spdlog::info("Threads: {}", threads);
+
+    // Each worker records latencies in its own histograms, merged after all runs.
+    tbb::enumerable_thread_specific<query_latencies> thread_latencies;
+    auto run_query = [&](Functor& func, size_t run, size_t idx) {
+        auto& timer = phase_timer::local();
+        timer.start();
+        auto nsecs = run_with_timer<std::chrono::nanoseconds>([&]() {
+            uint64_t result = func(queries[idx], thresholds[idx]);
+            if (safe && result < k) {
+                num_reruns += 1;
+                result = func(queries[idx], 0);
+            }
+            do_not_optimize_away(result);
+        });
+        auto phases = timer.stop();
+        if (run != 0) {  // first run is not timed
+            auto& latencies = thread_latencies.local();
+            latencies.total.record(nsecs.count());
+            for (std::size_t p = 0; p < phases.size(); ++p) {
+                if (phases[p]) {
+                    latencies.phases[p].record(*phases[p]);
+                }
+            }
+        }
+    };
 
+    // Each worker owns a copy of the query function, together with the top-k
+    // queue and accumulator it captures.
+    tbb::enumerable_thread_specific<Functor> thread_query_func(query_func);
+    std::chrono::microseconds elapsed{0};
     for (size_t run = 0; run <= runs; ++run) {
-        size_t idx = 0;
-        for (auto const& query: queries) {
-            auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
-                uint64_t result = query_func(query, thresholds[idx]);
-                if (safe && result < k) {
-                    num_reruns += 1;
-                    result = query_func(query, 0);
+        auto run_time = run_with_timer<std::chrono::microseconds>([&]() {
+            if (threads == 1) {
+                for (size_t idx = 0; idx < queries.size(); ++idx) {
+                    run_query(query_func, run, idx);
                 }
-                do_not_optimize_away(result);
-            });
-            if (run != 0) {  // first run is not timed
-                query_times.push_back(usecs.count());
+            } else {
+                tbb::parallel_for(size_t(0), queries.size(), [&](size_t idx) {
+                    run_query(thread_query_func.local(), run, idx);
+                });
             }
-            idx += 1;
+        });
+        if (run != 0) {
+            elapsed += run_time;
         }
     }
 
-    if (false) {
-        for (auto t: query_times) {
-            std::cout << (t / 1000) << std::endl;
+    query_latencies latencies;
+    thread_latencies.combine_each([&](query_latencies const& local) {
+        latencies.total.merge(local.total);
+        for (std::size_t p = 0; p < query_phase_names.size(); ++p) {
+            latencies.phases[p].merge(local.phases[p]);
+        }
+    });
+    auto usecs = [](double nsecs) { return nsecs / 1000.0; };
+    auto const& total = latencies.total;
+    double avg = usecs(total.mean());
+    double q50 = usecs(total.quantile(0.5));
+    double q90 = usecs(total.quantile(0.9));
+    double q95 = usecs(total.quantile(0.95));
+    double q99 = usecs(total.quantile(0.99));
+    double qps = total.count() / (elapsed.count() / 1'000'000.0);
+
+    spdlog::info("---- {} {}", index_type, query_type);
+    spdlog::info("Mean: {}", avg);
+    spdlog::info("50% quantile: {}", q50);
+    spdlog::info("90% quantile: {}", q90);
+    spdlog::info("95% quantile: {}", q95);
+    spdlog::info("99% quantile: {}", q99);
+    for (std::size_t p = 0; p < query_phase_names.size(); ++p) {
+        auto const& phase = latencies.phases[p];
+        if (phase.count() > 0) {
+            spdlog::info(
+                "Phase {}: mean {}, 50% quantile {}, 99% quantile {}",
+                query_phase_names[p],
+                usecs(phase.mean()),
+                usecs(phase.quantile(0.5)),
+                usecs(phase.quantile(0.99)));
+        }
+    }
+    spdlog::info("Throughput: {} QPS", qps);
+    spdlog::info("Num. reruns: {}", num_reruns.load());
+
+    stats_line()("type", index_type)("query", query_type)("threads", threads)("avg", avg)(
+        "q50", q50)("q90", q90)("q95", q95)("q99", q99)("qps", qps);
+
+    if (prometheus != nullptr) {
+        auto labels = fmt::format("encoding=\"{}\",algorithm=\"{}\"", index_type, query_type);
+        total.write_prometheus(
+            *prometheus, "pisa_query_latency_seconds", labels + ",phase=\"total\"");
+        for (std::size_t p = 0; p < query_phase_names.size(); ++p) {
+            if (latencies.phases[p].count() > 0) {
+                latencies.phases[p].write_prometheus(
+                    *prometheus,
+                    "pisa_query_latency_seconds",
+                    fmt::format("{},phase=\"{}\"", labels, query_phase_names[p]));
+            }
+        }
+    }
+}
+
+/// Waits until `time`, sleeping until shortly before it and spinning the rest of the way, as
+/// sleeps can overshoot by much more than the latency of a query.
+void wait_until(std::chrono::steady_clock::time_point time)
+{
+    auto spin = std::chrono::microseconds(200);
+    if (std::chrono::steady_clock::now() + spin < time) {
+        std::this_thread::sleep_until(time - spin);
+    }
+    while (std::chrono::steady_clock::now() < time) {
+    }
+}
+
+/// Issues the queries with Poisson arrivals at each of the given rates, in queries per second,
+/// and reports the latencies seen by the clients.
+///
+/// The load is open-loop: arrival times are drawn in advance, independently of how fast queries
+/// are processed. Queries are taken in arrival order by `threads` workers, so they wait in a
+/// queue whenever all workers are busy; the latency of a query is the sum of its queueing
+/// delay and of its service time. Each rate issues as many queries as the log, cycling through
+/// it, at least once. The saturation point is the first rate whose achieved throughput falls
+/// below 95% of the offered one.
+template <typename Functor>
+void op_loadtest(
+    Functor query_func,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& index_type,
+    std::string const& query_type,
+    std::vector<double> const& arrival_rates,
+    std::uint64_t k,
+    bool safe,
+    std::size_t threads)
+{
+    using clock = std::chrono::steady_clock;
+    auto to_nsecs = [](clock::duration d) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    };
+    auto usecs = [](double nsecs) { return nsecs / 1000.0; };
+    std::optional<double> saturation;
+    std::mt19937_64 rng(1729);
+    for (double rate: arrival_rates) {
+        std::exponential_distribution<double> gaps(rate);
+        std::vector<clock::duration> arrivals(queries.size());
+        double arrival = 0.0;
+        for (auto& a: arrivals) {
+            arrival += gaps(rng);
+            a = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(arrival));
+        }
+
+        struct worker_latencies {
+            latency_histogram latency;
+            latency_histogram queueing;
+            latency_histogram service;
+        };
+        std::vector<worker_latencies> latencies(threads);
+        std::atomic_size_t next{0};
+        std::atomic<clock::rep> last_finish{0};
+        auto start = clock::now() + std::chrono::milliseconds(10);
+        std::vector<std::thread> workers;
+        for (std::size_t tid = 0; tid < threads; ++tid) {
+            workers.emplace_back([&, tid, func = query_func]() mutable {
+                for (auto idx = next++; idx < queries.size(); idx = next++) {
+                    auto arrived = start + arrivals[idx];
+                    wait_until(arrived);
+                    auto begin = clock::now();
+                    uint64_t result = func(queries[idx], thresholds[idx]);
+                    if (safe && result < k) {
+                        result = func(queries[idx], 0);
+                    }
+                    do_not_optimize_away(result);
+                    auto end = clock::now();
+                    latencies[tid].latency.record(to_nsecs(end - arrived));
+                    latencies[tid].queueing.record(to_nsecs(begin - arrived));
+                    latencies[tid].service.record(to_nsecs(end - begin));
+                    auto finish = (end - start).count();
+                    auto last = last_finish.load();
+                    while (last < finish && not last_finish.compare_exchange_weak(last, finish)) {
+                    }
+                }
+            });
         }
+        for (auto& worker: workers) {
+            worker.join();
+        }
+
+        worker_latencies total;
+        for (auto const& local: latencies) {
+            total.latency.merge(local.latency);
+            total.queueing.merge(local.queueing);
+            total.service.merge(local.service);
+        }
+        double elapsed = std::chrono::duration<double>(clock::duration(last_finish.load())).count();
+        double achieved = queries.size() / elapsed;
+        if (not saturation && achieved < 0.95 * rate) {
+            saturation = rate;
+        }
+
+        spdlog::info(
+            "Offered {} QPS, achieved {} QPS: latency 50% {}, 99% {}; queueing 50% {}, 99% {}",
+            rate,
+            achieved,
+            usecs(total.latency.quantile(0.5)),
+            usecs(total.latency.quantile(0.99)),
+            usecs(total.queueing.quantile(0.5)),
+            usecs(total.queueing.quantile(0.99)));
+        stats_line()("type", index_type)("query", query_type)("threads", threads)(
+            "offered_qps", rate)("achieved_qps", achieved)("avg", usecs(total.latency.mean()))(
+            "q50", usecs(total.latency.quantile(0.5)))("q90", usecs(total.latency.quantile(0.9)))(
+            "q95", usecs(total.latency.quantile(0.95)))("q99", usecs(total.latency.quantile(0.99)))(
+            "queueing_q50", usecs(total.queueing.quantile(0.5)))(
+            "queueing_q99", usecs(total.queueing.quantile(0.99)))(
+            "service_avg", usecs(total.service.mean()));
+    }
+    if (saturation) {
+        spdlog::info("---- {} {} saturates at {} QPS", index_type, query_type, *saturation);
     } else {
-        std::sort(query_times.begin(), query_times.end());
-        double avg =
-            std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
-        double q50 = query_times[query_times.size() / 2];
-        double q90 = query_times[90 * query_times.size() / 100];
-        double q95 = query_times[95 * query_times.size() / 100];
-        double q99 = query_times[99 * query_times.size() / 100];
-
-        spdlog::info("---- {} {}", index_type, query_type);
-        spdlog::info("Mean: {}", avg);
-        spdlog::info("50% quantile: {}", q50);
-        spdlog::info("90% quantile: {}", q90);
-        spdlog::info("95% quantile: {}", q95);
-        spdlog::info("99% quantile: {}", q99);
-        spdlog::info("Num. reruns: {}", num_reruns);
-
-        stats_line()("type", index_type)("query", query_type)("avg", avg)("q50", q50)("q90", q90)(
-            "q95", q95)("q99", q99);
+        spdlog::info("---- {} {} does not saturate at the given rates", index_type, query_type);
     }
+    stats_line()("type", index_type)("query", query_type)("threads", threads)(
+        "saturation_qps", saturation ? *saturation : 0.0);
 }
 
 template <typename IndexType, typename WandType>
 void perftest(
     const std::string& index_filename,
+    mapper::load_mode load_mode,
     const std::optional<std::string>& wand_data_filename,
     const std::vector<Query>& queries,
     const std::optional<std::string>& thresholds_filename,
@@ -125,21 +419,44 @@ void perftest(
     uint64_t k,
     std::string const& scorer_name,
     bool extract,
-    bool safe)
+    bool safe,
+    std::size_t threads,
+    std::optional<std::string> const& deleted_filename,
+    std::optional<std::string> const& deleted_blocks_filename,
+    std::optional<std::string> const& term_thresholds_filename,
+    query_budget const& budget,
+    uint32_t prefetch_lines,
+    float clip_ratio,
+    std::optional<std::string> const& positions_filename,
+    std::optional<std::size_t> warmup_terms,
+    std::optional<std::string> const& stats_format,
+    std::optional<std::string> const& prometheus_filename,
+    std::vector<double> const& arrival_rates,
+    docid_range const& docids,
+    std::size_t score_memo_entries,
+    bool decode_list_endpoints,
+    std::size_t block_cache_mib,
+    std::optional<std::string> const& impact_index_filename,
+    std::size_t conjunctive_subqueries)
 {
     IndexType index;
     spdlog::info("Loading index from {}", index_filename);
-    mio::mmap_source m(index_filename.c_str());
+    mapper::mapped_file m(index_filename, load_mode);
     mapper::map(index, m);
+    if (decode_list_endpoints && not decode_endpoints(index)) {
+        spdlog::warn("The endpoints of {} indexes cannot be decoded", type);
+    }
 
     spdlog::info("Warming up posting lists");
-    std::unordered_set<term_id_type> warmed_up;
-    for (auto const& q: queries) {
-        for (auto t: q.terms) {
-            if (!warmed_up.count(t)) {
-                index.warmup(t);
-                warmed_up.insert(t);
-            }
+    warmup_lists(index, query_log_terms(queries, warmup_terms));
+    std::unique_ptr<decoded_block_cache> block_cache;
+    if (block_cache_mib > 0) {
+        block_cache =
+            use_decoded_block_cache(index, query_log_terms(queries), block_cache_mib << 20U);
+        if (block_cache) {
+            spdlog::info("Caching up to {} decoded blocks", block_cache->admitted_blocks());
+        } else {
+            spdlog::warn("The decoded blocks of {} indexes cannot be cached", type);
         }
     }
 
@@ -158,6 +475,39 @@ void perftest(
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
 
+    deleted_documents deleted;
+    mio::mmap_source mdel;
+    if (deleted_filename) {
+        mdel.map(*deleted_filename);
+        mapper::map(deleted, mdel);
+        if (deleted.num_docs() != index.num_docs()) {
+            throw std::invalid_argument("Deleted documents do not match the index size");
+        }
+        spdlog::info("Excluding {} deleted documents", deleted.count());
+    }
+    auto const* deleted_docs = deleted_filename ? &deleted : nullptr;
+    deleted_blocks blocks;
+    mio::mmap_source mblocks;
+    if (deleted_blocks_filename) {
+        mblocks.map(*deleted_blocks_filename);
+        mapper::map(blocks, mblocks);
+    }
+    // Term scores are memoized per thread across the queries, if requested.
+    auto memo = [&]() -> score_memo& {
+        thread_local score_memo memo(score_memo_entries);
+        return memo;
+    };
+
+    // Block-max algorithms see the maxima of fully deleted blocks as zero, if given.
+    auto with_block_max_data = [&](auto&& fn) {
+        auto const& data = block_max_data(index, wdata);
+        if (deleted_blocks_filename) {
+            fn(deleted_block_max_data<std::decay_t<decltype(data)>>(data, blocks));
+        } else {
+            fn(data);
+        }
+    };
+
     std::vector<Threshold> thresholds(queries.size(), 0.0);
     if (thresholds_filename) {
         std::string t;
@@ -171,128 +521,507 @@ void perftest(
             throw std::invalid_argument("Invalid thresholds file.");
         }
     }
+    if (term_thresholds_filename) {
+        term_thresholds estimates;
+        mio::mmap_source mt(term_thresholds_filename->c_str());
+        mapper::map(estimates, mt);
+        if (estimates.max_k() < k) {
+            spdlog::warn(
+                "Term thresholds are computed for k up to {}, queries start from a zero threshold",
+                estimates.max_k());
+        }
+        for (size_t idx = 0; idx < queries.size(); ++idx) {
+            thresholds[idx] = estimates.estimate(queries[idx], k);
+        }
+    }
+
+    positional_index<simdbp_block> positions;
+    mio::mmap_source mpositions;
+    if (positions_filename) {
+        mpositions.map(*positions_filename);
+        mapper::map(positions, mpositions);
+        if (positions.size() != index.size()) {
+            throw std::invalid_argument("Positions do not match the index size");
+        }
+    }
 
-    auto scorer = scorer::from_name(scorer_name, wdata);
+    std::ofstream prometheus;
+    if (prometheus_filename) {
+        prometheus.open(*prometheus_filename);
+        latency_histogram::write_prometheus_header(
+            prometheus, "pisa_query_latency_seconds", "Latency of queries and of their phases.");
+    }
 
-    spdlog::info("Performing {} queries", type);
-    spdlog::info("K: {}", k);
+    // Queries restricted to a docid range start their cursors at its beginning.
+    uint64_t max_docid = docids.end_within(index.num_docs());
+    if (not docids.is_full()) {
+        spdlog::info("Restricting queries to docids [{}, {})", docids.begin, max_docid);
+    }
+    auto in_range = [&](auto&& cursors) -> decltype(auto) {
+        seek_cursors(cursors, docids.begin);
+        return std::forward<decltype(cursors)>(cursors);
+    };
 
-    for (auto&& t: query_types) {
-        spdlog::info("Query type: {}", t);
-        std::function<uint64_t(Query, Threshold)> query_fun;
-        if (t == "and") {
-            query_fun = [&](Query query, Threshold) {
-                and_query and_q;
-                return and_q(make_cursors(index, query), index.num_docs()).size();
-            };
-        } else if (t == "or") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<false> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "or_freq") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<true> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_and_query ranked_and_q(topk);
-                ranked_and_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_ranked_and_query block_max_ranked_and_q(topk);
-                block_max_ranked_and_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or_taat" && wand_data_filename) {
-            Simple_Accumulator accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
-            Lazy_Accumulator<4> accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else {
-            spdlog::error("Unsupported query type: {}", t);
-            break;
+    // Planned queries whose lists are all stored in impact order as well may be processed
+    // score-at-a-time, over whole lists only.
+    impact_simdbp_index impact_index;
+    mio::mmap_source mimpact;
+    if (impact_index_filename) {
+        if (scorer_name != "quantized") {
+            throw std::invalid_argument("An impact-ordered index requires the quantized scorer");
         }
-        if (extract) {
-            extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
-        } else {
-            op_perftest(query_fun, queries, thresholds, type, t, 2, k, safe);
+        mimpact.map(*impact_index_filename);
+        mapper::map(impact_index, mimpact);
+        if (impact_index.size() != index.size() || impact_index.num_docs() != index.num_docs()) {
+            throw std::invalid_argument("The impact-ordered index does not match the index");
         }
+        warmup_lists(impact_index, query_log_terms(queries, warmup_terms));
     }
+    auto impact_ordered = [&](Query const& query) {
+        return impact_index_filename && docids.is_full()
+            && std::all_of(query.terms.begin(), query.terms.end(), [&](auto term) {
+                   return impact_index.stores(term);
+               });
+    };
+
+    query_planner planner;
+    conjunctive_rewriter::parameters rewrite_params;
+    rewrite_params.max_subqueries = conjunctive_subqueries;
+    conjunctive_rewriter rewriter(rewrite_params);
+    auto seeds_conjunctions = [&](std::string const& t) {
+        return conjunctive_subqueries > 0 && wand_data_filename
+            && (t == "wand" || t == "maxscore" || t == "block_max_wand"
+                || t == "block_max_maxscore");
+    };
+    bool known_thresholds = thresholds_filename || term_thresholds_filename;
+
+    spdlog::info("Performing {} queries", type);
+    spdlog::info("K: {}", k);
+
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        for (auto&& t: query_types) {
+            spdlog::info("Query type: {}", t);
+            std::function<uint64_t(Query, Threshold)> query_fun;
+            if (t == "and") {
+                query_fun = [&](Query query, Threshold) {
+                    and_query and_q;
+                    return and_q(in_range(make_cursors(index, query)), max_docid).size();
+                };
+            } else if (t == "phrase" && positions_filename) {
+                query_fun = [&](Query query, Threshold) {
+                    phrase_query phrase_q;
+                    return phrase_q(index, positions, query).size();
+                };
+            } else if (t == "and_simd") {
+                query_fun = [&](Query query, Threshold) {
+                    and_simd_query and_q;
+                    return and_q(in_range(make_cursors(index, query)), max_docid).size();
+                };
+            } else if (t == "or") {
+                query_fun = [&](Query query, Threshold) {
+                    or_query<false> or_q;
+                    return or_q(in_range(make_cursors(index, query)), max_docid);
+                };
+            } else if (t == "or_freq") {
+                query_fun = [&](Query query, Threshold) {
+                    or_query<true> or_q;
+                    return or_q(in_range(make_cursors(index, query)), max_docid);
+                };
+            } else if (t == "wand" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    wand_query wand_q(topk);
+                    query_arena::scope arena_scope(query_arena::local());
+                    auto cursors =
+                        make_max_scored_cursors(index, wdata, scorer, query, query_arena::local());
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    wand_q(cursors, max_docid);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_wand" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    return with_block_max_score_type(scorer_name, [&](auto score) {
+                        using Score = decltype(score);
+                        basic_topk_queue<Score> topk(k, deleted_docs);
+                        topk.set_threshold(ceil_score<Score>(t));
+                        basic_block_max_wand_query<Score> block_max_wand_q(
+                            topk, budget, prefetch_lines);
+                        with_block_max_data([&](auto const& block_max) {
+                            auto run = [&](auto cursors) {
+                                seek_cursors(cursors, docids.begin);
+                                end_phase(query_phase::cursors);
+                                block_max_wand_q(cursors, max_docid);
+                            };
+                            query_arena::scope arena_scope(query_arena::local());
+                            if (score_memo_entries > 0) {
+                                run(make_block_max_scored_cursors<Score>(
+                                    index, block_max, scorer, query, memo()));
+                            } else {
+                                run(make_block_max_scored_cursors<Score>(
+                                    index, block_max, scorer, query, query_arena::local()));
+                            }
+                        });
+                        end_phase(query_phase::traversal);
+                        topk.finalize();
+                        end_phase(query_phase::finalize);
+                        return topk.topk().size();
+                    });
+                };
+            } else if (t == "block_max_maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    return with_block_max_score_type(scorer_name, [&](auto score) {
+                        using Score = decltype(score);
+                        basic_topk_queue<Score> topk(k, deleted_docs);
+                        topk.set_threshold(ceil_score<Score>(t));
+                        basic_block_max_maxscore_query<Score> block_max_maxscore_q(topk);
+                        with_block_max_data([&](auto const& block_max) {
+                            auto cursors = make_block_max_scored_cursors<Score>(
+                                index, block_max, scorer, query);
+                            seek_cursors(cursors, docids.begin);
+                            end_phase(query_phase::cursors);
+                            block_max_maxscore_q(cursors, max_docid);
+                        });
+                        end_phase(query_phase::traversal);
+                        topk.finalize();
+                        end_phase(query_phase::finalize);
+                        return topk.topk().size();
+                    });
+                };
+            } else if (t == "dynamic_block_max_maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    return with_block_max_score_type(scorer_name, [&](auto score) {
+                        using Score = decltype(score);
+                        basic_topk_queue<Score> topk(k, deleted_docs);
+                        topk.set_threshold(ceil_score<Score>(t));
+                        basic_dynamic_block_max_maxscore_query<Score> dynamic_block_max_maxscore_q(
+                            topk);
+                        with_block_max_data([&](auto const& block_max) {
+                            auto cursors = make_block_max_scored_cursors<Score>(
+                                index, block_max, scorer, query);
+                            seek_cursors(cursors, docids.begin);
+                            end_phase(query_phase::cursors);
+                            dynamic_block_max_maxscore_q(cursors, max_docid);
+                        });
+                        end_phase(query_phase::traversal);
+                        topk.finalize();
+                        end_phase(query_phase::finalize);
+                        return topk.topk().size();
+                    });
+                };
+            } else if (t == "ranked_and" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    ranked_and_query ranked_and_q(topk);
+                    auto cursors = make_scored_cursors(index, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    ranked_and_q(cursors, max_docid);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_ranked_and" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    block_max_ranked_and_query block_max_ranked_and_q(topk);
+                    with_block_max_data([&](auto const& block_max) {
+                        auto cursors =
+                            make_block_max_scored_cursors(index, block_max, scorer, query);
+                        seek_cursors(cursors, docids.begin);
+                        end_phase(query_phase::cursors);
+                        block_max_ranked_and_q(cursors, max_docid);
+                    });
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    ranked_or_query ranked_or_q(topk);
+                    auto cursors = make_scored_cursors(index, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    ranked_or_q(cursors, max_docid);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, budget);
+                    auto run = [&](auto cursors) {
+                        seek_cursors(cursors, docids.begin);
+                        end_phase(query_phase::cursors);
+                        maxscore_q(cursors, max_docid);
+                    };
+                    query_arena::scope arena_scope(query_arena::local());
+                    if (score_memo_entries > 0) {
+                        run(make_max_scored_cursors(index, wdata, scorer, query, memo()));
+                    } else {
+                        run(make_max_scored_cursors(
+                            index, wdata, scorer, query, query_arena::local()));
+                    }
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "long_maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    long_maxscore_query long_maxscore_q(topk);
+                    query_arena::scope arena_scope(query_arena::local());
+                    auto cursors =
+                        make_max_scored_cursors(index, wdata, scorer, query, query_arena::local());
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    long_maxscore_q(cursors, max_docid);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "clipped_maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_queue topk(k, deleted_docs);
+                    topk.set_threshold(t);
+                    long_maxscore_query clipped_maxscore_q(topk, clip_ratio);
+                    query_arena::scope arena_scope(query_arena::local());
+                    auto cursors =
+                        make_max_scored_cursors(index, wdata, scorer, query, query_arena::local());
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    clipped_maxscore_q(cursors, max_docid);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Simple_Accumulator(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    auto cursors = make_scored_cursors(index, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    ranked_or_taat_q(cursors, max_docid, accumulator);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    auto cursors = make_scored_cursors(index, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    ranked_or_taat_q(cursors, max_docid, accumulator);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat_bf16" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Bfloat16_Accumulator(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    auto cursors = make_scored_cursors(index, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    ranked_or_taat_q(cursors, max_docid, accumulator);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat_quantized" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Quantized_Accumulator(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    auto cursors = make_scored_cursors(index, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    ranked_or_taat_q(cursors, max_docid, accumulator);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "windowed_taat" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Simple_Accumulator(
+                                 windowed_taat_query::default_window_size)](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    windowed_taat_query windowed_taat_q(topk);
+                    auto cursors = make_max_scored_cursors(index, wdata, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    windowed_taat_q(cursors, max_docid, accumulator);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "windowed_taat_lazy" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Lazy_Accumulator<4>(
+                                 windowed_taat_query::default_window_size)](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    windowed_taat_query windowed_taat_q(topk);
+                    auto cursors = make_max_scored_cursors(index, wdata, scorer, query);
+                    seek_cursors(cursors, docids.begin);
+                    end_phase(query_phase::cursors);
+                    windowed_taat_q(cursors, max_docid, accumulator);
+                    end_phase(query_phase::traversal);
+                    topk.finalize();
+                    end_phase(query_phase::finalize);
+                    return topk.topk().size();
+                };
+            } else if (t == "planned" && wand_data_filename) {
+                query_fun = [&,
+                             topk = topk_queue(k, deleted_docs),
+                             accumulator = Simple_Accumulator(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    auto features = query_features::compute(
+                        index,
+                        wdata,
+                        query,
+                        known_thresholds ? std::optional<float>(t) : std::nullopt);
+                    features.impact_ordered = impact_ordered(query);
+                    planner.execute(features, topk, [&](planned_algorithm choice) {
+                        switch (choice) {
+                        case planned_algorithm::block_max_ranked_and:
+                            with_block_max_data([&](auto const& block_max) {
+                                block_max_ranked_and_query block_max_ranked_and_q(topk);
+                                block_max_ranked_and_q(
+                                    in_range(make_block_max_scored_cursors(
+                                        index, block_max, scorer, query)),
+                                    max_docid);
+                            });
+                            break;
+                        case planned_algorithm::block_max_maxscore:
+                            with_block_max_data([&](auto const& block_max) {
+                                block_max_maxscore_query block_max_maxscore_q(topk);
+                                block_max_maxscore_q(
+                                    in_range(make_block_max_scored_cursors(
+                                        index, block_max, scorer, query)),
+                                    max_docid);
+                            });
+                            break;
+                        case planned_algorithm::block_max_wand:
+                            with_block_max_data([&](auto const& block_max) {
+                                block_max_wand_query block_max_wand_q(topk);
+                                block_max_wand_q(
+                                    in_range(make_block_max_scored_cursors(
+                                        index, block_max, scorer, query)),
+                                    max_docid);
+                            });
+                            break;
+                        case planned_algorithm::long_maxscore: {
+                            long_maxscore_query long_maxscore_q(topk);
+                            query_arena::scope arena_scope(query_arena::local());
+                            long_maxscore_q(
+                                in_range(make_max_scored_cursors(
+                                    index, wdata, scorer, query, query_arena::local())),
+                                max_docid);
+                            break;
+                        }
+                        case planned_algorithm::ranked_or_taat: {
+                            ranked_or_taat_query ranked_or_taat_q(topk);
+                            ranked_or_taat_q(
+                                in_range(make_scored_cursors(index, scorer, query)),
+                                max_docid,
+                                accumulator);
+                            break;
+                        }
+                        case planned_algorithm::impact_saat: {
+                            anytime_saat_query impact_saat_q(topk);
+                            impact_saat_q(make_impact_cursors(impact_index, query), accumulator);
+                            break;
+                        }
+                        }
+                    });
+                    return topk.topk().size();
+                };
+            } else {
+                spdlog::error("Unsupported query type: {}", t);
+                break;
+            }
+            if (seeds_conjunctions(t)) {
+                // Conjunctive subqueries are processed within the query, and timed with it.
+                query_fun = [&, run = std::move(query_fun)](Query query, Threshold t) {
+                    auto subqueries = rewriter.rewrite(index, wdata, query, k);
+                    Threshold seeded = 0;
+                    with_block_max_data([&](auto const& block_max) {
+                        seeded = conjunctive_threshold(
+                            index, block_max, scorer, subqueries, k, deleted_docs, docids);
+                    });
+                    return run(std::move(query), std::max(t, seeded));
+                };
+            }
+            if (stats_format) {
+                extract_stats(query_fun, queries, thresholds, t, *stats_format, std::cout);
+            } else if (extract) {
+                extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
+            } else if (not arrival_rates.empty()) {
+                op_loadtest(
+                    query_fun, queries, thresholds, type, t, arrival_rates, k, safe, threads);
+            } else {
+                op_perftest(
+                    query_fun,
+                    queries,
+                    thresholds,
+                    type,
+                    t,
+                    2,
+                    k,
+                    safe,
+                    threads,
+                    prometheus_filename ? &prometheus : nullptr);
+            }
+        }
+    });
 }
 
 using wand_raw_index = wand_data<wand_data_raw>;
@@ -306,14 +1035,108 @@ int main(int argc, const char** argv)
     bool safe = false;
     bool quantized = false;
 
-    App<arg::Index, arg::WandData, arg::Query<arg::QueryMode::Ranked>, arg::Algorithm, arg::Scorer, arg::Thresholds>
+    App<arg::Index,
+        arg::WandData,
+        arg::Query<arg::QueryMode::Ranked>,
+        arg::Algorithm,
+        arg::Scorer,
+        arg::Thresholds,
+        arg::Threads,
+        arg::DeletedDocuments,
+        arg::QueryBudget,
+        arg::ClipRatio,
+        arg::DocidRange>
         app{"Benchmarks queries on a given index."};
     app.add_flag("--quantized", quantized, "Quantized scores");
     app.add_flag("--extract", extract, "Extract individual query times");
     app.add_flag("--silent", silent, "Suppress logging");
-    app.add_flag("--safe", safe, "Rerun if not enough results with pruning.")
-        ->needs(app.thresholds_option());
+    std::optional<std::string> term_thresholds_file;
+    app.add_option(
+           "--term-thresholds",
+           term_thresholds_file,
+           "Per-term k-th scores used to estimate query thresholds")
+        ->excludes(app.thresholds_option());
+    app.add_flag("--safe", safe, "Rerun if not enough results with pruning.");
+    uint32_t prefetch_lines = 0;
+    app.add_option(
+        "--prefetch-lines",
+        prefetch_lines,
+        "Cache lines of the next blocks of the lists prefetched by block_max_wand (0 disables)");
+    std::size_t score_memo_entries = 0;
+    app.add_option(
+        "--score-memo",
+        score_memo_entries,
+        "Memoize up to this many term scores across queries, for batches of query variants "
+        "sharing terms (maxscore and block_max_wand; 0 disables)");
+    std::optional<std::string> positions_file;
+    app.add_option("--positions", positions_file, "Positional index, for phrase queries");
+    bool decode_list_endpoints = false;
+    app.add_flag(
+        "--decode-endpoints",
+        decode_list_endpoints,
+        "Decode the positions of all lists into memory, to open lists faster (block indexes)");
+    std::size_t block_cache_mib = 0;
+    app.add_option(
+        "--decoded-block-cache",
+        block_cache_mib,
+        "Share up to this many MiB of decoded blocks of the lists of the most frequent query "
+        "terms across queries and threads (block indexes; 0 disables)");
+    std::optional<std::string> impact_index_file;
+    app.add_option(
+        "--impact-index",
+        impact_index_file,
+        "Impact-ordered index of the longest lists, with the same docids and impacts, processed "
+        "score-at-a-time by planned queries whose lists are all stored (quantized scorer)");
+    std::optional<std::size_t> warmup_terms;
+    app.add_option(
+        "--warmup-terms",
+        warmup_terms,
+        "Warm up only the lists of the N most frequent query terms (default: all query terms)");
+    std::optional<std::string> stats_format;
+    app.add_option(
+           "--stats",
+           stats_format,
+           "Write the traversal counters of each query instead of timing it, as tsv or json "
+           "(requires a build with PISA_ENABLE_QUERY_STATS)")
+        ->check([](std::string const& format) {
+            return format == "tsv" || format == "json" ? std::string()
+                                                       : std::string("Must be tsv or json");
+        })
+        ->excludes("--extract");
+    std::optional<std::string> prometheus_file;
+    app.add_option(
+           "--prometheus",
+           prometheus_file,
+           "Write the latency quantiles of queries and of their phases to a file, in the "
+           "Prometheus text format")
+        ->excludes("--extract")
+        ->excludes("--stats");
+    std::vector<double> arrival_rates;
+    app.add_option(
+           "--arrival-rates",
+           arrival_rates,
+           "Issue queries with Poisson arrivals at each of these rates, in queries per second, "
+           "and report latencies including queueing delays")
+        ->excludes("--extract")
+        ->excludes("--stats")
+        ->excludes("--prometheus");
+    std::size_t conjunctive_subqueries = 0;
+    app.add_option(
+        "--conjunctive-subqueries",
+        conjunctive_subqueries,
+        "Process up to this many conjunctions of query terms with block_max_ranked_and first, "
+        "to start wand, maxscore, block_max_wand, and block_max_maxscore from the highest of "
+        "their k-th scores (0 disables)");
     CLI11_PARSE(app, argc, argv);
+    app.check_index();
+    if (stats_format && not default_query_stats::enabled) {
+        std::cerr << "--stats requires a build with PISA_ENABLE_QUERY_STATS\n";
+        return 1;
+    }
+    if (safe && not app.thresholds_file() && not term_thresholds_file) {
+        std::cerr << "--safe requires --thresholds or --term-thresholds\n";
+        return 1;
+    }
 
     if (silent) {
         spdlog::set_default_logger(spdlog::create<spdlog::sinks::null_sink_mt>("stderr"));
@@ -323,9 +1146,19 @@ int main(int argc, const char** argv)
     if (extract) {
         std::cout << "qid\tusec\n";
     }
+    if (stats_format == "tsv") {
+        std::cout << "query\tqid\t";
+        query_counters::write_tsv_header(std::cout);
+        std::cout << '\n';
+    }
+
+    // Queries run serially unless a thread count is requested explicitly.
+    std::size_t threads = app.threads_option()->count() > 0 ? app.threads() : 1;
+    tbb::task_scheduler_init init(threads);
 
     auto params = std::make_tuple(
         app.index_filename(),
+        app.load_mode(),
         app.wand_data_path(),
         app.queries(),
         app.thresholds_file(),
@@ -334,7 +1167,25 @@ int main(int argc, const char** argv)
         app.k(),
         app.scorer(),
         extract,
-        safe);
+        safe,
+        threads,
+        app.deleted_documents_file(),
+        app.deleted_blocks_file(),
+        term_thresholds_file,
+        app.query_budget(),
+        prefetch_lines,
+        app.clip_ratio(),
+        positions_file,
+        warmup_terms,
+        stats_format,
+        prometheus_file,
+        arrival_rates,
+        app.docids(),
+        score_memo_entries,
+        decode_list_endpoints,
+        block_cache_mib,
+        impact_index_file,
+        conjunctive_subqueries);
     /**/
     if (false) {
 #define LOOP_BODY(R, DATA, T)                                                                        \
@@ -354,6 +1205,9 @@ int main(int argc, const char** argv)
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
 #undef LOOP_BODY
 
+    } else if (app.index_encoding() == "fat_block_simdbp") {
+        // Block-max scores come from the index, the WAND data only provides the scorer statistics.
+        std::apply(perftest<fat_block_simdbp_index, wand_raw_index>, params);
     } else {
         spdlog::error("Unknown type {}", app.index_encoding());
     }
@@ -0,0 +1,510 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <range/v3/view/enumerate.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/task_arena.h>
+
+#include "accumulator/accumulator_pool.hpp"
+#include "accumulator/simple_accumulator.hpp"
+#include "app.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "mappable/residency.hpp"
+#include "mappable/warmup.hpp"
+#include "payload_vector.hpp"
+#include "query/admission_control.hpp"
+#include "query/algorithm.hpp"
+#include "query/term_processor.hpp"
+#include "query/warmup.hpp"
+#include "scorer/scorer.hpp"
+#include "timer.hpp"
+#include "util/line_server.hpp"
+#include "util/numa.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+using ranges::views::enumerate;
+
+struct server_options {
+    std::optional<std::string> terms_file;
+    std::optional<std::string> stopwords_file;
+    std::optional<std::string> stemmer;
+    std::optional<std::string> documents_file;
+    std::optional<std::string> socket_path;
+    std::optional<uint16_t> port;
+    std::string run_id;
+    /// Number of NUMA nodes the index is placed on and queries are run on, or 0 to leave
+    /// placement to the kernel.
+    std::size_t numa_nodes = 0;
+    std::string numa_policy = "replicate";
+    /// Whether to listen right away, leaving the index and WAND data to be read on demand and
+    /// warmed up by a background thread, rather than warming them up before listening.
+    bool lazy_startup = false;
+    /// File recording which parts of the index are resident, read at startup to warm up only
+    /// these parts, and rewritten every `snapshot_interval` seconds.
+    std::optional<std::string> warm_snapshot;
+    std::size_t snapshot_interval = 300;
+    /// Memory, in MiB, that the queries running at once are estimated to use together, beyond
+    /// which queries are downgraded, wait, or are rejected; unlimited if not given.
+    std::optional<std::size_t> memory_budget;
+    /// Number of queries that can wait for memory at once.
+    std::size_t max_waiting = 64;
+    /// Milliseconds a query waits for memory before it is rejected.
+    std::size_t max_wait = 1000;
+};
+
+/// Rewrites the residency snapshot of a mapped index periodically, from a thread of its own,
+/// until it is destroyed.
+class Snapshot_Writer {
+  public:
+    Snapshot_Writer(
+        std::string filename, mapper::mapped_file const& file, std::chrono::seconds interval)
+        : m_thread([this, filename = std::move(filename), &file, interval] {
+              std::unique_lock<std::mutex> lock(m_mutex);
+              while (not m_cv.wait_for(lock, interval, [this] { return m_stopped; })) {
+                  auto ranges = mapper::resident_ranges(file.data(), file.size());
+                  try {
+                      mapper::write_residency_snapshot(filename, file.size(), ranges);
+                      spdlog::debug("Wrote {} resident ranges to {}", ranges.size(), filename);
+                  } catch (std::runtime_error const& error) {
+                      spdlog::warn("{}", error.what());
+                  }
+              }
+          })
+    {}
+    Snapshot_Writer(Snapshot_Writer const&) = delete;
+    Snapshot_Writer(Snapshot_Writer&&) = delete;
+    Snapshot_Writer& operator=(Snapshot_Writer const&) = delete;
+    Snapshot_Writer& operator=(Snapshot_Writer&&) = delete;
+    ~Snapshot_Writer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopped = false;
+    std::thread m_thread;
+};
+
+/// Returns whether a query made of term IDs can be parsed without errors.
+[[nodiscard]] auto valid_query_ids(std::string const& request) -> bool
+{
+    auto raw_query = split_query_at_colon(request).second;
+    return std::all_of(raw_query.begin(), raw_query.end(), [](char c) {
+        return std::isdigit(c) || std::isspace(c);
+    });
+}
+
+template <typename IndexType, typename WandType>
+void serve(
+    std::string const& index_filename,
+    mapper::load_mode load_mode,
+    std::string const& wand_data_filename,
+    std::string const& query_type,
+    uint64_t k,
+    std::string const& scorer_name,
+    std::size_t threads,
+    server_options const& options)
+{
+    IndexType mapped_index;
+    spdlog::info("Loading index from {}", index_filename);
+    mapper::mapped_file m(index_filename, load_mode);
+    mapper::map(mapped_index, m);
+
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md, options.lazy_startup ? 0 : mapper::map_flags::warmup);
+    std::thread warmer;
+
+    // Queries sent to node `n` run on its CPUs with `node_indexes[n]`.
+    auto nodes = numa::node_cpus();
+    std::vector<numa::replica> replicas;
+    std::vector<std::unique_ptr<IndexType>> replica_indexes;
+    std::vector<IndexType const*> node_indexes{&mapped_index};
+    if (options.numa_nodes > 0) {
+        nodes.resize(std::min(nodes.size(), options.numa_nodes));
+        auto policy = numa::parse_policy(options.numa_policy);
+        spdlog::info("Placing the index on {} NUMA nodes ({})", nodes.size(), options.numa_policy);
+        if (policy == numa::policy::replicate) {
+            for (auto const& cpus: nodes) {
+                replicas.push_back(numa::replica::on_node(m.data(), m.size(), cpus));
+            }
+        } else {
+            replicas.push_back(numa::replica::interleaved(m.data(), m.size(), nodes.size()));
+        }
+        node_indexes.clear();
+        for (std::size_t node = 0; node < nodes.size(); ++node) {
+            auto const& memory = replicas[std::min(node, replicas.size() - 1)];
+            replica_indexes.push_back(std::make_unique<IndexType>());
+            mapper::map(*replica_indexes.back(), memory.data());
+            node_indexes.push_back(replica_indexes.back().get());
+        }
+    } else {
+        nodes.resize(1);
+        std::optional<mapper::byte_ranges> snapshot;
+        if (options.warm_snapshot) {
+            snapshot = mapper::read_residency_snapshot(*options.warm_snapshot, m.size());
+            if (not snapshot) {
+                spdlog::warn("No residency snapshot of this index in {}", *options.warm_snapshot);
+            }
+        }
+        if (snapshot) {
+            // The parts of the index that were hot before the restart are read first, with all
+            // threads, since they are what the first queries need.
+            spdlog::info("Warming up {} ranges of the residency snapshot", snapshot->size());
+            mapper::warmup_ranges(m.data(), m.size(), *snapshot);
+        }
+        if (options.lazy_startup) {
+            // A single thread, so that the warmup leaves the CPUs to the queries; the pages
+            // it has not reached yet are read on first access.
+            warmer = std::thread([&] {
+                spdlog::info("Warming up WAND data and posting lists in the background");
+                tbb::task_arena(1).execute([&] { mapper::warmup_memory(md.data(), md.size()); });
+                warmup_lists(mapped_index, 1);
+                spdlog::info("Warmup done");
+            });
+        } else if (not snapshot) {
+            spdlog::info("Warming up posting lists");
+            warmup_lists(mapped_index);
+        }
+    }
+    std::optional<Snapshot_Writer> snapshot_writer;
+    if (options.warm_snapshot) {
+        snapshot_writer.emplace(
+            *options.warm_snapshot, m, std::chrono::seconds(options.snapshot_interval));
+    }
+
+    std::optional<TermProcessor> term_processor;
+    if (options.terms_file) {
+        term_processor.emplace(options.terms_file, options.stopwords_file, options.stemmer);
+    }
+    std::shared_ptr<mio::mmap_source> documents_source;
+    std::optional<Payload_Vector<>> docmap;
+    if (options.documents_file) {
+        documents_source = std::make_shared<mio::mmap_source>(options.documents_file->c_str());
+        docmap = Payload_Vector<>::from(*documents_source);
+    }
+
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        using result_type = std::vector<std::pair<float, uint64_t>>;
+        std::function<result_type(IndexType const&, Query)> query_fun;
+        // Run instead of `query_fun` when it does not fit in the memory budget, using less memory.
+        std::function<result_type(IndexType const&, Query)> fallback_fun;
+        std::size_t accumulator_bytes = 0;
+        Accumulator_Pool<Simple_Accumulator> accumulators(mapped_index.num_docs());
+
+        if (query_type == "wand") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                wand_query wand_q(topk);
+                wand_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "block_max_wand") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                block_max_wand_query block_max_wand_q(topk);
+                block_max_wand_q(
+                    make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "block_max_maxscore") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                block_max_maxscore_query block_max_maxscore_q(topk);
+                block_max_maxscore_q(
+                    make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "block_max_ranked_and") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                block_max_ranked_and_query block_max_ranked_and_q(topk);
+                block_max_ranked_and_q(
+                    make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_and") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                ranked_and_query ranked_and_q(topk);
+                ranked_and_q(make_scored_cursors(index, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                ranked_or_query ranked_or_q(topk);
+                ranked_or_q(make_scored_cursors(index, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "maxscore") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                maxscore_query maxscore_q(topk);
+                maxscore_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else if (query_type == "ranked_or_taat") {
+            query_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                auto accumulator = accumulators.acquire();
+                ranked_or_taat_q(
+                    make_scored_cursors(index, scorer, query), index.num_docs(), *accumulator);
+                topk.finalize();
+                return topk.topk();
+            };
+            accumulator_bytes = mapped_index.num_docs() * sizeof(float);
+            fallback_fun = [&](IndexType const& index, Query query) {
+                topk_queue topk(k);
+                maxscore_query maxscore_q(topk);
+                maxscore_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else {
+            spdlog::error("Unsupported query type: {}", query_type);
+            return;
+        }
+
+        // Connections are served by their own threads, but queries are only ever processed
+        // by at most `threads` of them at a time, split evenly over the nodes. Requests are
+        // sent to the nodes in turn, and run on a thread pinned to the CPUs of their node.
+        std::vector<std::unique_ptr<tbb::task_arena>> arenas;
+        for (std::size_t node = 0; node < nodes.size(); ++node) {
+            arenas.push_back(std::make_unique<tbb::task_arena>(
+                std::max<int>(1, static_cast<int>(threads / nodes.size()))));
+        }
+        std::atomic_size_t next_node{0};
+        auto run_on_node = [&](std::size_t node, Query const& query, auto const& fun) {
+            thread_local std::optional<std::size_t> pinned_node;
+            if (options.numa_nodes > 0 && pinned_node != node) {
+                numa::pin_thread(nodes[node]);
+                pinned_node = node;
+            }
+            return fun(*node_indexes[node], query);
+        };
+        std::optional<admission_controller> admission;
+        if (options.memory_budget) {
+            spdlog::info(
+                "Admitting queries within {} MiB, with up to {} waiting for {} ms",
+                *options.memory_budget,
+                options.max_waiting,
+                options.max_wait);
+            admission.emplace(
+                *options.memory_budget << 20U,
+                options.max_waiting,
+                std::chrono::milliseconds(options.max_wait));
+        }
+        auto handle_request = [&](std::string const& request) -> std::string {
+            if (not term_processor && not valid_query_ids(request)) {
+                return fmt::format("ERROR\tinvalid query: {}\n", request);
+            }
+            auto query = term_processor ? parse_query_terms(request, *term_processor)
+                                        : parse_query_ids(request);
+            if (std::any_of(query.terms.begin(), query.terms.end(), [&](auto term) {
+                    return term >= mapped_index.size();
+                })) {
+                return fmt::format("ERROR\tunknown term ID: {}\n", request);
+            }
+            // The memory of the query is reserved until it is answered.
+            std::optional<admission_controller::ticket> ticket;
+            auto const* fun = &query_fun;
+            if (admission) {
+                std::optional<std::size_t> fallback_bytes;
+                if (fallback_fun) {
+                    fallback_bytes = estimate_query_memory(query.terms.size(), k);
+                }
+                ticket.emplace(admission->admit(
+                    estimate_query_memory(query.terms.size(), k, accumulator_bytes),
+                    fallback_bytes));
+                if (ticket->decision() == admission_controller::decision::rejected) {
+                    return fmt::format("ERROR\tover memory budget: {}\n", request);
+                }
+                if (ticket->decision() == admission_controller::decision::downgraded) {
+                    spdlog::debug("Query {} downgraded to fit in memory", request);
+                    fun = &fallback_fun;
+                }
+            }
+            result_type results;
+            auto node = next_node.fetch_add(1) % nodes.size();
+            auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
+                arenas[node]->execute([&]() { results = run_on_node(node, query, *fun); });
+            });
+            spdlog::debug("Query {} processed in {} us", request, usecs.count());
+
+            std::string response;
+            auto qid = query.id.value_or("0");
+            for (auto&& [rank, result]: enumerate(results)) {
+                auto document = docmap ? std::string((*docmap)[result.second])
+                                       : std::to_string(result.second);
+                response += fmt::format(
+                    "{}\tQ0\t{}\t{}\t{}\t{}\n", qid, document, rank, result.first, options.run_id);
+            }
+            return response;
+        };
+
+        auto server = options.socket_path ? line_server::unix_socket(*options.socket_path)
+                                          : line_server::tcp(*options.port);
+        if (options.socket_path) {
+            spdlog::info("Listening on {}", *options.socket_path);
+        } else {
+            spdlog::info("Listening on port {}", *options.port);
+        }
+        server.serve(handle_request);
+    });
+    if (warmer.joinable()) {
+        warmer.join();
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    server_options options;
+    options.run_id = "R0";
+    uint64_t k = 0;
+    bool debug = false;
+
+    App<arg::Index, arg::WandData, arg::Algorithm, arg::Scorer, arg::Threads> app{
+        "Serves query results in TREC format over a TCP or a Unix socket."};
+    app.add_option("-k", k, "The number of top results to return")->required();
+    auto* terms = app.add_option("--terms", options.terms_file, "Term lexicon");
+    app.add_option(
+           "--stopwords", options.stopwords_file, "List of blacklisted stop words to filter out")
+        ->needs(terms);
+    app.add_option("--stemmer", options.stemmer, "Stemmer type")->needs(terms);
+    app.add_option("--documents", options.documents_file, "Document lexicon");
+    app.add_option("-r,--run", options.run_id, "Run identifier");
+    auto* listen = app.add_option_group("listen");
+    listen->add_option("--socket", options.socket_path, "Unix socket path");
+    listen->add_option("--port", options.port, "TCP port");
+    listen->require_option(1);
+    app.add_flag("--debug", debug, "Log the processing time of every query");
+    auto* numa_nodes = app.add_option(
+        "--numa-nodes",
+        options.numa_nodes,
+        "Place the index on this many NUMA nodes and pin the query threads to them");
+    app.add_option(
+           "--numa-policy",
+           options.numa_policy,
+           "How the index is placed on the nodes: replicate (a copy per node) or interleave",
+           true)
+        ->check([](std::string const& name) {
+            try {
+                [[maybe_unused]] auto policy = numa::parse_policy(name);
+            } catch (std::invalid_argument const& error) {
+                return std::string(error.what());
+            }
+            return std::string();
+        })
+        ->needs(numa_nodes);
+    app.add_flag(
+        "--lazy-startup",
+        options.lazy_startup,
+        "Listen right away and warm up the index and WAND data in the background");
+    auto* warm_snapshot = app.add_option(
+        "--warm-snapshot",
+        options.warm_snapshot,
+        "Warm up the parts of the index recorded in this file, and record them periodically");
+    warm_snapshot->excludes(numa_nodes);
+    app.add_option(
+           "--snapshot-interval",
+           options.snapshot_interval,
+           "Seconds between two recordings of the resident parts of the index",
+           true)
+        ->needs(warm_snapshot);
+    auto* memory_budget = app.add_option(
+        "--memory-budget",
+        options.memory_budget,
+        "Memory, in MiB, that the queries running at once are estimated to use together");
+    app.add_option(
+           "--max-waiting",
+           options.max_waiting,
+           "Queries that can wait for memory at once, beyond which they are rejected",
+           true)
+        ->needs(memory_budget);
+    app.add_option(
+           "--max-wait",
+           options.max_wait,
+           "Milliseconds a query waits for memory before it is rejected",
+           true)
+        ->needs(memory_budget);
+    CLI11_PARSE(app, argc, argv);
+    app.check_index();
+
+    if (debug) {
+        spdlog::set_level(spdlog::level::debug);
+    }
+    if (not app.wand_data_path()) {
+        spdlog::error("WAND data is required");
+        return 1;
+    }
+    spdlog::info("Number of threads: {}", app.threads());
+
+    auto params = std::make_tuple(
+        app.index_filename(),
+        app.load_mode(),
+        *app.wand_data_path(),
+        app.algorithm(),
+        k,
+        app.scorer(),
+        app.threads(),
+        options);
+
+    /**/
+    if (false) {  // NOLINT
+#define LOOP_BODY(R, DATA, T)                                                             \
+    }                                                                                     \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                               \
+    {                                                                                     \
+        if (app.is_wand_compressed()) {                                                   \
+            std::apply(serve<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);       \
+        } else {                                                                          \
+            std::apply(serve<BOOST_PP_CAT(T, _index), wand_raw_index>, params);           \
+        }                                                                                 \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+}
@@ -1,3 +1,4 @@
+#include <limits>
 #include <numeric>
 #include <optional>
 #include <thread>
@@ -5,9 +6,14 @@
 #include <CLI/CLI.hpp>
 #include <pstl/execution>
 #include <spdlog/spdlog.h>
+#include <tbb/parallel_for_each.h>
 #include <tbb/task_scheduler_init.h>
 
+#include "mappable/mapper.hpp"
+#include "io.hpp"
 #include "payload_vector.hpp"
+#include "query/binary_queries.hpp"
+#include "query/queries.hpp"
 #include "recursive_graph_bisection.hpp"
 #include "util/inverted_index_utils.hpp"
 #include "util/progress.hpp"
@@ -50,6 +56,140 @@ inline void run_default_tree(size_t depth, const range_type& initial_range)
     recursive_graph_bisection(initial_range, depth, depth - 6, bp_progress);
 }
 
+inline size_t default_depth(size_t num_docs)
+{
+    return static_cast<size_t>(std::log2(num_docs) - 5);
+}
+
+/// Runs the first `levels` levels of a bisection of depth `depth` on all documents.
+inline void run_top_levels(size_t depth, size_t levels, const range_type& initial_range)
+{
+    spdlog::info("Top {} levels of a tree with depth {}", levels, depth);
+    pisa::progress bp_progress("Graph bisection", initial_range.size() * levels);
+    bp_progress.update(0);
+    recursive_graph_bisection(initial_range, levels, depth - 6, bp_progress);
+}
+
+/// Runs the remaining levels of `partial` on the subtrees of its shard, and returns their
+/// documents, in order.
+inline std::vector<uint32_t> run_shard(
+    const bp::partial_ordering& partial,
+    const forward_index& fwd,
+    std::vector<double>& gains,
+    std::vector<double> const* term_weights)
+{
+    std::vector<uint32_t> documents(partial.documents.begin(), partial.documents.end());
+    range_type initial_range(documents.begin(), documents.end(), fwd, gains, term_weights);
+    std::vector<range_type> subtrees;
+    bp::collect_subtrees(initial_range, partial.levels, subtrees);
+
+    std::vector<range_type> shard_subtrees;
+    for (size_t subtree = partial.shard; subtree < subtrees.size();
+         subtree += partial.shard_count) {
+        shard_subtrees.push_back(subtrees[subtree]);
+    }
+    size_t remaining_depth = partial.depth - partial.levels;
+    size_t cache_depth = partial.depth - 6;
+    cache_depth = cache_depth > partial.levels ? cache_depth - partial.levels : 0;
+    spdlog::info(
+        "Shard {} of {}: {} subtrees, remaining depth {}",
+        partial.shard,
+        partial.shard_count,
+        shard_subtrees.size(),
+        remaining_depth);
+
+    std::vector<uint32_t> shard_documents;
+    if (remaining_depth > 0) {
+        std::ptrdiff_t total_count = 0;
+        for (auto const& subtree: shard_subtrees) {
+            total_count += subtree.size();
+        }
+        pisa::progress bp_progress("Graph bisection", total_count * remaining_depth);
+        bp_progress.update(0);
+        tbb::parallel_for_each(shard_subtrees.begin(), shard_subtrees.end(), [&](auto subtree) {
+            recursive_graph_bisection(subtree, remaining_depth, cache_depth, bp_progress);
+        });
+    }
+    for (auto subtree: shard_subtrees) {
+        shard_documents.insert(shard_documents.end(), subtree.begin(), subtree.end());
+    }
+    return shard_documents;
+}
+
+/// Returns the ordering of all documents, from the partial orderings of all shards.
+inline std::vector<uint32_t> merge_shards(std::vector<std::string> const& shard_filenames)
+{
+    std::vector<uint32_t> documents;
+    std::vector<range_type> subtrees;
+    std::vector<double> gains;
+    std::vector<bool> merged_shards(shard_filenames.size(), false);
+    forward_index no_index;
+    for (auto const& filename: shard_filenames) {
+        bp::partial_ordering partial;
+        mapper::mapped_file source(filename);
+        mapper::map(partial, source);
+        if (partial.shard_count == 0) {
+            throw std::invalid_argument(filename + " must be continued with --partial first");
+        }
+        if (partial.shard_count != shard_filenames.size()) {
+            throw std::invalid_argument(fmt::format(
+                "{} is one of {} shards, but {} were given",
+                filename,
+                partial.shard_count,
+                shard_filenames.size()));
+        }
+        if (partial.shard >= partial.shard_count or merged_shards[partial.shard]) {
+            throw std::invalid_argument(fmt::format("{} repeats shard {}", filename, partial.shard));
+        }
+        merged_shards[partial.shard] = true;
+        if (documents.empty()) {
+            // Only the boundaries of the subtrees are needed, which depend on their sizes.
+            documents.resize(partial.num_docs);
+            range_type initial_range(documents.begin(), documents.end(), no_index, gains);
+            bp::collect_subtrees(initial_range, partial.levels, subtrees);
+        }
+        if (partial.num_docs != documents.size()) {
+            throw std::invalid_argument(filename + " is a shard of another collection");
+        }
+        auto shard_document = partial.documents.begin();
+        for (size_t subtree = partial.shard; subtree < subtrees.size();
+             subtree += partial.shard_count) {
+            if (std::distance(shard_document, partial.documents.end()) < subtrees[subtree].size()) {
+                throw std::invalid_argument(filename + " misses documents of its subtrees");
+            }
+            auto next = std::next(shard_document, subtrees[subtree].size());
+            std::copy(shard_document, next, subtrees[subtree].begin());
+            shard_document = next;
+        }
+    }
+    return documents;
+}
+
+/// Returns the number of times each of the `term_count` terms occurs in the queries of
+/// `filename`, either a binary query file written by `map_queries` or a file of term IDs.
+inline std::vector<std::size_t>
+query_log_frequencies(std::string const& filename, std::size_t term_count)
+{
+    std::vector<Query> queries;
+    if (binary_queries::is_binary_query_file(filename)) {
+        queries = binary_queries(filename).to_queries();
+    } else {
+        std::ifstream is(filename);
+        io::for_each_line(
+            is, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+    }
+    std::vector<std::size_t> frequencies(term_count, 0);
+    for (auto const& query: queries) {
+        for (auto term: query.terms) {
+            if (term < term_count) {
+                frequencies[term] += 1;
+            }
+        }
+    }
+    spdlog::info("Weighting terms by {} queries", queries.size());
+    return frequencies;
+}
+
 int main(int argc, char const* argv[])
 {
     std::string input_basename;
@@ -59,8 +199,17 @@ int main(int argc, char const* argv[])
     std::string config_file;
     std::optional<std::string> documents_filename;
     std::optional<std::string> reordered_documents_filename;
+    std::string input_partial;
+    std::string output_partial;
+    std::vector<std::string> shard_filenames;
+    std::optional<std::string> query_log;
+    double query_weight = 10.0;
+    std::optional<double> impact_fraction;
     size_t min_len = 0;
     size_t depth = 0;
+    size_t top_levels = 0;
+    size_t shard = 0;
+    size_t shard_count = 1;
     size_t threads = std::thread::hardware_concurrency();
     bool nogb = false;
     bool print = false;
@@ -80,48 +229,162 @@ int main(int argc, char const* argv[])
     auto optconf = app.add_option("--config", config_file, "Node configuration file");
     app.add_flag("--nogb", nogb, "No VarIntGB compression in forward index");
     app.add_flag("-p,--print", print, "Print ordering to standard output");
+    auto opttop = app.add_option(
+        "--top-levels",
+        top_levels,
+        "Run only this many levels on all documents, and store the ordering with "
+        "--store-partial, to be continued in shards with --partial");
+    auto optpartial = app.add_option(
+        "--partial",
+        input_partial,
+        "Continue the ordering stored by --top-levels on the subtrees of --shard, and store "
+        "them with --store-partial");
+    app.add_option("--shard", shard, "Shard to continue with --partial, from 0")->needs(optpartial);
+    app.add_option("--shards", shard_count, "Number of shards of --partial")
+        ->needs(optpartial)
+        ->check(CLI::Range(size_t(1), std::numeric_limits<size_t>::max()));
+    auto optstore = app.add_option(
+        "--store-partial", output_partial, "Output file (partial ordering)");
+    auto optmerge = app.add_option(
+        "--merge-shards",
+        shard_filenames,
+        "Merge the orderings stored by --partial for each of the shards, in any order");
+    auto optquerylog = app.add_option(
+        "--query-log",
+        query_log,
+        "Weight the cost of each term by its frequency in these queries of term IDs");
+    app.add_option(
+           "--query-weight",
+           query_weight,
+           "Weight of the most frequent term of --query-log over unqueried terms, minus 1",
+           true)
+        ->needs(optquerylog);
+    app.add_option(
+           "--impact-fraction",
+           impact_fraction,
+           "Co-cluster the documents of this fraction of the most frequent postings of each term "
+           "of --query-log")
+        ->needs(optquerylog)
+        ->check(CLI::Range(0.0, 1.0));
     optconf->excludes(optdepth);
+    opttop->needs(optstore)->excludes(optconf);
+    optpartial->needs(optstore)->excludes(opttop)->excludes(optconf)->excludes(optdepth);
+    optmerge->excludes(opttop)->excludes(optpartial)->excludes(optconf)->excludes(optdepth);
     CLI11_PARSE(app, argc, argv);
 
     bool config_provided = app.count("--config") > 0u;
     bool depth_provided = app.count("--depth") > 0u;
     bool output_provided = app.count("--output") > 0u;
-    if (app.count("--output") + app.count("--store-fwdidx") == 0u) {
+    if (app.count("--output") + app.count("--store-fwdidx") + app.count("--store-partial") == 0u) {
         spdlog::error("Must define at least one output parameter.");
         return 1;
     }
+    if (shard >= shard_count) {
+        spdlog::error("Shard {} out of {} shards", shard, shard_count);
+        return 1;
+    }
 
     tbb::task_scheduler_init init(threads);
     spdlog::info("Number of threads: {}", threads);
 
-    forward_index fwd = app.count("--fwdidx") > 0u
-        ? forward_index::read(input_fwd)
-        : forward_index::from_inverted_index(input_basename, min_len, not nogb);
-    if (app.count("--store-fwdidx") > 0u) {
-        forward_index::write(fwd, output_fwd);
-    }
+    std::vector<uint32_t> documents;
+    if (not shard_filenames.empty()) {
+        if (not output_provided) {
+            spdlog::error("Must define --output to merge shards.");
+            return 1;
+        }
+        documents = merge_shards(shard_filenames);
+    } else {
+        forward_index fwd = app.count("--fwdidx") > 0u
+            ? forward_index::read(input_fwd)
+            : forward_index::from_inverted_index(input_basename, min_len, not nogb);
+        if (app.count("--store-fwdidx") > 0u) {
+            forward_index::write(fwd, output_fwd);
+        }
+        if (not output_provided and output_partial.empty()) {
+            return 0;
+        }
+
+        std::vector<double> term_weights;
+        if (query_log) {
+            auto term_count = fwd.term_count();
+            term_weights = bp::query_term_weights(
+                query_log_frequencies(*query_log, term_count), term_count, query_weight);
+            if (impact_fraction) {
+                binary_freq_collection collection(input_basename.c_str());
+                fwd = bp::add_impact_terms(fwd, collection, term_weights, *impact_fraction);
+                spdlog::info("Added {} impact terms", fwd.term_count() - term_count);
+            }
+        }
+        auto const* weights = term_weights.empty() ? nullptr : &term_weights;
 
-    if (output_provided) {
-        std::vector<uint32_t> documents(fwd.size());
-        std::iota(documents.begin(), documents.end(), 0u);
         std::vector<double> gains(fwd.size(), 0.0);
-        range_type initial_range(documents.begin(), documents.end(), fwd, gains);
+        if (not input_partial.empty()) {
+            bp::partial_ordering partial;
+            mapper::mapped_file source(input_partial);
+            mapper::map(partial, source);
+            if (partial.shard_count != 0) {
+                spdlog::error("{} is already a shard", input_partial);
+                return 1;
+            }
+            if (partial.num_docs != fwd.size()) {
+                spdlog::error("{} is the ordering of another collection", input_partial);
+                return 1;
+            }
+            partial.shard = shard;
+            partial.shard_count = shard_count;
+            auto shard_documents = run_shard(partial, fwd, gains, weights);
+            partial.documents.steal(shard_documents);
+            mapper::freeze(partial, output_partial.c_str());
+            return 0;
+        }
+
+        documents.resize(fwd.size());
+        std::iota(documents.begin(), documents.end(), 0u);
+        range_type initial_range(documents.begin(), documents.end(), fwd, gains, weights);
 
         if (config_provided) {
             run_with_config(config_file, initial_range);
         } else {
-            run_default_tree(
-                depth_provided ? depth : static_cast<size_t>(std::log2(fwd.size()) - 5),
-                initial_range);
+            if (not depth_provided) {
+                depth = default_depth(fwd.size());
+            }
+            if (app.count("--top-levels") > 0u) {
+                std::vector<range_type> subtrees;
+                bp::collect_subtrees(initial_range, top_levels, subtrees);
+                if (top_levels >= depth
+                    or std::accumulate(
+                           subtrees.begin(),
+                           subtrees.end(),
+                           std::ptrdiff_t(0),
+                           [](auto acc, auto const& subtree) { return acc + subtree.size(); })
+                        != initial_range.size()) {
+                    spdlog::error(
+                        "Top levels must be fewer than the depth, {}, and leave subtrees of "
+                        "more than 2 documents",
+                        depth);
+                    return 1;
+                }
+                run_top_levels(depth, top_levels, initial_range);
+                bp::partial_ordering partial;
+                partial.depth = depth;
+                partial.levels = top_levels;
+                partial.num_docs = documents.size();
+                partial.documents.steal(documents);
+                mapper::freeze(partial, output_partial.c_str());
+                return 0;
+            }
+            run_default_tree(depth, initial_range);
         }
+    }
 
+    if (output_provided) {
         if (print) {
             for (const auto& document: documents) {
                 std::cout << document << '\n';
             }
         }
         auto mapping = get_mapping(documents);
-        fwd.clear();
         documents.clear();
         reorder_inverted_index(input_basename, output_basename, mapping);
 
@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <optional>
 #include <random>
 #include <string>
 #include <unordered_set>
@@ -7,6 +9,8 @@
 #include "CLI/CLI.hpp"
 #include "binary_freq_collection.hpp"
 #include "invert.hpp"
+#include "io.hpp"
+#include "payload_vector.hpp"
 #include "util/inverted_index_utils.hpp"
 #include "util/progress.hpp"
 
@@ -18,7 +22,9 @@ int main(int argc, char** argv)
     std::string output_basename;
     std::string type;
     std::string terms_to_drop_filename;
+    std::optional<std::string> terms_filename;
     float rate;
+    std::size_t strata = 100;
     unsigned seed = std::random_device{}();
 
     CLI::App app{"A tool for sampling an inverted index."};
@@ -26,11 +32,24 @@ int main(int argc, char** argv)
     app.add_option("-o,--output", output_basename, "Output collection basename")->required();
     app.add_option("-r,--rate", rate, "Sampling rate (proportional size of the output index)")
         ->required();
-    app.add_option("-t,--type", type, "Sampling type")->required();
+    app.add_option(
+           "-t,--type",
+           type,
+           "Sampling type: random_postings, random_docids, or stratified_docids")
+        ->required();
+    app.add_option(
+        "--strata",
+        strata,
+        "Number of equal docid ranges sampled at the same rate by stratified_docids",
+        true);
     app.add_option(
         "--terms-to-drop",
         terms_to_drop_filename,
         "A filename containing a list of term IDs that we want to drop");
+    app.add_option(
+        "--terms",
+        terms_filename,
+        "Terms of the input collection, to write the term lexicon of the sample");
     app.add_option("--seed", seed, "Seed state");
     CLI11_PARSE(app, argc, argv);
 
@@ -55,24 +74,30 @@ int main(int argc, char** argv)
 
             return sample;
         };
-    } else if (type == "random_docids") {
+    } else if (type == "random_docids" or type == "stratified_docids") {
         binary_freq_collection input(input_basename.c_str());
         auto num_docs = input.num_docs();
-        size_t sample_size = std::ceil(num_docs * rate);
-        spdlog::info("Taking {}/{}.", sample_size, num_docs);
-        std::vector<std::uint32_t> indices(num_docs);
-        std::iota(indices.begin(), indices.end(), 0);
-        std::vector<std::uint32_t> sampled_indices;
-        std::sample(
-            indices.begin(),
-            indices.end(),
-            std::back_inserter(sampled_indices),
-            sample_size,
-            std::mt19937{seed});
-        std::vector<bool> doc_ids(num_docs);
-        for (auto&& p: sampled_indices) {
-            doc_ids[p] = true;
+        std::vector<bool> doc_ids;
+        if (type == "stratified_docids") {
+            doc_ids = sample_docids_stratified(num_docs, rate, strata, seed);
+        } else {
+            size_t sample_size = std::ceil(num_docs * rate);
+            std::vector<std::uint32_t> indices(num_docs);
+            std::iota(indices.begin(), indices.end(), 0);
+            std::vector<std::uint32_t> sampled_indices;
+            std::sample(
+                indices.begin(),
+                indices.end(),
+                std::back_inserter(sampled_indices),
+                sample_size,
+                std::mt19937{seed});
+            doc_ids.resize(num_docs);
+            for (auto&& p: sampled_indices) {
+                doc_ids[p] = true;
+            }
         }
+        auto sample_size = std::count(doc_ids.begin(), doc_ids.end(), true);
+        spdlog::info("Taking {}/{}.", sample_size, num_docs);
 
         sampling_fn = [=](const auto& docs) {
             std::vector<std::uint32_t> sample;
@@ -94,5 +119,20 @@ int main(int argc, char** argv)
         dropped_terms_file << id << std::endl;
     }
 
+    // Dropped terms have no list in the sample, so the IDs of the terms after them are shifted.
+    if (terms_filename) {
+        auto terms = io::read_string_vector(*terms_filename);
+        std::vector<std::string> sample_terms;
+        std::ofstream terms_file(output_basename + ".terms");
+        for (size_t term = 0; term < terms.size(); ++term) {
+            if (terms_to_drop.find(term) == terms_to_drop.end()) {
+                terms_file << terms[term] << '\n';
+                sample_terms.push_back(std::move(terms[term]));
+            }
+        }
+        encode_payload_vector(gsl::span<std::string const>(sample_terms))
+            .to_file(output_basename + ".termlex");
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -16,11 +16,14 @@ using namespace pisa;
 
 template <typename IndexType>
 void selective_queries(
-    const std::string& index_filename, std::string const& encoding, std::vector<Query> const& queries)
+    const std::string& index_filename,
+    mapper::load_mode load_mode,
+    std::string const& encoding,
+    std::vector<Query> const& queries)
 {
     IndexType index;
     spdlog::info("Loading index from {}", index_filename);
-    mio::mmap_source m(index_filename.c_str());
+    mapper::mapped_file m(index_filename, load_mode);
     mapper::map(index, m, mapper::map_flags::warmup);
 
     spdlog::info("Performing {} queries", encoding);
@@ -45,6 +48,7 @@ int main(int argc, const char** argv)
     App<arg::Index, arg::Query<arg::QueryMode::Unranked>> app{
         "Filters selective queries for a given index."};
     CLI11_PARSE(app, argc, argv);
+    app.check_index();
 
     if (false) {
 #define LOOP_BODY(R, DATA, T)                               \
@@ -52,7 +56,7 @@ int main(int argc, const char** argv)
     else if (app.index_encoding() == BOOST_PP_STRINGIZE(T)) \
     {                                                       \
         selective_queries<BOOST_PP_CAT(T, _index)>(         \
-            app.index_filename(), app.index_encoding(), app.queries());
+            app.index_filename(), app.load_mode(), app.index_encoding(), app.queries());
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
@@ -0,0 +1,289 @@
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <range/v3/view/enumerate.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "erased_index.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "query/algorithm.hpp"
+#include "query/shard_broker.hpp"
+#include "query/shard_selection.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+using ranges::views::enumerate;
+
+struct broker_options {
+    std::string index_basename;
+    std::string wand_basename;
+    std::string terms_basename;
+    std::string documents_basename;
+    std::size_t shard_count = 0;
+    std::optional<std::string> stopwords;
+    std::optional<std::string> stemmer;
+    std::optional<std::string> global_stats_basename;
+    std::optional<std::string> csi_filename;
+    std::string csi_wand_filename;
+    std::string csi_terms_filename;
+    std::string document_shards_filename;
+    shard_selection selection;
+};
+
+template <typename IndexType, typename WandType>
+void sharded_queries(
+    broker_options const& options,
+    std::vector<std::string> const& queries,
+    std::string const& query_type,
+    uint64_t k,
+    std::string const& scorer_name,
+    std::string const& run_id,
+    std::string const& iteration)
+{
+    shard_broker<IndexType, WandType> broker(
+        options.index_basename,
+        options.wand_basename,
+        options.terms_basename,
+        options.documents_basename,
+        options.shard_count,
+        options.stopwords,
+        options.stemmer,
+        options.global_stats_basename);
+
+    std::optional<central_sample_index<IndexType, WandType>> csi;
+    if (options.csi_filename) {
+        csi.emplace(
+            *options.csi_filename,
+            options.csi_wand_filename,
+            options.csi_terms_filename,
+            options.document_shards_filename,
+            options.stopwords,
+            options.stemmer);
+        if (csi->selector().shard_count() > broker.shard_count()) {
+            spdlog::error(
+                "Documents are assigned to {} shards, but only {} are loaded",
+                csi->selector().shard_count(),
+                broker.shard_count());
+            return;
+        }
+    }
+
+    std::size_t selected_shards = 0;
+    auto run = [&](auto&& query_alg) {
+        for (auto&& [idx, query_string]: enumerate(queries)) {
+            auto query_fn = [&](auto const& index, auto const& wdata, Query query, auto& topk) {
+                scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+                    query_alg(index, wdata, scorer, query, topk);
+                });
+            };
+            std::vector<shard_result> results;
+            if (csi) {
+                auto shards = csi->select(query_string, options.selection, query_fn);
+                selected_shards += shards.size();
+                results = broker(query_string, k, query_fn, shards);
+            } else {
+                selected_shards += broker.shard_count();
+                results = broker(query_string, k, query_fn);
+            }
+            auto qid = split_query_at_colon(query_string).first;
+            for (auto&& [rank, result]: enumerate(results)) {
+                std::cout << fmt::format(
+                    "{}\t{}\t{}\t{}\t{}\t{}\n",
+                    qid.value_or(std::to_string(idx)),
+                    iteration,
+                    broker.document(result),
+                    rank,
+                    result.score,
+                    run_id);
+            }
+        }
+    };
+
+    auto start_batch = std::chrono::steady_clock::now();
+    if (query_type == "wand") {
+        run([](auto const& index, auto const& wdata, auto const& scorer, Query query, auto& topk) {
+            wand_query wand_q(topk);
+            wand_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (query_type == "block_max_wand") {
+        run([](auto const& index, auto const& wdata, auto const& scorer, Query query, auto& topk) {
+            block_max_wand_query block_max_wand_q(topk);
+            block_max_wand_q(
+                make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (query_type == "block_max_maxscore") {
+        run([](auto const& index, auto const& wdata, auto const& scorer, Query query, auto& topk) {
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            block_max_maxscore_q(
+                make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (query_type == "maxscore") {
+        run([](auto const& index, auto const& wdata, auto const& scorer, Query query, auto& topk) {
+            maxscore_query maxscore_q(topk);
+            maxscore_q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (query_type == "ranked_or") {
+        run([](auto const& index, auto const&, auto const& scorer, Query query, auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), index.num_docs());
+        });
+    } else {
+        spdlog::error("Unsupported query type: {}", query_type);
+        return;
+    }
+    auto end_batch = std::chrono::steady_clock::now();
+    double batch_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_batch - start_batch).count();
+    spdlog::info("Time taken to process queries: {}ms", batch_ms);
+    if (not queries.empty()) {
+        spdlog::info(
+            "Average number of shards per query: {}",
+            static_cast<double>(selected_shards) / queries.size());
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    broker_options options;
+    std::string encoding;
+    std::string algorithm;
+    std::string scorer_name;
+    std::optional<std::string> query_file;
+    uint64_t k = 0;
+    bool compressed_wand = false;
+    std::string run_id = "R0";
+    std::size_t threads = std::thread::hardware_concurrency();
+
+    CLI::App app{"Retrieves query results in TREC format from a sharded collection."};
+    app.add_option(
+           "-e,--encoding",
+           encoding,
+           "Index encoding, or mixed to read the encoding of each shard from its header")
+        ->required();
+    app.add_option("-i,--index", options.index_basename, "Basename of the shard indexes")
+        ->required();
+    app.add_option("-w,--wand", options.wand_basename, "Basename of the shard WAND data")
+        ->required();
+    app.add_flag("--compressed-wand", compressed_wand, "Compressed WAND data files");
+    app.add_option("--terms", options.terms_basename, "Basename of the shard term lexicons")
+        ->required();
+    app.add_option(
+           "--documents", options.documents_basename, "Basename of the shard document lexicons")
+        ->required();
+    app.add_option("--shards", options.shard_count, "Number of shards")->required();
+    app.add_option(
+        "--stopwords", options.stopwords, "List of blacklisted stop words to filter out");
+    app.add_option("--stemmer", options.stemmer, "Stemmer type");
+    app.add_option(
+        "--global-stats",
+        options.global_stats_basename,
+        "Basename of the global statistics of the shards, to score all shards alike");
+    std::string selection_method = "redde";
+    auto csi_option = app.add_option(
+        "--csi",
+        options.csi_filename,
+        "Central sample index, used to send each query only to the shards it selects");
+    app.add_option("--csi-wand", options.csi_wand_filename, "WAND data of the sample index")
+        ->needs(csi_option);
+    app.add_option("--csi-terms", options.csi_terms_filename, "Term lexicon of the sample index")
+        ->needs(csi_option);
+    app.add_option(
+           "--document-shards",
+           options.document_shards_filename,
+           "Shard of each document, as written to `.shards` by `partition_fwd_index`")
+        ->needs(csi_option);
+    app.add_option("--selection", selection_method, "Shard selection method: redde or rank_s")
+        ->needs(csi_option);
+    app.add_option(
+           "--selected-shards",
+           options.selection.max_shards,
+           "Maximum number of shards a query is sent to (0 for no limit)")
+        ->needs(csi_option);
+    app.add_option(
+           "--csi-depth",
+           options.selection.depth,
+           "Number of results of the sample index used to select shards")
+        ->needs(csi_option);
+    app.add_option("--rank-s-base", options.selection.rank_s_base, "Base of Rank-S votes")
+        ->needs(csi_option);
+    app.add_option(
+           "--rank-s-threshold", options.selection.rank_s_threshold, "Threshold of Rank-S votes")
+        ->needs(csi_option);
+    app.add_option("-q,--queries", query_file, "Path to file with queries", false);
+    app.add_option("-k", k, "The number of top results to return")->required();
+    app.add_option("-a,--algorithm", algorithm, "Query processing algorithm")->required();
+    app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
+    app.add_option("-r,--run", run_id, "Run identifier");
+    app.add_option("--threads", threads, "Number of threads");
+    CLI11_PARSE(app, argc, argv);
+
+    if (options.csi_filename
+        && (options.csi_wand_filename.empty() || options.csi_terms_filename.empty()
+            || options.document_shards_filename.empty())) {
+        spdlog::error("--csi requires --csi-wand, --csi-terms, and --document-shards");
+        return 1;
+    }
+    try {
+        options.selection.method = parse_shard_selection_method(selection_method);
+    } catch (std::invalid_argument const& err) {
+        spdlog::error(err.what());
+        return 1;
+    }
+
+    tbb::task_scheduler_init init(threads);
+    spdlog::info("Number of threads: {}", threads);
+
+    std::vector<std::string> queries;
+    auto push_query = [&](std::string const& line) { queries.push_back(line); };
+    if (query_file) {
+        std::ifstream is(*query_file);
+        io::for_each_line(is, push_query);
+    } else {
+        io::for_each_line(std::cin, push_query);
+    }
+
+    auto params = std::make_tuple(options, queries, algorithm, k, scorer_name, run_id, "Q0");
+
+    /**/
+    if (encoding == "mixed") {
+        if (compressed_wand) {
+            std::apply(sharded_queries<Erased_Index, wand_uniform_index>, params);
+        } else {
+            std::apply(sharded_queries<Erased_Index, wand_raw_index>, params);
+        }
+#define LOOP_BODY(R, DATA, T)                                                             \
+    }                                                                                     \
+    else if (encoding == BOOST_PP_STRINGIZE(T))                                           \
+    {                                                                                     \
+        if (compressed_wand) {                                                            \
+            std::apply(                                                                   \
+                sharded_queries<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);    \
+        } else {                                                                          \
+            std::apply(sharded_queries<BOOST_PP_CAT(T, _index), wand_raw_index>, params); \
+        }                                                                                 \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", encoding);
+    }
+}
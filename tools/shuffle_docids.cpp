@@ -82,31 +82,7 @@ int main(int argc, const char** argv)
         emit(output_sizes, new_sizes.data(), num_docs);
     }
 
-    pisa::progress progress("Shuffling posting lists", input.size());
-
-    std::ofstream output_docs(output_basename + ".docs");
-    std::ofstream output_freqs(output_basename + ".freqs");
-    emit(output_docs, 1);
-    emit(output_docs, num_docs);
-
-    std::vector<std::pair<uint32_t, uint32_t>> pl;
-    for (const auto& seq: input) {
-        for (size_t i = 0; i < seq.docs.size(); ++i) {
-            pl.emplace_back(mapping[seq.docs.begin()[i]], seq.freqs.begin()[i]);
-        }
-
-        std::sort(pl.begin(), pl.end());
-
-        emit(output_docs, pl.size());
-        emit(output_freqs, pl.size());
-        for (const auto& posting: pl) {
-            emit(output_docs, posting.first);
-            emit(output_freqs, posting.second);
-        }
-
-        progress.update(1);
-        pl.clear();
-    }
+    reorder_postings(input_basename, output_basename, mapping);
     if (documents_filename) {
         auto doc_buffer = Payload_Vector_Buffer::from_file(*documents_filename);
         auto documents = Payload_Vector<std::string>(doc_buffer);
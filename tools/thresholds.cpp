@@ -1,13 +1,21 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <tuple>
+#include <vector>
 
 #include <CLI/CLI.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <fmt/format.h>
 #include <mio/mmap.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
 
 #include "app.hpp"
 #include "cursor/max_scored_cursor.hpp"
@@ -16,6 +24,8 @@
 #include "mappable/mapper.hpp"
 #include "query/algorithm.hpp"
 #include "scorer/scorer.hpp"
+#include "term_thresholds.hpp"
+#include "topk_queue.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
@@ -25,15 +35,18 @@ using namespace pisa;
 template <typename IndexType, typename WandType>
 void thresholds(
     const std::string& index_filename,
+    mapper::load_mode load_mode,
     const std::optional<std::string>& wand_data_filename,
     const std::vector<Query>& queries,
     std::string const& type,
     std::string const& scorer_name,
-    uint64_t k,
-    bool quantized)
+    std::vector<uint64_t> const& ks,
+    bool quantized,
+    std::optional<std::string> const& term_thresholds_filename,
+    std::optional<std::string> const& output_basename)
 {
     IndexType index;
-    mio::mmap_source m(index_filename.c_str());
+    mapper::mapped_file m(index_filename, load_mode);
     mapper::map(index, m);
 
     WandType wdata;
@@ -50,18 +63,43 @@ void thresholds(
         }
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
-    topk_queue topk(k);
-    wand_query wand_q(topk);
-    for (auto const& query: queries) {
+    term_thresholds estimates;
+    mio::mmap_source mt;
+    if (term_thresholds_filename) {
+        mt.map(*term_thresholds_filename);
+        mapper::map(estimates, mt);
+    }
+
+    // The top results for the largest k give the k-th scores of all smaller ones.
+    uint64_t max_k = *std::max_element(ks.begin(), ks.end());
+    std::vector<std::vector<float>> thresholds(ks.size(), std::vector<float>(queries.size()));
+    tbb::enumerable_thread_specific<topk_queue> thread_topk(max_k);
+    tbb::parallel_for(size_t(0), queries.size(), [&](size_t idx) {
+        auto& topk = thread_topk.local();
+        auto const& query = queries[idx];
+        // A safe lower bound only skips documents that cannot enter the top-k.
+        topk.set_threshold(estimates.estimate(query, max_k));
+        wand_query wand_q(topk);
         wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
         topk.finalize();
-        auto results = topk.topk();
+        for (size_t i = 0; i < ks.size(); ++i) {
+            thresholds[i][idx] = topk.score_at_rank(ks[i]);
+        }
         topk.clear();
-        float threshold = 0.0;
-        if (results.size() == k) {
-            threshold = results.back().first;
+    });
+
+    for (size_t i = 0; i < ks.size(); ++i) {
+        std::ofstream file;
+        if (output_basename) {
+            auto filename = fmt::format("{}.{}", *output_basename, ks[i]);
+            spdlog::info("Writing the thresholds for k = {} to {}", ks[i], filename);
+            file.open(filename);
+            file.precision(std::numeric_limits<float>::max_digits10);
+        }
+        std::ostream& os = output_basename ? file : std::cout;
+        for (float threshold: thresholds[i]) {
+            os << threshold << '\n';
         }
-        std::cout << threshold << '\n';
     }
 }
 
@@ -79,20 +117,50 @@ int main(int argc, const char** argv)
 
     bool quantized = false;
 
-    App<arg::Index, arg::WandData, arg::Query<arg::QueryMode::Ranked>, arg::Scorer> app{
-        "Extracts query thresholds."};
+    App<arg::Index,
+        arg::WandData,
+        arg::Query<arg::QueryMode::Unranked>,
+        arg::Scorer,
+        arg::Threads>
+        app{"Extracts query thresholds."};
+    std::vector<uint64_t> ks;
+    app.add_option("-k", ks, "The numbers of top results to extract the k-th score of")
+        ->required();
+    std::optional<std::string> output_basename;
+    app.add_option(
+        "-o,--output",
+        output_basename,
+        "Write the thresholds for each k to <output>.<k> instead of the standard output");
     app.add_flag("--quantized", quantized, "Quantizes the scores");
+    std::optional<std::string> term_thresholds_filename;
+    app.add_option(
+        "--term-thresholds",
+        term_thresholds_filename,
+        "Term thresholds from create_wand_data or create_term_thresholds to start from");
 
     CLI11_PARSE(app, argc, argv);
+    app.check_index();
+    if (ks.size() > 1 && not output_basename) {
+        spdlog::error("Thresholds for more than one k require --output");
+        return 1;
+    }
+    if (std::find(ks.begin(), ks.end(), 0) != ks.end()) {
+        spdlog::error("k must be positive");
+        return 1;
+    }
+    tbb::task_scheduler_init init(app.threads());
 
     auto params = std::make_tuple(
         app.index_filename(),
+        app.load_mode(),
         app.wand_data_path(),
         app.queries(),
         app.index_encoding(),
         app.scorer(),
-        app.k(),
-        quantized);
+        ks,
+        quantized,
+        term_thresholds_filename,
+        output_basename);
 
     /**/
     if (false) {
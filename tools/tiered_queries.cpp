@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+
+#include <CLI/CLI.hpp>
+#include <mio/mmap.hpp>
+#include <range/v3/view/enumerate.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "index_tiers.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "query/algorithm/tiered_query.hpp"
+#include "query/warmup.hpp"
+#include "scorer/scorer.hpp"
+#include "timer.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using wand_raw_index = wand_data<wand_data_raw>;
+
+template <typename IndexType>
+void perftest(
+    std::string const& tiers_basename,
+    std::string const& wand_data_filename,
+    std::vector<Query> const& queries,
+    std::string const& type,
+    std::string const& scorer_name,
+    uint64_t k,
+    size_t runs,
+    bool print)
+{
+    IndexType first_tier;
+    IndexType second_tier;
+    index_tiers tiers;
+    spdlog::info("Loading tiers from {}", tiers_basename);
+    mio::mmap_source m1((tiers_basename + ".tier1").c_str());
+    mapper::map(first_tier, m1);
+    mio::mmap_source m2((tiers_basename + ".tier2").c_str());
+    mapper::map(second_tier, m2);
+    mio::mmap_source mt((tiers_basename + ".tiers").c_str());
+    mapper::map(tiers, mt);
+    if (tiers.size() != first_tier.size()) {
+        throw std::invalid_argument("Tier description does not match the first tier");
+    }
+
+    spdlog::info("Warming up posting lists");
+    auto terms = query_log_terms(queries);
+    std::vector<term_id_type> second_terms;
+    for (auto t: terms) {
+        if (tiers.second_term(t) != index_tiers::no_term) {
+            second_terms.push_back(tiers.second_term(t));
+        }
+    }
+    warmup_lists(first_tier, terms);
+    warmup_lists(second_tier, second_terms);
+
+    wand_raw_index wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    spdlog::info("K: {}", k);
+
+    scorer::with_scorer(scorer_name, wdata, [&](auto const& scorer) {
+        topk_queue topk(k);
+        tiered_query query_alg(topk);
+        auto run_query = [&](Query const& query) {
+            topk.clear();
+            query_alg(first_tier, second_tier, tiers, scorer, query);
+        };
+
+        std::vector<double> query_times;
+        size_t first_tier_queries = 0;
+        for (size_t run = 0; run <= runs; ++run) {
+            for (auto const& query: queries) {
+                auto usecs =
+                    run_with_timer<std::chrono::microseconds>([&]() { run_query(query); });
+                if (run != 0) {  // first run is not timed
+                    query_times.push_back(usecs.count());
+                    first_tier_queries += query_alg.used_second_tier() ? 0 : 1;
+                }
+            }
+        }
+
+        if (print) {
+            for (auto&& [qid, query]: ranges::views::enumerate(queries)) {
+                run_query(query);
+                for (auto&& [rank, result]: ranges::views::enumerate(topk.topk())) {
+                    std::cout << fmt::format(
+                        "{}\t{}\t{}\t{}\n",
+                        query.id.value_or(std::to_string(qid)),
+                        rank,
+                        result.second,
+                        result.first);
+                }
+            }
+        }
+
+        std::sort(query_times.begin(), query_times.end());
+        double avg =
+            std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
+        double q50 = query_times[query_times.size() / 2];
+        double q90 = query_times[90 * query_times.size() / 100];
+        double q95 = query_times[95 * query_times.size() / 100];
+        double q99 = query_times[99 * query_times.size() / 100];
+        double first_tier_fraction = double(first_tier_queries) / query_times.size();
+
+        spdlog::info("---- {} tiered", type);
+        spdlog::info("Mean: {}", avg);
+        spdlog::info("50% quantile: {}", q50);
+        spdlog::info("90% quantile: {}", q90);
+        spdlog::info("95% quantile: {}", q95);
+        spdlog::info("99% quantile: {}", q99);
+        spdlog::info("Answered on the first tier: {}", first_tier_fraction);
+
+        stats_line()("type", type)("query", "tiered")("avg", avg)("q50", q50)("q90", q90)(
+            "q95", q95)("q99", q99)("first_tier", first_tier_fraction);
+    });
+}
+
+int main(int argc, const char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string tiers_basename;
+    std::string wand_data_filename;
+    bool print = false;
+
+    App<arg::Encoding, arg::Query<arg::QueryMode::Ranked>, arg::Scorer> app{
+        "Benchmarks query processing on a two-tier index built by create_freq_index --tiers"};
+    app.add_option("--tiers", tiers_basename, "Basename of the tiers")->required();
+    app.add_option("-w,--wand", wand_data_filename, "WAND data filename of the full index")
+        ->required();
+    app.add_flag("--print", print, "Print query results");
+    CLI11_PARSE(app, argc, argv);
+
+    auto params = std::make_tuple(
+        tiers_basename,
+        wand_data_filename,
+        app.queries(),
+        app.index_encoding(),
+        app.scorer(),
+        app.k(),
+        2,
+        print);
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                          \
+    }                                                                  \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))            \
+    {                                                                  \
+        std::apply(perftest<BOOST_PP_CAT(T, _index)>, params);         \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", app.index_encoding());
+    }
+    return 0;
+}
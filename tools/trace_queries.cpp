@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "mappable/warmup.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+#include "query/query_trace.hpp"
+#include "scorer/scorer.hpp"
+#include "topk_queue.hpp"
+#include "util/block_profiler.hpp"
+#include "util/util.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+/// Where replayed queries find the index and the WAND data.
+enum class cache_state { cold, warm, as_is };
+
+/// The options of both subcommands: the index a trace is recorded or replayed on.
+struct trace_options {
+    std::string encoding;
+    std::string index_filename;
+    std::string wand_data_filename;
+    bool compressed_wand = false;
+    std::string scorer = "bm25";
+};
+
+struct record_options {
+    std::string algorithm;
+    std::uint32_t k = 10;
+    std::string queries_filename;
+    std::string output_filename;
+};
+
+struct replay_options {
+    std::string trace_filename;
+    std::optional<std::size_t> query;
+    cache_state cache = cache_state::as_is;
+    std::size_t repeat = 1;
+    std::optional<std::string> output_filename;
+};
+
+/// Returns a function running a query with `algorithm`, tracing the thresholds of `topk`.
+template <typename Index, typename Wand, typename Scorer>
+[[nodiscard]] auto traced_algorithm(
+    std::string const& algorithm,
+    Index const& index,
+    Wand const& wdata,
+    Scorer const& scorer,
+    topk_queue& topk) -> std::function<void(Query const&)>
+{
+    auto num_docs = index.num_docs();
+    if (algorithm == "ranked_or") {
+        return [&, num_docs](Query const& query) {
+            basic_ranked_or_query<traced_query_stats> op(topk);
+            op(make_scored_cursors(index, scorer, query), num_docs);
+        };
+    }
+    if (algorithm == "ranked_and") {
+        return [&, num_docs](Query const& query) {
+            basic_ranked_and_query<traced_query_stats> op(topk);
+            op(make_scored_cursors(index, scorer, query), num_docs);
+        };
+    }
+    if (algorithm == "wand") {
+        return [&, num_docs](Query const& query) {
+            basic_wand_query<traced_query_stats> op(topk);
+            op(make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        };
+    }
+    if (algorithm == "maxscore") {
+        return [&, num_docs](Query const& query) {
+            basic_maxscore_query<traced_query_stats> op(topk);
+            op(make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        };
+    }
+    if (algorithm == "block_max_wand") {
+        return [&, num_docs](Query const& query) {
+            basic_block_max_wand_query<float, traced_query_stats> op(topk);
+            op(make_block_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        };
+    }
+    if (algorithm == "block_max_maxscore") {
+        return [&, num_docs](Query const& query) {
+            basic_block_max_maxscore_query<float, traced_query_stats> op(topk);
+            op(make_block_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        };
+    }
+    throw std::invalid_argument("Unsupported query algorithm: " + algorithm);
+}
+
+/// Counts of the events of a trace, and the threshold it ended with.
+struct trace_summary {
+    std::size_t docs_blocks = 0;
+    std::size_t freqs_blocks = 0;
+    std::size_t thresholds = 0;
+    float final_threshold = 0;
+
+    explicit trace_summary(query_trace const& trace)
+    {
+        for (auto const& event: trace.events) {
+            switch (event.type) {
+            case trace_event::kind::docs_block: docs_blocks += 1; break;
+            case trace_event::kind::freqs_block: freqs_blocks += 1; break;
+            case trace_event::kind::threshold:
+                thresholds += 1;
+                final_threshold = event.threshold;
+                break;
+            }
+        }
+    }
+};
+
+/// Returns the position of the first event at which the replayed trace decodes another block,
+/// or reaches another threshold, than the recorded one, ignoring the times, or the number of
+/// events of the shorter trace if it is a prefix of the other.
+[[nodiscard]] auto first_divergence(query_trace const& recorded, query_trace const& replayed)
+    -> std::size_t
+{
+    auto same = [](trace_event const& lhs, trace_event const& rhs) {
+        return lhs.type == rhs.type && lhs.term == rhs.term && lhs.block == rhs.block
+            && lhs.threshold == rhs.threshold;
+    };
+    auto size = std::min(recorded.events.size(), replayed.events.size());
+    auto mismatch = std::mismatch(
+        recorded.events.begin(), recorded.events.begin() + size, replayed.events.begin(), same);
+    return std::distance(recorded.events.begin(), mismatch.first);
+}
+
+/// Runs the queries of one algorithm on an index, traced or not.
+struct query_runner {
+    /// Runs a query, from clearing the top-k to finalizing it.
+    std::function<void(Query const&)> run;
+    /// Drops the index and the WAND data from memory.
+    std::function<void()> evict;
+
+    void trace(Query const& query, query_trace& trace) const
+    {
+        query_tracer::local().start(trace);
+        run(query);
+        query_tracer::local().finish();
+    }
+};
+
+/// Loads the index with profiled lists, which report the blocks they decode to the tracer, and
+/// the WAND data, and calls `fn` with a `query_runner` of `algorithm`.
+template <typename IndexType, typename Wand, typename Fn>
+void with_query_runner(
+    trace_options const& options, std::string const& algorithm, std::uint32_t k, Fn&& fn)
+{
+    using profiled_index = typename add_profiling<IndexType>::type;
+    mio::mmap_source index_file(options.index_filename.c_str());
+    profiled_index index;
+    mapper::map(index, index_file);
+    if constexpr (not std::is_same_v<profiled_index, IndexType>) {
+        // profiled lists register with the profiler when opened, so count blocks without it
+        IndexType plain_index;
+        mapper::map(plain_index, index_file);
+        std::vector<uint32_t> list_blocks(plain_index.size());
+        for (size_t term = 0; term < plain_index.size(); ++term) {
+            list_blocks[term] = plain_index[term].num_blocks();
+        }
+        block_profiler::init(list_blocks);
+    } else {
+        spdlog::warn("Lists of {} indexes do not report the blocks they decode", options.encoding);
+    }
+
+    Wand wdata;
+    mio::mmap_source wand_file(options.wand_data_filename.c_str());
+    mapper::map(wdata, wand_file);
+
+    topk_queue topk(k);
+    scorer::with_scorer(options.scorer, wdata, [&](auto const& scorer) {
+        auto algorithm_fn = traced_algorithm(algorithm, index, wdata, scorer, topk);
+        query_runner runner;
+        runner.run = [&](Query const& query) {
+            topk.clear();
+            algorithm_fn(query);
+            topk.finalize();
+        };
+        runner.evict = [&]() {
+            mapper::evict_memory(index_file.data(), index_file.size(), options.index_filename);
+            mapper::evict_memory(wand_file.data(), wand_file.size(), options.wand_data_filename);
+        };
+        fn(runner);
+    });
+}
+
+template <typename IndexType, typename Wand>
+void record(trace_options const& options, record_options const& record_opts)
+{
+    std::vector<Query> queries;
+    std::ifstream is(record_opts.queries_filename);
+    io::for_each_line(
+        is, [&](std::string const& line) { queries.push_back(parse_query_ids(line)); });
+
+    std::vector<query_trace> traces(queries.size());
+    with_query_runner<IndexType, Wand>(
+        options, record_opts.algorithm, record_opts.k, [&](query_runner const& runner) {
+            for (std::size_t idx = 0; idx < queries.size(); ++idx) {
+                traces[idx].id = queries[idx].id;
+                traces[idx].terms = queries[idx].terms;
+                runner.trace(queries[idx], traces[idx]);
+            }
+        });
+
+    std::size_t events = 0;
+    for (auto const& trace: traces) {
+        events += trace.events.size();
+    }
+    std::ofstream os(record_opts.output_filename, std::ios::binary);
+    query_trace_file::write(
+        os, trace_header{record_opts.algorithm, options.encoding, record_opts.k}, traces);
+    spdlog::info(
+        "Recorded {} queries, {} events, to {}",
+        traces.size(),
+        events,
+        record_opts.output_filename);
+}
+
+template <typename IndexType, typename Wand>
+void replay(trace_options const& options, replay_options const& replay_opts)
+{
+    std::ifstream is(replay_opts.trace_filename, std::ios::binary);
+    auto [header, recorded] = query_trace_file::read(is);
+    std::size_t first = 0;
+    std::size_t last = recorded.size();
+    if (replay_opts.query) {
+        if (*replay_opts.query >= recorded.size()) {
+            throw std::out_of_range(fmt::format(
+                "Query {} is not in a trace of {} queries", *replay_opts.query, recorded.size()));
+        }
+        first = *replay_opts.query;
+        last = first + 1;
+    }
+    if (header.encoding != options.encoding) {
+        spdlog::info(
+            "Replaying traces of a {} index on a {} index: blocks will differ",
+            header.encoding,
+            options.encoding);
+    }
+
+    std::vector<query_trace> replayed;
+    with_query_runner<IndexType, Wand>(
+        options, header.algorithm, header.k, [&](query_runner const& runner) {
+            for (auto idx = first; idx < last; ++idx) {
+                Query query{recorded[idx].id, recorded[idx].terms, {}};
+                std::vector<std::uint64_t> latencies;
+                query_trace trace{query.id, query.terms, 0, {}};
+                for (std::size_t run = 0; run < replay_opts.repeat; ++run) {
+                    if (replay_opts.cache == cache_state::cold) {
+                        runner.evict();
+                    } else if (replay_opts.cache == cache_state::warm) {
+                        runner.run(query);
+                    }
+                    runner.trace(query, trace);
+                    latencies.push_back(trace.nanoseconds);
+                }
+                std::sort(latencies.begin(), latencies.end());
+                trace_summary before(recorded[idx]);
+                trace_summary after(trace);
+                stats_line()("query", idx)("algorithm", header.algorithm)(
+                    "recorded_usecs", recorded[idx].nanoseconds / 1000.0)(
+                    "replayed_usecs", latencies[latencies.size() / 2] / 1000.0)(
+                    "recorded_docs_blocks", before.docs_blocks)(
+                    "replayed_docs_blocks", after.docs_blocks)(
+                    "recorded_freqs_blocks", before.freqs_blocks)(
+                    "replayed_freqs_blocks", after.freqs_blocks)(
+                    "recorded_threshold", before.final_threshold)(
+                    "replayed_threshold", after.final_threshold)(
+                    "first_divergence", first_divergence(recorded[idx], trace));
+                replayed.push_back(std::move(trace));
+            }
+        });
+
+    if (replay_opts.output_filename) {
+        std::ofstream os(*replay_opts.output_filename, std::ios::binary);
+        header.encoding = options.encoding;
+        query_trace_file::write(os, header, replayed);
+    }
+}
+
+template <typename IndexType, typename Wand>
+void trace_queries(
+    bool recording,
+    trace_options const& options,
+    record_options const& record_opts,
+    replay_options const& replay_opts)
+{
+    if (recording) {
+        record<IndexType, Wand>(options, record_opts);
+    } else {
+        replay<IndexType, Wand>(options, replay_opts);
+    }
+}
+
+void add_index_options(CLI::App* app, trace_options& options)
+{
+    app->add_option("-e,--encoding", options.encoding, "Index encoding")->required();
+    app->add_option("-i,--index", options.index_filename, "Inverted index filename")->required();
+    app->add_option("-w,--wand", options.wand_data_filename, "WAND data filename")->required();
+    app->add_flag("--compressed-wand", options.compressed_wand, "Compressed WAND data file");
+    app->add_option("-s,--scorer", options.scorer, "Scorer function", true);
+}
+
+int main(int argc, char const** argv)
+{
+    trace_options options;
+    record_options record_opts;
+    replay_options replay_opts;
+    std::string cache = "as-is";
+
+    CLI::App app{"Records the blocks decoded and the thresholds reached by queries, and replays "
+                 "them on any index."};
+    app.require_subcommand(1);
+    auto* record_cmd = app.add_subcommand("record", "Record the traces of a query log");
+    add_index_options(record_cmd, options);
+    record_cmd->add_option("-a,--algorithm", record_opts.algorithm, "Query processing algorithm")
+        ->required();
+    record_cmd->add_option("-k", record_opts.k, "The number of top results to return", true);
+    record_cmd->add_option("-q,--queries", record_opts.queries_filename, "Queries of term IDs")
+        ->required();
+    record_cmd->add_option("-o,--output", record_opts.output_filename, "Trace file")->required();
+
+    auto* replay_cmd = app.add_subcommand("replay", "Replay the queries of a trace file");
+    add_index_options(replay_cmd, options);
+    replay_cmd->add_option("-t,--trace", replay_opts.trace_filename, "Trace file")->required();
+    replay_cmd->add_option(
+        "--query", replay_opts.query, "Position of the only query to replay in the trace file");
+    replay_cmd
+        ->add_option(
+            "--cache",
+            cache,
+            "State of the cache before each run: cold (index and WAND data evicted), warm "
+            "(query run once before), or as-is",
+            true)
+        ->check(CLI::IsMember({"cold", "warm", "as-is"}));
+    replay_cmd->add_option(
+        "--repeat",
+        replay_opts.repeat,
+        "Runs of each query, whose median latency is reported",
+        true);
+    replay_cmd->add_option(
+        "-o,--output", replay_opts.output_filename, "Trace file of the replayed queries");
+    CLI11_PARSE(app, argc, argv);
+    replay_opts.cache = cache == "cold" ? cache_state::cold
+        : cache == "warm"               ? cache_state::warm
+                                        : cache_state::as_is;
+    replay_opts.repeat = std::max<std::size_t>(replay_opts.repeat, 1);
+    bool recording = *record_cmd;
+
+    try {
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                                          \
+    }                                                                                  \
+    else if (options.encoding == BOOST_PP_STRINGIZE(T))                                \
+    {                                                                                  \
+        if (options.compressed_wand) {                                                 \
+            trace_queries<BOOST_PP_CAT(T, _index), wand_uniform_index>(                \
+                recording, options, record_opts, replay_opts);                         \
+        } else {                                                                       \
+            trace_queries<BOOST_PP_CAT(T, _index), wand_raw_index>(                    \
+                recording, options, record_opts, replay_opts);                         \
+        }                                                                              \
+        /**/
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+        } else {
+            spdlog::error("Unknown type {}", options.encoding);
+            return 1;
+        }
+    } catch (std::exception const& error) {
+        spdlog::error("{}", error.what());
+        return 1;
+    }
+    return 0;
+}